@@ -0,0 +1,640 @@
+#include "Benchmark.hpp"
+#include "Gfx.hpp"
+#include "ScreenStack.hpp"
+#include "common.h"
+#include "screens/DownloadScreen.hpp"
+#include "screens/GfxBenchScreen.hpp"
+#include "screens/ThemeDetailScreen.hpp"
+#include "utils/Async.hpp"
+#include "utils/BackupManager.hpp"
+#include "utils/FileLogger.hpp"
+#include "utils/ThemeManager.hpp"
+#include "utils/ThemePatcher.hpp"
+#include "utils/ZipExtractor.hpp"
+#include "utils/ZipIndex.hpp"
+#include <coreinit/time.h>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// CSV 中 items 一列: catalog 为列表中的主题数, scroll 为实际移动的项数, detail 为打开的详情数,
+// install 为 1 (成功时), inflate 为解压的条目数, backup 为复制的文件数
+#define THEMES_DIR "fs:/vol/external01/wiiu/themes"
+#define SAMPLE_THEME_ID "utheme-benchmark"  // 同时作为主题名和目录名
+
+static constexpr uint32_t CATALOG_TIMEOUT_MS = 60000;
+static constexpr uint32_t PREVIEW_TIMEOUT_MS = 20000;
+static constexpr uint32_t SCREEN_TIMEOUT_MS = 5000;  // 打开或关闭界面
+static constexpr int RETRY_FRAMES = 20;              // 界面有输入冷却, 按键没有生效时隔这么多帧再按
+static constexpr int SCROLL_STEP_FRAMES = 3;
+static constexpr int DETAIL_VIEW_FRAMES = 30;        // 预览图加载完后停留的帧数
+static constexpr int DETAIL_STEPS = 3;               // 两个详情之间在列表中移动的项数
+static constexpr int SETTLE_FRAMES = 30;             // 场景之间等待界面动画结束
+static constexpr uint32_t GFX_TIMEOUT_MS = 300000;   // 所有绘制配置 (每帧先等 GPU 空闲, 帧率很低)
+
+// 备份用的固定目录树: TREE_DIRS 个目录, 每个 TREE_FILES 个 4 KB ~ 512 KB 的文件 (共约 16 MB)
+static constexpr int TREE_DIRS = 8;
+static constexpr int TREE_FILES = 16;
+static constexpr int TREE_VERSION = 1;  // 改变目录树的内容时增加, 旧的目录树会重新生成
+
+// 帧时间直方图的上界 (ms), 最后一格是超过 100ms 的帧
+static const float sHistogramEdges[] = {8.3f, 16.7f, 20.0f, 25.0f, 33.3f, 50.0f, 100.0f};
+static constexpr int HISTOGRAM_BUCKETS = sizeof(sHistogramEdges) / sizeof(sHistogramEdges[0]) + 1;
+
+static bool sRunning = false;
+static std::unique_ptr<Async::Scope> sScope;
+static std::coroutine_handle<> sWaiting;   // 等待下一帧的脚本协程
+static uint32_t sButtons = 0;              // 这一帧模拟按下的键
+static std::string sRunId;                 // 开始运行的时间, 同一次运行的各行相同
+static DownloadScreen* sDownload = nullptr;  // 脚本打开的下载界面, 关闭后为 nullptr
+static GfxBenchScreen* sGfxBench = nullptr;
+
+// 正在计时的场景
+static const char* sScenario = nullptr;
+static OSTime sScenarioStart = 0;
+static std::vector<float> sFrameMs;
+static OSTime sLastFrameEnd = 0;
+
+static float TicksToMs(OSTime ticks) {
+    return OSTicksToMicroseconds(ticks) / 1000.0f;
+}
+
+static std::string BenchPath(const char* name) {
+    return std::string(Benchmark::ROOT) + "/" + name;
+}
+
+static void MakeDirectory(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        mkdir(path.c_str(), 0755);
+    }
+}
+
+static std::string FormatNow() {
+    OSCalendarTime calendar;
+    OSTicksToCalendarTime(OSGetTime(), &calendar);
+    char text[32];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d:%02d", calendar.tm_year, calendar.tm_mon + 1,
+             calendar.tm_mday, calendar.tm_hour, calendar.tm_min, calendar.tm_sec);
+    return text;
+}
+
+// ---------------------------------------------------------------------------
+// 结果
+
+static float Percentile(const std::vector<float>& sorted, float p) {
+    if (sorted.empty()) {
+        return 0.0f;
+    }
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+static void WriteResult(const char* scenario, const char* status, float durationMs, int items) {
+    std::vector<float> sorted = sFrameMs;
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0.0f;
+    int histogram[HISTOGRAM_BUCKETS] = {};
+    for (float ms : sorted) {
+        sum += ms;
+        int bucket = 0;
+        while (bucket < HISTOGRAM_BUCKETS - 1 && ms > sHistogramEdges[bucket]) {
+            bucket++;
+        }
+        histogram[bucket]++;
+    }
+    float avg = sorted.empty() ? 0.0f : sum / sorted.size();
+    float maxMs = sorted.empty() ? 0.0f : sorted.back();
+
+    FileLogger::GetInstance().LogInfo("[Benchmark] %s: %s, %.0f ms, %d items, %zu frames, p50 %.1f p95 %.1f max %.1f ms",
+                                      scenario, status, durationMs, items, sorted.size(),
+                                      Percentile(sorted, 0.50f), Percentile(sorted, 0.95f), maxMs);
+
+    MakeDirectory(Benchmark::ROOT);
+    struct stat st;
+    bool newFile = stat(Benchmark::RESULTS_FILE, &st) != 0 || st.st_size == 0;
+    FILE* file = fopen(Benchmark::RESULTS_FILE, "a");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[Benchmark] Failed to open %s", Benchmark::RESULTS_FILE);
+        return;
+    }
+    if (newFile) {
+        fprintf(file, "run,version,scenario,status,duration_ms,items,frames,avg_ms,p50_ms,p95_ms,p99_ms,max_ms");
+        for (float edge : sHistogramEdges) {
+            fprintf(file, ",le%gms", edge);
+        }
+        fprintf(file, ",gt%gms\n", sHistogramEdges[HISTOGRAM_BUCKETS - 2]);
+    }
+    fprintf(file, "%s,%s,%s,%s,%.1f,%d,%zu,%.2f,%.2f,%.2f,%.2f,%.2f", sRunId.c_str(), APP_VERSION_FULL, scenario, status,
+            durationMs, items, sorted.size(), avg, Percentile(sorted, 0.50f), Percentile(sorted, 0.95f),
+            Percentile(sorted, 0.99f), maxMs);
+    for (int count : histogram) {
+        fprintf(file, ",%d", count);
+    }
+    fprintf(file, "\n");
+    fclose(file);
+}
+
+// 绘制基准的一个配置: 每次调用的时间和提交次数, 和场景的结果分开保存
+static void WriteGfxResult(const GfxBenchScreen::Result& result) {
+    MakeDirectory(Benchmark::ROOT);
+    struct stat st;
+    bool newFile = stat(Benchmark::GFX_RESULTS_FILE, &st) != 0 || st.st_size == 0;
+    FILE* file = fopen(Benchmark::GFX_RESULTS_FILE, "a");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[Benchmark] Failed to open %s", Benchmark::GFX_RESULTS_FILE);
+        return;
+    }
+    if (newFile) {
+        fprintf(file, "run,version,case,calls,cpu_us_per_call,gpu_us_per_call,draw_calls_per_frame\n");
+    }
+    fprintf(file, "%s,%s,%s,%d,%.3f,%.3f,%.1f\n", sRunId.c_str(), APP_VERSION_FULL, result.name, result.calls,
+            result.cpuUsPerCall, result.gpuUsPerCall, result.drawCallsPerFrame);
+    fclose(file);
+}
+
+static void BeginScenario(const char* name) {
+    sScenario = name;
+    sScenarioStart = OSGetSystemTime();
+    sFrameMs.clear();
+}
+
+static void EndScenario(const char* status, int items) {
+    if (!sScenario) {
+        return;
+    }
+    WriteResult(sScenario, status, TicksToMs(OSGetSystemTime() - sScenarioStart), items);
+    sScenario = nullptr;
+}
+
+static void SkipScenario(const char* name, const char* reason) {
+    FileLogger::GetInstance().LogInfo("[Benchmark] %s skipped: %s", name, reason);
+    sFrameMs.clear();
+    WriteResult(name, "skipped", 0.0f, 0);
+}
+
+// ---------------------------------------------------------------------------
+// 脚本的基本操作
+
+namespace {
+
+// 在下一次 Benchmark::Update 中继续
+class NextFrame : public Async::Detail::CancellableAwaiter {
+public:
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    void await_suspend(std::coroutine_handle<P> handle) {
+        mScope = handle.promise().scope;
+        sWaiting = handle;
+    }
+};
+
+} // namespace
+
+static Async::Task<void> WaitFrames(int frames) {
+    for (int i = 0; i < frames; i++) {
+        co_await NextFrame();
+    }
+}
+
+// 这一帧按下 buttons (buttons_d 和 buttons_h 都有), 下一帧松开
+static Async::Task<void> Press(uint32_t buttons) {
+    sButtons = buttons;
+    co_await NextFrame();
+}
+
+// 等待 condition 成立, 超时返回 false
+static Async::Task<bool> WaitUntil(std::function<bool()> condition, uint32_t timeoutMs) {
+    OSTime start = OSGetSystemTime();
+    while (!condition()) {
+        if (OSTicksToMilliseconds(OSGetSystemTime() - start) > timeoutMs) {
+            co_return false;
+        }
+        co_await NextFrame();
+    }
+    co_return true;
+}
+
+// 按下 buttons 直到 condition 成立 (界面还在输入冷却时按键会被忽略), 超时返回 false
+static Async::Task<bool> PressUntil(uint32_t buttons, std::function<bool()> condition, uint32_t timeoutMs) {
+    OSTime start = OSGetSystemTime();
+    while (!condition()) {
+        if (OSTicksToMilliseconds(OSGetSystemTime() - start) > timeoutMs) {
+            co_return false;
+        }
+        co_await Press(buttons);
+        for (int i = 0; i < RETRY_FRAMES && !condition(); i++) {
+            co_await NextFrame();
+        }
+    }
+    co_return true;
+}
+
+static bool HasCatalog() {
+    return sDownload && sDownload->IsListReady() && sDownload->GetListSize() > 0;
+}
+
+// ---------------------------------------------------------------------------
+// 场景
+
+static Async::Task<void> CatalogScenario(const char* name, bool keepOpen) {
+    BeginScenario(name);
+    // 有缓存时构造函数里就读入了缓存, 也计入时间
+    auto screen = std::make_unique<DownloadScreen>();
+    sDownload = screen.get();
+    ScreenStack::Push(std::move(screen), []() { sDownload = nullptr; });
+
+    bool finished = co_await WaitUntil([]() {
+        return !sDownload || sDownload->IsListReady() || sDownload->HasLoadError();
+    }, CATALOG_TIMEOUT_MS);
+    const char* status = !finished ? "timeout" : HasCatalog() ? "ok" : "error";
+    EndScenario(status, sDownload ? sDownload->GetListSize() : 0);
+
+    if (!keepOpen && sDownload) {
+        co_await PressUntil(Input::BUTTON_B, []() { return sDownload == nullptr; }, SCREEN_TIMEOUT_MS);
+    }
+    co_await WaitFrames(SETTLE_FRAMES);
+}
+
+static Async::Task<void> ScrollScenario() {
+    if (!HasCatalog()) {
+        SkipScenario("scroll", "catalog not loaded");
+        co_return;
+    }
+
+    BeginScenario("scroll");
+    int startIndex = sDownload->GetSelectedIndex();
+    for (int i = 0; i < Benchmark::SCROLL_STEPS && sDownload; i++) {
+        co_await Press(Input::BUTTON_DOWN);
+        co_await WaitFrames(SCROLL_STEP_FRAMES - 1);
+    }
+    EndScenario(sDownload ? "ok" : "error", sDownload ? sDownload->GetSelectedIndex() - startIndex : 0);
+    co_await WaitFrames(SETTLE_FRAMES);
+}
+
+static Async::Task<void> DetailScenario() {
+    if (!HasCatalog()) {
+        SkipScenario("detail", "catalog not loaded");
+        co_return;
+    }
+
+    BeginScenario("detail");
+    const char* status = "ok";
+    int opened = 0;
+    for (int i = 0; i < Benchmark::DETAIL_SCREENS && sDownload; i++) {
+        if (!co_await PressUntil(Input::BUTTON_A, []() { return ScreenStack::Top() != sDownload; }, SCREEN_TIMEOUT_MS)) {
+            status = "timeout";
+            break;
+        }
+        // 下载界面上面只会压入主题详情
+        auto* detail = static_cast<ThemeDetailScreen*>(ScreenStack::Top());
+        if (!co_await WaitUntil([detail]() { return detail->IsPreviewReady(); }, PREVIEW_TIMEOUT_MS)) {
+            status = "timeout";
+        }
+        opened++;
+        co_await WaitFrames(DETAIL_VIEW_FRAMES);
+
+        if (!co_await PressUntil(Input::BUTTON_B, []() { return ScreenStack::Top() == sDownload; }, SCREEN_TIMEOUT_MS)) {
+            status = "timeout";
+            break;
+        }
+        for (int step = 0; step < DETAIL_STEPS; step++) {
+            co_await WaitFrames(RETRY_FRAMES);  // 从详情返回后下载界面也有输入冷却
+            co_await Press(Input::BUTTON_DOWN);
+        }
+    }
+    EndScenario(status, opened);
+
+    if (sDownload) {
+        co_await PressUntil(Input::BUTTON_B, []() { return sDownload == nullptr; }, SCREEN_TIMEOUT_MS);
+    }
+    co_await WaitFrames(SETTLE_FRAMES);
+}
+
+// 解压和安装示例主题 (在任务线程上运行), 和本地安装界面的流程相同
+static bool InstallSampleTheme(const std::string& archivePath) {
+    std::string themeDir = std::string(THEMES_DIR) + "/" + SAMPLE_THEME_ID;
+    MakeDirectory(THEMES_DIR);
+    MakeDirectory(themeDir);
+
+    ZipExtractor extractor;
+    extractor.SetFilter([](const std::string& name) {
+        return !(name.length() > 4 && name.compare(name.length() - 4, 4, ".bps") == 0);
+    });
+    if (!extractor.Extract(archivePath, themeDir)) {
+        return false;
+    }
+
+    ThemePatcher patcher;
+    return patcher.InstallThemeFromArchive(archivePath, themeDir, SAMPLE_THEME_ID, SAMPLE_THEME_ID, "UTheme");
+}
+
+// 卸载示例主题; 中止时协程帧销毁, 也在这里清理
+struct SampleThemeGuard {
+    std::string previousRecord;  // 安装前的当前主题记录
+
+    ~SampleThemeGuard() {
+        ThemePatcher patcher;
+        if (patcher.IsThemeInstalled(SAMPLE_THEME_ID)) {
+            patcher.UninstallTheme(SAMPLE_THEME_ID);
+        }
+        ThemePatcher::RestoreCurrentThemeRecord(previousRecord);
+    }
+};
+
+// ROOT 下的示例主题, 没有时为空
+static std::string FindSampleArchive() {
+    for (const char* name : {"sample.utheme", "sample.zip"}) {
+        struct stat st;
+        if (stat(BenchPath(name).c_str(), &st) == 0) {
+            return BenchPath(name);
+        }
+    }
+    return "";
+}
+
+static Async::Task<void> InstallScenario() {
+    std::string archivePath = FindSampleArchive();
+    if (archivePath.empty()) {
+        SkipScenario("install", "no sample.utheme in benchmark folder");
+        co_return;
+    }
+
+    SampleThemeGuard guard{ThemePatcher::ReadCurrentThemeRecord()};
+    {
+        // 上次运行中途退出时留下的
+        ThemePatcher patcher;
+        if (patcher.IsThemeInstalled(SAMPLE_THEME_ID)) {
+            patcher.UninstallTheme(SAMPLE_THEME_ID);
+        }
+    }
+
+    BeginScenario("install");
+    co_await Async::ResumeOnWorker();
+    bool success = InstallSampleTheme(archivePath);
+    co_await Async::ResumeOnMainThread();
+    EndScenario(success ? "ok" : "error", success ? 1 : 0);
+}
+
+// 用指定的 inflate 实现把所有条目解压到和 ZipExtractor 相同大小的缓冲区 (在任务线程上运行), 返回解压的条目数
+static int InflateArchive(const ZipIndex& index, ZipIndex::InflateBackend backend, bool& ok) {
+    ZipIndex::InflateBackend previous = ZipIndex::GetInflateBackend();
+    ZipIndex::SetInflateBackend(backend);
+    FileIO::Buffer buffer(ZipExtractor::DEFAULT_BUFFER_SIZE);
+    ZipIndex::Reader reader;
+    int entries = 0;
+    ok = buffer.size() > 0;
+    for (const ZipIndex::Entry& entry : index.GetEntries()) {
+        if (!ok) {
+            break;
+        }
+        if (entry.IsDirectory()) {
+            continue;
+        }
+        ok = reader.Open(index, entry);
+        while (ok && reader.Read(buffer.data(), buffer.size()) > 0) {
+        }
+        ok = ok && !reader.Failed();
+        entries++;
+    }
+    ZipIndex::SetInflateBackend(previous);
+    return entries;
+}
+
+static Async::Task<void> InflateScenario() {
+    std::string archivePath = FindSampleArchive();
+    std::shared_ptr<const ZipIndex> index = archivePath.empty() ? nullptr : ZipIndex::Get(archivePath);
+    const std::pair<const char*, ZipIndex::InflateBackend> backends[] = {
+        {"inflate-stream", ZipIndex::INFLATE_STREAM},
+        {"inflate-direct", ZipIndex::INFLATE_DIRECT},
+    };
+    for (const auto& backend : backends) {
+        if (!index) {
+            SkipScenario(backend.first, "no sample.utheme in benchmark folder");
+            continue;
+        }
+        BeginScenario(backend.first);
+        co_await Async::ResumeOnWorker();
+        bool ok = false;
+        int entries = InflateArchive(*index, backend.second, ok);
+        co_await Async::ResumeOnMainThread();
+        EndScenario(ok ? "ok" : "error", entries);
+    }
+}
+
+// 生成备份用的目录树 (在任务线程上运行), 已经生成过同一版本时直接返回
+static bool PrepareBackupTree(const std::string& treeDir) {
+    std::string marker = treeDir + "/.complete";
+    FILE* file = fopen(marker.c_str(), "r");
+    if (file) {
+        int version = 0;
+        bool current = fscanf(file, "%d", &version) == 1 && version == TREE_VERSION;
+        fclose(file);
+        if (current) {
+            return true;
+        }
+    }
+
+    MakeDirectory(treeDir);
+    std::vector<uint8_t> buffer(64 * 1024);
+    for (int d = 0; d < TREE_DIRS; d++) {
+        char dirPath[256];
+        snprintf(dirPath, sizeof(dirPath), "%s/dir%02d", treeDir.c_str(), d);
+        MakeDirectory(dirPath);
+        for (int f = 0; f < TREE_FILES; f++) {
+            char filePath[288];
+            snprintf(filePath, sizeof(filePath), "%s/file%02d.bin", dirPath, f);
+            FILE* out = fopen(filePath, "wb");
+            if (!out) {
+                return false;
+            }
+            size_t size = (size_t)4096 << (f % 8);
+            for (size_t i = 0; i < buffer.size(); i++) {
+                buffer[i] = (uint8_t)(i * 31 + d * 7 + f);
+            }
+            bool ok = true;
+            for (size_t written = 0; ok && written < size; written += buffer.size()) {
+                size_t chunk = std::min(buffer.size(), size - written);
+                ok = fwrite(buffer.data(), 1, chunk, out) == chunk;
+            }
+            fclose(out);
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+
+    file = fopen(marker.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "%d\n", TREE_VERSION);
+    fclose(file);
+    return true;
+}
+
+static Async::Task<void> BackupRun(const char* name, const std::string& treeDir, const std::string& backupDir,
+                                   bool archive = false) {
+    BackupManager backup;
+    bool failed = false;
+    backup.SetErrorCallback([&failed](const std::string& error) {
+        FileLogger::GetInstance().LogError("[Benchmark] Backup error: %s", error.c_str());
+        failed = true;
+    });
+
+    BeginScenario(name);
+    bool started = archive ? backup.StartArchiveBackup(treeDir, backupDir) : backup.StartBackup(treeDir, backupDir);
+    if (!started) {
+        EndScenario("error", 0);
+        co_return;
+    }
+    while (backup.UpdateBackup()) {
+        co_await NextFrame();
+    }
+    EndScenario(failed ? "error" : "ok", backup.GetProcessedItems() - backup.GetSkippedItems());
+}
+
+static Async::Task<void> BackupScenario() {
+    std::string treeDir = BenchPath("tree");
+    std::string backupDir = BenchPath("backup");
+
+    co_await Async::ResumeOnWorker();
+    bool prepared = PrepareBackupTree(treeDir);
+    co_await Async::ResumeOnMainThread();
+    if (!prepared) {
+        SkipScenario("backup-full", "failed to create the source tree");
+        co_return;
+    }
+
+    // 没有清单时复制所有文件
+    MakeDirectory(backupDir);
+    unlink((backupDir + "/" + BackupManager::MANIFEST_FILE).c_str());
+    co_await BackupRun("backup-full", treeDir, backupDir);
+    co_await WaitFrames(SETTLE_FRAMES);
+    co_await BackupRun("backup-incremental", treeDir, backupDir);
+    co_await WaitFrames(SETTLE_FRAMES);
+    co_await BackupRun("backup-archive", treeDir, backupDir, true);
+}
+
+static Async::Task<void> GfxScenario() {
+    // 中止时界面自己画完剩下的配置再关闭, 回调不能引用协程中的变量
+    static int sGfxCases = 0;
+    sGfxCases = 0;
+    auto screen = std::make_unique<GfxBenchScreen>([](const GfxBenchScreen::Result& result) {
+        WriteGfxResult(result);
+        sGfxCases++;
+    });
+    sGfxBench = screen.get();
+    ScreenStack::Push(std::move(screen), []() { sGfxBench = nullptr; });
+
+    BeginScenario("gfx");
+    bool finished = co_await WaitUntil([]() { return !sGfxBench; }, GFX_TIMEOUT_MS);
+    EndScenario(finished ? "ok" : "timeout", sGfxCases);
+    co_await WaitFrames(SETTLE_FRAMES);
+}
+
+static Async::Task<void> RunAll() {
+    FileLogger::GetInstance().LogInfo("[Benchmark] Started (%s)", sRunId.c_str());
+
+    ThemeManager::DeleteCache();
+    co_await CatalogScenario("catalog-cold", false);
+    co_await CatalogScenario("catalog-warm", true);
+    co_await ScrollScenario();
+    co_await DetailScenario();
+    co_await InstallScenario();
+    co_await InflateScenario();
+    co_await BackupScenario();
+    co_await GfxScenario();
+
+    FileLogger::GetInstance().LogInfo("[Benchmark] Finished, results in %s", Benchmark::RESULTS_FILE);
+    sRunning = false;
+}
+
+// ---------------------------------------------------------------------------
+
+void Benchmark::Start() {
+    if (sRunning) {
+        return;
+    }
+    sRunning = true;
+    sRunId = FormatNow();
+    sButtons = 0;
+    sScope = std::make_unique<Async::Scope>();
+    sScope->Spawn(RunAll());
+}
+
+void Benchmark::Stop() {
+    if (!sRunning) {
+        return;
+    }
+    sRunning = false;
+    FileLogger::GetInstance().LogInfo("[Benchmark] Aborted");
+    EndScenario("aborted", 0);
+
+    // 等待任务线程上的部分结束, 再恢复等待中的协程, 它抛出 Cancelled 并清理
+    sScope->Cancel();
+    if (sWaiting) {
+        std::coroutine_handle<> waiting = sWaiting;
+        sWaiting = nullptr;
+        waiting.resume();
+    }
+}
+
+bool Benchmark::IsRunning() {
+    return sRunning;
+}
+
+void Benchmark::Update(Input &input) {
+    if (!sRunning) {
+        return;
+    }
+
+    sButtons = 0;
+    const uint32_t abortCombo = Input::BUTTON_ZL | Input::BUTTON_ZR;
+    if ((input.data.buttons_h & abortCombo) == abortCombo && (input.data.buttons_d & Input::BUTTON_B)) {
+        Stop();
+    } else if (sWaiting) {
+        std::coroutine_handle<> waiting = sWaiting;
+        sWaiting = nullptr;
+        waiting.resume();
+    }
+
+    // 中止的这一帧也不把 B 交给界面
+    input.data = {};
+    input.lastData = {};
+    input.data.buttons_h = sButtons;
+    input.data.buttons_d = sButtons;
+}
+
+void Benchmark::EndFrame() {
+    OSTime now = OSGetSystemTime();
+    if (sScenario && sLastFrameEnd) {
+        sFrameMs.push_back(TicksToMs(now - sLastFrameEnd));
+    }
+    sLastFrameEnd = now;
+}
+
+void Benchmark::DrawOverlay() {
+    if (!sRunning) {
+        return;
+    }
+
+    char line[96];
+    if (sScenario) {
+        snprintf(line, sizeof(line), "Benchmark: %s  %.1fs", sScenario, TicksToMs(OSGetSystemTime() - sScenarioStart) / 1000.0f);
+    } else {
+        snprintf(line, sizeof(line), "Benchmark");
+    }
+    const int w = 460;
+    const int x = Gfx::SCREEN_WIDTH - w - 20;
+    const int y = 20;
+    Gfx::DrawRectFilled(x, y, w, 70, {0x00, 0x00, 0x00, 0xc0});
+    Gfx::Print(x + 12, y + 20, 24, Gfx::COLOR_WARNING, line, Gfx::ALIGN_VERTICAL);
+    Gfx::Print(x + 12, y + 50, 20, Gfx::COLOR_ALT_TEXT, "ZL + ZR + B: abort", Gfx::ALIGN_VERTICAL);
+}
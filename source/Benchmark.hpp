@@ -0,0 +1,39 @@
+#pragma once
+
+#include "input/Input.h"
+
+// 基准测试模式: 不需要操作, 按固定的脚本依次运行下面的场景, 每个场景的耗时和帧时间分布
+// 追加到 SD 卡上的 RESULTS_FILE (CSV), 用来在主机上对比不同版本
+//   catalog-cold        删除目录缓存后打开下载界面, 直到列表显示
+//   catalog-warm        从缓存打开下载界面
+//   scroll              在列表中向下移动 SCROLL_STEPS 项
+//   detail              依次打开 DETAIL_SCREENS 个主题详情, 等当前预览图的高清图加载完再返回
+//   install             安装 ROOT 下的示例主题 (sample.utheme 或 sample.zip), 之后卸载并恢复原来的当前主题
+//   inflate-stream      把示例主题的所有条目解压到内存 (不写文件), 使用 ZipIndex::INFLATE_STREAM
+//   inflate-direct      同上, 使用 ZipIndex::INFLATE_DIRECT
+//   backup-full         备份 ROOT/tree (第一次运行时生成的固定目录树)
+//   backup-incremental  再备份一次, 文件都没有变化
+//   gfx                 GfxBenchScreen 逐个测量 Gfx 基本图形和文字, 每个配置一行写入 GFX_RESULTS_FILE
+// 在主菜单按 ZL + ZR + PLUS 或在配置文件中设置 benchmark=1 开始, 按 ZL + ZR + B 中止
+// 运行期间真实的输入不交给界面, 界面收到的是脚本模拟的按键
+class Benchmark {
+public:
+    static constexpr const char* ROOT = "fs:/vol/external01/UTheme/benchmark";
+    static constexpr const char* RESULTS_FILE = "fs:/vol/external01/UTheme/benchmark/results.csv";
+    static constexpr const char* GFX_RESULTS_FILE = "fs:/vol/external01/UTheme/benchmark/gfx_results.csv";
+
+    static constexpr int SCROLL_STEPS = 200;
+    static constexpr int DETAIL_SCREENS = 10;
+
+    static void Start();
+    // 中止运行中的场景 (程序退出前也要调用)
+    static void Stop();
+    static bool IsRunning();
+
+    // 每帧在界面 Update 之前调用: 继续执行脚本, 再用脚本的按键替换 input
+    static void Update(Input &input);
+    // 每画完一帧调用一次, 记录帧间隔
+    static void EndFrame();
+    // 运行中在屏幕右上角显示当前场景
+    static void DrawOverlay();
+};
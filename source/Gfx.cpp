@@ -1,15 +1,26 @@
 #include "Gfx.hpp"
 #include "utils/SDL_FontCache.h"
+#include "utils/Animation.hpp"
+#include "utils/TextureRegistry.hpp"
+#include "utils/FileIO.hpp"
+#include "utils/JobSystem.hpp"
+#include "utils/AssetBundle.hpp"
 #include <cstdarg>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <map>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <coreinit/debug.h>
 #include <coreinit/memory.h>
+#include <coreinit/time.h>
 
 #include <fa-solid-900_ttf.h>
 #include <font_ttf.h>
-#include <ter-u32b_bdf.h>
 
 namespace {
 
@@ -25,49 +36,814 @@ namespace {
 
     std::map<int, FC_Font *> fontMap;
 
+    // only used by debug views: created from the asset bundle on first use
     FC_Font *monospaceFont = nullptr;
 
-    TTF_Font *iconFont = nullptr;
+    AssetBundle::Data monospaceData;
 
-    std::map<Uint16, SDL_Texture *> iconCache;
+    // The embedded font is a subset (see tools/subset_font.py). Strings with a glyph it lacks are drawn with
+    // the full font from the SD card, read in the background the first time such a string shows up
+    constexpr const char *FULL_FONT_PATH = "fs:/vol/external01/UTheme/font.ttf";
 
-    FC_Font *GetFontForSize(int size) {
-        if (fontMap.contains(size)) {
-            return fontMap[size];
-        }
+    enum FullFontState {
+        FULL_FONT_UNUSED,
+        FULL_FONT_LOADING,
+        FULL_FONT_READY,
+        FULL_FONT_MISSING
+    };
+
+    FullFontState fullFontState = FULL_FONT_UNUSED;
+
+    std::vector<uint8_t> fullFontData;
+
+    std::map<int, FC_Font *> fullFontMap;
+
+    // only used to look up which codepoints the embedded font provides
+    TTF_Font *fontProbe = nullptr;
+
+    // Glyphs rasterized ahead of time, a little per frame, so a new screen doesn't stall on them
+    struct GlyphPrewarm {
+        std::vector<Uint32> codepoints;
+        std::vector<int> sizes;  // most used first, sizes created later are appended
+        size_t sizeIndex = 0;
+        size_t codepointIndex = 0;
+    };
+
+    GlyphPrewarm prewarm;
+
+    constexpr int PREWARM_SIZES[] = {28, 32, 24, 40, 48, 44};
+
+    constexpr uint64_t PREWARM_BUDGET_US = 2000;
+
+    // Icons are rendered once per size bucket and packed into shared atlas pages, so icons batch together.
+    // Drawn sizes up to a bucket's size are scaled down from it
+    constexpr int ICON_BUCKET_SIZES[] = {64, 128};
+
+    constexpr int ICON_BUCKET_COUNT = sizeof(ICON_BUCKET_SIZES) / sizeof(ICON_BUCKET_SIZES[0]);
+
+    TTF_Font *iconFonts[ICON_BUCKET_COUNT] = {};
+
+    constexpr int ICON_ATLAS_SIZE = 1024;
+
+    constexpr int ICON_PADDING = 2;  // keeps linear filtering from sampling the neighbours
+
+    struct IconAtlasPage {
+        SDL_Texture *texture = nullptr;
+        int shelfX           = 0;
+        int shelfY           = 0;
+        int shelfHeight      = 0;
+    };
+
+    std::vector<IconAtlasPage> iconPages;
+
+    // Font Awesome glyphs live in the private use area, so a flat table from FIRST_ICON covers all of them
+    constexpr Uint16 FIRST_ICON = 0xe000;
+
+    struct IconEntry {
+        Sint16 page = -1;  // -1: not rendered yet, -2: failed
+        Uint16 x = 0, y = 0, w = 0, h = 0;
+    };
+
+    std::vector<IconEntry> iconTable;  // (icon - FIRST_ICON) * ICON_BUCKET_COUNT + bucket
 
+    // Quads waiting to be submitted together with one SDL_RenderGeometry call.
+    // All quads share a texture (nullptr for filled rects) and blend mode; changing either flushes.
+    struct QuadBatch {
+        SDL_Texture *texture    = nullptr;
+        SDL_BlendMode blendMode = SDL_BLENDMODE_NONE;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    QuadBatch batch;
+
+    // blend mode for untextured quads, the renderer's own draw blend mode is only set when a batch is flushed
+    SDL_BlendMode drawBlendMode = SDL_BLENDMODE_NONE;
+
+    // A single glyph of a cached text layout, positioned relative to the start of its line (unscaled)
+    struct GlyphQuad {
+        int cacheLevel;
+        SDL_Rect src;
+        float x;
+        int line;
+    };
+
+    // Glyph positions and extents of one string, built once with the same rules as FC_RenderLeft/FC_GetWidth
+    struct TextLayout {
+        std::vector<GlyphQuad> quads;
+        std::vector<int> lineWidths;
+        int width = 0;
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+
+    using LayoutMap = std::unordered_map<std::string, TextLayout, StringHash, std::equal_to<>>;
+
+    // font -> text -> layout, looked up with string_view so a cache hit doesn't allocate
+    std::map<FC_Font *, LayoutMap> layoutCache;
+
+    // dynamic strings (progress, timers) would grow the cache forever, so start over past this
+    constexpr size_t MAX_LAYOUTS_PER_FONT = 512;
+
+    // One line of wrapped text, as a byte range of the source string
+    struct WrappedLine {
+        uint32_t start;
+        uint32_t length;
+    };
+
+    using WrapMap = std::unordered_map<std::string, std::vector<WrappedLine>, StringHash, std::equal_to<>>;
+
+    // (font, max width) -> text -> line breaks, dropped on language change like the static text
+    std::map<std::pair<FC_Font *, int>, WrapMap> wrapCache;
+
+    // A string rendered once into its own texture (white, unscaled), drawn with a single SDL_RenderCopy
+    struct StaticText {
+        SDL_Texture *texture = nullptr;
+        int width            = 0;
+        int height           = 0;
+        uint64_t lastUse     = 0;
+    };
+
+    using StaticTextMap = std::unordered_map<std::string, StaticText, StringHash, std::equal_to<>>;
+
+    // horizontal alignment changes where each line sits in the texture, so it is part of the key
+    enum StaticAlign {
+        STATIC_LEFT,
+        STATIC_CENTER,
+        STATIC_RIGHT,
+    };
+
+    std::map<std::pair<FC_Font *, StaticAlign>, StaticTextMap> staticTextCache;
+
+    uint64_t staticTextUseCounter = 0;
+
+    size_t staticTextPixels = 0;
+
+    // SDL draw submissions this frame, and the total of the last presented frame
+    int drawCalls = 0;
+    int lastFrameDrawCalls = 0;
+
+    // ~16MB of RGBA textures, least recently drawn strings are dropped first
+    constexpr size_t MAX_STATIC_TEXT_PIXELS = 4 * 1024 * 1024;
+
+    FC_Font *LoadFontAtSize(void *data, size_t dataSize, int size) {
         FC_Font *font = FC_CreateFont();
         if (!font) {
             return font;
         }
 
-        if (!FC_LoadFont_RW(font, renderer, SDL_RWFromMem(fontData, fontSize), 1, size, Gfx::COLOR_BLACK, TTF_STYLE_NORMAL)) {
+        if (!FC_LoadFont_RW(font, renderer, SDL_RWFromMem(data, dataSize), 1, size, Gfx::COLOR_BLACK, TTF_STYLE_NORMAL)) {
             FC_FreeFont(font);
             return nullptr;
         }
+        return font;
+    }
+
+    FC_Font *GetMonospaceFont() {
+        if (monospaceFont || monospaceData) {
+            // monospaceData without a font means loading failed, don't retry every frame
+            return monospaceFont;
+        }
+
+        monospaceData = AssetBundle::Load("ter-u32b.bdf");
+        if (!monospaceData) {
+            monospaceData = std::make_shared<const std::vector<uint8_t>>();
+            return nullptr;
+        }
+
+        monospaceFont = LoadFontAtSize((void *) monospaceData->data(), monospaceData->size(), 32);
+        return monospaceFont;
+    }
+
+    FC_Font *GetFontForSize(int size) {
+        if (fontMap.contains(size)) {
+            return fontMap[size];
+        }
+
+        FC_Font *font = LoadFontAtSize(fontData, fontSize, size);
+        if (!font) {
+            return nullptr;
+        }
 
         fontMap.insert({size, font});
+
+        if (std::find(prewarm.sizes.begin(), prewarm.sizes.end(), size) == prewarm.sizes.end()) {
+            prewarm.sizes.push_back(size);
+        }
         return font;
     }
 
-    SDL_Texture *LoadIcon(Uint16 icon) {
-        if (iconCache.contains(icon)) {
-            return iconCache[icon];
+    void LoadFullFont() {
+        fullFontState = FULL_FONT_LOADING;
+
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        auto ok   = std::make_shared<bool>(false);
+        JobSystem::Submit(
+                [data, ok](const CancelToken &) {
+                    *ok = FileIO::ReadAll(FULL_FONT_PATH, *data);
+                },
+                [data, ok]() {
+                    if (!*ok || data->empty()) {
+                        OSReport("Full font %s not found, rare glyphs stay missing\n", FULL_FONT_PATH);
+                        fullFontState = FULL_FONT_MISSING;
+                        return;
+                    }
+                    fullFontData  = std::move(*data);
+                    fullFontState = FULL_FONT_READY;
+                });
+    }
+
+    // true if the text has a codepoint the embedded font doesn't provide
+    bool NeedsFullFont(std::string_view text) {
+        if (!fontProbe || fullFontState == FULL_FONT_MISSING) {
+            return false;
         }
 
-        SDL_Surface *iconSurface = TTF_RenderGlyph_Blended(iconFont, icon, Gfx::COLOR_WHITE);
+        for (size_t i = 0; i < text.size();) {
+            auto lead = (unsigned char) text[i];
+            if (lead < 0x80) {
+                i++;
+                continue;
+            }
+
+            int length       = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+            Uint32 codepoint = lead & (0x3f >> (length - 1));
+            for (int j = 1; j < length && i + j < text.size(); j++) {
+                codepoint = (codepoint << 6) | ((unsigned char) text[i + j] & 0x3f);
+            }
+            i += length;
+
+            if (!TTF_GlyphIsProvided32(fontProbe, codepoint)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    FC_Font *GetFontForText(int size, std::string_view text) {
+        if (!NeedsFullFont(text)) {
+            return GetFontForSize(size);
+        }
+
+        if (fullFontState == FULL_FONT_UNUSED) {
+            LoadFullFont();
+        }
+        if (fullFontState != FULL_FONT_READY) {
+            // drawn with the embedded font until the full one is read
+            return GetFontForSize(size);
+        }
+
+        if (fullFontMap.contains(size)) {
+            return fullFontMap[size];
+        }
+
+        FC_Font *font = LoadFontAtSize(fullFontData.data(), fullFontData.size(), size);
+        if (!font) {
+            return GetFontForSize(size);
+        }
+        fullFontMap.insert({size, font});
+        return font;
+    }
+
+    int GetIconBucket(int size) {
+        for (int i = 0; i < ICON_BUCKET_COUNT - 1; i++) {
+            if (size <= ICON_BUCKET_SIZES[i]) {
+                return i;
+            }
+        }
+        return ICON_BUCKET_COUNT - 1;
+    }
+
+    bool AllocateIconRect(int w, int h, int &page, SDL_Rect &rect) {
+        int paddedW = w + ICON_PADDING;
+        int paddedH = h + ICON_PADDING;
+        if (paddedW > ICON_ATLAS_SIZE || paddedH > ICON_ATLAS_SIZE) {
+            return false;
+        }
+
+        for (size_t i = 0; i <= iconPages.size(); i++) {
+            if (i == iconPages.size()) {
+                IconAtlasPage newPage;
+                newPage.texture = TextureRegistry::Create(TextureRegistry::CATEGORY_ICON, renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ICON_ATLAS_SIZE, ICON_ATLAS_SIZE);
+                if (!newPage.texture) {
+                    return false;
+                }
+                // the padding between icons has to be transparent too
+                std::vector<Uint32> clearPixels(ICON_ATLAS_SIZE * ICON_ATLAS_SIZE, 0);
+                SDL_UpdateTexture(newPage.texture, nullptr, clearPixels.data(), ICON_ATLAS_SIZE * 4);
+                SDL_SetTextureBlendMode(newPage.texture, SDL_BLENDMODE_BLEND);
+                iconPages.push_back(newPage);
+            }
+
+            // shelf packing: fill a row left to right, then start a new row below the tallest icon
+            IconAtlasPage &atlas = iconPages[i];
+            if (atlas.shelfX + paddedW > ICON_ATLAS_SIZE) {
+                atlas.shelfY += atlas.shelfHeight;
+                atlas.shelfX      = 0;
+                atlas.shelfHeight = 0;
+            }
+            if (atlas.shelfY + paddedH > ICON_ATLAS_SIZE) {
+                continue;
+            }
+
+            rect = {atlas.shelfX, atlas.shelfY, w, h};
+            page = (int) i;
+            atlas.shelfX += paddedW;
+            atlas.shelfHeight = std::max(atlas.shelfHeight, paddedH);
+            return true;
+        }
+        return false;
+    }
+
+    const IconEntry *LoadIcon(Uint16 icon, int size) {
+        if (icon < FIRST_ICON) {
+            return nullptr;
+        }
+
+        int bucket = GetIconBucket(size);
+        if (iconTable.empty()) {
+            iconTable.resize((0x10000 - FIRST_ICON) * ICON_BUCKET_COUNT);
+        }
+        IconEntry &entry = iconTable[(icon - FIRST_ICON) * ICON_BUCKET_COUNT + bucket];
+        if (entry.page >= 0) {
+            return &entry;
+        } else if (entry.page == -2 || !iconFonts[bucket]) {
+            return nullptr;
+        }
+
+        // don't retry icons that can't be rendered every frame
+        entry.page = -2;
+
+        SDL_Surface *iconSurface = TTF_RenderGlyph_Blended(iconFonts[bucket], icon, Gfx::COLOR_WHITE);
         if (!iconSurface) {
             return nullptr;
         }
 
-        SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, iconSurface);
+        if (iconSurface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+            SDL_Surface *converted = SDL_ConvertSurfaceFormat(iconSurface, SDL_PIXELFORMAT_ARGB8888, 0);
+            SDL_FreeSurface(iconSurface);
+            iconSurface = converted;
+            if (!iconSurface) {
+                return nullptr;
+            }
+        }
+
+        int page;
+        SDL_Rect rect;
+        if (!AllocateIconRect(iconSurface->w, iconSurface->h, page, rect)) {
+            SDL_FreeSurface(iconSurface);
+            return nullptr;
+        }
+
+        SDL_UpdateTexture(iconPages[page].texture, &rect, iconSurface->pixels, iconSurface->pitch);
         SDL_FreeSurface(iconSurface);
+
+        entry.page = (Sint16) page;
+        entry.x    = rect.x;
+        entry.y    = rect.y;
+        entry.w    = rect.w;
+        entry.h    = rect.h;
+        return &entry;
+    }
+
+    void FlushBatch() {
+        if (batch.indices.empty()) {
+            return;
+        }
+
+        if (!batch.texture) {
+            SDL_SetRenderDrawBlendMode(renderer, batch.blendMode);
+        }
+
+        // SDL2 only uses the vertex colors here, texture color and alpha mods are not applied
+        SDL_RenderGeometry(renderer, batch.texture, batch.vertices.data(), (int) batch.vertices.size(),
+                           batch.indices.data(), (int) batch.indices.size());
+        drawCalls++;
+
+        batch.vertices.clear();
+        batch.indices.clear();
+    }
+
+    // angle rotates the quad clockwise around its center (degrees), like SDL_RenderCopyEx
+    void BatchQuad(SDL_Texture *texture, const SDL_Rect *src, const SDL_FRect &dst, SDL_Color color, double angle = 0.0) {
+        SDL_BlendMode blendMode = SDL_BLENDMODE_NONE;
+        if (texture) {
+            SDL_GetTextureBlendMode(texture, &blendMode);
+        } else {
+            blendMode = drawBlendMode;
+        }
+
+        if (batch.texture != texture || batch.blendMode != blendMode) {
+            FlushBatch();
+            batch.texture   = texture;
+            batch.blendMode = blendMode;
+        }
+
+        float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+        if (texture && src) {
+            int w, h;
+            SDL_QueryTexture(texture, nullptr, nullptr, &w, &h);
+            u0 = src->x / (float) w;
+            v0 = src->y / (float) h;
+            u1 = (src->x + src->w) / (float) w;
+            v1 = (src->y + src->h) / (float) h;
+        }
+
+        SDL_FPoint corners[4] = {
+            {dst.x, dst.y},
+            {dst.x + dst.w, dst.y},
+            {dst.x + dst.w, dst.y + dst.h},
+            {dst.x, dst.y + dst.h},
+        };
+        if (angle != 0.0) {
+            float radians = (float) (angle * M_PI / 180.0);
+            float c       = std::cos(radians);
+            float s       = std::sin(radians);
+            float cx      = dst.x + dst.w * 0.5f;
+            float cy      = dst.y + dst.h * 0.5f;
+            for (SDL_FPoint &corner : corners) {
+                float dx = corner.x - cx;
+                float dy = corner.y - cy;
+                corner   = {cx + dx * c - dy * s, cy + dx * s + dy * c};
+            }
+        }
+
+        int base = (int) batch.vertices.size();
+        batch.vertices.push_back({corners[0], color, {u0, v0}});
+        batch.vertices.push_back({corners[1], color, {u1, v0}});
+        batch.vertices.push_back({corners[2], color, {u1, v1}});
+        batch.vertices.push_back({corners[3], color, {u0, v1}});
+
+        const int quadIndices[] = {0, 1, 2, 0, 2, 3};
+        for (int index : quadIndices) {
+            batch.indices.push_back(base + index);
+        }
+    }
+
+    void BeginUntextured() {
+        if (batch.texture || batch.blendMode != drawBlendMode) {
+            FlushBatch();
+            batch.texture   = nullptr;
+            batch.blendMode = drawBlendMode;
+        }
+    }
+
+    // Untextured triangles given as positions, indices are relative to the first position
+    void BatchTriangles(const SDL_FPoint *points, int numPoints, const int *indices, int numIndices, SDL_Color color) {
+        BeginUntextured();
+
+        int base = (int) batch.vertices.size();
+        for (int i = 0; i < numPoints; i++) {
+            batch.vertices.push_back({points[i], color, {0.0f, 0.0f}});
+        }
+        for (int i = 0; i < numIndices; i++) {
+            batch.indices.push_back(base + indices[i]);
+        }
+    }
+
+    // Same with a color per vertex, the GPU interpolates between them
+    void BatchColoredTriangles(const SDL_Vertex *vertices, int numVertices, const int *indices, int numIndices) {
+        BeginUntextured();
+
+        int base = (int) batch.vertices.size();
+        batch.vertices.insert(batch.vertices.end(), vertices, vertices + numVertices);
+        for (int i = 0; i < numIndices; i++) {
+            batch.indices.push_back(base + indices[i]);
+        }
+    }
+
+    void BatchRect(int x, int y, int w, int h, SDL_Color color) {
+        if (w <= 0 || h <= 0) {
+            return;
+        }
+        BatchQuad(nullptr, nullptr, SDL_FRect{(float) x, (float) y, (float) w, (float) h}, color);
+    }
+
+    // Draws with the texture's current color and alpha mod, like SDL_RenderCopy
+    void BatchCopy(SDL_Texture *texture, const SDL_Rect *src, const SDL_FRect &dst) {
+        SDL_Color color;
+        SDL_GetTextureColorMod(texture, &color.r, &color.g, &color.b);
+        SDL_GetTextureAlphaMod(texture, &color.a);
+        BatchQuad(texture, src, dst, color);
+    }
+
+    // SDL_FontCache glyphs go into the batch instead of one SDL_RenderCopyEx each
+    FC_Rect BatchRenderCallback(FC_Image *src, FC_Rect *srcrect, FC_Target *dest, float x, float y, float xscale, float yscale) {
+        FC_Rect result{(int) x, (int) y, (int) (srcrect->w * xscale), (int) (srcrect->h * yscale)};
+        if (xscale < 0 || yscale < 0) {
+            // flipped glyphs are left to SDL_FontCache
+            FlushBatch();
+            return FC_DefaultRenderCallback(src, srcrect, dest, x, y, xscale, yscale);
+        }
+
+        BatchCopy(src, srcrect, SDL_FRect{(float) result.x, (float) result.y, (float) result.w, (float) result.h});
+        return result;
+    }
+
+    // Quarter circle from 0 to 90 degrees, shared by all rounded rects
+    constexpr int CORNER_SEGMENTS = 16;
+
+    struct CornerTable {
+        float cos[CORNER_SEGMENTS + 1];
+        float sin[CORNER_SEGMENTS + 1];
+
+        CornerTable() {
+            for (int i = 0; i <= CORNER_SEGMENTS; i++) {
+                float angle = (float) M_PI / 2.0f * i / CORNER_SEGMENTS;
+                cos[i]      = cosf(angle);
+                sin[i]      = sinf(angle);
+            }
+        }
+    };
+
+    const CornerTable cornerTable;
+
+    // Triangle fan around the center: 4 corners, each with CORNER_SEGMENTS / step + 1 points
+    void BatchRoundedRect(float x, float y, float w, float h, float radius, SDL_Color color) {
+        // small corners don't need every point of the table
+        int step            = radius >= 12 ? 1 : (radius >= 6 ? 2 : 4);
+        int pointsPerCorner = CORNER_SEGMENTS / step + 1;
+        int numPoints       = 1 + 4 * pointsPerCorner;
+
+        SDL_FPoint points[1 + 4 * (CORNER_SEGMENTS + 1)];
+        int indices[3 * 4 * (CORNER_SEGMENTS + 1)];
+
+        points[0] = {x + w / 2.0f, y + h / 2.0f};
+
+        // corner centers and directions, clockwise starting at the top right
+        const float centerX[4] = {x + w - radius, x + w - radius, x + radius, x + radius};
+        const float centerY[4] = {y + radius, y + h - radius, y + h - radius, y + radius};
+        int n = 1;
+        for (int corner = 0; corner < 4; corner++) {
+            for (int i = 0; i <= CORNER_SEGMENTS; i += step) {
+                // each corner walks its quarter circle clockwise
+                float c = cornerTable.cos[i], s = cornerTable.sin[i];
+                float dx, dy;
+                switch (corner) {
+                    case 0: dx = s, dy = -c; break;
+                    case 1: dx = c, dy = s; break;
+                    case 2: dx = -s, dy = c; break;
+                    default: dx = -c, dy = -s; break;
+                }
+                points[n++] = {centerX[corner] + dx * radius, centerY[corner] + dy * radius};
+            }
+        }
+
+        int numIndices = 0;
+        for (int i = 1; i < numPoints; i++) {
+            indices[numIndices++] = 0;
+            indices[numIndices++] = i;
+            indices[numIndices++] = i + 1 < numPoints ? i + 1 : 1;
+        }
+
+        BatchTriangles(points, numPoints, indices, numIndices, color);
+    }
+
+    const TextLayout &GetTextLayout(FC_Font *font, std::string_view text) {
+        LayoutMap &layouts = layoutCache[font];
+        auto it            = layouts.find(text);
+        if (it != layouts.end()) {
+            return it->second;
+        }
+
+        if (layouts.size() >= MAX_LAYOUTS_PER_FONT) {
+            layouts.clear();
+        }
+
+        it = layouts.emplace(std::string(text), TextLayout{}).first;
+        TextLayout &layout = it->second;
+
+        float letterSpacing = FC_GetSpacing(font);
+        float lineX         = 0.0f;
+        int lineWidth       = 0;
+        int line            = 0;
+
+        // decode from the stored key, FC_GetCodepointFromUTF8 expects a terminated string
+        for (const char *c = it->first.c_str(); *c != '\0'; c++) {
+            if (*c == '\n') {
+                layout.lineWidths.push_back(lineWidth);
+                lineX     = 0.0f;
+                lineWidth = 0;
+                line++;
+                continue;
+            }
+
+            FC_GlyphData glyph;
+            Uint32 codepoint = FC_GetCodepointFromUTF8(&c, 1);
+            if (!FC_GetGlyphData(font, &glyph, codepoint)) {
+                codepoint = ' ';
+                if (!FC_GetGlyphData(font, &glyph, codepoint)) {
+                    continue;
+                }
+            }
+
+            if (codepoint != ' ') {
+                layout.quads.push_back({glyph.cache_level, {glyph.rect.x, glyph.rect.y, glyph.rect.w, glyph.rect.h}, lineX, line});
+            }
+
+            lineX += glyph.rect.w + letterSpacing;
+            lineWidth += glyph.rect.w;
+        }
+        layout.lineWidths.push_back(lineWidth);
+
+        for (int w : layout.lineWidths) {
+            layout.width = std::max(layout.width, w);
+        }
+
+        return layout;
+    }
+
+    float GetGlyphAdvance(FC_Font *font, Uint32 codepoint, float letterSpacing, int *width = nullptr) {
+        FC_GlyphData glyph;
+        if (!FC_GetGlyphData(font, &glyph, codepoint) && !FC_GetGlyphData(font, &glyph, ' ')) {
+            if (width) {
+                *width = 0;
+            }
+            return 0.0f;
+        }
+        if (width) {
+            *width = glyph.rect.w;
+        }
+        return glyph.rect.w + letterSpacing;
+    }
+
+    // Lines may break after spaces and ASCII punctuation; text without any (CJK) breaks between characters.
+    // Returns the cached text together with its lines, which refer to that copy.
+    const WrapMap::value_type &GetWrappedLines(FC_Font *font, std::string_view text, int maxWidth) {
+        WrapMap &wraps = wrapCache[{font, maxWidth}];
+        auto it        = wraps.find(text);
+        if (it != wraps.end()) {
+            return *it;
+        }
+
+        if (wraps.size() >= MAX_LAYOUTS_PER_FONT) {
+            wraps.clear();
+        }
+
+        it = wraps.emplace(std::string(text), std::vector<WrappedLine>{}).first;
+        std::vector<WrappedLine> &lines = it->second;
+        const char *base                = it->first.c_str();
+
+        float letterSpacing = FC_GetSpacing(font);
+        uint32_t lineStart  = 0;
+        uint32_t breakPos   = 0; // 0 = no break opportunity on this line yet
+        float lineX         = 0.0f;
+
+        for (const char *c = base; *c != '\0'; c++) {
+            uint32_t charStart = c - base;
+            if (*c == '\n') {
+                lines.push_back({lineStart, charStart - lineStart});
+                lineStart = charStart + 1;
+                breakPos  = 0;
+                lineX     = 0.0f;
+                continue;
+            }
+
+            Uint32 codepoint = FC_GetCodepointFromUTF8(&c, 1);
+            int glyphWidth;
+            float advance = GetGlyphAdvance(font, codepoint, letterSpacing, &glyphWidth);
+
+            if (lineX > 0.0f && lineX + glyphWidth > maxWidth && codepoint != ' ') {
+                uint32_t cut = breakPos > lineStart ? breakPos : charStart;
+                lines.push_back({lineStart, cut - lineStart});
+                lineStart = cut;
+                while (base[lineStart] == ' ') {
+                    lineStart++;
+                }
+                breakPos = 0;
+
+                // the characters carried over to the new line
+                lineX = 0.0f;
+                for (const char *p = base + lineStart; p < base + charStart; p++) {
+                    lineX += GetGlyphAdvance(font, FC_GetCodepointFromUTF8(&p, 1), letterSpacing);
+                }
+            }
+
+            lineX += advance;
+            if (codepoint < 0x80 && strchr(" \t,;.!?-", (char) codepoint)) {
+                breakPos = (c + 1) - base;
+            }
+        }
+
+        uint32_t end = it->first.size();
+        if (end > lineStart || lines.empty()) {
+            lines.push_back({lineStart, end - lineStart});
+        }
+
+        return *it;
+    }
+
+    StaticAlign GetStaticAlign(Gfx::AlignFlags align) {
+        if (align & Gfx::ALIGN_LEFT) {
+            return STATIC_LEFT;
+        } else if (align & Gfx::ALIGN_RIGHT) {
+            return STATIC_RIGHT;
+        } else if (align & Gfx::ALIGN_HORIZONTAL) {
+            return STATIC_CENTER;
+        }
+        return STATIC_LEFT;
+    }
+
+    void EvictStaticText(size_t neededPixels) {
+        while (staticTextPixels + neededPixels > MAX_STATIC_TEXT_PIXELS) {
+            StaticTextMap *oldestMap = nullptr;
+            StaticTextMap::iterator oldest;
+            for (auto &[key, texts] : staticTextCache) {
+                for (auto it = texts.begin(); it != texts.end(); ++it) {
+                    if (!oldestMap || it->second.lastUse < oldest->second.lastUse) {
+                        oldestMap = &texts;
+                        oldest    = it;
+                    }
+                }
+            }
+
+            if (!oldestMap) {
+                return;
+            }
+
+            staticTextPixels -= (size_t) oldest->second.width * oldest->second.height;
+            TextureRegistry::Destroy(oldest->second.texture);
+            oldestMap->erase(oldest);
+        }
+    }
+
+    const StaticText *GetStaticText(FC_Font *font, StaticAlign align, std::string_view text) {
+        StaticTextMap &texts = staticTextCache[{font, align}];
+        auto it              = texts.find(text);
+        if (it != texts.end()) {
+            it->second.lastUse = ++staticTextUseCounter;
+            return &it->second;
+        }
+
+        const TextLayout &layout = GetTextLayout(font, text);
+
+        // same line offsets as FC_DrawEffect: left aligned lines also add the line spacing
+        int lineHeight = FC_GetLineHeight(font);
+        int lineStep   = lineHeight + (align == STATIC_LEFT ? FC_GetLineSpacing(font) : 0);
+        int width      = layout.width;
+        int height     = lineStep * ((int) layout.lineWidths.size() - 1) + lineHeight;
+        if (width <= 0 || height <= 0) {
+            return nullptr;
+        }
+
+        EvictStaticText((size_t) width * height);
+
+        SDL_Texture *texture = TextureRegistry::Create(TextureRegistry::CATEGORY_GLYPH, renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
         if (!texture) {
             return nullptr;
         }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
 
-        iconCache.insert({icon, texture});
-        return texture;
+        // the glyph caches change blend mode and the render target switches below
+        FlushBatch();
+
+        SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
+        if (SDL_SetRenderTarget(renderer, texture) != 0) {
+            TextureRegistry::Destroy(texture);
+            return nullptr;
+        }
+        SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0x00);
+        SDL_RenderClear(renderer);
+
+        // copy the glyphs as they are (white + coverage), color and alpha are applied when drawing the texture
+        int numLevels = FC_GetNumCacheLevels(font);
+        for (int i = 0; i < numLevels; i++) {
+            FC_Image *cache = FC_GetGlyphCacheLevel(font, i);
+            SDL_SetTextureBlendMode(cache, SDL_BLENDMODE_NONE);
+            SDL_SetTextureColorMod(cache, 0xff, 0xff, 0xff);
+            SDL_SetTextureAlphaMod(cache, 0xff);
+        }
+
+        for (const GlyphQuad &quad : layout.quads) {
+            int lineX = 0;
+            if (align == STATIC_RIGHT) {
+                lineX = width - layout.lineWidths[quad.line];
+            } else if (align == STATIC_CENTER) {
+                lineX = (width - layout.lineWidths[quad.line]) / 2;
+            }
+
+            // one geometry submission per glyph cache level instead of one copy per glyph
+            SDL_FRect dst{(float) (lineX + (int) quad.x), (float) (quad.line * lineStep), (float) quad.src.w, (float) quad.src.h};
+            BatchQuad(FC_GetGlyphCacheLevel(font, quad.cacheLevel), &quad.src, dst, Gfx::COLOR_WHITE);
+        }
+        FlushBatch();
+
+        for (int i = 0; i < numLevels; i++) {
+            SDL_SetTextureBlendMode(FC_GetGlyphCacheLevel(font, i), SDL_BLENDMODE_BLEND);
+        }
+
+        SDL_SetRenderTarget(renderer, previousTarget);
+
+        StaticText &staticText = texts.emplace(std::string(text), StaticText{}).first->second;
+        staticText.texture     = texture;
+        staticText.width       = width;
+        staticText.height      = height;
+        staticText.lastUse     = ++staticTextUseCounter;
+        staticTextPixels += (size_t) width * height;
+        return &staticText;
     }
 
 } // namespace
@@ -98,36 +874,52 @@ namespace Gfx {
 
         TTF_Init();
 
-        monospaceFont = FC_CreateFont();
-        if (!monospaceFont) {
-            return false;
-        }
+        fontProbe = TTF_OpenFontRW(SDL_RWFromMem(fontData, fontSize), 1, 16);
 
-        if (!FC_LoadFont_RW(monospaceFont, renderer, SDL_RWFromMem((void *) ter_u32b_bdf, ter_u32b_bdf_size), 1, 32, Gfx::COLOR_BLACK, TTF_STYLE_NORMAL)) {
-            FC_FreeFont(monospaceFont);
-            return false;
-        }
+        FC_SetRenderCallback(BatchRenderCallback);
 
-        // icons @256 should be large enough for our needs
-        iconFont = TTF_OpenFontRW(SDL_RWFromMem((void *) fa_solid_900_ttf, fa_solid_900_ttf_size), 1, 256);
-        if (!iconFont) {
-            return false;
+        for (int i = 0; i < ICON_BUCKET_COUNT; i++) {
+            iconFonts[i] = TTF_OpenFontRW(SDL_RWFromMem((void *) fa_solid_900_ttf, fa_solid_900_ttf_size), 1, ICON_BUCKET_SIZES[i]);
+            if (!iconFonts[i]) {
+                return false;
+            }
         }
 
         return true;
     }
 
     void Shutdown() {
+        FlushBatch();
+        ClearStaticText();
+        layoutCache.clear();
+
         for (const auto &[key, value] : fontMap) {
             FC_FreeFont(value);
         }
+        for (const auto &[key, value] : fullFontMap) {
+            FC_FreeFont(value);
+        }
+        fullFontMap.clear();
+        fullFontData.clear();
+        if (fontProbe) {
+            TTF_CloseFont(fontProbe);
+            fontProbe = nullptr;
+        }
 
-        for (const auto &[key, value] : iconCache) {
-            SDL_DestroyTexture(value);
+        for (const IconAtlasPage &page : iconPages) {
+            TextureRegistry::Destroy(page.texture);
         }
+        iconPages.clear();
+        iconTable.clear();
 
-        FC_FreeFont(monospaceFont);
-        TTF_CloseFont(iconFont);
+        if (monospaceFont) {
+            FC_FreeFont(monospaceFont);
+            monospaceFont = nullptr;
+        }
+        monospaceData.reset();
+        for (TTF_Font *iconFont : iconFonts) {
+            TTF_CloseFont(iconFont);
+        }
         TTF_Quit();
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
@@ -135,15 +927,31 @@ namespace Gfx {
     }
 
     void Clear(SDL_Color color) {
+        FlushBatch();
         SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
         SDL_RenderClear(renderer);
     }
 
     void Render() {
+        FlushBatch();
         SDL_RenderPresent(renderer);
+        lastFrameDrawCalls = drawCalls;
+        drawCalls = 0;
+        Animation::NextFrame();
     }
-    
+
+    int GetDrawCallCount() {
+        return lastFrameDrawCalls;
+    }
+
+    int GetFrameDrawCallCount() {
+        FlushBatch();
+        return drawCalls;
+    }
+
     SDL_Renderer* GetRenderer() {
+        // the caller draws with SDL directly, everything queued so far has to come first
+        FlushBatch();
         return renderer;
     }
     
@@ -155,11 +963,68 @@ namespace Gfx {
         return globalAlpha;
     }
 
+    void PrewarmGlyphs(std::string_view text) {
+        // printable ASCII is always needed for names, numbers and paths
+        std::vector<bool> seen(0x80, false);
+        std::vector<Uint32> codepoints;
+        for (Uint32 c = 0x20; c < 0x7f; c++) {
+            seen[c] = true;
+            codepoints.push_back(c);
+        }
+
+        std::string terminated(text);
+        for (const char *c = terminated.c_str(); *c != '\0'; c++) {
+            Uint32 codepoint = FC_GetCodepointFromUTF8(&c, 1);
+            if (codepoint < 0x20) {
+                continue;
+            }
+            if (codepoint >= seen.size()) {
+                seen.resize(codepoint + 1, false);
+            }
+            if (!seen[codepoint]) {
+                seen[codepoint] = true;
+                codepoints.push_back(codepoint);
+            }
+        }
+
+        prewarm.codepoints = std::move(codepoints);
+        prewarm.sizes.assign(std::begin(PREWARM_SIZES), std::end(PREWARM_SIZES));
+        for (const auto &[size, font] : fontMap) {
+            if (std::find(prewarm.sizes.begin(), prewarm.sizes.end(), size) == prewarm.sizes.end()) {
+                prewarm.sizes.push_back(size);
+            }
+        }
+        prewarm.sizeIndex      = 0;
+        prewarm.codepointIndex = 0;
+    }
+
+    void UpdateGlyphPrewarm() {
+        if (!renderer || prewarm.sizeIndex >= prewarm.sizes.size()) {
+            return;
+        }
+
+        uint64_t start = OSGetSystemTime();
+        while (prewarm.sizeIndex < prewarm.sizes.size()) {
+            FC_Font *font = GetFontForSize(prewarm.sizes[prewarm.sizeIndex]);
+            if (!font || prewarm.codepointIndex >= prewarm.codepoints.size()) {
+                prewarm.sizeIndex++;
+                prewarm.codepointIndex = 0;
+                continue;
+            }
+
+            // only rasterizes when the glyph isn't cached yet
+            FC_GetGlyphData(font, nullptr, prewarm.codepoints[prewarm.codepointIndex++]);
+
+            if (OSTicksToMicroseconds(OSGetSystemTime() - start) >= PREWARM_BUDGET_US) {
+                break;
+            }
+        }
+    }
+
     void DrawRectFilled(int x, int y, int w, int h, SDL_Color color) {
-        SDL_Rect rect{x, y, w, h};
-        Uint8 finalAlpha = (Uint8)(color.a * globalAlpha);
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, finalAlpha);
-        SDL_RenderFillRect(renderer, &rect);
+        SDL_Color finalColor = color;
+        finalColor.a = (Uint8)(color.a * globalAlpha);
+        BatchRect(x, y, w, h, finalColor);
     }
 
     void DrawRect(int x, int y, int w, int h, int borderSize, SDL_Color color) {
@@ -170,23 +1035,22 @@ namespace Gfx {
     }
 
     void DrawIcon(int x, int y, int size, SDL_Color color, Uint16 icon, AlignFlags align, double angle) {
-        SDL_Texture *iconTex = LoadIcon(icon);
-        if (!iconTex) {
+        const IconEntry *entry = LoadIcon(icon, size);
+        if (!entry) {
             return;
         }
 
-        SDL_SetTextureColorMod(iconTex, color.r, color.g, color.b);
-        Uint8 finalAlpha = (Uint8)(color.a * globalAlpha);
-        SDL_SetTextureAlphaMod(iconTex, finalAlpha);
+        SDL_Texture *iconTex = iconPages[entry->page].texture;
+        SDL_Color finalColor = color;
+        finalColor.a = (Uint8)(color.a * globalAlpha);
 
-        int w, h;
-        SDL_QueryTexture(iconTex, nullptr, nullptr, &w, &h);
+        SDL_Rect src{entry->x, entry->y, entry->w, entry->h};
 
         SDL_Rect rect;
         rect.x = x;
         rect.y = y;
         // scale the width based on hight to keep AR
-        rect.w = (int) (((float) w / h) * size);
+        rect.w = (int) (((float) entry->w / entry->h) * size);
         rect.h = size;
 
         if (align & ALIGN_RIGHT) {
@@ -201,54 +1065,143 @@ namespace Gfx {
             rect.y -= rect.h / 2;
         }
 
-        // draw the icon
-        if (angle) {
-            SDL_RenderCopyEx(renderer, iconTex, nullptr, &rect, angle, nullptr, SDL_FLIP_NONE);
-        } else {
-            SDL_RenderCopy(renderer, iconTex, nullptr, &rect);
+        // rotated icons (spinners) stay in the batch too
+        BatchQuad(iconTex, &src, SDL_FRect{(float) rect.x, (float) rect.y, (float) rect.w, (float) rect.h}, finalColor, angle);
+    }
+
+    SDL_Texture *CaptureScreen(const std::function<void()> &draw) {
+        SDL_Texture *texture = TextureRegistry::Create(TextureRegistry::CATEGORY_TARGET, renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (!texture) {
+            return nullptr;
+        }
+        // the captured screen is opaque, drawing it back does not need blending
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+
+        // submit what is batched for the current target before switching
+        FlushBatch();
+
+        SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
+        if (SDL_SetRenderTarget(renderer, texture) != 0) {
+            TextureRegistry::Destroy(texture);
+            return nullptr;
         }
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xff);
+        SDL_RenderClear(renderer);
+
+        draw();
+
+        FlushBatch();
+        SDL_SetRenderTarget(renderer, previousTarget);
+        return texture;
     }
 
-    int GetIconWidth(int size, Uint16 icon) {
-        SDL_Texture *iconTex = LoadIcon(icon);
-        if (!iconTex) {
-            return 0;
+    bool RenderToTexture(SDL_Texture *target, const std::function<void()> &draw) {
+        if (!target) {
+            return false;
+        }
+        FlushBatch();
+
+        SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
+        if (SDL_SetRenderTarget(renderer, target) != 0) {
+            return false;
         }
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+        SDL_RenderClear(renderer);
 
-        int w, h;
-        SDL_QueryTexture(iconTex, nullptr, nullptr, &w, &h);
+        // the cached content is faded when it is drawn, not when it is rendered
+        float previousAlpha = globalAlpha;
+        globalAlpha = 1.0f;
+        draw();
+        globalAlpha = previousAlpha;
 
-        return (int) (((float) w / h) * size);
+        FlushBatch();
+        SDL_SetRenderTarget(renderer, previousTarget);
+        return true;
     }
 
-    void Print(int x, int y, int size, SDL_Color color, std::string text, AlignFlags align, bool monospace) {
-        FC_Font *font = monospace ? monospaceFont : GetFontForSize(size);
-        if (!font) {
+    void DrawTexture(SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect &dst) {
+        if (!texture) {
             return;
         }
+        BatchCopy(texture, src, SDL_FRect{(float) dst.x, (float) dst.y, (float) dst.w, (float) dst.h});
+    }
+
+    int GetIconWidth(int size, Uint16 icon) {
+        const IconEntry *entry = LoadIcon(icon, size);
+        if (!entry) {
+            return 0;
+        }
+
+        return (int) (((float) entry->w / entry->h) * size);
+    }
+
+    int Print(int x, int y, int size, SDL_Color color, std::string_view text, AlignFlags align, bool monospace) {
+        FC_Font *font = monospace ? GetMonospaceFont() : GetFontForText(size, text);
+        if (!font || text.empty()) {
+            return 0;
+        }
 
-        FC_Effect effect;
-        effect.color = color;
-        effect.color.a = (Uint8)(color.a * globalAlpha);  // Apply global alpha
+        SDL_Color finalColor = color;
+        finalColor.a = (Uint8)(color.a * globalAlpha);  // Apply global alpha
 
         // scale monospace font based on size
+        float scale = 1.0f;
         if (monospace) {
-            effect.scale = FC_MakeScale(size / 28.0f, size / 28.0f);
+            scale = size / 28.0f;
             // TODO figure out how to center this properly
             y += 5;
-        } else {
-            effect.scale = FC_MakeScale(1, 1);
         }
 
+        if (align & ALIGN_BOTTOM) {
+            y -= GetTextHeight(size, text, monospace);
+        } else if (align & ALIGN_VERTICAL) {
+            y -= GetTextHeight(size, text, monospace) / 2;
+        }
+
+        const TextLayout &layout = GetTextLayout(font, text);
+
+        // same line offsets as FC_DrawEffect: left aligned lines also add the line spacing
+        float lineStep   = FC_GetLineHeight(font) * scale;
+        float lineFactor = 0.0f;  // part of each line's width to move left
         if (align & ALIGN_LEFT) {
-            effect.alignment = FC_ALIGN_LEFT;
+            lineStep += FC_GetLineSpacing(font) * scale;
         } else if (align & ALIGN_RIGHT) {
-            effect.alignment = FC_ALIGN_RIGHT;
+            lineFactor = 1.0f;
         } else if (align & ALIGN_HORIZONTAL) {
-            effect.alignment = FC_ALIGN_CENTER;
+            lineFactor = 0.5f;
         } else {
             // left by default
-            effect.alignment = FC_ALIGN_LEFT;
+            lineStep += FC_GetLineSpacing(font) * scale;
+        }
+
+        FC_Image *cache = nullptr;
+        int cacheLevel  = -1;
+        for (const GlyphQuad &quad : layout.quads) {
+            if (quad.cacheLevel != cacheLevel) {
+                cacheLevel = quad.cacheLevel;
+                cache      = FC_GetGlyphCacheLevel(font, cacheLevel);
+            }
+
+            float lineX = x - layout.lineWidths[quad.line] * scale * lineFactor;
+            SDL_FRect dst{(float) (int) (lineX + quad.x * scale), (float) (int) (y + quad.line * lineStep),
+                          (float) (int) (quad.src.w * scale), (float) (int) (quad.src.h * scale)};
+            BatchQuad(cache, &quad.src, dst, finalColor);
+        }
+        return (int) (layout.width * scale);
+    }
+
+    int PrintStatic(int x, int y, int size, SDL_Color color, std::string_view text, AlignFlags align, bool monospace) {
+        FC_Font *font = monospace ? GetMonospaceFont() : GetFontForText(size, text);
+        if (!font || text.empty()) {
+            return 0;
+        }
+
+        // scale monospace font based on size
+        float scale = 1.0f;
+        if (monospace) {
+            scale = size / 28.0f;
+            // TODO figure out how to center this properly
+            y += 5;
         }
 
         if (align & ALIGN_BOTTOM) {
@@ -257,70 +1210,180 @@ namespace Gfx {
             y -= GetTextHeight(size, text, monospace) / 2;
         }
 
-        FC_DrawEffect(font, renderer, x, y, effect, "%s", text.c_str());
+        StaticAlign staticAlign      = GetStaticAlign(align);
+        const StaticText *staticText = GetStaticText(font, staticAlign, text);
+        if (!staticText) {
+            return 0;
+        }
+
+        SDL_Color finalColor = color;
+        finalColor.a = (Uint8)(color.a * globalAlpha);  // Apply global alpha
+
+        SDL_Rect dst{x, y, (int) (staticText->width * scale), (int) (staticText->height * scale)};
+        if (staticAlign == STATIC_RIGHT) {
+            dst.x -= dst.w;
+        } else if (staticAlign == STATIC_CENTER) {
+            dst.x -= dst.w / 2;
+        }
+        BatchQuad(staticText->texture, nullptr, SDL_FRect{(float) dst.x, (float) dst.y, (float) dst.w, (float) dst.h}, finalColor);
+        return dst.w;
+    }
+
+    void ClearStaticText() {
+        FlushBatch();
+        for (auto &[key, texts] : staticTextCache) {
+            for (auto &[text, staticText] : texts) {
+                TextureRegistry::Destroy(staticText.texture);
+            }
+        }
+        staticTextCache.clear();
+        staticTextPixels = 0;
+        wrapCache.clear();
     }
 
-    int GetTextWidth(int size, std::string text, bool monospace) {
-        FC_Font *font = monospace ? monospaceFont : GetFontForSize(size);
-        if (!font) {
+    size_t ReleaseTextCaches() {
+        size_t bytes = staticTextPixels * 4;
+        ClearStaticText();
+        layoutCache.clear();
+        return bytes;
+    }
+
+    int PrintWrapped(int x, int y, int size, SDL_Color color, std::string_view text, int maxWidth, int lineHeight, int maxLines, AlignFlags align) {
+        FC_Font *font = GetFontForText(size, text);
+        if (!font || text.empty()) {
+            return 0;
+        }
+
+        const auto &[source, lines] = GetWrappedLines(font, text, maxWidth);
+
+        int count = (int) lines.size();
+        if (maxLines > 0) {
+            count = std::min(count, maxLines);
+        }
+        for (int i = 0; i < count; i++) {
+            Print(x, y + i * lineHeight, size, color, std::string_view(source).substr(lines[i].start, lines[i].length), align);
+        }
+        return count;
+    }
+
+    int GetWrappedLineCount(int size, std::string_view text, int maxWidth) {
+        FC_Font *font = GetFontForText(size, text);
+        if (!font || text.empty()) {
+            return 0;
+        }
+        return (int) GetWrappedLines(font, text, maxWidth).second.size();
+    }
+
+    void LayoutParagraph(Paragraph &paragraph, int size, std::string_view text, int maxWidth, int maxLines) {
+        if (paragraph.size == size && paragraph.maxWidth == maxWidth && paragraph.maxLines == maxLines && paragraph.text == text) {
+            return;
+        }
+        paragraph.text     = std::string(text);
+        paragraph.size     = size;
+        paragraph.maxWidth = maxWidth;
+        paragraph.maxLines = maxLines;
+        paragraph.lines.clear();
+
+        FC_Font *font = GetFontForText(size, text);
+        if (!font || text.empty()) {
+            return;
+        }
+
+        const auto &[source, lines] = GetWrappedLines(font, text, maxWidth);
+        size_t count = lines.size();
+        if (maxLines > 0) {
+            count = std::min(count, (size_t) maxLines);
+        }
+        paragraph.lines.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            paragraph.lines.emplace_back(source, lines[i].start, lines[i].length);
+        }
+
+        if (count < lines.size()) {
+            // drop whole UTF-8 characters from the end of the last line until the ellipsis fits
+            std::string &last = paragraph.lines.back();
+            while (!last.empty()) {
+                std::string candidate = last + "...";
+                if (FC_GetWidthN(font, candidate.data(), candidate.size()) <= maxWidth) {
+                    break;
+                }
+                size_t end = last.size() - 1;
+                while (end > 0 && (last[end] & 0xC0) == 0x80) {
+                    end--;
+                }
+                last.erase(end);
+            }
+            while (!last.empty() && last.back() == ' ') {
+                last.pop_back();
+            }
+            last += "...";
+        }
+    }
+
+    int DrawParagraph(int x, int y, SDL_Color color, const Paragraph &paragraph, int lineHeight, AlignFlags align) {
+        for (size_t i = 0; i < paragraph.lines.size(); i++) {
+            PrintStatic(x, y + (int) i * lineHeight, paragraph.size, color, paragraph.lines[i], align);
+        }
+        return (int) paragraph.lines.size();
+    }
+
+    int GetTextWidth(int size, std::string_view text, bool monospace) {
+        FC_Font *font = monospace ? GetMonospaceFont() : GetFontForText(size, text);
+        if (!font || text.empty()) {
             return 0;
         }
 
         float scale = monospace ? (size / 28.0f) : 1.0f;
 
-        return FC_GetWidth(font, "%s", text.c_str()) * scale;
+        // measuring alone doesn't build (and cache) a layout, text that is drawn has one already
+        auto layouts = layoutCache.find(font);
+        if (layouts != layoutCache.end()) {
+            auto it = layouts->second.find(text);
+            if (it != layouts->second.end()) {
+                return it->second.width * scale;
+            }
+        }
+        return FC_GetWidthN(font, text.data(), text.size()) * scale;
     }
 
-    int GetTextHeight(int size, std::string text, bool monospace) {
+    int GetTextHeight(int size, std::string_view text, bool monospace) {
         // TODO this doesn't work nicely with monospace yet
         monospace = false;
 
-        FC_Font *font = monospace ? monospaceFont : GetFontForSize(size);
+        FC_Font *font = monospace ? GetMonospaceFont() : GetFontForText(size, text);
         if (!font) {
             return 0;
         }
 
         float scale = monospace ? (size / 28.0f) : 1.0f;
 
-        return FC_GetHeight(GetFontForSize(size), "%s", text.c_str()) * scale;
+        // only depends on the number of lines, same as FC_GetHeight
+        int numLines = 1;
+        for (char c : text) {
+            if (c == '\n') {
+                numLines++;
+            }
+        }
+
+        return (FC_GetLineHeight(font) * numLines + FC_GetLineSpacing(font) * (numLines - 1)) * scale;
     }
 
     void DrawRectRounded(int x, int y, int w, int h, int radius, SDL_Color color) {
-        Uint8 finalAlpha = (Uint8)(color.a * globalAlpha);
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, finalAlpha);
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-
-        // Draw center rectangle
-        SDL_Rect centerRect = {x + radius, y, w - 2 * radius, h};
-        SDL_RenderFillRect(renderer, &centerRect);
-
-        // Draw left and right rectangles
-        SDL_Rect leftRect = {x, y + radius, radius, h - 2 * radius};
-        SDL_RenderFillRect(renderer, &leftRect);
-        SDL_Rect rightRect = {x + w - radius, y + radius, radius, h - 2 * radius};
-        SDL_RenderFillRect(renderer, &rightRect);
-
-        // Draw corners (approximated with filled rectangles)
-        for (int i = 0; i < radius; i++) {
-            int offset = radius - i;
-            int width = (int)(sqrt(radius * radius - offset * offset) + 0.5);
-            
-            // Top-left
-            SDL_Rect tlRect = {x + radius - width, y + i, width, 1};
-            SDL_RenderFillRect(renderer, &tlRect);
-            
-            // Top-right
-            SDL_Rect trRect = {x + w - radius, y + i, width, 1};
-            SDL_RenderFillRect(renderer, &trRect);
-            
-            // Bottom-left
-            SDL_Rect blRect = {x + radius - width, y + h - i - 1, width, 1};
-            SDL_RenderFillRect(renderer, &blRect);
-            
-            // Bottom-right
-            SDL_Rect brRect = {x + w - radius, y + h - i - 1, width, 1};
-            SDL_RenderFillRect(renderer, &brRect);
+        if (w <= 0 || h <= 0) {
+            return;
         }
+
+        SDL_Color finalColor = color;
+        finalColor.a = (Uint8)(color.a * globalAlpha);
+        drawBlendMode = SDL_BLENDMODE_BLEND;
+
+        radius = std::min(radius, std::min(w, h) / 2);
+        if (radius <= 0) {
+            BatchRect(x, y, w, h, finalColor);
+            return;
+        }
+
+        BatchRoundedRect(x, y, w, h, radius, finalColor);
     }
 
     void DrawRectRoundedOutline(int x, int y, int w, int h, int radius, int borderSize, SDL_Color color) {
@@ -336,35 +1399,60 @@ namespace Gfx {
     }
 
     void DrawGradientV(int x, int y, int w, int h, SDL_Color colorTop, SDL_Color colorBottom) {
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        
-        for (int i = 0; i < h; i++) {
-            float ratio = (float)i / (float)h;
-            SDL_Color color = {
-                (Uint8)(colorTop.r + (colorBottom.r - colorTop.r) * ratio),
-                (Uint8)(colorTop.g + (colorBottom.g - colorTop.g) * ratio),
-                (Uint8)(colorTop.b + (colorBottom.b - colorTop.b) * ratio),
-                (Uint8)((colorTop.a + (colorBottom.a - colorTop.a) * ratio) * globalAlpha)
-            };
-            
-            SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-            SDL_RenderDrawLine(renderer, x, y + i, x + w, y + i);
+        if (w < 0 || h <= 0) {
+            return;
         }
+
+        drawBlendMode = SDL_BLENDMODE_BLEND;
+
+        colorTop.a    = (Uint8)(colorTop.a * globalAlpha);
+        colorBottom.a = (Uint8)(colorBottom.a * globalAlpha);
+
+        // one quad, the colors are interpolated between the top and bottom edge
+        // (the old per-line version covered x..x+w inclusive)
+        float left = x, right = x + w + 1, top = y, bottom = y + h;
+        const SDL_Vertex vertices[4] = {
+                {{left, top}, colorTop, {0.0f, 0.0f}},
+                {{right, top}, colorTop, {0.0f, 0.0f}},
+                {{right, bottom}, colorBottom, {0.0f, 0.0f}},
+                {{left, bottom}, colorBottom, {0.0f, 0.0f}},
+        };
+        const int indices[6] = {0, 1, 2, 0, 2, 3};
+        BatchColoredTriangles(vertices, 4, indices, 6);
     }
 
     void DrawShadow(int x, int y, int w, int h, int blur) {
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        
-        // Simple rectangular shadow for performance - keep original fast version
-        for (int i = 0; i < blur; i++) {
-            int alpha = (COLOR_SHADOW.a * (blur - i)) / blur;
-            SDL_Color shadowColor = COLOR_SHADOW;
-            shadowColor.a = alpha;
-            
-            SDL_SetRenderDrawColor(renderer, shadowColor.r, shadowColor.g, shadowColor.b, shadowColor.a);
-            SDL_Rect shadowRect = {x - i, y - i, w + i * 2, h + i * 2};
-            SDL_RenderDrawRect(renderer, &shadowRect);
+        if (blur <= 0) {
+            return;
         }
+
+        drawBlendMode = SDL_BLENDMODE_BLEND;
+
+        // a ring from the rect's edge (COLOR_SHADOW) fading out to blur pixels outside it (transparent),
+        // same falloff as the old one-outline-per-pixel version
+        SDL_Color inner = COLOR_SHADOW;
+        SDL_Color outer = COLOR_SHADOW;
+        outer.a         = 0;
+
+        float x0 = x, y0 = y, x1 = x + w, y1 = y + h;
+        const SDL_Vertex vertices[8] = {
+                {{x0, y0}, inner, {0.0f, 0.0f}},
+                {{x1, y0}, inner, {0.0f, 0.0f}},
+                {{x1, y1}, inner, {0.0f, 0.0f}},
+                {{x0, y1}, inner, {0.0f, 0.0f}},
+                {{x0 - blur, y0 - blur}, outer, {0.0f, 0.0f}},
+                {{x1 + blur, y0 - blur}, outer, {0.0f, 0.0f}},
+                {{x1 + blur, y1 + blur}, outer, {0.0f, 0.0f}},
+                {{x0 - blur, y1 + blur}, outer, {0.0f, 0.0f}},
+        };
+        // two triangles per side between the inner and outer rect
+        const int indices[24] = {
+                0, 4, 5, 0, 5, 1,
+                1, 5, 6, 1, 6, 2,
+                2, 6, 7, 2, 7, 3,
+                3, 7, 4, 3, 4, 0,
+        };
+        BatchColoredTriangles(vertices, 8, indices, 24);
     }
 
 } // namespace Gfx
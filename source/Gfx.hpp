@@ -1,7 +1,10 @@
 #pragma once
 
 #include <SDL.h>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Gfx {
     constexpr uint32_t SCREEN_WIDTH  = 1920;
@@ -50,8 +53,16 @@ namespace Gfx {
 
     void Render();
     
+    // Gfx 的绘制会先攒在一起, 纹理或混合模式变化时才用一次 SDL_RenderGeometry 提交
+    // GetRenderer 会先提交攒下的内容, 所以直接用 SDL 绘制时每次都应重新调用 GetRenderer
     SDL_Renderer* GetRenderer();  // Get SDL renderer for custom operations
-    
+
+    // 上一帧的 SDL 绘制提交次数 (不含调用方通过 GetRenderer 直接绘制的部分)
+    int GetDrawCallCount();
+
+    // 这一帧到现在的提交次数 (先提交攒下的内容), 前后各取一次得到一段绘制的提交次数
+    int GetFrameDrawCallCount();
+
     void SetGlobalAlpha(float alpha);  // Set global alpha multiplier (0.0 - 1.0)
     
     float GetGlobalAlpha();  // Get current global alpha
@@ -70,13 +81,68 @@ namespace Gfx {
 
     void DrawIcon(int x, int y, int size, SDL_Color color, Uint16 icon, AlignFlags align = ALIGN_CENTER, double angle = 0.0);
 
+    // 把 draw 中的绘制渲染到一张全屏的 SDL_TEXTUREACCESS_TARGET 纹理, 用于界面切换时的静态画面
+    // 失败时返回 nullptr; 调用者负责用 TextureRegistry::Destroy 释放
+    SDL_Texture* CaptureScreen(const std::function<void()>& draw);
+
+    // 把 draw 中的绘制渲染到 target (SDL_TEXTUREACCESS_TARGET), 先清成全透明; 渲染期间全局透明度按 1 计算
+    // 用于缓存不常变化的组合内容 (列表卡片); 切换渲染目标失败时返回 false
+    bool RenderToTexture(SDL_Texture* target, const std::function<void()>& draw);
+
+    // 和 SDL_RenderCopy 相同 (使用纹理当前的颜色和透明度), 但和其他 Gfx 绘制一起提交
+    void DrawTexture(SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect& dst);
+
     int GetIconWidth(int size, Uint16 icon);
 
     static inline int GetIconHeight(int size, Uint16 icon) { return size; }
 
-    void Print(int x, int y, int size, SDL_Color color, std::string text, AlignFlags align = ALIGN_LEFT | ALIGN_TOP, bool monospace = false);
+    // 文字的字形位置按 (字体, 字号, 文本) 缓存, 每帧绘制相同的文本时不再重新解码 UTF-8 和查找字形
+    // 返回绘制的宽度 (最宽一行), 接着绘制后面的内容时不用再调用 GetTextWidth
+    int Print(int x, int y, int size, SDL_Color color, std::string_view text, AlignFlags align = ALIGN_LEFT | ALIGN_TOP, bool monospace = false);
+
+    // 和 Print 相同, 但整段文字只渲染一次到纹理, 之后每次绘制只需一次 SDL_RenderCopy
+    // 用于不会逐帧变化的文字 (标题、底栏提示、卡片上的主题名和作者); 进度、计时等变化的文字仍用 Print
+    // 返回值和 Print 相同
+    int PrintStatic(int x, int y, int size, SDL_Color color, std::string_view text, AlignFlags align = ALIGN_LEFT | ALIGN_TOP, bool monospace = false);
+
+    // 释放 PrintStatic 的所有纹理和 PrintWrapped 的断行结果, 切换语言时调用
+    void ClearStaticText();
+
+    // 内存不足时 (MemoryPressure) 调用: 除了 ClearStaticText 的内容, 还丢弃字形位置的缓存
+    // 可见的文字下一帧重新生成; 返回释放的纹理字节数
+    size_t ReleaseTextCaches();
+
+    // 按 maxWidth 自动换行后逐行绘制, 最多 maxLines 行 (0 为不限), 返回绘制的行数
+    // 断行位置按 (字号, 宽度, 文本) 缓存, 每帧绘制相同的文本时不再逐字测量
+    int PrintWrapped(int x, int y, int size, SDL_Color color, std::string_view text, int maxWidth, int lineHeight, int maxLines = 0, AlignFlags align = ALIGN_LEFT | ALIGN_TOP);
+
+    // 换行后的行数, 和 PrintWrapped 使用同一份缓存
+    int GetWrappedLineCount(int size, std::string_view text, int maxWidth);
+
+    // 排版好的段落, 由调用者保存 (例如详情页的描述), 之后每帧只绘制各行
+    struct Paragraph {
+        std::string text;                // 排版时的原文
+        int size     = 0;
+        int maxWidth = 0;
+        int maxLines = 0;
+        std::vector<std::string> lines;
+    };
+
+    // 按实际字宽和 UTF-8 字符边界换行, 超过 maxLines 行 (0 为不限) 时最后一行以 "..." 结尾
+    // 参数和上次相同时直接返回, 可以每帧调用
+    void LayoutParagraph(Paragraph &paragraph, int size, std::string_view text, int maxWidth, int maxLines = 0);
+
+    // 每行用 PrintStatic 绘制, 返回绘制的行数
+    int DrawParagraph(int x, int y, SDL_Color color, const Paragraph &paragraph, int lineHeight, AlignFlags align = ALIGN_LEFT | ALIGN_TOP);
+
+    // 预先光栅化 text 中的字符 (和所有可打印 ASCII 字符), 用于常用字号和已创建的字号
+    // 切换语言时传入语言文件的全部文本; 实际工作在 UpdateGlyphPrewarm 中每帧做一点
+    void PrewarmGlyphs(std::string_view text);
+
+    // 每次主循环调用一次, 最多占用约 2ms
+    void UpdateGlyphPrewarm();
 
-    int GetTextWidth(int size, std::string text, bool monospace = false);
+    int GetTextWidth(int size, std::string_view text, bool monospace = false);
 
-    int GetTextHeight(int size, std::string text, bool monospace = false);
+    int GetTextHeight(int size, std::string_view text, bool monospace = false);
 } // namespace Gfx
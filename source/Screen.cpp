@@ -14,21 +14,21 @@ void Screen::DrawTopBar(const char *name) {
 
     // draw top bar content - 使用UTheme
     Gfx::DrawIcon(60, 60, 60, Gfx::COLOR_ACCENT, 0xf53f, Gfx::ALIGN_VERTICAL);
-    Gfx::Print(140, 60, 56, Gfx::COLOR_TEXT, _("app_name"), Gfx::ALIGN_VERTICAL);
+    int titleWidth = Gfx::PrintStatic(140, 60, 56, Gfx::COLOR_TEXT, _("app_name"), Gfx::ALIGN_VERTICAL);
     
     // Draw version number with local mode indicator if Mocha is unavailable
-    int versionX = 140 + Gfx::GetTextWidth(56, _("app_name")) + 20;
+    int versionX = 140 + titleWidth + 20;
     std::string versionText = APP_VERSION_FULL;
     if (!MainScreen::IsMochaAvailable()) {
         versionText += " (";
         versionText += _("common.local_mode");
         versionText += ")";
     }
-    Gfx::Print(versionX, 65, 32, Gfx::COLOR_ALT_TEXT, versionText.c_str(), Gfx::ALIGN_VERTICAL);
+    Gfx::PrintStatic(versionX, 65, 32, Gfx::COLOR_ALT_TEXT, versionText.c_str(), Gfx::ALIGN_VERTICAL);
     
     // Draw page name on the right if provided
     if (name) {
-        Gfx::Print(Gfx::SCREEN_WIDTH - 60, 60, 48, Gfx::COLOR_ALT_TEXT, name, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
+        Gfx::PrintStatic(Gfx::SCREEN_WIDTH - 60, 60, 48, Gfx::COLOR_ALT_TEXT, name, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
     }
     
     // Draw accent line at bottom
@@ -47,25 +47,25 @@ void Screen::DrawAnimatedTopBar(const std::string& name, Animation& titleAnim, u
     titleColor.a = (Uint8)(255 * titleProgress);
     
     Gfx::DrawIcon(60, titleY + 40, 60, Gfx::COLOR_ACCENT, icon, Gfx::ALIGN_VERTICAL);
-    Gfx::Print(140, titleY + 40, 56, titleColor, _("app_name"), Gfx::ALIGN_VERTICAL);
+    int titleWidth = Gfx::PrintStatic(140, titleY + 40, 56, titleColor, _("app_name"), Gfx::ALIGN_VERTICAL);
     
     // Draw version number with local mode indicator if Mocha is unavailable
     SDL_Color versionColor = Gfx::COLOR_ALT_TEXT;
     versionColor.a = (Uint8)(200 * titleProgress);
-    int versionX = 140 + Gfx::GetTextWidth(56, _("app_name")) + 20;
+    int versionX = 140 + titleWidth + 20;
     std::string versionText = APP_VERSION_FULL;
     if (!MainScreen::IsMochaAvailable()) {
         versionText += " (";
         versionText += _("common.local_mode");
         versionText += ")";
     }
-    Gfx::Print(versionX, titleY + 45, 32, versionColor, versionText.c_str(), Gfx::ALIGN_VERTICAL);
+    Gfx::PrintStatic(versionX, titleY + 45, 32, versionColor, versionText.c_str(), Gfx::ALIGN_VERTICAL);
     
     // Draw page name
     if (!name.empty()) {
         SDL_Color pageColor = Gfx::COLOR_ALT_TEXT;
         pageColor.a = (Uint8)(220 * titleProgress);
-        Gfx::Print(Gfx::SCREEN_WIDTH - 60, titleY + 40, 48, pageColor, name, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
+        Gfx::PrintStatic(Gfx::SCREEN_WIDTH - 60, titleY + 40, 48, pageColor, name, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
     }
     
     // Draw animated accent line
@@ -80,13 +80,13 @@ void Screen::DrawBottomBar(const char *leftHint, const char *centerHint, const c
 
     // draw bottom bar content - 统一字体大小为40
     if (leftHint) {
-        Gfx::Print(60, Gfx::SCREEN_HEIGHT - 40, 40, Gfx::COLOR_TEXT, leftHint, Gfx::ALIGN_VERTICAL);
+        Gfx::PrintStatic(60, Gfx::SCREEN_HEIGHT - 40, 40, Gfx::COLOR_TEXT, leftHint, Gfx::ALIGN_VERTICAL);
     }
     if (centerHint) {
-        Gfx::Print(Gfx::SCREEN_WIDTH / 2, Gfx::SCREEN_HEIGHT - 40, 40, Gfx::COLOR_TEXT, centerHint, Gfx::ALIGN_CENTER);
+        Gfx::PrintStatic(Gfx::SCREEN_WIDTH / 2, Gfx::SCREEN_HEIGHT - 40, 40, Gfx::COLOR_TEXT, centerHint, Gfx::ALIGN_CENTER);
     }
     if (rightHint) {
-        Gfx::Print(Gfx::SCREEN_WIDTH - 60, Gfx::SCREEN_HEIGHT - 40, 40, Gfx::COLOR_TEXT, rightHint, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
+        Gfx::PrintStatic(Gfx::SCREEN_WIDTH - 60, Gfx::SCREEN_HEIGHT - 40, 40, Gfx::COLOR_TEXT, rightHint, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
     }
 }
 
@@ -96,7 +96,7 @@ int Screen::DrawHeader(int x, int y, int w, uint16_t icon, const char *text) {
     const int xStart    = x + (w / 2) - (width / 2);
 
     Gfx::DrawIcon(xStart, y, 50, Gfx::COLOR_TEXT, icon, Gfx::ALIGN_VERTICAL);
-    Gfx::Print(xStart + iconWidth + 32, y, 50, Gfx::COLOR_TEXT, text, Gfx::ALIGN_VERTICAL);
+    Gfx::PrintStatic(xStart + iconWidth + 32, y, 50, Gfx::COLOR_TEXT, text, Gfx::ALIGN_VERTICAL);
     Gfx::DrawRectFilled(x, y + 32, w, 4, Gfx::COLOR_ACCENT);
 
     return y + 64;
@@ -21,6 +21,14 @@ public:
     virtual void Draw() = 0;
 
     virtual bool Update(Input &input) = 0;
+
+    // 再画一帧是否和上一帧完全相同 (Animation 的变化由主循环另外检查)
+    // 主循环只在没有输入、没有动画且当前界面空闲时跳过绘制; 默认每帧都画
+    virtual bool IsIdle() const { return false; }
+
+    // 被其它界面盖住时内存不足 (MemoryPressure): 释放可以重建的资源 (卡片纹理等), 返回释放的字节数
+    // 回到前面后在绘制时按需重建; 默认什么都不释放
+    virtual size_t ReleaseHiddenResources() { return 0; }
     
     // Get current fade alpha (0.0 = fully transparent, 1.0 = fully opaque)
     float GetFadeAlpha() const {
@@ -52,37 +60,32 @@ protected:
 
     static int DrawHeader(int x, int y, int w, uint16_t icon, const char *text);
 
+    // Current touch point (new or held) in 1920x1080 screen space
+    static bool GetTouch(const Input &input, int &touchX, int &touchY) {
+        if (!input.data.touched || !input.data.validPointer) {
+            return false;
+        }
+        // Input uses 1280x720 coordinates centered at (0,0), Y pointing up
+        touchX = (int)((input.data.x * 1920.0f / 1280.0f) + 960);
+        touchY = (int)(540 - (input.data.y * 1080.0f / 720.0f));
+        return true;
+    }
+
+    // New touch this frame (not held) in 1920x1080 screen space
+    static bool GetNewTouch(const Input &input, int &touchX, int &touchY) {
+        if (input.lastData.touched) {
+            return false;
+        }
+        return GetTouch(input, touchX, touchY);
+    }
+
     // Helper function to check if touch point is within a rectangle
     static bool IsTouchInRect(const Input &input, int x, int y, int w, int h) {
-        // Check both current touch (for new touch) and held touch
-        if (input.data.touched && input.data.validPointer) {
-            // Only trigger on new touch (not held)
-            if (input.lastData.touched) {
-                return false;
-            }
-            
-            // Input uses 1280x720 coordinate system (centered at 0,0)
-            // Coordinates range: x(-640 to 640), y(-360 to 360)
-            // We need to scale to 1920x1080 screen space
-            
-            // Scale from 1280x720 to 1920x1080
-            float scaleX = 1920.0f / 1280.0f;  // 1.5
-            float scaleY = 1080.0f / 720.0f;   // 1.5
-            
-            int touchX = (int)((input.data.x * scaleX) + 960);  // Scale and convert to 0~1920
-            // Y coordinate is inverted - flip it
-            int touchY = (int)(540 - (input.data.y * scaleY));  // Flip Y: 540 - scaled_y
-            
-            // Check if touch is within rectangle bounds
-            bool inRect = touchX >= x && touchX < (x + w) && touchY >= y && touchY < (y + h);
-            
-            // Debug output
-            DEBUG_FUNCTION_LINE("Touch: raw(%d,%d) scaled(%d,%d) rect(%d,%d,%d,%d) hit=%d", 
-                               input.data.x, input.data.y, touchX, touchY, x, y, w, h, inRect);
-            
-            return inRect;
+        int touchX, touchY;
+        if (!GetNewTouch(input, touchX, touchY)) {
+            return false;
         }
-        return false;
+        return touchX >= x && touchX < (x + w) && touchY >= y && touchY < (y + h);
     }
 
     struct ScreenListElement {
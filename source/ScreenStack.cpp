@@ -0,0 +1,60 @@
+#include "ScreenStack.hpp"
+#include "utils/FileLogger.hpp"
+#include <vector>
+
+namespace {
+
+struct Entry {
+    std::unique_ptr<Screen> screen;
+    std::function<void()> onClose;
+};
+
+std::vector<Entry> sStack;
+
+} // namespace
+
+void ScreenStack::Push(std::unique_ptr<Screen> screen, std::function<void()> onClose) {
+    sStack.push_back({std::move(screen), std::move(onClose)});
+    FileLogger::GetInstance().LogInfo("[ScreenStack] Pushed screen (depth %zu)", sStack.size());
+}
+
+Screen* ScreenStack::Top() {
+    return sStack.empty() ? nullptr : sStack.back().screen.get();
+}
+
+bool ScreenStack::Update(Input &input) {
+    if (sStack.empty()) {
+        return false;
+    }
+
+    if (sStack.back().screen->Update(input)) {
+        return true;
+    }
+
+    // 先销毁界面再回调, 回调中可以再压入新的界面
+    Entry entry = std::move(sStack.back());
+    sStack.pop_back();
+    entry.screen.reset();
+    FileLogger::GetInstance().LogInfo("[ScreenStack] Popped screen (depth %zu)", sStack.size());
+    if (entry.onClose) {
+        entry.onClose();
+    }
+    return true;
+}
+
+size_t ScreenStack::ReleaseHidden(Screen* base) {
+    if (sStack.empty()) {
+        return 0;
+    }
+    size_t freed = base ? base->ReleaseHiddenResources() : 0;
+    for (size_t i = 0; i + 1 < sStack.size(); i++) {
+        freed += sStack[i].screen->ReleaseHiddenResources();
+    }
+    return freed;
+}
+
+void ScreenStack::Clear() {
+    while (!sStack.empty()) {
+        sStack.pop_back();
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Screen.hpp"
+#include <functional>
+#include <memory>
+
+// 压在当前界面上的模态界面 (主题详情、本地安装等)
+// 由主循环统一更新和绘制栈顶, 后台服务 (下载、音乐、通知) 照常每帧运行
+class ScreenStack {
+public:
+    // 压入界面; 它的 Update 返回 false 时弹出、销毁, 然后调用 onClose
+    static void Push(std::unique_ptr<Screen> screen, std::function<void()> onClose = nullptr);
+
+    // 栈顶界面, 栈为空时返回 nullptr
+    static Screen* Top();
+
+    // 更新栈顶界面; 栈为空时返回 false, 由调用者更新底层界面
+    // 弹出的那一帧也返回 true, 这一帧的输入不再交给下面的界面
+    static bool Update(Input &input);
+
+    // 内存不足时调用: 栈中除栈顶以外的界面 (栈不为空时还有 base) 释放可以重建的资源, 返回释放的字节数
+    static size_t ReleaseHidden(Screen* base);
+
+    // 退出时调用: 从栈顶开始销毁, 不调用 onClose
+    static void Clear();
+};
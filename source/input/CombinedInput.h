@@ -4,6 +4,9 @@ class CombinedInput : public Input {
 public:
     void combine(const Input &b) {
         data.buttons_h |= b.data.buttons_h;
+        // presses and releases that happened between two updates (the hold state no longer shows them)
+        data.buttons_d |= b.data.buttons_d;
+        data.buttons_r |= b.data.buttons_r;
         
         // Copy touch data from the first valid input
         if (b.data.touched && b.data.validPointer) {
@@ -12,6 +15,8 @@ public:
             data.x = b.data.x;
             data.y = b.data.y;
             data.pointerAngle = b.data.pointerAngle;
+            touchPointCount = b.touchPointCount;
+            memcpy(touchPoints, b.touchPoints, sizeof(TouchPoint) * b.touchPointCount);
         }
     }
 
@@ -19,6 +24,14 @@ public:
         data.buttons_d |= (data.buttons_h & (~lastData.buttons_h));
         data.buttons_r |= (lastData.buttons_h & (~data.buttons_h));
         lastData.buttons_h = data.buttons_h;
+
+        // nothing held, pressed, released or touched (including the frame a touch ends)
+        idle = !data.buttons_h && !data.buttons_d && !data.buttons_r && !data.touched && !lastData.touched;
+    }
+
+    // no input changes this frame, the screen only needs redrawing for other reasons
+    bool isIdle() const {
+        return idle;
     }
 
     void reset() {
@@ -36,5 +49,9 @@ public:
         data.validPointer = false;
         data.x = 0;
         data.y = 0;
+        touchPointCount = 0;
     }
+
+private:
+    bool idle = true;
 };
\ No newline at end of file
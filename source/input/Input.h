@@ -57,4 +57,17 @@ public:
 
     PadData data{};
     PadData lastData{};
+
+    //! number of buffered samples drained per update (size of the VPAD / KPAD ring buffers)
+    static constexpr int MAX_SAMPLES = 16;
+
+    typedef struct {
+        int32_t x;
+        int32_t y;
+    } TouchPoint;
+
+    //! touch points sampled since the last update, oldest first (the last one equals data.x / data.y)
+    //! a long frame still sees the whole drag, e.g. to compute scroll velocity
+    TouchPoint touchPoints[MAX_SAMPLES]{};
+    int touchPointCount = 0;
 };
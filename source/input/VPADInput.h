@@ -23,7 +23,7 @@ class VPadInput : public Input {
 public:
     //!Constructor
     VPadInput() {
-        memset(&vpad, 0, sizeof(vpad));
+        memset(vpad, 0, sizeof(vpad));
     }
 
     //!Destructor
@@ -32,30 +32,53 @@ public:
     bool update(int32_t width, int32_t height) {
         lastData = data;
 
+        //! drain every buffered sample, so presses and touch movement during a long frame are not lost
         VPADReadError vpadError = VPAD_READ_NO_SAMPLES;
-        VPADRead(VPAD_CHAN_0, &vpad, 1, &vpadError);
+        int32_t count = VPADRead(VPAD_CHAN_0, vpad, MAX_SAMPLES, &vpadError);
 
-        if (vpadError == VPAD_READ_SUCCESS) {
-            data.buttons_r    = vpad.release;
-            data.buttons_h    = vpad.hold;
-            data.buttons_d    = vpad.trigger;
-            data.validPointer = !vpad.tpNormal.validity;
-            data.touched      = vpad.tpNormal.touched;
+        if (vpadError == VPAD_READ_SUCCESS && count > 0) {
+            //! samples are newest first: hold state from the newest, edges from all of them
+            data.buttons_r = 0;
+            data.buttons_d = 0;
+            for (int32_t i = 0; i < count; i++) {
+                data.buttons_r |= vpad[i].release;
+                data.buttons_d |= vpad[i].trigger;
+            }
+            data.buttons_h    = vpad[0].hold;
+            data.validPointer = !vpad[0].tpNormal.validity;
+            data.touched      = vpad[0].tpNormal.touched;
 
-            VPADGetTPCalibratedPoint(VPAD_CHAN_0, &tpCalib, &vpad.tpFiltered1);
+            touchPointCount = 0;
+            for (int32_t i = count - 1; i >= 0; i--) {
+                if (!vpad[i].tpNormal.touched || vpad[i].tpNormal.validity) {
+                    continue;
+                }
+                VPADGetTPCalibratedPoint(VPAD_CHAN_0, &tpCalib, &vpad[i].tpFiltered1);
+                touchPoints[touchPointCount++] = toScreen(tpCalib, width, height);
+            }
 
-            //! calculate the screen offsets
-            data.x = -(width >> 1) + (int32_t) (((float) tpCalib.x / 1280.0f) * (float) width);
-            data.y = -(height >> 1) + (int32_t) (float) height - (((float) tpCalib.y / 720.0f) * (float) height);
+            VPADGetTPCalibratedPoint(VPAD_CHAN_0, &tpCalib, &vpad[0].tpFiltered1);
+            TouchPoint point = toScreen(tpCalib, width, height);
+            data.x = point.x;
+            data.y = point.y;
 
             return true;
         } else {
-            data.buttons_h = 0;
+            data.buttons_h  = 0;
+            touchPointCount = 0;
         }
         return false;
     }
 
 private:
-    VPADStatus vpad{};
+    //! calculate the screen offsets
+    static TouchPoint toScreen(const VPADTouchData &calib, int32_t width, int32_t height) {
+        TouchPoint point;
+        point.x = -(width >> 1) + (int32_t) (((float) calib.x / 1280.0f) * (float) width);
+        point.y = -(height >> 1) + (int32_t) (float) height - (((float) calib.y / 720.0f) * (float) height);
+        return point;
+    }
+
+    VPADStatus vpad[MAX_SAMPLES]{};
     VPADTouchData tpCalib{};
 };
\ No newline at end of file
@@ -17,6 +17,7 @@
  ****************************************************************************/
 
 #include "Input.h"
+#include <atomic>
 #include <padscore/kpad.h>
 #include <padscore/wpad.h>
 
@@ -126,28 +127,60 @@ public:
 
     bool update(int32_t width, int32_t height) {
         lastData = data;
-        WPADExtensionType type;
-        if (WPADProbe(channel, &type) != 0) {
-            data.buttons_h = 0;
+        //! channels without a controller are not read at all
+        if (!isConnected(channel)) {
+            data.buttons_h  = 0;
+            data.buttons_d  = 0;
+            data.buttons_r  = 0;
+            touchPointCount = 0;
             return false;
         }
 
-        KPADRead(channel, &kpad, 1);
-
+        //! drain every buffered sample (newest first), so presses during a long frame are not lost
+        int32_t count = KPADRead(channel, kpadSamples, MAX_SAMPLES);
+        if (count <= 0) {
+            //! nothing new since the last update: keep holding, no new edges
+            data.buttons_r = 0;
+            data.buttons_d = 0;
+            touchPointCount = 0;
+            return true;
+        }
+        kpad = kpadSamples[0];
+
+        data.buttons_r = 0;
+        data.buttons_d = 0;
+        for (int32_t i = 0; i < count; i++) {
+            const KPADStatus &sample = kpadSamples[i];
+            if (sample.extensionType == WPAD_EXT_CORE || sample.extensionType == WPAD_EXT_NUNCHUK) {
+                data.buttons_r |= remapWiiMoteButtons(sample.release);
+                data.buttons_d |= remapWiiMoteButtons(sample.trigger);
+            } else {
+                data.buttons_r |= remapClassicButtons(sample.classic.release);
+                data.buttons_d |= remapClassicButtons(sample.classic.trigger);
+            }
+        }
         if (kpad.extensionType == WPAD_EXT_CORE || kpad.extensionType == WPAD_EXT_NUNCHUK) {
-            data.buttons_r = remapWiiMoteButtons(kpad.release);
             data.buttons_h = remapWiiMoteButtons(kpad.hold);
-            data.buttons_d = remapWiiMoteButtons(kpad.trigger);
         } else {
-            data.buttons_r = remapClassicButtons(kpad.classic.release);
             data.buttons_h = remapClassicButtons(kpad.classic.hold);
-            data.buttons_d = remapClassicButtons(kpad.classic.trigger);
         }
 
         data.validPointer = (kpad.posValid == 1 || kpad.posValid == 2) &&
                             (kpad.pos.x >= -1.0f && kpad.pos.x <= 1.0f) &&
                             (kpad.pos.y >= -1.0f && kpad.pos.y <= 1.0f);
 
+        //! pointer positions of this update, oldest first
+        touchPointCount = 0;
+        for (int32_t i = count - 1; i >= 0; i--) {
+            const KPADStatus &sample = kpadSamples[i];
+            if ((sample.posValid == 1 || sample.posValid == 2) &&
+                sample.pos.x >= -1.0f && sample.pos.x <= 1.0f && sample.pos.y >= -1.0f && sample.pos.y <= 1.0f) {
+                touchPoints[touchPointCount].x = (width >> 1) * sample.pos.x;
+                touchPoints[touchPointCount].y = (height >> 1) * (-sample.pos.y);
+                touchPointCount++;
+            }
+        }
+
         //! calculate the screen offsets if pointer is valid else leave old value
         if (data.validPointer) {
             data.x = (width >> 1) * kpad.pos.x;
@@ -166,12 +199,44 @@ public:
     static void init() {
         KPADInit();
         WPADEnableURCC(1);
+
+        //! controllers connected before the callbacks are installed don't report a connect
+        for (int chan = WPAD_CHAN_0; chan <= WPAD_CHAN_3; chan++) {
+            WPADExtensionType type;
+            setConnected((KPADChan) chan, WPADProbe((WPADChan) chan, &type) == 0);
+            KPADSetConnectCallback((KPADChan) chan, onConnect);
+        }
+    }
+
+    static bool isConnected(KPADChan channel) {
+        return connectedMask.load(std::memory_order_relaxed) & (1u << channel);
+    }
+
+    //! true if any Wii Remote is connected
+    static bool anyConnected() {
+        return connectedMask.load(std::memory_order_relaxed) != 0;
     }
 
     static void close() {
     }
 
 private:
-    KPADStatus kpad{};
+    //! called from the WPAD thread when a controller connects or disconnects
+    static void onConnect(KPADChan channel, int32_t status) {
+        setConnected(channel, status == WPAD_ERROR_NONE);
+    }
+
+    static void setConnected(KPADChan channel, bool connected) {
+        if (connected) {
+            connectedMask.fetch_or(1u << channel);
+        } else {
+            connectedMask.fetch_and(~(1u << channel));
+        }
+    }
+
+    static inline std::atomic<uint32_t> connectedMask{0};
+
+    KPADStatus kpadSamples[MAX_SAMPLES]{};
+    KPADStatus kpad{}; //!< newest sample
     KPADChan channel;
 };
\ No newline at end of file
@@ -1,16 +1,40 @@
+#include "Benchmark.hpp"
 #include "Gfx.hpp"
 #include "input/CombinedInput.h"
 #include "input/VPADInput.h"
 #include "input/WPADInput.h"
 #include "screens/MainScreen.hpp"
+#include "ScreenStack.hpp"
 #include "utils/logger.h"
 #include "utils/LanguageManager.hpp"
 #include "utils/FileLogger.hpp"
 #include "utils/ImageLoader.hpp"
+#include "utils/ThemeManager.hpp"
 #include "utils/Config.hpp"
+#include "utils/FileIO.hpp"
+#include "utils/TrashBin.hpp"
 #include "utils/MusicPlayer.hpp"
 #include "utils/BgmDownloader.hpp"
 #include "utils/PluginDownloader.hpp"
+#include "utils/Profiler.hpp"
+#include "utils/Trace.hpp"
+#include "utils/AllocTracker.hpp"
+#include "utils/FrameArena.hpp"
+#include "utils/FastMemory.hpp"
+#include "utils/AppLifecycle.hpp"
+#include "utils/MemoryPressure.hpp"
+#include "utils/StartupTasks.hpp"
+#include "utils/FrameScheduler.hpp"
+#include "utils/IdleTasks.hpp"
+#include "utils/PerfProfile.hpp"
+#include "utils/MetricsStream.hpp"
+#include "utils/ZipIndex.hpp"
+#include "utils/InstallQueue.hpp"
+#include "utils/JobSystem.hpp"
+#include "utils/ThemeRegistry.hpp"
+#include "utils/SystemInfo.hpp"
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
 #include <coreinit/title.h>
 #include <memory>
 #include <padscore/kpad.h>
@@ -24,18 +48,31 @@ inline bool RunningFromMiiMaker() {
 }
 
 int main(int argc, char const *argv[]) {
+    // 只在 ALLOC_TRACKING=1 的构建中统计, 尽早安装以记录启动时的分配
+    AllocTracker::Install();
     initLogging();
     WHBProcInit();
+    // 进入后台和回到前台时通知各子系统
+    AppLifecycle::Init();
+    // operator new 失败时通知释放缓存
+    MemoryPressure::Init();
+    OSTime bootStart = OSGetSystemTime();
 
     // Initialize audio system for SDL2_mixer
     AXInit();
 
-    KPADInit();
-    WPADEnableURCC(TRUE);
+    // 连接状态由回调记录, 主循环只读取连接了手柄的通道
+    WPADInput::init();
+
+    // MEM1 要在 SDL 占用剩下的空间之前取得
+    FastMemory::Init();
 
     // Initialize graphics
     Gfx::Init();
     
+    // 后台任务线程 (核心 0 和 2), 图片解码等在上面运行
+    JobSystem::Init();
+    
     // Initialize image loader
     ImageLoader::Init();
     
@@ -51,80 +88,161 @@ int main(int argc, char const *argv[]) {
         FileLogger::GetInstance().LogInfo("Running from: %s", RunningFromMiiMaker() ? "MiiMaker" : "Homebrew Launcher");
     }
     
+    // 按可用内存选择缓存和缓冲区大小 (配置文件可以固定档位)
+    PerfProfile::Init();
+    ImageLoader::SetCacheBudget(PerfProfile::GetTextureCacheBudget());
+    ZipIndex::SetInflateBackend(Config::GetInstance().IsDirectInflateEnabled() ? ZipIndex::INFLATE_DIRECT
+                                                                                 : ZipIndex::INFLATE_STREAM);
+    // 配置文件中打开时每秒用 UDP 广播性能数据
+    MetricsStream::Init();
+    
+    // 系统菜单的 title ID、区域和 content 路径只在这里查一次
+    SystemInfo::Init();
+    
     // Initialize language system (will automatically load language from config)
     Lang().Initialize();
     
+    // 在后台继续删除上次没删完的旧主题目录
+    TrashBin::Init();
+    
+    // 第一帧之后再做的启动阶段
     // Initialize music player
-    MusicPlayer::GetInstance().Init();
+    StartupTasks::Add("audio", StartupTasks::MAIN_THREAD, []() {
+        MusicPlayer::GetInstance().Init();
+    });
     
-    // 检查BGM文件是否存在
-    const char* bgmPath = "fs:/vol/external01/UTheme/BGM.mp3";
-    struct stat st;
-    bool bgmExists = (stat(bgmPath, &st) == 0);
+    // 检查或下载BGM, 在后台加载
+    StartupTasks::Add("bgm", StartupTasks::MAIN_THREAD, []() {
+        // 检查BGM文件是否存在
+        const char* bgmPath = "fs:/vol/external01/UTheme/BGM.mp3";
+        struct stat st;
+        bool bgmExists = (stat(bgmPath, &st) == 0);
     
-    // 如果BGM文件不存在,自动下载
-    if (!bgmExists) {
-        FileLogger::GetInstance().LogInfo("BGM file not found, starting automatic download...");
-        std::string bgmUrl = Config::GetInstance().GetBgmUrl();
+        // 如果BGM文件不存在,自动下载
+        if (!bgmExists) {
+            FileLogger::GetInstance().LogInfo("BGM file not found, starting automatic download...");
+            std::string bgmUrl = Config::GetInstance().GetBgmUrl();
         
-        if (!bgmUrl.empty()) {
-            FileLogger::GetInstance().LogInfo("Downloading BGM from: %s", bgmUrl.c_str());
+            if (!bgmUrl.empty()) {
+                FileLogger::GetInstance().LogInfo("Downloading BGM from: %s", bgmUrl.c_str());
             
-            // 设置下载完成回调
-            BgmDownloader::GetInstance().SetCompletionCallback([](bool success, const std::string& error) {
-                if (success) {
-                    FileLogger::GetInstance().LogInfo("BGM downloaded successfully");
-                } else {
-                    FileLogger::GetInstance().LogError("BGM download failed: %s", error.c_str());
-                }
-            });
+                // 设置下载完成回调
+                BgmDownloader::GetInstance().SetCompletionCallback([](bool success, const std::string& error) {
+                    if (success) {
+                        FileLogger::GetInstance().LogInfo("BGM downloaded successfully");
+                    } else {
+                        FileLogger::GetInstance().LogError("BGM download failed: %s", error.c_str());
+                    }
+                });
             
-            // 开始后台下载
-            BgmDownloader::GetInstance().StartDownload(bgmUrl);
+                // 开始后台下载
+                BgmDownloader::GetInstance().StartDownload(bgmUrl);
+            } else {
+                FileLogger::GetInstance().LogInfo("No BGM URL configured, skipping download");
+            }
         } else {
-            FileLogger::GetInstance().LogInfo("No BGM URL configured, skipping download");
+            FileLogger::GetInstance().LogInfo("BGM file exists, loading...");
         }
-    } else {
-        FileLogger::GetInstance().LogInfo("BGM file exists, loading...");
-    }
     
-    // 尝试加载BGM (可能已存在,或正在下载中)
-    const char* bgmPaths[] = {
-        "fs:/vol/external01/UTheme/BGM.mp3",
-        "fs:/vol/external01/UTheme/BGM.ogg"
-    };
-    
-    bool bgmLoaded = false;
-    for (const char* path : bgmPaths) {
-        if (MusicPlayer::GetInstance().LoadMusic(path)) {
-            FileLogger::GetInstance().LogInfo("Background music loaded from: %s", path);
-            bgmLoaded = true;
-            
-            // 显示音乐加载通知,包含歌曲名和艺术家
-            std::string musicName = MusicPlayer::GetInstance().GetCurrentTrackName();
-            std::string artist = MusicPlayer::GetInstance().GetCurrentArtist();
-            Screen::GetBgmNotification().ShowNowPlaying(musicName, artist);
-            
-            break;
+        // 尝试加载BGM (可能已存在,或正在下载中)
+        const char* bgmPaths[] = {
+            "fs:/vol/external01/UTheme/BGM.mp3",
+            "fs:/vol/external01/UTheme/BGM.ogg"
+        };
+    
+        bool bgmLoaded = false;
+        for (const char* path : bgmPaths) {
+            // 在后台加载, 加载完成后显示音乐通知,包含歌曲名和艺术家
+            if (MusicPlayer::GetInstance().LoadMusic(path, [](bool success) {
+                    if (success) {
+                        Screen::GetBgmNotification().ShowNowPlaying(MusicPlayer::GetInstance().GetCurrentTrackName(),
+                                                                    MusicPlayer::GetInstance().GetCurrentArtist());
+                    }
+                })) {
+                FileLogger::GetInstance().LogInfo("Background music loading from: %s", path);
+                bgmLoaded = true;
+                break;
+            }
         }
-    }
     
-    if (bgmLoaded) {
-        MusicPlayer::GetInstance().SetEnabled(Config::GetInstance().IsBgmEnabled());
-        MusicPlayer::GetInstance().SetVolume(32);  // 25% volume
-    } else {
-        if (bgmExists) {
-            FileLogger::GetInstance().LogError("Failed to load existing BGM file");
+        if (bgmLoaded) {
+            MusicPlayer::GetInstance().SetEnabled(Config::GetInstance().IsBgmEnabled());
+            MusicPlayer::GetInstance().SetVolume(32);  // 25% volume
         } else {
-            FileLogger::GetInstance().LogInfo("BGM downloading in background, will be available after completion");
+            if (bgmExists) {
+                FileLogger::GetInstance().LogError("Failed to load existing BGM file");
+            } else {
+                FileLogger::GetInstance().LogInfo("BGM downloading in background, will be available after completion");
+            }
         }
-    }
+    }, {"audio"});
     
-    // 检查并下载 StyleMiiU 插件
-    FileLogger::GetInstance().LogInfo("Checking for StyleMiiU plugin...");
-    PluginDownloader::GetInstance().CheckAndDownloadStyleMiiU();
+    // 检查 StyleMiiU 插件, 需要时通过下载队列在后台下载
+    StartupTasks::Add("plugin", StartupTasks::MAIN_THREAD, []() {
+        PluginDownloader::GetInstance().CheckStyleMiiU();
+    });
+    
+    // 预先建立到主题服务器的连接, 第一次打开下载界面时不用等 DNS 和 TLS 握手
+    StartupTasks::Add("network", StartupTasks::MAIN_THREAD, []() {
+        ThemeManager::PrewarmConnections();
+    });
+    
+    // 预先读入已安装主题的登记表, 打开管理界面时不用再等 SD 卡
+    StartupTasks::Add("registry", StartupTasks::BACKGROUND, []() {
+        ThemeRegistry::GetInstance().GetInstalledIDs();
+    });
 
-    std::unique_ptr<Screen> mainScreen = std::make_unique<MainScreen>();
+    // 每帧在预算之内处理的主线程工作 (ImageLoader 和下载队列的完成回调在界面 Update 中处理, 也受同一预算限制)
+    // 后台任务完成后在主线程执行的续接
+    FrameScheduler::Register("jobs", FrameScheduler::PRIORITY_NORMAL, JobSystem::Update);
+    // 第一帧之后的启动阶段
+    FrameScheduler::Register("startup", FrameScheduler::PRIORITY_NORMAL, []() {
+        StartupTasks::Update();
+        return false;
+    });
+    // 合并设置的修改, 在后台写入配置文件
+    FrameScheduler::Register("config", FrameScheduler::PRIORITY_LOW, []() {
+        Config::GetInstance().Update();
+        return false;
+    });
+    // 安装主题后在后台保存预览图
+    FrameScheduler::Register("image-jobs", FrameScheduler::PRIORITY_LOW, []() {
+        ThemeManager::UpdateImageJobs();
+        return false;
+    });
+    // 空闲帧也继续预先生成字形
+    FrameScheduler::Register("glyph-prewarm", FrameScheduler::PRIORITY_LOW, []() {
+        Gfx::UpdateGlyphPrewarm();
+        return false;
+    });
+    // 每帧都检查 (只比较时间), 繁忙时也按时发送
+    FrameScheduler::Register("metrics", FrameScheduler::PRIORITY_HIGH, MetricsStream::Update);
+    // 前几次传输之后按吞吐选择网络档位
+    FrameScheduler::Register("perf-profile", FrameScheduler::PRIORITY_LOW, PerfProfile::Update);
+    // MEM2 水位和分配失败的通知, 繁忙时也要处理
+    FrameScheduler::Register("memory-pressure", FrameScheduler::PRIORITY_HIGH, MemoryPressure::Update);
+    // 几秒没有输入之后的维护工作, 排在所有每帧工作之后
+    FrameScheduler::Register("idle", FrameScheduler::PRIORITY_LOW, IdleTasks::Run);
+    // 磁盘缓存淘汰到低水位、删除无主文件、写回索引
+    IdleTasks::Register("disk-cache", 60 * 1000, ImageLoader::RunCacheMaintenance);
+    // 启动阶段不算空闲
+    IdleTasks::NoteInput();
+
+    std::unique_ptr<MainScreen> mainScreen = std::make_unique<MainScreen>();
+    
+    // 内存不足时按顺序丢弃可以重建的状态 (ImageLoader 在 Init 中自己登记)
+    MemoryPressure::AddListener("screens", MemoryPressure::ORDER_HIDDEN, [&mainScreen](MemoryPressure::Level) {
+        return ScreenStack::ReleaseHidden(mainScreen.get());
+    });
+    MemoryPressure::AddListener("catalog-prefetch", MemoryPressure::ORDER_HIDDEN, [](MemoryPressure::Level) {
+        return ThemeManager::ReleasePrefetchedCatalog();
+    });
+    // 可见的文字下一帧就要重建, 只在已经有分配失败时释放
+    MemoryPressure::AddListener("text", MemoryPressure::ORDER_TEXT, [](MemoryPressure::Level level) {
+        return level == MemoryPressure::LEVEL_CRITICAL ? Gfx::ReleaseTextCaches() : 0;
+    });
+    // 配置文件中 benchmark=1: 主菜单显示后自动运行基准测试
+    bool benchmarkPending = Config::GetInstance().IsBenchmarkOnLaunch();
 
     CombinedInput baseInput;
     VPadInput vpadInput;
@@ -134,42 +252,145 @@ int main(int argc, char const *argv[]) {
             WPAD_CHAN_2,
             WPAD_CHAN_3};
 
+    // 空闲时不重画: 上一帧留在屏幕上, 循环只等待并继续处理输入和后台任务
+    // 每秒仍至少画一帧; 两次循环间隔很长 (例如从 HOME 菜单返回) 时也立即重画
+    const uint32_t MAX_SKIPPED_FRAMES = 60;
+    const uint64_t IDLE_FRAME_MS = 16;
+    uint32_t skippedFrames = 0;
+    uint64_t lastLoopTime = OSGetSystemTime();
+    bool firstFrameShown = false;
+
     // 主循环 - 使用 try-catch 捕获异常
     bool shouldQuit = false;
     try {
         while (WHBProcIsRunning()) {
+            // 空闲帧不调用 Gfx::Render, 在这里开始新的动画帧
+            Animation::NextFrame();
+            FrameScheduler::BeginFrame();
             baseInput.reset();
             if (vpadInput.update(1280, 720)) {
                 baseInput.combine(vpadInput);
             }
-            for (auto &wpadInput : wpadInputs) {
-                if (wpadInput.update(1280, 720)) {
-                    baseInput.combine(wpadInput);
+            // 没有连接 Wii 遥控器时 (大多数情况只用 GamePad) 整个跳过
+            if (WPADInput::anyConnected()) {
+                for (auto &wpadInput : wpadInputs) {
+                    if (wpadInput.update(1280, 720)) {
+                        baseInput.combine(wpadInput);
+                    }
                 }
             }
             baseInput.process();
+            if (!baseInput.isIdle()) {
+                IdleTasks::NoteInput();
+            }
 
-            if (!mainScreen->Update(baseInput)) {
-                // screen requested quit
-                shouldQuit = true;
-                break;
+            // ZL + ZR + MINUS: 显示或隐藏性能 HUD
+            const uint32_t hudCombo = Input::BUTTON_ZL | Input::BUTTON_ZR;
+            if ((baseInput.data.buttons_h & hudCombo) == hudCombo && (baseInput.data.buttons_d & Input::BUTTON_MINUS)) {
+                Profiler::ToggleHud();
+            }
+
+            // ZL + ZR + X: 开始记录时间线, 再按一次写出 (UTheme/trace/)
+            if ((baseInput.data.buttons_h & hudCombo) == hudCombo && (baseInput.data.buttons_d & Input::BUTTON_X)) {
+                std::string tracePath;
+                if (!Trace::IsRecording()) {
+                    Trace::Start();
+                    Screen::GetBgmNotification().ShowNowPlaying("Trace recording");
+                } else if (Trace::Stop(tracePath)) {
+                    Screen::GetBgmNotification().ShowNowPlaying("Trace saved: " + tracePath);
+                } else {
+                    Screen::GetBgmNotification().ShowError("Failed to save trace");
+                }
+            }
+
+            // ZL + ZR + PLUS: 运行基准测试 (运行中 ZL + ZR + B 中止)
+            if ((baseInput.data.buttons_h & hudCombo) == hudCombo && (baseInput.data.buttons_d & Input::BUTTON_PLUS)) {
+                Benchmark::Start();
+            }
+            if (benchmarkPending && mainScreen->IsInMenu()) {
+                benchmarkPending = false;
+                Benchmark::Start();
+            }
+            // 运行中界面收到的是脚本模拟的按键
+            Benchmark::Update(baseInput);
+
+            {
+                Profiler::Scope scope(Profiler::SECTION_UPDATE);
+                AllocTracker::TagScope allocTag(AllocTracker::TAG_UI);
+                // 有模态界面时只更新栈顶
+                if (!ScreenStack::Update(baseInput) && !mainScreen->Update(baseInput)) {
+                    // screen requested quit
+                    shouldQuit = true;
+                    break;
+                }
             }
             
             // Update BGM downloader
             BgmDownloader::GetInstance().Update();
             
+            // StyleMiiU 插件下载
+            PluginDownloader::GetInstance().Update();
+            
+            // 主题下载和安装队列 (不依赖当前界面)
+            InstallQueue::GetInstance().Update();
+            
             // Update music player
-            MusicPlayer::GetInstance().Update();
+            {
+                Profiler::Scope scope(Profiler::SECTION_MUSIC);
+                MusicPlayer::GetInstance().Update();
+            }
             
             // Update BGM notification
             Screen::UpdateBgmNotification();
 
-            mainScreen->Draw();
-            
-            // Draw BGM notification on top
-            Screen::DrawBgmNotification();
-            
-            Gfx::Render();
+            // 启动阶段、预览图保存、字形预生成, 超出这一帧预算的留到下一帧
+            FrameScheduler::Run();
+
+            uint64_t now = OSGetSystemTime();
+            bool resumed = OSTicksToMilliseconds(now - lastLoopTime) > 100;
+            lastLoopTime = now;
+
+            // 先取出动画标记, 这一帧 Update 中开始的动画也算在内
+            bool animating = Animation::ConsumeActivity();
+            bool idle = !animating && !resumed && baseInput.isIdle() &&
+                        !Screen::GetBgmNotification().IsVisible() && !Profiler::IsHudVisible() && !Benchmark::IsRunning() &&
+                        InstallQueue::GetInstance().GetPendingCount() == 0 &&
+                        (ScreenStack::Top() ? ScreenStack::Top()->IsIdle() : mainScreen->IsIdle());
+            if (idle && skippedFrames < MAX_SKIPPED_FRAMES) {
+                skippedFrames++;
+                OSSleepTicks(OSMillisecondsToTicks(IDLE_FRAME_MS));
+                continue;
+            }
+            skippedFrames = 0;
+
+            Screen* topScreen = ScreenStack::Top() ? ScreenStack::Top() : mainScreen.get();
+            {
+                Profiler::Scope scope(Profiler::SECTION_DRAW);
+                AllocTracker::TagScope allocTag(AllocTracker::TAG_UI);
+                topScreen->Draw();
+
+                // Draw BGM notification on top
+                Screen::DrawBgmNotification();
+            }
+
+            Profiler::DrawHud();
+            Benchmark::DrawOverlay();
+            InstallQueue::GetInstance().DrawOverlay();
+
+            {
+                Profiler::Scope scope(Profiler::SECTION_RENDER);
+                Gfx::Render();
+            }
+            // 这一帧绘制用的临时文字在 Render 之后才可以丢弃
+            FrameArena::Reset();
+            Profiler::EndFrame();
+            Benchmark::EndFrame();
+
+            if (!firstFrameShown) {
+                firstFrameShown = true;
+                FileLogger::GetInstance().LogInfo("[Startup] First frame after %llu ms",
+                                                  (unsigned long long)OSTicksToMilliseconds(OSGetSystemTime() - bootStart));
+            }
         }
     } catch (const std::exception& e) {
         FileLogger::GetInstance().LogError("Fatal exception in main loop: %s", e.what());
@@ -183,7 +404,23 @@ int main(int argc, char const *argv[]) {
 
     // 清理
     FileLogger::GetInstance().LogInfo("Cleaning up resources...");
+    MemoryPressure::Shutdown();
+    Benchmark::Stop();
+    ScreenStack::Clear();
     mainScreen.reset();
+    InstallQueue::GetInstance().Shutdown();
+    ThemeManager::ShutdownCacheWriter();
+    ThemeManager::ShutdownImageJobs();
+    PluginDownloader::GetInstance().Shutdown();
+    BgmDownloader::GetInstance().Cancel();
+    StartupTasks::Shutdown();
+    TrashBin::Shutdown();
+    MetricsStream::Shutdown();
+    Config::GetInstance().Flush();
+    if (Trace::IsRecording()) {
+        std::string tracePath;
+        Trace::Stop(tracePath);
+    }
     
     // Cleanup music player
     MusicPlayer::GetInstance().Shutdown();
@@ -193,6 +430,9 @@ int main(int argc, char const *argv[]) {
     FileLogger::GetInstance().EndLog();
     
     ImageLoader::Cleanup();
+    JobSystem::Shutdown();
+    FileIO::Shutdown();
+    FastMemory::Shutdown();
     Gfx::Shutdown();
     
     // Cleanup audio system
@@ -200,6 +440,7 @@ int main(int argc, char const *argv[]) {
 
     WHBProcShutdown();
     deinitLogging();
+    AllocTracker::Uninstall();
     
     // 如果需要退出,决定退出方式
     if (shouldQuit) {
@@ -15,6 +15,9 @@ public:
 
     bool Update(Input &input) override;
 
+    // 只有动画, 没有逐帧变化的内容
+    bool IsIdle() const override { return true; }
+
 private:
     Animation mFadeInAnim;
     Animation mTitleAnim;
@@ -1,18 +1,18 @@
 #include "DownloadScreen.hpp"
 #include "ThemeDetailScreen.hpp"
+#include "ScreenStack.hpp"
 #include "Gfx.hpp"
 #include "../utils/LanguageManager.hpp"
 #include "../utils/ImageLoader.hpp"
 #include "../utils/DownloadQueue.hpp"
-#include "../utils/Utils.hpp"
 #include "../utils/logger.h"
 #include "../utils/FileLogger.hpp"
-#include "../input/CombinedInput.h"
-#include "../input/VPADInput.h"
-#include "../input/WPADInput.h"
+#include "../utils/FrameArena.hpp"
+#include "../utils/ThemeRegistry.hpp"
+#include "../utils/InstallQueue.hpp"
 #include <cmath>
+#include <algorithm>
 #include <sys/stat.h>
-#include <dirent.h>
 
 DownloadScreen::DownloadScreen() {
     mTitleAnim.Start(0, 1, 500);
@@ -26,17 +26,26 @@ DownloadScreen::DownloadScreen() {
     ScanInstalledThemes();
     
     // 设置回调
+    // 已经显示列表时获取和出错都不离开列表: 旧数据继续可用, 新数据到达后在原处更新
+    // 卡片和动画由 SyncView 跟着列表走: 第一批主题到达就显示, 之后的追加到末尾, 同步的结果不改变选中项
     mThemeManager->SetStateCallback([this](ThemeManager::FetchState state, const std::string& message) {
         switch (state) {
             case ThemeManager::FETCH_IN_PROGRESS:
-                mState = STATE_LOADING;
+                if (mState != STATE_SHOW_THEMES || mThemeManager->GetThemes().empty()) {
+                    mState = STATE_LOADING;
+                }
                 break;
             case ThemeManager::FETCH_SUCCESS:
                 mState = STATE_SHOW_THEMES;
+                mOffline = false;
                 mLoadedThemeCount = mThemeManager->GetThemes().size();
-                InitAnimations(mLoadedThemeCount);  // 初始化动画
                 break;
             case ThemeManager::FETCH_ERROR:
+                if (mState == STATE_SHOW_THEMES && !mThemeManager->GetThemes().empty()) {
+                    FileLogger::GetInstance().LogWarning("DownloadScreen: Fetch failed, keeping cached list: %s", message.c_str());
+                    mOffline = true;
+                    break;
+                }
                 mState = STATE_ERROR;
                 mErrorMessage = message;
                 break;
@@ -45,61 +54,206 @@ DownloadScreen::DownloadScreen() {
         }
     });
     
-    // 先尝试从缓存加载
+    // 先显示缓存 (不论新旧), 再在后台同步; 没有缓存时才等待网络
     FileLogger::GetInstance().LogInfo("DownloadScreen: Checking cache...");
-    if (mThemeManager->LoadCache() && mThemeManager->IsCacheValid()) {
-        // 缓存有效，直接显示主题列表
-        FileLogger::GetInstance().LogInfo("DownloadScreen: Using cached themes");
+    if (mThemeManager->LoadCache()) {
+        int64_t age = mThemeManager->GetCacheAge();
+        FileLogger::GetInstance().LogInfo("DownloadScreen: Showing %zu cached themes (age: %lld seconds%s)",
+                                          mThemeManager->GetThemes().size(), (long long)age,
+                                          age >= ThemeManager::CACHE_VALIDITY_SECONDS ? ", stale" : "");
         mState = STATE_SHOW_THEMES;
         mLoadedThemeCount = mThemeManager->GetThemes().size();
         
-        // 初始化动画
-        InitAnimations(mLoadedThemeCount);
-        
-        // 如果缓存主题数量少于50个,说明是旧版本缓存,自动刷新
-        if (mLoadedThemeCount < 50) {
-            FileLogger::GetInstance().LogInfo("DownloadScreen: Cache has only %zu themes (< 50), triggering full refresh", mLoadedThemeCount);
-            mState = STATE_LOADING;
-            mThemeManager->FetchThemes();
-        } else {
-            // 在后台检查更新
-            mThemeManager->CheckForUpdates();
+        // 回到上次离开时的视图, 它的第一屏缩略图已经随快照放进图集
+        ThemeManager::WarmView warmView;
+        if (mThemeManager->TakeWarmView(warmView)) {
+            RestoreView(warmView);
         }
+        
+        // 在后台检查更新 (异步, 结果在 ThemeManager::Update 中合并)
+        StartBackgroundSync();
     } else {
         // 缓存无效或不存在，需要从网络获取
-        FileLogger::GetInstance().LogInfo("DownloadScreen: Cache invalid or missing, will fetch from network");
+        FileLogger::GetInstance().LogInfo("DownloadScreen: No usable cache, will fetch from network");
     }
 }
 
+// 后台增量同步: 列表保持可用, 变化的主题合并到原来的位置
+void DownloadScreen::StartBackgroundSync() {
+    // 后面的页还在加载时不同步 (加载完后再刷新)
+    if (mThemeManager->GetState() == ThemeManager::FETCH_IN_PROGRESS) {
+        return;
+    }
+    mThemeManager->CheckForUpdates([this](bool ok, size_t changes) {
+        mOffline = !ok;
+        if (ok) {
+            FileLogger::GetInstance().LogInfo("DownloadScreen: Background sync done, %zu themes changed", changes);
+            mLoadedThemeCount = mThemeManager->GetThemes().size();
+        } else {
+            FileLogger::GetInstance().LogWarning("DownloadScreen: Background sync failed, showing cached themes");
+        }
+    });
+}
+
 // 初始化动画
 void DownloadScreen::InitAnimations(size_t themeCount) {
-    mThemeAnims.clear();
-    mThemeAnims.resize(themeCount);
-    
-    for (size_t i = 0; i < themeCount; i++) {
-        mThemeAnims[i].scaleAnim.SetImmediate(1.0f);
-        mThemeAnims[i].highlightAnim.SetImmediate(0.0f);
+    mCardAnims.Reset((int)themeCount, std::min(mSelectedTheme, (int)themeCount - 1));
+}
+
+// 只更新可见卡片的动画 (滚动中上下各露出一部分时是 VISIBLE_ROWS + 1 张)
+void DownloadScreen::UpdateAnimations() {
+    int firstRow = mScroll.GetFirstRow();
+    mCardAnims.Update(firstRow, firstRow + VISIBLE_ROWS + 1);
+}
+
+// 让索引跟上主题列表; 视图中的主题改变了位置时, 选中项跟随原来的主题, 动画和优先级重新计算
+void DownloadScreen::SyncView() {
+    if (!mThemeManager) {
+        return;
     }
-    
-    // 选中第一个主题的动画
-    if (themeCount > 0) {
-        mThemeAnims[0].scaleAnim.SetTarget(1.05f, 300);
-        mThemeAnims[0].highlightAnim.SetTarget(1.0f, 300);
+    mCatalog.Update(mThemeManager->GetThemes(), mThemeManager->GetCatalogVersion());
+    const auto& view = mCatalog.GetView();
+    const int viewSize = (int)view.size();
+    mScroll.SetLimits(viewSize, VISIBLE_ROWS);
+
+    if (mViewVersion == mCatalog.GetViewVersion()) {
+        // 只在末尾追加了结果 (页或流式解析的主题陆续到达), 已有卡片的动画保持不变, 可见的新卡片滑入
+        if (viewSize > mCardAnims.GetItemCount()) {
+            int firstRow = mScroll.GetFirstRow();
+            mCardAnims.Append(viewSize, std::min(mSelectedTheme, viewSize - 1), firstRow, firstRow + VISIBLE_ROWS + 1);
+        } else if (mCardAnims.GetItemCount() != viewSize) {
+            InitAnimations(viewSize);
+        }
+        return;
+    }
+
+    mViewVersion = mCatalog.GetViewVersion();
+    const int previousOffset = mScrollOffset;
+    bool kept = false;
+    if (!mSelectedThemeId.empty()) {
+        // 选中的主题被过滤掉时停在原来的位置; 移动了时 (同步在前面插入或删除了主题) 列表跟着滚动,
+        // 选中的卡片留在屏幕上原来的那一行
+        for (int i = 0; i < viewSize; i++) {
+            if (GetViewTheme(i).id == mSelectedThemeId) {
+                mScrollOffset += i - mSelectedTheme;
+                mSelectedTheme = i;
+                kept = true;
+                break;
+            }
+        }
+    }
+    mSelectedTheme = std::max(0, std::min(mSelectedTheme, viewSize - 1));
+    mScrollOffset = std::max(0, std::min(mScrollOffset, mSelectedTheme));
+    if (mSelectedTheme >= mScrollOffset + VISIBLE_ROWS) {
+        mScrollOffset = mSelectedTheme - VISIBLE_ROWS + 1;
+    }
+    if (mScrollOffset != previousOffset) {
+        mScroll.Jump(mScrollOffset);
+    }
+    mPrevSelectedTheme = mSelectedTheme;
+    mPriorityScrollOffset = -1;
+    mHdPreloadTheme = -1;
+    if (mCardAnims.GetItemCount() == 0) {
+        // 列表刚出现 (第一批主题到达): 可见的卡片滑入
+        mCardAnims.Append(viewSize, mSelectedTheme, mScrollOffset, mScrollOffset + VISIBLE_ROWS);
+    } else {
+        // 还是原来的主题时直接处于选中状态, 不重新播放放大的动画
+        mCardAnims.Reset(viewSize, mSelectedTheme, !kept);
     }
 }
 
-// 更新所有动画
-void DownloadScreen::UpdateAnimations() {
-    for (auto& anim : mThemeAnims) {
-        anim.scaleAnim.Update();
-        anim.highlightAnim.Update();
+// 热启动: 按 uuid 找回选中项 (目录没变时就在原来的位置), 滚动位置直接跳过去
+void DownloadScreen::RestoreView(const ThemeManager::WarmView& view) {
+    mCatalog.SetSort((ThemeCatalogIndex::SortOrder)view.sortOrder);
+    if (!view.tagFilter.empty()) {
+        mCatalog.SetTagFilter({PooledString(view.tagFilter)});
+    }
+    mSelectedThemeId = view.selectedThemeId;
+    mSelectedTheme = std::max(0, view.selectedIndex);
+    mScrollOffset = std::max(0, view.scrollRow);
+    SyncView();
+    mScroll.Jump(mScrollOffset);
+    FileLogger::GetInstance().LogInfo("DownloadScreen: Restored view (sort %d, row %d, selected %d)",
+                                      view.sortOrder, mScrollOffset, mSelectedTheme);
+}
+
+// 离开时的视图和最上面一屏的缩略图 (热启动快照); 列表没有显示时返回 false
+bool DownloadScreen::CaptureView(ThemeManager::WarmView& view, std::vector<std::string>& thumbUrls) {
+    if (!mThemeManager || mState != STATE_SHOW_THEMES || GetViewSize() == 0) {
+        return false;
+    }
+    view.sortOrder = mCatalog.GetSort();
+    if (!mCatalog.GetTagFilter().empty()) {
+        view.tagFilter = mCatalog.GetTagFilter()[0].str();
+    }
+    view.selectedThemeId = mSelectedThemeId;
+    view.selectedIndex = mSelectedTheme;
+    view.scrollRow = mScrollOffset;
+    
+    int endIndex = std::min(mScrollOffset + VISIBLE_ROWS, GetViewSize());
+    for (int i = mScrollOffset; i < endIndex; i++) {
+        const std::string& url = GetViewTheme(i).collagePreview.thumbUrl;
+        if (!url.empty()) {
+            thumbUrls.push_back(url);
+        }
     }
+    return true;
 }
 
-// 检查触摸点是否在矩形内
-bool DownloadScreen::IsTouchInRect(int touchX, int touchY, int rectX, int rectY, int rectW, int rectH) {
-    return touchX >= rectX && touchX <= rectX + rectW &&
-           touchY >= rectY && touchY <= rectY + rectH;
+// 换了排序或过滤条件后从新列表的开头看起
+void DownloadScreen::ResetSelection() {
+    mSelectedTheme = 0;
+    mScrollOffset = 0;
+    mScroll.Jump(0);
+    mSelectedThemeId.clear();
+}
+
+void DownloadScreen::CycleSortOrder() {
+    auto order = (ThemeCatalogIndex::SortOrder)((mCatalog.GetSort() + 1) % ThemeCatalogIndex::SORT_COUNT);
+    mCatalog.SetSort(order);
+    ResetSelection();
+    SyncView();
+    FileLogger::GetInstance().LogInfo("DownloadScreen: Sort order %d (%d themes)", (int)order, GetViewSize());
+}
+
+void DownloadScreen::CycleTagFilter(int step) {
+    // 按主题数从多到少排列, 位置 -1 表示不过滤
+    std::vector<ThemeCatalogIndex::TagInfo> tags = mCatalog.GetTags();
+    if (tags.empty()) {
+        return;
+    }
+    std::stable_sort(tags.begin(), tags.end(), [](const ThemeCatalogIndex::TagInfo& a, const ThemeCatalogIndex::TagInfo& b) {
+        return a.count > b.count;
+    });
+
+    int count = (int)tags.size();
+    int current = -1;
+    const auto& filter = mCatalog.GetTagFilter();
+    if (!filter.empty()) {
+        for (int i = 0; i < count; i++) {
+            if (tags[i].name == filter[0]) {
+                current = i;
+                break;
+            }
+        }
+    }
+
+    int next = current + step;
+    if (next < -1) {
+        next = count - 1;
+    } else if (next >= count) {
+        next = -1;
+    }
+
+    if (next < 0) {
+        mCatalog.SetTagFilter({});
+        FileLogger::GetInstance().LogInfo("DownloadScreen: Tag filter cleared");
+    } else {
+        mCatalog.SetTagFilter({tags[next].name});
+        FileLogger::GetInstance().LogInfo("DownloadScreen: Tag filter '%s' (%zu themes)", tags[next].name.c_str(), tags[next].count);
+    }
+    ResetSelection();
+    SyncView();
 }
 
 DownloadScreen::~DownloadScreen() {
@@ -118,6 +272,13 @@ DownloadScreen::~DownloadScreen() {
         }
     }
     
+    // 还没完成的缩略图 (包括预取的) 回调中引用了 this: 还在下载或排队解码的直接取消, 其余只丢弃回调
+    mImageOwner.Cancel();
+    
+    ThemeManager::WarmView warmView;
+    std::vector<std::string> warmThumbs;
+    bool saveView = CaptureView(warmView, warmThumbs);
+    
     // 清理 ThemeManager (会取消未完成的网络请求)
     if (mThemeManager) {
         FileLogger::GetInstance().LogInfo("Cleaning up ThemeManager");
@@ -125,6 +286,13 @@ DownloadScreen::~DownloadScreen() {
         FileLogger::GetInstance().LogInfo("ThemeManager cleanup completed");
     }
     
+    // 快照排在 ThemeManager 析构时写入的目录缓存之后, 记下的是新的目录
+    if (saveView) {
+        // 未选中卡片的缩略图尺寸, 和 DrawThemeList 中的请求一致
+        const int thumbH = 200 - 40;
+        ThemeManager::SaveWarmStart(warmView, warmThumbs, (int)(thumbH * 16.0f / 9.0f), thumbH);
+    }
+    
     FileLogger::GetInstance().LogInfo("DownloadScreen destructor completed");
 }
 
@@ -182,9 +350,8 @@ void DownloadScreen::Draw() {
             Gfx::Print(cardX + cardW/2, cardY + 200, 44, Gfx::COLOR_TEXT, _("download.downloading"), Gfx::ALIGN_CENTER);
             
             // 主题名称
-            const auto& themes = mThemeManager->GetThemes();
-            if (mSelectedTheme < (int)themes.size()) {
-                std::string themeName = themes[mSelectedTheme].name;
+            if (mSelectedTheme < GetViewSize()) {
+                std::string themeName = GetViewTheme(mSelectedTheme).name;
                 if (themeName.length() > 30) {
                     themeName = themeName.substr(0, 27) + "...";
                 }
@@ -255,23 +422,48 @@ void DownloadScreen::Draw() {
     
     // 底部栏 - 根据状态显示不同提示
     if (mState == STATE_SHOW_THEMES) {
-        std::string middleHint = std::string("\ue000 ") + _("download.download") + " | \ue002 " + _("download.refresh");
-        
         // 如果检测到更新,添加提示
-        if (mThemeManager->HasUpdates()) {
-            middleHint += " | " + std::string(_("download.update_available"));
-        }
+        std::string_view middleHint = FrameArena::Format("\ue000 %s | \ue002 %s | \ue003 %s | \ue004\ue005 %s%s%s",
+                                                         _("download.download").c_str(), _("download.refresh").c_str(),
+                                                         _("download.sort").c_str(), _("download.tag").c_str(),
+                                                         mThemeManager->HasUpdates() ? " | " : "",
+                                                         mThemeManager->HasUpdates() ? _("download.update_available").c_str() : "");
         
-        DrawBottomBar((std::string("\ue07d ") + _("input.select")).c_str(), 
-                     middleHint.c_str(), 
-                     (std::string("\ue001 ") + _("input.back")).c_str());
+        DrawBottomBar(FrameArena::Format("\ue07d %s", _("input.select").c_str()).data(), 
+                     middleHint.data(), 
+                     FrameArena::Format("\ue001 %s", _("input.back").c_str()).data());
     } else {
         DrawBottomBar(nullptr, 
-                     (std::string("\ue044 ") + _("input.exit")).c_str(), 
-                     (std::string("\ue001 ") + _("input.back")).c_str());
+                     FrameArena::Format("\ue044 %s", _("input.exit").c_str()).data(), 
+                     FrameArena::Format("\ue001 %s", _("input.back").c_str()).data());
     }
 }
 
+void DownloadScreen::OpenDetailScreen() {
+    // 创建详情屏幕 (预加载中的高清图由详情页接手)
+    mHdPreloadUrls.clear();
+    ScreenStack::Push(std::make_unique<ThemeDetailScreen>(&GetViewTheme(mSelectedTheme), mThemeManager.get()), [this]() {
+        FileLogger::GetInstance().LogInfo("Returned from detail screen, theme count: %zu", mThemeManager->GetThemes().size());
+        
+        // 验证选中索引是否仍然有效
+        if (mSelectedTheme >= GetViewSize()) {
+            FileLogger::GetInstance().LogError("Selected theme index out of bounds! Resetting to 0");
+            mSelectedTheme = 0;
+            mScrollOffset = 0;
+            mScroll.Jump(0);
+        }
+        
+        // 重新初始化动画以确保大小匹配
+        if (mCardAnims.GetItemCount() != GetViewSize()) {
+            FileLogger::GetInstance().LogInfo("Reinitializing animations after detail screen");
+            InitAnimations(GetViewSize());
+        }
+        
+        // 设置返回时间,启动输入冷却
+        mReturnFromDetailFrame = mFrameCount;
+    });
+}
+
 bool DownloadScreen::Update(Input &input) {
     // 更新图片加载器
     ImageLoader::Update();
@@ -281,6 +473,12 @@ bool DownloadScreen::Update(Input &input) {
     // 更新主题管理器
     if (mThemeManager) {
         mThemeManager->Update();
+        SyncView();
+    }
+    
+    // 队列在后台装好了主题
+    if (InstallQueue::GetInstance().GetFinishedCount() != mInstallFinishedCount) {
+        ScanInstalledThemes();
     }
     
     // 输入冷却 - 从详情页面返回后等待15帧再处理输入
@@ -309,12 +507,7 @@ bool DownloadScreen::Update(Input &input) {
     }
     
     if (mState == STATE_SHOW_THEMES) {
-        const auto& themes = mThemeManager->GetThemes();
-        
-        // 确保动画向量大小与主题数量匹配
-        if (mThemeAnims.size() != themes.size()) {
-            InitAnimations(themes.size());
-        }
+        const int viewSize = GetViewSize();
         
         // 如果在输入冷却期,不处理输入
         if (inputCooldown) {
@@ -326,159 +519,100 @@ bool DownloadScreen::Update(Input &input) {
             return false;
         }
         
-        // X键刷新
+        // X键刷新: 有列表时在后台同步, 列表保持可用
         if (input.data.buttons_d & Input::BUTTON_X) {
-            mState = STATE_LOADING;
-            mThemeManager->ForceRefresh();
+            if (mThemeManager->GetThemes().empty()) {
+                mState = STATE_LOADING;
+                mThemeManager->ForceRefresh();
+            } else if (!mThemeManager->IsSyncing()) {
+                StartBackgroundSync();
+            }
             return true;
         }
         
-        // 触摸支持
-        if (input.data.touched && input.data.validPointer && !input.lastData.touched) {
-            // 转换触摸坐标 (DRC: 854x480 -> 1920x1080)
-            int touchX = (int)((input.data.x * 1920.0f / 1280.0f) + 960);
-            int touchY = (int)(540 - (input.data.y * 1080.0f / 720.0f));
-            
-            // 计算主题卡片的位置和大小（与 DrawThemeList 保持一致）
-            const int cardW = 1720;
-            const int cardH = 200;
-            const int listX = 100;
-            const int listY = 150;
-            const int spacing = 20;
-            const int visibleCount = 3;
-            
-            // 检查点击了哪个主题卡片
-            for (int i = 0; i < visibleCount && (mScrollOffset + i) < (int)themes.size(); i++) {
-                int themeIndex = mScrollOffset + i;
-                int cardX = listX;
-                int cardY = listY + i * (cardH + spacing);
-                
-                if (IsTouchInRect(touchX, touchY, cardX, cardY, cardW, cardH)) {
-                    // 如果点击已选中的主题，打开详情页
-                    if (themeIndex == mSelectedTheme) {
-                        // 创建详情屏幕
-                        mDetailScreen = new ThemeDetailScreen(&themes[mSelectedTheme], mThemeManager.get());
-                        
-                        // 创建输入对象
-                        CombinedInput detailBaseInput;
-                        VPadInput detailVpadInput;
-                        WPADInput detailWpadInputs[4] = {WPAD_CHAN_0, WPAD_CHAN_1, WPAD_CHAN_2, WPAD_CHAN_3};
-                        
-                        // 进入详情屏幕循环
-                        while (true) {
-                            detailBaseInput.reset();
-                            if (detailVpadInput.update(1280, 720)) {
-                                detailBaseInput.combine(detailVpadInput);
-                            }
-                            for (auto &wpadInput : detailWpadInputs) {
-                                if (wpadInput.update(1280, 720)) {
-                                    detailBaseInput.combine(wpadInput);
-                                }
-                            }
-                            detailBaseInput.process();
-                            
-                            if (!mDetailScreen->Update(detailBaseInput)) {
-                                break; // 返回主题列表
-                            }
-                            
-                            mDetailScreen->Draw();
-                            Gfx::Render();
-                        }
-                        
-                        // 清理详情屏幕
-                        delete mDetailScreen;
-                        mDetailScreen = nullptr;
-                        
-                        FileLogger::GetInstance().LogInfo("Returned from detail screen (touch), theme count: %zu", themes.size());
-                        
-                        // 验证选中索引是否仍然有效
-                        if (mSelectedTheme >= (int)themes.size()) {
-                            FileLogger::GetInstance().LogError("Selected theme index out of bounds! Resetting to 0");
-                            mSelectedTheme = 0;
-                            mScrollOffset = 0;
-                        }
-                        
-                        // 重新初始化动画以确保大小匹配
-                        if (mThemeAnims.size() != themes.size()) {
-                            FileLogger::GetInstance().LogInfo("Reinitializing animations after detail screen");
-                            InitAnimations(themes.size());
-                        }
-                        
-                        // 设置返回时间,启动输入冷却
-                        mReturnFromDetailFrame = mFrameCount;
-                        
-                        // 从详情屏返回后，立即返回以避免本帧的输入被重复处理
-                        return true;
-                    } else {
-                        // 否则选中该主题
-                        mPrevSelectedTheme = mSelectedTheme;
-                        mSelectedTheme = themeIndex;
-                        
-                        // 更新动画
-                        if (mPrevSelectedTheme >= 0 && mPrevSelectedTheme < (int)mThemeAnims.size()) {
-                            mThemeAnims[mPrevSelectedTheme].scaleAnim.SetTarget(1.0f, 300);
-                            mThemeAnims[mPrevSelectedTheme].highlightAnim.SetTarget(0.0f, 300);
-                        }
-                        if (mSelectedTheme >= 0 && mSelectedTheme < (int)mThemeAnims.size()) {
-                            mThemeAnims[mSelectedTheme].scaleAnim.SetTarget(1.05f, 300);
-                            mThemeAnims[mSelectedTheme].highlightAnim.SetTarget(1.0f, 300);
-                        }
-                    }
-                    break;
+        // Y键切换排序, L/R键切换标签过滤
+        if (input.data.buttons_d & Input::BUTTON_Y) {
+            CycleSortOrder();
+            return true;
+        }
+        if (input.data.buttons_d & (Input::BUTTON_L | Input::BUTTON_R)) {
+            CycleTagFilter((input.data.buttons_d & Input::BUTTON_R) ? 1 : -1);
+            return true;
+        }
+        
+        // 触摸: 拖动滚动列表, 松开后惯性滑行; 没有拖动的触摸是点击 (卡片区域在 DrawThemeList 中登记)
+        int touchX, touchY;
+        if (GetTouch(input, touchX, touchY)) {
+            if (!mScroll.IsDragging()) {
+                mScroll.TouchDown(touchY);
+                mTouchDownX = touchX;
+                mTouchDownY = touchY;
+            } else {
+                mScroll.TouchMove(touchY);
+            }
+        } else if (!input.data.touched && mScroll.IsDragging() && mScroll.TouchUp()) {
+            int themeIndex = mCardHits.Hit(mTouchDownX, mTouchDownY);
+            if (themeIndex >= 0 && themeIndex < viewSize) {
+                // 如果点击已选中的主题，打开详情页
+                if (themeIndex == mSelectedTheme) {
+                    OpenDetailScreen();
+                    return true;
                 }
+                // 否则选中该主题
+                mPrevSelectedTheme = mSelectedTheme;
+                mSelectedTheme = themeIndex;
+                
+                // 更新动画
+                mCardAnims.Select(mPrevSelectedTheme, mSelectedTheme);
+            }
+        }
+        
+        mScroll.Update();
+        mScrollOffset = mScroll.GetRestingRow();
+        
+        // 触摸滚动停下时选中项可能已经离开屏幕: 改为选中最近的可见卡片
+        if (mScroll.ConsumeTouchSettled()) {
+            int lastVisible = std::min(mScrollOffset + VISIBLE_ROWS, viewSize) - 1;
+            int nearest = std::max(mScrollOffset, std::min(mSelectedTheme, lastVisible));
+            if (nearest != mSelectedTheme) {
+                mPrevSelectedTheme = mSelectedTheme;
+                mSelectedTheme = nearest;
+                mCardAnims.Select(mPrevSelectedTheme, mSelectedTheme);
             }
         }
         
         // 保存旧的选择
         mPrevSelectedTheme = mSelectedTheme;
         
-        // 检测上下按键和摇杆输入(支持循环和长按连续)
+        // 检测上下按键和摇杆输入(支持循环和长按连续, 按住 0.5 秒后每 0.1 秒移动一次)
         bool upPressed = (input.data.buttons_d & Input::BUTTON_UP) || (input.data.buttons_d & Input::STICK_L_UP);
         bool downPressed = (input.data.buttons_d & Input::BUTTON_DOWN) || (input.data.buttons_d & Input::STICK_L_DOWN);
         bool upHeld = (input.data.buttons_h & Input::BUTTON_UP) || (input.data.buttons_h & Input::STICK_L_UP);
         bool downHeld = (input.data.buttons_h & Input::BUTTON_DOWN) || (input.data.buttons_h & Input::STICK_L_DOWN);
         
-        // 处理按下事件
-        if (upPressed || downPressed) {
-            mHoldFrames = 0;  // 重置计数器
-        }
-        
-        // 长按连续选择逻辑
-        bool shouldMoveUp = upPressed;
-        bool shouldMoveDown = downPressed;
-        
-        if (upHeld && !upPressed) {
-            mHoldFrames++;
-            if (mHoldFrames > mRepeatDelay) {
-                if ((mHoldFrames - mRepeatDelay) % mRepeatRate == 0) {
-                    shouldMoveUp = true;
-                }
-            }
-        } else if (downHeld && !downPressed) {
-            mHoldFrames++;
-            if (mHoldFrames > mRepeatDelay) {
-                if ((mHoldFrames - mRepeatDelay) % mRepeatRate == 0) {
-                    shouldMoveDown = true;
-                }
-            }
-        } else if (!upHeld && !downHeld) {
-            mHoldFrames = 0;
-        }
+        bool shouldMove = mKeyRepeat.Update(upPressed || downPressed, upHeld || downHeld);
+        bool shouldMoveUp = shouldMove && (upPressed || (!downPressed && upHeld));
+        bool shouldMoveDown = shouldMove && !shouldMoveUp;
         
         // 上下选择(支持循环)
-        const int themeCount = (int)themes.size();
+        const int themeCount = viewSize;
         if (shouldMoveUp) {
             if (mSelectedTheme > 0) {
                 mSelectedTheme--;
             } else {
                 // 循环到底部
                 mSelectedTheme = themeCount - 1;
-                mScrollOffset = std::max(0, themeCount - 3);
+                mScrollOffset = std::max(0, themeCount - VISIBLE_ROWS);
+                mScroll.Jump(mScrollOffset);
             }
             // 调整滚动
             if (mSelectedTheme < mScrollOffset) {
                 mScrollOffset = mSelectedTheme;
             }
+            if (mSelectedTheme >= mScrollOffset + VISIBLE_ROWS) {
+                mScrollOffset = mSelectedTheme - VISIBLE_ROWS + 1;
+            }
+            mScroll.ScrollTo(mScrollOffset);
         } else if (shouldMoveDown) {
             if (mSelectedTheme < themeCount - 1) {
                 mSelectedTheme++;
@@ -486,84 +620,32 @@ bool DownloadScreen::Update(Input &input) {
                 // 循环到顶部
                 mSelectedTheme = 0;
                 mScrollOffset = 0;
+                mScroll.Jump(0);
             }
-            // 调整滚动 (假设显示3个)
-            const int visibleCount = 3;
-            if (mSelectedTheme >= mScrollOffset + visibleCount) {
-                mScrollOffset = mSelectedTheme - visibleCount + 1;
+            // 调整滚动 (选中项滑行后可能在屏幕外, 两个方向都要检查)
+            if (mSelectedTheme >= mScrollOffset + VISIBLE_ROWS) {
+                mScrollOffset = mSelectedTheme - VISIBLE_ROWS + 1;
             }
+            if (mSelectedTheme < mScrollOffset) {
+                mScrollOffset = mSelectedTheme;
+            }
+            mScroll.ScrollTo(mScrollOffset);
+        }
+        
+        // 选中项或滑行停下的位置接近列表末尾时加载下一页 (过滤后结果很少时也会继续翻页, 让更多主题参与过滤)
+        if (std::max(mSelectedTheme, mScrollOffset + VISIBLE_ROWS - 1) >= themeCount - LOAD_MORE_THRESHOLD) {
+            mThemeManager->LoadMoreThemes();
         }
         
         // 如果选择改变，更新动画
         if (mPrevSelectedTheme != mSelectedTheme) {
-            // 重置旧的选择
-            if (mPrevSelectedTheme >= 0 && mPrevSelectedTheme < (int)mThemeAnims.size()) {
-                mThemeAnims[mPrevSelectedTheme].scaleAnim.SetTarget(1.0f, 300);
-                mThemeAnims[mPrevSelectedTheme].highlightAnim.SetTarget(0.0f, 300);
-            }
-            
-            // 高亮新的选择
-            if (mSelectedTheme >= 0 && mSelectedTheme < (int)mThemeAnims.size()) {
-                mThemeAnims[mSelectedTheme].scaleAnim.SetTarget(1.05f, 300);
-                mThemeAnims[mSelectedTheme].highlightAnim.SetTarget(1.0f, 300);
-            }
+            mCardAnims.Select(mPrevSelectedTheme, mSelectedTheme);
         }
         
         // A键打开主题详情
         if (input.data.buttons_d & Input::BUTTON_A) {
-            if (mSelectedTheme < (int)themes.size()) {
-                // 创建详情屏幕
-                mDetailScreen = new ThemeDetailScreen(&themes[mSelectedTheme], mThemeManager.get());
-                
-                // 创建输入对象
-                CombinedInput detailBaseInput;
-                VPadInput detailVpadInput;
-                WPADInput detailWpadInputs[4] = {WPAD_CHAN_0, WPAD_CHAN_1, WPAD_CHAN_2, WPAD_CHAN_3};
-                
-                // 进入详情屏幕循环
-                while (true) {
-                    detailBaseInput.reset();
-                    if (detailVpadInput.update(1280, 720)) {
-                        detailBaseInput.combine(detailVpadInput);
-                    }
-                    for (auto &wpadInput : detailWpadInputs) {
-                        if (wpadInput.update(1280, 720)) {
-                            detailBaseInput.combine(wpadInput);
-                        }
-                    }
-                    detailBaseInput.process();
-                    
-                    if (!mDetailScreen->Update(detailBaseInput)) {
-                        break; // 返回主题列表
-                    }
-                    
-                    mDetailScreen->Draw();
-                    Gfx::Render();
-                }
-                
-                // 清理详情屏幕
-                delete mDetailScreen;
-                mDetailScreen = nullptr;
-                
-                FileLogger::GetInstance().LogInfo("Returned from detail screen, theme count: %zu", themes.size());
-                
-                // 验证选中索引是否仍然有效
-                if (mSelectedTheme >= (int)themes.size()) {
-                    FileLogger::GetInstance().LogError("Selected theme index out of bounds! Resetting to 0");
-                    mSelectedTheme = 0;
-                    mScrollOffset = 0;
-                }
-                
-                // 重新初始化动画以确保大小匹配
-                if (mThemeAnims.size() != themes.size()) {
-                    FileLogger::GetInstance().LogInfo("Reinitializing animations after detail screen");
-                    InitAnimations(themes.size());
-                }
-                
-                // 设置返回时间,启动输入冷却
-                mReturnFromDetailFrame = mFrameCount;
-                
-                // 从详情屏返回后，立即返回以避免本帧的输入被重复处理
+            if (mSelectedTheme < viewSize) {
+                OpenDetailScreen();
                 return true;
             }
         }
@@ -593,9 +675,11 @@ bool DownloadScreen::Update(Input &input) {
 }
 
 void DownloadScreen::DrawThemeList() {
-    const auto& themes = mThemeManager->GetThemes();
+    SyncView();
+    const int viewSize = GetViewSize();
+    mCardHits.Clear();
     
-    if (themes.empty()) {
+    if (viewSize == 0) {
         // 没有主题
         const int cardW = 800;
         const int cardH = 300;
@@ -608,7 +692,7 @@ void DownloadScreen::DrawThemeList() {
         Gfx::DrawRectRounded(cardX, cardY, cardW, cardH, 20, Gfx::COLOR_CARD_BG);
         
         Gfx::DrawIcon(cardX + cardW/2, cardY + 100, 70, Gfx::COLOR_WARNING, 0xf071, Gfx::ALIGN_CENTER);
-        Gfx::Print(cardX + cardW/2, cardY + 190, 44, Gfx::COLOR_TEXT, "No themes found", Gfx::ALIGN_CENTER);
+        Gfx::Print(cardX + cardW/2, cardY + 190, 44, Gfx::COLOR_TEXT, _("download.no_themes"), Gfx::ALIGN_CENTER);
         return;
     }
     
@@ -618,37 +702,242 @@ void DownloadScreen::DrawThemeList() {
     const int cardW = 1720;
     const int cardH = 200;
     const int cardSpacing = 20;
-    const int visibleCount = 3;
-    
-    int currentY = listY;
-    int endIndex = std::min(mScrollOffset + visibleCount, (int)themes.size());
+    const int visibleCount = VISIBLE_ROWS;
     
-    for (int i = mScrollOffset; i < endIndex; i++) {
+    // 滚动位置是小数: 从最上面露出一部分的卡片画到最下面露出一部分的卡片, 裁剪到列表区域
+    // (上下留出选中放大、发光和阴影的边距, 停在整行上时和不裁剪时一样)
+    const float position = mScroll.GetPosition();
+    const int firstRow = mScroll.GetFirstRow();
+    SDL_Rect listClip = {0, listY - cardSpacing, Gfx::SCREEN_WIDTH, visibleCount * (cardH + cardSpacing) + cardSpacing};
+    SDL_RenderSetClipRect(Gfx::GetRenderer(), &listClip);
+    for (int i = std::max(0, firstRow); i < std::min(firstRow + visibleCount + 1, viewSize); i++) {
         bool selected = (i == mSelectedTheme);
-        // 需要非 const 访问来修改缩略图状态
-        auto& themesVec = const_cast<std::vector<Theme>&>(themes);
-        DrawThemeCard(listX, currentY, cardW, cardH, themesVec[i], selected, i);
-        currentY += cardH + cardSpacing;
+        int cardY = listY + (int)std::lround((i - position) * (cardH + cardSpacing));
+        DrawThemeCard(listX, cardY, cardW, cardH, GetViewTheme(i), selected, i);
+        SDL_Rect cardRect = {listX, cardY, cardW, cardH};
+        SDL_Rect hitRect;
+        if (SDL_IntersectRect(&cardRect, &listClip, &hitRect)) {
+            mCardHits.Add(i, hitRect);
+        }
+    }
+    SDL_RenderSetClipRect(Gfx::GetRenderer(), nullptr);
+    
+    // 优先级和预取按停下的位置计算: 滑行中就开始加载最终会停在屏幕上的缩略图, 而不是途中一闪而过的
+    int endIndex = std::min(mScrollOffset + visibleCount, viewSize);
+    if (mScrollOffset != mPriorityScrollOffset) {
+        if (mPriorityScrollOffset >= 0) {
+            mScrollDirection = (mScrollOffset > mPriorityScrollOffset) ? 1 : -1;
+        }
+        UpdateThumbnailPriorities(mScrollOffset, endIndex);
+        // 未选中卡片的缩略图尺寸, 和 DrawThemeCard 中的请求一致
+        const int thumbH = cardH - 40;
+        PrefetchThumbnails(mScrollOffset, endIndex, (int)(thumbH * 16.0f / 9.0f), thumbH);
+        mPriorityScrollOffset = mScrollOffset;
+    }
+    
+    // 记下选中的主题, 同步改变列表顺序后按 uuid 找回
+    if (mSelectedTheme >= 0 && mSelectedTheme < viewSize) {
+        mSelectedThemeId = GetViewTheme(mSelectedTheme).id;
+    }
+    
+    // 选中项停留一段时间后, 在空闲时预加载它的高清预览图
+    if (mSelectedTheme != mHdPreloadTheme) {
+        CancelHdPreload();
+        mHdPreloadTheme = mSelectedTheme;
+        mHdPreloadFrame = mFrameCount;
+        mHdPreloadStarted = false;
+        mHdPreloadDetailsRequested = false;
+    } else if (!mHdPreloadStarted && mFrameCount - mHdPreloadFrame >= HD_PRELOAD_DELAY_FRAMES &&
+               mSelectedTheme < viewSize) {
+        // 高清图地址在详情中, 先获取详情 (打开详情页时也就不用再等)
+        const Theme& theme = GetViewTheme(mSelectedTheme);
+        if (theme.detailsLoaded) {
+            PreloadHdPreviews(mSelectedTheme);
+            mHdPreloadStarted = true;
+        } else if (!mThemeManager->IsFetchingDetails(theme.id)) {
+            if (mHdPreloadDetailsRequested) {
+                mHdPreloadStarted = true; // 获取失败, 不再重试
+            } else {
+                mThemeManager->FetchThemeDetails(theme.id);
+                mHdPreloadDetailsRequested = true;
+            }
+        }
     }
     
     // 绘制滚动指示器
-    if (themes.size() > visibleCount) {
+    if (viewSize > visibleCount) {
         char scrollInfo[32];
-        snprintf(scrollInfo, sizeof(scrollInfo), "%d / %zu", mSelectedTheme + 1, themes.size());
+        snprintf(scrollInfo, sizeof(scrollInfo), "%d / %d", mSelectedTheme + 1, viewSize);
         Gfx::Print(Gfx::SCREEN_WIDTH - 100, Gfx::SCREEN_HEIGHT - 150, 32, Gfx::COLOR_ALT_TEXT, 
                   scrollInfo, Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
     }
+    
+    // 当前的排序和标签过滤
+    static constexpr LanguageManager::TextKey sortKeys[ThemeCatalogIndex::SORT_COUNT] = {
+        "download.sort_default", "download.sort_downloads", "download.sort_likes", "download.sort_updated"
+    };
+    const auto& tagFilter = mCatalog.GetTagFilter();
+    std::string_view viewInfo = FrameArena::Format("%s: %s   %s: %s", _("download.sort").c_str(), _(sortKeys[mCatalog.GetSort()]).c_str(),
+                                                   _("download.tag").c_str(),
+                                                   tagFilter.empty() ? _("download.tag_all").c_str() : tagFilter[0].c_str());
+    Gfx::Print(listX, Gfx::SCREEN_HEIGHT - 150, 32, Gfx::COLOR_ALT_TEXT, viewInfo, Gfx::ALIGN_VERTICAL);
+    
+    // 后台同步状态: 显示的是缓存时说明正在确认或无法连接
+    if (mThemeManager->IsSyncing()) {
+        Gfx::Print(Gfx::SCREEN_WIDTH - 300, Gfx::SCREEN_HEIGHT - 150, 28, Gfx::COLOR_ALT_TEXT,
+                   _("download.syncing"), Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
+    } else if (mOffline) {
+        Gfx::Print(Gfx::SCREEN_WIDTH - 300, Gfx::SCREEN_HEIGHT - 150, 28, Gfx::COLOR_WARNING,
+                   _("download.offline"), Gfx::ALIGN_VERTICAL | Gfx::ALIGN_RIGHT);
+    }
+}
+
+void DownloadScreen::UpdateThumbnailPriorities(int visibleStart, int visibleEnd) {
+    const auto& themes = mThemeManager->GetThemes();
+    const auto& view = mCatalog.GetView();
+    
+    // 可见的位置换算成主题下标; 被过滤掉的主题一律降级
+    std::vector<bool> visible(themes.size(), false);
+    for (int i = std::max(0, visibleStart); i < visibleEnd && i < (int)view.size(); i++) {
+        visible[view[i]] = true;
+    }
+    
+    for (int i = 0; i < (int)themes.size(); i++) {
+        const auto& preview = themes[i].collagePreview;
+        // 只处理已请求但还没拿到纹理的缩略图
+        if (!preview.thumbLoaded || preview.thumbInAtlas || preview.thumbUrl.empty()) {
+            continue;
+        }
+        
+        ImageLoader::SetPriority(preview.thumbUrl, visible[i] ? DownloadPriority::HIGH : DownloadPriority::LOW);
+    }
+}
+
+void DownloadScreen::PrefetchThumbnails(int visibleStart, int visibleEnd, int thumbW, int thumbH) {
+    auto& themes = mThemeManager->GetThemes();
+    const auto& view = mCatalog.GetView();
+    int count = (int)view.size();
+    
+    // 滚动方向上预取 PREFETCH_ROWS 行, 反方向只预取 PREFETCH_BEHIND_ROWS 行
+    int ahead = (mScrollDirection >= 0) ? PREFETCH_ROWS : PREFETCH_BEHIND_ROWS;
+    int behind = (mScrollDirection >= 0) ? PREFETCH_BEHIND_ROWS : PREFETCH_ROWS;
+    int prefetchStart = std::max(0, visibleStart - behind);
+    int prefetchEnd = std::min(count, visibleEnd + ahead);
+    
+    // 窗口内 (包括可见的卡片) 还没有详情的主题合并成批量请求, 选中后打开详情页或预加载高清图时不用再等
+    std::vector<std::string> detailIds;
+    for (int i = prefetchStart; i < prefetchEnd; i++) {
+        Theme& theme = themes[view[i]];
+        if (!theme.detailsLoaded) {
+            detailIds.push_back(theme.id);
+        }
+        // 已经画出来的卡片在绘制时已请求; 滑行停下时可见但还没画到的卡片按普通优先级请求, 其余的是预取
+        if (!theme.collagePreview.thumbUrl.empty() && !theme.collagePreview.thumbLoaded) {
+            bool resting = i >= visibleStart && i < visibleEnd;
+            RequestThumbnail(theme, thumbW, thumbH, false, !resting);
+        }
+    }
+    mThemeManager->PrefetchThemeDetails(detailIds);
+    
+    // 离可见范围太远 (或已被过滤掉) 的缩略图如果还在排队或下载, 取消以免占用连接
+    std::vector<bool> keep(themes.size(), false);
+    for (int i = std::max(0, visibleStart - PREFETCH_CANCEL_ROWS); i < visibleEnd + PREFETCH_CANCEL_ROWS && i < count; i++) {
+        keep[view[i]] = true;
+    }
+    for (int i = 0; i < (int)themes.size(); i++) {
+        auto& preview = themes[i].collagePreview;
+        if (keep[i]) {
+            continue;
+        }
+        if (preview.thumbLoaded && !preview.thumbInAtlas && !preview.thumbUrl.empty() &&
+            ImageLoader::CancelLoad(preview.thumbUrl, &mImageOwner)) {
+            preview.thumbLoaded = false; // 再次接近时重新请求
+        }
+    }
 }
 
-void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, bool selected, int themeIndex) {
-    // 获取动画值
-    float scale = 1.0f;
-    float highlight = 0.0f;
-    if (themeIndex >= 0 && themeIndex < (int)mThemeAnims.size()) {
-        scale = mThemeAnims[themeIndex].scaleAnim.GetValue();
-        highlight = mThemeAnims[themeIndex].highlightAnim.GetValue();
+void DownloadScreen::WarmUp() {
+    // 和 DrawThemeList 中未选中卡片的缩略图尺寸一致, 否则打开时不能命中图集
+    const int thumbH = 200 - 40;
+    ThemeManager::PrefetchCache(WARMUP_THUMBNAILS, (int)(thumbH * 16.0f / 9.0f), thumbH);
+}
+
+void DownloadScreen::PreloadHdPreviews(int position) {
+    if (position < 0 || position >= GetViewSize()) {
+        return;
     }
     
+    // 不带回调: 完成后纹理进入缓存, 打开详情页时直接命中;
+    // 打开时还没下载完的请求会和详情页的请求合并并提升为高优先级
+    const Theme& theme = GetViewTheme(position);
+    const ThemeDetails& details = theme.GetDetails();
+    for (const ThemeImage* image : {&theme.collagePreview, &details.launcherScreenshot, &details.waraWaraScreenshot}) {
+        if (image->hdUrl.empty() || image->hdTexture.Get()) {
+            continue;
+        }
+        ImageLoader::LoadRequest request;
+        request.url = image->hdUrl;
+        request.lowPriority = true;
+        request.usefulMs = HD_PRELOAD_USEFUL_MS;
+        ImageLoader::LoadAsync(request);
+        mHdPreloadUrls.push_back(image->hdUrl);
+    }
+}
+
+void DownloadScreen::CancelHdPreload() {
+    // 已经在解码的请求无法取消, 完成后照常进入缓存
+    for (const auto& url : mHdPreloadUrls) {
+        ImageLoader::CancelLoad(url);
+    }
+    mHdPreloadUrls.clear();
+}
+
+void DownloadScreen::RequestThumbnail(Theme& theme, int thumbW, int thumbH, bool highPriority, bool lowPriority) {
+    // 标记为正在加载
+    theme.collagePreview.thumbLoaded = true;
+    
+    // 异步加载 - 使用 ThemeManager 和索引来避免引用失效
+    ImageLoader::LoadRequest request;
+    request.url = theme.collagePreview.thumbUrl;
+    request.highPriority = highPriority;
+    request.lowPriority = lowPriority;
+    request.targetWidth = thumbW;    // 直接解码到卡片大小
+    request.targetHeight = thumbH;
+    request.atlas = true;            // 打包进图集, 列表共用几张大纹理
+    request.owner = &mImageOwner;
+    request.callback = [this, themeId = theme.id](SDL_Texture* texture) {
+        // 通过 uuid 查找主题, 同步或刷新后索引可能已经改变
+        if (!mThemeManager) {
+            DEBUG_FUNCTION_LINE("ThemeManager is null in callback!");
+            return;
+        }
+        
+        Theme* target = mThemeManager->FindTheme(themeId);
+        if (target) {
+            target->collagePreview.thumbInAtlas = (texture != nullptr);
+            DEBUG_FUNCTION_LINE("Set texture for theme %s: %p", themeId.c_str(), texture);
+            
+            if (texture) {
+                FileLogger::GetInstance().LogInfo("Image loaded for theme %s", target->name.c_str());
+            } else {
+                FileLogger::GetInstance().LogError("Failed to load image for theme %s", themeId.c_str());
+            }
+        } else {
+            DEBUG_FUNCTION_LINE("Theme no longer in list: %s", themeId.c_str());
+        }
+    };
+    ImageLoader::LoadAsync(request);
+}
+
+void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, bool selected, int position) {
+    // 获取动画值; 刚到达的卡片从下方滑入并放大到原来的尺寸
+    float appear = mCardAnims.GetAppear(position);
+    float scale = mCardAnims.GetScale(position) * (0.9f + 0.1f * appear);
+    float highlight = mCardAnims.GetHighlight(position);
+    const int baseW = w;
+    const int baseH = h;
+    y += (int)(CARD_APPEAR_OFFSET * (1.0f - appear));
+    
     // 应用缩放
     int scaledW = (int)(w * scale);
     int scaledH = (int)(h * scale);
@@ -672,9 +961,46 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
         Gfx::DrawRectRounded(x - 4, y - 4, w + 8, h + 8, 20, glowColor);
     }
     
-    // 绘制卡片背景
-    SDL_Color bgColor = selected ? Gfx::COLOR_CARD_HOVER : Gfx::COLOR_CARD_BG;
-    Gfx::DrawRectRounded(x, y, w, h, 16, bgColor);
+    // 缩略图在图集中, 所在页被淘汰时重新加载 (GetAtlasSprite 同时标记它正在显示, 使用缓存的卡片时也要每帧调用)
+    ImageLoader::AtlasSprite thumbSprite;
+    ThemeImage& preview = theme.collagePreview;
+    if (preview.thumbInAtlas) {
+        if (ImageLoader::GetAtlasSprite(preview.thumbUrl, thumbSprite)) {
+            mThemeManager->SetPlaceholderColor(theme, thumbSprite.averageColor);
+        } else {
+            preview.thumbInAtlas = false;
+            preview.thumbLoaded = false;
+        }
+    }
+    
+    // 目录缓存中有缩略图的颜色时先用它占位, 没有加载动画; 请求在这里发出, 卡片照常缓存
+    bool placeholder = !preview.thumbInAtlas && !preview.thumbUrl.empty() && preview.placeholderColor != 0;
+    if (placeholder && !preview.thumbLoaded) {
+        const int thumbH = baseH - 40;
+        RequestThumbnail(theme, (int)(thumbH * 16.0f / 9.0f), thumbH, selected, false);
+    }
+    
+    // 卡片内容缓存为纹理; 缩略图加载中时有旋转动画, 直接绘制
+    bool thumbLoading = !preview.thumbInAtlas && !preview.thumbUrl.empty() && !preview.thumbLoaded;
+    bool installed = !theme.id.empty() && mInstalledThemeIds.find(theme.id) != mInstalledThemeIds.end();
+    bool cached = false;
+    if (!thumbLoading) {
+        uint64_t signature = CardTextureCache::SIGNATURE_SEED;
+        signature = CardTextureCache::Mix(signature, theme.display.name);
+        signature = CardTextureCache::Mix(signature, theme.display.author);
+        signature = CardTextureCache::Mix(signature, theme.display.description);
+        signature = CardTextureCache::Mix(signature, (uint64_t)theme.downloads << 32 | (uint32_t)theme.likes);
+        signature = CardTextureCache::Mix(signature, (uint64_t)installed << 1 | (uint64_t)selected);
+        signature = CardTextureCache::Mix(signature, (uint64_t)(uintptr_t)thumbSprite.texture);
+        signature = CardTextureCache::Mix(signature, (uint64_t)(uint32_t)thumbSprite.rect.x << 32 | (uint32_t)thumbSprite.rect.y);
+        signature = CardTextureCache::Mix(signature, (uint64_t)(placeholder ? preview.placeholderColor : 0));
+        signature = CardTextureCache::Mix(signature, Lang().GetCurrentLanguage());
+        cached = mCardCache.Draw(theme.id.empty() ? theme.name : theme.id.str(), signature, baseW, baseH, SDL_Rect{x, y, w, h},
+                                 [&]() { DrawThemeCardContent(0, 0, baseW, baseH, theme, selected, installed, thumbSprite); });
+    }
+    if (!cached) {
+        DrawThemeCardContent(x, y, w, h, theme, selected, installed, thumbSprite);
+    }
     
     // 绘制边框(如果选中)
     if (selected) {
@@ -682,6 +1008,14 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
         borderColor.a = (uint8_t)(150 + 100 * highlight);
         Gfx::DrawRectRoundedOutline(x, y, w, h, 16, 3, borderColor);
     }
+}
+
+// 卡片的背景、缩略图、文字和标签, 不含随选中动画变化的部分
+void DownloadScreen::DrawThemeCardContent(int x, int y, int w, int h, Theme& theme, bool selected, bool installed,
+                                          const ImageLoader::AtlasSprite& thumbSprite) {
+    // 绘制卡片背景
+    SDL_Color bgColor = selected ? Gfx::COLOR_CARD_HOVER : Gfx::COLOR_CARD_BG;
+    Gfx::DrawRectRounded(x, y, w, h, 16, bgColor);
     
     // 左侧缩略图区域 - 16:9 比例
     const int thumbH = h - 40;
@@ -690,13 +1024,12 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
     const int thumbY = y + 20;
     
     // 绘制缩略图
-    if (theme.collagePreview.thumbTexture) {
-        // 已加载,绘制纹理
+    if (theme.collagePreview.thumbInAtlas) {
+        // 已加载,绘制图集中的区域
         SDL_Rect dstRect = {thumbX, thumbY, thumbW, thumbH};
         
-        // 获取纹理尺寸
-        int texW, texH;
-        SDL_QueryTexture(theme.collagePreview.thumbTexture, nullptr, nullptr, &texW, &texH);
+        // 获取图片尺寸
+        int texW = thumbSprite.rect.w, texH = thumbSprite.rect.h;
         
         // 计算缩放以保持纵横比
         float scale = std::min((float)thumbW / texW, (float)thumbH / texH);
@@ -712,8 +1045,13 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
         // 背景
         Gfx::DrawRectFilled(thumbX, thumbY, thumbW, thumbH, Gfx::COLOR_ALT_BACKGROUND);
         
-        // 绘制纹理
-        SDL_RenderCopy(Gfx::GetRenderer(), theme.collagePreview.thumbTexture, nullptr, &dstRect);
+        // 绘制纹理 (相邻的卡片使用同一张纹理)
+        Gfx::DrawTexture(thumbSprite.texture, &thumbSprite.rect, dstRect);
+        
+    } else if (!theme.collagePreview.thumbUrl.empty() && theme.collagePreview.placeholderColor != 0) {
+        // 还在加载, 用上次记下的平均颜色占位 (请求已在 DrawThemeCard 中发出)
+        uint32_t color = theme.collagePreview.placeholderColor;
+        Gfx::DrawRectFilled(thumbX, thumbY, thumbW, thumbH, SDL_Color{(uint8_t)(color >> 16), (uint8_t)(color >> 8), (uint8_t)color, 255});
         
     } else if (!theme.collagePreview.thumbUrl.empty() && !theme.collagePreview.thumbLoaded) {
         // 还未加载,显示占位符并异步加载
@@ -727,36 +1065,8 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
         Gfx::Print(thumbX + thumbW/2, thumbY + thumbH/2 + 30, 24, Gfx::COLOR_ALT_TEXT, 
                   _("download.loading_image"), Gfx::ALIGN_CENTER);
         
-        // 标记为正在加载
-        theme.collagePreview.thumbLoaded = true;
-        
-        // 异步加载 - 使用 ThemeManager 和索引来避免引用失效
-        ImageLoader::LoadRequest request;
-        request.url = theme.collagePreview.thumbUrl;
-        request.highPriority = selected; // 选中的优先加载
-        request.callback = [this, themeIndex](SDL_Texture* texture) {
-            // 通过索引访问主题,避免引用失效
-            if (!mThemeManager) {
-                DEBUG_FUNCTION_LINE("ThemeManager is null in callback!");
-                return;
-            }
-            
-            auto& themes = mThemeManager->GetThemes();
-            if (themeIndex >= 0 && themeIndex < (int)themes.size()) {
-                themes[themeIndex].collagePreview.thumbTexture = texture;
-                DEBUG_FUNCTION_LINE("Set texture for theme %d: %p", themeIndex, texture);
-                
-                if (texture) {
-                    FileLogger::GetInstance().LogInfo("Image loaded for theme %d: %s", 
-                        themeIndex, themes[themeIndex].name.c_str());
-                } else {
-                    FileLogger::GetInstance().LogError("Failed to load image for theme %d", themeIndex);
-                }
-            } else {
-                DEBUG_FUNCTION_LINE("Invalid theme index in callback: %d (total: %zu)", themeIndex, themes.size());
-            }
-        };
-        ImageLoader::LoadAsync(request);
+        // 异步加载, 选中的优先加载
+        RequestThumbnail(theme, thumbW, thumbH, selected, false);
         
     } else {
         // 没有缩略图URL,显示默认图标
@@ -768,44 +1078,28 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
     const int infoX = thumbX + thumbW + 30;
     const int infoY = y + 30;
     
-    // 主题名称 - 清理特殊字符用于显示
-    std::string displayName = Utils::SanitizeThemeNameForDisplay(theme.name);
+    // 名称、作者、截断后的描述和统计数在解析时已经生成 (ThemeManager::BuildDisplayStrings)
+    const ThemeDisplay& display = theme.display;
     SDL_Color titleColor = selected ? Gfx::COLOR_WHITE : Gfx::COLOR_TEXT;
-    Gfx::Print(infoX, infoY, 42, titleColor, displayName.c_str(), Gfx::ALIGN_VERTICAL);
+    Gfx::PrintStatic(infoX, infoY, 42, titleColor, display.name, Gfx::ALIGN_VERTICAL);
     
     // 作者
     SDL_Color authorColor = Gfx::COLOR_ALT_TEXT;
-    Gfx::Print(infoX, infoY + 55, 32, authorColor, 
-              (std::string("by ") + theme.author).c_str(), Gfx::ALIGN_VERTICAL);
-    
-    // 描述(截断) - 限制到一行
-    std::string desc = theme.description;
-    if (desc.empty()) {
-        desc = "No description available";
-    }
-    
-    // 移除换行符
-    size_t newlinePos = desc.find('\n');
-    if (newlinePos != std::string::npos) {
-        desc = desc.substr(0, newlinePos);
-    }
+    Gfx::PrintStatic(infoX, infoY + 55, 32, authorColor, display.author, Gfx::ALIGN_VERTICAL);
     
-    // 限制描述长度到50字符以防止重叠
-    if (desc.length() > 50) {
-        desc = desc.substr(0, 47) + "...";
-    }
-    Gfx::Print(infoX, infoY + 100, 26, authorColor, desc.c_str(), Gfx::ALIGN_VERTICAL);
+    // 描述 - 只有一行, 按显示宽度截断 (不会切开中日文字符)
+    Gfx::PrintStatic(infoX, infoY + 100, 26, authorColor, display.description, Gfx::ALIGN_VERTICAL);
     
     // 统计信息 - 移到更靠下的位置
     const int statsY = y + h - 40;
     Gfx::DrawIcon(infoX, statsY, 24, Gfx::COLOR_ICON, 0xf019, Gfx::ALIGN_VERTICAL);
-    Gfx::Print(infoX + 35, statsY, 28, authorColor, std::to_string(theme.downloads).c_str(), Gfx::ALIGN_VERTICAL);
+    Gfx::Print(infoX + 35, statsY, 28, authorColor, display.downloads, Gfx::ALIGN_VERTICAL);
     
     Gfx::DrawIcon(infoX + 150, statsY, 24, Gfx::COLOR_WARNING, 0xf004, Gfx::ALIGN_VERTICAL);
-    Gfx::Print(infoX + 185, statsY, 28, authorColor, std::to_string(theme.likes).c_str(), Gfx::ALIGN_VERTICAL);
+    Gfx::Print(infoX + 185, statsY, 28, authorColor, display.likes, Gfx::ALIGN_VERTICAL);
     
-    // 检查是否已下载/已安装 (使用缓存,避免频繁磁盘IO)
-    if (!theme.id.empty() && mInstalledThemeIds.find(theme.id) != mInstalledThemeIds.end()) {
+    // 已下载/已安装 (使用缓存,避免频繁磁盘IO)
+    if (installed) {
         // 绘制"已下载"标签在右上角
         const int badgeW = 140;
         const int badgeH = 45;
@@ -828,26 +1122,9 @@ void DownloadScreen::DrawThemeCard(int x, int y, int w, int h, Theme& theme, boo
 
 // 扫描已安装的主题
 void DownloadScreen::ScanInstalledThemes() {
-    mInstalledThemeIds.clear();
-    
-    const char* installedDir = "fs:/vol/external01/UTheme/installed";
-    DIR* dir = opendir(installedDir);
-    if (!dir) {
-        FileLogger::GetInstance().LogInfo("DownloadScreen: installed directory not found");
-        return;
-    }
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string filename = entry->d_name;
-        // 检查是否是 .json 文件
-        if (filename.length() > 5 && filename.substr(filename.length() - 5) == ".json") {
-            // 提取主题ID (去掉 .json 后缀)
-            std::string themeId = filename.substr(0, filename.length() - 5);
-            mInstalledThemeIds.insert(themeId);
-        }
-    }
-    closedir(dir);
+    // 已安装主题的登记表在内存中, 不用每次打开界面都读 installed 目录
+    mInstallFinishedCount = InstallQueue::GetInstance().GetFinishedCount();
+    mInstalledThemeIds = ThemeRegistry::GetInstance().GetInstalledIDs();
     
     FileLogger::GetInstance().LogInfo("DownloadScreen: Found %zu installed themes", mInstalledThemeIds.size());
 }
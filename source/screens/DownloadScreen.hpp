@@ -1,7 +1,13 @@
 #pragma once
 #include "Screen.hpp"
 #include "../utils/Animation.hpp"
+#include "../utils/ListItemAnimator.hpp"
 #include "../utils/ThemeManager.hpp"
+#include "../utils/ThemeCatalogIndex.hpp"
+#include "../utils/ImageLoader.hpp"
+#include "../utils/CardTextureCache.hpp"
+#include "../utils/HitGrid.hpp"
+#include "../utils/ScrollController.hpp"
 #include <memory>
 #include <set>
 
@@ -13,6 +19,18 @@ public:
     void Draw() override;
     bool Update(Input &input) override;
 
+    // 详情页打开时内存不足: 丢弃卡片纹理 (缩略图由 ImageLoader 自己淘汰)
+    size_t ReleaseHiddenResources() override { return mCardCache.Clear(); }
+
+    // 基准测试用: 目录已显示 / 加载失败, 列表长度和选中项
+    bool IsListReady() const { return mState == STATE_SHOW_THEMES; }
+    bool HasLoadError() const { return mState == STATE_ERROR; }
+    int GetListSize() const { return GetViewSize(); }
+    int GetSelectedIndex() const { return mSelectedTheme; }
+    
+    // 菜单上停留在"下载主题"时调用: 后台读取目录缓存, 并把最前面几张已在磁盘上的缩略图加载进图集
+    static void WarmUp();
+
 private:
     enum State {
         STATE_INIT,
@@ -30,31 +48,68 @@ private:
     int mFrameCount = 0;
     int mDownloadStartFrame = 0;  // 下载开始的帧数
     int mReturnFromDetailFrame = 0;  // 从详情页面返回的帧数
+    bool mOffline = false;           // 最近一次同步失败, 显示的是缓存的列表
     Animation mTitleAnim;
     
     // 主题管理
     std::unique_ptr<ThemeManager> mThemeManager;
+    
+    // 列表显示的是目录索引的视图 (排序、按标签过滤后的主题下标),
+    // 下面的选中项、滚动位置、卡片动画和预加载都是视图中的位置
+    ThemeCatalogIndex mCatalog;
     int mSelectedTheme = 0;
     int mPrevSelectedTheme = 0;
-    int mScrollOffset = 0;
+    int mScrollOffset = 0;           // 停下时最上面的行 (滑行中是预测的停止位置), 卡片按 mScroll 的小数位置绘制
+    int mPriorityScrollOffset = -1;  // 上次调整下载优先级时的滚动位置
+    int mScrollDirection = 1;        // 最近一次滚动的方向 (1 向下, -1 向上)
+    uint32_t mViewVersion = 0;       // 上次看到的视图版本
+    std::string mSelectedThemeId;    // 选中主题的 uuid (视图重新排序后用来找回选中项)
+    
+    // 缩略图预取 (按行计算, 每行一个主题)
+    static constexpr int PREFETCH_ROWS = 6;         // 滚动方向上提前加载的行数
+    static constexpr int PREFETCH_BEHIND_ROWS = 1;  // 反方向提前加载的行数
+    static constexpr int PREFETCH_CANCEL_ROWS = 12; // 超出可见范围这么多行时取消未完成的下载
+    static constexpr int LOAD_MORE_THRESHOLD = 10;  // 选中项离末尾不到这么多行时加载下一页主题
+    static constexpr size_t WARMUP_THUMBNAILS = 6;  // 菜单预热时加载的缩略图数 (第一屏和下一屏)
+    static constexpr int CARD_APPEAR_OFFSET = 60;   // 新到达的卡片滑入的距离
+    static constexpr int VISIBLE_ROWS = 3;
+    static constexpr int ROW_HEIGHT = 220;          // 卡片高度加间距, 和 DrawThemeList 的布局一致
     
-    // 长按连续选择
-    int mHoldFrames = 0;
-    int mRepeatDelay = 30;  // 初始延迟帧数 (约0.5秒)
-    int mRepeatRate = 6;    // 重复间隔帧数 (约0.1秒)
+    // 选中主题的高清预览图预加载
+    static constexpr int HD_PRELOAD_DELAY_FRAMES = 30; // 选中项停留约 0.5 秒后开始
+    static constexpr int HD_PRELOAD_USEFUL_MS = 10000;  // 这么久还没开始下载 (网络忙) 时放弃, 不占用之后的带宽
+    int mHdPreloadTheme = -1;          // 正在计时或已预加载的主题
+    int mHdPreloadFrame = 0;           // 选中该主题时的帧数
+    bool mHdPreloadStarted = false;
+    bool mHdPreloadDetailsRequested = false; // 已为预加载请求过主题详情
+    std::vector<std::string> mHdPreloadUrls; // 已发出的预加载请求 (换选中项时取消)
+    ImageLoader::Owner mImageOwner;          // 缩略图请求的回调引用了 this
+    
+    // 长按连续选择和触摸滚动
+    KeyRepeat mKeyRepeat;
+    ScrollController mScroll{(float)ROW_HEIGHT};
+    int mTouchDownX = 0;    // 按下的位置, 松开时是点击则按它选中卡片
+    int mTouchDownY = 0;
     
     // 已安装主题缓存(用于快速检查,避免频繁磁盘IO)
     std::set<std::string> mInstalledThemeIds;
+    uint32_t mInstallFinishedCount = 0;  // InstallQueue 的完成计数, 变化时重新扫描
     
-    // 详情屏幕
-    class ThemeDetailScreen* mDetailScreen = nullptr;
+    // 主题卡片动画 (只保留可见卡片的状态)
+    ListItemAnimator mCardAnims;
+    CardTextureCache mCardCache;             // 卡片内容的纹理
+    HitGrid mCardHits;                       // 上一次绘制的卡片区域 (触摸命中)
     
-    // 主题卡片动画
-    struct ThemeCardAnim {
-        Animation scaleAnim;
-        Animation highlightAnim;
-    };
-    std::vector<ThemeCardAnim> mThemeAnims;
+    // 视图
+    int GetViewSize() const { return (int)mCatalog.GetView().size(); }
+    Theme& GetViewTheme(int position) { return mThemeManager->GetThemes()[mCatalog.GetView()[position]]; }
+    void SyncView();                 // 让索引跟上主题列表, 视图变化后按 uuid 找回选中项
+    void CycleSortOrder();
+    void CycleTagFilter(int step);   // 在最常见的标签之间切换, 包括不过滤
+    void ResetSelection();
+    void RestoreView(const ThemeManager::WarmView& view);   // 恢复热启动快照中的视图
+    bool CaptureView(ThemeManager::WarmView& view, std::vector<std::string>& thumbUrls);
+    void OpenDetailScreen();         // 把选中主题的详情页压入界面栈
     
     // 初始化动画
     void InitAnimations(size_t themeCount);
@@ -63,10 +118,24 @@ private:
     // 扫描已安装的主题
     void ScanInstalledThemes();
     
+    // 在后台同步缓存的列表
+    void StartBackgroundSync();
+    
     // 触摸支持
-    bool IsTouchInRect(int touchX, int touchY, int rectX, int rectY, int rectW, int rectH);
     
     // 绘制主题列表
     void DrawThemeList();
-    void DrawThemeCard(int x, int y, int w, int h, Theme& theme, bool selected, int themeIndex);
+    void DrawThemeCard(int x, int y, int w, int h, Theme& theme, bool selected, int position);
+    void DrawThemeCardContent(int x, int y, int w, int h, Theme& theme, bool selected, bool installed,
+                              const ImageLoader::AtlasSprite& thumbSprite);
+    
+    // 滚动后提升可见缩略图的下载优先级,降低已滚出屏幕的
+    // [visibleStart, visibleEnd) 是滚动停下时可见的行 (惯性滑行中为预测的位置)
+    void UpdateThumbnailPriorities(int visibleStart, int visibleEnd);
+    
+    // 按滚动方向以低优先级预取即将出现的缩略图, 取消离得太远的; 参数同上
+    void PrefetchThumbnails(int visibleStart, int visibleEnd, int thumbW, int thumbH);
+    void RequestThumbnail(Theme& theme, int thumbW, int thumbH, bool highPriority, bool lowPriority);
+    void PreloadHdPreviews(int position);
+    void CancelHdPreload();
 };
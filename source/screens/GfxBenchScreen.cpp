@@ -0,0 +1,178 @@
+#include "GfxBenchScreen.hpp"
+#include "Gfx.hpp"
+#include "../utils/FileLogger.hpp"
+#include <coreinit/time.h>
+#include <gx2/event.h>
+#include <cstdio>
+
+namespace {
+
+enum Primitive {
+    PRIM_RECT_ROUNDED,
+    PRIM_GRADIENT,
+    PRIM_SHADOW,
+    PRIM_ICON,
+    PRIM_TEXT,
+    PRIM_TEXT_STATIC,
+};
+
+// w/h 为图形的尺寸, 文字的 w 为字号; param 为圆角半径或模糊半径
+struct BenchCase {
+    const char* name;
+    Primitive primitive;
+    int w;
+    int h;
+    int param;
+    uint8_t alpha;
+    const char* text;
+    int callsPerFrame;
+};
+
+// 长文字取自各语言文件中最长的一条 (详情页底栏提示)
+const char* TEXT_EN_LONG = "B: Back  |  A: Download  |  Y: Add to Queue  |  <Arrow>: Switch Preview";
+const char* TEXT_JA_LONG = "B: 戻る  |  A: ダウンロード  |  Y: キューに追加  |  <Arrow>: プレビュー切替";
+const char* TEXT_ZH_LONG = "B: 返回  |  A: 下载  |  Y: 加入队列  |  <Arrow>: 切换预览图";
+
+const BenchCase sCases[] = {
+    {"rect-rounded-64-r8",          PRIM_RECT_ROUNDED, 64,   64,   8,  0xff, nullptr, 2000},
+    {"rect-rounded-256-r32",        PRIM_RECT_ROUNDED, 256,  256,  32, 0xff, nullptr, 1000},
+    {"rect-rounded-256-r32-alpha",  PRIM_RECT_ROUNDED, 256,  256,  32, 0x80, nullptr, 1000},
+    {"rect-rounded-1720-r24",       PRIM_RECT_ROUNDED, 1720, 200,  24, 0xff, nullptr, 200},
+    {"gradient-256",                PRIM_GRADIENT,     256,  256,  0,  0xff, nullptr, 1000},
+    {"gradient-fullscreen",         PRIM_GRADIENT,     1920, 1080, 0,  0xff, nullptr, 20},
+    {"shadow-256-b10",              PRIM_SHADOW,       256,  128,  10, 0xff, nullptr, 1000},
+    {"shadow-256-b30",              PRIM_SHADOW,       256,  128,  30, 0xff, nullptr, 1000},
+    {"shadow-1720-b20",             PRIM_SHADOW,       1720, 200,  20, 0xff, nullptr, 200},
+    {"icon-32",                     PRIM_ICON,         32,   32,   0,  0xff, nullptr, 2000},
+    {"icon-96-alpha",               PRIM_ICON,         96,   96,   0,  0x80, nullptr, 1000},
+    {"text-en-short",               PRIM_TEXT,         32,   32,   0,  0xff, "Themes", 1000},
+    {"text-en-long",                PRIM_TEXT,         32,   32,   0,  0xff, TEXT_EN_LONG, 300},
+    {"text-ja-short",               PRIM_TEXT,         32,   32,   0,  0xff, "テーマ", 1000},
+    {"text-ja-long",                PRIM_TEXT,         32,   32,   0,  0xff, TEXT_JA_LONG, 300},
+    {"text-zh-short",               PRIM_TEXT,         32,   32,   0,  0xff, "主题", 1000},
+    {"text-zh-long",                PRIM_TEXT,         32,   32,   0,  0xff, TEXT_ZH_LONG, 300},
+    {"text-en-long-alpha",          PRIM_TEXT,         32,   32,   0,  0x80, TEXT_EN_LONG, 300},
+    {"text-static-en-long",         PRIM_TEXT_STATIC,  32,   32,   0,  0xff, TEXT_EN_LONG, 1000},
+    {"text-static-zh-long",         PRIM_TEXT_STATIC,  32,   32,   0,  0xff, TEXT_ZH_LONG, 1000},
+};
+constexpr int CASE_COUNT = sizeof(sCases) / sizeof(sCases[0]);
+
+// 提交攒下的内容并等 GPU 做完
+void WaitForGpu() {
+    SDL_RenderFlush(Gfx::GetRenderer());
+    GX2DrawDone();
+}
+
+void DrawPrimitive(const BenchCase& bench, int i) {
+    // 位置按调用序号错开, 每帧相同; 文字宽度不固定, 留出一半屏幕
+    int spanW = Gfx::SCREEN_WIDTH - (bench.primitive >= PRIM_TEXT ? Gfx::SCREEN_WIDTH / 2 : bench.w);
+    int spanH = Gfx::SCREEN_HEIGHT - bench.h;
+    int x = spanW > 0 ? (i * 37) % spanW : 0;
+    int y = spanH > 0 ? (i * 53) % spanH : 0;
+    switch (bench.primitive) {
+        case PRIM_RECT_ROUNDED:
+            Gfx::DrawRectRounded(x, y, bench.w, bench.h, bench.param, Gfx::COLOR_CARD_BG);
+            break;
+        case PRIM_GRADIENT:
+            Gfx::DrawGradientV(x, y, bench.w, bench.h, Gfx::COLOR_ACCENT, Gfx::COLOR_ALT_ACCENT);
+            break;
+        case PRIM_SHADOW:
+            Gfx::DrawShadow(x, y, bench.w, bench.h, bench.param);
+            break;
+        case PRIM_ICON:
+            Gfx::DrawIcon(x, y, bench.w, Gfx::COLOR_ICON, 0xf019, Gfx::ALIGN_LEFT | Gfx::ALIGN_TOP);
+            break;
+        case PRIM_TEXT:
+            Gfx::Print(x, y, bench.w, Gfx::COLOR_TEXT, bench.text);
+            break;
+        case PRIM_TEXT_STATIC:
+            Gfx::PrintStatic(x, y, bench.w, Gfx::COLOR_TEXT, bench.text);
+            break;
+    }
+}
+
+} // namespace
+
+GfxBenchScreen::GfxBenchScreen(ResultCallback onResult) : mOnResult(std::move(onResult)) {
+}
+
+GfxBenchScreen::~GfxBenchScreen() = default;
+
+bool GfxBenchScreen::IsFinished() const {
+    return mCase >= CASE_COUNT;
+}
+
+int GfxBenchScreen::GetCaseCount() const {
+    return CASE_COUNT;
+}
+
+void GfxBenchScreen::Draw() {
+    Gfx::DrawRectFilled(0, 0, Gfx::SCREEN_WIDTH, Gfx::SCREEN_HEIGHT, Gfx::COLOR_BACKGROUND);
+    if (IsFinished()) {
+        return;
+    }
+
+    RunCase();
+
+    char line[96];
+    snprintf(line, sizeof(line), "%s  (%d/%d)", sCases[mCase].name, mCase + 1, CASE_COUNT);
+    Gfx::DrawRectFilled(20, Gfx::SCREEN_HEIGHT - 90, 760, 70, {0x00, 0x00, 0x00, 0xc0});
+    Gfx::Print(32, Gfx::SCREEN_HEIGHT - 55, 28, Gfx::COLOR_WARNING, line, Gfx::ALIGN_VERTICAL);
+
+    if (++mFrame >= WARMUP_FRAMES + MEASURE_FRAMES) {
+        FinishCase();
+    }
+}
+
+void GfxBenchScreen::RunCase() {
+    const BenchCase& bench = sCases[mCase];
+    WaitForGpu();
+    int drawCallsBefore = Gfx::GetFrameDrawCallCount();
+
+    // 透明度用全局透明度设置, 阴影等没有颜色参数的图形也一样
+    float previousAlpha = Gfx::GetGlobalAlpha();
+    Gfx::SetGlobalAlpha(bench.alpha / 255.0f);
+    OSTime start = OSGetSystemTime();
+    for (int i = 0; i < bench.callsPerFrame; i++) {
+        DrawPrimitive(bench, i);
+    }
+    OSTime drawn = OSGetSystemTime();
+    int drawCalls = Gfx::GetFrameDrawCallCount() - drawCallsBefore;
+    WaitForGpu();
+    OSTime done = OSGetSystemTime();
+    Gfx::SetGlobalAlpha(previousAlpha);
+
+    if (mFrame < WARMUP_FRAMES) {
+        return;
+    }
+    mCpuTicks += drawn - start;
+    mGpuTicks += done - drawn;
+    mCalls += bench.callsPerFrame;
+    mDrawCalls += drawCalls;
+}
+
+void GfxBenchScreen::FinishCase() {
+    Result result;
+    result.name = sCases[mCase].name;
+    result.calls = mCalls;
+    result.cpuUsPerCall = mCalls > 0 ? (float)OSTicksToMicroseconds(mCpuTicks) / mCalls : 0.0f;
+    result.gpuUsPerCall = mCalls > 0 ? (float)OSTicksToMicroseconds(mGpuTicks) / mCalls : 0.0f;
+    result.drawCallsPerFrame = (float)mDrawCalls / MEASURE_FRAMES;
+    FileLogger::GetInstance().LogInfo("[GfxBench] %s: %d calls, cpu %.2f us, gpu %.2f us per call, %.1f draw calls per frame",
+                                      result.name, result.calls, result.cpuUsPerCall, result.gpuUsPerCall,
+                                      result.drawCallsPerFrame);
+    if (mOnResult) {
+        mOnResult(result);
+    }
+
+    mCase++;
+    mFrame = 0;
+    mCpuTicks = 0;
+    mGpuTicks = 0;
+    mCalls = 0;
+    mDrawCalls = 0;
+}
+
+bool GfxBenchScreen::Update(Input &input) {
+    return !IsFinished();
+}
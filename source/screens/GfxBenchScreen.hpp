@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Screen.hpp"
+#include <functional>
+
+// Gfx 基本图形的基准测试 (Benchmark 的 gfx 场景): 按固定的配置 (尺寸、圆角、模糊、透明度、各语言的长短文字)
+// 把每种图形在一帧中连续绘制 callsPerFrame 次, 每个配置先画 WARMUP_FRAMES 帧 (光栅化字形、生成静态文字纹理),
+// 再测量 MEASURE_FRAMES 帧, 结果交给回调; 全部配置完成后 Update 返回 false, 界面关闭
+// 每帧测量前先等 GPU 空闲 (GX2DrawDone), 所以测到的是单独绘制这些图形的代价, 帧率不代表正常界面
+class GfxBenchScreen : public Screen {
+public:
+    static constexpr int WARMUP_FRAMES = 5;
+    static constexpr int MEASURE_FRAMES = 20;
+
+    struct Result {
+        const char* name;
+        int calls;              // 测量的总调用次数
+        float cpuUsPerCall;     // Gfx 调用本身 (生成顶点、攒批, 中途换纹理时的提交)
+        float gpuUsPerCall;     // 调用返回后提交剩下的内容并等到 GPU 完成的时间, 按调用次数平均
+        float drawCallsPerFrame;    // 这些调用产生的 SDL 绘制提交次数
+    };
+    using ResultCallback = std::function<void(const Result& result)>;
+
+    explicit GfxBenchScreen(ResultCallback onResult);
+    ~GfxBenchScreen() override;
+
+    void Draw() override;
+    bool Update(Input &input) override;
+
+    bool IsFinished() const;
+    int GetCaseCount() const;
+
+private:
+    void RunCase();
+    void FinishCase();
+
+    ResultCallback mOnResult;
+    int mCase = 0;
+    int mFrame = 0;             // 当前配置已经画的帧数 (包括预热)
+    uint64_t mCpuTicks = 0;
+    uint64_t mGpuTicks = 0;
+    int mCalls = 0;
+    int mDrawCalls = 0;
+};
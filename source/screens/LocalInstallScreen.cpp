@@ -4,123 +4,124 @@
 #include "../utils/FileLogger.hpp"
 #include "../utils/ThemePatcher.hpp"
 #include "../utils/Utils.hpp"
-#include "../utils/minizip/unzip.h"
+#include "../utils/ZipExtractor.hpp"
+#include "../utils/TrashBin.hpp"
+#include "../utils/ImageLoader.hpp"
 #include <dirent.h>
 #include <sys/stat.h>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
 
-LocalInstallScreen::LocalInstallScreen() {
+static const char* THEMES_DIR = "fs:/vol/external01/wiiu/themes";
+static const char* INDEX_DIR = "fs:/vol/external01/UTheme/temp/local";
+// 列表中缩略图的大小 (16:9)
+static const int THUMB_WIDTH = 128;
+static const int THUMB_HEIGHT = 72;
+
+LocalInstallScreen::LocalInstallScreen() : mIndex(THEMES_DIR, INDEX_DIR) {
     mTitleAnim.Start(0, 1, 500);
     mContentAnim.Start(0, 1, 600);
     mListAnim.Start(0, 1, 700);
     
-    FileLogger::GetInstance().LogInfo("LocalInstallScreen: Starting file scan");
+    // 先用上次保存的索引显示 (不打开任何 .utheme), 再在后台检查文件变化
+    mIndex.Load();
+    mThemeFiles = BuildFileList();
+    if (!mThemeFiles.empty()) {
+        mState = STATE_FILE_LIST;
+        InitAnimations();
+    }
     
-    // 异步扫描.utheme文件
-    std::thread([this]() {
-        ScanThemeFiles();
-        
-        if (mThemeFiles.empty()) {
-            mState = STATE_EMPTY;
-        } else {
-            mState = STATE_FILE_LIST;
-            InitAnimations();
-        }
-    }).detach();
+    FileLogger::GetInstance().LogInfo("LocalInstallScreen: %zu indexed file(s), starting file scan", mThemeFiles.size());
+    StartScan();
 }
 
 LocalInstallScreen::~LocalInstallScreen() {
-    // 等待安装线程完成
-    if (mInstallThreadRunning.load()) {
+    // 请求取消并等待安装线程完成 (打补丁时不能取消, 会等到安装结束)
+    if (mInstallThread.joinable()) {
         FileLogger::GetInstance().LogInfo("LocalInstallScreen: Waiting for install thread to finish");
-        if (mInstallThread.joinable()) {
-            mInstallThread.join();
-        }
+        mInstallCancelRequested = true;
+        mInstallThread.join();
+    }
+    if (mScanThread.joinable()) {
+        mScanThread.join();
     }
     
     FileLogger::GetInstance().LogInfo("LocalInstallScreen: Destructor completed");
 }
 
-void LocalInstallScreen::ScanThemeFiles() {
-    mThemeFiles.clear();
-    
-    const char* searchPath = "fs:/vol/external01/wiiu/themes";
-    FileLogger::GetInstance().LogInfo("Scanning for .utheme files in: %s", searchPath);
-    
-    DIR* dir = opendir(searchPath);
-    if (!dir) {
-        FileLogger::GetInstance().LogError("Failed to open directory: %s", searchPath);
-        return;
-    }
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        // 只处理普通文件
-        if (entry->d_type != DT_REG) continue;
-        
-        // 检查是否是.utheme文件
-        const char* ext = strrchr(entry->d_name, '.');
-        if (!ext || strcmp(ext, ".utheme") != 0) continue;
-        
-        // 构建完整路径
-        std::string fullPath = std::string(searchPath) + "/" + entry->d_name;
-        
-        // 获取文件大小
-        struct stat st;
-        if (stat(fullPath.c_str(), &st) != 0) {
-            FileLogger::GetInstance().LogWarning("Failed to stat file: %s", fullPath.c_str());
-            continue;
-        }
-        
-        // 创建文件记录
+std::vector<UThemeFile> LocalInstallScreen::BuildFileList() {
+    std::vector<UThemeFile> files;
+    for (const auto& entry : mIndex.GetEntries()) {
         UThemeFile file;
-        file.fileName = entry->d_name;
-        file.fullPath = fullPath;
-        file.fileSize = st.st_size;
-        file.fileSizeStr = FormatFileSize(st.st_size);
-        
-        // 提取显示名称(去掉.utheme后缀)
+        file.fileName = entry.fileName;
+        file.fullPath = std::string(THEMES_DIR) + "/" + entry.fileName;
+        file.fileSize = entry.size;
+        file.fileSizeStr = FormatFileSize(entry.size);
+        // 显示名称(去掉.utheme后缀), 同时用作主题目录名
         file.displayName = file.fileName.substr(0, file.fileName.length() - 7);
-        
-        mThemeFiles.push_back(file);
-        FileLogger::GetInstance().LogInfo("Found .utheme file: %s (%s)", 
-            file.fileName.c_str(), file.fileSizeStr.c_str());
+        file.themeName = entry.themeName;
+        file.themeAuthor = entry.themeAuthor;
+        file.previewKey = LocalThemeIndex::GetPreviewKey(entry);
+        file.indexEntry = entry;
+        files.push_back(file);
     }
-    
-    closedir(dir);
-    
-    // 按文件名排序
-    std::sort(mThemeFiles.begin(), mThemeFiles.end(), 
-        [](const UThemeFile& a, const UThemeFile& b) {
-            return a.fileName < b.fileName;
-        });
-    
-    FileLogger::GetInstance().LogInfo("Found %zu .utheme files", mThemeFiles.size());
+    return files;
 }
 
-void LocalInstallScreen::InitAnimations() {
-    mItemAnims.clear();
-    mItemAnims.resize(mThemeFiles.size());
-    
-    // 初始化所有项目的动画
-    for (size_t i = 0; i < mThemeFiles.size(); i++) {
-        mItemAnims[i].scaleAnim.SetImmediate(1.0f);
-        mItemAnims[i].highlightAnim.SetImmediate(0.0f);
+void LocalInstallScreen::StartScan() {
+    // 上一次扫描已经交出结果, 只需回收线程
+    if (mScanThread.joinable()) {
+        mScanThread.join();
     }
+    mScanThread = std::thread([this]() {
+        mIndex.Refresh();
+        mIndex.Save();
+        std::vector<UThemeFile> files = BuildFileList();
+        FileLogger::GetInstance().LogInfo("Found %zu .utheme files", files.size());
+        
+        std::lock_guard<std::mutex> lock(mScanMutex);
+        mScannedFiles = std::move(files);
+        mScanReady = true;
+    });
+}
+
+void LocalInstallScreen::ApplyFileList(std::vector<UThemeFile> files) {
+    std::string selectedName;
+    if (mSelectedIndex >= 0 && mSelectedIndex < (int)mThemeFiles.size()) {
+        selectedName = mThemeFiles[mSelectedIndex].fileName;
+    }
+    // 缩略图已经请求过的文件保留标记
+    for (auto& file : files) {
+        for (const auto& old : mThemeFiles) {
+            if (old.fileName == file.fileName && old.previewKey == file.previewKey) {
+                file.thumbRequested = old.thumbRequested;
+                break;
+            }
+        }
+    }
+    mThemeFiles = std::move(files);
     
-    // 选中第一个项目的动画 - 缩小放大比例,快速动画
-    if (mThemeFiles.size() > 0) {
-        mItemAnims[0].scaleAnim.SetTarget(1.02f, 350);
-        mItemAnims[0].highlightAnim.SetTarget(1.0f, 350);
+    mSelectedIndex = 0;
+    for (size_t i = 0; i < mThemeFiles.size(); i++) {
+        if (mThemeFiles[i].fileName == selectedName) {
+            mSelectedIndex = (int)i;
+            break;
+        }
     }
+    int maxScroll = std::max(0, (int)mThemeFiles.size() - ITEMS_PER_PAGE);
+    mScrollOffset = std::min(std::max(mScrollOffset, mSelectedIndex - ITEMS_PER_PAGE + 1), mSelectedIndex);
+    mScrollOffset = std::max(0, std::min(mScrollOffset, maxScroll));
+    InitAnimations();
+}
+
+void LocalInstallScreen::InitAnimations() {
+    // 选中项目的动画 - 缩小放大比例,快速动画
+    mItemAnims.Reset((int)mThemeFiles.size(), mSelectedIndex);
 }
 
 void LocalInstallScreen::UpdateAnimations() {
-    for (auto& anim : mItemAnims) {
-        anim.scaleAnim.Update();
-        anim.highlightAnim.Update();
-    }
+    mItemAnims.Update(mScrollOffset, mScrollOffset + ITEMS_PER_PAGE);
 }
 
 std::string LocalInstallScreen::FormatFileSize(uint64_t bytes) {
@@ -237,15 +238,15 @@ void LocalInstallScreen::DrawFileList() {
     int visibleEnd = std::min(visibleStart + ITEMS_PER_PAGE, (int)mThemeFiles.size());
     
     for (int i = visibleStart; i < visibleEnd; i++) {
-        const auto& file = mThemeFiles[i];
+        auto& file = mThemeFiles[i];
         int itemY = listY + (i - visibleStart) * ITEM_HEIGHT;
         
         // 是否选中
         bool isSelected = (i == mSelectedIndex);
         
         // 从动画获取缩放和高亮值
-        float scale = mItemAnims[i].scaleAnim.GetValue();
-        float highlight = mItemAnims[i].highlightAnim.GetValue();
+        float scale = mItemAnims.GetScale(i);
+        float highlight = mItemAnims.GetHighlight(i);
         
         // 背景卡片 - 使用圆角
         SDL_Color bgColor = isSelected ? Gfx::COLOR_ACCENT : SDL_Color{40, 40, 50, 200};
@@ -284,17 +285,58 @@ void LocalInstallScreen::DrawFileList() {
             Gfx::DrawRectRounded(scaledX, scaledY, scaledW, scaledH, cardRadius, bgColor);
         }
         
-        // 文件图标
-        SDL_Color iconColor = isSelected ? Gfx::COLOR_TEXT : Gfx::COLOR_ACCENT;
-        iconColor.a = (uint8_t)(255 * listAlpha);
-        Gfx::DrawIcon(scaledX + 50, scaledY + scaledH / 2, 40, iconColor, 
-                      0xf1c6, Gfx::ALIGN_CENTER); // file-archive icon
+        // 预览图 (从压缩包中直接解出), 没有时显示文件图标
+        SDL_Texture* thumb = file.previewKey.empty() ? nullptr : ImageLoader::GetCached(file.previewKey);
+        if (!thumb && !file.previewKey.empty() && !file.thumbRequested) {
+            file.thumbRequested = true;
+            ImageLoader::LoadRequest request;
+            request.url = file.previewKey;
+            request.source = [path = file.fullPath, entry = file.indexEntry](std::string& data) {
+                return LocalThemeIndex::ReadPreview(path, entry, data);
+            };
+            request.highPriority = isSelected;
+            request.targetWidth = THUMB_WIDTH;
+            request.targetHeight = THUMB_HEIGHT;
+            request.callback = [](SDL_Texture*) {};  // 绘制时用 GetCached 取得
+            request.owner = &mImageOwner;
+            ImageLoader::LoadAsync(request);
+        }
+        const int thumbX = scaledX + 20;
+        const int thumbY = scaledY + (scaledH - THUMB_HEIGHT) / 2;
+        if (thumb) {
+            int texW, texH;
+            SDL_QueryTexture(thumb, nullptr, nullptr, &texW, &texH);
+            float imgScale = std::min((float)THUMB_WIDTH / texW, (float)THUMB_HEIGHT / texH);
+            SDL_Rect dstRect;
+            dstRect.w = (int)(texW * imgScale);
+            dstRect.h = (int)(texH * imgScale);
+            dstRect.x = thumbX + (THUMB_WIDTH - dstRect.w) / 2;
+            dstRect.y = thumbY + (THUMB_HEIGHT - dstRect.h) / 2;
+            SDL_SetTextureAlphaMod(thumb, (uint8_t)(255 * listAlpha));
+            Gfx::DrawTexture(thumb, nullptr, dstRect);
+        } else {
+            SDL_Color iconColor = isSelected ? Gfx::COLOR_TEXT : Gfx::COLOR_ACCENT;
+            iconColor.a = (uint8_t)(255 * listAlpha);
+            Gfx::DrawIcon(thumbX + THUMB_WIDTH / 2, scaledY + scaledH / 2, 40, iconColor, 
+                          0xf1c6, Gfx::ALIGN_CENTER); // file-archive icon
+        }
         
-        // 文件名(左侧,垂直居中)
+        // 主题名称 (metadata.json 中没有时显示文件名) 和作者
         SDL_Color nameColor = Gfx::COLOR_TEXT;
         nameColor.a = (uint8_t)(255 * listAlpha);
-        Gfx::Print(scaledX + 120, scaledY + scaledH / 2, 32, nameColor, 
-                   file.displayName.c_str(), Gfx::ALIGN_LEFT | Gfx::ALIGN_VERTICAL);
+        const std::string& name = file.themeName.empty() ? file.displayName : file.themeName;
+        const int textX = thumbX + THUMB_WIDTH + 24;
+        if (file.themeAuthor.empty()) {
+            Gfx::Print(textX, scaledY + scaledH / 2, 32, nameColor, 
+                       name.c_str(), Gfx::ALIGN_LEFT | Gfx::ALIGN_VERTICAL);
+        } else {
+            Gfx::Print(textX, scaledY + scaledH / 2 - 16, 32, nameColor, 
+                       name.c_str(), Gfx::ALIGN_LEFT | Gfx::ALIGN_VERTICAL);
+            SDL_Color authorColor = Gfx::COLOR_ALT_TEXT;
+            authorColor.a = (uint8_t)(255 * listAlpha);
+            Gfx::Print(textX, scaledY + scaledH / 2 + 22, 24, authorColor, 
+                       file.themeAuthor.c_str(), Gfx::ALIGN_LEFT | Gfx::ALIGN_VERTICAL);
+        }
         
         // 文件大小(右侧,垂直居中)
         SDL_Color sizeColor = Gfx::COLOR_ALT_TEXT;
@@ -471,7 +513,13 @@ void LocalInstallScreen::DrawInstallProgress() {
     }
     
     // 进度条 - 使用圆角
-    float progress = mInstallProgress.load();
+    // 安装线程的进度是跳跃的, 显示时每帧平滑地靠近
+    float target = mInstallProgress.load();
+    mDisplayedProgress += (target - mDisplayedProgress) * 0.2f;
+    if (std::fabs(target - mDisplayedProgress) < 0.002f) {
+        mDisplayedProgress = target;
+    }
+    float progress = mDisplayedProgress;
     const int barW = 700;
     const int barH = 40;
     const int barX = (Gfx::SCREEN_WIDTH - barW) / 2;
@@ -496,6 +544,13 @@ void LocalInstallScreen::DrawInstallProgress() {
     snprintf(percentStr, sizeof(percentStr), "%.0f%%", progress * 100);
     Gfx::Print(Gfx::SCREEN_WIDTH / 2, barY + barH / 2, 28, 
                Gfx::COLOR_TEXT, percentStr, Gfx::ALIGN_CENTER | Gfx::ALIGN_VERTICAL);
+    
+    // 提示 (开始打补丁后不能取消)
+    if (mInstallCancellable.load() && !mInstallCancelRequested.load()) {
+        const std::string hint = _("common.cancel");
+        Gfx::Print(Gfx::SCREEN_WIDTH / 2, dialogY + 440, 28, 
+                   Gfx::COLOR_ALT_TEXT, ("B: " + hint).c_str(), Gfx::ALIGN_CENTER);
+    }
 }
 
 void LocalInstallScreen::DrawInstallResult() {
@@ -575,6 +630,20 @@ void LocalInstallScreen::DrawEmptyState() {
 }
 
 bool LocalInstallScreen::Update(Input &input) {
+    // 扫描结果只在浏览列表时替换, 确认和安装期间保持选中的文件不变
+    State scanState = mState.load();
+    if (mScanReady.load() &&
+        (scanState == STATE_LOADING || scanState == STATE_FILE_LIST || scanState == STATE_EMPTY)) {
+        std::vector<UThemeFile> files;
+        {
+            std::lock_guard<std::mutex> lock(mScanMutex);
+            files = std::move(mScannedFiles);
+            mScanReady = false;
+        }
+        ApplyFileList(std::move(files));
+        mState = mThemeFiles.empty() ? STATE_EMPTY : STATE_FILE_LIST;
+    }
+    
     State currentState = mState.load();
     
     // 处理文件列表导航
@@ -599,7 +668,7 @@ bool LocalInstallScreen::Update(Input &input) {
                 const int itemY = listY + index * ITEM_HEIGHT;
                 
                 // 应用缩放(从动画获取值)
-                float scale = mItemAnims[i].scaleAnim.GetValue();
+                float scale = mItemAnims.GetScale(i);
                 int scaledW = (int)(cardW * scale);
                 int scaledH = (int)(cardH * scale);
                 int scaledX = cardX - (scaledW - cardW) / 2;
@@ -618,11 +687,7 @@ bool LocalInstallScreen::Update(Input &input) {
                             mSelectedIndex = i;
                             
                             // 触发选择动画
-                            mItemAnims[prevSelected].scaleAnim.SetTarget(1.0f, 350);
-                            mItemAnims[prevSelected].highlightAnim.SetTarget(0.0f, 350);
-                            
-                            mItemAnims[mSelectedIndex].scaleAnim.SetTarget(1.02f, 350);
-                            mItemAnims[mSelectedIndex].highlightAnim.SetTarget(1.0f, 350);
+                            mItemAnims.Select(prevSelected, mSelectedIndex);
                             
                             FileLogger::GetInstance().LogInfo("Changed selection to: %s", 
                                 mThemeFiles[i].fileName.c_str());
@@ -696,11 +761,7 @@ bool LocalInstallScreen::Update(Input &input) {
         
         // 触发选择动画
         if (selectionChanged) {
-            mItemAnims[prevSelected].scaleAnim.SetTarget(1.0f, 350);
-            mItemAnims[prevSelected].highlightAnim.SetTarget(0.0f, 350);
-            
-            mItemAnims[mSelectedIndex].scaleAnim.SetTarget(1.02f, 350);
-            mItemAnims[mSelectedIndex].highlightAnim.SetTarget(1.0f, 350);
+            mItemAnims.Select(prevSelected, mSelectedIndex);
         }
         
         // A键确认选择
@@ -805,16 +866,20 @@ bool LocalInstallScreen::Update(Input &input) {
             mState = STATE_FILE_LIST;
         }
     }
+    // 安装中: B键取消 (解压阶段)
+    else if (currentState == STATE_INSTALLING) {
+        if ((input.data.buttons_d & Input::BUTTON_B) && mInstallCancellable.load()) {
+            FileLogger::GetInstance().LogInfo("Install cancel requested");
+            mInstallCancelRequested = true;
+        }
+    }
     // 处理安装结果
     else if (currentState == STATE_INSTALL_COMPLETE || currentState == STATE_INSTALL_ERROR) {
         // A或B键返回列表
         if ((input.data.buttons_d & Input::BUTTON_A) || (input.data.buttons_d & Input::BUTTON_B)) {
-            // 重新扫描文件列表
+            // 重新扫描文件列表 (安装后原文件可能已被删除)
             mState = STATE_LOADING;
-            std::thread([this]() {
-                ScanThemeFiles();
-                mState = mThemeFiles.empty() ? STATE_EMPTY : STATE_FILE_LIST;
-            }).detach();
+            StartScan();
         }
     }
     // 空状态
@@ -832,26 +897,39 @@ void LocalInstallScreen::StartInstall() {
         return;
     }
     
+    // 上一次安装的线程已经结束, 只需回收
+    if (mInstallThread.joinable()) {
+        mInstallThread.join();
+    }
+    
     mState = STATE_INSTALLING;
     mInstallProgress = 0.0f;
+    mDisplayedProgress = 0.0f;
+    mInstallCancelRequested = false;
+    mInstallCancellable = true;
     mInstallError.clear();
     mInstalledThemeName = mThemeFiles[mSelectedIndex].displayName;
     
     FileLogger::GetInstance().LogInfo("Starting install of: %s", 
         mThemeFiles[mSelectedIndex].fullPath.c_str());
     
-    // 启动安装线程
+    // 启动安装线程 (文件信息复制一份, 安装期间列表可能被重新扫描)
+    UThemeFile file = mThemeFiles[mSelectedIndex];
     mInstallThreadRunning = true;
-    mInstallThread = std::thread([this]() {
-        PerformInstall();
+    mInstallThread = std::thread([this, file]() {
+        PerformInstall(file);
+        mInstallCancellable = false;
         mInstallThreadRunning = false;
     });
-    mInstallThread.detach();
 }
 
-void LocalInstallScreen::PerformInstall() {
-    const auto& file = mThemeFiles[mSelectedIndex];
-    
+void LocalInstallScreen::CancelInstall(const std::string& themeDir) {
+    FileLogger::GetInstance().LogInfo("Install cancelled, cleaning up: %s", themeDir.c_str());
+    ClearThemeDirectory(themeDir);
+    mState = STATE_FILE_LIST;
+}
+
+void LocalInstallScreen::PerformInstall(const UThemeFile& file) {
     FileLogger::GetInstance().LogInfo("Installing theme from: %s", file.fullPath.c_str());
     
     mInstallProgress = 0.1f;
@@ -877,11 +955,12 @@ void LocalInstallScreen::PerformInstall() {
         }
     }
     
-    // 如果主题目录已存在,先删除(重新安装)
+    // 如果主题目录已存在,删除旧的主题文件(重新安装)
+    // patched/ 保留: ThemePatcher 按安装记录只重新生成输入有变化的输出, 并删除不再需要的
     if (stat(themeDir.c_str(), &st) == 0) {
         FileLogger::GetInstance().LogInfo("Theme already exists, removing old version: %s", themeDir.c_str());
         
-        if (!DeleteDirectoryRecursive(themeDir)) {
+        if (!ClearThemeDirectory(themeDir)) {
             FileLogger::GetInstance().LogError("Failed to delete existing theme directory");
             mInstallError = "Failed to remove old theme version";
             mState = STATE_INSTALL_ERROR;
@@ -892,7 +971,7 @@ void LocalInstallScreen::PerformInstall() {
     }
     
     // 创建主题目录
-    if (mkdir(themeDir.c_str(), 0755) != 0) {
+    if (stat(themeDir.c_str(), &st) != 0 && mkdir(themeDir.c_str(), 0755) != 0) {
         FileLogger::GetInstance().LogError("Failed to create theme directory: %s", themeDir.c_str());
         mInstallError = "Failed to create theme directory";
         mState = STATE_INSTALL_ERROR;
@@ -904,63 +983,31 @@ void LocalInstallScreen::PerformInstall() {
     // 解压.utheme文件到主题目录
     FileLogger::GetInstance().LogInfo("Extracting theme to: %s", themeDir.c_str());
     
-    // 使用unzip解压(minizip库)
-    unzFile zipFile = unzOpen(file.fullPath.c_str());
-    if (!zipFile) {
-        FileLogger::GetInstance().LogError("Failed to open .utheme file");
-        mInstallError = "Failed to open theme file";
-        mState = STATE_INSTALL_ERROR;
-        return;
+    // 保留 .utheme 文件时 BPS 补丁不解压, 安装时直接从 .utheme 读取; 安装后删除时才需要解压到 SD 卡
+    bool patchesFromArchive = !mDeleteAfterInstall;
+    ZipExtractor extractor;
+    extractor.SetCancelFlag(&mInstallCancelRequested);
+    if (patchesFromArchive) {
+        extractor.SetFilter([](const std::string& name) {
+            return !(name.length() > 4 && name.compare(name.length() - 4, 4, ".bps") == 0);
+        });
     }
-    
-    // 解压所有文件
-    int ret = unzGoToFirstFile(zipFile);
-    while (ret == UNZ_OK) {
-        char filename[512];
-        unz_file_info fileInfo;
-        
-        if (unzGetCurrentFileInfo(zipFile, &fileInfo, filename, sizeof(filename), 
-                                  nullptr, 0, nullptr, 0) != UNZ_OK) {
-            FileLogger::GetInstance().LogError("Failed to get file info");
-            break;
+    extractor.SetProgressCallback([this](uint64_t done, uint64_t total) {
+        if (total > 0) {
+            mInstallProgress = 0.2f + 0.3f * (float)((double)done / (double)total);
         }
-        
-        std::string extractPath = themeDir + "/" + filename;
-        
-        // 如果是目录,创建它
-        if (filename[strlen(filename) - 1] == '/') {
-            mkdir(extractPath.c_str(), 0755);
-        } else {
-            // 解压文件
-            if (unzOpenCurrentFile(zipFile) != UNZ_OK) {
-                FileLogger::GetInstance().LogError("Failed to open file in zip: %s", filename);
-                ret = unzGoToNextFile(zipFile);
-                continue;
-            }
-            
-            FILE* outFile = fopen(extractPath.c_str(), "wb");
-            if (!outFile) {
-                FileLogger::GetInstance().LogError("Failed to create file: %s", extractPath.c_str());
-                unzCloseCurrentFile(zipFile);
-                ret = unzGoToNextFile(zipFile);
-                continue;
-            }
-            
-            char buffer[8192];
-            int bytesRead;
-            while ((bytesRead = unzReadCurrentFile(zipFile, buffer, sizeof(buffer))) > 0) {
-                fwrite(buffer, 1, bytesRead, outFile);
-            }
-            
-            fclose(outFile);
-            unzCloseCurrentFile(zipFile);
+    });
+    if (!extractor.Extract(file.fullPath, themeDir)) {
+        if (extractor.WasCancelled()) {
+            CancelInstall(themeDir);
+            return;
         }
-        
-        ret = unzGoToNextFile(zipFile);
+        FileLogger::GetInstance().LogError("Failed to extract .utheme file: %s", extractor.GetError().c_str());
+        mInstallError = "Failed to extract theme file";
+        mState = STATE_INSTALL_ERROR;
+        return;
     }
     
-    unzClose(zipFile);
-    
     mInstallProgress = 0.5f;
     
     // 创建或更新 theme_info.json,确保包含 id 字段
@@ -1014,11 +1061,23 @@ void LocalInstallScreen::PerformInstall() {
     
     mInstallProgress = 0.6f;
     
+    // 打补丁会更新安装记录和 patched/, 开始后不再响应取消
+    mInstallCancellable = false;
+    if (mInstallCancelRequested.load()) {
+        CancelInstall(themeDir);
+        return;
+    }
+    
     // 现在安装解压后的主题(应用BPS补丁)
     FileLogger::GetInstance().LogInfo("Installing theme with ThemePatcher");
     
     ThemePatcher patcher;
-    bool success = patcher.InstallTheme(themeDir, themeId, themeName, themeAuthor);
+    patcher.SetProgressCallback([this](float progress, const std::string& message) {
+        mInstallProgress = 0.6f + 0.3f * progress;
+    });
+    bool success = patchesFromArchive
+        ? patcher.InstallThemeFromArchive(file.fullPath, themeDir, themeId, themeName, themeAuthor)
+        : patcher.InstallTheme(themeDir, themeId, themeName, themeAuthor);
     
     mInstallProgress = 0.9f;
     
@@ -1049,7 +1108,7 @@ bool LocalInstallScreen::IsTouchInRect(int touchX, int touchY, int rectX, int re
            touchY >= rectY && touchY <= rectY + rectH;
 }
 
-bool LocalInstallScreen::DeleteDirectoryRecursive(const std::string& path) {
+bool LocalInstallScreen::ClearThemeDirectory(const std::string& path) {
     DIR* dir = opendir(path.c_str());
     if (!dir) {
         FileLogger::GetInstance().LogError("Failed to open directory for deletion: %s", path.c_str());
@@ -1066,27 +1125,17 @@ bool LocalInstallScreen::DeleteDirectoryRecursive(const std::string& path) {
         
         std::string fullPath = path + "/" + entry->d_name;
         
-        if (entry->d_type == DT_DIR) {
-            // 递归删除子目录
-            if (!DeleteDirectoryRecursive(fullPath)) {
-                success = false;
-            }
-        } else {
-            // 删除文件
-            if (unlink(fullPath.c_str()) != 0) {
-                FileLogger::GetInstance().LogError("Failed to delete file: %s", fullPath.c_str());
-                success = false;
-            }
+        if (entry->d_type == DT_DIR &&
+            (strcmp(entry->d_name, "patched") == 0 || strcmp(entry->d_name, "compiled") == 0)) {
+            continue;
+        }
+        // 子目录移到回收站后在后台删除, 解压可以马上开始
+        if (!TrashBin::Remove(fullPath)) {
+            FileLogger::GetInstance().LogError("Failed to delete: %s", fullPath.c_str());
+            success = false;
         }
     }
     
     closedir(dir);
-    
-    // 删除空目录
-    if (rmdir(path.c_str()) != 0) {
-        FileLogger::GetInstance().LogError("Failed to delete directory: %s", path.c_str());
-        return false;
-    }
-    
     return success;
 }
@@ -1,10 +1,14 @@
 #pragma once
 #include "Screen.hpp"
 #include "../utils/Animation.hpp"
+#include "../utils/ListItemAnimator.hpp"
+#include "../utils/LocalThemeIndex.hpp"
+#include "../utils/ImageLoader.hpp"
 #include <string>
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
 
 // 本地.utheme文件结构
 struct UThemeFile {
@@ -13,12 +17,12 @@ struct UThemeFile {
     std::string displayName;   // 显示名称(不含.utheme后缀)
     uint64_t fileSize;         // 文件大小(字节)
     std::string fileSizeStr;   // 文件大小(格式化字符串)
-};
-
-// 动画状态
-struct ItemAnimation {
-    Animation scaleAnim;
-    Animation highlightAnim;
+    // 来自索引 (压缩包中的 metadata.json 和预览图), 没有时为空
+    std::string themeName;
+    std::string themeAuthor;
+    std::string previewKey;    // 预览图的缓存键 (压缩包指纹)
+    LocalThemeIndex::Entry indexEntry;  // 预览图条目的位置, 解码时从压缩包直接读出
+    bool thumbRequested = false;
 };
 
 class LocalInstallScreen : public Screen {
@@ -48,6 +52,14 @@ private:
     int mSelectedIndex = 0;
     int mScrollOffset = 0;
     
+    // 文件索引: 打开界面时立即用上次保存的索引显示列表, 扫描线程检查文件变化后再更新
+    LocalThemeIndex mIndex;
+    ImageLoader::Owner mImageOwner;  // 离开时不再解码还在排队的预览图
+    std::thread mScanThread;
+    std::mutex mScanMutex;
+    std::vector<UThemeFile> mScannedFiles;       // 扫描线程的结果, 由 mScanMutex 保护
+    std::atomic<bool> mScanReady{false};
+    
     // UI配置
     static constexpr int ITEMS_PER_PAGE = 6;
     static constexpr int ITEM_HEIGHT = 100;
@@ -56,17 +68,20 @@ private:
     Animation mTitleAnim;
     Animation mContentAnim;
     Animation mListAnim;
-    std::vector<ItemAnimation> mItemAnims;  // 每个文件项的动画状态
+    ListItemAnimator mItemAnims{1.02f, 350};  // 可见文件项的选中动画
     
     // 安装相关
     bool mDeleteAfterInstall = false;  // 是否在安装后删除原文件
     std::atomic<float> mInstallProgress{0.0f};
+    float mDisplayedProgress = 0.0f;   // 进度条显示的进度, 每帧向 mInstallProgress 靠近
     std::string mInstallError;
     std::string mInstalledThemeName;
     
-    // 安装线程
+    // 安装线程 (解压和打补丁都在这个线程上, UI 线程只读取进度)
     std::thread mInstallThread;
     std::atomic<bool> mInstallThreadRunning{false};
+    std::atomic<bool> mInstallCancelRequested{false};
+    std::atomic<bool> mInstallCancellable{false};  // 开始打补丁后不能再取消
     
     // 触摸输入
     bool mTouchStarted = false;
@@ -79,7 +94,9 @@ private:
     static constexpr int INPUT_REPEAT_RATE = 5;      // 重复速率(约0.08秒)
     
     // 辅助函数
-    void ScanThemeFiles();
+    std::vector<UThemeFile> BuildFileList();     // 由索引条目生成文件列表
+    void StartScan();                            // 在扫描线程上刷新索引
+    void ApplyFileList(std::vector<UThemeFile> files);  // 在 UI 线程上替换列表, 保留选中的文件
     void InitAnimations();
     void UpdateAnimations();
     void DrawFileList();
@@ -89,9 +106,10 @@ private:
     void DrawEmptyState();
     
     void StartInstall();
-    void PerformInstall(); // 在线程中执行
+    void PerformInstall(const UThemeFile& file); // 在线程中执行
+    void CancelInstall(const std::string& themeDir);   // 在安装线程上处理取消: 清理解压了一半的目录
     
     std::string FormatFileSize(uint64_t bytes);
     bool IsTouchInRect(int touchX, int touchY, int rectX, int rectY, int rectW, int rectH);
-    bool DeleteDirectoryRecursive(const std::string& path); // 递归删除目录
+    bool ClearThemeDirectory(const std::string& path);      // 删除主题目录中除 patched/ 和 compiled/ 以外的内容
 };
@@ -3,6 +3,7 @@
 #include "MenuScreen.hpp"
 #include "common.h"
 #include "../utils/LanguageManager.hpp"
+#include "../utils/SystemInfo.hpp"
 #include <mocha/mocha.h>
 #include <utility>
 #include <cmath>
@@ -131,6 +132,11 @@ void MainScreen::Draw() {
     }
 }
 
+bool MainScreen::IsIdle() const {
+    // 初始化阶段一直在画加载动画
+    return mState == STATE_IN_MENU && mMenuScreen && mMenuScreen->IsIdle();
+}
+
 bool MainScreen::Update(Input &input) {
     if (mMenuScreen) {
         return mMenuScreen->Update(input);
@@ -170,6 +176,7 @@ bool MainScreen::Update(Input &input) {
                     res = Mocha_MountFS(MLC_STORAGE_PATH, nullptr, "/vol/storage_mlc01");
                 }
                 if (res == MOCHA_RESULT_SUCCESS) {
+                    SystemInfo::ValidateMenuContent();
                     mState = STATE_LOAD_MENU;
                     break;
                 }
@@ -18,6 +18,13 @@ public:
     void Draw() override;
 
     bool Update(Input &input) override;
+
+    bool IsIdle() const override;
+
+    size_t ReleaseHiddenResources() override { return mMenuScreen ? mMenuScreen->ReleaseHiddenResources() : 0; }
+    
+    // 初始化完成, 已显示主菜单
+    bool IsInMenu() const { return mState == STATE_IN_MENU && mMenuScreen; }
     
     // 静态方法检查Mocha是否可用
     static bool IsMochaAvailable() { return sMochaAvailable; }
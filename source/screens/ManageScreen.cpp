@@ -2,21 +2,22 @@
 #include "ThemeDetailScreen.hpp"
 #include "DownloadScreen.hpp"
 #include "LocalInstallScreen.hpp"
+#include "ScreenStack.hpp"
 #include "Gfx.hpp"
 #include "../utils/LanguageManager.hpp"
 #include "../utils/FileLogger.hpp"
+#include "../utils/FrameArena.hpp"
 #include "../utils/ImageLoader.hpp"
-#include "../utils/SimpleJsonParser.hpp"
+#include "../utils/ThemeRegistry.hpp"
 #include "../utils/Utils.hpp"
-#include "../input/CombinedInput.h"
-#include "../input/VPADInput.h"
-#include "../input/WPADInput.h"
+#include "../utils/ThemePatcher.hpp"
+#include "../utils/InstallQueue.hpp"
 #include <SDL2/SDL_image.h>
-#include <dirent.h>
-#include <sys/stat.h>
 #include <chrono>
 #include <thread>
 #include <algorithm>
+#include <set>
+#include <unordered_map>
 
 // 静态成员定义
 bool ManageScreen::sReturnedDueToEmpty = false;
@@ -32,218 +33,119 @@ ManageScreen::ManageScreen() {
     ImageLoader::Init();
     
     // 异步扫描本地主题
-    std::thread([this]() {
+    mScanJob = JobSystem::Submit([this](const CancelToken&) {
         ScanLocalThemes();
         
         // 初始化动画
         InitAnimations();
         
         mIsLoading = false;
-    }).detach();
+    });
 }
 
 ManageScreen::~ManageScreen() {
     FileLogger::GetInstance().LogInfo("ManageScreen destructor called");
     
-    // 等待扫描线程完成(如果还在运行)
-    // 注意: 由于使用了 detach(),无法直接 join,但可以设置标志让线程尽快退出
+    // 扫描任务会访问成员, 必须等它结束
     if (mIsLoading) {
-        FileLogger::GetInstance().LogInfo("Warning: ManageScreen destroyed while still loading themes");
+        FileLogger::GetInstance().LogInfo("ManageScreen destroyed while still loading themes, waiting for scan");
     }
+    mScanJob.Wait();
     
-    // 释放纹理
+    // 切换线程会访问成员, 必须等它结束
+    if (mSwitchThread.joinable()) {
+        mSwitchThread.join();
+    }
+    if (mVerifyThread.joinable()) {
+        mVerifyThread.join();
+    }
+    
+    // 还没完成的缩略图回调引用了 this, 排队中的解码不再进行
+    mImageOwner.Cancel();
+    
+    // 释放纹理 (纹理归 ImageLoader 的缓存所有)
     for (auto& theme : mThemes) {
-        if (theme.collageThumbTexture) {
-            SDL_DestroyTexture(theme.collageThumbTexture);
-            theme.collageThumbTexture = nullptr;
+        if (!theme.collageThumbTexture.IsEmpty()) {
+            theme.collageThumbTexture.Reset();
+            ImageLoader::RemoveFromCache(theme.collageThumbPath);
         }
     }
     
     FileLogger::GetInstance().LogInfo("ManageScreen destructor completed");
 }
 
+void ManageScreen::WarmUp() {
+    JobSystem::Submit([](const CancelToken&) {
+        ThemeRegistry::GetInstance().Preload();
+    });
+}
+
 void ManageScreen::InitAnimations() {
-    mThemeAnims.clear();
-    mThemeAnims.resize(mThemes.size());
-    
-    for (size_t i = 0; i < mThemes.size(); i++) {
-        mThemeAnims[i].scaleAnim.SetImmediate(1.0f);
-        mThemeAnims[i].highlightAnim.SetImmediate(0.0f);
-    }
-    
-    // 选中第一个主题的动画
-    if (mThemes.size() > 0) {
-        mThemeAnims[0].scaleAnim.SetTarget(1.05f, 300);
-        mThemeAnims[0].highlightAnim.SetTarget(1.0f, 300);
-    }
+    int themeCount = (int)mThemes.size();
+    mThemeAnims.Reset(themeCount, std::min(mSelectedIndex, themeCount - 1));
 }
 
+// 只更新可见卡片的动画 (滚动中上下各露出一部分时是 VISIBLE_COUNT + 1 张)
 void ManageScreen::UpdateAnimations() {
-    for (auto& anim : mThemeAnims) {
-        anim.scaleAnim.Update();
-        anim.highlightAnim.Update();
-    }
+    int firstRow = mScroll.GetFirstRow();
+    mThemeAnims.Update(firstRow, firstRow + VISIBLE_COUNT + 1);
 }
 
 void ManageScreen::ScanLocalThemes() {
     mThemes.clear();
+    mMarkedCount = 0;
+    std::string currentThemePath = ThemePatcher::GetCurrentThemePath();
     
-    const char* themesPath = "fs:/vol/external01/wiiu/themes";
-    DIR* dir = opendir(themesPath);
-    if (!dir) {
-        FileLogger::GetInstance().LogError("Failed to open themes directory");
-        return;
-    }
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_type != DT_DIR) continue;
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
-        
-        LocalTheme theme;
-        theme.name = entry->d_name;
-        theme.path = std::string(themesPath) + "/" + entry->d_name;
-        
-        // 加载元数据
-        LoadThemeMetadata(theme);
-        
-        // 检查是否有修补完成的文件 (Men.pack 或 Men2.pack)
-        std::string patchedPath = theme.path + "/patched/Common/Package";
-        struct stat st;
-        theme.hasPatched = false;
-        
-        if (stat(patchedPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
-            std::string menPath = patchedPath + "/Men.pack";
-            std::string men2Path = patchedPath + "/Men2.pack";
-            
-            struct stat menSt, men2St;
-            bool hasMen = (stat(menPath.c_str(), &menSt) == 0);
-            bool hasMen2 = (stat(men2Path.c_str(), &men2St) == 0);
-            
-            theme.hasPatched = (hasMen || hasMen2);
-        }
-        
-        // 统计 BPS 文件数量
-        theme.bpsCount = 0;
-        DIR* themeDir = opendir(theme.path.c_str());
-        if (themeDir) {
-            struct dirent* themeEntry;
-            while ((themeEntry = readdir(themeDir)) != nullptr) {
-                std::string filename = themeEntry->d_name;
-                if (filename.length() > 4 && filename.substr(filename.length() - 4) == ".bps") {
-                    theme.bpsCount++;
-                }
-            }
-            closedir(themeDir);
+    // 主题信息来自已安装主题的登记表 (内存中), 不再逐个打开主题目录; 直接填入列表, 不复制条目
+    ThemeRegistry& registry = ThemeRegistry::GetInstance();
+    mUpdatesVersion = registry.GetUpdatesVersion();
+    mThemes.reserve(registry.GetThemeCount());
+    registry.ForEachTheme([this, &currentThemePath](const ThemeRegistry::Entry& entry) {
+        // 从压缩包安装的主题目录里没有补丁, 只有 patched/ 下的输出
+        if (entry.bpsCount == 0 && !entry.hasPatched) {
+            return;
         }
         
-        if (theme.bpsCount > 0) {
-            mThemes.push_back(theme);
-            FileLogger::GetInstance().LogInfo("Found theme: %s (%d BPS files)", theme.name.c_str(), theme.bpsCount);
-        }
-    }
+        LocalTheme& theme = mThemes.emplace_back();
+        theme.name = entry.dirName;
+        theme.path = entry.path;
+        theme.id = entry.id;
+        theme.author = entry.author;
+        theme.description = entry.description;
+        theme.downloads = entry.downloads;
+        theme.likes = entry.likes;
+        theme.updatedAt = entry.updatedAt;
+        theme.tags = entry.tags;
+        theme.collageThumbPath = entry.images[ThemeRegistry::IMAGE_COLLAGE_THUMB];
+        theme.collageHdPath = entry.images[ThemeRegistry::IMAGE_COLLAGE];
+        theme.launcherThumbPath = entry.images[ThemeRegistry::IMAGE_LAUNCHER_THUMB];
+        theme.launcherHdPath = entry.images[ThemeRegistry::IMAGE_LAUNCHER];
+        theme.warawaraThumbPath = entry.images[ThemeRegistry::IMAGE_WARAWARA_THUMB];
+        theme.warawaraHdPath = entry.images[ThemeRegistry::IMAGE_WARAWARA];
+        theme.hasPatched = entry.hasPatched;
+        theme.bpsCount = entry.bpsCount;
+        theme.isCurrent = (theme.path == currentThemePath);
+        theme.hasUpdate = entry.HasUpdate();
+        theme.displayName = Utils::TruncateForDisplay(Utils::SanitizeThemeNameForDisplay(theme.name), CARD_NAME_COLUMNS);
+        theme.displayAuthor = Utils::TruncateForDisplay(theme.author.empty() ? "Unknown" : theme.author, CARD_AUTHOR_COLUMNS);
+        theme.downloadsText = std::to_string(theme.downloads);
+        theme.likesText = std::to_string(theme.likes);
+    });
     
-    closedir(dir);
     FileLogger::GetInstance().LogInfo("Total local themes found: %d", (int)mThemes.size());
 }
 
-void ManageScreen::LoadThemeMetadata(LocalTheme& theme) {
-    std::string metadataPath = theme.path + "/theme_info.json";
-    FILE* fp = fopen(metadataPath.c_str(), "r");
-    if (!fp) {
-        // 如果没有元数据文件，使用默认值
-        FileLogger::GetInstance().LogInfo("No metadata file for theme: %s, using defaults", theme.name.c_str());
-        theme.author = "Unknown";
-        theme.description = "";
-        theme.downloads = 0;
-        theme.likes = 0;
-        theme.updatedAt = "";
-        return;
-    }
-    
-    // 读取文件内容
-    fseek(fp, 0, SEEK_END);
-    long fileSize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    
-    char* buffer = (char*)malloc(fileSize + 1);
-    fread(buffer, 1, fileSize, fp);
-    buffer[fileSize] = '\0';
-    fclose(fp);
-    
-    FileLogger::GetInstance().LogInfo("Parsing metadata for: %s (size: %ld bytes)", theme.name.c_str(), fileSize);
-    
-    // 解析 JSON
-    JsonValue root = SimpleJsonParser::Parse(buffer);
-    
-    if (root.has("id")) {
-        theme.id = root["id"].asString();
-        FileLogger::GetInstance().LogInfo("  ID: %s", theme.id.c_str());
-    }
-    if (root.has("author")) {
-        theme.author = root["author"].asString();
-        FileLogger::GetInstance().LogInfo("  Author: %s", theme.author.c_str());
-    } else {
-        theme.author = "Unknown";
-    }
-    if (root.has("description")) theme.description = root["description"].asString();
-    if (root.has("downloads")) theme.downloads = root["downloads"].asInt();
-    if (root.has("likes")) theme.likes = root["likes"].asInt();
-    if (root.has("updatedAt")) theme.updatedAt = root["updatedAt"].asString();
-    
-    // 解析 tags 数组
-    if (root.has("tags") && root["tags"].isArray()) {
-        for (size_t i = 0; i < root["tags"].size(); i++) {
-            if (root["tags"][i].isString()) {
-                theme.tags.push_back(root["tags"][i].asString());
-            }
-        }
-    }
-    
-    free(buffer);
-    
-    // 设置图片路径 - 从 images/ 子目录加载(新格式),如果不存在则尝试旧格式
-    // 支持多种图片格式: .webp, .jpg, .jpeg, .png
-    std::string imagesDir = theme.path + "/images";
-    struct stat st;
-    bool hasImagesDir = (stat(imagesDir.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
-    
-    // 辅助函数: 查找存在的图片文件(尝试多种扩展名)
-    auto findImage = [](const std::string& basePath) -> std::string {
-        const char* extensions[] = {".webp", ".jpg", ".jpeg", ".png"};
-        struct stat st;
-        for (const char* ext : extensions) {
-            std::string path = basePath + ext;
-            if (stat(path.c_str(), &st) == 0) {
-                FileLogger::GetInstance().LogInfo("Found image: %s", path.c_str());
-                return path;
-            }
-        }
-        FileLogger::GetInstance().LogWarning("No image found for: %s (tried .webp, .jpg, .jpeg, .png)", basePath.c_str());
-        return basePath + ".jpg"; // 默认返回 .jpg (兼容旧逻辑)
-    };
-    
-    if (hasImagesDir) {
-        // 新格式: images/ 子目录
-        theme.collageThumbPath = findImage(imagesDir + "/collage_thumb");
-        theme.collageHdPath = findImage(imagesDir + "/collage");
-        theme.launcherThumbPath = findImage(imagesDir + "/launcher_thumb");
-        theme.launcherHdPath = findImage(imagesDir + "/launcher");
-        theme.warawaraThumbPath = findImage(imagesDir + "/warawara_thumb");
-        theme.warawaraHdPath = findImage(imagesDir + "/warawara");
-        FileLogger::GetInstance().LogInfo("Loading images from /images subdirectory");
-    } else {
-        // 旧格式: 直接在主题根目录
-        theme.collageThumbPath = findImage(theme.path + "/collage_thumb");
-        theme.collageHdPath = findImage(theme.path + "/collage");
-        theme.launcherThumbPath = findImage(theme.path + "/launcher_thumb");
-        theme.launcherHdPath = findImage(theme.path + "/launcher");
-        theme.warawaraThumbPath = findImage(theme.path + "/warawara_thumb");
-        theme.warawaraHdPath = findImage(theme.path + "/warawara");
-        FileLogger::GetInstance().LogInfo("Loading images from theme root (legacy)");
+void ManageScreen::RefreshUpdateFlags() {
+    ThemeRegistry& registry = ThemeRegistry::GetInstance();
+    mUpdatesVersion = registry.GetUpdatesVersion();
+    std::unordered_map<std::string, bool> updates;
+    registry.ForEachTheme([&updates](const ThemeRegistry::Entry& entry) {
+        updates[entry.path] = entry.HasUpdate();
+    });
+    for (auto& theme : mThemes) {
+        auto it = updates.find(theme.path);
+        theme.hasUpdate = it != updates.end() && it->second;
     }
-    
-    FileLogger::GetInstance().LogInfo("Loaded metadata for theme: %s (by %s)", theme.name.c_str(), theme.author.c_str());
 }
 
 void ManageScreen::Draw() {
@@ -324,16 +226,294 @@ void ManageScreen::Draw() {
         }
     }
     
-    // 底部提示 - 添加本地安装选项
-    std::string bottomHint = "\ue000 " + std::string(_("manage.view_details")) + 
-                             "  |  \ue002 " + std::string(_("manage.install_local"));
+    DrawSwitchStatus();
+    DrawVerifyStatus();
+    DrawUninstallStatus();
+    
+    // 底部提示 - 添加本地安装选项; 多选时换成勾选和卸载
+    std::string_view bottomHint;
+    if (mMarkedCount > 0) {
+        bottomHint = FrameArena::Format("\ue000 %s  |  \ue045 %s (%d)  |  \ue001 %s", _("manage.mark").c_str(),
+                                        _("manage.uninstall").c_str(), mMarkedCount, _("manage.clear_marks").c_str());
+    } else {
+        bottomHint = FrameArena::Format("\ue000 %s  |  \ue003 %s  |  \ue002 %s  |  \ue046 %s  |  \ue045 %s",
+                                        _("manage.view_details").c_str(), _("manage.apply").c_str(),
+                                        _("manage.install_local").c_str(), _("manage.mark").c_str(),
+                                        _("manage.verify").c_str());
+    }
+    
+    DrawBottomBar(bottomHint.data(), 
+                 FrameArena::Format("\ue044 %s", _("input.exit").c_str()).data(), 
+                 FrameArena::Format("\ue001 %s", _("input.back").c_str()).data());
+}
+
+void ManageScreen::StartSwitchTheme(LocalTheme& theme) {
+    if (theme.id.empty()) {
+        FileLogger::GetInstance().LogWarning("Theme %s has no ID, cannot switch to it", theme.name.c_str());
+        mSwitchResult = -1;
+        mSwitchResultFrames = 0;
+        return;
+    }
+    
+    FileLogger::GetInstance().LogInfo("Switching to theme: %s", theme.name.c_str());
+    mSwitching = true;
+    mSwitchProgress = 0.0f;
+    mSwitchResult = 0;
+    mSwitchResultFrames = 0;
+    mSwitchThemePath = theme.path;
+    
+    std::string themePath = theme.path;
+    std::string themeID = theme.id;
+    std::string themeName = theme.name;
+    std::string themeAuthor = theme.author;
+    mSwitchThread = std::thread([this, themePath, themeID, themeName, themeAuthor]() {
+        ThemePatcher patcher;
+        // 只更新原子变量
+        patcher.SetProgressCallback([this](float progress, const std::string& message) {
+            mSwitchProgress = progress;
+        });
+        bool success = patcher.SwitchToTheme(themePath, themeID, themeName, themeAuthor);
+        FileLogger::GetInstance().LogInfo("Theme switch finished: %d", success);
+        mSwitchResult = success ? 1 : -1;
+        mSwitching = false;
+    });
+}
+
+void ManageScreen::DrawSwitchStatus() {
+    if (mSwitching.load()) {
+        const int cardW = 700;
+        const int cardH = 300;
+        const int cardX = (Gfx::SCREEN_WIDTH - cardW) / 2;
+        const int cardY = (Gfx::SCREEN_HEIGHT - cardH) / 2;
+        
+        SDL_Color shadowColor = Gfx::COLOR_SHADOW;
+        shadowColor.a = 100;
+        Gfx::DrawRectRounded(cardX + 8, cardY + 8, cardW, cardH, 24, shadowColor);
+        Gfx::DrawRectRounded(cardX, cardY, cardW, cardH, 24, Gfx::COLOR_CARD_BG);
+        
+        double angle = (mFrameCount % 60) * 6.0;
+        Gfx::DrawIcon(cardX + cardW/2, cardY + 100, 60, Gfx::COLOR_ACCENT, 0xf110, Gfx::ALIGN_CENTER, angle);
+        Gfx::Print(cardX + cardW/2, cardY + 190, 40, Gfx::COLOR_TEXT, _("manage.applying"), Gfx::ALIGN_CENTER);
+        
+        char progressText[16];
+        snprintf(progressText, sizeof(progressText), "%.0f%%", mSwitchProgress.load() * 100);
+        Gfx::Print(cardX + cardW/2, cardY + 245, 30, Gfx::COLOR_ALT_TEXT, progressText, Gfx::ALIGN_CENTER);
+        return;
+    }
     
-    DrawBottomBar(bottomHint.c_str(), 
-                 (std::string("\ue044 ") + _("input.exit")).c_str(), 
-                 (std::string("\ue001 ") + _("input.back")).c_str());
+    // 结果提示显示约 2 秒
+    int result = mSwitchResult.load();
+    if (result == 0) {
+        return;
+    }
+    if (++mSwitchResultFrames > 120) {
+        mSwitchResult = 0;
+        return;
+    }
+    SDL_Color color = (result > 0) ? Gfx::COLOR_SUCCESS : Gfx::COLOR_ERROR;
+    Gfx::Print(Gfx::SCREEN_WIDTH / 2, Gfx::SCREEN_HEIGHT - 140, 32, color,
+              result > 0 ? _("manage.apply_done") : _("manage.apply_failed"), Gfx::ALIGN_CENTER);
+}
+
+void ManageScreen::StartVerify() {
+    // 只校验打过补丁的主题; 线程只使用这份副本, 扫描或卸载改变 mThemes 也没有影响
+    std::vector<std::pair<std::string, std::string>> themes;
+    for (const auto& theme : mThemes) {
+        if (theme.hasPatched) {
+            themes.emplace_back(theme.path, theme.id);
+        }
+    }
+    if (themes.empty()) {
+        return;
+    }
+    
+    FileLogger::GetInstance().LogInfo("Verifying %zu installed theme(s)", themes.size());
+    mVerifying = true;
+    mVerifyProgress = 0.0f;
+    mVerifyResultFrames = -1;
+    mVerifyThread = std::thread([this, themes]() {
+        ThemePatcher patcher;
+        // 只更新原子变量
+        patcher.SetProgressCallback([this](float progress, const std::string& message) {
+            mVerifyProgress = progress;
+        });
+        ThemePatcher::VerifyReport report = patcher.VerifyThemes(themes);
+        // 主线程在 mVerifying 变为 false 之后 join 时才读取
+        mVerifyChecked = report.checkedFiles;
+        mVerifyDamaged = report.damagedFiles;
+        mVerifyDamagedPaths = std::move(report.damagedThemes);
+        mVerifying = false;
+    });
+}
+
+void ManageScreen::DrawVerifyStatus() {
+    if (mVerifying.load()) {
+        const int cardW = 700;
+        const int cardH = 300;
+        const int cardX = (Gfx::SCREEN_WIDTH - cardW) / 2;
+        const int cardY = (Gfx::SCREEN_HEIGHT - cardH) / 2;
+        
+        SDL_Color shadowColor = Gfx::COLOR_SHADOW;
+        shadowColor.a = 100;
+        Gfx::DrawRectRounded(cardX + 8, cardY + 8, cardW, cardH, 24, shadowColor);
+        Gfx::DrawRectRounded(cardX, cardY, cardW, cardH, 24, Gfx::COLOR_CARD_BG);
+        
+        double angle = (mFrameCount % 60) * 6.0;
+        Gfx::DrawIcon(cardX + cardW/2, cardY + 100, 60, Gfx::COLOR_ACCENT, 0xf110, Gfx::ALIGN_CENTER, angle);
+        Gfx::Print(cardX + cardW/2, cardY + 190, 40, Gfx::COLOR_TEXT, _("manage.verifying"), Gfx::ALIGN_CENTER);
+        
+        char progressText[16];
+        snprintf(progressText, sizeof(progressText), "%.0f%%", mVerifyProgress.load() * 100);
+        Gfx::Print(cardX + cardW/2, cardY + 245, 30, Gfx::COLOR_ALT_TEXT, progressText, Gfx::ALIGN_CENTER);
+        return;
+    }
+    
+    // 结果提示显示约 3 秒, 损坏的主题在卡片上保留标记
+    if (mVerifyResultFrames < 0 || mVerifyThread.joinable()) {
+        return;
+    }
+    if (++mVerifyResultFrames > 180) {
+        mVerifyResultFrames = -1;
+        return;
+    }
+    std::string resultText;
+    if (mVerifyDamaged > 0) {
+        resultText = _("manage.verify_damaged");
+        size_t pos = resultText.find("{count}");
+        if (pos != std::string::npos) {
+            resultText.replace(pos, 7, std::to_string(mVerifyDamagedPaths.size()));
+        }
+    } else {
+        resultText = _("manage.verify_ok");
+        size_t pos = resultText.find("{count}");
+        if (pos != std::string::npos) {
+            resultText.replace(pos, 7, std::to_string(mVerifyChecked));
+        }
+    }
+    Gfx::Print(Gfx::SCREEN_WIDTH / 2, Gfx::SCREEN_HEIGHT - 140, 32,
+              mVerifyDamaged > 0 ? Gfx::COLOR_ERROR : Gfx::COLOR_SUCCESS, resultText, Gfx::ALIGN_CENTER);
+}
+
+void ManageScreen::ToggleMarked(int index) {
+    if (index < 0 || index >= (int)mThemes.size()) {
+        return;
+    }
+    LocalTheme& theme = mThemes[index];
+    theme.marked = !theme.marked;
+    mMarkedCount += theme.marked ? 1 : -1;
+}
+
+void ManageScreen::ClearMarks() {
+    for (auto& theme : mThemes) {
+        theme.marked = false;
+    }
+    mMarkedCount = 0;
+}
+
+void ManageScreen::UninstallMarkedThemes() {
+    std::vector<std::string> paths;
+    paths.reserve(mMarkedCount);
+    for (const auto& theme : mThemes) {
+        if (theme.marked) {
+            paths.push_back(theme.path);
+        }
+    }
+    
+    // 目录移到回收站后立即返回, 登记表只写一次
+    std::vector<std::string> removedPaths = ThemePatcher::UninstallThemes(paths);
+    std::set<std::string> removed(removedPaths.begin(), removedPaths.end());
+    mUninstalledCount = (int)removedPaths.size();
+    mUninstallResultFrames = 0;
+    
+    // 直接从列表中去掉, 不重新扫描; 缩略图回调按索引访问列表, 删除后索引会变
+    mImageOwner.Cancel();
+    int selectedIndex = mSelectedIndex;
+    int removedBeforeSelection = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < mThemes.size(); i++) {
+        LocalTheme& theme = mThemes[i];
+        if (removed.count(theme.path)) {
+            if (!theme.collageThumbTexture.IsEmpty()) {
+                theme.collageThumbTexture.Reset();
+                ImageLoader::RemoveFromCache(theme.collageThumbPath);
+            }
+            if ((int)i < selectedIndex) {
+                removedBeforeSelection++;
+            }
+            continue;
+        }
+        // 没能移走的主题保留在列表中, 取消勾选
+        theme.marked = false;
+        // 被取消的缩略图请求重新发出
+        if (theme.collageThumbTexture.IsEmpty()) {
+            theme.collageThumbLoaded = false;
+        }
+        if (kept != i) {
+            mThemes[kept] = std::move(theme);
+        }
+        kept++;
+    }
+    mThemes.resize(kept);
+    mMarkedCount = 0;
+    
+    const int themeCount = (int)mThemes.size();
+    mSelectedIndex = std::max(0, std::min(selectedIndex - removedBeforeSelection, themeCount - 1));
+    mScrollOffset = std::max(0, std::min(mScrollOffset, std::max(0, themeCount - VISIBLE_COUNT)));
+    if (mSelectedIndex < mScrollOffset) {
+        mScrollOffset = mSelectedIndex;
+    } else if (mSelectedIndex >= mScrollOffset + VISIBLE_COUNT) {
+        mScrollOffset = mSelectedIndex - VISIBLE_COUNT + 1;
+    }
+    mScroll.SetLimits(themeCount, VISIBLE_COUNT);
+    mScroll.Jump(mScrollOffset);
+    mWarmUpScrollOffset = -1;
+    InitAnimations();
+}
+
+void ManageScreen::DrawUninstallStatus() {
+    if (mConfirmUninstall) {
+        const int cardW = 800;
+        const int cardH = 320;
+        const int cardX = (Gfx::SCREEN_WIDTH - cardW) / 2;
+        const int cardY = (Gfx::SCREEN_HEIGHT - cardH) / 2;
+        
+        SDL_Color shadowColor = Gfx::COLOR_SHADOW;
+        shadowColor.a = 100;
+        Gfx::DrawRectRounded(cardX + 8, cardY + 8, cardW, cardH, 24, shadowColor);
+        Gfx::DrawRectRounded(cardX, cardY, cardW, cardH, 24, Gfx::COLOR_CARD_BG);
+        
+        Gfx::DrawIcon(cardX + cardW/2, cardY + 80, 60, Gfx::COLOR_WARNING, 0xf071, Gfx::ALIGN_CENTER);
+        
+        std::string confirmText = _("manage.uninstall_marked_confirm");
+        size_t pos = confirmText.find("{count}");
+        if (pos != std::string::npos) {
+            confirmText.replace(pos, 7, std::to_string(mMarkedCount));
+        }
+        Gfx::Print(cardX + cardW/2, cardY + 170, 36, Gfx::COLOR_TEXT, confirmText, Gfx::ALIGN_CENTER);
+        Gfx::Print(cardX + cardW/2, cardY + 250, 30, Gfx::COLOR_ALT_TEXT,
+                  FrameArena::Format("\ue000 %s  |  \ue001 %s", _("common.confirm").c_str(), _("input.back").c_str()),
+                  Gfx::ALIGN_CENTER);
+        return;
+    }
+    
+    // 结果提示显示约 2 秒
+    if (mUninstalledCount == 0) {
+        return;
+    }
+    if (++mUninstallResultFrames > 120) {
+        mUninstalledCount = 0;
+        return;
+    }
+    std::string doneText = _("manage.uninstall_done");
+    size_t pos = doneText.find("{count}");
+    if (pos != std::string::npos) {
+        doneText.replace(pos, 7, std::to_string(mUninstalledCount));
+    }
+    Gfx::Print(Gfx::SCREEN_WIDTH / 2, Gfx::SCREEN_HEIGHT - 140, 32, Gfx::COLOR_SUCCESS, doneText, Gfx::ALIGN_CENTER);
 }
 
 void ManageScreen::DrawThemeList() {
+    mCardHits.Clear();
     if (mThemes.empty()) {
         return;
     }
@@ -345,14 +525,35 @@ void ManageScreen::DrawThemeList() {
     const int cardH = CARD_HEIGHT;
     const int cardSpacing = CARD_SPACING;
     const int visibleCount = VISIBLE_COUNT;
+    const int themeCount = (int)mThemes.size();
+    mScroll.SetLimits(themeCount, visibleCount);
     
-    int currentY = listY;
-    int endIndex = std::min(mScrollOffset + visibleCount, (int)mThemes.size());
-    
-    for (int i = mScrollOffset; i < endIndex; i++) {
+    // 滚动位置是小数: 从最上面露出一部分的卡片画到最下面露出一部分的卡片, 裁剪到列表区域
+    const float position = mScroll.GetPosition();
+    const int firstRow = mScroll.GetFirstRow();
+    SDL_Rect listClip = {0, listY - cardSpacing, Gfx::SCREEN_WIDTH, visibleCount * (cardH + cardSpacing) + cardSpacing};
+    SDL_RenderSetClipRect(Gfx::GetRenderer(), &listClip);
+    for (int i = std::max(0, firstRow); i < std::min(firstRow + visibleCount + 1, themeCount); i++) {
         bool selected = (i == mSelectedIndex);
-        DrawThemeCard(mThemes[i], listX, currentY, cardW, cardH, selected, i);
-        currentY += cardH + cardSpacing;
+        int cardY = listY + (int)std::lround((i - position) * (cardH + cardSpacing));
+        DrawThemeCard(mThemes[i], listX, cardY, cardW, cardH, selected, i);
+        SDL_Rect cardRect = {listX, cardY, cardW, cardH};
+        SDL_Rect hitRect;
+        if (SDL_IntersectRect(&cardRect, &listClip, &hitRect)) {
+            mCardHits.Add(i, hitRect);
+        }
+    }
+    SDL_RenderSetClipRect(Gfx::GetRenderer(), nullptr);
+    
+    // 惯性滑行中先读入停下时会显示的缩略图, 滑到时卡片已经可以画完整
+    if (mScrollOffset != mWarmUpScrollOffset) {
+        mWarmUpScrollOffset = mScrollOffset;
+        for (int i = mScrollOffset; i < std::min(mScrollOffset + visibleCount, themeCount); i++) {
+            LocalTheme& theme = mThemes[i];
+            if (theme.collageThumbTexture.IsEmpty() && !theme.collageThumbPath.empty() && !theme.collageThumbLoaded) {
+                RequestThumbnail(i, false);
+            }
+        }
     }
     
     // 绘制滚动指示器
@@ -366,12 +567,10 @@ void ManageScreen::DrawThemeList() {
 
 void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h, bool selected, int themeIndex) {
     // 获取动画值
-    float scale = 1.0f;
-    float highlight = 0.0f;
-    if (themeIndex >= 0 && themeIndex < (int)mThemeAnims.size()) {
-        scale = mThemeAnims[themeIndex].scaleAnim.GetValue();
-        highlight = mThemeAnims[themeIndex].highlightAnim.GetValue();
-    }
+    float scale = mThemeAnims.GetScale(themeIndex);
+    float highlight = mThemeAnims.GetHighlight(themeIndex);
+    const int baseW = w;
+    const int baseH = h;
     
     // 应用缩放
     int scaledW = (int)(w * scale);
@@ -396,9 +595,34 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
         Gfx::DrawRectRounded(x - 4, y - 4, w + 8, h + 8, 20, glowColor);
     }
     
-    // 绘制卡片背景
-    SDL_Color bgColor = selected ? Gfx::COLOR_CARD_HOVER : Gfx::COLOR_CARD_BG;
-    Gfx::DrawRectRounded(x, y, w, h, 16, bgColor);
+    // 纹理已被缓存淘汰时重新加载 (Get 同时标记它正在显示, 使用缓存的卡片时也要每帧调用)
+    SDL_Texture* thumb = theme.collageThumbTexture.Get();
+    if (!thumb && !theme.collageThumbTexture.IsEmpty()) {
+        theme.collageThumbTexture.Reset();
+        theme.collageThumbLoaded = false;
+    }
+    
+    // 卡片内容缓存为纹理; 缩略图加载中时有旋转动画, 直接绘制
+    bool thumbLoading = !thumb && !theme.collageThumbPath.empty() && !theme.collageThumbLoaded;
+    bool cached = false;
+    if (!thumbLoading) {
+        uint64_t signature = CardTextureCache::SIGNATURE_SEED;
+        signature = CardTextureCache::Mix(signature, theme.displayName);
+        signature = CardTextureCache::Mix(signature, theme.displayAuthor);
+        signature = CardTextureCache::Mix(signature, (uint64_t)theme.downloads << 32 | (uint32_t)theme.likes);
+        signature = CardTextureCache::Mix(signature, (uint64_t)theme.bpsCount << 3 | (uint64_t)theme.isCurrent << 2 |
+                                                     (uint64_t)theme.hasPatched << 1 | (uint64_t)selected |
+                                                     (uint64_t)theme.marked << 4 | (uint64_t)theme.hasUpdate << 5 |
+                                                     (uint64_t)theme.damaged << 6);
+        signature = CardTextureCache::Mix(signature, (uint64_t)(uintptr_t)thumb);
+        signature = CardTextureCache::Mix(signature, (uint64_t)theme.collageThumbRetryCount);
+        signature = CardTextureCache::Mix(signature, Lang().GetCurrentLanguage());
+        cached = mCardCache.Draw(theme.path, signature, baseW, baseH, SDL_Rect{x, y, w, h},
+                                 [&]() { DrawThemeCardContent(theme, 0, 0, baseW, baseH, selected, themeIndex); });
+    }
+    if (!cached) {
+        DrawThemeCardContent(theme, x, y, w, h, selected, themeIndex);
+    }
     
     // 绘制边框(如果选中)
     if (selected) {
@@ -406,6 +630,13 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
         borderColor.a = (uint8_t)(150 + 100 * highlight);
         Gfx::DrawRectRoundedOutline(x, y, w, h, 16, 3, borderColor);
     }
+}
+
+// 卡片的背景、缩略图、文字和标签, 不含随选中动画变化的部分
+void ManageScreen::DrawThemeCardContent(LocalTheme& theme, int x, int y, int w, int h, bool selected, int themeIndex) {
+    // 绘制卡片背景
+    SDL_Color bgColor = selected ? Gfx::COLOR_CARD_HOVER : Gfx::COLOR_CARD_BG;
+    Gfx::DrawRectRounded(x, y, w, h, 16, bgColor);
     
     // 左侧缩略图区域 - 16:9 比例
     const int thumbH = h - 40;
@@ -414,13 +645,14 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
     const int thumbY = y + 20;
     
     // 绘制缩略图 - 使用 ImageLoader 异步加载 webp
-    if (theme.collageThumbTexture) {
+    SDL_Texture* thumb = theme.collageThumbTexture.Get();
+    if (thumb) {
         // 已加载,绘制纹理
         SDL_Rect dstRect = {thumbX, thumbY, thumbW, thumbH};
         
         // 获取纹理尺寸
         int texW, texH;
-        SDL_QueryTexture(theme.collageThumbTexture, nullptr, nullptr, &texW, &texH);
+        SDL_QueryTexture(thumb, nullptr, nullptr, &texW, &texH);
         
         // 计算缩放以保持纵横比
         float imgScale = std::min((float)thumbW / texW, (float)thumbH / texH);
@@ -437,7 +669,7 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
         Gfx::DrawRectFilled(thumbX, thumbY, thumbW, thumbH, Gfx::COLOR_ALT_BACKGROUND);
         
         // 绘制纹理
-        SDL_RenderCopy(Gfx::GetRenderer(), theme.collageThumbTexture, nullptr, &dstRect);
+        Gfx::DrawTexture(thumb, nullptr, dstRect);
         
     } else if (!theme.collageThumbPath.empty() && !theme.collageThumbLoaded) {
         // 还未加载,显示占位符并异步加载
@@ -451,43 +683,10 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
         Gfx::Print(thumbX + thumbW/2, thumbY + thumbH/2 + 30, 24, Gfx::COLOR_ALT_TEXT, 
                   _("download.loading_image"), Gfx::ALIGN_CENTER);
         
-        // 标记为正在加载
-        theme.collageThumbLoaded = true;
-        
-        // 异步加载 webp 文件 - 直接使用本地路径
-        ImageLoader::LoadRequest request;
-        request.url = theme.collageThumbPath;  // 本地文件路径
-        request.highPriority = selected;
-        request.callback = [this, themeIndex](SDL_Texture* texture) {
-            if (themeIndex >= 0 && themeIndex < (int)mThemes.size()) {
-                if (texture) {
-                    // 加载成功
-                    mThemes[themeIndex].collageThumbTexture = texture;
-                    FileLogger::GetInstance().LogInfo("Loaded webp image for theme %d: %s", 
-                        themeIndex, mThemes[themeIndex].name.c_str());
-                } else {
-                    // 加载失败,检查重试次数
-                    mThemes[themeIndex].collageThumbRetryCount++;
-                    
-                    if (mThemes[themeIndex].collageThumbRetryCount < 3) {
-                        // 重试 (最多3次)
-                        FileLogger::GetInstance().LogWarning("Failed to load webp image for theme %d, retry %d/3", 
-                            themeIndex, mThemes[themeIndex].collageThumbRetryCount);
-                        
-                        // 重置加载标志以触发重新加载
-                        mThemes[themeIndex].collageThumbLoaded = false;
-                    } else {
-                        // 重试次数已用尽,停止加载
-                        FileLogger::GetInstance().LogError("Failed to load webp image for theme %d after 3 retries, giving up", 
-                            themeIndex);
-                    }
-                }
-            }
-        };
-        ImageLoader::LoadAsync(request);
+        RequestThumbnail(themeIndex, selected);
         
     } else if (!theme.collageThumbPath.empty() && theme.collageThumbLoaded && 
-               !theme.collageThumbTexture && theme.collageThumbRetryCount >= 3) {
+               !thumb && theme.collageThumbRetryCount >= 3) {
         // 加载失败且已达到最大重试次数,显示错误图标
         Gfx::DrawRectRounded(thumbX, thumbY, thumbW, thumbH, 12, Gfx::COLOR_ALT_BACKGROUND);
         Gfx::DrawIcon(thumbX + thumbW/2, thumbY + thumbH/2, 50, Gfx::COLOR_ERROR, 0xf071, Gfx::ALIGN_CENTER); // warning icon
@@ -498,43 +697,58 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
         Gfx::DrawIcon(thumbX + thumbW/2, thumbY + thumbH/2, 50, Gfx::COLOR_ICON, 0xf03e, Gfx::ALIGN_CENTER);
     }
     
+    // 多选中已勾选: 缩略图左上角的勾选标记
+    if (theme.marked) {
+        SDL_Color markBg = Gfx::COLOR_ACCENT;
+        markBg.a = 230;
+        Gfx::DrawRectRounded(thumbX + 10, thumbY + 10, 50, 50, 12, markBg);
+        Gfx::DrawIcon(thumbX + 35, thumbY + 35, 30, Gfx::COLOR_WHITE, 0xf00c, Gfx::ALIGN_CENTER);
+    }
+    
     // 主题信息区域
     const int infoX = thumbX + thumbW + 30;
     const int infoY = y + 30;
     
-    // 主题名称 - 清理特殊字符用于显示
-    std::string displayName = Utils::SanitizeThemeNameForDisplay(theme.name);
-    if (displayName.length() > 45) {
-        displayName = displayName.substr(0, 42) + "...";
-    }
-    Gfx::Print(infoX, infoY, 38, Gfx::COLOR_TEXT, displayName.c_str(), Gfx::ALIGN_VERTICAL);
+    // 主题名称 - 清理特殊字符并截断 (扫描时生成)
+    Gfx::PrintStatic(infoX, infoY, 38, Gfx::COLOR_TEXT, theme.displayName, Gfx::ALIGN_VERTICAL);
     
     // 作者
     int currentInfoY = infoY + 48;
     Gfx::DrawIcon(infoX, currentInfoY, 20, Gfx::COLOR_ALT_TEXT, 0xf007, Gfx::ALIGN_VERTICAL);
-    std::string authorText = theme.author.empty() ? "Unknown" : theme.author;
-    if (authorText.length() > 35) {
-        authorText = authorText.substr(0, 32) + "...";
-    }
-    Gfx::Print(infoX + 28, currentInfoY, 28, Gfx::COLOR_ALT_TEXT, authorText.c_str(), Gfx::ALIGN_VERTICAL);
+    Gfx::PrintStatic(infoX + 28, currentInfoY, 28, Gfx::COLOR_ALT_TEXT, theme.displayAuthor, Gfx::ALIGN_VERTICAL);
     
     // 统计信息
     currentInfoY += 40;
     if (theme.downloads > 0) {
-        char statsText[64];
         Gfx::DrawIcon(infoX, currentInfoY, 18, Gfx::COLOR_ALT_TEXT, 0xf019, Gfx::ALIGN_VERTICAL);
-        snprintf(statsText, sizeof(statsText), "%d", theme.downloads);
-        Gfx::Print(infoX + 25, currentInfoY, 24, Gfx::COLOR_ALT_TEXT, statsText, Gfx::ALIGN_VERTICAL);
+        Gfx::Print(infoX + 25, currentInfoY, 24, Gfx::COLOR_ALT_TEXT, theme.downloadsText, Gfx::ALIGN_VERTICAL);
         
         if (theme.likes > 0) {
             Gfx::DrawIcon(infoX + 120, currentInfoY, 18, Gfx::COLOR_ALT_TEXT, 0xf004, Gfx::ALIGN_VERTICAL);
-            snprintf(statsText, sizeof(statsText), "%d", theme.likes);
-            Gfx::Print(infoX + 145, currentInfoY, 24, Gfx::COLOR_ALT_TEXT, statsText, Gfx::ALIGN_VERTICAL);
+            Gfx::Print(infoX + 145, currentInfoY, 24, Gfx::COLOR_ALT_TEXT, theme.likesText, Gfx::ALIGN_VERTICAL);
         }
     }
     
     // 状态标签（右上角,与 DownloadScreen 样式一致）
-    if (theme.hasPatched) {
+    if (theme.isCurrent) {
+        // "使用中"标签 - 右上角显示
+        const int badgeW = 140;
+        const int badgeH = 45;
+        const int badgeX = x + w - badgeW - 20;
+        const int badgeY = y + 20;
+        
+        // 背景 - 强调色
+        SDL_Color badgeBg = Gfx::COLOR_ACCENT;
+        badgeBg.a = 220;
+        Gfx::DrawRectRounded(badgeX, badgeY, badgeW, badgeH, 8, badgeBg);
+        
+        // 图标 - 星标
+        Gfx::DrawIcon(badgeX + 15, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 0xf005, Gfx::ALIGN_VERTICAL);
+        
+        // 文字
+        Gfx::Print(badgeX + 50, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 
+                  _("manage.current"), Gfx::ALIGN_VERTICAL);
+    } else if (theme.hasPatched) {
         // "已安装"标签 - 右上角显示
         const int badgeW = 140;
         const int badgeH = 45;
@@ -571,6 +785,82 @@ void ManageScreen::DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h,
         Gfx::Print(badgeX + 50, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 
                   _("manage.ready"), Gfx::ALIGN_VERTICAL);
     }
+    
+    // "有更新"标签 - 状态标签下方
+    if (theme.hasUpdate) {
+        const int badgeW = 140;
+        const int badgeH = 45;
+        const int badgeX = x + w - badgeW - 20;
+        const int badgeY = y + 75;
+        
+        SDL_Color badgeBg = Gfx::COLOR_WIIU;
+        badgeBg.a = 220;
+        Gfx::DrawRectRounded(badgeX, badgeY, badgeW, badgeH, 8, badgeBg);
+        
+        // 图标 - 刷新
+        Gfx::DrawIcon(badgeX + 15, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 0xf021, Gfx::ALIGN_VERTICAL);
+        
+        Gfx::Print(badgeX + 50, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 
+                  _("manage.update_available"), Gfx::ALIGN_VERTICAL);
+    }
+    
+    // "已损坏"标签 - 校验发现输出缺少或不一致, 放在其他标签下方
+    if (theme.damaged) {
+        const int badgeW = 140;
+        const int badgeH = 45;
+        const int badgeX = x + w - badgeW - 20;
+        const int badgeY = y + (theme.hasUpdate ? 130 : 75);
+        
+        SDL_Color badgeBg = Gfx::COLOR_ERROR;
+        badgeBg.a = 220;
+        Gfx::DrawRectRounded(badgeX, badgeY, badgeW, badgeH, 8, badgeBg);
+        
+        // 图标 - 警告
+        Gfx::DrawIcon(badgeX + 15, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 0xf071, Gfx::ALIGN_VERTICAL);
+        
+        Gfx::Print(badgeX + 50, badgeY + badgeH/2, 28, Gfx::COLOR_WHITE, 
+                  _("manage.damaged"), Gfx::ALIGN_VERTICAL);
+    }
+}
+
+void ManageScreen::RequestThumbnail(int themeIndex, bool highPriority) {
+    LocalTheme& theme = mThemes[themeIndex];
+    
+    // 标记为正在加载
+    theme.collageThumbLoaded = true;
+    
+    // 异步加载 webp 文件 - 直接使用本地路径
+    ImageLoader::LoadRequest request;
+    request.url = theme.collageThumbPath;  // 本地文件路径
+    request.highPriority = highPriority;
+    request.owner = &mImageOwner;
+    request.callback = [this, themeIndex](SDL_Texture* texture) {
+        if (themeIndex >= 0 && themeIndex < (int)mThemes.size()) {
+            if (texture) {
+                // 加载成功
+                mThemes[themeIndex].collageThumbTexture = ImageLoader::TextureHandle(mThemes[themeIndex].collageThumbPath);
+                FileLogger::GetInstance().LogInfo("Loaded webp image for theme %d: %s", 
+                    themeIndex, mThemes[themeIndex].name.c_str());
+            } else {
+                // 加载失败,检查重试次数
+                mThemes[themeIndex].collageThumbRetryCount++;
+                
+                if (mThemes[themeIndex].collageThumbRetryCount < 3) {
+                    // 重试 (最多3次)
+                    FileLogger::GetInstance().LogWarning("Failed to load webp image for theme %d, retry %d/3", 
+                        themeIndex, mThemes[themeIndex].collageThumbRetryCount);
+                    
+                    // 重置加载标志以触发重新加载
+                    mThemes[themeIndex].collageThumbLoaded = false;
+                } else {
+                    // 重试次数已用尽,停止加载
+                    FileLogger::GetInstance().LogError("Failed to load webp image for theme %d after 3 retries, giving up", 
+                        themeIndex);
+                }
+            }
+        }
+    };
+    ImageLoader::LoadAsync(request);
 }
 
 bool ManageScreen::Update(Input &input) {
@@ -582,6 +872,53 @@ bool ManageScreen::Update(Input &input) {
     // 更新图片加载器
     ImageLoader::Update();
     
+    // 正在切换主题或校验时不处理输入
+    if (mSwitching.load() || mVerifying.load()) {
+        return true;
+    }
+    // 后台的同步刚标记了更新
+    if (ThemeRegistry::GetInstance().GetUpdatesVersion() != mUpdatesVersion) {
+        RefreshUpdateFlags();
+    }
+    if (mSwitchThread.joinable()) {
+        // 切换刚结束: 更新"使用中"标记
+        mSwitchThread.join();
+        if (mSwitchResult.load() == 1) {
+            for (auto& theme : mThemes) {
+                theme.isCurrent = (theme.path == mSwitchThemePath);
+                if (theme.isCurrent) {
+                    theme.hasPatched = true;
+                    theme.damaged = false;
+                }
+            }
+        }
+    }
+    if (mVerifyThread.joinable()) {
+        // 校验刚结束: 标记损坏的主题
+        mVerifyThread.join();
+        std::set<std::string> damaged(mVerifyDamagedPaths.begin(), mVerifyDamagedPaths.end());
+        for (auto& theme : mThemes) {
+            theme.damaged = damaged.count(theme.path) > 0;
+        }
+        mVerifyResultFrames = 0;
+    }
+    
+    // 批量卸载的确认框: A 卸载, B 取消
+    if (mConfirmUninstall) {
+        if (input.data.buttons_d & Input::BUTTON_A) {
+            if (InstallQueue::GetInstance().IsInstalling()) {
+                // 排队的安装可能正在写其中的主题目录, 等它结束
+                FileLogger::GetInstance().LogWarning("A queued install is running, batch uninstall postponed");
+            } else {
+                mConfirmUninstall = false;
+                UninstallMarkedThemes();
+            }
+        } else if (input.data.buttons_d & Input::BUTTON_B) {
+            mConfirmUninstall = false;
+        }
+        return true;
+    }
+    
     // 如果没有主题,按 A 返回主菜单(让用户选择下载)
     if (mThemes.empty()) {
         if (input.data.buttons_d & Input::BUTTON_A) {
@@ -599,43 +936,13 @@ bool ManageScreen::Update(Input &input) {
         if (input.data.buttons_d & Input::BUTTON_X) {
             FileLogger::GetInstance().LogInfo("Opening LocalInstallScreen (empty theme list)");
             
-            // 创建本地安装屏幕
-            LocalInstallScreen* installScreen = new LocalInstallScreen();
-            
-            // 创建输入对象
-            CombinedInput installBaseInput;
-            VPadInput installVpadInput;
-            WPADInput installWpadInputs[4] = {WPAD_CHAN_0, WPAD_CHAN_1, WPAD_CHAN_2, WPAD_CHAN_3};
-            
-            // 进入本地安装屏幕循环
-            while (true) {
-                installBaseInput.reset();
-                if (installVpadInput.update(1280, 720)) {
-                    installBaseInput.combine(installVpadInput);
-                }
-                for (auto &wpadInput : installWpadInputs) {
-                    if (wpadInput.update(1280, 720)) {
-                        installBaseInput.combine(wpadInput);
-                    }
-                }
-                installBaseInput.process();
-                
-                if (!installScreen->Update(installBaseInput)) {
-                    break; // 返回管理列表
-                }
+            ScreenStack::Push(std::make_unique<LocalInstallScreen>(), [this]() {
+                FileLogger::GetInstance().LogInfo("Returned from LocalInstallScreen");
                 
-                installScreen->Draw();
-                Gfx::Render();
-            }
-            
-            // 清理本地安装屏幕
-            delete installScreen;
-            
-            FileLogger::GetInstance().LogInfo("Returned from LocalInstallScreen");
-            
-            // 重新加载主题列表(可能刚刚安装了新主题)
-            ScanLocalThemes();
-            InitAnimations();
+                // 重新加载主题列表(可能刚刚安装了新主题)
+                ScanLocalThemes();
+                InitAnimations();
+            });
             
             return true;
         }
@@ -648,41 +955,52 @@ bool ManageScreen::Update(Input &input) {
     
     // 处理列表导航 - 和 DownloadScreen 一样
     if (!mThemes.empty()) {
-        // 检测上下按键和摇杆输入(支持循环和长按连续)
-        bool upPressed = (input.data.buttons_d & Input::BUTTON_UP) || (input.data.buttons_d & Input::STICK_L_UP);
-        bool downPressed = (input.data.buttons_d & Input::BUTTON_DOWN) || (input.data.buttons_d & Input::STICK_L_DOWN);
-        bool upHeld = (input.data.buttons_h & Input::BUTTON_UP) || (input.data.buttons_h & Input::STICK_L_UP);
-        bool downHeld = (input.data.buttons_h & Input::BUTTON_DOWN) || (input.data.buttons_h & Input::STICK_L_DOWN);
-        
-        // 处理按下事件
-        if (upPressed || downPressed) {
-            mHoldFrames = 0;  // 重置计数器
-        }
-        
-        // 长按连续选择逻辑
-        bool shouldMoveUp = upPressed;
-        bool shouldMoveDown = downPressed;
+        const int themeCount = (int)mThemes.size();
+        mScroll.SetLimits(themeCount, VISIBLE_COUNT);
         
-        if (upHeld && !upPressed) {
-            mHoldFrames++;
-            if (mHoldFrames > mRepeatDelay) {
-                if ((mHoldFrames - mRepeatDelay) % mRepeatRate == 0) {
-                    shouldMoveUp = true;
-                }
+        // 触摸: 拖动滚动列表, 松开后惯性滑行; 没有拖动的触摸是点击 (卡片区域在 DrawThemeList 中登记)
+        int touchX, touchY;
+        if (GetTouch(input, touchX, touchY)) {
+            if (!mScroll.IsDragging()) {
+                mScroll.TouchDown(touchY);
+                mTouchDownX = touchX;
+                mTouchDownY = touchY;
+            } else {
+                mScroll.TouchMove(touchY);
             }
-        } else if (downHeld && !downPressed) {
-            mHoldFrames++;
-            if (mHoldFrames > mRepeatDelay) {
-                if ((mHoldFrames - mRepeatDelay) % mRepeatRate == 0) {
-                    shouldMoveDown = true;
+        } else if (!input.data.touched && mScroll.IsDragging() && mScroll.TouchUp()) {
+            int clickedIndex = mCardHits.Hit(mTouchDownX, mTouchDownY);
+            if (clickedIndex >= 0 && clickedIndex < themeCount) {
+                if (clickedIndex != mSelectedIndex) {
+                    // 先更新选择
+                    mSelectedIndex = clickedIndex;
+                } else {
+                    // 双击效果: 如果已经选中, 触发 A 按钮效果直接进入详情
+                    input.data.buttons_d |= Input::BUTTON_A;
                 }
             }
-        } else if (!upHeld && !downHeld) {
-            mHoldFrames = 0;
         }
         
+        mScroll.Update();
+        mScrollOffset = mScroll.GetRestingRow();
+        
+        // 触摸滚动停下时选中项可能已经离开屏幕: 改为选中最近的可见卡片
+        if (mScroll.ConsumeTouchSettled()) {
+            int lastVisible = std::min(mScrollOffset + VISIBLE_COUNT, themeCount) - 1;
+            mSelectedIndex = std::max(mScrollOffset, std::min(mSelectedIndex, lastVisible));
+        }
+        
+        // 检测上下按键和摇杆输入(支持循环和长按连续, 按住 0.5 秒后每 0.1 秒移动一次)
+        bool upPressed = (input.data.buttons_d & Input::BUTTON_UP) || (input.data.buttons_d & Input::STICK_L_UP);
+        bool downPressed = (input.data.buttons_d & Input::BUTTON_DOWN) || (input.data.buttons_d & Input::STICK_L_DOWN);
+        bool upHeld = (input.data.buttons_h & Input::BUTTON_UP) || (input.data.buttons_h & Input::STICK_L_UP);
+        bool downHeld = (input.data.buttons_h & Input::BUTTON_DOWN) || (input.data.buttons_h & Input::STICK_L_DOWN);
+        
+        bool shouldMove = mKeyRepeat.Update(upPressed || downPressed, upHeld || downHeld);
+        bool shouldMoveUp = shouldMove && (upPressed || (!downPressed && upHeld));
+        bool shouldMoveDown = shouldMove && !shouldMoveUp;
+        
         // 上下选择(支持循环)
-        const int themeCount = (int)mThemes.size();
         if (shouldMoveUp) {
             if (mSelectedIndex > 0) {
                 mSelectedIndex--;
@@ -690,11 +1008,16 @@ bool ManageScreen::Update(Input &input) {
                 // 循环到底部
                 mSelectedIndex = themeCount - 1;
                 mScrollOffset = std::max(0, themeCount - VISIBLE_COUNT);
+                mScroll.Jump(mScrollOffset);
             }
-            // 调整滚动
+            // 调整滚动 (选中项滑行后可能在屏幕外, 两个方向都要检查)
             if (mSelectedIndex < mScrollOffset) {
                 mScrollOffset = mSelectedIndex;
             }
+            if (mSelectedIndex >= mScrollOffset + VISIBLE_COUNT) {
+                mScrollOffset = mSelectedIndex - VISIBLE_COUNT + 1;
+            }
+            mScroll.ScrollTo(mScrollOffset);
         } else if (shouldMoveDown) {
             if (mSelectedIndex < themeCount - 1) {
                 mSelectedIndex++;
@@ -702,78 +1025,45 @@ bool ManageScreen::Update(Input &input) {
                 // 循环到顶部
                 mSelectedIndex = 0;
                 mScrollOffset = 0;
+                mScroll.Jump(0);
             }
             // 调整滚动 (显示3个)
             if (mSelectedIndex >= mScrollOffset + VISIBLE_COUNT) {
                 mScrollOffset = mSelectedIndex - VISIBLE_COUNT + 1;
             }
+            if (mSelectedIndex < mScrollOffset) {
+                mScrollOffset = mSelectedIndex;
+            }
+            mScroll.ScrollTo(mScrollOffset);
         }
         
         // 如果选择改变，更新动画
         if (prevSelected != mSelectedIndex) {
-            // 重置旧的选择
-            if (prevSelected >= 0 && prevSelected < (int)mThemeAnims.size()) {
-                mThemeAnims[prevSelected].scaleAnim.SetTarget(1.0f, 300);
-                mThemeAnims[prevSelected].highlightAnim.SetTarget(0.0f, 300);
-            }
-            
-            // 高亮新的选择
-            if (mSelectedIndex >= 0 && mSelectedIndex < (int)mThemeAnims.size()) {
-                mThemeAnims[mSelectedIndex].scaleAnim.SetTarget(1.05f, 300);
-                mThemeAnims[mSelectedIndex].highlightAnim.SetTarget(1.0f, 300);
-            }
+            mThemeAnims.Select(prevSelected, mSelectedIndex);
         }
         
-        // 处理触摸输入
-        if (input.data.touched && input.data.validPointer && !input.lastData.touched) {
-            // 转换触摸坐标
-            float scaleX = 1920.0f / 1280.0f;
-            float scaleY = 1080.0f / 720.0f;
-            int touchX = (int)((input.data.x * scaleX) + 960);
-            int touchY = (int)(540 - (input.data.y * scaleY));
-            
-            FileLogger::GetInstance().LogInfo("Touch at (%d, %d)", touchX, touchY);
-            
-            // 检查是否点击了某个主题卡片
-            const int cardX = 100;
-            const int cardY = 170;
-            const int cardW = 1720;
-            const int cardH = 200;
-            const int cardSpacing = 15;
-            
-            for (int i = 0; i < VISIBLE_COUNT && (mScrollOffset + i) < (int)mThemes.size(); i++) {
-                int y = cardY + i * (cardH + cardSpacing);
-                
-                if (touchX >= cardX && touchX <= (cardX + cardW) &&
-                    touchY >= y && touchY <= (y + cardH)) {
-                    // 点击了这个主题
-                    int clickedIndex = mScrollOffset + i;
-                    
-                    if (clickedIndex != mSelectedIndex) {
-                        // 先更新选择
-                        int prevSel = mSelectedIndex;
-                        mSelectedIndex = clickedIndex;
-                        
-                        // 更新动画
-                        if (prevSel >= 0 && prevSel < (int)mThemeAnims.size()) {
-                            mThemeAnims[prevSel].scaleAnim.SetTarget(1.0f, 300);
-                            mThemeAnims[prevSel].highlightAnim.SetTarget(0.0f, 300);
-                        }
-                        if (mSelectedIndex >= 0 && mSelectedIndex < (int)mThemeAnims.size()) {
-                            mThemeAnims[mSelectedIndex].scaleAnim.SetTarget(1.05f, 300);
-                            mThemeAnims[mSelectedIndex].highlightAnim.SetTarget(1.0f, 300);
-                        }
-                        
-                        FileLogger::GetInstance().LogInfo("Theme selected by touch: %d", mSelectedIndex);
-                    } else {
-                        // 双击效果: 如果已经选中,直接进入详情
-                        FileLogger::GetInstance().LogInfo("Double-tap detected, opening details");
-                        // 触发 A 按钮效果
-                        input.data.buttons_d |= Input::BUTTON_A;
-                    }
-                    break;
-                }
+        // 多选: - 勾选当前主题 (ZL + ZR + - 是性能 HUD); 有勾选时 A 勾选, + 确认卸载, B 取消全部勾选
+        const uint32_t hudCombo = Input::BUTTON_ZL | Input::BUTTON_ZR;
+        bool hudComboHeld = (input.data.buttons_h & hudCombo) == hudCombo;
+        if ((input.data.buttons_d & Input::BUTTON_MINUS) && !hudComboHeld) {
+            ToggleMarked(mSelectedIndex);
+            return true;
+        }
+        if (mMarkedCount > 0) {
+            if (input.data.buttons_d & Input::BUTTON_A) {
+                ToggleMarked(mSelectedIndex);
+            } else if ((input.data.buttons_d & Input::BUTTON_PLUS) && !hudComboHeld) {
+                mConfirmUninstall = true;
+            } else if (input.data.buttons_d & Input::BUTTON_B) {
+                ClearMarks();
             }
+            return true;
+        }
+        
+        // 没有勾选时 + 校验已安装主题的输出
+        if ((input.data.buttons_d & Input::BUTTON_PLUS) && !hudComboHeld) {
+            StartVerify();
+            return true;
         }
         
         // 按 A 进入详情
@@ -783,63 +1073,37 @@ bool ManageScreen::Update(Input &input) {
                 FileLogger::GetInstance().LogInfo("Opening details for theme: %s", localTheme.name.c_str());
                 
                 // 将 LocalTheme 转换为 Theme 结构
-                Theme theme;
-                theme.id = localTheme.id;
-                theme.name = localTheme.name;
-                theme.author = localTheme.author;
-                theme.description = localTheme.description;
-                theme.downloads = localTheme.downloads;
-                theme.likes = localTheme.likes;
-                theme.updatedAt = localTheme.updatedAt;
-                theme.tags = localTheme.tags;
+                // 详情页持有它的指针, 由关闭回调保持到详情页销毁
+                auto theme = std::make_shared<Theme>();
+                ThemeDetails& details = theme->EditDetails();
+                theme->id = localTheme.id;
+                theme->name = localTheme.name;
+                theme->author = localTheme.author;
+                details.description = localTheme.description;
+                theme->downloads = localTheme.downloads;
+                theme->likes = localTheme.likes;
+                theme->updatedAt = localTheme.updatedAt;
+                theme->tags.assign(localTheme.tags.begin(), localTheme.tags.end());
+                ThemeManager::BuildDisplayStrings(*theme);
                 
                 // 设置图片 URL - 直接使用本地路径,不添加 file:// 前缀
-                theme.collagePreview.thumbUrl = localTheme.collageThumbPath;
-                theme.collagePreview.hdUrl = localTheme.collageHdPath;
-                theme.launcherScreenshot.thumbUrl = localTheme.launcherThumbPath;
-                theme.launcherScreenshot.hdUrl = localTheme.launcherHdPath;
-                theme.waraWaraScreenshot.thumbUrl = localTheme.warawaraThumbPath;
-                theme.waraWaraScreenshot.hdUrl = localTheme.warawaraHdPath;
+                theme->collagePreview.thumbUrl = localTheme.collageThumbPath;
+                theme->collagePreview.hdUrl = localTheme.collageHdPath;
+                details.launcherScreenshot.thumbUrl = localTheme.launcherThumbPath;
+                details.launcherScreenshot.hdUrl = localTheme.launcherHdPath;
+                details.waraWaraScreenshot.thumbUrl = localTheme.warawaraThumbPath;
+                details.waraWaraScreenshot.hdUrl = localTheme.warawaraHdPath;
                 
                 // 如果已经加载了缩略图,直接设置纹理
-                if (localTheme.collageThumbTexture) {
-                    theme.collagePreview.thumbTexture = localTheme.collageThumbTexture;
-                    theme.collagePreview.thumbLoaded = true;
+                if (!localTheme.collageThumbTexture.IsEmpty()) {
+                    theme->collagePreview.thumbTexture = localTheme.collageThumbTexture;
+                    theme->collagePreview.thumbLoaded = true;
                 }
                 
                 // 创建详情屏幕 - 传入 nullptr 作为 ThemeManager (本地模式)
-                ThemeDetailScreen* detailScreen = new ThemeDetailScreen(&theme, nullptr);
-                
-                // 创建输入对象
-                CombinedInput detailBaseInput;
-                VPadInput detailVpadInput;
-                WPADInput detailWpadInputs[4] = {WPAD_CHAN_0, WPAD_CHAN_1, WPAD_CHAN_2, WPAD_CHAN_3};
-                
-                // 进入详情屏幕循环
-                while (true) {
-                    detailBaseInput.reset();
-                    if (detailVpadInput.update(1280, 720)) {
-                        detailBaseInput.combine(detailVpadInput);
-                    }
-                    for (auto &wpadInput : detailWpadInputs) {
-                        if (wpadInput.update(1280, 720)) {
-                            detailBaseInput.combine(wpadInput);
-                        }
-                    }
-                    detailBaseInput.process();
-                    
-                    if (!detailScreen->Update(detailBaseInput)) {
-                        break; // 返回管理列表
-                    }
-                    
-                    detailScreen->Draw();
-                    Gfx::Render();
-                }
-                
-                // 清理详情屏幕
-                delete detailScreen;
-                
-                FileLogger::GetInstance().LogInfo("Returned from local theme detail screen");
+                ScreenStack::Push(std::make_unique<ThemeDetailScreen>(theme.get(), nullptr), [theme]() {
+                    FileLogger::GetInstance().LogInfo("Returned from local theme detail screen");
+                });
                 
                 // 返回后立即跳过当前帧处理
                 return true;
@@ -847,6 +1111,14 @@ bool ManageScreen::Update(Input &input) {
         }
     }
     
+    // 按 Y 切换到选中的主题
+    if (input.data.buttons_d & Input::BUTTON_Y) {
+        if (mSelectedIndex >= 0 && mSelectedIndex < (int)mThemes.size()) {
+            StartSwitchTheme(mThemes[mSelectedIndex]);
+            return true;
+        }
+    }
+    
     // 按 B 返回
     if (input.data.buttons_d & Input::BUTTON_B) {
         return false;
@@ -856,52 +1128,20 @@ bool ManageScreen::Update(Input &input) {
     if (input.data.buttons_d & Input::BUTTON_X) {
         FileLogger::GetInstance().LogInfo("Opening LocalInstallScreen");
         
-        // 创建本地安装屏幕
-        LocalInstallScreen* installScreen = new LocalInstallScreen();
-        
-        // 创建输入对象
-        CombinedInput installBaseInput;
-        VPadInput installVpadInput;
-        WPADInput installWpadInputs[4] = {WPAD_CHAN_0, WPAD_CHAN_1, WPAD_CHAN_2, WPAD_CHAN_3};
-        
-        // 进入本地安装屏幕循环
-        while (true) {
-            installBaseInput.reset();
-            if (installVpadInput.update(1280, 720)) {
-                installBaseInput.combine(installVpadInput);
-            }
-            for (auto &wpadInput : installWpadInputs) {
-                if (wpadInput.update(1280, 720)) {
-                    installBaseInput.combine(wpadInput);
-                }
-            }
-            installBaseInput.process();
-            
-            if (!installScreen->Update(installBaseInput)) {
-                break; // 返回管理列表
-            }
+        ScreenStack::Push(std::make_unique<LocalInstallScreen>(), [this]() {
+            FileLogger::GetInstance().LogInfo("Returned from LocalInstallScreen");
             
-            installScreen->Draw();
-            Gfx::Render();
-        }
-        
-        // 清理本地安装屏幕
-        delete installScreen;
-        
-        FileLogger::GetInstance().LogInfo("Returned from LocalInstallScreen");
-        
-        // 清理B键状态,避免立即返回到MenuScreen
-        input.data.buttons_d &= ~Input::BUTTON_B;
-        input.data.buttons_h &= ~Input::BUTTON_B;
-        
-        // 重新扫描主题列表(可能有新安装的主题)
-        mIsLoading = true;
-        mThemes.clear();
-        std::thread([this]() {
-            ScanLocalThemes();
-            InitAnimations();
-            mIsLoading = false;
-        }).detach();
+            // 重新扫描主题列表(可能有新安装的主题)
+            mIsLoading = true;
+            mScanJob.Wait();
+            mImageOwner.Cancel();  // 回调按索引访问旧的列表
+            mThemes.clear();
+            mScanJob = JobSystem::Submit([this](const CancelToken&) {
+                ScanLocalThemes();
+                InitAnimations();
+                mIsLoading = false;
+            });
+        });
         
         return true;
     }
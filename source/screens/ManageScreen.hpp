@@ -1,7 +1,13 @@
 #pragma once
 #include "Screen.hpp"
 #include "../utils/Animation.hpp"
+#include "../utils/ListItemAnimator.hpp"
 #include "../utils/ThemeManager.hpp"
+#include "../utils/JobSystem.hpp"
+#include "../utils/ImageLoader.hpp"
+#include "../utils/CardTextureCache.hpp"
+#include "../utils/HitGrid.hpp"
+#include "../utils/ScrollController.hpp"
 #include <string>
 #include <vector>
 #include <thread>
@@ -28,12 +34,22 @@ struct LocalTheme {
     std::string warawaraHdPath;
     
     // 图片纹理（异步加载）
-    SDL_Texture* collageThumbTexture = nullptr;
+    ImageLoader::TextureHandle collageThumbTexture;
     bool collageThumbLoaded = false;  // 标记是否已请求加载
     int collageThumbRetryCount = 0;   // 加载重试计数（最多3次）
     
     bool hasPatched;
+    bool isCurrent = false;           // 当前启用的主题
+    bool marked = false;              // 多选中已勾选 (批量卸载)
+    bool hasUpdate = false;           // 主题目录中有更新的版本 (同步后由登记表标记)
+    bool damaged = false;             // 上一次校验发现输出缺少或损坏 (需要重新应用)
     int bpsCount;
+    
+    // 卡片显示的文字 (扫描时生成, 按显示宽度截断)
+    std::string displayName;
+    std::string displayAuthor;
+    std::string downloadsText;
+    std::string likesText;
 };
 
 class ManageScreen : public Screen {
@@ -43,9 +59,15 @@ public:
 
     void Draw() override;
     bool Update(Input &input) override;
+
+    // 详情页或本地安装打开时内存不足: 丢弃卡片纹理 (缩略图由 ImageLoader 自己淘汰)
+    size_t ReleaseHiddenResources() override { return mCardCache.Clear(); }
     
     // 静态标志: 是否因为空状态而返回（用于提示用户去下载）
     static bool sReturnedDueToEmpty;
+    
+    // 菜单上停留在"管理主题"时调用: 在后台读入已安装主题的登记表
+    static void WarmUp();
 
 private:
     int mFrameCount = 0;
@@ -56,20 +78,46 @@ private:
     std::vector<LocalTheme> mThemes;
     int mSelectedIndex = 0;
     int mPreviousSelectedIndex = 0;
-    int mScrollOffset = 0;
+    int mScrollOffset = 0;          // 停下时最上面的行 (滑行中是预测的停止位置), 卡片按 mScroll 的小数位置绘制
+    int mWarmUpScrollOffset = -1;   // 上次预先加载缩略图时的 mScrollOffset
     bool mIsLoading = true;
+    JobHandle mScanJob;      // 后台扫描本地主题, 析构时等待它结束
+    uint32_t mUpdatesVersion = 0;   // 读取更新标记时登记表的 GetUpdatesVersion
+    ImageLoader::Owner mImageOwner; // 缩略图请求的回调引用了 this
+    
+    // 切换主题 (后台线程, 输出已是最新时不打补丁)
+    std::thread mSwitchThread;
+    std::atomic<bool> mSwitching{false};
+    std::atomic<float> mSwitchProgress{0.0f};
+    std::atomic<int> mSwitchResult{0};  // 0: 无 1: 成功 -1: 失败, 显示一段时间后清零
+    int mSwitchResultFrames = 0;
+    std::string mSwitchThemePath;
+    
+    // 校验已安装主题的输出 (后台线程): 没有勾选时 + 开始
+    std::thread mVerifyThread;
+    std::atomic<bool> mVerifying{false};
+    std::atomic<float> mVerifyProgress{0.0f};
+    int mVerifyChecked = 0;             // 线程结束后由主线程填写
+    int mVerifyDamaged = 0;
+    std::vector<std::string> mVerifyDamagedPaths;
+    int mVerifyResultFrames = -1;       // >= 0 时显示结果
+    
+    // 多选和批量卸载: 有勾选的主题时 A 勾选、+ 卸载、B 取消全部勾选
+    int mMarkedCount = 0;
+    bool mConfirmUninstall = false;     // 显示批量卸载的确认框
+    int mUninstalledCount = 0;          // 上一次卸载的主题数, 显示一段时间后清零
+    int mUninstallResultFrames = 0;
     
-    // 长按连续选择
-    int mHoldFrames = 0;
-    int mRepeatDelay = 30;  // 初始延迟帧数 (约0.5秒)
-    int mRepeatRate = 6;    // 重复间隔帧数 (约0.1秒)
+    // 长按连续选择和触摸滚动
+    KeyRepeat mKeyRepeat;
+    ScrollController mScroll{(float)(CARD_HEIGHT + CARD_SPACING)};
+    int mTouchDownX = 0;    // 按下的位置, 松开时是点击则按它选中卡片
+    int mTouchDownY = 0;
     
-    // 动画系统 - 每个主题卡片的动画
-    struct ThemeAnimation {
-        Animation scaleAnim;
-        Animation highlightAnim;
-    };
-    std::vector<ThemeAnimation> mThemeAnims;
+    // 主题卡片的选中动画 (只保留可见卡片的状态)
+    ListItemAnimator mThemeAnims;
+    CardTextureCache mCardCache;   // 卡片内容的纹理
+    HitGrid mCardHits;             // 上一次绘制的卡片区域 (触摸命中)
     
     // 横向卡片列表布局 - 和 DownloadScreen 一样
     static constexpr int LIST_X = 100;
@@ -78,11 +126,25 @@ private:
     static constexpr int CARD_HEIGHT = 200;
     static constexpr int CARD_SPACING = 20;
     static constexpr int VISIBLE_COUNT = 3;
+    static constexpr size_t CARD_NAME_COLUMNS = 45;    // 名称和作者的最大显示宽度 (中日文字符算 2 列)
+    static constexpr size_t CARD_AUTHOR_COLUMNS = 35;
     
     void ScanLocalThemes();
-    void LoadThemeMetadata(LocalTheme& theme);
+    // 同步后登记表的更新标记改变时调用, 只更新 hasUpdate
+    void RefreshUpdateFlags();
+    void StartSwitchTheme(LocalTheme& theme);
+    void DrawSwitchStatus();
+    void StartVerify();
+    void DrawVerifyStatus();
+    void ToggleMarked(int index);
+    void ClearMarks();
+    void UninstallMarkedThemes();
+    void DrawUninstallStatus();
     void InitAnimations();
     void UpdateAnimations();
     void DrawThemeList();
     void DrawThemeCard(LocalTheme& theme, int x, int y, int w, int h, bool selected, int themeIndex);
+    void DrawThemeCardContent(LocalTheme& theme, int x, int y, int w, int h, bool selected, int themeIndex);
+    // 异步读入缩略图; 绘制卡片时和滑行停下的位置改变时 (预先加载最终会停在屏幕上的卡片) 调用
+    void RequestThumbnail(int themeIndex, bool highPriority);
 };
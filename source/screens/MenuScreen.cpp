@@ -9,6 +9,7 @@
 #include "utils/logger.h"
 #include "utils/FileLogger.hpp"
 #include "utils/LanguageManager.hpp"
+#include "utils/ThemeManager.hpp"
 #include <coreinit/time.h>
 
 MenuScreen::MenuScreen()
@@ -35,6 +36,11 @@ MenuScreen::MenuScreen()
 MenuScreen::~MenuScreen() = default;
 
 void MenuScreen::RefreshMenuTexts() {
+    if (mTextsLanguage == Lang().GetCurrentLanguage()) {
+        return;
+    }
+    mTextsLanguage = Lang().GetCurrentLanguage();
+    
     mEntries[MENU_ID_DOWNLOAD_THEMES].name = _("menu.download_themes");
     mEntries[MENU_ID_DOWNLOAD_THEMES].description = _("menu.download_themes_desc");
     
@@ -51,6 +57,19 @@ void MenuScreen::RefreshMenuTexts() {
     mEntries[MENU_ID_ABOUT].description = _("menu.about_desc");
 }
 
+void MenuScreen::WarmUpEntry(MenuID id) {
+    switch (id) {
+        case MENU_ID_DOWNLOAD_THEMES:
+            DownloadScreen::WarmUp();
+            break;
+        case MENU_ID_MANAGE_THEMES:
+            ManageScreen::WarmUp();
+            break;
+        default:
+            break;
+    }
+}
+
 void MenuScreen::UpdateAnimations() {
     mSelectorAnimation.Update();
     mTitleAnimation.Update();
@@ -126,8 +145,12 @@ void MenuScreen::Draw() {
         // Simple fade transition for now
         // Old screen fades out, new screen fades in
         if (progress < 0.5f) {
-            // First half: fade out old screen (menu)
-            DrawMenuContent();
+            // First half: fade out old screen (menu), from the snapshot taken when the transition started
+            if (SDL_Texture* snapshot = mTransition.GetOldSnapshot()) {
+                Gfx::DrawTexture(snapshot, nullptr, SDL_Rect{0, 0, Gfx::SCREEN_WIDTH, Gfx::SCREEN_HEIGHT});
+            } else {
+                DrawMenuContent();
+            }
             // Draw dark overlay with increasing alpha
             SDL_Color overlay = {0, 0, 0, (Uint8)(progress * 2.0f * 200)};
             Gfx::DrawRectFilled(0, 0, Gfx::SCREEN_WIDTH, Gfx::SCREEN_HEIGHT, overlay);
@@ -194,6 +217,17 @@ void MenuScreen::DrawMenuContent() {
     }
 }
 
+bool MenuScreen::IsIdle() const {
+    if (mTransition.IsActive()) {
+        return false;
+    }
+    if (mSubscreen) {
+        return mSubscreen->IsIdle();
+    }
+    // 调试信息显示触摸状态
+    return !mShowDebug && !mJustReturnedFromSubscreen;
+}
+
 bool MenuScreen::Update(Input &input) {
     // 处理子页面
     if (mSubscreen) {
@@ -206,6 +240,9 @@ bool MenuScreen::Update(Input &input) {
             // 设置返回冷却,防止立即重新进入子页面
             mJustReturnedFromSubscreen = true;
             mReturnCooldownFrames = 10; // 10帧冷却时间(约1/6秒)
+            // 子页面可能改写了缓存或登记表, 重新计时预热
+            mWarmUpFrames = 0;
+            mWarmedUp = false;
             
             // 检查是否从空的 ManageScreen 返回
             if (ManageScreen::sReturnedDueToEmpty) {
@@ -230,6 +267,7 @@ bool MenuScreen::Update(Input &input) {
                 mPrevSelectedEntry = prevEntry;
                 mCurrentSelectorY = 170 + (int)mSelectedEntry * 160;
                 mSelectorAnimation.SetTarget(mCurrentSelectorY, 400);
+                ThemeManager::PrewarmConnections();
                 
                 // 重置标志
                 ManageScreen::sReturnedDueToEmpty = false;
@@ -407,6 +445,19 @@ bool MenuScreen::Update(Input &input) {
         // 取消之前选中项的动画
         mEntries[mPrevSelectedEntry].scaleAnim.SetTarget(1.0f, 400);
         mEntries[mPrevSelectedEntry].glowAnim.SetTarget(0.0f, 400);
+        
+        // 很可能马上进入下载界面, 先建立连接
+        if (mSelectedEntry == MENU_ID_DOWNLOAD_THEMES) {
+            ThemeManager::PrewarmConnections();
+        }
+    }
+
+    if (selectionChanged) {
+        mWarmUpFrames = 0;
+        mWarmedUp = false;
+    } else if (!mWarmedUp && ++mWarmUpFrames >= WARMUP_DELAY_FRAMES) {
+        WarmUpEntry(mSelectedEntry);
+        mWarmedUp = true;
     }
 
     if (input.data.buttons_d & Input::BUTTON_A) {
@@ -432,7 +483,9 @@ bool MenuScreen::Update(Input &input) {
         
         if (newScreen) {
             // Start transition animation
-            mTransition.Start(ScreenTransition::SLIDE_LEFT, this, newScreen.get());
+            // 菜单在切换期间不再变化, 只画一次
+            SDL_Texture* snapshot = Gfx::CaptureScreen([this]() { DrawMenuContent(); });
+            mTransition.Start(ScreenTransition::SLIDE_LEFT, this, newScreen.get(), snapshot);
             mSubscreen = std::move(newScreen);
         }
     }
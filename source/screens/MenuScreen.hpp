@@ -18,6 +18,11 @@ public:
 
     bool Update(Input &input) override;
 
+    bool IsIdle() const override;
+
+    // 打开的子界面 (下载、管理) 被盖住
+    size_t ReleaseHiddenResources() override { return mSubscreen ? mSubscreen->ReleaseHiddenResources() : 0; }
+
 private:
     std::unique_ptr<Screen> mSubscreen;
     ScreenTransition mTransition;
@@ -73,8 +78,15 @@ private:
     int mRepeatDelay = 30;  // 初始延迟帧数 (约0.5秒)
     int mRepeatRate = 8;    // 重复间隔帧数
     
+    // 在同一项上停留一段时间后预热它的界面 (读缓存、登记表), 进入时内容立即显示
+    static constexpr int WARMUP_DELAY_FRAMES = 20;  // 约 0.33 秒, 快速滚动经过的项不预热
+    int mWarmUpFrames = 0;
+    bool mWarmedUp = false;
+    
     void DrawCard(int x, int y, int w, int h, MenuEntry &entry, bool selected);
     void UpdateAnimations();
     void DrawMenuContent();
-    void RefreshMenuTexts();  // 刷新菜单文本
+    void RefreshMenuTexts();  // 刷新菜单文本 (语言改变时)
+    std::string mTextsLanguage;  // 菜单文本对应的语言
+    void WarmUpEntry(MenuID id);
 };
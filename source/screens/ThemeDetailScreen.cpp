@@ -2,88 +2,22 @@
 #include "Gfx.hpp"
 #include "../utils/LanguageManager.hpp"
 #include "../utils/ImageLoader.hpp"
-#include "../utils/ThemeDownloader.hpp"
 #include "../utils/ThemePatcher.hpp"
+#include "../utils/ThemeRegistry.hpp"
 #include "../utils/Utils.hpp"
 #include "../utils/logger.h"
 #include "../utils/FileLogger.hpp"
+#include "../utils/FrameArena.hpp"
+#include "../utils/TrashBin.hpp"
 #include <algorithm>
 #include <sstream>
-#include <thread>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <coreinit/cache.h>  // Wii U 缓存刷新
 
-// 递归删除目录的辅助函数
-static bool RemoveDirectory(const std::string& path) {
-    FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Opening directory: %s", path.c_str());
-    DIR* dir = opendir(path.c_str());
-    if (!dir) {
-        FileLogger::GetInstance().LogError("[REMOVE_DIR] Failed to open directory: %s (errno=%d)", path.c_str(), errno);
-        return false;
-    }
-    
-    FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Directory opened, starting enumeration");
-    struct dirent* entry;
-    bool success = true;
-    int fileCount = 0;
-    
-    while ((entry = readdir(dir)) != nullptr) {
-        // 跳过 . 和 ..
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        
-        std::string entryPath = path + "/" + entry->d_name;
-        fileCount++;
-        
-        FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Processing entry %d: %s", fileCount, entry->d_name);
-        
-        // 使用 stat 来判断文件类型 (d_type 在某些文件系统上不可靠)
-        struct stat st;
-        if (stat(entryPath.c_str(), &st) != 0) {
-            FileLogger::GetInstance().LogError("[REMOVE_DIR] Failed to stat: %s (errno=%d)", entryPath.c_str(), errno);
-            success = false;
-            continue;
-        }
-        
-        if (S_ISDIR(st.st_mode)) {
-            // 递归删除子目录
-            FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Recursing into subdirectory: %s", entryPath.c_str());
-            if (!RemoveDirectory(entryPath)) {
-                FileLogger::GetInstance().LogError("[REMOVE_DIR] Failed to remove subdirectory: %s", entryPath.c_str());
-                success = false;
-            }
-        } else {
-            // 删除文件
-            FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Deleting file: %s", entryPath.c_str());
-            if (unlink(entryPath.c_str()) != 0) {
-                FileLogger::GetInstance().LogError("[REMOVE_DIR] Failed to delete file: %s (errno=%d)", entryPath.c_str(), errno);
-                success = false;
-            } else {
-                FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Successfully deleted file: %s", entryPath.c_str());
-            }
-        }
-    }
-    
-    FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Finished enumeration, processed %d entries", fileCount);
-    closedir(dir);
-    FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Directory closed");
-    
-    // 删除目录本身
-    FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Attempting to remove directory: %s", path.c_str());
-    if (rmdir(path.c_str()) != 0) {
-        FileLogger::GetInstance().LogError("[REMOVE_DIR] Failed to delete directory: %s (errno=%d)", path.c_str(), errno);
-        return false;
-    }
-    
-    FileLogger::GetInstance().LogInfo("[REMOVE_DIR] Successfully deleted directory: %s", path.c_str());
-    return success;
-}
-
 ThemeDetailScreen::ThemeDetailScreen(const Theme* theme, ThemeManager* themeManager)
-    : mTheme(theme), mThemeManager(themeManager) {
+    : mTheme(theme), mThemeManager(themeManager), mThemeId(theme->id) {
     mTitleAnim.Start(0, 1, 500);
     mContentAnim.Start(0, 1, 600);
     mButtonHoverAnim.SetImmediate(0.0f);
@@ -102,12 +36,9 @@ ThemeDetailScreen::ThemeDetailScreen(const Theme* theme, ThemeManager* themeMana
         mIsLocalMode = true;
         FileLogger::GetInstance().LogInfo("Theme '%s' is local (from ManageScreen)", theme->name.c_str());
     } else if (!theme->id.empty()) {
-        // 检查 installed 目录中是否存在该主题的 .json 文件
-        std::string installedJsonPath = "fs:/vol/external01/UTheme/installed/" + theme->id + ".json";
-        struct stat st;
-        mIsLocalMode = (stat(installedJsonPath.c_str(), &st) == 0);
-        FileLogger::GetInstance().LogInfo("Theme '%s' local mode: %d (json: %s)", 
-            theme->name.c_str(), mIsLocalMode, installedJsonPath.c_str());
+        // 已安装主题的登记表中是否有该主题的安装记录
+        mIsLocalMode = ThemeRegistry::GetInstance().IsInstalled(theme->id);
+        FileLogger::GetInstance().LogInfo("Theme '%s' local mode: %d", theme->name.c_str(), mIsLocalMode);
     }
     
     // 查找主题索引
@@ -126,136 +57,138 @@ ThemeDetailScreen::ThemeDetailScreen(const Theme* theme, ThemeManager* themeMana
         themeManager ? "Network" : "Local", mIsLocalMode, themeIndex);
     FileLogger::GetInstance().LogInfo("Theme URLs - Collage HD: %s, Launcher HD: %s, WaraWara HD: %s", 
         theme->collagePreview.hdUrl.c_str(),
-        theme->launcherScreenshot.hdUrl.c_str(),
-        theme->waraWaraScreenshot.hdUrl.c_str());
-    
-    // 异步加载高清预览图
-    // 网络模式: 更新 ThemeManager 中的主题数据
-    if (themeIndex >= 0 && themeManager) {
-        auto& themes = themeManager->GetThemes();
-        
-        // 加载 collagePreview 高清图
-        if (!theme->collagePreview.hdUrl.empty() && !theme->collagePreview.hdLoaded) {
-            themes[themeIndex].collagePreview.hdLoaded = true;
-            ImageLoader::LoadRequest request;
-            request.url = theme->collagePreview.hdUrl;
-            request.highPriority = true;
-            request.callback = [themeManager, themeIndex](SDL_Texture* texture) {
-                if (themeManager) {
-                    auto& themes = themeManager->GetThemes();
-                    if (themeIndex >= 0 && themeIndex < (int)themes.size()) {
-                        themes[themeIndex].collagePreview.hdTexture = texture;
-                        FileLogger::GetInstance().LogInfo("Loaded HD collagePreview for theme %d: %p", themeIndex, texture);
-                    }
-                }
-            };
-            ImageLoader::LoadAsync(request);
+        theme->GetDetails().launcherScreenshot.hdUrl.c_str(),
+        theme->GetDetails().waraWaraScreenshot.hdUrl.c_str());
+    
+    // 打开期间固定所有预览图 (纹理句柄在淘汰后自动失效, 不需要检查)
+    for (const ThemeImage* image : {&theme->collagePreview, &theme->GetDetails().launcherScreenshot, &theme->GetDetails().waraWaraScreenshot}) {
+        if (!image->thumbUrl.empty()) {
+            ImageLoader::PinTexture(image->thumbUrl);
+            mPinnedUrls.push_back(image->thumbUrl);
         }
-        
-        // 加载 launcherScreenshot 高清图
-        if (!theme->launcherScreenshot.hdUrl.empty() && !theme->launcherScreenshot.hdLoaded) {
-            themes[themeIndex].launcherScreenshot.hdLoaded = true;
-            ImageLoader::LoadRequest request;
-            request.url = theme->launcherScreenshot.hdUrl;
-            request.highPriority = true;
-            request.callback = [themeManager, themeIndex](SDL_Texture* texture) {
-                if (themeManager) {
-                    auto& themes = themeManager->GetThemes();
-                    if (themeIndex >= 0 && themeIndex < (int)themes.size()) {
-                        themes[themeIndex].launcherScreenshot.hdTexture = texture;
-                        FileLogger::GetInstance().LogInfo("Loaded HD launcherScreenshot for theme %d: %p", themeIndex, texture);
-                    }
-                }
-            };
-            ImageLoader::LoadAsync(request);
-        }
-        
-        // 加载 waraWaraScreenshot 高清图
-        if (!theme->waraWaraScreenshot.hdUrl.empty() && !theme->waraWaraScreenshot.hdLoaded) {
-            themes[themeIndex].waraWaraScreenshot.hdLoaded = true;
-            ImageLoader::LoadRequest request;
-            request.url = theme->waraWaraScreenshot.hdUrl;
-            request.highPriority = true;
-            request.callback = [themeManager, themeIndex](SDL_Texture* texture) {
-                if (themeManager) {
-                    auto& themes = themeManager->GetThemes();
-                    if (themeIndex >= 0 && themeIndex < (int)themes.size()) {
-                        themes[themeIndex].waraWaraScreenshot.hdTexture = texture;
-                        FileLogger::GetInstance().LogInfo("Loaded HD waraWaraScreenshot for theme %d: %p", themeIndex, texture);
-                    }
-                }
-            };
-            ImageLoader::LoadAsync(request);
+        if (!image->hdUrl.empty()) {
+            ImageLoader::PinTexture(image->hdUrl);
+            mPinnedUrls.push_back(image->hdUrl);
         }
     }
-    // 本地模式: 直接加载本地文件
-    else if (!themeManager) {
-        FileLogger::GetInstance().LogInfo("Local mode: Loading local images directly");
-        
-        // 加载 collagePreview 高清图
-        if (!theme->collagePreview.hdUrl.empty()) {
-            ImageLoader::LoadRequest request;
-            request.url = theme->collagePreview.hdUrl;
-            request.highPriority = true;
-            request.callback = [this](SDL_Texture* texture) {
-                if (mTheme) {
-                    const_cast<Theme*>(mTheme)->collagePreview.hdTexture = texture;
-                    const_cast<Theme*>(mTheme)->collagePreview.hdLoaded = true;
-                    FileLogger::GetInstance().LogInfo("Loaded local HD collagePreview: %p", texture);
-                }
-            };
-            ImageLoader::LoadAsync(request);
-        }
-        
-        // 加载 launcherScreenshot 高清图
-        if (!theme->launcherScreenshot.hdUrl.empty()) {
-            ImageLoader::LoadRequest request;
-            request.url = theme->launcherScreenshot.hdUrl;
-            request.highPriority = true;
-            request.callback = [this](SDL_Texture* texture) {
-                if (mTheme) {
-                    const_cast<Theme*>(mTheme)->launcherScreenshot.hdTexture = texture;
-                    const_cast<Theme*>(mTheme)->launcherScreenshot.hdLoaded = true;
-                    FileLogger::GetInstance().LogInfo("Loaded local HD launcherScreenshot: %p", texture);
-                }
-            };
-            ImageLoader::LoadAsync(request);
+    
+    // 网络模式: 更新 ThemeManager 中的主题数据; 本地模式: 直接加载本地文件
+    if (themeIndex >= 0 && themeManager) {
+        mThemeIndex = themeIndex;
+        if (!theme->detailsLoaded) {
+            // 列表只包含卡片字段, 截图和高清图的地址在详情到达后才有 (见 Update)
+            mWaitingForDetails = true;
+            themeManager->FetchThemeDetails(theme->id);
         }
-        
-        // 加载 waraWaraScreenshot 高清图
-        if (!theme->waraWaraScreenshot.hdUrl.empty()) {
-            ImageLoader::LoadRequest request;
-            request.url = theme->waraWaraScreenshot.hdUrl;
-            request.highPriority = true;
-            request.callback = [this](SDL_Texture* texture) {
-                if (mTheme) {
-                    const_cast<Theme*>(mTheme)->waraWaraScreenshot.hdTexture = texture;
-                    const_cast<Theme*>(mTheme)->waraWaraScreenshot.hdLoaded = true;
-                    FileLogger::GetInstance().LogInfo("Loaded local HD waraWaraScreenshot: %p", texture);
-                }
-            };
-            ImageLoader::LoadAsync(request);
+    }
+    // 当前预览图的高清图马上开始加载, 其余的在 Update 中按顺序加载
+    UpdateHdLoads();
+}
+
+static ThemeImage* PreviewImage(Theme& theme, int index) {
+    switch (index) {
+        case 0: return &theme.collagePreview;
+        case 1: return &theme.EditDetails().launcherScreenshot;
+        case 2: return &theme.EditDetails().waraWaraScreenshot;
+        default: return nullptr;
+    }
+}
+
+void ThemeDetailScreen::UpdateHdLoads() {
+    // 网络模式要等详情到达才有高清图的地址
+    if (mThemeManager && (mThemeIndex < 0 || mWaitingForDetails || !mTheme->detailsLoaded)) {
+        return;
+    }
+    auto settled = [this](int index) {
+        const ThemeImage* image = GetPreviewImage(index);
+        return image->hdUrl.empty() || (mHdLoads[index] != HD_NONE && !ImageLoader::IsLoading(image->hdUrl));
+    };
+    
+    const int current = mCurrentPreview;
+    const int next = (current + 1) % 3;
+    const int last = (current + 2) % 3;
+    if (mHdLoads[current] != HD_VISIBLE) {
+        RequestHdImage(current, HD_VISIBLE);
+    }
+    if (mHdLoads[next] == HD_NONE) {
+        RequestHdImage(next, HD_PREFETCH);
+    }
+    // 剩下的一张等前两张完成, 并且没有其它图片在加载
+    if (mHdLoads[last] == HD_NONE && settled(current) && settled(next) && ImageLoader::GetPendingCount() == 0) {
+        RequestHdImage(last, HD_IDLE);
+    }
+}
+
+void ThemeDetailScreen::RequestHdImage(int index, HdLoad stage) {
+    static const char* const NAMES[] = {"collagePreview", "launcherScreenshot", "waraWaraScreenshot"};
+    ThemeImage* image = PreviewImage(*const_cast<Theme*>(mTheme), index);
+    HdLoad previous = mHdLoads[index];
+    mHdLoads[index] = stage;
+    if (image->hdUrl.empty() || image->hdTexture.Get()) {
+        return;
+    }
+    if (previous != HD_NONE) {
+        // 预取的图片切换到了屏幕上: 还没下载完时提高优先级
+        if (stage == HD_VISIBLE && ImageLoader::IsLoading(image->hdUrl)) {
+            ImageLoader::SetPriority(image->hdUrl, DownloadPriority::HIGH);
         }
+        return;
     }
+    
+    ImageLoader::LoadRequest request;
+    request.url = image->hdUrl;
+    request.highPriority = stage == HD_VISIBLE;
+    request.lowPriority = stage != HD_VISIBLE;
+    request.owner = &mImageOwner;
+    std::string url = image->hdUrl;
+    if (mThemeManager) {
+        // 网络模式: hdLoaded 表示已经请求过, 关闭时没有完成的会被清除
+        image->hdLoaded = true;
+        ThemeManager* themeManager = mThemeManager;
+        std::string themeId = mThemeId;
+        request.callback = [themeManager, themeId, index, url](SDL_Texture* texture) {
+            // 按 uuid 查找: 同步可能改变了主题在列表中的位置
+            Theme* target = themeManager->FindTheme(themeId);
+            if (target) {
+                PreviewImage(*target, index)->hdTexture = texture ? ImageLoader::TextureHandle(url)
+                                                                  : ImageLoader::TextureHandle();
+                FileLogger::GetInstance().LogInfo("Loaded HD %s for theme %s: %p", NAMES[index], themeId.c_str(), texture);
+            }
+        };
+        // 高清图边下载边显示, 收到的部分先显示出来
+        request.progressive = true;
+        request.progressCallback = request.callback;
+    } else {
+        request.callback = [this, index, url](SDL_Texture* texture) {
+            ThemeImage* target = PreviewImage(*const_cast<Theme*>(mTheme), index);
+            target->hdTexture = texture ? ImageLoader::TextureHandle(url) : ImageLoader::TextureHandle();
+            target->hdLoaded = true;
+            FileLogger::GetInstance().LogInfo("Loaded local HD %s: %p", NAMES[index], texture);
+        };
+    }
+    ImageLoader::LoadAsync(request);
 }
 
 ThemeDetailScreen::~ThemeDetailScreen() {
     FileLogger::GetInstance().LogInfo("ThemeDetailScreen destructor called");
     
-    // 如果正在下载,取消下载
-    if (mState == STATE_DOWNLOADING) {
-        FileLogger::GetInstance().LogInfo("Cancelling ongoing download...");
-        mThemeManager->CancelDownload();
-    }
+    // 队列中的下载和安装在关闭界面后继续
     
-    // 等待安装线程完成
-    if (mInstallThread.joinable()) {
-        FileLogger::GetInstance().LogInfo("Waiting for install thread to finish...");
-        if (mInstallThreadRunning.load()) {
-            FileLogger::GetInstance().LogInfo("Install thread is still running, waiting...");
+    // 放弃还没完成的高清图; 回调被丢弃的图片清除 hdLoaded, 下次打开时重新请求
+    mImageOwner.Cancel();
+    if (!mIsLocalMode && mThemeManager && !mThemeId.empty()) {
+        if (Theme* theme = mThemeManager->FindTheme(mThemeId)) {
+            ThemeDetails& details = theme->EditDetails();
+            for (ThemeImage* image : {&theme->collagePreview, &details.launcherScreenshot, &details.waraWaraScreenshot}) {
+                if (!image->hdTexture.Get()) {
+                    image->hdLoaded = false;
+                }
+            }
         }
-        mInstallThread.join();
-        FileLogger::GetInstance().LogInfo("Install thread finished");
+    }
+    
+    for (const auto& url : mPinnedUrls) {
+        ImageLoader::UnpinTexture(url);
     }
     
     FileLogger::GetInstance().LogInfo("ThemeDetailScreen destructor completed");
@@ -305,6 +238,81 @@ void ThemeDetailScreen::Draw() {
     // 如果需要调试,应该在详情页单独激活,而不是继承主菜单的状态
 }
 
+bool ThemeDetailScreen::IsPreviewReady() const {
+    if (mWaitingForDetails) {
+        return false;
+    }
+    const ThemeImage* image = GetPreviewImage(mCurrentPreview);
+    if (!image || image->hdUrl.empty()) {
+        return true;
+    }
+    return image->hdLoaded && !ImageLoader::IsLoading(image->hdUrl);
+}
+
+const ThemeImage* ThemeDetailScreen::GetPreviewImage(int index) const {
+    switch (index) {
+        case 0: return &mTheme->collagePreview;
+        case 1: return &mTheme->GetDetails().launcherScreenshot;
+        case 2: return &mTheme->GetDetails().waraWaraScreenshot;
+        default: return nullptr;
+    }
+}
+
+bool ThemeDetailScreen::DrawPreviewImage(int index, const SDL_Rect& area, int offsetX, Uint8 alpha) {
+    const ThemeImage* image = GetPreviewImage(index);
+    if (!image) {
+        return false;
+    }
+    
+    // 缩略图 (列表的缩略图在图集中, 按 URL 取出所在的区域)
+    SDL_Texture* thumb = nullptr;
+    SDL_Rect thumbSrc = {0, 0, 0, 0};
+    if (image->thumbInAtlas) {
+        ImageLoader::AtlasSprite sprite;
+        if (!image->thumbUrl.empty() && ImageLoader::GetAtlasSprite(image->thumbUrl, sprite)) {
+            thumb = sprite.texture;
+            thumbSrc = sprite.rect;
+        }
+    } else if ((thumb = image->thumbTexture.Get()) != nullptr) {
+        SDL_QueryTexture(thumb, nullptr, nullptr, &thumbSrc.w, &thumbSrc.h);
+    }
+    
+    SDL_Texture* hd = image->hdTexture.Get();
+    if (!hd && !thumb) {
+        return false;
+    }
+    
+    // 两层画在同一位置: 放大的缩略图在下, 高清图在上
+    // 渐进加载中的高清图还没解码的行是透明的, 露出下面的缩略图; 加载完成后不再画缩略图
+    int texW = thumbSrc.w;
+    int texH = thumbSrc.h;
+    if (hd) {
+        SDL_QueryTexture(hd, nullptr, nullptr, &texW, &texH);
+    }
+    if (texW <= 0 || texH <= 0) {
+        return false;
+    }
+    
+    // 适应区域（保持比例，不裁剪）
+    float scale = std::min((float)area.w / texW, (float)area.h / texH);
+    int scaledW = (int)(texW * scale);
+    int scaledH = (int)(texH * scale);
+    SDL_Rect dstRect = {area.x + (area.w - scaledW) / 2 + offsetX, area.y + (area.h - scaledH) / 2, scaledW, scaledH};
+    
+    bool hdComplete = hd && !ImageLoader::IsLoading(image->hdUrl);
+    if (thumb && !hdComplete) {
+        SDL_SetTextureAlphaMod(thumb, alpha);
+        Gfx::DrawTexture(thumb, &thumbSrc, dstRect);
+        SDL_SetTextureAlphaMod(thumb, 255);
+    }
+    if (hd) {
+        SDL_SetTextureAlphaMod(hd, alpha);
+        Gfx::DrawTexture(hd, nullptr, dstRect);
+        SDL_SetTextureAlphaMod(hd, 255);
+    }
+    return true;
+}
+
 void ThemeDetailScreen::DrawPreviewSection(int yOffset) {
     // 左侧大图区域 (16:9比例，无背景，图片填满整个区 ?
     const int previewX = 60;
@@ -316,26 +324,6 @@ void ThemeDetailScreen::DrawPreviewSection(int yOffset) {
     SDL_Rect clipRect = {previewX, previewY, previewW, previewH};
     SDL_RenderSetClipRect(Gfx::GetRenderer(), &clipRect);
     
-    // 获取预览图纹理（第一张使用高清图，其他使用缩略图 ?
-    auto getPreviewTexture = [this](int index) -> SDL_Texture* {
-        switch (index) {
-            case 0: 
-                // collagePreview 优先使用高清图，如果没有则使用缩略图
-                return mTheme->collagePreview.hdTexture ? 
-                       mTheme->collagePreview.hdTexture : 
-                       mTheme->collagePreview.thumbTexture;
-            case 1: 
-                return mTheme->launcherScreenshot.hdTexture ? 
-                       mTheme->launcherScreenshot.hdTexture : 
-                       mTheme->launcherScreenshot.thumbTexture;
-            case 2: 
-                return mTheme->waraWaraScreenshot.hdTexture ? 
-                       mTheme->waraWaraScreenshot.hdTexture : 
-                       mTheme->waraWaraScreenshot.thumbTexture;
-            default: return nullptr;
-        }
-    };
-    
     // 滑动动画：绘制当前和前一个预览图
     float slideProgress = mPreviewSlideAnim.GetValue();
     int slideOffset = 0;
@@ -354,81 +342,32 @@ void ThemeDetailScreen::DrawPreviewSection(int yOffset) {
     if (shouldDrawPrevious) {
         // 确定要显示的"前一个"预览图
         int prevIndex = mPreviousPreview;
+        int prevOffset = -slideOffset; // 动画模式
         if (mIsDragging) {
             // 拖动时根据方向决定显示哪一张
             if (mTouchDragOffsetX > 0) {
-                // 向右拖动,显示上一张(左侧)
+                // 向右拖动,显示上一张(左侧),从左边出现
                 prevIndex = (mCurrentPreview + 2) % 3;
+                prevOffset = mTouchDragOffsetX - previewW;
             } else {
-                // 向左拖动,显示下一张(右侧)
+                // 向左拖动,显示下一张(右侧),从右边出现
                 prevIndex = (mCurrentPreview + 1) % 3;
+                prevOffset = mTouchDragOffsetX + previewW;
             }
         }
-        
-        SDL_Texture* prevTexture = getPreviewTexture(prevIndex);
-        if (prevTexture) {
-            int texW, texH;
-            SDL_QueryTexture(prevTexture, nullptr, nullptr, &texW, &texH);
-            
-            // 适应区域（保持比例，不裁剪）
-            float scaleW = (float)previewW / texW;
-            float scaleH = (float)previewH / texH;
-            float scale = std::min(scaleW, scaleH); // 使用min以适应区域
-            int scaledW = (int)(texW * scale);
-            int scaledH = (int)(texH * scale);
-            
-            SDL_Rect dstRect;
-            if (mIsDragging) {
-                // 拖动模式:根据拖动方向决定位置
-                if (mTouchDragOffsetX > 0) {
-                    // 向右拖,前一张从左边出现
-                    dstRect.x = previewX + (previewW - scaledW) / 2 + mTouchDragOffsetX - previewW;
-                } else {
-                    // 向左拖,下一张从右边出现
-                    dstRect.x = previewX + (previewW - scaledW) / 2 + mTouchDragOffsetX + previewW;
-                }
-            } else {
-                // 动画模式
-                dstRect.x = previewX + (previewW - scaledW) / 2 - slideOffset;
-            }
-            dstRect.y = previewY + (previewH - scaledH) / 2;
-            dstRect.w = scaledW;
-            dstRect.h = scaledH;
-            
-            SDL_RenderCopy(Gfx::GetRenderer(), prevTexture, nullptr, &dstRect);
-        }
+        DrawPreviewImage(prevIndex, clipRect, prevOffset, 255);
     }
     
     // 绘制当前预览图（滑入 ?
-    SDL_Texture* currentTexture = getPreviewTexture(mCurrentPreview);
-    if (currentTexture) {
-        int texW, texH;
-        SDL_QueryTexture(currentTexture, nullptr, nullptr, &texW, &texH);
-        
-        // 适应区域（保持比例，不裁剪）
-        float scaleW = (float)previewW / texW;
-        float scaleH = (float)previewH / texH;
-        float scale = std::min(scaleW, scaleH); // 使用min以适应区域
-        int scaledW = (int)(texW * scale);
-        int scaledH = (int)(texH * scale);
-        
-        SDL_Rect dstRect;
-        if (mIsDragging) {
-            // 拖动模式:当前图片跟随手指移动
-            dstRect.x = previewX + (previewW - scaledW) / 2 + mTouchDragOffsetX;
-        } else if (mSlideDirection != 0 && slideProgress < 1.0f) {
-            // 动画模式：从边缘滑入
-            dstRect.x = previewX + (previewW - scaledW) / 2 + previewW * mSlideDirection - slideOffset;
-        } else {
-            // 静止：居中
-            dstRect.x = previewX + (previewW - scaledW) / 2;
-        }
-        dstRect.y = previewY + (previewH - scaledH) / 2;
-        dstRect.w = scaledW;
-        dstRect.h = scaledH;
-        
-        SDL_RenderCopy(Gfx::GetRenderer(), currentTexture, nullptr, &dstRect);
-    } else {
+    int currentOffset = 0; // 静止：居中
+    if (mIsDragging) {
+        // 拖动模式:当前图片跟随手指移动
+        currentOffset = mTouchDragOffsetX;
+    } else if (mSlideDirection != 0 && slideProgress < 1.0f) {
+        // 动画模式：从边缘滑入
+        currentOffset = previewW * mSlideDirection - slideOffset;
+    }
+    if (!DrawPreviewImage(mCurrentPreview, clipRect, currentOffset, 255)) {
         // 加载 ?- 显示在黑色背景上
         SDL_Color loadingBg = {20, 20, 20, 255};
         Gfx::DrawRectFilled(previewX, previewY, previewW, previewH, loadingBg);
@@ -490,20 +429,19 @@ void ThemeDetailScreen::DrawInfoSection(int yOffset) {
     currentY += 65;
     
     // 作者信 ?
-    const std::string byText = _("theme_detail.by");
-    std::string authorText = byText + " " + mTheme->author;
+    std::string_view authorText = FrameArena::Format("%s %s", _("theme_detail.by").c_str(), mTheme->author.c_str());
     Gfx::Print(infoX + titlePadding, currentY, 28, Gfx::COLOR_ALT_TEXT, 
-               authorText.c_str(), Gfx::ALIGN_LEFT);
+               authorText, Gfx::ALIGN_LEFT);
     currentY += 40;
     
     // 更新日期
     if (!mTheme->updatedAt.empty()) {
-        const std::string updatedText = _("theme_detail.updated");
-        std::string updateText = updatedText + " " + mTheme->updatedAt.substr(0, 10); // 只显示日期部 ?YYYY-MM-DD
+        std::string_view updateText = FrameArena::Format("%s %.10s", _("theme_detail.updated").c_str(),
+                                                         mTheme->updatedAt.c_str()); // 只显示日期部 ?YYYY-MM-DD
         Gfx::DrawIcon(infoX + titlePadding, currentY + 4, 24, Gfx::COLOR_ALT_TEXT, 
                       0xf017, Gfx::ALIGN_LEFT); // calendar icon
         Gfx::Print(infoX + titlePadding + 35, currentY + 4, 24, Gfx::COLOR_ALT_TEXT, 
-                   updateText.c_str(), Gfx::ALIGN_LEFT);
+                   updateText, Gfx::ALIGN_LEFT);
         currentY += 40;
     }
     
@@ -518,18 +456,16 @@ void ThemeDetailScreen::DrawInfoSection(int yOffset) {
     // 下载 ?
     Gfx::DrawIcon(infoX + titlePadding, currentY, statIconSize, Gfx::COLOR_WIIU, 
                   0xf019, Gfx::ALIGN_LEFT);
-    const std::string downloadsLabel = _("theme_detail.downloads");
-    std::string downloadsText = std::to_string(mTheme->downloads) + " " + downloadsLabel;
+    std::string_view downloadsText = FrameArena::Format("%d %s", mTheme->downloads, _("theme_detail.downloads").c_str());
     Gfx::Print(infoX + titlePadding + statIconSize + 15, currentY + 8, 28, 
-               Gfx::COLOR_TEXT, downloadsText.c_str(), Gfx::ALIGN_LEFT);
+               Gfx::COLOR_TEXT, downloadsText, Gfx::ALIGN_LEFT);
     
     // 点赞 ?
     Gfx::DrawIcon(infoX + titlePadding + 280, currentY, statIconSize, Gfx::COLOR_ERROR, 
                   0xf004, Gfx::ALIGN_LEFT);
-    const std::string likesLabel = _("theme_detail.likes");
-    std::string likesText = std::to_string(mTheme->likes) + " " + likesLabel;
+    std::string_view likesText = FrameArena::Format("%d %s", mTheme->likes, _("theme_detail.likes").c_str());
     Gfx::Print(infoX + titlePadding + 280 + statIconSize + 15, currentY + 8, 28, 
-               Gfx::COLOR_TEXT, likesText.c_str(), Gfx::ALIGN_LEFT);
+               Gfx::COLOR_TEXT, likesText, Gfx::ALIGN_LEFT);
     
     currentY += statIconSize + 40;
     
@@ -544,69 +480,16 @@ void ThemeDetailScreen::DrawInfoSection(int yOffset) {
                descTitle.c_str(), Gfx::ALIGN_LEFT);
     
     // 描述内容 (多行，改进文本换行以避免重叠)
-    const std::string noDescText = _("theme_detail.no_description");
-    std::string desc = mTheme->description.empty() ? noDescText : mTheme->description;
+    const std::string& description = mTheme->GetDetails().description;
+    const std::string& desc = description.empty() ? _("theme_detail.no_description") : description;
     
-    // 改进的文本换行逻辑
+    // 按实际字宽换行, 描述不变时只排版一次 (获取详情后描述可能更新)
     const int maxLineWidth = infoW - titlePadding * 2 - 40; // 可用宽度（减去左右边距）
     const int fontSize = 24;
-    const int lineHeight = 34; // 增加行高以避免重 ?
-    int descY = currentY + 70;
-    int lineCount = 0;
-    size_t pos = 0;
-    
-    while (pos < desc.length() && lineCount < 6) {
-        // 计算这一行能放多少字 ?
-        std::string testLine;
-        size_t endPos = pos;
-        int lineWidth = 0;
-        
-        // 逐字符添加，直到超出宽度
-        while (endPos < desc.length() && lineWidth < maxLineWidth) {
-            char c = desc[endPos];
-            testLine += c;
-            
-            // 估算字符宽度（ASCII ?0px，其他约20px ?
-            int charWidth = (c >= 32 && c <= 126) ? 10 : 20;
-            lineWidth += charWidth;
-            
-            endPos++;
-            
-            // 如果遇到换行符，强制断行
-            if (c == '\n') {
-                break;
-            }
-        }
-        
-        // 如果不是最后一行，尝试在空格或标点处断 ?
-        if (endPos < desc.length()) {
-            size_t breakPos = testLine.find_last_of(" \t,;.!?-");
-            if (breakPos != std::string::npos && breakPos > testLine.length() / 2) {
-                testLine = testLine.substr(0, breakPos);
-                endPos = pos + breakPos;
-            }
-        }
-        
-        // 移除首尾空白
-        size_t start = testLine.find_first_not_of(" \t\n\r");
-        if (start != std::string::npos) {
-            testLine = testLine.substr(start);
-        }
-        
-        // 绘制这一 ?
-        if (!testLine.empty()) {
-            Gfx::Print(infoX + titlePadding + 20, descY, fontSize, Gfx::COLOR_ALT_TEXT, 
-                       testLine.c_str(), Gfx::ALIGN_LEFT);
-            descY += lineHeight;
-            lineCount++;
-        }
-        
-        pos = endPos;
-        // 跳过空白字符
-        while (pos < desc.length() && (desc[pos] == ' ' || desc[pos] == '\t' || desc[pos] == '\n' || desc[pos] == '\r')) {
-            pos++;
-        }
-    }
+    const int lineHeight = 34; // 增加行高以避免重叠
+    Gfx::LayoutParagraph(mDescriptionLayout, fontSize, desc, maxLineWidth, 6);
+    Gfx::DrawParagraph(infoX + titlePadding + 20, currentY + 70, Gfx::COLOR_ALT_TEXT, mDescriptionLayout, lineHeight,
+                       Gfx::ALIGN_LEFT);
     
     currentY += descH + 40;
     
@@ -623,7 +506,7 @@ void ThemeDetailScreen::DrawInfoSection(int yOffset) {
         const int tagSpacing = 10;
         
         for (const auto& tag : mTheme->tags) {
-            int tagW = tag.length() * 12 + 30;
+            int tagW = Gfx::GetTextWidth(20, tag.str()) + 30;
             
             // 换行检 ?
             if (tagX + tagW > infoX + infoW - titlePadding) {
@@ -662,6 +545,21 @@ void ThemeDetailScreen::DrawInfoSection(int yOffset) {
         const std::string uninstallBtnText = _("theme_detail.uninstall_theme");
         Gfx::Print(infoX + titlePadding + btnW / 2 + 40, btnY + btnH / 2, 36, 
                    Gfx::COLOR_WHITE, uninstallBtnText.c_str(), Gfx::ALIGN_CENTER);
+    } else if (InstallQueue::Status status; InstallQueue::GetInstance().GetStatus(mTheme->id, status) &&
+                                            InstallQueue::IsActive(status.state)) {
+        // 网络模式, 已在队列中: 显示队列中的状态 (灰色)
+        Gfx::DrawRectRounded(infoX + titlePadding, btnY, btnW, btnH, 12, Gfx::COLOR_ALT_BACKGROUND);
+        
+        std::string_view queueText;
+        if (status.state == InstallQueue::JOB_QUEUED || status.state == InstallQueue::JOB_WAITING_INSTALL) {
+            queueText = _("install_queue.waiting");
+        } else {
+            const std::string& stage = status.state == InstallQueue::JOB_INSTALLING ? _("theme_detail.installing")
+                                                                                   : _("theme_detail.downloading");
+            queueText = FrameArena::Format("%s %.0f%%", stage.c_str(), status.progress * 100);
+        }
+        Gfx::Print(infoX + titlePadding + btnW / 2, btnY + btnH / 2, 32, 
+                   Gfx::COLOR_TEXT, queueText, Gfx::ALIGN_CENTER);
     } else {
         // 网络模式: 显示下载按钮 (蓝色)
         SDL_Color btnBg = mDownloadButtonHovered ? Gfx::COLOR_HIGHLIGHTED : Gfx::COLOR_ACCENT;
@@ -752,11 +650,6 @@ void ThemeDetailScreen::DrawDownloadProgress() {
         Gfx::DrawIcon(cardX + cardW / 2, cardY + 160, 80, Gfx::COLOR_SUCCESS, 
                       0xf00c, Gfx::ALIGN_CENTER); // checkmark icon
         
-        // 调试信息：显示线程状态
-        std::string threadStatus = mInstallThreadRunning.load() ? "Thread running" : "Thread finished";
-        Gfx::Print(cardX + cardW / 2, cardY + 220, 24, Gfx::COLOR_ALT_TEXT, 
-                   threadStatus.c_str(), Gfx::ALIGN_CENTER);
-        
         // 提示信息
         Gfx::Print(cardX + cardW / 2, cardY + 250, 28, Gfx::COLOR_ALT_TEXT, 
                    "A/B: " + _("common.back"), Gfx::ALIGN_CENTER);
@@ -808,6 +701,10 @@ void ThemeDetailScreen::DrawDownloadProgress() {
         snprintf(progressText, sizeof(progressText), "%.0f%%", mInstallProgress * 100);
         Gfx::Print(cardX + cardW / 2, cardY + 245, 28, Gfx::COLOR_ALT_TEXT, 
                    progressText, Gfx::ALIGN_CENTER);
+        
+        // 安装在后台继续
+        Gfx::Print(cardX + cardW / 2, cardY + 275, 24, Gfx::COLOR_ALT_TEXT, 
+                   _("install_queue.background_hint"), Gfx::ALIGN_CENTER);
     } else if (mState == STATE_DOWNLOAD_COMPLETE) {
         // 下载完成（保留用于兼容）
         const std::string completeText = _("theme_detail.complete");
@@ -822,11 +719,12 @@ void ThemeDetailScreen::DrawDownloadProgress() {
         Gfx::Print(cardX + cardW / 2, cardY + 250, 28, Gfx::COLOR_ALT_TEXT, 
                    "A/B: " + _("common.back"), Gfx::ALIGN_CENTER);
     } else {
-        // 下载中或解压中
-        int downloadState = mThemeManager->GetDownloadState();
+        // 排队、下载中或解压中
         std::string statusText;
         
-        if (downloadState == DOWNLOAD_EXTRACTING) {
+        if (mQueueState == InstallQueue::JOB_QUEUED || mQueueState == InstallQueue::JOB_WAITING_INSTALL) {
+            statusText = _("install_queue.waiting");
+        } else if (mQueueState == InstallQueue::JOB_EXTRACTING) {
             statusText = _("theme_detail.extracting");
         } else {
             statusText = _("theme_detail.downloading");
@@ -837,7 +735,7 @@ void ThemeDetailScreen::DrawDownloadProgress() {
         
         // 旋转图标（使用 spinner 圆圈图标）
         double angle = (mFrameCount % 60) * 6.0;
-        if (downloadState == DOWNLOAD_DOWNLOADING) {
+        if (mQueueState == InstallQueue::JOB_DOWNLOADING) {
             Gfx::DrawIcon(cardX + cardW / 2, cardY + 120, 60, Gfx::COLOR_ACCENT, 
                           0xf110, Gfx::ALIGN_CENTER, angle); // spinner icon
         } else {
@@ -866,8 +764,9 @@ void ThemeDetailScreen::DrawDownloadProgress() {
                    progressText, Gfx::ALIGN_CENTER);
         
         // 取消提示
-        Gfx::Print(cardX + cardW / 2, cardY + 270, 24, Gfx::COLOR_ALT_TEXT, 
-                   "B: " + _("common.cancel"), Gfx::ALIGN_CENTER);
+        Gfx::Print(cardX + cardW / 2, cardY + 275, 24, Gfx::COLOR_ALT_TEXT, 
+                   FrameArena::Format("B: %s  |  %s", _("common.cancel").c_str(), _("install_queue.background_hint").c_str()),
+                   Gfx::ALIGN_CENTER);
     }
 }
 
@@ -916,12 +815,10 @@ bool ThemeDetailScreen::UninstallTheme() {
         return false;
     }
     
-    FileLogger::GetInstance().LogInfo("[UNINSTALL] About to call RemoveDirectory: %s", themePath.c_str());
+    FileLogger::GetInstance().LogInfo("[UNINSTALL] Removing theme directory: %s", themePath.c_str());
     
-    // 删除主题文件夹
-    bool success = RemoveDirectory(themePath);
-    
-    FileLogger::GetInstance().LogInfo("[UNINSTALL] RemoveDirectory returned: %d", success);
+    // 删除主题文件夹 (移到回收站, 在后台删除)
+    bool success = TrashBin::Remove(themePath);
     
     if (success) {
         FileLogger::GetInstance().LogInfo("[UNINSTALL] Theme uninstalled successfully: %s", mTheme->name.c_str());
@@ -934,6 +831,7 @@ bool ThemeDetailScreen::UninstallTheme() {
             FileLogger::GetInstance().LogWarning("[UNINSTALL] Failed to delete installed JSON (errno=%d): %s", 
                 errno, installedJsonPath.c_str());
         }
+        ThemeRegistry::GetInstance().RemoveTheme(themePath);
     } else {
         FileLogger::GetInstance().LogError("[UNINSTALL] Failed to uninstall theme: %s", mTheme->name.c_str());
     }
@@ -941,6 +839,65 @@ bool ThemeDetailScreen::UninstallTheme() {
     return success;
 }
 
+void ThemeDetailScreen::QueueDownload(bool background) {
+    InstallQueue& queue = InstallQueue::GetInstance();
+    InstallQueue::Status status;
+    bool queued = queue.GetStatus(mTheme->id, status) && InstallQueue::IsActive(status.state);
+    
+    if (!queued) {
+        if (!queue.Enqueue(*mTheme)) {
+            return;
+        }
+        FileLogger::GetInstance().LogInfo("Theme '%s' added to install queue", mTheme->name.c_str());
+        if (background) {
+            Screen::GetBgmNotification().ShowNowPlaying(_("install_queue.queued") + ": " + mTheme->name);
+        }
+    }
+    
+    // 已在队列中时打开它的进度界面
+    if (!background) {
+        mState = STATE_DOWNLOADING;
+        mDownloadStartFrame = mFrameCount;
+        UpdateQueueStatus();
+    }
+}
+
+void ThemeDetailScreen::UpdateQueueStatus() {
+    InstallQueue::Status status;
+    if (!InstallQueue::GetInstance().GetStatus(mTheme->id, status)) {
+        mState = STATE_VIEWING;
+        return;
+    }
+    mQueueState = status.state;
+    
+    switch (status.state) {
+        case InstallQueue::JOB_QUEUED:
+        case InstallQueue::JOB_DOWNLOADING:
+        case InstallQueue::JOB_EXTRACTING:
+        case InstallQueue::JOB_WAITING_INSTALL:
+            mState = STATE_DOWNLOADING;
+            mDownloadProgress = status.state == InstallQueue::JOB_WAITING_INSTALL ? 1.0f : status.progress;
+            break;
+        case InstallQueue::JOB_INSTALLING:
+            mState = STATE_INSTALLING;
+            mInstallProgress = status.progress;
+            break;
+        case InstallQueue::JOB_DONE:
+            mState = STATE_INSTALL_COMPLETE;
+            break;
+        case InstallQueue::JOB_FAILED:
+            // 下载或安装出错, 显示错误信息
+            mInstallError = status.error;
+            mErrorDisplayFrames = 0;
+            mState = STATE_INSTALL_ERROR;
+            break;
+        case InstallQueue::JOB_CANCELLED:
+            mState = STATE_VIEWING;
+            mDownloadProgress = 0.0f;
+            break;
+    }
+}
+
 void ThemeDetailScreen::HandleTouchInput(const Input& input) {
     FileLogger::GetInstance().LogInfo("[HandleTouchInput] Entry - touched:%d valid:%d lastTouched:%d", 
                                       input.data.touched, input.data.validPointer, input.lastData.touched);
@@ -985,11 +942,9 @@ void ThemeDetailScreen::HandleTouchInput(const Input& input) {
             mUninstallRequested = true;
         } else {
             // 网络模式: 下载主题
-            if (mState == STATE_VIEWING) {  // 只在浏览状态才响应
-                mState = STATE_DOWNLOADING;
-                mDownloadStartFrame = mFrameCount;
-                mThemeManager->DownloadTheme(*mTheme); // 启动异步下载
-                FileLogger::GetInstance().LogInfo("Download button touched, starting download");
+            if (mState == STATE_VIEWING && !mWaitingForDetails && !mTheme->GetDetails().downloadUrl.empty()) {  // 只在浏览状态才响应
+                FileLogger::GetInstance().LogInfo("Download button touched, queueing download");
+                QueueDownload(false);
             } else {
                 FileLogger::GetInstance().LogInfo("[HandleTouchInput] Not in VIEWING state, ignoring");
             }
@@ -1071,6 +1026,23 @@ bool ThemeDetailScreen::Update(Input &input) {
     // 保存输入状态用于调试显示
     mLastInput = input;
     
+    // 详情到达后固定并加载截图和高清图
+    if (mWaitingForDetails && !mThemeManager->IsFetchingDetails(mTheme->id)) {
+        mWaitingForDetails = false;
+        if (mTheme->detailsLoaded) {
+            const ThemeDetails& details = mTheme->GetDetails();
+            for (const ThemeImage* image : {&mTheme->collagePreview, &details.launcherScreenshot, &details.waraWaraScreenshot}) {
+                for (const std::string* url : {&image->thumbUrl, &image->hdUrl}) {
+                    if (!url->empty() && std::find(mPinnedUrls.begin(), mPinnedUrls.end(), *url) == mPinnedUrls.end()) {
+                        ImageLoader::PinTexture(*url);
+                        mPinnedUrls.push_back(*url);
+                    }
+                }
+            }
+        }
+    }
+    UpdateHdLoads();
+    
     // 全屏预览模式处理
     if (mState == STATE_FULLSCREEN_PREVIEW) {
         // 按B键或触摸退出全屏预览
@@ -1109,7 +1081,7 @@ bool ThemeDetailScreen::Update(Input &input) {
     
     // 如果正在卸载状态,直接同步执行卸载(不使用线程)
     if (mState == STATE_UNINSTALLING) {
-        if (!mInstallThreadRunning.load()) {
+        if (!InstallQueue::GetInstance().IsInstalling()) {
             FileLogger::GetInstance().LogInfo("[UNINSTALL] Starting synchronous uninstall");
             
             bool success = UninstallTheme();
@@ -1123,13 +1095,16 @@ bool ThemeDetailScreen::Update(Input &input) {
                 FileLogger::GetInstance().LogError("[UNINSTALL] Theme uninstall failed");
             }
         } else {
-            FileLogger::GetInstance().LogWarning("[UNINSTALL] Install thread still running, waiting...");
+            FileLogger::GetInstance().LogWarning("[UNINSTALL] A queued install is running, waiting...");
         }
     }
     
     // 更新图片加载器 - 处理异步图片加载
     ImageLoader::Update();
     
+    // 详情页在下载界面的循环中运行, 主循环不会执行到, 刚安装的主题的预览图在这里开始保存
+    ThemeManager::UpdateImageJobs();
+    
     mTitleAnim.Update();
     mContentAnim.Update();
     mButtonHoverAnim.Update();
@@ -1146,127 +1121,33 @@ bool ThemeDetailScreen::Update(Input &input) {
     }
     
     // 下载和安装状态处理 - 即使在冷却期也要处理
-    // 下载进度更新（检查 ThemeManager 中的下载器状态）
-    if (mState == STATE_DOWNLOADING) {
-        // 从 ThemeManager 获取实际下载进度
-        mDownloadProgress = mThemeManager->GetDownloadProgress();
+    if (mState == STATE_DOWNLOADING || mState == STATE_INSTALLING) {
+        UpdateQueueStatus();
         
-        // 检查下载是否完成或出错
-        auto downloadState = mThemeManager->GetDownloadState();
-        if (downloadState == DOWNLOAD_COMPLETE) {
-            // 下载完成，开始安装
-            mState = STATE_INSTALLING;
-            mInstallProgress = 0.0f;
-            
-            // 异步安装主题
-            std::string themeId = mTheme->id;
-            std::string themeName = mTheme->name;
-            std::string themeAuthor = mTheme->author;
-            
-            // 确保之前的安装线程已经结束
-            if (mInstallThread.joinable()) {
-                mInstallThread.join();
-            }
-            
-            mInstallThreadRunning = true;
-            mInstallThread = std::thread([this, themeId, themeName, themeAuthor]() {
-                FileLogger::GetInstance().LogInfo("[INSTALL THREAD] Thread started");
-                
-                ThemePatcher patcher;
-                
-                // 获取解压后的主题文件夹路径
-                std::string extractedPath = mThemeManager->GetExtractedPath();
-                
-                if (extractedPath.empty()) {
-                    FileLogger::GetInstance().LogError("Extracted folder path is empty");
-                    mInstallError = "Invalid theme path";
-                    mErrorDisplayFrames = 0;
-                    mState = STATE_INSTALL_ERROR;
-                    mInstallThreadRunning = false;
-                    FileLogger::GetInstance().LogInfo("[INSTALL THREAD] Thread exiting (empty path)");
-                    return;
-                }
-                
-                FileLogger::GetInstance().LogInfo("Installing theme from: %s", extractedPath.c_str());
-                
-                // 设置进度回调 - 使用 shared_ptr 或原子变量避免访问已销毁的对象
-                // 注意: 不直接捕获 this,而是只访问原子变量
-                patcher.SetProgressCallback([this](float progress, const std::string& message) {
-                    // 只更新原子变量,不访问其他成员
-                    mInstallProgress = progress;
-                    // 日志输出是安全的
-                    FileLogger::GetInstance().LogInfo("Install progress: %.1f%% - %s", progress * 100, message.c_str());
-                });
-                
-                // 直接安装主题，不需要读取 metadata.json
-                // 主题信息已经从 API 获取了
-                FileLogger::GetInstance().LogInfo("[INSTALL THREAD] Calling InstallTheme");
-                bool success = patcher.InstallTheme(extractedPath, themeId, themeName, themeAuthor);
-                FileLogger::GetInstance().LogInfo("[INSTALL THREAD] InstallTheme returned: %d", success);
-                
-                if (success) {
-                    FileLogger::GetInstance().LogInfo("Theme installed successfully: %s", themeName.c_str());
-                    mState = STATE_INSTALL_COMPLETE;
-                } else {
-                    FileLogger::GetInstance().LogError("Failed to install theme: %s", themeName.c_str());
-                    mInstallError = "Installation failed";
-                    mErrorDisplayFrames = 0;
-                    mState = STATE_INSTALL_ERROR;
-                }
-                
-                // 显式清理 patcher 对象
-                FileLogger::GetInstance().LogInfo("[INSTALL THREAD] Cleaning up patcher");
-                // patcher 会在这里自动析构
-                
-                mInstallThreadRunning = false;
-                FileLogger::GetInstance().LogInfo("[INSTALL THREAD] Thread exiting");
-            });
-            
-        } else if (downloadState == DOWNLOAD_ERROR || downloadState == DOWNLOAD_CANCELLED) {
-            // 下载出错,显示错误信息
-            if (downloadState == DOWNLOAD_ERROR) {
-                mInstallError = "Download failed: " + mThemeManager->GetDownloadError();
-                mErrorDisplayFrames = 0;
-                mState = STATE_INSTALL_ERROR;
-                FileLogger::GetInstance().LogError("Download failed: %s", mInstallError.c_str());
-            } else {
-                // 取消下载,直接返回浏览状态
-                mState = STATE_VIEWING;
-                mDownloadProgress = 0.0f;
-            }
-        }
-        
-        // 下载中允许按B取消
-        if (input.data.buttons_d & Input::BUTTON_B) {
-            mThemeManager->CancelDownload();
+        if (mState == STATE_DOWNLOADING && (input.data.buttons_d & Input::BUTTON_B)) {
+            // 下载中按B取消
+            InstallQueue::GetInstance().Cancel(mTheme->id);
             mState = STATE_VIEWING;
             mDownloadProgress = 0.0f;
             return true;
         }
-        return true;
-    }
-    
-    // 安装中
-    if (mState == STATE_INSTALLING) {
-        // 禁止输入，只显示安装进度
+        if (mState == STATE_INSTALLING && (input.data.buttons_d & Input::BUTTON_B)) {
+            // 安装不能中断: 返回主题列表, 安装在后台继续
+            FileLogger::GetInstance().LogInfo("Leaving detail screen, install continues in background");
+            return false;
+        }
+        if (input.data.buttons_d & Input::BUTTON_Y) {
+            // 关闭进度界面, 队列在后台继续
+            mState = STATE_VIEWING;
+        }
         return true;
     }
     
     // 安装完成
     if (mState == STATE_INSTALL_COMPLETE) {
         if (input.data.buttons_d & (Input::BUTTON_A | Input::BUTTON_B)) {
-            // 只有在线程真正完成时才允许退出
-            if (!mInstallThreadRunning.load()) {
-                // 确保线程已经join
-                if (mInstallThread.joinable()) {
-                    FileLogger::GetInstance().LogInfo("Joining install thread before exit...");
-                    mInstallThread.join();
-                }
-                FileLogger::GetInstance().LogInfo("Install thread completed, returning to theme list");
-                return false; // 返回主题列表
-            } else {
-                FileLogger::GetInstance().LogInfo("Install thread still running, please wait...");
-            }
+            FileLogger::GetInstance().LogInfo("Install complete, returning to theme list");
+            return false; // 返回主题列表
         }
         return true;
     }
@@ -1278,17 +1159,9 @@ bool ThemeDetailScreen::Update(Input &input) {
         // 3秒后自动关闭 (60fps * 3 = 180帧)
         if (mErrorDisplayFrames >= 180 || 
             input.data.buttons_d & (Input::BUTTON_A | Input::BUTTON_B)) {
-            // 只有在线程真正完成时才允许返回浏览
-            if (!mInstallThreadRunning.load()) {
-                // 确保线程已经join
-                if (mInstallThread.joinable()) {
-                    FileLogger::GetInstance().LogInfo("Joining install thread after error...");
-                    mInstallThread.join();
-                }
-                mState = STATE_VIEWING;
-                mInstallError.clear();
-                mErrorDisplayFrames = 0;
-            }
+            mState = STATE_VIEWING;
+            mInstallError.clear();
+            mErrorDisplayFrames = 0;
         }
         return true;
     }
@@ -1427,19 +1300,6 @@ bool ThemeDetailScreen::Update(Input &input) {
         // 但允许按B键退出(紧急退出)
         if (input.data.buttons_d & Input::BUTTON_B) {
             FileLogger::GetInstance().LogInfo("Emergency exit during cooldown period");
-            
-            // 如果正在下载,先取消
-            if (mState == STATE_DOWNLOADING) {
-                mThemeManager->CancelDownload();
-                mState = STATE_VIEWING;
-            }
-            
-            // 如果正在安装,不允许退出
-            if (mState == STATE_INSTALLING || mInstallThreadRunning.load()) {
-                FileLogger::GetInstance().LogInfo("Installation in progress, cannot exit");
-                return true;
-            }
-            
             return false;
         }
         return true;
@@ -1488,15 +1348,23 @@ bool ThemeDetailScreen::Update(Input &input) {
                 mState = STATE_UNINSTALL_CONFIRM;
                 return true;
             } else {
-                // 网络模式: 下载主题
-                mState = STATE_DOWNLOADING;
-                mDownloadStartFrame = mFrameCount;
-                mThemeManager->DownloadTheme(*mTheme); // 启动异步下载
+                // 网络模式: 下载主题 (下载地址在详情中)
+                if (mWaitingForDetails || mTheme->GetDetails().downloadUrl.empty()) {
+                    return true;
+                }
+                QueueDownload(false);
                 return true;
             }
         }
     }
     
+    // Y键: 加入安装队列, 不显示进度界面 (可以继续浏览和加入其它主题)
+    if ((input.data.buttons_d & Input::BUTTON_Y) && mState == STATE_VIEWING && mThemeManager &&
+        !mWaitingForDetails && !mTheme->GetDetails().downloadUrl.empty()) {
+        QueueDownload(true);
+        return true;
+    }
+    
     // B键返回或取消
     if (input.data.buttons_d & Input::BUTTON_B) {
         // 如果在确认对话框中按B,取消
@@ -1510,25 +1378,6 @@ bool ThemeDetailScreen::Update(Input &input) {
             return false;
         }
         
-        // 如果正在下载,先取消
-        if (mState == STATE_DOWNLOADING) {
-            FileLogger::GetInstance().LogInfo("Cancelling download before exit...");
-            mThemeManager->CancelDownload();
-            mState = STATE_VIEWING;
-        }
-        
-        // 如果正在安装,不允许退出
-        if (mState == STATE_INSTALLING) {
-            FileLogger::GetInstance().LogInfo("Installation in progress, cannot exit");
-            return true;
-        }
-        
-        // 如果安装线程还在运行,等待完成
-        if (mInstallThreadRunning.load()) {
-            FileLogger::GetInstance().LogInfo("Install thread still running, waiting...");
-            return true;
-        }
-        
         FileLogger::GetInstance().LogInfo("[UPDATE] B pressed, returning false (exit)");
         return false;
     }
@@ -1541,53 +1390,7 @@ void ThemeDetailScreen::DrawFullscreenPreview() {
     // 纯黑背景
     Gfx::DrawRectFilled(0, 0, Gfx::SCREEN_WIDTH, Gfx::SCREEN_HEIGHT, {0, 0, 0, 255});
     
-    // 辅助函数:根据索引获取预览图纹理
-    auto getPreviewTexture = [this](int index) -> SDL_Texture* {
-        switch (index) {
-            case 0:
-                return mTheme->collagePreview.hdTexture ? 
-                       mTheme->collagePreview.hdTexture : 
-                       mTheme->collagePreview.thumbTexture;
-            case 1:
-                return mTheme->launcherScreenshot.hdTexture ? 
-                       mTheme->launcherScreenshot.hdTexture : 
-                       mTheme->launcherScreenshot.thumbTexture;
-            case 2:
-                return mTheme->waraWaraScreenshot.hdTexture ? 
-                       mTheme->waraWaraScreenshot.hdTexture : 
-                       mTheme->waraWaraScreenshot.thumbTexture;
-            default:
-                return nullptr;
-        }
-    };
-    
-    // 辅助函数:绘制纹理到指定位置(保持比例,居中)
-    auto drawTexture = [](SDL_Texture* texture, int offsetX, int alpha) {
-        if (!texture) return;
-        
-        int texW, texH;
-        SDL_QueryTexture(texture, nullptr, nullptr, &texW, &texH);
-        
-        // 适应整个屏幕(保持比例)
-        float scaleW = (float)Gfx::SCREEN_WIDTH / texW;
-        float scaleH = (float)Gfx::SCREEN_HEIGHT / texH;
-        float scale = std::min(scaleW, scaleH); // 保持比例,不裁剪
-        
-        int scaledW = (int)(texW * scale);
-        int scaledH = (int)(texH * scale);
-        
-        // 居中显示 + 偏移
-        SDL_Rect dstRect;
-        dstRect.x = (Gfx::SCREEN_WIDTH - scaledW) / 2 + offsetX;
-        dstRect.y = (Gfx::SCREEN_HEIGHT - scaledH) / 2;
-        dstRect.w = scaledW;
-        dstRect.h = scaledH;
-        
-        // 设置透明度
-        SDL_SetTextureAlphaMod(texture, alpha);
-        SDL_RenderCopy(Gfx::GetRenderer(), texture, nullptr, &dstRect);
-        SDL_SetTextureAlphaMod(texture, 255); // 恢复
-    };
+    const SDL_Rect screenArea = {0, 0, Gfx::SCREEN_WIDTH, Gfx::SCREEN_HEIGHT};
     
     // 获取动画进度
     float slideProgress = mFullscreenSlideAnim.GetValue();
@@ -1598,19 +1401,16 @@ void ThemeDetailScreen::DrawFullscreenPreview() {
         int slideOffset = (int)(Gfx::SCREEN_WIDTH * slideProgress * mFullscreenSlideDir);
         
         // 绘制上一张图片(滑出)
-        SDL_Texture* prevTexture = getPreviewTexture(mFullscreenPrevPreview);
-        int prevAlpha = (int)(255 * (1.0f - slideProgress)); // 淡出
-        drawTexture(prevTexture, slideOffset, prevAlpha);
+        Uint8 prevAlpha = (Uint8)(255 * (1.0f - slideProgress)); // 淡出
+        DrawPreviewImage(mFullscreenPrevPreview, screenArea, slideOffset, prevAlpha);
         
         // 绘制当前图片(滑入)
-        SDL_Texture* currTexture = getPreviewTexture(mCurrentPreview);
         int currOffset = slideOffset - (Gfx::SCREEN_WIDTH * mFullscreenSlideDir);
-        int currAlpha = (int)(255 * slideProgress); // 淡入
-        drawTexture(currTexture, currOffset, currAlpha);
+        Uint8 currAlpha = (Uint8)(255 * slideProgress); // 淡入
+        DrawPreviewImage(mCurrentPreview, screenArea, currOffset, currAlpha);
     } else {
         // 没有动画,直接绘制当前图片
-        SDL_Texture* texture = getPreviewTexture(mCurrentPreview);
-        drawTexture(texture, 0, 255);
+        DrawPreviewImage(mCurrentPreview, screenArea, 0, 255);
     }
     
     // 底部提示文字(半透明背景)
@@ -1619,7 +1419,7 @@ void ThemeDetailScreen::DrawFullscreenPreview() {
     Gfx::DrawRectFilled(0, Gfx::SCREEN_HEIGHT - tipHeight, Gfx::SCREEN_WIDTH, tipHeight, tipBg);
     
     // 获取当前预览图名称(多语言)
-    const char* previewKeys[] = {
+    static constexpr LanguageManager::TextKey previewKeys[] = {
         "theme_detail.preview_collage",
         "theme_detail.preview_launcher", 
         "theme_detail.preview_wara_wara"
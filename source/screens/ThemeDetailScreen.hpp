@@ -2,10 +2,14 @@
 #include "Screen.hpp"
 #include "../utils/Animation.hpp"
 #include "../utils/ThemeManager.hpp"
+#include "../utils/ImageLoader.hpp"
+#include "../utils/InstallQueue.hpp"
+#include "../Gfx.hpp"
 #include <SDL2/SDL.h>
 #include <memory>
-#include <thread>
 #include <atomic>
+#include <vector>
+#include <string>
 
 class ThemeDetailScreen : public Screen {
 public:
@@ -15,10 +19,28 @@ public:
     void Draw() override;
     bool Update(Input &input) override;
 
+    // 主题详情已获取, 当前预览图的高清图已加载完成 (或失败、没有高清图)
+    bool IsPreviewReady() const;
+
 private:
     const Theme* mTheme;
     ThemeManager* mThemeManager;
     bool mIsLocalMode = false; // 是否为本地模式(已下载的主题)
+    std::vector<std::string> mPinnedUrls; // 打开期间固定在纹理缓存中的预览图
+    ImageLoader::Owner mImageOwner;       // 关闭时放弃还没完成的高清图
+    int mThemeIndex = -1;                 // 在 ThemeManager 列表中的位置 (网络模式)
+    std::string mThemeId;                 // 关闭时按 uuid 查找 (列表可能已经变化)
+    bool mWaitingForDetails = false;      // 正在获取主题详情 (下载地址、截图)
+    
+    // 高清图按显示顺序加载: 当前预览图以高优先级加载, 下一张作为预取,
+    // 剩下的一张等前两张完成且没有其它图片在加载时再加载; 切换到预取中的图片时提高它的优先级
+    enum HdLoad {
+        HD_NONE,      // 还没有请求
+        HD_IDLE,
+        HD_PREFETCH,
+        HD_VISIBLE
+    };
+    HdLoad mHdLoads[3] = {HD_NONE, HD_NONE, HD_NONE};  // 按预览图下标
     
     enum State {
         STATE_VIEWING,
@@ -38,15 +60,13 @@ private:
     int mFrameCount = 0;
     int mEnterFrame = 0; // 进入屏幕的帧数，用于输入冷却
     int mDownloadStartFrame = 0;
-    std::atomic<float> mDownloadProgress{0.0f};
-    std::atomic<float> mInstallProgress{0.0f};
+    // 下载和安装由 InstallQueue 进行, 进度界面只显示队列中这个主题的状态 (关闭界面后继续)
+    InstallQueue::JobState mQueueState = InstallQueue::JOB_QUEUED;
+    float mDownloadProgress = 0.0f;
+    float mInstallProgress = 0.0f;
     std::string mInstallError;
     int mErrorDisplayFrames = 0; // 错误显示帧计数
     
-    // 安装线程管理
-    std::thread mInstallThread;
-    std::atomic<bool> mInstallThreadRunning{false};
-    
     // 动画
     Animation mTitleAnim;
     Animation mContentAnim;
@@ -80,13 +100,24 @@ private:
     // 调试信息 - 保存最后的输入状态用于绘制
     Input mLastInput;
     
+    Gfx::Paragraph mDescriptionLayout; // 描述的换行结果
+    
     // 辅助函数
     void DrawPreviewSection(int yOffset);
     void DrawInfoSection(int yOffset);
     void DrawDownloadProgress();
     void DrawFullscreenPreview(); // 全屏预览绘制
+    const ThemeImage* GetPreviewImage(int index) const;
+    // 在 area 中居中 (保持比例) 绘制预览图, 两层都没有时返回 false
+    bool DrawPreviewImage(int index, const SDL_Rect& area, int offsetX, Uint8 alpha);
+    void UpdateHdLoads();         // 每帧调用: 按当前预览图推进高清图的加载
+    void RequestHdImage(int index, HdLoad stage);
     
     bool IsTouchInRect(int touchX, int touchY, int rectX, int rectY, int rectW, int rectH);
     void HandleTouchInput(const Input& input);
     bool UninstallTheme(); // 卸载主题
+    // 把主题加入安装队列; background 为 false 时显示进度界面
+    void QueueDownload(bool background);
+    // 进度界面: 按队列中的状态切换下载、安装、完成和错误状态
+    void UpdateQueueStatus();
 };
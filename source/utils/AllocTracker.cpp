@@ -0,0 +1,338 @@
+#include "AllocTracker.hpp"
+
+#if UTHEME_ALLOC_TRACKING
+
+#include "FileLogger.hpp"
+#include "MemoryPressure.hpp"
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/memexpheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/mutex.h>
+#include <coreinit/thread.h>
+#include <algorithm>
+#include <cstdio>
+
+// 正在使用的块: 开放寻址的哈希表 (线性探测, 删除时把后面的项前移)
+// 安装之前分配的块不在表中, 释放时忽略; 表太满时新的块不再记录, 只计数
+static constexpr uint32_t TABLE_SIZE = 1 << 17;
+static constexpr uint32_t TABLE_LIMIT = TABLE_SIZE / 4 * 3;
+static constexpr uint32_t MAX_TAGGED_THREADS = 32;
+
+struct Block {
+    void* ptr;
+    uint32_t size;
+    AllocTracker::Tag tag;
+};
+
+struct ThreadTag {
+    OSThread* thread;
+    AllocTracker::Tag tag;
+};
+
+static Block sBlocks[TABLE_SIZE];
+static uint32_t sBlockCount = 0;
+static uint32_t sUntracked = 0;
+static ThreadTag sThreadTags[MAX_TAGGED_THREADS];  // 没有登记的线程为 TAG_OTHER
+
+// 下面的统计都受 sMutex 保护 (分配可能来自任何线程)
+static OSMutex sMutex;
+static bool sInstalled = false;
+static decltype(MEMAllocFromDefaultHeap) sRealAlloc = nullptr;
+static decltype(MEMAllocFromDefaultHeapEx) sRealAllocEx = nullptr;
+static decltype(MEMFreeToDefaultHeap) sRealFree = nullptr;
+
+static size_t sLiveBytes = 0;
+static size_t sPeakBytes = 0;
+static size_t sTagLive[AllocTracker::TAG_COUNT] = {};
+static size_t sTagPeak[AllocTracker::TAG_COUNT] = {};
+static uint32_t sFrameAllocs = 0;                         // 这一帧到目前为止
+static size_t sFrameTagBytes[AllocTracker::TAG_COUNT] = {};
+static uint32_t sFailed = 0;
+static uint32_t sLastFailedSize = 0;
+static AllocTracker::Tag sLastFailedTag = AllocTracker::TAG_OTHER;
+
+// 以下只在主线程访问
+static uint32_t sLastFrameAllocs = 0;
+static size_t sLastFrameBytes = 0;
+static uint32_t sMaxFrameAllocs = 0;   // 上次写日志以来最多的一帧
+static size_t sMaxFrameBytes = 0;
+static size_t sHeapFree = 0;
+static size_t sMinHeapFree = SIZE_MAX;
+static uint32_t sReportedFailed = 0;
+
+static const char* const sTagNames[AllocTracker::TAG_COUNT] = {
+    "other", "ui", "images", "net", "catalog", "patch", "archive", "audio", "backup"
+};
+
+static uint32_t BlockIndex(const void* ptr) {
+    return ((uint32_t)(uintptr_t)ptr >> 4) * 2654435761u & (TABLE_SIZE - 1);
+}
+
+static AllocTracker::Tag CurrentTag() {
+    OSThread* thread = OSGetCurrentThread();
+    for (const ThreadTag& entry : sThreadTags) {
+        if (entry.thread == thread) {
+            return entry.tag;
+        }
+    }
+    return AllocTracker::TAG_OTHER;
+}
+
+static void AddBlock(void* ptr, uint32_t size) {
+    AllocTracker::Tag tag = CurrentTag();
+    sFrameAllocs++;
+    sFrameTagBytes[tag] += size;
+
+    if (sBlockCount >= TABLE_LIMIT) {
+        sUntracked++;
+        return;
+    }
+    uint32_t i = BlockIndex(ptr);
+    while (sBlocks[i].ptr) {
+        i = (i + 1) & (TABLE_SIZE - 1);
+    }
+    sBlocks[i] = {ptr, size, tag};
+    sBlockCount++;
+
+    sLiveBytes += size;
+    sTagLive[tag] += size;
+    sPeakBytes = std::max(sPeakBytes, sLiveBytes);
+    sTagPeak[tag] = std::max(sTagPeak[tag], sTagLive[tag]);
+}
+
+static void RemoveBlock(void* ptr) {
+    uint32_t i = BlockIndex(ptr);
+    while (sBlocks[i].ptr != ptr) {
+        if (!sBlocks[i].ptr) {
+            return;  // 安装之前分配的, 或表满时没有记录的
+        }
+        i = (i + 1) & (TABLE_SIZE - 1);
+    }
+    sLiveBytes -= sBlocks[i].size;
+    sTagLive[sBlocks[i].tag] -= sBlocks[i].size;
+    sBlockCount--;
+
+    // 把后面探测链上的项前移, 填补空位
+    uint32_t hole = i;
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & (TABLE_SIZE - 1);
+        if (!sBlocks[j].ptr) {
+            break;
+        }
+        uint32_t home = BlockIndex(sBlocks[j].ptr);
+        // home 不在 (hole, j] 之间时这一项可以移到 hole
+        bool between = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!between) {
+            sBlocks[hole] = sBlocks[j];
+            hole = j;
+        }
+    }
+    sBlocks[hole].ptr = nullptr;
+}
+
+static void RecordAlloc(void* ptr, uint32_t size) {
+    OSLockMutex(&sMutex);
+    if (ptr) {
+        AddBlock(ptr, size);
+    } else {
+        sFailed++;
+        sLastFailedSize = size;
+        sLastFailedTag = CurrentTag();
+        MemoryPressure::Signal(MemoryPressure::LEVEL_CRITICAL, "heap");
+    }
+    OSUnlockMutex(&sMutex);
+}
+
+static void* AllocHook(uint32_t size) {
+    void* ptr = sRealAlloc(size);
+    RecordAlloc(ptr, size);
+    return ptr;
+}
+
+static void* AllocExHook(uint32_t size, int32_t alignment) {
+    void* ptr = sRealAllocEx(size, alignment);
+    RecordAlloc(ptr, size);
+    return ptr;
+}
+
+static void FreeHook(void* ptr) {
+    if (ptr) {
+        OSLockMutex(&sMutex);
+        RemoveBlock(ptr);
+        OSUnlockMutex(&sMutex);
+    }
+    sRealFree(ptr);
+}
+
+static float ToMB(size_t bytes) {
+    return bytes / (1024.0f * 1024.0f);
+}
+
+void AllocTracker::Install() {
+    if (sInstalled) {
+        return;
+    }
+    OSInitMutex(&sMutex);
+    sRealAlloc = MEMAllocFromDefaultHeap;
+    sRealAllocEx = MEMAllocFromDefaultHeapEx;
+    sRealFree = MEMFreeToDefaultHeap;
+    MEMAllocFromDefaultHeap = AllocHook;
+    MEMAllocFromDefaultHeapEx = AllocExHook;
+    MEMFreeToDefaultHeap = FreeHook;
+    sInstalled = true;
+}
+
+void AllocTracker::Uninstall() {
+    if (!sInstalled) {
+        return;
+    }
+    OSLockMutex(&sMutex);
+    MEMAllocFromDefaultHeap = sRealAlloc;
+    MEMAllocFromDefaultHeapEx = sRealAllocEx;
+    MEMFreeToDefaultHeap = sRealFree;
+    sInstalled = false;
+    OSUnlockMutex(&sMutex);
+}
+
+AllocTracker::Tag AllocTracker::SetThreadTag(Tag tag) {
+    if (!sInstalled) {
+        return TAG_OTHER;
+    }
+    OSThread* thread = OSGetCurrentThread();
+    OSLockMutex(&sMutex);
+    Tag previous = TAG_OTHER;
+    ThreadTag* slot = nullptr;
+    for (ThreadTag& entry : sThreadTags) {
+        if (entry.thread == thread) {
+            previous = entry.tag;
+            slot = &entry;
+            break;
+        }
+        if (!entry.thread && !slot) {
+            slot = &entry;
+        }
+    }
+    // 线程太多时不再登记, 这些线程的分配记在 TAG_OTHER 下
+    if (slot) {
+        slot->thread = tag == TAG_OTHER ? nullptr : thread;
+        slot->tag = tag;
+    }
+    OSUnlockMutex(&sMutex);
+    return previous;
+}
+
+void AllocTracker::EndFrame() {
+    if (!sInstalled) {
+        return;
+    }
+
+    size_t tagBytes[TAG_COUNT];
+    uint32_t allocs;
+    uint32_t failed;
+    uint32_t failedSize;
+    Tag failedTag;
+    OSLockMutex(&sMutex);
+    allocs = sFrameAllocs;
+    sFrameAllocs = 0;
+    for (int t = 0; t < TAG_COUNT; t++) {
+        tagBytes[t] = sFrameTagBytes[t];
+        sFrameTagBytes[t] = 0;
+    }
+    failed = sFailed;
+    failedSize = sLastFailedSize;
+    failedTag = sLastFailedTag;
+    OSUnlockMutex(&sMutex);
+
+    size_t bytes = 0;
+    for (size_t tagged : tagBytes) {
+        bytes += tagged;
+    }
+    sLastFrameAllocs = allocs;
+    sLastFrameBytes = bytes;
+    sMaxFrameAllocs = std::max(sMaxFrameAllocs, allocs);
+    sMaxFrameBytes = std::max(sMaxFrameBytes, bytes);
+
+    sHeapFree = MEMGetTotalFreeSizeForExpHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2));
+    sMinHeapFree = std::min(sMinHeapFree, sHeapFree);
+
+    if (!FileLogger::GetInstance().IsEnabled()) {
+        return;
+    }
+    if (bytes >= SPIKE_BYTES) {
+        char line[256];
+        int len = 0;
+        for (int t = 0; t < TAG_COUNT && len < (int)sizeof(line); t++) {
+            if (tagBytes[t]) {
+                len += snprintf(line + len, sizeof(line) - len, " %s %zuK", sTagNames[t], tagBytes[t] >> 10);
+            }
+        }
+        FileLogger::GetInstance().LogInfo("[Alloc] Frame allocated %zu KB in %u allocations:%s", bytes >> 10, allocs, line);
+    }
+    if (failed != sReportedFailed) {
+        FileLogger::GetInstance().LogWarning("[Alloc] %u allocation(s) failed, last %u bytes (%s), heap free %zu KB",
+                                             failed - sReportedFailed, failedSize, sTagNames[failedTag], sHeapFree >> 10);
+        sReportedFailed = failed;
+    }
+}
+
+size_t AllocTracker::GetLiveBytes() {
+    return sLiveBytes;
+}
+
+size_t AllocTracker::GetPeakBytes() {
+    return sPeakBytes;
+}
+
+uint32_t AllocTracker::GetFrameAllocs() {
+    return sLastFrameAllocs;
+}
+
+size_t AllocTracker::GetFrameBytes() {
+    return sLastFrameBytes;
+}
+
+size_t AllocTracker::GetHeapFreeBytes() {
+    return sHeapFree;
+}
+
+uint32_t AllocTracker::GetFailedCount() {
+    return sFailed;
+}
+
+const char* AllocTracker::GetTagName(Tag tag) {
+    return sTagNames[tag];
+}
+
+void AllocTracker::DumpToLog() {
+    if (!sInstalled) {
+        return;
+    }
+
+    size_t live[TAG_COUNT];
+    size_t peak[TAG_COUNT];
+    uint32_t blocks;
+    uint32_t untracked;
+    OSLockMutex(&sMutex);
+    std::copy(sTagLive, sTagLive + TAG_COUNT, live);
+    std::copy(sTagPeak, sTagPeak + TAG_COUNT, peak);
+    blocks = sBlockCount;
+    untracked = sUntracked;
+    OSUnlockMutex(&sMutex);
+
+    FileLogger::GetInstance().LogInfo("[Alloc] live %.1f MB in %u blocks (peak %.1f MB), heap free %.1f MB (min %.1f MB); max frame %u allocs / %zu KB; %u untracked, %u failed",
+                                      ToMB(sLiveBytes), blocks, ToMB(sPeakBytes), ToMB(sHeapFree), ToMB(sMinHeapFree),
+                                      sMaxFrameAllocs, sMaxFrameBytes >> 10, untracked, sFailed);
+
+    char line[320];
+    int len = 0;
+    for (int t = 0; t < TAG_COUNT && len < (int)sizeof(line); t++) {
+        len += snprintf(line + len, sizeof(line) - len, " %s %zuK/%zuK", sTagNames[t], live[t] >> 10, peak[t] >> 10);
+    }
+    FileLogger::GetInstance().LogInfo("[Alloc] live/peak by tag:%s", line);
+
+    sMaxFrameAllocs = 0;
+    sMaxFrameBytes = 0;
+}
+
+#endif // UTHEME_ALLOC_TRACKING
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 编译时打开: make ALLOC_TRACKING=1 (默认关闭, 关闭时下面的函数都是空的)
+#ifndef UTHEME_ALLOC_TRACKING
+#define UTHEME_ALLOC_TRACKING 0
+#endif
+
+// 堆分配统计: 替换 coreinit 默认堆的分配和释放函数指针 (malloc / new 都经过它们),
+// 按分配时线程的 tag 记录每个子系统占用的字节数和峰值, 以及每帧的分配次数和字节数
+// 性能 HUD 上显示总量, 日志中记录各 tag 的占用、分配很多的帧和分配失败
+// 统计表是固定大小的静态数组, 记录本身不分配内存; 所有分配都要加锁, 只用于测量
+class AllocTracker {
+public:
+    enum Tag : uint8_t {
+        TAG_OTHER,
+        TAG_UI,        // 界面的 Update / Draw
+        TAG_IMAGES,    // 图片解码
+        TAG_NETWORK,   // 网络线程 (curl, 下载缓冲区)
+        TAG_CATALOG,   // 主题目录解析和缓存
+        TAG_PATCH,     // 打补丁
+        TAG_ARCHIVE,   // 解压
+        TAG_AUDIO,     // 音乐读取
+        TAG_BACKUP,    // 备份
+        TAG_COUNT
+    };
+
+    static constexpr size_t SPIKE_BYTES = 1024 * 1024;  // 一帧分配超过这么多时写日志
+
+    // 作用域内当前线程的分配记在 tag 下, 嵌套时内层优先
+    class TagScope {
+    public:
+#if UTHEME_ALLOC_TRACKING
+        explicit TagScope(Tag tag) : mPrevious(AllocTracker::SetThreadTag(tag)) {}
+        ~TagScope() { AllocTracker::SetThreadTag(mPrevious); }
+#else
+        explicit TagScope(Tag) {}
+#endif
+
+        TagScope(const TagScope&) = delete;
+        TagScope& operator=(const TagScope&) = delete;
+
+#if UTHEME_ALLOC_TRACKING
+    private:
+        Tag mPrevious;
+#endif
+    };
+
+#if UTHEME_ALLOC_TRACKING
+    static constexpr bool ENABLED = true;
+
+    // 程序开始时安装, 退出前恢复原来的函数
+    static void Install();
+    static void Uninstall();
+
+    // 设置当前线程的 tag, 返回之前的 tag
+    static Tag SetThreadTag(Tag tag);
+
+    // 每画完一帧调用一次 (Profiler::EndFrame), 结束这一帧的计数
+    static void EndFrame();
+
+    static size_t GetLiveBytes();
+    static size_t GetPeakBytes();
+    static uint32_t GetFrameAllocs();      // 上一帧的分配次数 (所有线程)
+    static size_t GetFrameBytes();
+    static size_t GetHeapFreeBytes();      // 默认堆剩余 (包括没有统计到的分配)
+    static uint32_t GetFailedCount();
+    static const char* GetTagName(Tag tag);
+
+    // 各 tag 的占用和峰值, 统计期间最大的一帧
+    static void DumpToLog();
+#else
+    static constexpr bool ENABLED = false;
+
+    static void Install() {}
+    static void Uninstall() {}
+    static void EndFrame() {}
+    static size_t GetLiveBytes() { return 0; }
+    static size_t GetPeakBytes() { return 0; }
+    static uint32_t GetFrameAllocs() { return 0; }
+    static size_t GetFrameBytes() { return 0; }
+    static size_t GetHeapFreeBytes() { return 0; }
+    static uint32_t GetFailedCount() { return 0; }
+    static void DumpToLog() {}
+#endif
+};
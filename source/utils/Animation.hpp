@@ -3,16 +3,18 @@
 #include <cmath>
 #include <coreinit/time.h>
 
+// 每个动画只保存起止值和开始时间; 当前时间每帧只读取一次 (FrameTimeMs), 不在动画中的对象 Update 只检查一个标志
 class Animation {
 public:
     Animation() : mStartValue(0), mTargetValue(0), mCurrentValue(0), mDuration(0), mStartTime(0), mIsAnimating(false) {}
 
     void Start(float from, float to, float durationMs) {
+        sActivity = true;
         mStartValue = from;
         mTargetValue = to;
         mCurrentValue = from;
         mDuration = durationMs;
-        mStartTime = OSTicksToMilliseconds(OSGetSystemTime());
+        mStartTime = FrameTimeMs();
         mIsAnimating = true;
     }
 
@@ -23,23 +25,24 @@ public:
             mStartValue = mCurrentValue;
             mTargetValue = target;
             mDuration = durationMs;
-            mStartTime = OSTicksToMilliseconds(OSGetSystemTime());
+            mStartTime = FrameTimeMs();
+            sActivity = true;
         }
     }
 
     void Update() {
         if (!mIsAnimating) return;
+        sActivity = true;
 
-        uint64_t currentTime = OSTicksToMilliseconds(OSGetSystemTime());
-        float elapsed = (float)(currentTime - mStartTime);
+        float elapsed = (float)(FrameTimeMs() - mStartTime);
 
         if (elapsed >= mDuration) {
             mCurrentValue = mTargetValue;
             mIsAnimating = false;
         } else {
-            float progress = elapsed / mDuration;
             // Ease out cubic
-            progress = 1 - pow(1 - progress, 3);
+            float inv = 1.0f - elapsed / mDuration;
+            float progress = 1.0f - inv * inv * inv;
             mCurrentValue = mStartValue + (mTargetValue - mStartValue) * progress;
         }
     }
@@ -48,12 +51,43 @@ public:
     bool IsAnimating() const { return mIsAnimating; }
     float GetTarget() const { return mTargetValue; }
     void SetImmediate(float value) {
+        sActivity = true;
         mCurrentValue = value;
         mTargetValue = value;
         mIsAnimating = false;
     }
 
+    // 自上次调用以来是否有动画开始、被设置或正在进行 (主循环据此判断画面是否可能变化)
+    static bool ConsumeActivity() {
+        bool activity = sActivity;
+        sActivity = false;
+        return activity;
+    }
+
+    // 不经过 Animation 的连续变化 (例如惯性滚动) 也要让主循环继续绘制
+    static void MarkActivity() {
+        sActivity = true;
+    }
+
+    // 开始新的一帧: 下一次读取时间时重新采样 (主循环和 Gfx::Render 中调用)
+    static void NextFrame() {
+        sFrameTimeValid = false;
+    }
+
+    // 本帧的时间 (毫秒), 同一帧内所有动画使用同一个值
+    static uint64_t FrameTimeMs() {
+        if (!sFrameTimeValid) {
+            sFrameTime = OSTicksToMilliseconds(OSGetSystemTime());
+            sFrameTimeValid = true;
+        }
+        return sFrameTime;
+    }
+
 private:
+    static inline bool sActivity = false;
+    static inline bool sFrameTimeValid = false;
+    static inline uint64_t sFrameTime = 0;
+
     float mStartValue;
     float mTargetValue;
     float mCurrentValue;
@@ -65,11 +99,16 @@ private:
 // Easing functions
 namespace Easing {
     inline float EaseInOutCubic(float t) {
-        return t < 0.5f ? 4.0f * t * t * t : 1.0f - pow(-2.0f * t + 2.0f, 3.0f) / 2.0f;
+        if (t < 0.5f) {
+            return 4.0f * t * t * t;
+        }
+        float u = -2.0f * t + 2.0f;
+        return 1.0f - u * u * u / 2.0f;
     }
 
     inline float EaseOutCubic(float t) {
-        return 1.0f - pow(1.0f - t, 3.0f);
+        float u = 1.0f - t;
+        return 1.0f - u * u * u;
     }
 
     inline float EaseInCubic(float t) {
@@ -78,12 +117,13 @@ namespace Easing {
 
     inline float EaseOutElastic(float t) {
         const float c4 = (2.0f * M_PI) / 3.0f;
-        return t == 0.0f ? 0.0f : t == 1.0f ? 1.0f : pow(2.0f, -10.0f * t) * sin((t * 10.0f - 0.75f) * c4) + 1.0f;
+        return t == 0.0f ? 0.0f : t == 1.0f ? 1.0f : exp2f(-10.0f * t) * sinf((t * 10.0f - 0.75f) * c4) + 1.0f;
     }
 
     inline float EaseOutBack(float t) {
         const float c1 = 1.70158f;
         const float c3 = c1 + 1.0f;
-        return 1.0f + c3 * pow(t - 1.0f, 3.0f) + c1 * pow(t - 1.0f, 2.0f);
+        float u = t - 1.0f;
+        return 1.0f + c3 * u * u * u + c1 * u * u;
     }
 }
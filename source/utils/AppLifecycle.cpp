@@ -0,0 +1,83 @@
+#include "AppLifecycle.hpp"
+#include "FileLogger.hpp"
+#include <coreinit/time.h>
+#include <proc_ui/procui.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t CALLBACK_PRIORITY = 100;
+
+struct Listener {
+    int id;
+    std::string name;
+    AppLifecycle::Callback onRelease;
+    AppLifecycle::Callback onAcquire;
+};
+
+static std::vector<Listener> sListeners;
+static int sNextId = 1;
+static bool sForeground = true;
+static uint32_t sForegroundCount = 0;
+
+static uint32_t OnForegroundReleased(void*) {
+    if (!sForeground) {
+        return 0;
+    }
+    sForeground = false;
+    OSTime start = OSGetSystemTime();
+    // 回调中可能增删监听者, 按副本通知
+    std::vector<Listener> listeners = sListeners;
+    for (auto it = listeners.rbegin(); it != listeners.rend(); ++it) {
+        if (it->onRelease) {
+            FileLogger::GetInstance().LogDebug("[AppLifecycle] Pausing %s", it->name.c_str());
+            it->onRelease();
+        }
+    }
+    FileLogger::GetInstance().LogInfo("[AppLifecycle] Entered background, %zu listeners paused in %llu ms",
+                                      listeners.size(),
+                                      (unsigned long long)OSTicksToMilliseconds(OSGetSystemTime() - start));
+    return 0;
+}
+
+static uint32_t OnForegroundAcquired(void*) {
+    if (sForeground) {
+        return 0;
+    }
+    sForeground = true;
+    sForegroundCount++;
+    std::vector<Listener> listeners = sListeners;
+    for (const Listener& listener : listeners) {
+        if (listener.onAcquire) {
+            FileLogger::GetInstance().LogDebug("[AppLifecycle] Resuming %s", listener.name.c_str());
+            listener.onAcquire();
+        }
+    }
+    FileLogger::GetInstance().LogInfo("[AppLifecycle] Back in foreground, %zu listeners resumed", listeners.size());
+    return 0;
+}
+
+void AppLifecycle::Init() {
+    ProcUIRegisterCallback(PROCUI_CALLBACK_RELEASE, OnForegroundReleased, nullptr, CALLBACK_PRIORITY);
+    ProcUIRegisterCallback(PROCUI_CALLBACK_ACQUIRE, OnForegroundAcquired, nullptr, CALLBACK_PRIORITY);
+}
+
+int AppLifecycle::AddListener(const char* name, Callback onRelease, Callback onAcquire) {
+    int id = sNextId++;
+    sListeners.push_back({id, name, std::move(onRelease), std::move(onAcquire)});
+    return id;
+}
+
+void AppLifecycle::RemoveListener(int id) {
+    sListeners.erase(std::remove_if(sListeners.begin(), sListeners.end(),
+                                    [id](const Listener& listener) { return listener.id == id; }),
+                     sListeners.end());
+}
+
+bool AppLifecycle::IsForeground() {
+    return sForeground;
+}
+
+uint32_t AppLifecycle::GetForegroundCount() {
+    return sForegroundCount;
+}
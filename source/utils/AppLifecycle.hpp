@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// 进入后台 (HOME 菜单、切换到其它程序) 和回到前台的通知
+// ProcUI 的释放和获取回调都在主线程上 (WHBProcIsRunning 中) 调用, 在后台期间主循环停在那里不动,
+// 只有各子系统自己的线程还在运行; 下载、解码、备份等在释放时暂停, 回到前台时从原来的位置继续
+// 释放时按注册的相反顺序通知, 获取时按注册顺序通知 (先注册的 FastMemory 最后交还 MEM1,
+// 这时其它流水线已经停下来, 不会再分配)
+// 回调里不能等待主线程; 只在主线程调用
+class AppLifecycle {
+public:
+    using Callback = std::function<void()>;
+
+    // WHBProcInit 之后调用
+    static void Init();
+
+    // 返回的编号交给 RemoveListener; 回调可以为空
+    static int AddListener(const char* name, Callback onRelease, Callback onAcquire);
+    static void RemoveListener(int id);
+
+    static bool IsForeground();
+    // 回到前台的次数; 渲染到纹理的缓存据此判断内容是否还有效
+    static uint32_t GetForegroundCount();
+};
@@ -0,0 +1,116 @@
+#include "AssetBundle.hpp"
+#include "FileLogger.hpp"
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <zlib.h>
+
+#include <assets_bin.h>
+
+// 索引格式见 tools/pack_assets.py (大端)
+static constexpr uint32_t BUNDLE_MAGIC = 0x55544142;  // "UTAB"
+static constexpr uint32_t BUNDLE_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 12;
+static constexpr size_t NAME_SIZE = 32;
+static constexpr size_t ENTRY_SIZE = NAME_SIZE + 16;
+
+enum Method {
+    METHOD_STORED = 0,
+    METHOD_DEFLATE = 1
+};
+
+static std::mutex sMutex;
+static std::map<std::string, std::weak_ptr<const std::vector<uint8_t>>> sLoaded;
+
+static uint32_t ReadBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static bool Decompress(uint32_t method, const uint8_t* src, size_t srcSize, std::vector<uint8_t>& out) {
+    if (method == METHOD_STORED) {
+        if (srcSize != out.size()) {
+            return false;
+        }
+        memcpy(out.data(), src, srcSize);
+        return true;
+    }
+    if (method != METHOD_DEFLATE) {
+        return false;
+    }
+
+    z_stream zs = {};
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    zs.next_in = (Bytef*)src;
+    zs.avail_in = (uInt)srcSize;
+    zs.next_out = out.data();
+    zs.avail_out = (uInt)out.size();
+    int ret = inflate(&zs, Z_FINISH);
+    bool ok = ret == Z_STREAM_END && zs.avail_out == 0;
+    inflateEnd(&zs);
+    return ok;
+}
+
+AssetBundle::Data AssetBundle::Load(const std::string& name) {
+    std::lock_guard<std::mutex> lock(sMutex);
+
+    auto it = sLoaded.find(name);
+    if (it != sLoaded.end()) {
+        if (Data data = it->second.lock()) {
+            return data;
+        }
+    }
+
+    const uint8_t* bundle = assets_bin;
+    size_t bundleSize = assets_bin_size;
+    if (bundleSize < HEADER_SIZE || ReadBE32(bundle) != BUNDLE_MAGIC || ReadBE32(bundle + 4) != BUNDLE_VERSION) {
+        FileLogger::GetInstance().LogError("[AssetBundle] Invalid asset bundle");
+        return nullptr;
+    }
+
+    uint32_t count = ReadBE32(bundle + 8);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* entry = bundle + HEADER_SIZE + i * ENTRY_SIZE;
+        if (entry + ENTRY_SIZE > bundle + bundleSize) {
+            break;
+        }
+        if (strncmp((const char*)entry, name.c_str(), NAME_SIZE) != 0) {
+            continue;
+        }
+
+        uint32_t method = ReadBE32(entry + NAME_SIZE);
+        uint32_t offset = ReadBE32(entry + NAME_SIZE + 4);
+        uint32_t compressedSize = ReadBE32(entry + NAME_SIZE + 8);
+        uint32_t size = ReadBE32(entry + NAME_SIZE + 12);
+        if ((uint64_t)offset + compressedSize > bundleSize) {
+            break;
+        }
+
+        auto data = std::make_shared<std::vector<uint8_t>>(size);
+        if (!Decompress(method, bundle + offset, compressedSize, *data)) {
+            FileLogger::GetInstance().LogError("[AssetBundle] Failed to decompress %s", name.c_str());
+            return nullptr;
+        }
+        FileLogger::GetInstance().LogInfo("[AssetBundle] Loaded %s (%u -> %u bytes)", name.c_str(), compressedSize, size);
+        sLoaded[name] = data;
+        return data;
+    }
+
+    FileLogger::GetInstance().LogError("[AssetBundle] Asset %s not found", name.c_str());
+    return nullptr;
+}
+
+size_t AssetBundle::GetResidentBytes() {
+    std::lock_guard<std::mutex> lock(sMutex);
+    size_t bytes = 0;
+    for (auto it = sLoaded.begin(); it != sLoaded.end();) {
+        if (Data data = it->second.lock()) {
+            bytes += data->size();
+            ++it;
+        } else {
+            it = sLoaded.erase(it);
+        }
+    }
+    return bytes;
+}
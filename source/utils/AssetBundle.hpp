@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 嵌入的资源包 (tools/pack_assets.py 在编译时生成的 assets.bin)
+// 每个资源单独用 deflate 压缩, 开头是索引; 第一次使用时解压到堆上
+// 返回的缓冲区由调用者持有, 最后一个持有者放开后释放; 还有人持有时再次 Load 返回同一个缓冲区
+// 只用于不是一直需要的资源 (语言文件、等宽字体); 一直使用的字体没有压缩, 否则程序映像和堆上各有一份
+class AssetBundle {
+public:
+    using Data = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // 没有该资源或解压失败时返回 nullptr
+    static Data Load(const std::string& name);
+
+    // 已解压且还在使用的字节数
+    static size_t GetResidentBytes();
+};
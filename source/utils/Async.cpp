@@ -0,0 +1,137 @@
+#include "Async.hpp"
+#include "DownloadQueue.hpp"
+#include "FileLogger.hpp"
+#include <algorithm>
+
+namespace Async {
+
+namespace Detail {
+
+void ScheduleOnWorker(std::coroutine_handle<> handle, std::shared_ptr<ScopeState> scope) {
+    // 记下在任务线程上运行的协程, Scope::Cancel 要等它们挂起或结束
+    JobSystem::Submit([handle, scope](const CancelToken&) {
+        if (scope) {
+            std::lock_guard<std::mutex> lock(scope->mutex);
+            scope->onWorker++;
+        }
+        handle.resume();
+        if (scope) {
+            std::lock_guard<std::mutex> lock(scope->mutex);
+            if (--scope->onWorker == 0) {
+                scope->idleCv.notify_all();
+            }
+        }
+    });
+}
+
+void ScheduleOnMainThread(std::coroutine_handle<> handle) {
+    JobSystem::RunOnMainThread([handle]() { handle.resume(); });
+}
+
+bool StartDownloads(const std::vector<DownloadOperation*>& ops, std::coroutine_handle<> handle,
+                    std::shared_ptr<ScopeState> scope) {
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (!queue) {
+        for (DownloadOperation* op : ops) {
+            op->status = DownloadStatus::FAILED;
+        }
+        return false;
+    }
+
+    auto remaining = std::make_shared<size_t>(ops.size());
+    {
+        std::lock_guard<std::mutex> lock(scope->mutex);
+        for (DownloadOperation* op : ops) {
+            scope->downloads.push_back({op, handle, remaining});
+        }
+    }
+
+    // 完成回调在主线程 (DownloadQueue::Process) 中执行, 最后一个下载结束时继续协程
+    for (DownloadOperation* op : ops) {
+        op->cb = [scope](DownloadOperation* done) {
+            std::coroutine_handle<> waiter;
+            {
+                std::lock_guard<std::mutex> lock(scope->mutex);
+                auto& downloads = scope->downloads;
+                auto it = std::find_if(downloads.begin(), downloads.end(),
+                                       [done](const ScopeState::PendingDownload& d) { return d.op == done; });
+                if (it == downloads.end()) {
+                    return;
+                }
+                if (--*it->remaining == 0) {
+                    waiter = it->waiter;
+                }
+                downloads.erase(it);
+            }
+            if (waiter) {
+                waiter.resume();
+            }
+        };
+        queue->DownloadAdd(op);
+    }
+    return true;
+}
+
+void ReportUnhandled(std::exception_ptr exception) {
+    try {
+        std::rethrow_exception(exception);
+    } catch (const std::exception& e) {
+        FileLogger::GetInstance().LogError("[Async] Unhandled exception in task: %s", e.what());
+    } catch (...) {
+        FileLogger::GetInstance().LogError("[Async] Unhandled exception in task");
+    }
+}
+
+} // namespace Detail
+
+// 最外层的协程: 取消正常结束, 其它异常只记录
+static Task<void> RunDetached(Task<void> task) {
+    try {
+        co_await task;
+    } catch (const Cancelled&) {
+    } catch (...) {
+        Detail::ReportUnhandled(std::current_exception());
+    }
+}
+
+void Scope::Spawn(Task<void> task) {
+    if (IsCancelled()) {
+        return;
+    }
+    Task<void> wrapper = RunDetached(std::move(task));
+    auto handle = wrapper.Release();
+    handle.promise().scope = mState;
+    handle.promise().detached = true;
+    handle.resume();
+}
+
+void Scope::Cancel() {
+    mState->token.Cancel();
+
+    std::vector<ScopeState::PendingDownload> downloads;
+    {
+        std::lock_guard<std::mutex> lock(mState->mutex);
+        downloads.swap(mState->downloads);
+    }
+
+    // 取消下载后直接恢复等待的协程, 它们抛出 Cancelled 并清理自己的下载对象
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    std::vector<std::coroutine_handle<>> waiters;
+    for (const auto& download : downloads) {
+        if (queue) {
+            queue->DownloadCancel(download.op);
+        }
+        if (*download.remaining != 0) {
+            *download.remaining = 0;
+            waiters.push_back(download.waiter);
+        }
+    }
+    for (auto waiter : waiters) {
+        waiter.resume();
+    }
+
+    std::unique_lock<std::mutex> lock(mState->mutex);
+    mState->idleCv.wait(lock, [this]() { return mState->onWorker == 0; });
+}
+
+} // namespace Async
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "JobSystem.hpp"
+#include <coroutine>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct DownloadOperation;
+
+// C++20 协程: 把 "下载 -> 后台处理 -> 回到主线程" 这样的流程写成顺序代码, 代替层层嵌套的回调
+//
+//   Async::Task<void> SaveImages(...) {
+//       co_await Async::ResumeOnWorker();        // 之后在 JobSystem 的任务线程上运行
+//       ...
+//       co_await Async::Download(ops);           // 等待下载全部结束 (在主线程继续)
+//       co_await Async::ResumeOnMainThread();
+//   }
+//   mScope.Spawn(SaveImages(...));
+//
+// 协程属于一个 Scope (通常是界面的成员); Scope 取消或析构后, 协程在下一个 co_await 处抛出
+// Async::Cancelled 并结束, 不会在界面释放之后继续执行; 正在等待的下载同时被取消
+namespace Async {
+
+// 所属的 Scope 已经取消
+struct Cancelled {};
+
+// Scope 的共享部分, 协程帧持有它, Scope 析构后仍然有效
+struct ScopeState {
+    CancelToken token;
+
+    std::mutex mutex;                 // 保护下面的成员
+    std::condition_variable idleCv;   // onWorker 变为 0
+    int onWorker = 0;                 // 正在任务线程上运行的协程数
+
+    struct PendingDownload {
+        DownloadOperation* op;
+        std::coroutine_handle<> waiter;
+        std::shared_ptr<size_t> remaining;  // 同一次 co_await 的下载还没结束的数量
+    };
+    std::vector<PendingDownload> downloads;
+};
+
+namespace Detail {
+
+void ScheduleOnWorker(std::coroutine_handle<> handle, std::shared_ptr<ScopeState> scope);
+void ScheduleOnMainThread(std::coroutine_handle<> handle);
+// 返回 false 时下载没有开始 (没有下载队列), 协程不挂起
+bool StartDownloads(const std::vector<DownloadOperation*>& ops, std::coroutine_handle<> handle,
+                    std::shared_ptr<ScopeState> scope);
+void ReportUnhandled(std::exception_ptr exception);
+
+struct PromiseBase {
+    std::shared_ptr<ScopeState> scope;
+    std::coroutine_handle<> continuation;  // co_await 这个任务的协程
+    std::exception_ptr exception;
+    bool detached = false;                 // Scope::Spawn 启动的最外层协程, 结束时释放自己
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+            PromiseBase& promise = handle.promise();
+            if (promise.continuation) {
+                return promise.continuation;
+            }
+            if (promise.detached) {
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+// 恢复后检查所属的 Scope 是否已经取消
+class CancellableAwaiter {
+public:
+    void await_resume() const {
+        if (mScope && mScope->token.IsCancelled()) {
+            throw Cancelled();
+        }
+    }
+
+protected:
+    std::shared_ptr<ScopeState> mScope;
+};
+
+} // namespace Detail
+
+template <class T>
+class Task;
+
+template <class T>
+struct Promise : Detail::PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    template <class U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+};
+
+template <>
+struct Promise<void> : Detail::PromiseBase {
+    Task<void> get_return_object();
+
+    void return_void() {}
+};
+
+// 延迟启动的协程: co_await 时才开始运行, 结束后回到等待它的协程
+template <class T = void>
+class [[nodiscard]] Task {
+public:
+    using promise_type = Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task(Task&& other) noexcept : mHandle(std::exchange(other.mHandle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (mHandle) {
+                mHandle.destroy();
+            }
+            mHandle = std::exchange(other.mHandle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (mHandle) {
+            mHandle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    // 子任务属于调用者的 Scope
+    template <class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> caller) noexcept {
+        mHandle.promise().scope = caller.promise().scope;
+        mHandle.promise().continuation = caller;
+        return mHandle;
+    }
+
+    T await_resume() {
+        promise_type& promise = mHandle.promise();
+        if (promise.exception) {
+            std::rethrow_exception(promise.exception);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*promise.value);
+        }
+    }
+
+    Handle Release() { return std::exchange(mHandle, {}); }
+
+private:
+    friend struct Promise<T>;
+    explicit Task(Handle handle) : mHandle(handle) {}
+
+    Handle mHandle;
+};
+
+template <class T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+// 在 JobSystem 的任务线程上继续
+class ResumeOnWorker : public Detail::CancellableAwaiter {
+public:
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    void await_suspend(std::coroutine_handle<P> handle) {
+        mScope = handle.promise().scope;
+        Detail::ScheduleOnWorker(handle, mScope);
+    }
+};
+
+// 在主线程上继续 (JobSystem::Update, 受帧预算限制)
+class ResumeOnMainThread : public Detail::CancellableAwaiter {
+public:
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    void await_suspend(std::coroutine_handle<P> handle) {
+        mScope = handle.promise().scope;
+        Detail::ScheduleOnMainThread(handle);
+    }
+};
+
+// 把下载交给 DownloadQueue 并等待全部结束, 在主线程继续
+// 下载对象归调用者所有; 设置了 cb 也会被替换; 结果看各自的 status / response_code
+class Download : public Detail::CancellableAwaiter {
+public:
+    explicit Download(DownloadOperation* op) : mOps{op} {}
+    explicit Download(std::vector<DownloadOperation*> ops) : mOps(std::move(ops)) {}
+
+    bool await_ready() const noexcept { return mOps.empty(); }
+
+    template <class P>
+    bool await_suspend(std::coroutine_handle<P> handle) {
+        mScope = handle.promise().scope;
+        return Detail::StartDownloads(mOps, handle, mScope);
+    }
+
+private:
+    std::vector<DownloadOperation*> mOps;
+};
+
+// 不挂起, 取得当前协程的取消标记 (交给长时间运行的循环检查)
+class CurrentToken {
+public:
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    bool await_suspend(std::coroutine_handle<P> handle) noexcept {
+        if (handle.promise().scope) {
+            mToken = handle.promise().scope->token;
+        }
+        return false;
+    }
+
+    CancelToken await_resume() const { return mToken; }
+
+private:
+    CancelToken mToken;
+};
+
+// 协程的所有者, 析构时取消其中所有的协程
+class Scope {
+public:
+    Scope() : mState(std::make_shared<ScopeState>()) {}
+    ~Scope() { Cancel(); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    // 在调用线程上开始运行 task, 直到第一个挂起点
+    void Spawn(Task<void> task);
+
+    // 在主线程调用: 取消等待中的下载, 等待正在任务线程上运行的协程挂起或结束
+    // 之后恢复的协程都抛出 Cancelled; 取消后不能再 Spawn
+    void Cancel();
+
+    bool IsCancelled() const { return mState->token.IsCancelled(); }
+
+private:
+    std::shared_ptr<ScopeState> mState;
+};
+
+} // namespace Async
@@ -0,0 +1,395 @@
+#include "BackupArchive.hpp"
+#include "FileLogger.hpp"
+#include "FastMemory.hpp"
+#include "Utils.hpp"
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+static const char HEADER_MAGIC[4] = {'U', 'T', 'B', 'A'};
+static const char TRAILER_MAGIC[4] = {'U', 'T', 'B', 'I'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 8;    // magic, version
+static constexpr size_t TRAILER_SIZE = 16;  // 索引位置, 条目数, magic
+// 压缩输出每次交给 Append 的块大小
+static constexpr size_t DEFLATE_CHUNK = 256 * 1024;
+
+static void PutLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint64_t GetLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+BackupArchive::~BackupArchive() {
+    if (!mTempPath.empty()) {
+        Abort();
+    }
+    Close();
+}
+
+bool BackupArchive::Create(const std::string& path) {
+    Close();
+    mPath = path;
+    mTempPath = path + ".tmp";
+    mEntries.clear();
+    mBuffered = 0;
+    mOffset = 0;
+    mFailed = false;
+    mWriteBuffer.resize(WRITE_BUFFER_SIZE);
+    if (mWriteBuffer.size() == 0 || !mFile.Open(mTempPath, FileIO::MODE_WRITE)) {
+        FileLogger::GetInstance().LogError("[BackupArchive] Failed to create %s", mTempPath.c_str());
+        mTempPath.clear();
+        return false;
+    }
+    std::vector<uint8_t> header(HEADER_MAGIC, HEADER_MAGIC + 4);
+    PutLE(header, FORMAT_VERSION, 4);
+    std::lock_guard<std::mutex> lock(mMutex);
+    return Append(header.data(), header.size());
+}
+
+bool BackupArchive::FlushBuffer() {
+    if (mBuffered > 0 && !mFailed) {
+        mFailed = !mFile.Write(mWriteBuffer.data(), mBuffered);
+    }
+    mBuffered = 0;
+    return !mFailed;
+}
+
+bool BackupArchive::Append(const void* data, size_t n) {
+    const uint8_t* in = (const uint8_t*)data;
+    mOffset += n;
+    while (n > 0 && !mFailed) {
+        size_t chunk = std::min(n, mWriteBuffer.size() - mBuffered);
+        memcpy(mWriteBuffer.data() + mBuffered, in, chunk);
+        mBuffered += chunk;
+        in += chunk;
+        n -= chunk;
+        if (mBuffered == mWriteBuffer.size()) {
+            FlushBuffer();
+        }
+    }
+    return !mFailed;
+}
+
+bool BackupArchive::AddBuffer(const std::string& relativePath, int64_t mtime, const uint8_t* data, size_t size,
+                              uint32_t& crc) {
+    crc = (uint32_t)crc32(0, data, (uInt)size);
+
+    // 锁外压缩, 几个复制线程可以同时压缩各自的文件
+    std::vector<uint8_t> compressed;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (size > 0 && deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+        compressed.resize(deflateBound(&zs, (uLong)size));
+        zs.next_in = (Bytef*)data;
+        zs.avail_in = (uInt)size;
+        zs.next_out = compressed.data();
+        zs.avail_out = (uInt)compressed.size();
+        bool ok = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+        compressed.resize(ok ? zs.total_out : 0);
+        deflateEnd(&zs);
+    }
+
+    Entry entry;
+    entry.path = relativePath;
+    entry.size = size;
+    entry.mtime = mtime;
+    entry.crc = crc;
+    // 压缩后没有变小就直接存放
+    bool deflated = !compressed.empty() && compressed.size() < size;
+    entry.method = deflated ? METHOD_DEFLATE : METHOD_STORED;
+    entry.storedSize = deflated ? compressed.size() : size;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    entry.offset = mOffset;
+    if (!Append(deflated ? compressed.data() : data, (size_t)entry.storedSize)) {
+        return false;
+    }
+    mEntries.push_back(std::move(entry));
+    return true;
+}
+
+bool BackupArchive::AddFile(const std::string& relativePath, int64_t mtime, FileIO& src, FileIO::Buffer& buffer,
+                            uint32_t& crc, const std::atomic<bool>* stop) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    std::vector<uint8_t> out(DEFLATE_CHUNK);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry entry;
+    entry.path = relativePath;
+    entry.method = METHOD_DEFLATE;
+    entry.offset = mOffset;
+    entry.mtime = mtime;
+
+    uLong crcValue = crc32(0, nullptr, 0);
+    bool ok = !mFailed;
+    int flush = Z_NO_FLUSH;
+    while (ok && flush != Z_FINISH) {
+        if (stop && stop->load()) {
+            ok = false;
+            break;
+        }
+        size_t n = src.Read(buffer.data(), buffer.size());
+        crcValue = crc32(crcValue, buffer.data(), (uInt)n);
+        entry.size += n;
+        flush = n < buffer.size() ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = buffer.data();
+        zs.avail_in = (uInt)n;
+        int ret;
+        do {
+            zs.next_out = out.data();
+            zs.avail_out = (uInt)out.size();
+            ret = deflate(&zs, flush);
+            size_t produced = out.size() - zs.avail_out;
+            if (ret == Z_STREAM_ERROR || (produced > 0 && !Append(out.data(), produced))) {
+                ok = false;
+                break;
+            }
+        } while (zs.avail_out == 0);
+    }
+    deflateEnd(&zs);
+    // 读取出错也会提前结束, 按文件大小确认读完
+    ok = ok && entry.size == src.Size();
+    if (!ok) {
+        // 已经写出的部分留在容器里不被索引引用, 不影响其它条目
+        return false;
+    }
+    entry.storedSize = mOffset - entry.offset;
+    entry.crc = crc = (uint32_t)crcValue;
+    mEntries.push_back(std::move(entry));
+    return true;
+}
+
+bool BackupArchive::Finish() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<uint8_t> index;
+    for (const Entry& entry : mEntries) {
+        PutLE(index, entry.path.size(), 2);
+        index.insert(index.end(), entry.path.begin(), entry.path.end());
+        index.push_back(entry.method);
+        PutLE(index, entry.offset, 8);
+        PutLE(index, entry.storedSize, 8);
+        PutLE(index, entry.size, 8);
+        PutLE(index, (uint64_t)entry.mtime, 8);
+        PutLE(index, entry.crc, 4);
+    }
+    PutLE(index, mOffset, 8);
+    PutLE(index, mEntries.size(), 4);
+    index.insert(index.end(), TRAILER_MAGIC, TRAILER_MAGIC + 4);
+
+    bool ok = Append(index.data(), index.size()) && FlushBuffer() && mFile.Sync();
+    ok = mFile.Close() && ok;
+    mWriteBuffer.resize(0);
+    if (ok) {
+        remove(mPath.c_str());
+        ok = rename(mTempPath.c_str(), mPath.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(mTempPath.c_str());
+        FileLogger::GetInstance().LogError("[BackupArchive] Failed to write %s", mPath.c_str());
+    } else {
+        FileLogger::GetInstance().LogInfo("[BackupArchive] Wrote %zu files, %llu bytes", mEntries.size(),
+                                          (unsigned long long)mOffset);
+    }
+    mTempPath.clear();
+    return ok;
+}
+
+void BackupArchive::Abort() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFile.Close();
+    mWriteBuffer.resize(0);
+    if (!mTempPath.empty()) {
+        remove(mTempPath.c_str());
+        mTempPath.clear();
+    }
+}
+
+bool BackupArchive::Open(const std::string& path) {
+    Close();
+    mPath = path;
+    if (!mFile.Open(path, FileIO::MODE_READ)) {
+        return false;
+    }
+    uint64_t fileSize = mFile.Size();
+    uint8_t header[HEADER_SIZE];
+    uint8_t trailer[TRAILER_SIZE];
+    if (fileSize < HEADER_SIZE + TRAILER_SIZE ||
+        mFile.ReadAt(0, header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, HEADER_MAGIC, 4) != 0 || GetLE(header + 4, 4) != FORMAT_VERSION ||
+        mFile.ReadAt(fileSize - TRAILER_SIZE, trailer, sizeof(trailer)) != sizeof(trailer) ||
+        memcmp(trailer + 12, TRAILER_MAGIC, 4) != 0) {
+        FileLogger::GetInstance().LogError("[BackupArchive] Not a backup archive: %s", path.c_str());
+        Close();
+        return false;
+    }
+
+    uint64_t indexOffset = GetLE(trailer, 8);
+    uint32_t count = (uint32_t)GetLE(trailer + 8, 4);
+    if (indexOffset < HEADER_SIZE || indexOffset > fileSize - TRAILER_SIZE) {
+        Close();
+        return false;
+    }
+    std::vector<uint8_t> index((size_t)(fileSize - TRAILER_SIZE - indexOffset));
+    if (!index.empty() && mFile.ReadAt(indexOffset, index.data(), index.size()) != index.size()) {
+        Close();
+        return false;
+    }
+
+    // 每个条目: 路径长度、路径、方式、位置、存放大小、原始大小、修改时间、CRC32
+    const size_t FIXED = 1 + 8 + 8 + 8 + 8 + 4;
+    size_t pos = 0;
+    // count 来自文件尾, 损坏时可能很大: 按索引最多能放下的条目数预留
+    mEntries.reserve(std::min<size_t>(count, index.size() / (2 + FIXED)));
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos + 2 > index.size()) {
+            break;
+        }
+        size_t nameLen = (size_t)GetLE(&index[pos], 2);
+        pos += 2;
+        if (pos + nameLen + FIXED > index.size()) {
+            break;
+        }
+        Entry entry;
+        entry.path.assign((const char*)&index[pos], nameLen);
+        pos += nameLen;
+        entry.method = (Method)index[pos++];
+        entry.offset = GetLE(&index[pos], 8);
+        entry.storedSize = GetLE(&index[pos + 8], 8);
+        entry.size = GetLE(&index[pos + 16], 8);
+        entry.mtime = (int64_t)GetLE(&index[pos + 24], 8);
+        entry.crc = (uint32_t)GetLE(&index[pos + 32], 4);
+        pos += FIXED - 1;
+        if (entry.offset + entry.storedSize > indexOffset) {
+            continue;
+        }
+        mEntries.push_back(std::move(entry));
+    }
+    if (mEntries.size() != count) {
+        FileLogger::GetInstance().LogError("[BackupArchive] Damaged index in %s", path.c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+const BackupArchive::Entry* BackupArchive::Find(const std::string& relativePath) const {
+    for (const Entry& entry : mEntries) {
+        if (entry.path == relativePath) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool BackupArchive::Extract(const Entry& entry, const std::string& destPath) {
+    FileIO out;
+    if (!out.Open(destPath, FileIO::MODE_WRITE) || !out.Reserve(entry.size)) {
+        out.Close();
+        remove(destPath.c_str());
+        return false;
+    }
+
+    FileIO::Buffer in(FileIO::CHUNK_SIZE);
+    FileIO::Buffer inflated(entry.method == METHOD_DEFLATE ? FileIO::CHUNK_SIZE : 0);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    zs.zalloc = FastMemory::ZAlloc;
+    zs.zfree = FastMemory::ZFree;
+    bool ok = in.size() > 0 && (entry.method == METHOD_STORED ||
+              (inflated.size() > 0 && inflateInit2(&zs, -MAX_WBITS) == Z_OK));
+    bool inflating = ok && entry.method == METHOD_DEFLATE;
+
+    uLong crc = crc32(0, nullptr, 0);
+    uint64_t written = 0;
+    uint64_t remaining = entry.storedSize;
+    uint64_t offset = entry.offset;
+    while (ok && remaining > 0) {
+        size_t n = mFile.ReadAt(offset, in.data(), (size_t)std::min<uint64_t>(in.size(), remaining));
+        if (n == 0) {
+            ok = false;
+            break;
+        }
+        offset += n;
+        remaining -= n;
+        if (!inflating) {
+            crc = crc32(crc, in.data(), (uInt)n);
+            written += n;
+            ok = out.Write(in.data(), n);
+            continue;
+        }
+        zs.next_in = in.data();
+        zs.avail_in = (uInt)n;
+        do {
+            zs.next_out = inflated.data();
+            zs.avail_out = (uInt)inflated.size();
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                ok = false;
+                break;
+            }
+            size_t produced = inflated.size() - zs.avail_out;
+            crc = crc32(crc, inflated.data(), (uInt)produced);
+            written += produced;
+            if (produced > 0 && !out.Write(inflated.data(), produced)) {
+                ok = false;
+                break;
+            }
+            if (ret == Z_STREAM_END) {
+                break;
+            }
+        } while (zs.avail_out == 0);
+    }
+    if (inflating) {
+        inflateEnd(&zs);
+    }
+    ok = ok && written == entry.size && (uint32_t)crc == entry.crc;
+    ok = out.Close() && ok;
+    if (!ok) {
+        FileLogger::GetInstance().LogError("[BackupArchive] Failed to extract %s", entry.path.c_str());
+        remove(destPath.c_str());
+    }
+    return ok;
+}
+
+bool BackupArchive::ExtractAll(const std::string& destDir,
+                               const std::function<void(size_t done, size_t total)>& progress) {
+    // 按容器中的位置顺序读取
+    std::vector<const Entry*> order;
+    for (const Entry& entry : mEntries) {
+        order.push_back(&entry);
+    }
+    std::sort(order.begin(), order.end(), [](const Entry* a, const Entry* b) { return a->offset < b->offset; });
+
+    size_t done = 0;
+    for (const Entry* entry : order) {
+        std::string destPath = destDir + "/" + entry->path;
+        size_t slash = destPath.find_last_of('/');
+        if (!Utils::CreateSubfolder(destPath.substr(0, slash)) || !Extract(*entry, destPath)) {
+            return false;
+        }
+        done++;
+        if (progress) {
+            progress(done, order.size());
+        }
+    }
+    return true;
+}
+
+void BackupArchive::Close() {
+    mFile.Close();
+    mEntries.clear();
+}
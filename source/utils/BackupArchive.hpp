@@ -0,0 +1,79 @@
+#pragma once
+
+#include "FileIO.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 备份容器: 所有文件按顺序存放在一个文件里, 每个文件一段独立的 raw deflate 流 (压缩没有收益时直接存放),
+// 末尾是索引 (相对路径、位置、大小、修改时间、CRC32) 和指向索引的尾部
+// 写入只在末尾追加, 经过大缓冲区顺序写出; 先写到 path + ".tmp", Finish 成功后才改名
+// 读取时只读尾部和索引, 任意一个文件都可以单独解出 (Extract), 也可以全部恢复 (ExtractAll)
+// MLC 上的 .pack 等文件压缩率高, 写入 SD 卡的字节数和 FAT 目录操作都比逐个复制少
+// 多字节数值都按小端存放
+class BackupArchive {
+public:
+    static constexpr const char* FILE_NAME = "backup.utba";
+    static constexpr size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+    enum Method : uint8_t {
+        METHOD_STORED = 0,
+        METHOD_DEFLATE = 1
+    };
+
+    struct Entry {
+        std::string path;        // 相对路径
+        Method method = METHOD_STORED;
+        uint64_t offset = 0;     // 数据在容器中的位置
+        uint64_t storedSize = 0; // 容器中的字节数
+        uint64_t size = 0;       // 原始大小
+        int64_t mtime = 0;
+        uint32_t crc = 0;        // 原始内容的 CRC32
+    };
+
+    BackupArchive() = default;
+    ~BackupArchive();
+    BackupArchive(const BackupArchive&) = delete;
+    BackupArchive& operator=(const BackupArchive&) = delete;
+
+    // 写入: Add* 可以在多个线程上同时调用
+    bool Create(const std::string& path);
+    // 整个文件已经在内存中: 在调用线程上压缩, 只在追加到容器时加锁
+    bool AddBuffer(const std::string& relativePath, int64_t mtime, const uint8_t* data, size_t size, uint32_t& crc);
+    // 大文件: 持有写入锁边读边压缩边写出, buffer 为读取用的缓冲区; stop 为 true 时中止
+    bool AddFile(const std::string& relativePath, int64_t mtime, FileIO& src, FileIO::Buffer& buffer, uint32_t& crc,
+                 const std::atomic<bool>* stop = nullptr);
+    // 写出索引和尾部并改名; 失败时删除临时文件
+    bool Finish();
+    // 放弃写入, 删除临时文件
+    void Abort();
+
+    // 读取 (只在一个线程上使用)
+    bool Open(const std::string& path);
+    const std::vector<Entry>& GetEntries() const { return mEntries; }
+    const Entry* Find(const std::string& relativePath) const;
+    // 把一个条目解到 destPath, 校验 CRC32, 失败时不留下文件
+    bool Extract(const Entry& entry, const std::string& destPath);
+    // 恢复所有文件到 destDir 下 (按相对路径创建目录), 每解出一个文件调用一次 progress
+    bool ExtractAll(const std::string& destDir, const std::function<void(size_t done, size_t total)>& progress = nullptr);
+    void Close();
+
+private:
+    FileIO mFile;
+    std::string mPath;
+    std::string mTempPath;
+    std::vector<Entry> mEntries;
+
+    // 写入状态, 由 mMutex 保护
+    std::mutex mMutex;
+    FileIO::Buffer mWriteBuffer;
+    size_t mBuffered = 0;
+    uint64_t mOffset = 0;      // 已经追加的字节数 (包括还在缓冲区里的)
+    bool mFailed = false;
+
+    bool Append(const void* data, size_t n);  // 调用者持有 mMutex
+    bool FlushBuffer();
+};
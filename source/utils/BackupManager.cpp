@@ -1,52 +1,99 @@
 #include "BackupManager.hpp"
 #include "Utils.hpp"
+#include "FileLogger.hpp"
+#include "AllocTracker.hpp"
+#include "Trace.hpp"
+#include "AppLifecycle.hpp"
+#include "JobSystem.hpp"
+#include "PerfProfile.hpp"
 #include <sys/stat.h>
 #include <dirent.h>
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
+#include <zlib.h>
+
+static const char* MANIFEST_MAGIC = "UTBM";
+static const int MANIFEST_VERSION = 1;
 
 BackupManager::BackupManager()
-    : mTotalItems(0)
+    : mMode(MODE_FULL)
+    , mIsBackupInProgress(false)
+    , mReportedItems(0)
+    , mTotalItems(0)
     , mProcessedItems(0)
     , mScannedDirs(0)
-    , mIsBackupInProgress(false)
+    , mSkippedItems(0)
+    , mMismatchedItems(0)
     , mIsScanning(false)
-    , mIsSelectiveScan(false)
-    , mCopySourceFile(nullptr)
-    , mCopyDestFile(nullptr)
-    , mCopyFileSize(0)
-    , mCopyFileCopied(0)
-    , mIsCopyingFile(false)
+    , mFinished(false)
+    , mStop(false)
+    , mScanDone(false)
+    , mPaused(false)
+    , mActiveScanners(0)
+    , mCheckSpace(false)
+    , mFreeBytes(0)
+    , mNeededBytes(0)
     , mProgressCallback(nullptr)
     , mErrorCallback(nullptr) {
+    mLifecycleListener = AppLifecycle::AddListener("BackupManager", [this]() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPaused = true;
+    }, [this]() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPaused = false;
+        }
+        mPauseCv.notify_all();
+    });
 }
 
 BackupManager::~BackupManager() {
-    EndFileCopy();
+    AppLifecycle::RemoveListener(mLifecycleListener);
+    StopThreads();
 }
 
 bool BackupManager::StartBackup(const std::string& sourcePath, const std::string& backupPath) {
+    return Start(sourcePath, backupPath, MODE_FULL);
+}
+
+bool BackupManager::StartSelectiveBackup(const std::string& mlcPath, const std::string& sdSourcePath, const std::string& backupPath) {
+    mSdSourceBasePath = sdSourcePath;
+    return Start(mlcPath, backupPath, MODE_SELECTIVE);
+}
+
+bool BackupManager::StartArchiveBackup(const std::string& sourcePath, const std::string& backupPath) {
+    return Start(sourcePath, backupPath, MODE_ARCHIVE);
+}
+
+bool BackupManager::StartVerify(const std::string& sourcePath, const std::string& backupPath) {
+    return Start(sourcePath, backupPath, MODE_VERIFY);
+}
+
+bool BackupManager::Start(const std::string& sourcePath, const std::string& backupPath, Mode mode) {
+    // 上一次备份的线程还在运行时先停止
+    StopThreads();
+
     // 重置状态
     mTotalItems = 0;
     mProcessedItems = 0;
     mScannedDirs = 0;
-    mCurrentFile = "";
+    mSkippedItems = 0;
+    mMismatchedItems = 0;
+    mReportedItems = 0;
     mSourcePath = sourcePath;
     mBackupPath = backupPath;
-    mIsBackupInProgress = true;
-    mIsScanning = true;
-    mIsSelectiveScan = false;
-    
-    // 清空队列
-    while (!mPendingFiles.empty()) {
-        mPendingFiles.pop();
-    }
-    while (!mPendingScans.empty()) {
-        mPendingScans.pop();
-    }
-    
-    // 创建备份目录
-    if (!Utils::CreateSubfolder(backupPath)) {
+    mMode = mode;
+    mPendingFiles.clear();
+    mNewManifest.clear();
+    mScanDone = false;
+    mCurrentFile.clear();
+    mError.clear();
+    mStop = false;
+    mFinished = false;
+
+    // 创建备份目录 (校验时不创建)
+    if (mode != MODE_VERIFY && !Utils::CreateSubfolder(backupPath)) {
         if (mErrorCallback) {
             mErrorCallback("创建备份目录失败: " + backupPath);
         }
@@ -54,328 +101,563 @@ bool BackupManager::StartBackup(const std::string& sourcePath, const std::string
         mIsScanning = false;
         return false;
     }
-    
-    // 添加根目录到扫描队列（异步扫描）
-    mPendingScans.push(ScanEntry(sourcePath, backupPath));
-    
-    return true;
-}
 
-bool BackupManager::StartSelectiveBackup(const std::string& mlcPath, const std::string& sdSourcePath, const std::string& backupPath) {
-    // 重置状态
-    mTotalItems = 0;
-    mProcessedItems = 0;
-    mScannedDirs = 0;
-    mCurrentFile = "";
-    mSourcePath = mlcPath;
-    mBackupPath = backupPath;
-    mSdSourceBasePath = sdSourcePath;
-    mIsBackupInProgress = true;
-    mIsScanning = true;
-    mIsSelectiveScan = true;
-    
-    // 清空队列
-    while (!mPendingFiles.empty()) {
-        mPendingFiles.pop();
-    }
-    while (!mPendingScans.empty()) {
-        mPendingScans.pop();
-    }
-    
-    // 创建备份目录
-    if (!Utils::CreateSubfolder(backupPath)) {
+    if (mode == MODE_ARCHIVE) {
+        // 容器每次完整写一遍, 不使用清单
+        mManifest.clear();
+        if (!mArchive.Create(backupPath + "/" + BackupArchive::FILE_NAME)) {
+            if (mErrorCallback) {
+                mErrorCallback("创建备份文件失败: " + backupPath);
+            }
+            mIsBackupInProgress = false;
+            mIsScanning = false;
+            return false;
+        }
+    } else {
+        LoadManifest();
+    }
+    if (mode == MODE_VERIFY && mManifest.empty()) {
         if (mErrorCallback) {
-            mErrorCallback("创建备份目录失败: " + backupPath);
+            mErrorCallback("备份清单不存在: " + backupPath);
         }
         mIsBackupInProgress = false;
         mIsScanning = false;
         return false;
     }
-    
-    // 添加根目录到扫描队列（异步扫描）
-    mPendingScans.push(ScanEntry(mlcPath, backupPath));
-    
+
+    mIsBackupInProgress = true;
+    mIsScanning = true;
+    mThread = std::thread(&BackupManager::ScanThread, this);
     return true;
 }
 
-void BackupManager::ScanDirectory(const std::string& srcPath, const std::string& dstPath) {
-    DIR* dir = opendir(srcPath.c_str());
-    if (!dir) return;
+void BackupManager::LoadManifest() {
+    mManifest.clear();
+    std::string content;
+    if (!FileIO::ReadAll(mBackupPath + "/" + MANIFEST_FILE, content)) {
+        return;
+    }
 
-    struct dirent* dp;
-    while ((dp = readdir(dir)) != nullptr) {
-        std::string name = dp->d_name;
-        if (name == "." || name == "..") continue;
+    // 第一行是版本, 之后每行: 相对路径 大小 修改时间 CRC32
+    size_t start = 0;
+    bool header = true;
+    while (start < content.size()) {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string line = content.substr(start, end - start);
+        start = end + 1;
 
-        std::string fullSrcPath = srcPath + "/" + name;
-        std::string fullDstPath = dstPath + "/" + name;
-        
-        struct stat filestat;
-        if (stat(fullSrcPath.c_str(), &filestat) == 0) {
-            bool isDir = (filestat.st_mode & S_IFMT) == S_IFDIR;
-            
-            if (isDir) {
-                // 递归扫描子目录
-                ScanDirectory(fullSrcPath, fullDstPath);
-            } else {
-                // 只添加文件
-                mPendingFiles.push(FileEntry(fullSrcPath, false));
-                mTotalItems++;
+        size_t tab3 = line.rfind('\t');
+        size_t tab2 = (tab3 == std::string::npos || tab3 == 0) ? std::string::npos : line.rfind('\t', tab3 - 1);
+        size_t tab1 = (tab2 == std::string::npos || tab2 == 0) ? std::string::npos : line.rfind('\t', tab2 - 1);
+        if (header) {
+            header = false;
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos || line.substr(0, tab) != MANIFEST_MAGIC ||
+                atoi(line.c_str() + tab + 1) != MANIFEST_VERSION) {
+                FileLogger::GetInstance().LogWarning("[BackupManager] Manifest version mismatch, ignoring");
+                return;
             }
+            continue;
         }
+        if (tab1 == std::string::npos || tab1 == 0) {
+            continue;
+        }
+        ManifestRecord record;
+        record.size = strtoull(line.c_str() + tab1 + 1, nullptr, 10);
+        record.mtime = strtoll(line.c_str() + tab2 + 1, nullptr, 10);
+        record.crc = (uint32_t)strtoul(line.c_str() + tab3 + 1, nullptr, 16);
+        mManifest[line.substr(0, tab1)] = record;
     }
-    closedir(dir);
+    FileLogger::GetInstance().LogInfo("[BackupManager] Manifest has %zu files", mManifest.size());
 }
 
-bool BackupManager::UpdateScan() {
-    if (mPendingScans.empty()) {
-        // 扫描完成
-        mIsScanning = false;
+bool BackupManager::SaveManifest(bool complete) {
+    // 没有完成时 (取消或出错) 还没处理到的文件保留上一次的记录
+    std::map<std::string, ManifestRecord> records;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        records = complete ? mNewManifest : mManifest;
+        if (!complete) {
+            for (const auto& pair : mNewManifest) {
+                records[pair.first] = pair.second;
+            }
+        }
+    }
+
+    std::string content = std::string(MANIFEST_MAGIC) + "\t" + std::to_string(MANIFEST_VERSION) + "\n";
+    char fields[64];
+    for (const auto& pair : records) {
+        snprintf(fields, sizeof(fields), "\t%llu\t%lld\t%08x\n", (unsigned long long)pair.second.size,
+                 (long long)pair.second.mtime, (unsigned)pair.second.crc);
+        content += pair.first + fields;
+    }
+
+    std::string path = mBackupPath + "/" + MANIFEST_FILE;
+    std::string tempPath = path + ".tmp";
+    FileIO file;
+    if (!file.Open(tempPath, FileIO::MODE_WRITE) || !file.Write(content.data(), content.size()) || !file.Close()) {
+        file.Close();
+        remove(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[BackupManager] Failed to write manifest: %s", tempPath.c_str());
         return false;
     }
-    
-    // 每帧只处理一个目录
-    ScanEntry entry = mPendingScans.front();
-    mPendingScans.pop();
-    mScannedDirs++;  // 增加已扫描目录计数
-    
-    DIR* dir = opendir(entry.srcPath.c_str());
-    if (!dir) return true;
+    remove(path.c_str());
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[BackupManager] Failed to save manifest");
+        return false;
+    }
+    return true;
+}
 
-    struct dirent* dp;
-    while ((dp = readdir(dir)) != nullptr) {
-        std::string name = dp->d_name;
-        if (name == "." || name == "..") continue;
+bool BackupManager::IsUnchanged(const CopyJob& job) const {
+    auto it = mManifest.find(job.relativePath);
+    if (it == mManifest.end() || it->second.size != job.record.size || it->second.mtime != job.record.mtime) {
+        return false;
+    }
+    struct stat st;
+    return stat(job.dstPath.c_str(), &st) == 0 && (uint64_t)st.st_size == it->second.size;
+}
 
-        std::string fullSrcPath = entry.srcPath + "/" + name;
-        std::string fullDstPath = entry.dstPath + "/" + name;
-        
-        struct stat filestat;
-        if (stat(fullSrcPath.c_str(), &filestat) == 0) {
-            bool isDir = (filestat.st_mode & S_IFMT) == S_IFDIR;
-            
-            if (isDir) {
-                // 添加子目录到扫描队列（下一帧处理）
-                mPendingScans.push(ScanEntry(fullSrcPath, fullDstPath));
-            } else {
-                if (mIsSelectiveScan) {
-                    // 选择性备份：检查SD卡中是否存在同名文件
-                    std::string relativePath = fullSrcPath;
-                    if (relativePath.length() > mSourcePath.length()) {
-                        relativePath = relativePath.substr(mSourcePath.length());
-                    }
-                    std::string sdPath = mSdSourceBasePath + relativePath;
-                    
-                    struct stat sdStat;
-                    if (stat(sdPath.c_str(), &sdStat) == 0) {
-                        bool sdIsFile = (sdStat.st_mode & S_IFMT) != S_IFDIR;
-                        if (sdIsFile) {
-                            // SD卡中存在同名文件，需要备份
-                            mPendingFiles.push(FileEntry(fullSrcPath, false));
-                            mTotalItems++;
-                        }
-                    }
-                } else {
-                    // 全量备份：添加所有文件
-                    mPendingFiles.push(FileEntry(fullSrcPath, false));
-                    mTotalItems++;
-                }
+std::string BackupManager::GetCurrentFile() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCurrentFile;
+}
+
+void BackupManager::Fail(const std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mError.empty()) {
+            mError = error;
+        }
+    }
+    FileLogger::GetInstance().LogError("[BackupManager] %s", error.c_str());
+    mStop = true;
+    mCv.notify_all();
+    mScanCv.notify_all();
+    mPauseCv.notify_all();
+}
+
+void BackupManager::WaitWhilePaused() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mPauseCv.wait(lock, [this] { return !mPaused || mStop; });
+}
+
+void BackupManager::ScanThread() {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_BACKUP);
+    // 扫描、复制和写入线程都在这个线程结束之前结束
+    JobSystem::HeavyWorkScope heavyWork;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; mMode != MODE_VERIFY && i < COPY_THREADS; i++) {
+        workers.emplace_back(&BackupManager::CopyThread, this);
+    }
+
+    // 空间检查: 扫描和复制同时进行, 要复制的字节数一超过开始时的剩余空间就停止, 不等复制到写满
+    // 备份中已有的旧版本 (清单中的大小) 会被覆盖, 只算差额
+    mFreeBytes = 0;
+    mNeededBytes = 0;
+    mCheckSpace = mMode != MODE_VERIFY && FileIO::GetFreeSpace(mBackupPath, mFreeBytes);
+
+    // 几个扫描线程共用一个按层的目录队列, 扫到的文件立即交给复制线程
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPendingDirs.clear();
+        mPendingDirs.emplace_back(mSourcePath, mBackupPath);
+        mActiveScanners = 0;
+    }
+    std::vector<std::thread> scanners;
+    for (unsigned i = 1; i < SCAN_THREADS; i++) {
+        scanners.emplace_back(&BackupManager::ScanWorker, this);
+    }
+    ScanWorker();
+    for (std::thread& scanner : scanners) {
+        scanner.join();
+    }
+
+    mIsScanning = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mScanDone = true;
+    }
+    mCv.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (mMode == MODE_VERIFY) {
+        // 备份中有、源目录里已经没有的文件也算不一致
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& pair : mManifest) {
+            if (!mStop && !mNewManifest.count(pair.first)) {
+                mMismatchedItems++;
             }
         }
+        FileLogger::GetInstance().LogInfo("[BackupManager] Verified %d files, %d mismatched",
+                                          mTotalItems.load(), mMismatchedItems.load());
+    } else if (mMode == MODE_ARCHIVE) {
+        // 没有完成的容器不保留 (上一次的容器在新容器写好之前一直有效)
+        if (mStop) {
+            mArchive.Abort();
+        } else if (!mArchive.Finish()) {
+            Fail("写入备份文件失败: " + mBackupPath);
+        }
+        FileLogger::GetInstance().LogInfo("[BackupManager] Archived %d/%d files",
+                                          mProcessedItems.load(), mTotalItems.load());
+    } else {
+        SaveManifest(!mStop);
+        FileLogger::GetInstance().LogInfo("[BackupManager] Copied %d/%d files (%d unchanged)",
+                                          mProcessedItems.load(), mTotalItems.load(), mSkippedItems.load());
     }
-    closedir(dir);
-    
-    return true;
+    mFinished = true;
 }
 
-void BackupManager::ScanDirectorySelective(const std::string& mlcPath, const std::string& sdSourcePath, const std::string& backupPath) {
-    DIR* dir = opendir(mlcPath.c_str());
-    if (!dir) return;
+void BackupManager::ScanWorker() {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_BACKUP);
+    while (true) {
+        WaitWhilePaused();
+        std::string srcDir, dstDir;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            // 队列空了但还有线程在扫描时等待, 它可能再放入子目录
+            mScanCv.wait(lock, [this] { return mStop || !mPendingDirs.empty() || mActiveScanners == 0; });
+            if (mStop || mPendingDirs.empty()) {
+                mScanCv.notify_all();
+                return;
+            }
+            srcDir = std::move(mPendingDirs.front().first);
+            dstDir = std::move(mPendingDirs.front().second);
+            mPendingDirs.pop_front();
+            mActiveScanners++;
+        }
+
+        std::vector<std::pair<std::string, std::string>> subdirs;
+        ScanDirectory(srcDir, dstDir, subdirs);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto& subdir : subdirs) {
+                mPendingDirs.push_back(std::move(subdir));
+            }
+            mActiveScanners--;
+        }
+        mScanCv.notify_all();
+    }
+}
 
+void BackupManager::ScanDirectory(const std::string& srcDir, const std::string& dstDir,
+                                  std::vector<std::pair<std::string, std::string>>& subdirs) {
+    mScannedDirs++;
+    DIR* dir = opendir(srcDir.c_str());
+    if (!dir) {
+        return;
+    }
+    std::vector<CopyJob> jobs;
+    uint64_t neededBytes = 0;
     struct dirent* dp;
-    while ((dp = readdir(dir)) != nullptr) {
+    while ((dp = readdir(dir)) != nullptr && !mStop) {
         std::string name = dp->d_name;
         if (name == "." || name == "..") continue;
 
-        std::string fullMlcPath = mlcPath + "/" + name;
-        std::string fullSdPath = sdSourcePath + "/" + name;
-        std::string fullBackupPath = backupPath + "/" + name;
-        
-        struct stat mlcStat;
-        if (stat(fullMlcPath.c_str(), &mlcStat) == 0) {
-            bool isDir = (mlcStat.st_mode & S_IFMT) == S_IFDIR;
-            
-            if (isDir) {
-                // 递归扫描子目录
-                ScanDirectorySelective(fullMlcPath, fullSdPath, fullBackupPath);
-            } else {
-                // 检查SD卡中是否存在同名文件（且也是文件，不是目录）
-                struct stat sdStat;
-                if (stat(fullSdPath.c_str(), &sdStat) == 0) {
-                    bool sdIsFile = (sdStat.st_mode & S_IFMT) != S_IFDIR;
-                    if (sdIsFile) {
-                        // SD卡中存在同名文件，说明会被覆盖，需要备份MLC中的文件
-                        mPendingFiles.push(FileEntry(fullMlcPath, false));
-                        mTotalItems++;
-                    }
-                }
+        std::string fullSrcPath = srcDir + "/" + name;
+        std::string fullDstPath = dstDir + "/" + name;
+
+        // 目录直接按 d_type 判断, 不用 stat; 类型未知时才 stat
+        struct stat filestat;
+        bool haveStat = false;
+        if (dp->d_type == DT_DIR) {
+            subdirs.emplace_back(fullSrcPath, fullDstPath);
+            continue;
+        }
+        if (dp->d_type == DT_UNKNOWN) {
+            if (stat(fullSrcPath.c_str(), &filestat) != 0) {
+                continue;
+            }
+            haveStat = true;
+            if (S_ISDIR(filestat.st_mode)) {
+                subdirs.emplace_back(fullSrcPath, fullDstPath);
+                continue;
             }
         }
+
+        std::string relativePath = fullSrcPath.substr(mSourcePath.length());
+        if (mMode == MODE_SELECTIVE) {
+            // 选择性备份：SD卡中存在同名文件 (且不是目录) 才会被覆盖, 需要备份 (先检查, 不需要的文件不 stat)
+            struct stat sdStat;
+            std::string sdPath = mSdSourceBasePath + relativePath;
+            if (stat(sdPath.c_str(), &sdStat) != 0 || S_ISDIR(sdStat.st_mode)) {
+                continue;
+            }
+        }
+        // 清单要记录大小和修改时间
+        if (!haveStat && stat(fullSrcPath.c_str(), &filestat) != 0) {
+            continue;
+        }
+        if (!relativePath.empty() && relativePath[0] == '/') {
+            relativePath = relativePath.substr(1);
+        }
+        CopyJob job{fullSrcPath, fullDstPath, relativePath, ManifestRecord()};
+        job.record.size = (uint64_t)filestat.st_size;
+        job.record.mtime = (int64_t)filestat.st_mtime;
+
+        // 没有变化的文件不再复制, 沿用清单中的记录 (校验时只统计不一致的文件)
+        mTotalItems++;
+        if (mMode != MODE_ARCHIVE && IsUnchanged(job)) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mNewManifest[relativePath] = mManifest.at(relativePath);
+            mSkippedItems++;
+            mProcessedItems++;
+        } else if (mMode == MODE_VERIFY) {
+            FileLogger::GetInstance().LogInfo("[BackupManager] Changed since backup: %s", relativePath.c_str());
+            std::lock_guard<std::mutex> lock(mMutex);
+            mNewManifest[relativePath] = job.record;  // 只用来记下见过的文件
+            mMismatchedItems++;
+            mProcessedItems++;
+        } else {
+            auto previous = mManifest.find(relativePath);
+            uint64_t existing = previous != mManifest.end() ? previous->second.size : 0;
+            if (job.record.size > existing) {
+                neededBytes += job.record.size - existing;
+            }
+            jobs.push_back(std::move(job));
+        }
     }
     closedir(dir);
-}
 
-bool BackupManager::UpdateBackup() {
-    if (!mIsBackupInProgress) {
-        return false;
+    if (jobs.empty() || mStop) {
+        return;
     }
-    
-    // 如果正在扫描，继续扫描
-    if (mIsScanning) {
-        UpdateScan();
-        return true;  // 继续扫描
+    bool noSpace;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNeededBytes += neededBytes;
+        noSpace = mCheckSpace && mNeededBytes > mFreeBytes;
     }
-    
-    // 如果正在复制文件，继续复制
-    if (mIsCopyingFile) {
-        if (!ContinueFileCopy()) {
-            if (mErrorCallback) {
-                mErrorCallback("备份文件失败");
+    if (noSpace) {
+        FileLogger::GetInstance().LogError("[BackupManager] Backup needs more than %llu free bytes",
+                                           (unsigned long long)mFreeBytes);
+        Fail("SD卡空间不足: " + mBackupPath);
+        return;
+    }
+    // 目标目录在交出文件之前创建, 复制线程不用再检查 (容器备份不需要目录)
+    if (mMode != MODE_ARCHIVE && !Utils::CreateSubfolder(dstDir)) {
+        Fail("创建备份父目录失败: " + dstDir);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (CopyJob& job : jobs) {
+            mPendingFiles.push_back(std::move(job));
+        }
+    }
+    mCv.notify_all();
+}
+
+void BackupManager::CopyThread() {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_BACKUP);
+    // 对齐的缓冲区可以直接交给 FSA 传输
+    FileIO::Buffer buffers[2];
+    while (true) {
+        WaitWhilePaused();
+        CopyJob job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCv.wait(lock, [this] { return mStop || !mPendingFiles.empty() || mScanDone; });
+            if (mStop || mPendingFiles.empty()) {
+                return;
             }
-            mIsBackupInProgress = false;
-            return false;
+            job = std::move(mPendingFiles.front());
+            mPendingFiles.pop_front();
+            mCurrentFile = job.relativePath;
         }
-        
-        // 如果文件复制完成
-        if (!mIsCopyingFile) {
-            mProcessedItems++;
-            if (mProgressCallback) {
-                mProgressCallback(mProcessedItems, mTotalItems, mCurrentFile);
+
+        // 每个复制线程两个缓冲区, 大小按内存档位
+        if (buffers[0].size() == 0) {
+            buffers[0].resize(PerfProfile::GetCopyBufferSize());
+        }
+        bool copied = mMode == MODE_ARCHIVE ? ArchiveFile(job, buffers) : CopyFile(job, buffers);
+        if (!copied) {
+            // 不留下复制了一半的文件
+            if (mMode != MODE_ARCHIVE) {
+                remove(job.dstPath.c_str());
             }
+            if (!mStop) {
+                Fail("备份文件失败: " + job.srcPath);
+            }
+            return;
         }
-        return true;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mNewManifest[job.relativePath] = job.record;
+        }
+        mProcessedItems++;
     }
-    
-    // 处理下一个文件
-    if (mPendingFiles.empty()) {
-        // 备份完成
-        mIsBackupInProgress = false;
+}
+
+bool BackupManager::CopyFile(CopyJob& job, FileIO::Buffer* buffers) {
+    Trace::Span span("backup", "copy", job.relativePath);
+    FileIO src, dst;
+    if (!src.Open(job.srcPath, FileIO::MODE_READ)) {
         return false;
     }
-    
-    FileEntry entry = mPendingFiles.front();
-    mPendingFiles.pop();
-    
-    // 计算目标路径
-    std::string relativePath = entry.path;
-    if (relativePath.length() > mSourcePath.length()) {
-        relativePath = relativePath.substr(mSourcePath.length());
-    }
-    std::string dstPath = mBackupPath + relativePath;
-    
-    // 更新当前文件
-    if (relativePath.length() > 0 && (relativePath[0] == '/' || relativePath[0] == '\\')) {
-        mCurrentFile = relativePath.substr(1);
-    } else {
-        mCurrentFile = relativePath;
-    }
-    
-    // 确保父目录存在
-    size_t lastSlash = dstPath.find_last_of("/\\");
-    if (lastSlash != std::string::npos) {
-        std::string parentDir = dstPath.substr(0, lastSlash);
-        if (!Utils::CreateSubfolder(parentDir)) {
-            if (mErrorCallback) {
-                mErrorCallback("创建备份父目录失败: " + parentDir);
-            }
-            mIsBackupInProgress = false;
-            return false;
-        }
+    uint64_t size = src.Size();
+    if (!dst.Open(job.dstPath, FileIO::MODE_WRITE)) {
+        return false;
     }
-    
-    // 开始复制文件
-    if (!StartFileCopy(entry.path, dstPath)) {
-        if (mErrorCallback) {
-            mErrorCallback("备份文件失败: " + entry.path);
+
+    // 小文件: 整个读入, 一次写出
+    if (size <= buffers[0].size()) {
+        size_t total = 0;
+        size_t n;
+        while (total < size && (n = src.Read(buffers[0].data() + total, (size_t)size - total)) > 0) {
+            total += n;
         }
-        mIsBackupInProgress = false;
+        job.record.crc = (uint32_t)crc32(0, buffers[0].data(), (uInt)total);
+        bool ok = total == size && (size == 0 || dst.Write(buffers[0].data(), total));
+        return dst.Close() && ok;
+    }
+
+    // 大文件: 两个缓冲区轮流使用, 本线程读, 写入线程写; 先一次分配好整个文件的空间
+    if (!dst.Reserve(size)) {
         return false;
     }
-    
-    return true;
-}
+    if (buffers[1].size() == 0) {
+        buffers[1].resize(PerfProfile::GetCopyBufferSize());
+    }
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t lengths[2] = {0, 0};
+    bool filled[2] = {false, false};
+    bool readDone = false;
+    bool writeFailed = false;
 
-void BackupManager::CancelBackup() {
-    EndFileCopy();
-    mIsBackupInProgress = false;
-    while (!mPendingFiles.empty()) {
-        mPendingFiles.pop();
+    std::thread writer([&]() {
+        for (int i = 0;; i ^= 1) {
+            size_t length;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return filled[i] || readDone; });
+                if (!filled[i]) {
+                    return;
+                }
+                length = lengths[i];
+            }
+            if (!dst.Write(buffers[i].data(), length)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                writeFailed = true;
+                cv.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            filled[i] = false;
+            cv.notify_all();
+        }
+    });
+
+    uint64_t copied = 0;
+    uLong crc = crc32(0, nullptr, 0);
+    for (int i = 0; copied < size && !mStop; i ^= 1) {
+        WaitWhilePaused();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return !filled[i] || writeFailed; });
+            if (writeFailed) {
+                break;
+            }
+        }
+        size_t n = src.Read(buffers[i].data(), buffers[i].size());
+        if (n == 0) {
+            break;
+        }
+        copied += n;
+        crc = crc32(crc, buffers[i].data(), (uInt)n);
+        std::lock_guard<std::mutex> lock(mutex);
+        lengths[i] = n;
+        filled[i] = true;
+        cv.notify_all();
     }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readDone = true;
+        cv.notify_all();
+    }
+    writer.join();
+
+    job.record.crc = (uint32_t)crc;
+    bool ok = !writeFailed && copied == size;
+    return dst.Close() && ok;
 }
 
-bool BackupManager::StartFileCopy(const std::string& srcPath, const std::string& dstPath) {
-    // 打开源文件
-    mCopySourceFile = fopen(srcPath.c_str(), "rb");
-    if (!mCopySourceFile) {
+bool BackupManager::ArchiveFile(CopyJob& job, FileIO::Buffer* buffers) {
+    Trace::Span span("backup", "archive", job.relativePath);
+    FileIO src;
+    if (!src.Open(job.srcPath, FileIO::MODE_READ)) {
         return false;
     }
-    
-    // 获取文件大小
-    fseek(mCopySourceFile, 0, SEEK_END);
-    mCopyFileSize = ftell(mCopySourceFile);
-    fseek(mCopySourceFile, 0, SEEK_SET);
-    
-    // 打开目标文件
-    mCopyDestFile = fopen(dstPath.c_str(), "wb");
-    if (!mCopyDestFile) {
-        fclose(mCopySourceFile);
-        mCopySourceFile = nullptr;
-        return false;
+    uint64_t size = src.Size();
+
+    // 小文件: 整个读入, 在本线程压缩, 追加到容器时才加锁
+    if (size <= buffers[0].size()) {
+        size_t total = 0;
+        size_t n;
+        while (total < size && (n = src.Read(buffers[0].data() + total, (size_t)size - total)) > 0) {
+            total += n;
+        }
+        return total == size &&
+               mArchive.AddBuffer(job.relativePath, job.record.mtime, buffers[0].data(), total, job.record.crc);
     }
-    
-    mCopyFileCopied = 0;
-    mIsCopyingFile = true;
-    return true;
+
+    // 大文件: 持有容器的写入锁边读边写, 其它线程的小文件等它写完
+    return mArchive.AddFile(job.relativePath, job.record.mtime, src, buffers[0], job.record.crc, &mStop);
 }
 
-bool BackupManager::ContinueFileCopy() {
-    if (!mIsCopyingFile || !mCopySourceFile || !mCopyDestFile) {
+bool BackupManager::UpdateBackup() {
+    if (!mIsBackupInProgress) {
         return false;
     }
-    
-    // 每次复制 256KB
-    const size_t CHUNK_SIZE = 256 * 1024;
-    char buffer[CHUNK_SIZE];
-    
-    size_t bytesRead = fread(buffer, 1, CHUNK_SIZE, mCopySourceFile);
-    if (bytesRead > 0) {
-        size_t bytesWritten = fwrite(buffer, 1, bytesRead, mCopyDestFile);
-        if (bytesWritten != bytesRead) {
-            EndFileCopy();
-            return false;
+
+    // 后台线程完成的文件数变化时报告进度 (一帧内完成的多个文件合并报告一次)
+    int processed = mProcessedItems;
+    if (processed != mReportedItems) {
+        mReportedItems = processed;
+        if (mProgressCallback) {
+            mProgressCallback(processed, mTotalItems, GetCurrentFile());
         }
-        mCopyFileCopied += bytesRead;
     }
-    
-    // 检查是否复制完成
-    if (mCopyFileCopied >= mCopyFileSize || feof(mCopySourceFile)) {
-        EndFileCopy();
+
+    if (!mFinished) {
         return true;
     }
-    
-    return true;
-}
 
-void BackupManager::EndFileCopy() {
-    if (mCopySourceFile) {
-        fclose(mCopySourceFile);
-        mCopySourceFile = nullptr;
+    mThread.join();
+    mIsBackupInProgress = false;
+    std::string error;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        error = mError;
     }
-    if (mCopyDestFile) {
-        fclose(mCopyDestFile);
-        mCopyDestFile = nullptr;
+    if (!error.empty() && mErrorCallback) {
+        mErrorCallback(error);
     }
-    mIsCopyingFile = false;
-    mCopyFileSize = 0;
-    mCopyFileCopied = 0;
+    return false;
+}
+
+void BackupManager::StopThreads() {
+    if (mThread.joinable()) {
+        mStop = true;
+        mCv.notify_all();
+        mScanCv.notify_all();
+        mPauseCv.notify_all();
+        mThread.join();
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPendingFiles.clear();
+}
+
+void BackupManager::CancelBackup() {
+    StopThreads();
+    mIsBackupInProgress = false;
+    mIsScanning = false;
 }
@@ -1,15 +1,30 @@
 #pragma once
 #include <string>
-#include <queue>
+#include <deque>
+#include <vector>
+#include <map>
+#include <cstdint>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "FileIO.hpp"
+#include "BackupArchive.hpp"
 
+// 备份在后台线程上进行: 几个扫描线程共用一个目录队列逐层扫描 (目录按 d_type 判断, 只有文件才 stat),
+// 扫到的文件立即交给几个复制线程, 扫描和复制同时进行
+// 不超过一个缓冲区的文件 (绝大多数) 一次读入内存再一次写出; 大文件用两个缓冲区,
+// 读下一块的同时由写入线程写出上一块
+// UI 线程只需每帧调用 UpdateBackup 读取进度, 回调都在 UpdateBackup 中调用
+// 备份目录中的清单 (MANIFEST_FILE) 记录每个文件的相对路径、大小、修改时间和 CRC32:
+// 再次备份到同一目录时, 大小和修改时间都没变、备份中的文件也还在的文件不再复制
+// 进入后台时 (AppLifecycle) 扫描和复制线程在下一个目录、文件或数据块之前停下, 回到前台时继续
 class BackupManager {
 public:
-    struct FileEntry {
-        std::string path;
-        bool isDirectory;
-        FileEntry(const std::string& p, bool isDir) : path(p), isDirectory(isDir) {}
-    };
+    static constexpr unsigned COPY_THREADS = 3;
+    static constexpr unsigned SCAN_THREADS = 2;   // 扫描主要在等文件系统, 两个线程同时 stat
+    static constexpr const char* MANIFEST_FILE = "backup_manifest.txt";
 
     // 备份回调函数类型
     using ProgressCallback = std::function<void(int current, int total, const std::string& currentFile)>;
@@ -20,77 +35,129 @@ public:
 
     // 开始备份（扫描文件）
     bool StartBackup(const std::string& sourcePath, const std::string& backupPath);
-    
+
     // 开始选择性备份（只备份将被SD卡文件覆盖的MLC文件）
     bool StartSelectiveBackup(const std::string& mlcPath, const std::string& sdSourcePath, const std::string& backupPath);
-    
-    // 更新备份进度（每帧调用一次）
+
+    // 开始容器备份: 所有文件压缩后顺序写入 backupPath 下的一个 BackupArchive::FILE_NAME
+    // 每次都完整写一遍 (不使用清单), 恢复用 BackupArchive::ExtractAll
+    bool StartArchiveBackup(const std::string& sourcePath, const std::string& backupPath);
+
+    // 按清单检查备份是否和源目录一致: 只比较大小和修改时间, 不读取文件内容
+    // 完成后 GetMismatchedItems 为有变化或备份中缺少的文件数
+    bool StartVerify(const std::string& sourcePath, const std::string& backupPath);
+
+    // 更新备份进度（每帧调用一次, 只读取后台线程的进度）
     // 返回值：true = 继续进行中，false = 已完成
     bool UpdateBackup();
-    
-    // 取消备份
+
+    // 取消备份 (等待后台线程停止, 复制了一半的文件会删除)
     void CancelBackup();
-    
+
     // 获取备份状态
     bool IsBackupInProgress() const { return mIsBackupInProgress; }
     bool IsScanning() const { return mIsScanning; }
     int GetTotalItems() const { return mTotalItems; }
     int GetProcessedItems() const { return mProcessedItems; }
     int GetScannedDirs() const { return mScannedDirs; }  // 已扫描的目录数
-    std::string GetCurrentFile() const { return mCurrentFile; }
-    
+    int GetSkippedItems() const { return mSkippedItems; }        // 没有变化、不用复制的文件数 (计入已处理)
+    int GetMismatchedItems() const { return mMismatchedItems; }  // 校验时不一致的文件数
+    std::string GetCurrentFile() const;
+
     // 设置回调
     void SetProgressCallback(ProgressCallback callback) { mProgressCallback = callback; }
     void SetErrorCallback(ErrorCallback callback) { mErrorCallback = callback; }
 
 private:
-    // 异步扫描目录（每帧处理一个目录）
-    bool UpdateScan();
-    
-    // 扫描目录
-    void ScanDirectory(const std::string& srcPath, const std::string& dstPath);
-    
-    // 选择性扫描：只添加SD卡中存在的MLC文件
-    void ScanDirectorySelective(const std::string& mlcPath, const std::string& sdSourcePath, const std::string& backupPath);
-    
-    // 开始文件复制
-    bool StartFileCopy(const std::string& srcPath, const std::string& dstPath);
-    
-    // 继续文件复制（分块）
-    bool ContinueFileCopy();
-    
-    // 结束文件复制
-    void EndFileCopy();
-
-    std::queue<FileEntry> mPendingFiles;
-    std::string mCurrentFile;
-    int mTotalItems;
-    int mProcessedItems;
-    int mScannedDirs;  // 已扫描的目录数量
-    bool mIsBackupInProgress;
-    bool mIsScanning;
-    
-    // 异步扫描状态
-    struct ScanEntry {
+    // 清单中的一个文件
+    struct ManifestRecord {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint32_t crc = 0;
+    };
+
+    // 一个要复制的文件
+    struct CopyJob {
         std::string srcPath;
         std::string dstPath;
-        ScanEntry(const std::string& src, const std::string& dst) : srcPath(src), dstPath(dst) {}
+        std::string relativePath;  // 清单的键, 也用于显示; 不以 '/' 开头
+        ManifestRecord record;     // 源文件的大小和修改时间, CRC32 在复制时计算
     };
-    std::queue<ScanEntry> mPendingScans;
-    bool mIsSelectiveScan;
-    std::string mSdSourceBasePath;  // 用于选择性扫描
-    
-    // 文件复制状态
-    FILE* mCopySourceFile;
-    FILE* mCopyDestFile;
-    long mCopyFileSize;
-    long mCopyFileCopied;
-    bool mIsCopyingFile;
-    
+
+    enum Mode {
+        MODE_FULL,
+        MODE_SELECTIVE,
+        MODE_VERIFY,
+        MODE_ARCHIVE
+    };
+
+    bool Start(const std::string& sourcePath, const std::string& backupPath, Mode mode);
+    void LoadManifest();
+    bool SaveManifest(bool complete);
+    // 清单中有记录且大小和修改时间都没变, 备份中的文件也在
+    bool IsUnchanged(const CopyJob& job) const;
+    void StopThreads();
+    void Fail(const std::string& error);  // 记下第一个错误并停止
+    void WaitWhilePaused();               // 后台线程在处理下一个目录、文件或数据块之前调用
+
+    // 扫描线程: 启动复制线程和其它扫描线程, 自己也扫描, 全部结束后保存清单
+    void ScanThread();
+    // 从目录队列取目录扫描, 队列空了并且没有线程在扫描时返回
+    void ScanWorker();
+    // 扫描一个目录: 文件交给复制线程, 子目录放进 subdirs
+    void ScanDirectory(const std::string& srcDir, const std::string& dstDir,
+                       std::vector<std::pair<std::string, std::string>>& subdirs);
+    // 复制线程
+    void CopyThread();
+    bool CopyFile(CopyJob& job, FileIO::Buffer* buffers);
+    // 容器备份时代替 CopyFile: 小文件读入内存后压缩, 大文件边读边压缩写入容器
+    bool ArchiveFile(CopyJob& job, FileIO::Buffer* buffers);
+
     std::string mSourcePath;
     std::string mBackupPath;
-    
+    std::string mSdSourceBasePath;  // 用于选择性扫描
+    Mode mMode;
+
+    // 只在 UI 线程访问
+    bool mIsBackupInProgress;
+    int mReportedItems;
+    std::thread mThread;
+
+    // 后台线程更新, UI 线程读取
+    std::atomic<int> mTotalItems;
+    std::atomic<int> mProcessedItems;
+    std::atomic<int> mScannedDirs;  // 已扫描的目录数量
+    std::atomic<int> mSkippedItems;
+    std::atomic<int> mMismatchedItems;
+    std::atomic<bool> mIsScanning;
+    std::atomic<bool> mFinished;    // 扫描线程和所有复制线程都已结束
+    std::atomic<bool> mStop;        // 取消或出错
+
+    // 由 mMutex 保护
+    mutable std::mutex mMutex;
+    std::condition_variable mCv;
+    std::deque<CopyJob> mPendingFiles;
+    bool mScanDone;
+    std::condition_variable mScanCv;
+    bool mPaused;                 // 在后台
+    std::condition_variable mPauseCv;
+    std::deque<std::pair<std::string, std::string>> mPendingDirs;  // 等待扫描的 (源目录, 备份目录)
+    unsigned mActiveScanners;     // 正在扫描目录的线程数
+    bool mCheckSpace;             // 能查到剩余空间, 下面两个值有效
+    uint64_t mFreeBytes;
+    uint64_t mNeededBytes;        // 已经交给复制线程的文件还要占用的空间
+    std::string mCurrentFile;
+    std::string mError;
+    std::map<std::string, ManifestRecord> mNewManifest;  // 这次复制或确认没变的文件
+
+    BackupArchive mArchive;       // MODE_ARCHIVE 时写入的容器
+
+    // 上一次的清单, 开始后只读
+    std::map<std::string, ManifestRecord> mManifest;
+
     // 回调函数
     ProgressCallback mProgressCallback;
     ErrorCallback mErrorCallback;
+
+    int mLifecycleListener;
 };
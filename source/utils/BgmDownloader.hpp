@@ -2,11 +2,9 @@
 
 #include <string>
 #include <functional>
-#include <atomic>
-#include <mutex>
-#include <thread>
-#include <curl/curl.h>
-#include <cstdio>
+#include "ProgressChannel.hpp"
+
+struct DownloadOperation;
 
 // BGM下载状态
 enum BgmDownloadState {
@@ -17,7 +15,7 @@ enum BgmDownloadState {
     BGM_CANCELLED
 };
 
-// BGM下载器 - 后台线程下载防止阻塞
+// BGM下载器 - 交给共享的 DownloadQueue 在后台下载, 优先级最低, 不和缩略图抢连接
 class BgmDownloader {
 public:
     static BgmDownloader& GetInstance();
@@ -28,20 +26,20 @@ public:
     // 取消下载
     void Cancel();
     
-    // 每帧更新 - 检查下载状态
+    // 每帧更新 - 下载中处理下载队列, 完成回调在这里执行
     void Update();
     
     // 状态查询
     BgmDownloadState GetState() const { return mState; }
-    float GetProgress() const { return mProgress; }
+    float GetProgress() const;
     const std::string& GetError() const { return mErrorMessage; }
     bool IsDownloading() const { return mState == BGM_DOWNLOADING; }
     
     // 获取下载信息
-    long GetDownloadedBytes() const { return mDownloadedBytes; }
-    long GetTotalBytes() const { return mTotalBytes; }
+    long GetDownloadedBytes() const;
+    long GetTotalBytes() const;
     
-    // 回调设置 - 下载完成时触发
+    // 回调设置 - 下载完成时触发 (在主线程中)
     void SetCompletionCallback(std::function<void(bool success, const std::string& filepath)> callback);
     
 private:
@@ -50,25 +48,14 @@ private:
     BgmDownloader(const BgmDownloader&) = delete;
     BgmDownloader& operator=(const BgmDownloader&) = delete;
     
-    std::atomic<BgmDownloadState> mState;
-    std::atomic<float> mProgress;
-    std::atomic<long> mDownloadedBytes;
-    std::atomic<long> mTotalBytes;
-    std::atomic<bool> mCancelRequested;
-    
+    BgmDownloadState mState;
     std::string mErrorMessage;
-    std::string mCurrentUrl;
-    std::mutex mMutex;
     std::function<void(bool success, const std::string& filepath)> mCompletionCallback;
     
-    // 后台下载线程
-    std::thread mDownloadThread;
-    bool mThreadRunning;
-    
-    // 内部方法 - 在后台线程中运行
-    void PerformDownload();
+    DownloadOperation* mDownload;
+    ProgressChannel mProgress;   // 网络线程写入下载的字节数, 界面读取
     
-    // CURL进度回调
-    static int ProgressCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow, 
-                                curl_off_t ultotal, curl_off_t ulnow);
+    // 下载结束 (在主线程中)
+    void OnDownloadFinished(DownloadOperation* download);
+    void Fail(const std::string& message);
 };
@@ -0,0 +1,1583 @@
+#include "BpsStreamPatcher.hpp"
+#include "hips.hpp"
+#include "FileIO.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace {
+
+constexpr size_t READ_WINDOW = BpsStreamPatcher::READ_WINDOW;
+constexpr size_t TARGET_HISTORY = BpsStreamPatcher::TARGET_HISTORY;
+
+// 一次 Apply 的 I/O 线程: 按提交顺序执行预读和写入任务, 打补丁的线程只在需要结果时等待
+// 每个文件同一时间只由一方使用: 使用者在自己读写文件之前先等待它提交的任务完成
+class IoWorker {
+public:
+    IoWorker() {
+        mThread = std::thread(&IoWorker::ThreadFunc, this);
+    }
+
+    ~IoWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mTaskCv.notify_one();
+        mThread.join();
+    }
+
+    // 返回任务编号, 传给 Wait 等待它完成
+    uint64_t Submit(std::function<void()> task) {
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.push_back(std::move(task));
+            ticket = ++mSubmitted;
+        }
+        mTaskCv.notify_one();
+        return ticket;
+    }
+
+    // 任务按顺序执行, 编号为 0 表示没有任务
+    void Wait(uint64_t ticket) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDoneCv.wait(lock, [&]() { return mCompleted >= ticket; });
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mTaskCv;
+    std::condition_variable mDoneCv;
+    std::deque<std::function<void()>> mTasks;
+    uint64_t mSubmitted = 0;
+    uint64_t mCompleted = 0;
+    bool mStop = false;
+    std::thread mThread;
+
+    void ThreadFunc() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mTaskCv.wait(lock, [&]() { return mStop || !mTasks.empty(); });
+                if (mTasks.empty()) {
+                    return;
+                }
+                task = std::move(mTasks.front());
+                mTasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mCompleted++;
+            }
+            mDoneCv.notify_all();
+        }
+    }
+};
+
+// SourceWindow 读取的源数据: 源文件, 或者补丁链前面各层合成的结果 (ChainSource)
+// 只在一个线程上使用 (顺序窗口的预读在 I/O 线程上, 和使用者轮流进行)
+class SourceData {
+public:
+    virtual ~SourceData() = default;
+    virtual uint64_t Size() = 0;
+    // 返回读到的字节数, 少于 n 表示到了末尾或出错
+    virtual size_t ReadAt(uint64_t offset, uint8_t* dst, size_t n) = 0;
+};
+
+class FileSourceData : public SourceData {
+public:
+    explicit FileSourceData(FileIO& file) : mFile(file) {}
+    uint64_t Size() override { return mFile.Size(); }
+    size_t ReadAt(uint64_t offset, uint8_t* dst, size_t n) override { return mFile.ReadAt(offset, dst, n); }
+
+private:
+    FileIO& mFile;
+};
+
+// 预读的数据来源: 源数据按位置读取; 补丁流只能顺序读取, 它的预读总是首尾相接, at 就是流的当前位置
+size_t ReadBlock(SourceData* source, uint64_t at, uint8_t* dst, size_t n) {
+    return source->ReadAt(at, dst, n);
+}
+
+size_t ReadBlock(BpsStreamPatcher::PatchStream* stream, uint64_t, uint8_t* dst, size_t n) {
+    return stream->Read(dst, n);
+}
+
+// 在 I/O 线程上预读的下一块; crc 不为空时读完顺便累加 [at, crcLimit) 部分的 CRC32 (数据还在缓存里)
+struct Prefetch {
+    FileIO::Buffer data;
+    uint64_t offset = 0;
+    size_t len = 0;
+    uint64_t ticket = 0;
+    bool valid = false;
+
+    template <typename Source>
+    void Start(IoWorker& worker, Source* file, uint64_t at, uint64_t fileSize,
+               uint32_t* crc = nullptr, uint64_t crcLimit = 0) {
+        valid = at < fileSize;
+        if (!valid) {
+            return;
+        }
+        offset = at;
+        size_t want = (size_t)std::min<uint64_t>(data.size(), fileSize - at);
+        ticket = worker.Submit([this, file, at, want, crc, crcLimit]() {
+            len = ReadBlock(file, at, data.data(), want);
+            if (crc && at < crcLimit) {
+                *crc = Hips::Detail::crc32(data.data(), (size_t)std::min<uint64_t>(len, crcLimit - at), *crc);
+            }
+        });
+    }
+
+    // 等待未完成的预读 (之后才能自己使用这个文件或丢弃预读的数据)
+    void Finish(IoWorker& worker) {
+        if (valid) {
+            worker.Wait(ticket);
+        }
+    }
+};
+
+// 文件作为补丁流: 自己记录读取位置, 和之前对这个文件的 ReadAt 无关
+class FilePatchStream : public BpsStreamPatcher::PatchStream {
+public:
+    explicit FilePatchStream(FileIO& file) : mFile(file) {}
+
+    uint64_t Size() override { return mFile.Size(); }
+
+    size_t Read(void* dst, size_t n) override {
+        size_t got = mFile.ReadAt(mPos, dst, n);
+        mPos += got;
+        return got;
+    }
+
+private:
+    FileIO& mFile;
+    uint64_t mPos = 0;
+};
+
+// 顺序读取补丁, 位置超过文件末尾时读不到数据; 读完一块时下一块已经在预读
+// 各块首尾相接地读入 (Skip 也不跳过读取), 补丁自身的 CRC32 (不含最后 4 字节) 在预读时算出
+// 最后 12 字节 (三个 CRC32) 在块经过时留下, 整个补丁只从头到尾读一遍
+class PatchReader {
+public:
+    // computeCrc 为 false 时只是顺序读取 (重放 .ops 文件)
+    PatchReader(IoWorker& worker, BpsStreamPatcher::PatchStream& stream, uint64_t size, bool computeCrc = true)
+        : mWorker(worker), mStream(&stream), mSize(size), mBuffer(READ_WINDOW), mComputeCrc(computeCrc) {
+        mNext.data.resize(READ_WINDOW);
+        StartPrefetch(0);
+    }
+
+    ~PatchReader() {
+        mNext.Finish(mWorker);
+    }
+
+    uint64_t Tell() const { return mPos; }
+
+    bool ReadByte(uint8_t& byte) {
+        if (mPos >= BufferEnd() && !Refill()) {
+            return false;
+        }
+        byte = mBuffer[(size_t)(mPos - mBufferStart)];
+        mPos++;
+        return true;
+    }
+
+    // 返回实际读到的字节数, 位置总是前进 n (和内存版本一样, 读不到的部分当作 0)
+    size_t Read(uint8_t* dst, size_t n) {
+        size_t done = 0;
+        while (done < n) {
+            if (mPos >= BufferEnd() && !Refill()) {
+                break;
+            }
+            size_t chunk = (size_t)std::min<uint64_t>(n - done, BufferEnd() - mPos);
+            memcpy(dst + done, mBuffer.data() + (size_t)(mPos - mBufferStart), chunk);
+            mPos += chunk;
+            done += chunk;
+        }
+        if (done < n) {
+            mPos += n - done;
+        }
+        return done;
+    }
+
+    void Skip(uint64_t n) {
+        mPos += n;
+    }
+
+    // 和 Hips::BPS::readNumber 相同的编码, 数字越过 end 时返回 false
+    bool ReadNumber(uint64_t end, uint64_t& value) {
+        uint64_t ret = 0;
+        uint64_t shift = 1;
+        uint8_t byte;
+        while (mPos < end && ReadByte(byte)) {
+            ret += (byte & 0x7F) * shift;
+            if (byte & 0x80) {
+                value = ret;
+                return true;
+            }
+            shift <<= 7;
+            ret += shift;
+        }
+        return false;
+    }
+
+    // 读完剩下的部分, 返回补丁的 CRC32
+    uint32_t FinishCrc() {
+        while (BufferEnd() < mSize && NextBlock()) {
+        }
+        mNext.Finish(mWorker);
+        return mCrc;
+    }
+
+    // 补丁末尾的 n 字节 (不超过 TRAILER_SIZE), FinishCrc 之后才完整
+    bool ReadTrailer(uint8_t* dst, size_t n) {
+        if (n > TRAILER_SIZE || mTrailerHave < TRAILER_SIZE) {
+            return false;
+        }
+        memcpy(dst, mTrailer + TRAILER_SIZE - n, n);
+        return true;
+    }
+
+private:
+    static constexpr size_t TRAILER_SIZE = 12;
+
+    IoWorker& mWorker;
+    BpsStreamPatcher::PatchStream* mStream;
+    uint64_t mSize;
+    FileIO::Buffer mBuffer;
+    uint64_t mBufferStart = 0;
+    size_t mBufferLen = 0;
+    uint64_t mPos = 0;
+    bool mComputeCrc;
+    uint32_t mCrc = 0;      // 由预读任务更新, 等待预读完成后才能读
+    Prefetch mNext;
+    uint8_t mTrailer[TRAILER_SIZE];
+    size_t mTrailerHave = 0;
+
+    uint64_t BufferEnd() const { return mBufferStart + mBufferLen; }
+
+    void StartPrefetch(uint64_t at) {
+        mNext.Start(mWorker, mStream, at, mSize, mComputeCrc ? &mCrc : nullptr, mSize - 4);
+    }
+
+    // 把当前块中落在末尾 TRAILER_SIZE 字节内的部分留下
+    void KeepTrailer() {
+        if (mSize < TRAILER_SIZE) {
+            return;
+        }
+        uint64_t trailerStart = mSize - TRAILER_SIZE;
+        uint64_t from = std::max(trailerStart, mBufferStart);
+        if (from >= BufferEnd()) {
+            return;
+        }
+        size_t n = (size_t)(BufferEnd() - from);
+        memcpy(mTrailer + (from - trailerStart), mBuffer.data() + (size_t)(from - mBufferStart), n);
+        mTrailerHave = std::max(mTrailerHave, (size_t)(from - trailerStart) + n);
+    }
+
+    // 换入预读好的下一块并开始预读再下一块
+    bool NextBlock() {
+        if (!mNext.valid) {
+            return false;
+        }
+        mNext.Finish(mWorker);
+        mBuffer.swap(mNext.data);
+        mBufferStart = mNext.offset;
+        mBufferLen = mNext.len;
+        mNext.valid = false;
+        if (mBufferLen == 0) {
+            return false;
+        }
+        KeepTrailer();
+        StartPrefetch(BufferEnd());
+        return true;
+    }
+
+    bool Refill() {
+        while (mPos >= BufferEnd()) {
+            if (mPos >= mSize || !NextBlock()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// 随机读取源文件, 缓存一个窗口 (SourceRead 和 SourceCopy 各用一个, 各自打开文件, 互不冲刷)
+// sequential 为 true 时 (向前读取的 SourceRead) 在 I/O 线程上预读窗口之后的一块;
+// 同时要校验源文件时, 这些块首尾相接地覆盖整个文件 (跳过的部分也读), 预读时顺便算出 CRC32
+class SourceWindow {
+public:
+    SourceWindow(IoWorker& worker, SourceData& source, uint64_t size, bool sequential, uint64_t crcLimit = 0)
+        : mWorker(worker), mFile(&source), mSize(size), mBuffer(READ_WINDOW),
+          mSequential(sequential), mVerify(sequential && crcLimit > 0), mCrcLimit(crcLimit) {
+        if (mSequential) {
+            mNext.data.resize(READ_WINDOW);
+            StartPrefetch();
+        }
+    }
+
+    ~SourceWindow() {
+        mNext.Finish(mWorker);
+    }
+
+    // 从 offset 读取最多 n 字节, 返回读到的字节数 (0 表示已到文件末尾)
+    size_t Read(uint64_t offset, uint8_t* dst, size_t n) {
+        if (offset >= mSize || n == 0) {
+            return 0;
+        }
+        n = (size_t)std::min<uint64_t>(n, mSize - offset);
+
+        // 向前读: 换入预读的块. 校验时一直读到 offset 所在的块, 否则只接受紧接着的一块
+        if (!InWindow(offset) && mSequential && offset >= mChainEnd &&
+            (mVerify || offset < mChainEnd + READ_WINDOW)) {
+            while (!InWindow(offset) && NextBlock()) {
+            }
+        }
+
+        if (!InWindow(offset)) {
+            mNext.Finish(mWorker);
+            if (n >= mBuffer.size() && !mSequential) {
+                // 大块直接读到目标, 不经过窗口
+                return mFile->ReadAt(offset, dst, n);
+            }
+            mStart = offset;
+            mLen = mFile->ReadAt(offset, mBuffer.data(), (size_t)std::min<uint64_t>(mBuffer.size(), mSize - offset));
+            if (mLen == 0) {
+                return 0;
+            }
+            if (mSequential && !mVerify) {
+                // 不校验时预读从新位置接着开始; 校验时预读链保持不变
+                mNext.valid = false;
+                mChainEnd = mStart + mLen;
+                StartPrefetch();
+            }
+        }
+
+        size_t chunk = std::min(n, (size_t)(mStart + mLen - offset));
+        memcpy(dst, mBuffer.data() + (offset - mStart), chunk);
+        return chunk;
+    }
+
+    // 读完还没校验的部分, 返回源文件前 crcLimit 字节的 CRC32
+    uint32_t FinishCrc() {
+        while (mChainEnd < mCrcLimit && NextBlock()) {
+        }
+        mNext.Finish(mWorker);
+        return mCrc;
+    }
+
+private:
+    IoWorker& mWorker;
+    SourceData* mFile;
+    uint64_t mSize;
+    FileIO::Buffer mBuffer;
+    uint64_t mStart = 0;
+    size_t mLen = 0;
+    bool mSequential;
+    bool mVerify;
+    uint64_t mCrcLimit;
+    uint64_t mChainEnd = 0;  // 预读链已经读到的位置 (下一块从这里开始)
+    uint32_t mCrc = 0;       // 由预读任务更新
+    Prefetch mNext;
+
+    bool InWindow(uint64_t offset) const {
+        return offset >= mStart && offset < mStart + mLen;
+    }
+
+    void StartPrefetch() {
+        mNext.Start(mWorker, mFile, mChainEnd, mSize, mVerify ? &mCrc : nullptr, mCrcLimit);
+    }
+
+    bool NextBlock() {
+        if (!mNext.valid) {
+            return false;
+        }
+        mNext.Finish(mWorker);
+        mBuffer.swap(mNext.data);
+        mStart = mNext.offset;
+        mLen = mNext.len;
+        mNext.valid = false;
+        if (mLen == 0) {
+            return false;
+        }
+        mChainEnd = mStart + mLen;
+        StartPrefetch();
+        return true;
+    }
+};
+
+// 编译后的操作列表 (.ops): 文件头之后是 CompiledOp 记录, OP_LITERAL 记录后面紧跟数据 (补齐到 8 字节)
+// 偏移都是绝对位置, 越界和回绕已经在编译时展开成 OP_ZERO, 相邻且连续的同类操作合并成一条
+// 只在本机上读写, 按本机字节序保存
+constexpr char COMPILED_MAGIC[4] = {'U', 'T', 'O', 'P'};
+constexpr uint32_t COMPILED_VERSION = 1;
+constexpr size_t RECORD_BUFFER = 64 * 1024;
+
+enum : uint32_t {
+    OP_SOURCE = 1,   // 从源文件 offset 复制
+    OP_TARGET = 2,   // 从已生成的目标 offset 复制 (可能重叠)
+    OP_LITERAL = 3,  // 紧跟在记录后面的数据
+    OP_ZERO = 4
+};
+
+struct CompiledHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t patchCrc;
+    uint32_t sourceCrc;
+    uint32_t targetCrc;
+    uint32_t reserved;
+    uint64_t outputSize;
+    uint64_t opCount;
+};
+
+struct CompiledOp {
+    uint32_t type;
+    uint32_t length;
+    uint64_t offset;
+};
+
+static_assert(sizeof(CompiledHeader) == 40 && sizeof(CompiledOp) == 16, "compiled op layout");
+
+size_t LiteralPadding(size_t n) {
+    return (8 - (n & 7)) & 7;
+}
+
+// 打补丁时记录实际执行的操作, 写入 .ops 文件 (先写占位的文件头, 完成时回填)
+class OpRecorder {
+public:
+    explicit OpRecorder(FileIO& file) : mFile(file), mBuffer(RECORD_BUFFER) {
+        CompiledHeader header = {};
+        Append(&header, sizeof(header));
+    }
+
+    void Source(uint64_t offset, size_t n) { Emit(OP_SOURCE, offset, n); }
+    void Target(uint64_t offset, size_t n) { Emit(OP_TARGET, offset, n); }
+    void Zero(size_t n) { Emit(OP_ZERO, 0, n); }
+
+    void Literal(const uint8_t* data, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        FlushPending();
+        CompiledOp op = {OP_LITERAL, (uint32_t)n, 0};
+        Append(&op, sizeof(op));
+        Append(data, n);
+        static const uint8_t zeros[8] = {0};
+        Append(zeros, LiteralPadding(n));
+        mCount++;
+    }
+
+    bool Finish(const BpsStreamPatcher::Info& info) {
+        FlushPending();
+        WriteBuffer();
+        CompiledHeader header = {};
+        memcpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+        header.version = COMPILED_VERSION;
+        header.patchCrc = info.patchCrc;
+        header.sourceCrc = info.sourceCrc;
+        header.targetCrc = info.targetCrc;
+        header.outputSize = info.outputSize;
+        header.opCount = mCount;
+        mOk = mOk && mFile.Seek(0) && mFile.Write(&header, sizeof(header));
+        return mOk;
+    }
+
+private:
+    FileIO& mFile;
+    FileIO::Buffer mBuffer;
+    size_t mUsed = 0;
+    CompiledOp mPending = {};
+    bool mHavePending = false;
+    uint64_t mCount = 0;
+    bool mOk = true;
+
+    // 和上一条同类且首尾相接时直接延长 (TargetCopy 按字节向前复制, 合并后结果不变)
+    void Emit(uint32_t type, uint64_t offset, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        if (mHavePending && mPending.type == type && (uint64_t)mPending.length + n <= UINT32_MAX &&
+            (type == OP_ZERO || mPending.offset + mPending.length == offset)) {
+            mPending.length += (uint32_t)n;
+            return;
+        }
+        FlushPending();
+        mPending = {type, (uint32_t)n, offset};
+        mHavePending = true;
+    }
+
+    void FlushPending() {
+        if (mHavePending) {
+            Append(&mPending, sizeof(mPending));
+            mCount++;
+            mHavePending = false;
+        }
+    }
+
+    void Append(const void* data, size_t n) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        while (n > 0) {
+            size_t chunk = std::min(n, mBuffer.size() - mUsed);
+            memcpy(mBuffer.data() + mUsed, bytes, chunk);
+            mUsed += chunk;
+            bytes += chunk;
+            n -= chunk;
+            if (mUsed == mBuffer.size()) {
+                WriteBuffer();
+            }
+        }
+    }
+
+    void WriteBuffer() {
+        if (mUsed > 0 && !mFile.Write(mBuffer.data(), mUsed)) {
+            mOk = false;
+        }
+        mUsed = 0;
+    }
+};
+
+// 目标: 内存中保存 [mBase, mBase + mUsed), 文件中是 [0, mBase)
+// 保存目标的缓冲区被 TargetCopy 反复随机读取, 放在 MEM1 (FastMemory); 写缓冲区交给文件系统, 留在 MEM2
+// 写入文件在 I/O 线程上进行 (先复制到写缓冲区), CRC32 也在那里计算
+// 设置了 recorder 时每次追加都记录下来 (编译操作列表)
+class TargetWriter {
+public:
+    TargetWriter(IoWorker& worker, FileIO& file)
+        : mWorker(worker), mFile(&file), mBuffer(TARGET_HISTORY * 2, true), mWriteBuffer(TARGET_HISTORY) {}
+
+    ~TargetWriter() {
+        mWorker.Wait(mWriteTicket);
+    }
+
+    uint64_t End() const { return mBase + mUsed; }
+    void SetRecorder(OpRecorder* recorder) { mRecorder = recorder; }
+    bool Ok() const { return mOk && !mWriteFailed; }
+
+    // 保证缓冲区末尾有空间, 返回可写的字节数
+    size_t Reserve() {
+        if (mUsed == mBuffer.size()) {
+            WriteOut(TARGET_HISTORY);
+        }
+        return mBuffer.size() - mUsed;
+    }
+    uint8_t* Tail() { return mBuffer.data() + mUsed; }
+    void Commit(size_t n) { mUsed += n; }
+
+    // 写入失败后不再补 0 (可能有几百 MB), 由 Finish 报告错误
+    void AppendZeros(uint64_t n) {
+        while (n > 0 && Ok()) {
+            size_t chunk = (size_t)std::min<uint64_t>(n, Reserve());
+            memset(Tail(), 0, chunk);
+            if (mRecorder) mRecorder->Zero(chunk);
+            Commit(chunk);
+            n -= chunk;
+        }
+    }
+
+    void AppendSource(SourceWindow& source, uint64_t offset, uint64_t n) {
+        while (n > 0) {
+            size_t got = source.Read(offset, Tail(), (size_t)std::min<uint64_t>(n, Reserve()));
+            if (got == 0) {
+                break; // 剩下的部分在源文件之外, 由调用者补 0
+            }
+            if (mRecorder) mRecorder->Source(offset, got);
+            Commit(got);
+            offset += got;
+            n -= got;
+        }
+    }
+
+    void AppendPatch(PatchReader& patch, uint64_t n) {
+        while (n > 0) {
+            size_t chunk = (size_t)std::min<uint64_t>(n, Reserve());
+            size_t got = patch.Read(Tail(), chunk);
+            if (mRecorder) mRecorder->Literal(Tail(), got);
+            Commit(got);
+            n -= chunk;
+            if (got < chunk) {
+                patch.Skip(n); // 补丁数据用完, 位置照样前进
+                break;
+            }
+        }
+    }
+
+    // 复制已生成的目标 (src < End), 源和目标重叠时得到重复的图案
+    void AppendTarget(uint64_t src, uint64_t n) {
+        while (n > 0 && mOk) {
+            size_t chunk = (size_t)std::min<uint64_t>(n, Reserve());
+            if (src >= mBase) {
+                uint64_t distance = End() - src;
+                if (distance >= chunk) {
+                    memcpy(Tail(), mBuffer.data() + (src - mBase), chunk);
+                } else {
+                    Hips::BPS::replicate(Tail(), (size_t)distance, chunk);
+                }
+            } else {
+                // 已经写入文件的部分: 等正在进行的写入完成后读回来
+                mWorker.Wait(mWriteTicket);
+                chunk = (size_t)std::min<uint64_t>(chunk, mBase - src);
+                size_t got = mFile->ReadAt(src, Tail(), chunk);
+                if (got != chunk) {
+                    mOk = false;
+                    return;
+                }
+            }
+            if (mRecorder) mRecorder->Target(src, chunk);
+            Commit(chunk);
+            src += chunk;
+            n -= chunk;
+        }
+    }
+
+    // 写出剩下的数据并等待写入完成, 返回 CRC32
+    bool Finish(uint32_t& crc) {
+        while (mUsed > 0) {
+            WriteOut(std::min(mUsed, TARGET_HISTORY));
+        }
+        mWorker.Wait(mWriteTicket);
+        crc = mCrc;
+        return Ok();
+    }
+
+private:
+    IoWorker& mWorker;
+    FileIO* mFile;
+    FileIO::Buffer mBuffer;
+    FileIO::Buffer mWriteBuffer;        // I/O 线程正在写的数据
+    uint64_t mWriteTicket = 0;
+    uint64_t mBase = 0;
+    size_t mUsed = 0;
+    uint32_t mCrc = 0;                  // 只在 I/O 线程上更新
+    bool mOk = true;
+    OpRecorder* mRecorder = nullptr;
+    std::atomic<bool> mWriteFailed{false};
+
+    // 把缓冲区开头的 n (<= TARGET_HISTORY) 字节交给 I/O 线程写入
+    void WriteOut(size_t n) {
+        mWorker.Wait(mWriteTicket);
+        memcpy(mWriteBuffer.data(), mBuffer.data(), n);
+        uint64_t at = mBase;  // 中间可能读回过前面的部分, 写之前定位
+        mWriteTicket = mWorker.Submit([this, n, at]() {
+            if (!mFile->Seek(at) || !mFile->Write(mWriteBuffer.data(), n)) {
+                mWriteFailed = true;
+            }
+            mCrc = Hips::Detail::crc32(mWriteBuffer.data(), n, mCrc);
+        });
+        memmove(mBuffer.data(), mBuffer.data() + n, mUsed - n);
+        mUsed -= n;
+        mBase += n;
+    }
+};
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 读取 "BPS1" 和三个大小并跳过元数据, 成功时位置在第一个动作; dataSize 是源数据的大小
+BpsStreamPatcher::Result ReadPatchHeader(PatchReader& patch, uint64_t patchSize, uint64_t dataSize,
+                                         uint64_t& inputSize, uint64_t& outputSize) {
+    uint8_t magic[4];
+    if (patch.Read(magic, 4) != 4 || memcmp(magic, "BPS1", 4) != 0) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+
+    // 动作列表在三个 CRC32 之前结束
+    const uint64_t actionsEnd = patchSize - 12;
+    uint64_t metadataSize;
+    if (!patch.ReadNumber(actionsEnd, inputSize) ||
+        !patch.ReadNumber(actionsEnd, outputSize) ||
+        !patch.ReadNumber(actionsEnd, metadataSize)) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+    if (dataSize < inputSize) {
+        return BpsStreamPatcher::RESULT_SIZE_MISMATCH;
+    }
+    if (metadataSize > actionsEnd - patch.Tell()) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+    patch.Skip(metadataSize);
+    return BpsStreamPatcher::RESULT_SUCCESS;
+}
+
+// 读完补丁, 取出末尾记录的三个 CRC32 并检查补丁自身的 CRC32
+BpsStreamPatcher::Result ReadPatchTrailer(PatchReader& patch, BpsStreamPatcher::Info& info) {
+    uint32_t patchCrc = patch.FinishCrc();
+    uint8_t trailer[12];
+    if (!patch.ReadTrailer(trailer, sizeof(trailer))) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+    info.sourceCrc = ReadLE32(trailer);
+    info.targetCrc = ReadLE32(trailer + 4);
+    info.patchCrc = ReadLE32(trailer + 8);
+    return patchCrc == info.patchCrc ? BpsStreamPatcher::RESULT_SUCCESS : BpsStreamPatcher::RESULT_PATCH_CORRUPT;
+}
+
+// sourceReadData 和 sourceCopyData 是同一份源数据的两个独立读取者 (分别给 SourceRead 和 SourceCopy)
+BpsStreamPatcher::Result ApplyFiles(SourceData& sourceReadData, SourceData& sourceCopyData, BpsStreamPatcher::PatchStream& patchStream,
+                                    FileIO& outFile, bool verifySource, OpRecorder* recorder, BpsStreamPatcher::Info& info) {
+    uint64_t dataSize = sourceReadData.Size();
+    uint64_t patchSize = patchStream.Size();
+    if (patchSize < Hips::BPS::minimumPatchSize) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+
+    IoWorker worker;
+    PatchReader patch(worker, patchStream, patchSize);
+    uint64_t inputSize;
+    BpsStreamPatcher::Result header = ReadPatchHeader(patch, patchSize, dataSize, inputSize, info.outputSize);
+    if (header != BpsStreamPatcher::RESULT_SUCCESS) {
+        return header;
+    }
+    const uint64_t actionsEnd = patchSize - 12;
+    // 输出的大小已知: 一次分配好, 空间不够时在打补丁之前失败
+    if (!outFile.Reserve(info.outputSize)) {
+        return BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+
+    SourceWindow sourceRead(worker, sourceReadData, dataSize, true, verifySource ? inputSize : 0);
+    SourceWindow sourceCopy(worker, sourceCopyData, dataSize, false);
+    TargetWriter target(worker, outFile);
+    target.SetRecorder(recorder);
+    uint64_t sourceOffset = 0;
+    uint64_t targetOffset = 0; // TargetCopy 的读取位置
+    bool truncated = false;    // 动作没有读完 (补丁截断或损坏)
+
+    while (patch.Tell() < actionsEnd && target.Ok()) {
+        uint64_t word;
+        if (!patch.ReadNumber(actionsEnd, word)) {
+            truncated = true;
+            break;
+        }
+        const uint64_t action = word & 3;
+        const uint64_t start = target.End();
+        const uint64_t count = std::min<uint64_t>((word >> 2) + 1, info.outputSize - start);
+
+        switch (action) {
+            case Hips::BPS::Action::SourceRead:
+                target.AppendSource(sourceRead, start, count);
+                break;
+
+            case Hips::BPS::Action::TargetRead:
+                target.AppendPatch(patch, count);
+                break;
+
+            case Hips::BPS::Action::SourceCopy: {
+                uint64_t offsetWord;
+                if (!patch.ReadNumber(actionsEnd, offsetWord)) {
+                    truncated = true;
+                    break;
+                }
+                const uint64_t offset = offsetWord >> 1;
+                sourceOffset += (offsetWord & 1) ? -offset : offset;
+
+                size_t src = (size_t)sourceOffset;
+                size_t dst = (size_t)start;
+                size_t n = (size_t)count;
+                Hips::BPS::skipToZero(src, (size_t)dataSize, dst, n);
+                target.AppendZeros(dst - start);
+                target.AppendSource(sourceCopy, src, n);
+                sourceOffset += count;
+                break;
+            }
+
+            case Hips::BPS::Action::TargetCopy: {
+                uint64_t offsetWord;
+                if (!patch.ReadNumber(actionsEnd, offsetWord)) {
+                    truncated = true;
+                    break;
+                }
+                const uint64_t offset = offsetWord >> 1;
+                targetOffset += (offsetWord & 1) ? -offset : offset;
+
+                // 读取位置在写入位置或之后时只能读到 0
+                size_t src = (size_t)targetOffset;
+                size_t dst = (size_t)start;
+                size_t n = (size_t)count;
+                Hips::BPS::skipToZero(src, dst, dst, n);
+                target.AppendZeros(dst - start);
+                if (src < dst) {
+                    target.AppendTarget(src, n);
+                }
+                targetOffset += count;
+                break;
+            }
+        }
+        if (truncated) {
+            break;
+        }
+
+        // 没有覆盖到的部分 (越界读取) 为 0
+        if (target.End() < start + count) {
+            target.AppendZeros(start + count - target.End());
+        }
+    }
+
+    // 补丁没有写到的部分为 0; 动作没有读完时不补, 直接报告损坏
+    if (truncated) {
+        return BpsStreamPatcher::RESULT_PATCH_CORRUPT;
+    }
+    target.AppendZeros(info.outputSize - target.End());
+    uint32_t targetCrc = 0;
+    if (!target.Finish(targetCrc)) {
+        return BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+
+    // 三个 CRC32 都在数据读写时顺便算好了, 这里只需比较
+    BpsStreamPatcher::Result trailer = ReadPatchTrailer(patch, info);
+    if (trailer != BpsStreamPatcher::RESULT_SUCCESS) {
+        return trailer;
+    }
+    if (verifySource) {
+        uint32_t sourceCrc = inputSize > 0 ? sourceRead.FinishCrc() : 0;
+        if (sourceCrc != info.sourceCrc) {
+            return BpsStreamPatcher::RESULT_SOURCE_MISMATCH;
+        }
+        info.sourceVerified = true;
+    }
+    if (targetCrc != info.targetCrc) {
+        return BpsStreamPatcher::RESULT_CHECKSUM_MISMATCH;
+    }
+    return BpsStreamPatcher::RESULT_SUCCESS;
+}
+
+bool ReadCompiledHeader(FileIO& file, CompiledHeader& header) {
+    return file.ReadAt(0, &header, sizeof(header)) == sizeof(header) &&
+           memcmp(header.magic, COMPILED_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == COMPILED_VERSION;
+}
+
+// 按 .ops 文件里的操作生成目标: 没有变长数字解码和越界判断, 每条操作是一次连续的复制
+BpsStreamPatcher::Result ReplayFiles(FileIO& sourceReadFile, FileIO& sourceCopyFile, FileIO& opsFile, FileIO& outFile,
+                                     BpsStreamPatcher::Info& info) {
+    uint64_t dataSize = sourceReadFile.Size();
+    uint64_t opsSize = opsFile.Size();
+    CompiledHeader header;
+    if (!ReadCompiledHeader(opsFile, header)) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+    info.outputSize = header.outputSize;
+    info.sourceCrc = header.sourceCrc;
+    info.targetCrc = header.targetCrc;
+    info.patchCrc = header.patchCrc;
+    if (!outFile.Reserve(header.outputSize)) {
+        return BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+
+    IoWorker worker;
+    FilePatchStream opsStream(opsFile);
+    PatchReader ops(worker, opsStream, opsSize, false);
+    ops.Skip(sizeof(header));
+    FileSourceData sourceReadData(sourceReadFile);
+    FileSourceData sourceCopyData(sourceCopyFile);
+    SourceWindow sourceRead(worker, sourceReadData, dataSize, true);
+    SourceWindow sourceCopy(worker, sourceCopyData, dataSize, false);
+    TargetWriter target(worker, outFile);
+
+    for (uint64_t i = 0; i < header.opCount && target.Ok(); i++) {
+        CompiledOp op;
+        if (ops.Read((uint8_t*)&op, sizeof(op)) != sizeof(op)) {
+            return BpsStreamPatcher::RESULT_INVALID_PATCH;
+        }
+        const uint64_t start = target.End();
+        if (op.length > header.outputSize - start) {
+            return BpsStreamPatcher::RESULT_INVALID_PATCH;
+        }
+
+        switch (op.type) {
+            case OP_SOURCE:
+                // 读取位置和写入位置相同的来自 SourceRead, 使用带预读的顺序窗口
+                target.AppendSource(op.offset == start ? sourceRead : sourceCopy, op.offset, op.length);
+                if (target.End() != start + op.length) {
+                    return BpsStreamPatcher::RESULT_SIZE_MISMATCH;
+                }
+                break;
+
+            case OP_TARGET:
+                if (op.offset >= start) {
+                    return BpsStreamPatcher::RESULT_INVALID_PATCH;
+                }
+                target.AppendTarget(op.offset, op.length);
+                break;
+
+            case OP_LITERAL:
+                target.AppendPatch(ops, op.length);
+                if (target.End() != start + op.length) {
+                    return BpsStreamPatcher::RESULT_INVALID_PATCH;
+                }
+                ops.Skip(LiteralPadding(op.length));
+                break;
+
+            case OP_ZERO:
+                target.AppendZeros(op.length);
+                break;
+
+            default:
+                return BpsStreamPatcher::RESULT_INVALID_PATCH;
+        }
+    }
+
+    uint32_t targetCrc = 0;
+    if (!target.Ok()) {
+        return BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+    if (target.End() != header.outputSize) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+    if (!target.Finish(targetCrc)) {
+        return BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+    return targetCrc == header.targetCrc ? BpsStreamPatcher::RESULT_SUCCESS : BpsStreamPatcher::RESULT_CHECKSUM_MISMATCH;
+}
+
+// 关闭输出文件, 成功时把临时文件改名为 outputPath, 失败时删除临时文件
+// 改名前先刷到 SD 卡: 改名之后断电, outputPath 也只会是完整的新文件 (或者没有), 不会是写了一半的内容
+BpsStreamPatcher::Result FinishOutput(FileIO& outFile, const std::string& tempPath, const std::string& outputPath,
+                                      BpsStreamPatcher::Result result) {
+    if (result == BpsStreamPatcher::RESULT_SUCCESS && !outFile.Sync()) {
+        result = BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+    if (!outFile.Close() && result == BpsStreamPatcher::RESULT_SUCCESS) {
+        result = BpsStreamPatcher::RESULT_IO_ERROR;
+    }
+    if (result == BpsStreamPatcher::RESULT_SUCCESS) {
+        remove(outputPath.c_str()); // 先删除旧文件
+        if (rename(tempPath.c_str(), outputPath.c_str()) != 0) {
+            result = BpsStreamPatcher::RESULT_IO_ERROR;
+        }
+    }
+    if (result != BpsStreamPatcher::RESULT_SUCCESS) {
+        remove(tempPath.c_str());
+    }
+    return result;
+}
+
+// ---- 补丁链 ----
+// 前面各层的输出不生成出来, 只记成区段表: 按顺序首尾相接, 每一段说明这部分数据来自哪里
+// 下一层的 SourceRead / SourceCopy 从上一层的区段表切出对应的部分, TargetCopy 从自己已有的区段切出,
+// 所以无论叠几层, 区段最终都指向源文件、某一层补丁里的新数据、内存或 0
+enum : uint32_t {
+    EXTENT_SOURCE = 1,  // 源文件 offset 处
+    EXTENT_PATCH = 2,   // 第 arg 层补丁文件 offset 处 (TargetRead 的新数据)
+    EXTENT_MEMORY = 3,  // 内存池 offset 处 (不是文件的补丁的新数据)
+    EXTENT_REPEAT = 4,  // 内存池 offset 处 arg 字节的图案, 从图案的 phase 处开始循环 (短距离重叠的 TargetCopy)
+    EXTENT_ZERO = 5
+};
+
+struct Extent {
+    uint64_t start;   // 在这一层输出中的位置
+    uint64_t length;
+    uint64_t offset;
+    uint32_t type;
+    uint32_t arg;
+    uint32_t phase;
+};
+
+// 短于这个距离的重叠 TargetCopy 把图案读出来放进内存池, 更长的按周期切成多段
+constexpr size_t PATTERN_LIMIT = 4096;
+
+struct ChainState {
+    std::string sourcePath;
+    std::vector<std::string> layerPaths;  // 每层补丁文件的路径, 不是文件时为空 (新数据放进 pool)
+    std::vector<uint8_t> pool;
+};
+
+uint64_t ExtentsEnd(const std::vector<Extent>& extents) {
+    return extents.empty() ? 0 : extents.back().start + extents.back().length;
+}
+
+// 包含 at 的区段 (区段首尾相接, at 在末尾之前)
+size_t FindExtent(const std::vector<Extent>& extents, uint64_t at) {
+    auto it = std::upper_bound(extents.begin(), extents.end(), at,
+                               [](uint64_t value, const Extent& extent) { return value < extent.start; });
+    return (size_t)(it - extents.begin()) - 1;
+}
+
+// 追加到末尾, 和上一段首尾相接且来源连续时直接延长
+void PushExtent(std::vector<Extent>& extents, uint32_t type, uint64_t offset, uint64_t length,
+                uint32_t arg = 0, uint32_t phase = 0) {
+    if (length == 0) {
+        return;
+    }
+    if (!extents.empty()) {
+        Extent& last = extents.back();
+        bool contiguous = false;
+        if (last.type == type && last.arg == arg) {
+            switch (type) {
+                case EXTENT_ZERO:
+                    contiguous = true;
+                    break;
+                case EXTENT_REPEAT:
+                    contiguous = last.offset == offset && (last.phase + last.length) % arg == phase;
+                    break;
+                default:
+                    contiguous = last.offset + last.length == offset;
+                    break;
+            }
+        }
+        if (contiguous) {
+            last.length += length;
+            return;
+        }
+    }
+    extents.push_back({ExtentsEnd(extents), length, offset, type, arg, phase});
+}
+
+// 把 from 的 [at, at + n) 追加到 out (from 可以就是 out, 只读已有的部分); 超出 fromSize 的部分为 0
+void AppendSlice(std::vector<Extent>& out, const std::vector<Extent>& from, uint64_t fromSize, uint64_t at, uint64_t n) {
+    uint64_t inRange = at < fromSize ? std::min(n, fromSize - at) : 0;
+    uint64_t done = 0;
+    for (size_t i = inRange > 0 ? FindExtent(from, at) : 0; done < inRange; i++) {
+        const Extent extent = from[i];  // out 追加时可能重新分配, 先复制
+        uint64_t skip = at + done - extent.start;
+        uint64_t length = std::min(extent.length - skip, inRange - done);
+        if (extent.type == EXTENT_REPEAT) {
+            PushExtent(out, EXTENT_REPEAT, extent.offset, length, extent.arg, (uint32_t)((extent.phase + skip) % extent.arg));
+        } else if (extent.type == EXTENT_ZERO) {
+            PushExtent(out, EXTENT_ZERO, 0, length);
+        } else {
+            PushExtent(out, extent.type, extent.offset + skip, length, extent.arg);
+        }
+        done += length;
+    }
+    PushExtent(out, EXTENT_ZERO, 0, n - inRange);
+}
+
+// 随机读取文件, 缓存一个窗口 (区段很碎时不必每一段都读一次文件)
+class CachedReader {
+public:
+    CachedReader() : mBuffer(READ_WINDOW) {}
+
+    bool Open(const std::string& path) { return mFile.Open(path, FileIO::MODE_READ); }
+
+    size_t ReadAt(uint64_t offset, uint8_t* dst, size_t n) {
+        size_t done = 0;
+        while (done < n) {
+            uint64_t at = offset + done;
+            if (at < mStart || at >= mStart + mLen) {
+                if (n - done >= mBuffer.size()) {
+                    return done + mFile.ReadAt(at, dst + done, n - done);
+                }
+                mStart = at;
+                mLen = mFile.ReadAt(at, mBuffer.data(), mBuffer.size());
+                if (mLen == 0) {
+                    break;
+                }
+            }
+            size_t chunk = std::min(n - done, (size_t)(mStart + mLen - at));
+            memcpy(dst + done, mBuffer.data() + (at - mStart), chunk);
+            done += chunk;
+        }
+        return done;
+    }
+
+private:
+    FileIO mFile;
+    FileIO::Buffer mBuffer;
+    uint64_t mStart = 0;
+    size_t mLen = 0;
+};
+
+// 按区段表读出数据; 自己打开源文件和各层补丁文件, 每个使用者 (线程) 用各自的一个
+class ExtentReader {
+public:
+    explicit ExtentReader(const ChainState& chain) : mChain(chain) {}
+
+    bool Open() {
+        if (!mSource.Open(mChain.sourcePath)) {
+            return false;
+        }
+        mLayers.resize(mChain.layerPaths.size());
+        for (size_t i = 0; i < mLayers.size(); i++) {
+            if (!mChain.layerPaths[i].empty()) {
+                mLayers[i].reset(new CachedReader());
+                if (!mLayers[i]->Open(mChain.layerPaths[i])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // 读取 [at, at + n) (不超过区段表的末尾), 返回读到的字节数
+    size_t Read(const std::vector<Extent>& extents, uint64_t at, uint8_t* dst, size_t n) {
+        size_t done = 0;
+        for (size_t i = n > 0 ? FindExtent(extents, at) : 0; done < n && i < extents.size(); i++) {
+            const Extent& extent = extents[i];
+            uint64_t skip = at + done - extent.start;
+            size_t length = (size_t)std::min<uint64_t>(extent.length - skip, n - done);
+            uint8_t* out = dst + done;
+            switch (extent.type) {
+                case EXTENT_SOURCE:
+                    if (mSource.ReadAt(extent.offset + skip, out, length) != length) {
+                        return done;
+                    }
+                    break;
+                case EXTENT_PATCH:
+                    if (!mLayers[extent.arg] || mLayers[extent.arg]->ReadAt(extent.offset + skip, out, length) != length) {
+                        return done;
+                    }
+                    break;
+                case EXTENT_MEMORY:
+                    memcpy(out, mChain.pool.data() + extent.offset + skip, length);
+                    break;
+                case EXTENT_REPEAT: {
+                    size_t period = extent.arg;
+                    size_t phase = (size_t)((extent.phase + skip) % period);
+                    for (size_t k = 0; k < length;) {
+                        size_t chunk = std::min(length - k, period - phase);
+                        memcpy(out + k, mChain.pool.data() + extent.offset + phase, chunk);
+                        k += chunk;
+                        phase = 0;
+                    }
+                    break;
+                }
+                default:
+                    memset(out, 0, length);
+                    break;
+            }
+            done += length;
+        }
+        return done;
+    }
+
+private:
+    const ChainState& mChain;
+    CachedReader mSource;
+    std::vector<std::unique_ptr<CachedReader>> mLayers;
+};
+
+// 前面各层合成的结果, 作为最后一层的源数据
+class ChainSource : public SourceData {
+public:
+    ChainSource(const ChainState& chain, const std::vector<Extent>& extents, uint64_t size)
+        : mReader(chain), mExtents(extents), mSize(size) {}
+
+    bool Open() { return mReader.Open(); }
+    uint64_t Size() override { return mSize; }
+
+    size_t ReadAt(uint64_t offset, uint8_t* dst, size_t n) override {
+        if (offset >= mSize) {
+            return 0;
+        }
+        return mReader.Read(mExtents, offset, dst, (size_t)std::min<uint64_t>(n, mSize - offset));
+    }
+
+private:
+    ExtentReader mReader;
+    const std::vector<Extent>& mExtents;
+    uint64_t mSize;
+};
+
+bool ChainWithinLimit(const ChainState& chain, const std::vector<Extent>& lower, const std::vector<Extent>& out) {
+    return chain.pool.size() + (lower.capacity() + out.capacity()) * sizeof(Extent) <= BpsStreamPatcher::CHAIN_MEMORY_LIMIT;
+}
+
+// 把第 index 层补丁合成到区段表: lower 是这一层的源 (上一层的结果), 结果追加到 out
+// 动作的解释和 ApplyFiles 逐条对应 (越界读取得到 0, 负偏移回绕等)
+BpsStreamPatcher::Result ComposeLayer(BpsStreamPatcher::PatchStream& stream, uint32_t index,
+                                      const std::vector<Extent>& lower, uint64_t lowerSize, ChainState& chain,
+                                      ExtentReader& reader, std::vector<Extent>& out, BpsStreamPatcher::Info& info,
+                                      uint64_t& inputSize) {
+    const uint64_t patchSize = stream.Size();
+    if (patchSize < Hips::BPS::minimumPatchSize) {
+        return BpsStreamPatcher::RESULT_INVALID_PATCH;
+    }
+    IoWorker worker;
+    PatchReader patch(worker, stream, patchSize);
+    BpsStreamPatcher::Result header = ReadPatchHeader(patch, patchSize, lowerSize, inputSize, info.outputSize);
+    if (header != BpsStreamPatcher::RESULT_SUCCESS) {
+        return header;
+    }
+    const uint64_t actionsEnd = patchSize - 12;
+    const bool patchInFile = !chain.layerPaths[index].empty();
+    uint64_t sourceOffset = 0;
+    uint64_t targetOffset = 0;
+
+    while (patch.Tell() < actionsEnd) {
+        if (!ChainWithinLimit(chain, lower, out)) {
+            return BpsStreamPatcher::RESULT_CHAIN_TOO_LARGE;
+        }
+        uint64_t word;
+        if (!patch.ReadNumber(actionsEnd, word)) {
+            break;
+        }
+        const uint64_t action = word & 3;
+        const uint64_t start = ExtentsEnd(out);
+        const uint64_t count = std::min<uint64_t>((word >> 2) + 1, info.outputSize - start);
+
+        switch (action) {
+            case Hips::BPS::Action::SourceRead:
+                AppendSlice(out, lower, lowerSize, start, count);
+                break;
+
+            case Hips::BPS::Action::TargetRead: {
+                uint64_t at = patch.Tell();
+                uint64_t available = at < patchSize ? std::min(count, patchSize - at) : 0;
+                if (patchInFile) {
+                    // 新数据留在补丁文件里, 用到时再读
+                    PushExtent(out, EXTENT_PATCH, at, available, index);
+                    patch.Skip(count);
+                } else {
+                    if (chain.pool.size() + available > BpsStreamPatcher::CHAIN_MEMORY_LIMIT) {
+                        return BpsStreamPatcher::RESULT_CHAIN_TOO_LARGE;
+                    }
+                    size_t poolAt = chain.pool.size();
+                    chain.pool.resize(poolAt + (size_t)available);
+                    size_t got = patch.Read(chain.pool.data() + poolAt, (size_t)available);
+                    patch.Skip(count - available);
+                    chain.pool.resize(poolAt + got);
+                    PushExtent(out, EXTENT_MEMORY, poolAt, got);
+                }
+                break;
+            }
+
+            case Hips::BPS::Action::SourceCopy: {
+                uint64_t offsetWord;
+                if (!patch.ReadNumber(actionsEnd, offsetWord)) {
+                    break;
+                }
+                const uint64_t offset = offsetWord >> 1;
+                sourceOffset += (offsetWord & 1) ? -offset : offset;
+
+                size_t src = (size_t)sourceOffset;
+                size_t dst = (size_t)start;
+                size_t n = (size_t)count;
+                Hips::BPS::skipToZero(src, (size_t)lowerSize, dst, n);
+                PushExtent(out, EXTENT_ZERO, 0, dst - start);
+                AppendSlice(out, lower, lowerSize, src, n);
+                sourceOffset += count;
+                break;
+            }
+
+            case Hips::BPS::Action::TargetCopy: {
+                uint64_t offsetWord;
+                if (!patch.ReadNumber(actionsEnd, offsetWord)) {
+                    break;
+                }
+                const uint64_t offset = offsetWord >> 1;
+                targetOffset += (offsetWord & 1) ? -offset : offset;
+
+                size_t src = (size_t)targetOffset;
+                size_t dst = (size_t)start;
+                size_t n = (size_t)count;
+                Hips::BPS::skipToZero(src, dst, dst, n);
+                PushExtent(out, EXTENT_ZERO, 0, dst - start);
+                if (src < dst) {
+                    size_t distance = dst - src;
+                    if (distance >= n) {
+                        AppendSlice(out, out, dst, src, n);
+                    } else if (distance <= PATTERN_LIMIT) {
+                        // 重复的图案: 读出一个周期放进内存池
+                        size_t poolAt = chain.pool.size();
+                        chain.pool.resize(poolAt + distance);
+                        if (reader.Read(out, src, chain.pool.data() + poolAt, distance) != distance) {
+                            return BpsStreamPatcher::RESULT_IO_ERROR;
+                        }
+                        PushExtent(out, EXTENT_REPEAT, poolAt, n, (uint32_t)distance, 0);
+                    } else {
+                        // 每一段都落在已有的部分之内
+                        for (size_t done = 0; done < n;) {
+                            size_t chunk = std::min(distance, n - done);
+                            AppendSlice(out, out, dst + done, src + done, chunk);
+                            done += chunk;
+                        }
+                    }
+                }
+                targetOffset += count;
+                break;
+            }
+        }
+
+        // 没有覆盖到的部分 (越界读取) 为 0
+        if (ExtentsEnd(out) < start + count) {
+            PushExtent(out, EXTENT_ZERO, 0, start + count - ExtentsEnd(out));
+        }
+    }
+
+    // 补丁没有写到的部分为 0
+    PushExtent(out, EXTENT_ZERO, 0, info.outputSize - ExtentsEnd(out));
+    return ReadPatchTrailer(patch, info);
+}
+
+struct ChainLayer {
+    BpsStreamPatcher::PatchStream* stream;
+    std::string path;  // 补丁是文件时的路径, 新数据从这里按需读取
+};
+
+// 源文件前 size 字节的 CRC32
+bool ComputeSourceCrc(const std::string& path, uint64_t size, uint32_t& crc) {
+    FileIO file;
+    if (!file.Open(path, FileIO::MODE_READ)) {
+        return false;
+    }
+    FileIO::Buffer buffer(READ_WINDOW);
+    crc = 0;
+    uint64_t done = 0;
+    while (done < size) {
+        size_t n = file.Read(buffer.data(), (size_t)std::min<uint64_t>(buffer.size(), size - done));
+        if (n == 0) {
+            return false;
+        }
+        crc = Hips::Detail::crc32(buffer.data(), n, crc);
+        done += n;
+    }
+    return true;
+}
+
+BpsStreamPatcher::Result ApplyChainLayers(const std::string& sourcePath, const std::vector<ChainLayer>& layers,
+                                          const std::string& outputPath, bool verifySource, BpsStreamPatcher::Info& info) {
+    ChainState chain;
+    chain.sourcePath = sourcePath;
+    for (const ChainLayer& layer : layers) {
+        chain.layerPaths.push_back(layer.path);
+    }
+    ExtentReader patternReader(chain);
+    if (!patternReader.Open()) {
+        return BpsStreamPatcher::RESULT_OPEN_FAILED;
+    }
+
+    // 源文件本身是第 0 层的源: 一整段
+    uint64_t lowerSize;
+    {
+        FileIO sourceFile;
+        if (!sourceFile.Open(sourcePath, FileIO::MODE_READ)) {
+            return BpsStreamPatcher::RESULT_OPEN_FAILED;
+        }
+        lowerSize = sourceFile.Size();
+    }
+    std::vector<Extent> lower;
+    PushExtent(lower, EXTENT_SOURCE, 0, lowerSize);
+
+    std::vector<uint32_t> patchCrcs;
+    uint32_t previousTarget = 0;
+    for (size_t i = 0; i + 1 < layers.size(); i++) {
+        std::vector<Extent> out;
+        BpsStreamPatcher::Info layerInfo;
+        uint64_t inputSize = 0;
+        BpsStreamPatcher::Result result = ComposeLayer(*layers[i].stream, (uint32_t)i, lower, lowerSize, chain,
+                                                       patternReader, out, layerInfo, inputSize);
+        if (i == 0) {
+            info.sourceCrc = layerInfo.sourceCrc;
+        }
+        if (result != BpsStreamPatcher::RESULT_SUCCESS) {
+            return result;
+        }
+        if (i == 0 && verifySource) {
+            uint32_t sourceCrc = 0;
+            if (!ComputeSourceCrc(sourcePath, inputSize, sourceCrc)) {
+                return BpsStreamPatcher::RESULT_OPEN_FAILED;
+            }
+            if (sourceCrc != layerInfo.sourceCrc) {
+                return BpsStreamPatcher::RESULT_SOURCE_MISMATCH;
+            }
+            info.sourceVerified = true;
+        }
+        // 中间结果不计算 CRC32: 这一层记录的源文件必须就是上一层记录的目标
+        if (i > 0 && layerInfo.sourceCrc != previousTarget) {
+            return BpsStreamPatcher::RESULT_SOURCE_MISMATCH;
+        }
+        patchCrcs.push_back(layerInfo.patchCrc);
+        previousTarget = layerInfo.targetCrc;
+        lower.swap(out);
+        lowerSize = layerInfo.outputSize;
+    }
+
+    // 最后一层照常流式应用, 源数据是前面各层合成的结果
+    ChainSource sourceReadData(chain, lower, lowerSize);
+    ChainSource sourceCopyData(chain, lower, lowerSize);
+    std::string tempPath = outputPath + ".tmp";
+    FileIO outFile;
+    if (!sourceReadData.Open() || !sourceCopyData.Open() || !outFile.Open(tempPath, FileIO::MODE_READ_WRITE)) {
+        return BpsStreamPatcher::RESULT_OPEN_FAILED;
+    }
+    BpsStreamPatcher::Info last;
+    BpsStreamPatcher::Result result = ApplyFiles(sourceReadData, sourceCopyData, *layers.back().stream, outFile,
+                                                 false, nullptr, last);
+    if (result == BpsStreamPatcher::RESULT_SUCCESS && last.sourceCrc != previousTarget) {
+        result = BpsStreamPatcher::RESULT_SOURCE_MISMATCH;
+    }
+    result = FinishOutput(outFile, tempPath, outputPath, result);
+
+    patchCrcs.push_back(last.patchCrc);
+    info.outputSize = last.outputSize;
+    info.targetCrc = last.targetCrc;
+    info.patchCrc = BpsStreamPatcher::ChainCrc(patchCrcs);
+    return result;
+}
+
+} // namespace
+
+BpsStreamPatcher::Result BpsStreamPatcher::Apply(const std::string& sourcePath, const std::string& patchPath,
+                                                 const std::string& outputPath, bool verifySource, Info* info,
+                                                 const std::string& compiledPath) {
+    FileIO patchFile;
+    if (!patchFile.Open(patchPath, FileIO::MODE_READ)) {
+        return RESULT_OPEN_FAILED;
+    }
+    FilePatchStream patch(patchFile);
+    return ApplyStream(sourcePath, patch, outputPath, verifySource, info, compiledPath);
+}
+
+BpsStreamPatcher::Result BpsStreamPatcher::ApplyStream(const std::string& sourcePath, PatchStream& patch,
+                                                       const std::string& outputPath, bool verifySource, Info* info,
+                                                       const std::string& compiledPath) {
+    // 源文件打开两次: 顺序读取 (带预读) 和随机读取的 SourceCopy 各用一个文件位置
+    std::string tempPath = outputPath + ".tmp";
+    FileIO sourceReadFile, sourceCopyFile, outFile;
+    if (!sourceReadFile.Open(sourcePath, FileIO::MODE_READ) || !sourceCopyFile.Open(sourcePath, FileIO::MODE_READ) ||
+        !outFile.Open(tempPath, FileIO::MODE_READ_WRITE)) {
+        return RESULT_OPEN_FAILED;
+    }
+
+    // 编译操作列表是顺带的: 打不开或写失败只是不留下 .ops 文件
+    std::string compiledTemp = compiledPath + ".tmp";
+    FileIO compiledFile;
+    std::unique_ptr<OpRecorder> recorder;
+    if (!compiledPath.empty() && compiledFile.Open(compiledTemp, FileIO::MODE_WRITE)) {
+        recorder.reset(new OpRecorder(compiledFile));
+    }
+
+    Info applied;
+    FileSourceData sourceReadData(sourceReadFile);
+    FileSourceData sourceCopyData(sourceCopyFile);
+    Result result = ApplyFiles(sourceReadData, sourceCopyData, patch, outFile, verifySource, recorder.get(), applied);
+    sourceReadFile.Close();
+    sourceCopyFile.Close();
+    result = FinishOutput(outFile, tempPath, outputPath, result);
+
+    if (recorder) {
+        // 只保留源文件确实是补丁对应版本时编译出的列表 (没有校验源文件时由调用者保证)
+        Result compiled = (result == RESULT_SUCCESS && recorder->Finish(applied)) ? RESULT_SUCCESS : RESULT_IO_ERROR;
+        FinishOutput(compiledFile, compiledTemp, compiledPath, compiled);
+    }
+
+    if (info) {
+        *info = applied;
+    }
+    return result;
+}
+
+BpsStreamPatcher::Result BpsStreamPatcher::ApplyChain(const std::string& sourcePath,
+                                                      const std::vector<std::string>& patchPaths,
+                                                      const std::string& outputPath, bool verifySource, Info* info) {
+    std::vector<std::unique_ptr<FileIO>> files;
+    std::vector<std::unique_ptr<FilePatchStream>> streams;
+    std::vector<ChainLayer> layers;
+    for (const std::string& path : patchPaths) {
+        files.emplace_back(new FileIO());
+        if (!files.back()->Open(path, FileIO::MODE_READ)) {
+            return RESULT_OPEN_FAILED;
+        }
+        streams.emplace_back(new FilePatchStream(*files.back()));
+        layers.push_back({streams.back().get(), path});
+    }
+    if (layers.empty()) {
+        return RESULT_INVALID_PATCH;
+    }
+    if (layers.size() == 1) {
+        return ApplyStream(sourcePath, *layers[0].stream, outputPath, verifySource, info);
+    }
+    Info applied;
+    Result result = ApplyChainLayers(sourcePath, layers, outputPath, verifySource, applied);
+    if (info) {
+        *info = applied;
+    }
+    return result;
+}
+
+BpsStreamPatcher::Result BpsStreamPatcher::ApplyChainStreams(const std::string& sourcePath,
+                                                             const std::vector<PatchStream*>& patches,
+                                                             const std::string& outputPath, bool verifySource,
+                                                             Info* info) {
+    if (patches.empty()) {
+        return RESULT_INVALID_PATCH;
+    }
+    if (patches.size() == 1) {
+        return ApplyStream(sourcePath, *patches[0], outputPath, verifySource, info);
+    }
+    std::vector<ChainLayer> layers;
+    for (PatchStream* patch : patches) {
+        layers.push_back({patch, std::string()});
+    }
+    Info applied;
+    Result result = ApplyChainLayers(sourcePath, layers, outputPath, verifySource, applied);
+    if (info) {
+        *info = applied;
+    }
+    return result;
+}
+
+uint32_t BpsStreamPatcher::ChainCrc(const std::vector<uint32_t>& crcs) {
+    if (crcs.size() == 1) {
+        return crcs[0];
+    }
+    std::vector<uint8_t> bytes;
+    for (uint32_t crc : crcs) {
+        for (int i = 0; i < 4; i++) {
+            bytes.push_back((uint8_t)(crc >> (i * 8)));
+        }
+    }
+    return Hips::Detail::crc32(bytes.data(), bytes.size(), 0);
+}
+
+BpsStreamPatcher::Result BpsStreamPatcher::ApplyCompiled(const std::string& sourcePath, const std::string& compiledPath,
+                                                         const std::string& outputPath, Info* info) {
+    std::string tempPath = outputPath + ".tmp";
+    FileIO sourceReadFile, sourceCopyFile, opsFile, outFile;
+    if (!sourceReadFile.Open(sourcePath, FileIO::MODE_READ) || !sourceCopyFile.Open(sourcePath, FileIO::MODE_READ) ||
+        !opsFile.Open(compiledPath, FileIO::MODE_READ) || !outFile.Open(tempPath, FileIO::MODE_READ_WRITE)) {
+        return RESULT_OPEN_FAILED;
+    }
+
+    Info replayed;
+    Result result = ReplayFiles(sourceReadFile, sourceCopyFile, opsFile, outFile, replayed);
+    sourceReadFile.Close();
+    sourceCopyFile.Close();
+    opsFile.Close();
+    result = FinishOutput(outFile, tempPath, outputPath, result);
+
+    if (info) {
+        *info = replayed;
+    }
+    return result;
+}
+
+bool BpsStreamPatcher::ReadCompiledInfo(const std::string& compiledPath, Info& info) {
+    FileIO file;
+    CompiledHeader header;
+    if (!file.Open(compiledPath, FileIO::MODE_READ) || !ReadCompiledHeader(file, header)) {
+        return false;
+    }
+    info.outputSize = header.outputSize;
+    info.sourceCrc = header.sourceCrc;
+    info.targetCrc = header.targetCrc;
+    info.patchCrc = header.patchCrc;
+    return true;
+}
+
+const char* BpsStreamPatcher::ResultToString(Result result) {
+    switch (result) {
+        case RESULT_SUCCESS: return "Success";
+        case RESULT_OPEN_FAILED: return "Failed to open file";
+        case RESULT_INVALID_PATCH: return "Invalid patch";
+        case RESULT_SIZE_MISMATCH: return "Size mismatch";
+        case RESULT_CHECKSUM_MISMATCH: return "Checksum mismatch";
+        case RESULT_SOURCE_MISMATCH: return "Source file checksum mismatch";
+        case RESULT_PATCH_CORRUPT: return "Patch checksum mismatch";
+        case RESULT_IO_ERROR: return "I/O error";
+        case RESULT_CHAIN_TOO_LARGE: return "Patch chain too large";
+        default: return "Unknown error";
+    }
+}
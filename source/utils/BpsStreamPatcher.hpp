@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// 流式 BPS 补丁: 源文件和补丁都按窗口读取, 目标边生成边写入磁盘, 内存占用和文件大小无关
+// 目标只在内存中保留最近的一段 (TargetCopy 绝大多数落在这里), 更早的部分从输出文件读回
+// 结果和 Hips::patchBPS 逐字节一致 (越界读取得到 0, 负偏移回绕等规则相同)
+// 读补丁、读源文件和写目标在每次 Apply 自己的 I/O 线程上进行 (预读下一块、异步写出), 和打补丁的计算重叠
+// 文件读写经过 FileIO (SD 卡和 MLC 上直接调用 FSA, 缓冲区按 FSA 的要求对齐)
+// 输出先写到 outputPath + ".tmp", 校验通过后才改名为 outputPath
+// Apply 可以顺便把实际执行的操作编译成 .ops 文件 (绝对偏移、合并后的连续复制、内联的新数据),
+// 同一个补丁和同一个源文件再次安装时用 ApplyCompiled 重放, 不再解析补丁
+class BpsStreamPatcher {
+public:
+    enum Result {
+        RESULT_SUCCESS,
+        RESULT_OPEN_FAILED,        // 打不开源文件、补丁或输出文件
+        RESULT_INVALID_PATCH,
+        RESULT_SIZE_MISMATCH,      // 源文件比补丁要求的小
+        RESULT_CHECKSUM_MISMATCH,  // 目标的 CRC32 和补丁记录的不一致
+        RESULT_SOURCE_MISMATCH,    // 源文件的 CRC32 和补丁记录的不一致 (不是补丁对应的版本)
+        RESULT_PATCH_CORRUPT,      // 补丁自身的 CRC32 不一致 (下载或解压损坏)
+        RESULT_IO_ERROR,           // 读写输出文件失败
+        RESULT_CHAIN_TOO_LARGE     // 补丁链的中间结果太碎, 区段表超过 CHAIN_MEMORY_LIMIT
+    };
+
+    // 补丁记录的校验和与目标大小
+    struct Info {
+        uint64_t outputSize = 0;
+        uint32_t sourceCrc = 0;
+        uint32_t targetCrc = 0;
+        uint32_t patchCrc = 0;
+        bool sourceVerified = false;  // 这次确实校验了源文件
+    };
+
+    // 补丁的来源, 只从头到尾顺序读一遍 (可以是正在从 zip 中解压的条目)
+    // Read 在 Apply 的 I/O 线程上调用, 只有到末尾或出错时才返回少于 n 字节
+    class PatchStream {
+    public:
+        virtual ~PatchStream() = default;
+        virtual uint64_t Size() = 0;
+        virtual size_t Read(void* dst, size_t n) = 0;
+    };
+
+    // 目标和补丁总是校验; verifySource 为 false 时 (已知源文件和上次校验时相同) 不为了校验读完整个源文件
+    // info 不为空时返回补丁记录的信息 (失败时也尽量填写)
+    // compiledPath 不为空时成功后在那里写入编译好的操作列表 (失败不影响结果)
+    static Result Apply(const std::string& sourcePath, const std::string& patchPath,
+                        const std::string& outputPath, bool verifySource = true, Info* info = nullptr,
+                        const std::string& compiledPath = std::string());
+    // 和 Apply 相同, 补丁从 patch 读取
+    static Result ApplyStream(const std::string& sourcePath, PatchStream& patch,
+                              const std::string& outputPath, bool verifySource = true, Info* info = nullptr,
+                              const std::string& compiledPath = std::string());
+
+    // 读取操作列表记录的补丁信息; 调用者用 patchCrc 和 sourceCrc 确认它属于当前的补丁和源文件
+    static bool ReadCompiledInfo(const std::string& compiledPath, Info& info);
+    // 重放操作列表, 目标的 CRC32 照样校验 (不校验源文件)
+    static Result ApplyCompiled(const std::string& sourcePath, const std::string& compiledPath,
+                                const std::string& outputPath, Info* info = nullptr);
+
+    // 补丁链: 依次应用 patchPaths (后一个补丁的源是前一个的目标), 只写出最后的结果
+    // 中间结果不生成, 只记成区段表 (每一段来自源文件、某个补丁的新数据或 0), 最后一个补丁照常流式应用
+    // 每个补丁记录的源 CRC32 必须等于前一个记录的目标 CRC32; verifySource 只决定是否校验最初的源文件
+    // info 的 sourceCrc 来自第一个补丁, outputSize 和 targetCrc 来自最后一个, patchCrc 是 ChainCrc
+    // 补丁链不编译 .ops 文件; 只有一个补丁时和 ApplyStream 相同
+    static Result ApplyChain(const std::string& sourcePath, const std::vector<std::string>& patchPaths,
+                             const std::string& outputPath, bool verifySource = true, Info* info = nullptr);
+    // 和 ApplyChain 相同, 补丁从 patches 读取; 不是文件的补丁的新数据放在内存中 (计入 CHAIN_MEMORY_LIMIT)
+    static Result ApplyChainStreams(const std::string& sourcePath, const std::vector<PatchStream*>& patches,
+                                    const std::string& outputPath, bool verifySource = true, Info* info = nullptr);
+    // 一串补丁 CRC32 合成一个值 (只有一个时就是它本身), 用来记录和比较整条补丁链
+    static uint32_t ChainCrc(const std::vector<uint32_t>& crcs);
+
+    static const char* ResultToString(Result result);
+
+    // 补丁和源文件的读取窗口
+    static constexpr size_t READ_WINDOW = 64 * 1024;
+    // 目标在内存中至少保留最近这么多字节, 缓冲区为它的两倍, 满了就把前一半写入文件
+    static constexpr size_t TARGET_HISTORY = 256 * 1024;
+    // 一次 Apply 的缓冲区总大小, 和文件大小无关:
+    // 补丁和 SourceRead 各两个窗口 (一个在用, 一个预读), SourceCopy 一个, 目标缓冲区加写缓冲区
+    static constexpr size_t WORKING_SET = READ_WINDOW * 5 + TARGET_HISTORY * 3;
+    // 补丁链的区段表和内存中的新数据的上限
+    static constexpr size_t CHAIN_MEMORY_LIMIT = 16 * 1024 * 1024;
+};
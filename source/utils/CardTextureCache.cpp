@@ -0,0 +1,109 @@
+#include "CardTextureCache.hpp"
+#include "TextureRegistry.hpp"
+#include "AppLifecycle.hpp"
+#include "Animation.hpp"
+#include "../Gfx.hpp"
+
+// 这一帧已经重新渲染的卡片数 (所有列表共用, 按帧时间区分帧)
+static uint64_t sRenderFrameMs = 0;
+static int sRendersThisFrame = 0;
+
+CardTextureCache::~CardTextureCache() {
+    Clear();
+}
+
+size_t CardTextureCache::Clear() {
+    size_t bytes = 0;
+    for (Entry& entry : mEntries) {
+        if (entry.texture) {
+            bytes += (size_t)entry.w * entry.h * 4;
+        }
+        TextureRegistry::Destroy(entry.texture);
+    }
+    mEntries.clear();
+    return bytes;
+}
+
+CardTextureCache::Entry& CardTextureCache::Acquire(const std::string& key, int w, int h) {
+    for (Entry& entry : mEntries) {
+        if (entry.key == key) {
+            return entry;
+        }
+    }
+    if (mEntries.size() < MAX_ENTRIES) {
+        mEntries.emplace_back();
+        mEntries.back().key = key;
+        return mEntries.back();
+    }
+
+    // 淘汰最久没有绘制的卡片, 尺寸相同时直接重用它的纹理
+    Entry* oldest = &mEntries[0];
+    for (Entry& entry : mEntries) {
+        if (entry.lastUsed < oldest->lastUsed) {
+            oldest = &entry;
+        }
+    }
+    oldest->key = key;
+    oldest->signature = 0;
+    if (oldest->w != w || oldest->h != h) {
+        TextureRegistry::Destroy(oldest->texture);
+        oldest->texture = nullptr;
+    }
+    return *oldest;
+}
+
+bool CardTextureCache::Draw(const std::string& key, uint64_t signature, int w, int h, const SDL_Rect& dst,
+                            const std::function<void()>& draw) {
+    if (w <= 0 || h <= 0) {
+        return false;
+    }
+
+    if (mForegroundCount != AppLifecycle::GetForegroundCount()) {
+        mForegroundCount = AppLifecycle::GetForegroundCount();
+        for (Entry& cached : mEntries) {
+            cached.signature = 0;
+        }
+    }
+
+    Entry& entry = Acquire(key, w, h);
+    entry.lastUsed = ++mUseCounter;
+
+    if (sRenderFrameMs != Animation::FrameTimeMs()) {
+        sRenderFrameMs = Animation::FrameTimeMs();
+        sRendersThisFrame = 0;
+    }
+    // 已有旧内容的卡片这一帧的份额用完时先画旧的 (例如几张缩略图同时到达), 下一帧再渲染
+    bool stale = entry.texture && entry.w == w && entry.h == h && entry.signature != 0;
+    bool deferred = stale && entry.signature != signature && sRendersThisFrame >= MAX_RENDERS_PER_FRAME;
+
+    if (!deferred && (!entry.texture || entry.w != w || entry.h != h || entry.signature != signature)) {
+        if (stale) {
+            sRendersThisFrame++;
+        }
+        if (entry.texture && (entry.w != w || entry.h != h)) {
+            TextureRegistry::Destroy(entry.texture);
+            entry.texture = nullptr;
+        }
+        if (!entry.texture) {
+            entry.texture = TextureRegistry::Create(TextureRegistry::CATEGORY_TARGET, Gfx::GetRenderer(),
+                                                    SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+            if (!entry.texture) {
+                entry.signature = 0;
+                return false;
+            }
+            SDL_SetTextureBlendMode(entry.texture, SDL_BLENDMODE_BLEND);
+            entry.w = w;
+            entry.h = h;
+        }
+        if (!Gfx::RenderToTexture(entry.texture, draw)) {
+            entry.signature = 0;
+            return false;
+        }
+        entry.signature = signature;
+    }
+
+    // 界面淡入淡出时的全局透明度在绘制时应用
+    SDL_SetTextureAlphaMod(entry.texture, (Uint8) (255 * Gfx::GetGlobalAlpha()));
+    Gfx::DrawTexture(entry.texture, nullptr, dst);
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <SDL2/SDL.h>
+
+// 列表卡片的合成纹理: 卡片背景、缩略图、文字和标签按原尺寸渲染到一张纹理, 之后每帧只需一次绘制
+// 卡片的内容由调用者算出的签名 (Mix 组合的哈希) 表示, 签名变化 (数据、缩略图、选中状态、语言) 时重新渲染
+// 选中动画的缩放、阴影、发光和边框在绘制纹理时处理, 不进入缓存
+// 最多保留 MAX_ENTRIES 张, 超出时淘汰最久没有绘制的; 只在主线程使用
+// 从后台回到前台后渲染目标的内容不一定还在, 下次绘制时全部重新渲染
+class CardTextureCache {
+public:
+    static constexpr size_t MAX_ENTRIES = 6;  // 可见的卡片加上滚动时进入的几张
+    // 每帧最多重新渲染的已有卡片数, 超出的这一帧继续画旧的内容 (第一次渲染的卡片没有旧内容, 不受限制)
+    // 按键移动选中项时新旧两张卡片在同一帧改变, 不会被推迟
+    static constexpr int MAX_RENDERS_PER_FRAME = 2;
+
+    CardTextureCache() = default;
+    ~CardTextureCache();
+    CardTextureCache(const CardTextureCache&) = delete;
+    CardTextureCache& operator=(const CardTextureCache&) = delete;
+
+    // 把 key 对应的卡片绘制到 dst (按 dst 缩放), 签名或尺寸不同时先用 draw 在 (0, 0) 按 w x h 重新渲染
+    // 纹理创建或渲染失败时返回 false, 调用者应直接绘制卡片
+    bool Draw(const std::string& key, uint64_t signature, int w, int h, const SDL_Rect& dst,
+              const std::function<void()>& draw);
+
+    // 释放所有纹理 (离开界面时由析构函数调用, 被盖住的界面内存不足时也调用), 返回释放的字节数
+    size_t Clear();
+
+    // FNV-1a, 用于组合签名
+    static constexpr uint64_t SIGNATURE_SEED = 0xcbf29ce484222325ull;
+    static uint64_t Mix(uint64_t hash, std::string_view data) {
+        for (unsigned char c : data) {
+            hash = (hash ^ c) * 0x100000001b3ull;
+        }
+        // 分隔相邻的字段, "ab" + "c" 和 "a" + "bc" 不同
+        return (hash ^ 0xff) * 0x100000001b3ull;
+    }
+    static uint64_t Mix(uint64_t hash, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t signature = 0;
+        SDL_Texture* texture = nullptr;
+        int w = 0;
+        int h = 0;
+        uint32_t lastUsed = 0;
+    };
+
+    Entry& Acquire(const std::string& key, int w, int h);
+
+    std::vector<Entry> mEntries;
+    uint32_t mUseCounter = 0;
+    uint32_t mForegroundCount = 0;  // 渲染时 AppLifecycle::GetForegroundCount 的值
+};
@@ -1,7 +1,9 @@
 #include "Config.hpp"
+#include "FileLogger.hpp"
 #include <fstream>
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 #include <sys/stat.h>
 
 Config::Config() 
@@ -12,12 +14,20 @@ Config::Config()
     , mAutoInstall(true)
     , mBgmEnabled(true)   // 默认开启背景音乐
     , mBgmUrl("https://raw.githubusercontent.com/xziip/utheme/main/data/BGM.mp3")  // 默认BGM下载地址
+    , mBgmWorkMode(BGM_WORK_FADE)
+    , mStyleMiiUPresent(false)
+    , mCompactPreviews(true)
+    , mBenchmarkOnLaunch(false)
+    , mPatchStore(false)
+    , mPerfProfile(-1)
+    , mMetricsStream(false)
+    , mDirectInflate(false)
     , mConfigPath("fs:/vol/external01/wiiu/utheme.cfg") {
     Load();
 }
 
 Config::~Config() {
-    Save();
+    Flush();
 }
 
 Config& Config::GetInstance() {
@@ -26,51 +36,74 @@ Config& Config::GetInstance() {
 }
 
 void Config::SetLoggingEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mLoggingEnabled != enabled) {
         mLoggingEnabled = enabled;
-        Save();
+        MarkDirty();
     }
 }
 
 void Config::SetVerboseLogging(bool verbose) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mVerboseLogging != verbose) {
         mVerboseLogging = verbose;
-        Save();
+        MarkDirty();
     }
 }
 
 void Config::SetLanguage(const std::string& lang) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mLanguage != lang) {
         mLanguage = lang;
-        Save();
+        MarkDirty();
     }
 }
 
 void Config::SetDownloadPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mDownloadPath != path) {
         mDownloadPath = path;
-        Save();
+        MarkDirty();
     }
 }
 
 void Config::SetAutoInstallEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mAutoInstall != enabled) {
         mAutoInstall = enabled;
-        Save();
+        MarkDirty();
     }
 }
 
 void Config::SetBgmEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mBgmEnabled != enabled) {
         mBgmEnabled = enabled;
-        Save();
+        MarkDirty();
     }
 }
 
 void Config::SetBgmUrl(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mBgmUrl != url) {
         mBgmUrl = url;
-        Save();
+        MarkDirty();
+    }
+}
+
+void Config::SetStyleMiiUPresent(bool present) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStyleMiiUPresent != present) {
+        mStyleMiiUPresent = present;
+        MarkDirty();
+    }
+}
+
+void Config::SetCompactPreviewsEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCompactPreviews != enabled) {
+        mCompactPreviews = enabled;
+        MarkDirty();
     }
 }
 
@@ -103,6 +136,24 @@ bool Config::Load() {
             mBgmEnabled = (line[4] == '1');
         } else if (strncmp(line, "bgmurl=", 7) == 0) {
             mBgmUrl = &line[7];
+        } else if (strncmp(line, "bgmwork=", 8) == 0) {
+            int mode = atoi(&line[8]);
+            mBgmWorkMode = (mode >= BGM_WORK_PLAY && mode <= BGM_WORK_FADE) ? (BgmWorkMode)mode : BGM_WORK_FADE;
+        } else if (strncmp(line, "stylemiiu=", 10) == 0) {
+            mStyleMiiUPresent = (line[10] == '1');
+        } else if (strncmp(line, "compactpreviews=", 16) == 0) {
+            mCompactPreviews = (line[16] == '1');
+        } else if (strncmp(line, "benchmark=", 10) == 0) {
+            mBenchmarkOnLaunch = (line[10] == '1');
+        } else if (strncmp(line, "patchstore=", 11) == 0) {
+            mPatchStore = (line[11] == '1');
+        } else if (strncmp(line, "perfprofile=", 12) == 0) {
+            int profile = atoi(&line[12]);
+            mPerfProfile = (profile >= 0 && profile <= 2) ? profile : -1;
+        } else if (strncmp(line, "metrics=", 8) == 0) {
+            mMetricsStream = (line[8] == '1');
+        } else if (strncmp(line, "directinflate=", 14) == 0) {
+            mDirectInflate = (line[14] == '1');
         }
     }
     
@@ -110,7 +161,61 @@ bool Config::Load() {
     return true;
 }
 
+void Config::MarkDirty() {
+    mDirty = true;
+    mLastChange = Clock::now();
+}
+
+void Config::Update() {
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mDirty) {
+            return;
+        }
+        // 上一次写入还没结束, 或者还在连续修改
+        const Clock::time_point now = Clock::now();
+        if (!mSaveJob.IsDone() || now - mLastChange < std::chrono::milliseconds(SAVE_DELAY_MS) ||
+            now - mLastSave < std::chrono::milliseconds(SAVE_INTERVAL_MS)) {
+            return;
+        }
+        content = Serialize();
+        mDirty = false;
+        mLastSave = now;
+    }
+
+    mSaveJob = JobSystem::Submit([this, content = std::move(content)](const CancelToken&) {
+        if (!WriteFile(content)) {
+            FileLogger::GetInstance().LogError("[Config] Failed to save %s", mConfigPath.c_str());
+        }
+    });
+}
+
+void Config::Flush() {
+    mSaveJob.Wait();
+    mSaveJob = JobHandle();
+    bool dirty;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        dirty = mDirty;
+    }
+    if (dirty) {
+        Save();
+    }
+}
+
 bool Config::Save() {
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        content = Serialize();
+        mDirty = false;
+        mLastSave = Clock::now();
+    }
+    return WriteFile(content);
+}
+
+bool Config::WriteFile(const std::string& content) const {
     // 确保目录存在
     const char* dirPath = "fs:/vol/external01/wiiu";
     struct stat st;
@@ -118,35 +223,91 @@ bool Config::Save() {
         mkdir(dirPath, 0777);
     }
     
-    FILE* file = fopen(mConfigPath.c_str(), "w");
+    // 先写临时文件, 写入中断时原来的配置不受影响
+    const std::string tempPath = mConfigPath + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "w");
     if (!file) {
         return false;
     }
+    bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    // FAT 上不能改名覆盖已有的文件
+    remove(mConfigPath.c_str());
+    if (rename(tempPath.c_str(), mConfigPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string Config::Serialize() const {
+    std::string out;
+    out.reserve(1024);
+    auto line = [&out](const char* fmt, auto... args) {
+        char buf[640];
+        int n = snprintf(buf, sizeof(buf), fmt, args...);
+        if (n > 0) {
+            out.append(buf, std::min((size_t) n, sizeof(buf) - 1));
+        }
+    };
     
-    fprintf(file, "# UTheme Configuration File\n");
-    fprintf(file, "# This file is automatically generated\n\n");
+    out += "# UTheme Configuration File\n";
+    out += "# This file is automatically generated\n\n";
     
-    fprintf(file, "# Logging settings\n");
-    fprintf(file, "logging=%d\n", mLoggingEnabled ? 1 : 0);
-    fprintf(file, "verbose=%d\n", mVerboseLogging ? 1 : 0);
-    fprintf(file, "\n");
+    out += "# Logging settings\n";
+    line("logging=%d\n", mLoggingEnabled ? 1 : 0);
+    line("verbose=%d\n", mVerboseLogging ? 1 : 0);
+    out += "\n";
     
-    fprintf(file, "# Language (zh-cn, en-us, ja-jp)\n");
-    fprintf(file, "language=%s\n", mLanguage.c_str());
-    fprintf(file, "\n");
+    out += "# Language (zh-cn, en-us, ja-jp)\n";
+    line("language=%s\n", mLanguage.c_str());
+    out += "\n";
     
-    fprintf(file, "# Download path\n");
-    fprintf(file, "downloadpath=%s\n", mDownloadPath.c_str());
-    fprintf(file, "\n");
+    out += "# Download path\n";
+    line("downloadpath=%s\n", mDownloadPath.c_str());
+    out += "\n";
     
-    fprintf(file, "# Auto install after download\n");
-    fprintf(file, "autoinstall=%d\n", mAutoInstall ? 1 : 0);
-    fprintf(file, "\n");
+    out += "# Auto install after download\n";
+    line("autoinstall=%d\n", mAutoInstall ? 1 : 0);
+    out += "\n";
     
-    fprintf(file, "# Background music\n");
-    fprintf(file, "bgm=%d\n", mBgmEnabled ? 1 : 0);
-    fprintf(file, "bgmurl=%s\n", mBgmUrl.c_str());
+    out += "# Background music\n";
+    line("bgm=%d\n", mBgmEnabled ? 1 : 0);
+    line("bgmurl=%s\n", mBgmUrl.c_str());
+    out += "# Music while installing, extracting or backing up (0 keep playing, 1 pause, 2 fade out and pause)\n";
+    line("bgmwork=%d\n", (int)mBgmWorkMode);
+    out += "\n";
     
-    fclose(file);
-    return true;
+    out += "# StyleMiiU plugin installed (set to 0 to check again)\n";
+    line("stylemiiu=%d\n", mStyleMiiUPresent ? 1 : 0);
+    out += "\n";
+    
+    out += "# 16-bit textures for opaque HD previews (half the texture memory)\n";
+    line("compactpreviews=%d\n", mCompactPreviews ? 1 : 0);
+    out += "\n";
+    
+    out += "# Run the benchmark scenarios after startup (results in UTheme/benchmark/)\n";
+    line("benchmark=%d\n", mBenchmarkOnLaunch ? 1 : 0);
+    out += "\n";
+    
+    out += "# Keep one shared copy of identical patched files of inactive themes (UTheme/store/)\n";
+    line("patchstore=%d\n", mPatchStore ? 1 : 0);
+    out += "\n";
+    
+    out += "# Performance profile (-1 auto from memory and network speed, 0 low, 1 normal, 2 high)\n";
+    line("perfprofile=%d\n", mPerfProfile);
+    out += "\n";
+    
+    out += "# Broadcast performance metrics once a second over UDP (JSON lines on port 4406)\n";
+    line("metrics=%d\n", mMetricsStream ? 1 : 0);
+    out += "\n";
+    
+    out += "# Inflate ZIP entries that fit in one buffer in a single call (compare with the inflate benchmarks)\n";
+    line("directinflate=%d\n", mDirectInflate ? 1 : 0);
+    
+    return out;
 }
@@ -1,8 +1,16 @@
 #pragma once
+#include "JobSystem.hpp"
+#include <chrono>
+#include <mutex>
 #include <string>
 
+// 设置项修改后只标记为待保存, 由 Update 合并成一次写入: 最后一次修改后等待 SAVE_DELAY_MS,
+// 两次写入至少间隔 SAVE_INTERVAL_MS, 在后台任务中先写 .tmp 再改名; 退出时 Flush 写出剩下的修改
 class Config {
 public:
+    static constexpr int SAVE_DELAY_MS = 500;
+    static constexpr int SAVE_INTERVAL_MS = 2000;
+
     static Config& GetInstance();
     
     // 日志设置
@@ -13,11 +21,11 @@ public:
     void SetVerboseLogging(bool verbose);
     
     // 语言设置
-    std::string GetLanguage() const { return mLanguage; }
+    std::string GetLanguage() const { std::lock_guard<std::mutex> lock(mMutex); return mLanguage; }
     void SetLanguage(const std::string& lang);
     
     // 下载路径设置
-    std::string GetDownloadPath() const { return mDownloadPath; }
+    std::string GetDownloadPath() const { std::lock_guard<std::mutex> lock(mMutex); return mDownloadPath; }
     void SetDownloadPath(const std::string& path);
     
     // 自动安装设置
@@ -28,19 +36,61 @@ public:
     bool IsBgmEnabled() const { return mBgmEnabled; }
     void SetBgmEnabled(bool enabled);
     
-    std::string GetBgmUrl() const { return mBgmUrl; }
+    std::string GetBgmUrl() const { std::lock_guard<std::mutex> lock(mMutex); return mBgmUrl; }
     void SetBgmUrl(const std::string& url);
     
-    // 加载/保存配置
+    // 安装主题、解压、备份期间背景音乐怎么办 (不再占用解码的 CPU), 只能在配置文件中设置
+    enum BgmWorkMode {
+        BGM_WORK_PLAY = 0,   // 照常播放
+        BGM_WORK_PAUSE = 1,  // 立即暂停, 结束后继续
+        BGM_WORK_FADE = 2    // 淡出后暂停, 结束后继续并淡入
+    };
+    BgmWorkMode GetBgmWorkMode() const { return mBgmWorkMode; }
+    
+    // StyleMiiU 插件已确认存在 (之后启动不再检查文件)
+    bool IsStyleMiiUPresent() const { return mStyleMiiUPresent; }
+    void SetStyleMiiUPresent(bool present);
+    
+    // 高清预览图使用 16 位纹理 (RGB565, 只用于不透明的图片), 显存减半
+    bool IsCompactPreviewsEnabled() const { return mCompactPreviews; }
+    void SetCompactPreviewsEnabled(bool enabled);
+    
+    // 启动后自动运行一次基准测试 (结果写入 UTheme/benchmark/), 只能在配置文件中设置
+    bool IsBenchmarkOnLaunch() const { return mBenchmarkOnLaunch; }
+    
+    // 不是当前主题的补丁输出移入共享的内容寻址存储 (PatchStore), 只能在配置文件中设置
+    bool IsPatchStoreEnabled() const { return mPatchStore; }
+    
+    // 解压 ZIP 时能放进缓冲区的条目一次解压到目标里 (ZipIndex::INFLATE_DIRECT), 只能在配置文件中设置
+    bool IsDirectInflateEnabled() const { return mDirectInflate; }
+    
+    // 每秒把性能数据用 UDP 广播给电脑上的接收程序 (MetricsStream), 只能在配置文件中设置
+    bool IsMetricsStreamEnabled() const { return mMetricsStream; }
+    
+    // 固定的性能档位 (PerfProfile::Tier), -1 为按内存和网络自动选择, 只能在配置文件中设置
+    int GetPerfProfile() const { return mPerfProfile; }
+    
+    // 加载/保存配置; Save 在调用线程上立即写入
     bool Load();
     bool Save();
     
+    // 每帧在主线程调用: 到时间时在后台写入待保存的修改
+    void Update();
+    // 退出时调用: 等待后台写入结束, 再同步写入剩下的修改
+    void Flush();
+    
 private:
     Config();
     ~Config();
     Config(const Config&) = delete;
     Config& operator=(const Config&) = delete;
     
+    using Clock = std::chrono::steady_clock;
+    
+    void MarkDirty();                   // 调用者持有 mMutex
+    std::string Serialize() const;      // 调用者持有 mMutex
+    bool WriteFile(const std::string& content) const;
+    
     bool mLoggingEnabled;
     bool mVerboseLogging;
     std::string mLanguage;          // 语言代码: "zh-cn", "en-us", "ja-jp"
@@ -48,5 +98,20 @@ private:
     bool mAutoInstall;              // 下载后自动安装
     bool mBgmEnabled;               // 背景音乐开关
     std::string mBgmUrl;            // BGM下载地址
+    BgmWorkMode mBgmWorkMode;       // 耗时工作期间的背景音乐
+    bool mStyleMiiUPresent;         // StyleMiiU 插件已存在
+    bool mCompactPreviews;          // 高清预览图使用 16 位纹理
+    bool mBenchmarkOnLaunch;        // 启动后运行基准测试
+    bool mPatchStore;               // 补丁输出去重存储
+    int mPerfProfile;               // 性能档位, -1 为自动
+    bool mMetricsStream;            // UDP 性能数据
+    bool mDirectInflate;            // 整个条目一次解压
     std::string mConfigPath;
+    
+    // 保存状态; 设置项可能在下载线程中修改 (SetStyleMiiUPresent), 由 mMutex 保护
+    mutable std::mutex mMutex;
+    bool mDirty = false;
+    Clock::time_point mLastChange;
+    Clock::time_point mLastSave;
+    JobHandle mSaveJob;
 };
@@ -0,0 +1,1009 @@
+#include "DiskCacheIndex.hpp"
+#include "FileLogger.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <unordered_set>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const char* INDEX_FILE = "index.txt";
+static const char* INDEX_MAGIC = "UTCI";
+// 版本 2 增加了打包文件中的位置和数据校验值; 版本 1 的条目都是单独的文件, 照常读入
+static const int INDEX_VERSION = 2;
+static const char* PACK_FILE = "pack.dat";
+// CompactPack 换文件前写下的新索引 (条目在新打包文件中的位置)
+static const char* COMPACT_INDEX_FILE = "index.compact";
+
+//------------------------------------------------------------------------------
+// XXH64 (按小端读取输入, 结果与参考实现一致)
+
+static const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t XxhRotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t XxhRead64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline uint32_t XxhRead32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t XxhRound(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = XxhRotl(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t XxhMergeRound(uint64_t acc, uint64_t val) {
+    acc ^= XxhRound(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static uint64_t Xxh64(const uint8_t* p, size_t len, uint64_t seed) {
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = XxhRound(v1, XxhRead64(p));
+            v2 = XxhRound(v2, XxhRead64(p + 8));
+            v3 = XxhRound(v3, XxhRead64(p + 16));
+            v4 = XxhRound(v4, XxhRead64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = XxhRotl(v1, 1) + XxhRotl(v2, 7) + XxhRotl(v3, 12) + XxhRotl(v4, 18);
+        h = XxhMergeRound(h, v1);
+        h = XxhMergeRound(h, v2);
+        h = XxhMergeRound(h, v3);
+        h = XxhMergeRound(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+
+    h += (uint64_t)len;
+
+    while (p + 8 <= end) {
+        h ^= XxhRound(0, XxhRead64(p));
+        h = XxhRotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)XxhRead32(p) * XXH_PRIME64_1;
+        h = XxhRotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = XxhRotl(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t DiskCacheIndex::Hash(const std::string& url) {
+    return Xxh64((const uint8_t*)url.data(), url.size(), 0);
+}
+
+//------------------------------------------------------------------------------
+
+// 按文件头判断类型 (只用于文件扩展名, 解码时会重新检测)
+static const char* SniffType(const void* data, uint64_t size) {
+    const uint8_t* b = (const uint8_t*)data;
+    if (!b || size < 4) {
+        return "bin";
+    }
+    if (b[0] == 0xFF && b[1] == 0xD8 && b[2] == 0xFF) {
+        return "jpg";
+    }
+    if (b[0] == 0x89 && b[1] == 'P' && b[2] == 'N' && b[3] == 'G') {
+        return "png";
+    }
+    if (size >= 12 && memcmp(b, "RIFF", 4) == 0 && memcmp(b + 8, "WEBP", 4) == 0) {
+        return "webp";
+    }
+    if (memcmp(b, "GIF", 3) == 0) {
+        return "gif";
+    }
+    return "bin";
+}
+
+// 把一行按 '\t' 拆开 (字段中不会出现制表符和换行)
+static std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        if (tab == std::string::npos) {
+            fields.push_back(line.substr(start));
+            break;
+        }
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    return fields;
+}
+
+// 校验信息来自服务器响应头, 去掉会破坏索引格式的字符
+static std::string CleanField(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c != '\t' && c != '\r' && c != '\n') {
+            out += c;
+        }
+    }
+    return out;
+}
+
+DiskCacheIndex::DiskCacheIndex(const std::string& dir, uint64_t budget)
+    : mDir(dir), mBudget(budget) {
+    if (!mDir.empty() && mDir.back() != '/') {
+        mDir += '/';
+    }
+}
+
+void DiskCacheIndex::RecoverCompactionLocked() {
+    std::string packPath = mDir + PACK_FILE;
+    std::string tempPackPath = packPath + ".tmp";
+    std::string compactPath = mDir + COMPACT_INDEX_FILE;
+    struct stat st;
+    if (stat(compactPath.c_str(), &st) != 0) {
+        return; // 新索引写完之前中断: .tmp 不完整, 旧文件仍然有效 (.tmp 由下面的清理删除)
+    }
+    bool havePack = stat(packPath.c_str(), &st) == 0;
+    bool haveTemp = stat(tempPackPath.c_str(), &st) == 0;
+    if (havePack && haveTemp) {
+        // 删除旧文件之前中断
+        unlink(tempPackPath.c_str());
+        unlink(compactPath.c_str());
+        return;
+    }
+    if (!havePack && !haveTemp) {
+        unlink(compactPath.c_str());
+        return;
+    }
+    if (haveTemp && rename(tempPackPath.c_str(), packPath.c_str()) != 0) {
+        FileLogger::GetInstance().LogError("[DiskCache] Failed to recover compacted pack file");
+        return;
+    }
+    // 新的打包文件已经就位, 旧索引中的位置对不上它
+    std::string indexPath = mDir + INDEX_FILE;
+    remove(indexPath.c_str());
+    if (rename(compactPath.c_str(), indexPath.c_str()) != 0) {
+        FileLogger::GetInstance().LogError("[DiskCache] Failed to recover index after compaction");
+        return;
+    }
+    FileLogger::GetInstance().LogWarning("[DiskCache] Recovered interrupted pack compaction");
+}
+
+bool DiskCacheIndex::Load() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+    mFiles.clear();
+    mTotalBytes = 0;
+    RecoverCompactionLocked();
+
+    std::string indexPath = mDir + INDEX_FILE;
+    FILE* file = fopen(indexPath.c_str(), "r");
+    bool loaded = false;
+    int version = 0;
+    if (file) {
+        std::string line;
+        char buffer[1024];
+        bool header = true;
+        while (fgets(buffer, sizeof(buffer), file)) {
+            line += buffer;
+            if (line.empty() || line.back() != '\n') {
+                continue; // 超长的行, 继续读
+            }
+            line.pop_back();
+
+            std::vector<std::string> fields = SplitFields(line);
+            line.clear();
+
+            if (header) {
+                header = false;
+                version = fields.size() >= 2 ? atoi(fields[1].c_str()) : 0;
+                if (fields[0] != INDEX_MAGIC || version < 1 || version > INDEX_VERSION) {
+                    FileLogger::GetInstance().LogWarning("[DiskCache] Index version mismatch, starting empty");
+                    break;
+                }
+                loaded = true;
+                continue;
+            }
+
+            // file size type lastAccess validatedAt etag lastModified variants [packOffset hash] url
+            size_t fieldCount = version >= 2 ? 11 : 9;
+            if (fields.size() != fieldCount || fields[0].empty() || fields.back().empty()) {
+                continue;
+            }
+            Entry entry;
+            entry.file = fields[0];
+            entry.size = strtoull(fields[1].c_str(), nullptr, 10);
+            entry.type = fields[2];
+            entry.lastAccess = strtoll(fields[3].c_str(), nullptr, 10);
+            entry.validatedAt = strtoll(fields[4].c_str(), nullptr, 10);
+            entry.etag = fields[5];
+            entry.lastModified = fields[6];
+
+            // 后缀:大小;后缀:大小
+            const std::string& variants = fields[7];
+            size_t start = 0;
+            while (start < variants.size()) {
+                size_t end = variants.find(';', start);
+                if (end == std::string::npos) {
+                    end = variants.size();
+                }
+                std::string item = variants.substr(start, end - start);
+                size_t colon = item.rfind(':');
+                if (colon != std::string::npos && colon > 0) {
+                    entry.variants.emplace_back(item.substr(0, colon), strtoull(item.c_str() + colon + 1, nullptr, 10));
+                }
+                start = end + 1;
+            }
+
+            if (version >= 2) {
+                entry.packOffset = strtoll(fields[8].c_str(), nullptr, 10);
+                entry.hash = strtoull(fields[9].c_str(), nullptr, 16);
+            }
+
+            if (mFiles.count(entry.file)) {
+                continue;
+            }
+            mFiles[entry.file] = fields.back();
+            mTotalBytes += EntryBytes(entry);
+            mEntries[fields.back()] = std::move(entry);
+        }
+        fclose(file);
+    }
+
+    // 打包文件比索引记录的短 (上次写入时断电等): 超出末尾的条目作废
+    // 索引没来得及写回的追加数据留在末尾, 压缩时回收
+    int lost = 0;
+    mPackLive = 0;
+    {
+        std::lock_guard<std::mutex> packLock(mPackMutex);
+        OpenPackLocked();
+        for (auto it = mEntries.begin(); it != mEntries.end();) {
+            const Entry& entry = it->second;
+            if (entry.packOffset < 0) {
+                ++it;
+            } else if ((uint64_t)entry.packOffset + entry.size > mPackEnd) {
+                mTotalBytes -= EntryBytes(entry);
+                RemoveFilesLocked(entry);
+                mFiles.erase(entry.file);
+                it = mEntries.erase(it);
+                lost++;
+            } else {
+                mPackLive += entry.size;
+                ++it;
+            }
+        }
+    }
+
+    // 删除不属于任何条目的文件
+    std::unordered_set<std::string> keep;
+    keep.insert(INDEX_FILE);
+    keep.insert(PACK_FILE);
+    for (const auto& pair : mEntries) {
+        keep.insert(pair.second.file);
+        for (const auto& variant : pair.second.variants) {
+            keep.insert(pair.second.file + variant.first);
+        }
+    }
+
+    int orphans = 0;
+    DIR* dir = opendir(mDir.c_str());
+    if (dir) {
+        struct dirent* dp;
+        std::vector<std::string> remove;
+        while ((dp = readdir(dir)) != nullptr) {
+            if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) {
+                continue;
+            }
+            if (!keep.count(dp->d_name)) {
+                remove.push_back(dp->d_name);
+            }
+        }
+        closedir(dir);
+
+        for (const auto& name : remove) {
+            if (unlink((mDir + name).c_str()) == 0) {
+                orphans++;
+            }
+        }
+    }
+
+    FileLogger::GetInstance().LogInfo("[DiskCache] %zu entries, %llu KB (budget %llu KB), pack %llu KB, "
+                                      "removed %d stray file(s) and %d truncated entr%s",
+                                      mEntries.size(), (unsigned long long)(mTotalBytes / 1024),
+                                      (unsigned long long)(mBudget / 1024), (unsigned long long)(mPackEnd / 1024),
+                                      orphans, lost, lost == 1 ? "y" : "ies");
+
+    mDirty = !loaded || version != INDEX_VERSION || orphans > 0 || lost > 0;
+    mPendingChanges = 0;
+    EvictLocked(std::string());
+    return loaded;
+}
+
+bool DiskCacheIndex::Save() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return SaveLocked();
+}
+
+bool DiskCacheIndex::WriteIndexLocked(const std::string& path,
+                                      const std::unordered_map<std::string, int64_t>* packOffsets) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[DiskCache] Failed to write index: %s", path.c_str());
+        return false;
+    }
+
+    bool ok = fprintf(file, "%s\t%d\n", INDEX_MAGIC, INDEX_VERSION) > 0;
+    for (const auto& pair : mEntries) {
+        const Entry& entry = pair.second;
+        int64_t packOffset = entry.packOffset;
+        if (packOffsets && packOffset >= 0) {
+            auto moved = packOffsets->find(pair.first);
+            if (moved == packOffsets->end()) {
+                continue;
+            }
+            packOffset = moved->second;
+        }
+        std::string variants;
+        for (const auto& variant : entry.variants) {
+            if (!variants.empty()) {
+                variants += ';';
+            }
+            variants += variant.first + ":" + std::to_string(variant.second);
+        }
+        ok = fprintf(file, "%s\t%llu\t%s\t%lld\t%lld\t%s\t%s\t%s\t%lld\t%016llx\t%s\n",
+                     entry.file.c_str(), (unsigned long long)entry.size, entry.type.c_str(),
+                     (long long)entry.lastAccess, (long long)entry.validatedAt,
+                     entry.etag.c_str(), entry.lastModified.c_str(), variants.c_str(),
+                     (long long)packOffset, (unsigned long long)entry.hash,
+                     pair.first.c_str()) > 0 && ok;
+    }
+    ok = (fflush(file) == 0 && fsync(fileno(file)) == 0) && ok;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        unlink(path.c_str());
+    }
+    return ok;
+}
+
+bool DiskCacheIndex::SaveLocked() {
+    if (!mDirty) {
+        return true;
+    }
+
+    std::string indexPath = mDir + INDEX_FILE;
+    std::string tempPath = indexPath + ".tmp";
+    bool ok = WriteIndexLocked(tempPath, nullptr);
+
+    // FAT 上不能改名覆盖已有的文件
+    if (ok) {
+        remove(indexPath.c_str());
+    }
+    if (!ok || rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[DiskCache] Failed to save index");
+        return false;
+    }
+
+    if (mCompactIndexPending) {
+        unlink((mDir + COMPACT_INDEX_FILE).c_str());
+        mCompactIndexPending = false;
+    }
+    mDirty = false;
+    mPendingChanges = 0;
+    return true;
+}
+
+void DiskCacheIndex::NoteChangeLocked() {
+    mDirty = true;
+    if (++mPendingChanges >= SAVE_AFTER_CHANGES) {
+        SaveLocked();
+    }
+}
+
+uint64_t DiskCacheIndex::EntryBytes(const Entry& entry) {
+    uint64_t bytes = entry.size;
+    for (const auto& variant : entry.variants) {
+        bytes += variant.second;
+    }
+    return bytes;
+}
+
+bool DiskCacheIndex::Find(const std::string& url, Entry& entry, bool touch) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(url);
+    if (it == mEntries.end()) {
+        return false;
+    }
+    if (touch) {
+        it->second.lastAccess = (int64_t)time(NULL);
+        mDirty = true;
+    }
+    entry = it->second;
+    return true;
+}
+
+std::string DiskCacheIndex::GetPath(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(url);
+    return (it == mEntries.end()) ? std::string() : mDir + it->second.file;
+}
+
+std::string DiskCacheIndex::Insert(const std::string& url, const void* data, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::string path = mDir + InsertLocked(url, SniffType(data, size), size).file;
+    EvictLocked(url);
+    NoteChangeLocked();
+    return path;
+}
+
+DiskCacheIndex::Entry& DiskCacheIndex::InsertLocked(const std::string& url, const char* type, uint64_t size) {
+    Entry entry;
+    auto it = mEntries.find(url);
+    if (it != mEntries.end()) {
+        // 新数据替换旧数据: 派生的文件已经过期
+        entry = it->second;
+        for (const auto& variant : entry.variants) {
+            unlink((mDir + entry.file + variant.first).c_str());
+        }
+        mTotalBytes -= EntryBytes(entry);
+        entry.variants.clear();
+        if (entry.packOffset >= 0) {
+            // 打包文件中的旧数据留到压缩时回收
+            mPackLive -= entry.size;
+            entry.packOffset = -1;
+            entry.hash = 0;
+        } else {
+            // 单独的文件: Insert 的调用者会重新写入, Store 之后不再使用
+            unlink((mDir + entry.file).c_str());
+        }
+        if (entry.type != type) {
+            mFiles.erase(entry.file);
+            entry.file.clear();
+        }
+    }
+
+    if (entry.file.empty()) {
+        // XXH64 作为文件名, 和其他 URL 冲突时加序号
+        char base[17];
+        snprintf(base, sizeof(base), "%016llx", (unsigned long long)Hash(url));
+        std::string name = std::string(base) + "." + type;
+        for (int n = 1; mFiles.count(name) && mFiles[name] != url; n++) {
+            name = std::string(base) + "-" + std::to_string(n) + "." + type;
+        }
+        entry.file = name;
+        mFiles[name] = url;
+    }
+
+    entry.size = size;
+    entry.type = type;
+    entry.lastAccess = (int64_t)time(NULL);
+    mTotalBytes += EntryBytes(entry);
+    Entry& stored = mEntries[url];
+    stored = std::move(entry);
+    return stored;
+}
+
+// 调用者持有 mPackMutex
+bool DiskCacheIndex::OpenPackLocked() {
+    if (mPack.IsOpen()) {
+        return true;
+    }
+    if (!mPack.Open(mDir + PACK_FILE, FileIO::MODE_UPDATE)) {
+        FileLogger::GetInstance().LogError("[DiskCache] Failed to open pack file");
+        mPackEnd = 0;
+        return false;
+    }
+    mPackEnd = mPack.Size();
+    return true;
+}
+
+bool DiskCacheIndex::Store(const std::string& url, const void* data, uint64_t size) {
+    if (!data || size == 0 || size > MAX_DATA_SIZE) {
+        return false;
+    }
+    uint64_t hash = Xxh64((const uint8_t*)data, (size_t)size, 0);
+
+    // 先追加数据再登记条目, 写入时不持有 mMutex, 查询不用等 SD 卡
+    uint64_t offset;
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> packLock(mPackMutex);
+        if (!OpenPackLocked()) {
+            return false;
+        }
+        offset = mPackEnd;
+        if (!mPack.Seek(offset) || !mPack.Write(data, (size_t)size)) {
+            // 写了一部分的数据留在末尾之后, 下次追加时覆盖
+            FileLogger::GetInstance().LogError("[DiskCache] Failed to append %llu bytes to pack", (unsigned long long)size);
+            return false;
+        }
+        mPackEnd += size;
+        generation = mPackGeneration;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (generation != mPackGeneration) {
+        // 写入之后、登记之前换上了压缩后的文件, 刚写的数据不在新文件里
+        return false;
+    }
+    Entry& entry = InsertLocked(url, SniffType(data, size), size);
+    entry.packOffset = (int64_t)offset;
+    entry.hash = hash;
+    mPackLive += size;
+    EvictLocked(url);
+    NoteChangeLocked();
+    return true;
+}
+
+bool DiskCacheIndex::Read(const std::string& url, std::vector<uint8_t>& out) {
+    out.clear();
+    // 读取之前压缩换上了新文件时重新取一次位置
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Entry entry;
+        uint32_t generation;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mEntries.find(url);
+            if (it == mEntries.end()) {
+                return false;
+            }
+            it->second.lastAccess = (int64_t)time(NULL);
+            mDirty = true;
+            entry = it->second;
+            generation = mPackGeneration;
+        }
+
+        bool ok;
+        if (entry.packOffset < 0) {
+            // 旧版本写入的单独文件; 被外部删除时条目作废
+            ok = FileIO::ReadAll(mDir + entry.file, out) && !out.empty() && out.size() <= MAX_DATA_SIZE;
+        } else {
+            std::lock_guard<std::mutex> packLock(mPackMutex);
+            if (generation != mPackGeneration) {
+                continue;
+            }
+            out.resize((size_t)entry.size);
+            ok = OpenPackLocked() &&
+                 mPack.ReadAt((uint64_t)entry.packOffset, out.data(), out.size()) == out.size();
+        }
+        if (ok && entry.packOffset >= 0 && Xxh64(out.data(), out.size(), 0) != entry.hash) {
+            FileLogger::GetInstance().LogWarning("[DiskCache] Checksum mismatch, dropping %s", url.c_str());
+            ok = false;
+        }
+        if (!ok) {
+            out.clear();
+            // 只删除读取时的那份数据, 期间重新写入的条目保留
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mEntries.find(url);
+            if (it != mEntries.end() && it->second.packOffset == entry.packOffset && it->second.file == entry.file) {
+                EraseLocked(it);
+                NoteChangeLocked();
+            }
+        }
+        return ok;
+    }
+    return false;
+}
+
+void DiskCacheIndex::Close() {
+    std::lock_guard<std::mutex> packLock(mPackMutex);
+    mPack.Close();
+}
+
+bool DiskCacheIndex::CompactPack(const std::function<bool()>& keepGoing) {
+    struct Move {
+        std::string url;
+        int64_t oldOffset;
+        int64_t newOffset;
+        uint64_t size;
+    };
+    std::vector<Move> moves;
+    uint64_t snapshotEnd;
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::lock_guard<std::mutex> packLock(mPackMutex);
+        uint64_t waste = mPackEnd - mPackLive;
+        if (waste < PACK_COMPACT_MIN || waste * 4 < mPackEnd) {
+            return true;
+        }
+        for (const auto& pair : mEntries) {
+            if (pair.second.packOffset >= 0) {
+                moves.push_back({pair.first, pair.second.packOffset, -1, pair.second.size});
+            }
+        }
+        snapshotEnd = mPackEnd;
+        generation = mPackGeneration;
+    }
+    // 按原来的顺序复制, 读取旧文件时顺序前进
+    std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) { return a.oldOffset < b.oldOffset; });
+
+    std::string packPath = mDir + PACK_FILE;
+    std::string tempPath = packPath + ".tmp";
+    FileIO out;
+    if (!out.Open(tempPath, FileIO::MODE_WRITE)) {
+        return true;
+    }
+    uint64_t liveBytes = 0;
+    for (const Move& move : moves) {
+        liveBytes += move.size;
+    }
+    out.Reserve(liveBytes);
+
+    // 复制一条数据: 旧文件 -> 新文件末尾, 调用者持有 mPackMutex
+    std::vector<uint8_t> buffer;
+    auto copyLocked = [&](int64_t oldOffset, uint64_t size, int64_t& newOffset) {
+        buffer.resize((size_t)size);
+        newOffset = (int64_t)out.Tell();
+        return mPack.ReadAt((uint64_t)oldOffset, buffer.data(), buffer.size()) == buffer.size() &&
+               out.Write(buffer.data(), buffer.size());
+    };
+
+    bool ok = true;
+    for (Move& move : moves) {
+        if (!keepGoing()) {
+            out.Close();
+            unlink(tempPath.c_str());
+            return false;
+        }
+        std::lock_guard<std::mutex> packLock(mPackMutex);
+        ok = generation == mPackGeneration && OpenPackLocked() && copyLocked(move.oldOffset, move.size, move.newOffset);
+        if (!ok) {
+            break;
+        }
+    }
+
+    // 换上新文件: 复制期间追加的数据也复制过去, 然后更新所有条目的位置
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::lock_guard<std::mutex> packLock(mPackMutex);
+    std::unordered_map<std::string, int64_t> newOffsets;
+    if (ok) {
+        for (const Move& move : moves) {
+            auto it = mEntries.find(move.url);
+            // 复制期间替换或删除的条目不用管
+            if (it != mEntries.end() && it->second.packOffset == move.oldOffset) {
+                newOffsets[move.url] = move.newOffset;
+            }
+        }
+        for (const auto& pair : mEntries) {
+            if (!ok) {
+                break;
+            }
+            if (pair.second.packOffset >= (int64_t)snapshotEnd) {
+                int64_t newOffset;
+                ok = copyLocked(pair.second.packOffset, pair.second.size, newOffset);
+                newOffsets[pair.first] = newOffset;
+            }
+        }
+    }
+    uint64_t newEnd = out.Tell();
+    ok = out.Sync() && out.Close() && ok;
+
+    // 换文件前先写下新的位置: FAT 上不能改名覆盖已有的文件, 删除旧文件到改名之间中断时
+    // 下次 Load 用 .tmp 和 index.compact 恢复 (RecoverCompactionLocked)
+    std::string compactPath = mDir + COMPACT_INDEX_FILE;
+    ok = ok && WriteIndexLocked(compactPath, &newOffsets);
+    bool removedOld = false;
+    if (ok) {
+        mPack.Close();
+        removedOld = remove(packPath.c_str()) == 0;
+        ok = removedOld && rename(tempPath.c_str(), packPath.c_str()) == 0;
+    }
+    if (!ok) {
+        unlink(tempPath.c_str());
+        unlink(compactPath.c_str());
+        if (removedOld) {
+            // 旧文件已经删除但新文件没能换上: 打包文件中的条目全部作废
+            mPackGeneration++;
+            for (auto it = mEntries.begin(); it != mEntries.end();) {
+                auto next = std::next(it);
+                if (it->second.packOffset >= 0) {
+                    EraseLocked(it);
+                }
+                it = next;
+            }
+            mDirty = true;
+            SaveLocked();
+        }
+        FileLogger::GetInstance().LogError("[DiskCache] Failed to compact pack file");
+        return true;
+    }
+    mCompactIndexPending = true;
+
+    uint64_t oldEnd = mPackEnd;
+    mPackGeneration++;
+    mPackLive = 0;
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (it->second.packOffset < 0) {
+            ++it;
+            continue;
+        }
+        auto moved = newOffsets.find(it->first);
+        if (moved == newOffsets.end()) {
+            // 不应该发生: 不在新文件里的条目作废
+            mTotalBytes -= EntryBytes(it->second);
+            RemoveFilesLocked(it->second);
+            mFiles.erase(it->second.file);
+            it = mEntries.erase(it);
+            continue;
+        }
+        it->second.packOffset = moved->second;
+        mPackLive += it->second.size;
+        ++it;
+    }
+    OpenPackLocked();
+    mPackEnd = newEnd;
+    // 新的位置马上写回, 否则下次启动时旧索引的位置对不上新文件 (校验值会发现, 但缓存就丢了)
+    mDirty = true;
+    SaveLocked();
+    FileLogger::GetInstance().LogInfo("[DiskCache] Compacted pack file: %llu KB -> %llu KB",
+                                      (unsigned long long)(oldEnd / 1024), (unsigned long long)(newEnd / 1024));
+    return true;
+}
+
+void DiskCacheIndex::RemoveFilesLocked(const Entry& entry) {
+    if (entry.packOffset < 0) {
+        unlink((mDir + entry.file).c_str());
+    }
+    for (const auto& variant : entry.variants) {
+        unlink((mDir + entry.file + variant.first).c_str());
+    }
+}
+
+void DiskCacheIndex::EraseLocked(std::unordered_map<std::string, Entry>::iterator it) {
+    RemoveFilesLocked(it->second);
+    if (it->second.packOffset >= 0) {
+        mPackLive -= it->second.size;
+    }
+    mTotalBytes -= EntryBytes(it->second);
+    mFiles.erase(it->second.file);
+    mEntries.erase(it);
+}
+
+void DiskCacheIndex::Remove(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(url);
+    if (it != mEntries.end()) {
+        EraseLocked(it);
+        NoteChangeLocked();
+    }
+}
+
+void DiskCacheIndex::EvictLocked(const std::string& keepUrl) {
+    if (mTotalBytes <= mBudget) {
+        return;
+    }
+
+    // 按最后使用时间从旧到新淘汰, 刚写入的条目保留
+    std::vector<std::pair<int64_t, std::string>> order;
+    order.reserve(mEntries.size());
+    for (const auto& pair : mEntries) {
+        if (pair.first != keepUrl) {
+            order.emplace_back(pair.second.lastAccess, pair.first);
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    int evicted = 0;
+    for (const auto& item : order) {
+        if (mTotalBytes <= mBudget) {
+            break;
+        }
+        auto it = mEntries.find(item.second);
+        if (it != mEntries.end()) {
+            EraseLocked(it);
+            evicted++;
+        }
+    }
+
+    if (evicted > 0) {
+        mDirty = true;
+        FileLogger::GetInstance().LogInfo("[DiskCache] Evicted %d entr%s, now %llu KB", evicted,
+                                          evicted == 1 ? "y" : "ies", (unsigned long long)(mTotalBytes / 1024));
+    }
+}
+
+void DiskCacheIndex::SetValidators(const std::string& url, const std::string& etag, const std::string& lastModified) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(url);
+    if (it == mEntries.end()) {
+        return;
+    }
+    it->second.etag = CleanField(etag);
+    it->second.lastModified = CleanField(lastModified);
+    bool hasValidators = !it->second.etag.empty() || !it->second.lastModified.empty();
+    it->second.validatedAt = hasValidators ? (int64_t)time(NULL) : 0;
+    mDirty = true;
+}
+
+bool DiskCacheIndex::HasVariant(const std::string& url, const std::string& suffix) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(url);
+    if (it == mEntries.end()) {
+        return false;
+    }
+    for (const auto& variant : it->second.variants) {
+        if (variant.first == suffix) {
+            it->second.lastAccess = (int64_t)time(NULL);
+            mDirty = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DiskCacheIndex::AddVariant(const std::string& url, const std::string& suffix, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(url);
+    if (it == mEntries.end()) {
+        // 原始数据已被淘汰, 派生文件下次启动时作为无主文件删除
+        return;
+    }
+
+    auto& variants = it->second.variants;
+    for (auto& variant : variants) {
+        if (variant.first == suffix) {
+            mTotalBytes += size - variant.second;
+            variant.second = size;
+            mDirty = true;
+            return;
+        }
+    }
+    variants.emplace_back(suffix, size);
+    mTotalBytes += size;
+    EvictLocked(url);
+    NoteChangeLocked();
+}
+
+bool DiskCacheIndex::Trim(uint64_t target, const std::function<bool()>& keepGoing) {
+    std::vector<std::pair<int64_t, std::string>> order;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mTotalBytes <= target) {
+            return true;
+        }
+        order.reserve(mEntries.size());
+        for (const auto& pair : mEntries) {
+            order.emplace_back(pair.second.lastAccess, pair.first);
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    int evicted = 0;
+    bool finished = true;
+    for (const auto& item : order) {
+        if (!keepGoing()) {
+            finished = false;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mTotalBytes <= target) {
+            break;
+        }
+        // 取得顺序之后又被使用过的条目留下
+        auto it = mEntries.find(item.second);
+        if (it != mEntries.end() && it->second.lastAccess == item.first) {
+            EraseLocked(it);
+            mDirty = true;
+            evicted++;
+        }
+    }
+
+    if (evicted > 0) {
+        FileLogger::GetInstance().LogInfo("[DiskCache] Trimmed %d entr%s, now %llu KB", evicted,
+                                          evicted == 1 ? "y" : "ies", (unsigned long long)(GetTotalBytes() / 1024));
+    }
+    return finished;
+}
+
+bool DiskCacheIndex::RemoveStrayFiles(const std::function<bool()>& keepGoing) {
+    std::vector<std::string> names;
+    DIR* dir = opendir(mDir.c_str());
+    if (!dir) {
+        return true;
+    }
+    struct dirent* dp;
+    while ((dp = readdir(dir)) != nullptr) {
+        if (strcmp(dp->d_name, ".") != 0 && strcmp(dp->d_name, "..") != 0) {
+            names.push_back(dp->d_name);
+        }
+    }
+    closedir(dir);
+
+    // 派生文件名 = 条目文件名 + 后缀
+    std::unordered_set<std::string> keep;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        keep.insert(INDEX_FILE);
+        keep.insert(std::string(INDEX_FILE) + ".tmp");
+        keep.insert(PACK_FILE);
+        keep.insert(COMPACT_INDEX_FILE);
+        for (const auto& pair : mEntries) {
+            keep.insert(pair.second.file);
+            for (const auto& variant : pair.second.variants) {
+                keep.insert(pair.second.file + variant.first);
+            }
+        }
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    int removed = 0;
+    bool finished = true;
+    for (const auto& name : names) {
+        if (keep.count(name)) {
+            continue;
+        }
+        if (!keepGoing()) {
+            finished = false;
+            break;
+        }
+        std::string path = mDir + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || now - (int64_t)st.st_mtime < STRAY_MIN_AGE) {
+            continue;
+        }
+        // 扫描之后可能有新条目用了这个文件名
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mFiles.count(name) && unlink(path.c_str()) == 0) {
+            removed++;
+        }
+    }
+
+    if (removed > 0) {
+        FileLogger::GetInstance().LogInfo("[DiskCache] Removed %d stray file(s)", removed);
+    }
+    return finished;
+}
+
+uint64_t DiskCacheIndex::GetTotalBytes() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTotalBytes;
+}
+
+uint64_t DiskCacheIndex::GetBudget() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBudget;
+}
+
+size_t DiskCacheIndex::GetEntryCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+void DiskCacheIndex::SetBudget(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBudget = bytes;
+    EvictLocked(std::string());
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <cstdint>
+#include <ctime>
+#include "FileIO.hpp"
+
+// 磁盘缓存索引: URL -> 缓存文件, 启动时从 index.txt 读入一次
+// 查询只访问内存; 文件名由 URL 的 XXH64 决定 (跨工具链稳定), 冲突时顺延
+// 超过容量上限时按最后使用时间淘汰, 同一图片派生的文件 (像素缓存) 一起删除
+// 原始数据 (Store) 追加写入一个打包文件 (pack.dat), 通过一直打开的句柄按偏移读取:
+// FAT32 上一个目录里的小文件越多, 创建、打开和查找越慢, 每个小文件还要占一整簇
+// 打包文件只追加, 删除和替换的数据留在原处, 空闲时由 CompactPack 重写
+// 派生文件仍然是单独的文件, 名称为条目文件名 + 后缀 (条目文件名只作为名称, 打包的数据没有这个文件)
+// 所有方法都可以在任意线程调用
+class DiskCacheIndex {
+public:
+    struct Entry {
+        std::string file;          // 缓存目录中的文件名
+        uint64_t size = 0;
+        std::string type;          // jpg / png / webp / gif / bin (按文件头判断)
+        int64_t lastAccess = 0;    // 最后一次使用的时间
+        int64_t validatedAt = 0;   // 最后一次下载或向服务器确认的时间 (没有校验信息时为 0)
+        std::string etag;
+        std::string lastModified;
+        std::vector<std::pair<std::string, uint64_t>> variants; // 派生文件的后缀和大小
+        int64_t packOffset = -1;   // 数据在打包文件中的位置; -1 表示单独的文件 (旧版本写入的) 或没有数据
+        uint64_t hash = 0;         // 打包数据的 XXH64, 读取时校验
+    };
+
+    DiskCacheIndex(const std::string& dir, uint64_t budget);
+
+    // 读入索引并删除目录中不属于任何条目的文件 (旧版本的缓存和写到一半的文件)
+    bool Load();
+    // 有改动时写回索引 (先写临时文件再改名)
+    bool Save();
+
+    // 查询条目, touch 为 true 时更新最后使用时间
+    bool Find(const std::string& url, Entry& entry, bool touch = true);
+    std::string GetPath(const std::string& url);  // 没有条目时返回空字符串
+
+    // 为即将写入的数据登记条目并返回文件路径, 同时淘汰超出容量的旧条目
+    // 替换已有条目时旧的派生文件失效并被删除; 没有原始数据的条目 (只有派生文件) 用 Insert(url, nullptr, 0)
+    std::string Insert(const std::string& url, const void* data, uint64_t size);
+    // 把数据追加到打包文件并登记条目 (替换已有条目时同 Insert), 写入失败时返回 false
+    bool Store(const std::string& url, const void* data, uint64_t size);
+    // 读出原始数据 (打包的或单独的文件) 并更新最后使用时间; 数据丢失或损坏时删除条目并返回 false
+    bool Read(const std::string& url, std::vector<uint8_t>& out);
+    // 关闭打包文件 (退出时, 在 FileIO::Shutdown 之前); 之后的读写会重新打开
+    void Close();
+    void Remove(const std::string& url);
+
+    // 下载或 304 确认后记录校验信息, validatedAt 更新为当前时间
+    void SetValidators(const std::string& url, const std::string& etag, const std::string& lastModified);
+
+    // 派生文件 (文件名为条目文件名 + suffix), HasVariant 命中时更新最后使用时间
+    bool HasVariant(const std::string& url, const std::string& suffix);
+    void AddVariant(const std::string& url, const std::string& suffix, uint64_t size);
+
+    // 空闲时的整理 (IdleTasks), 在后台线程调用; keepGoing 返回 false 时停止并返回 false
+    // 按最后使用时间淘汰到 target 字节以下, 一次只删除一个条目, 不长时间占用锁
+    bool Trim(uint64_t target, const std::function<bool()>& keepGoing);
+    // 打包文件中删除或替换留下的空间超过 PACK_COMPACT_MIN 和文件的 1/4 时, 把有效数据复制到新文件再换上
+    // 复制期间的写入和读取照常进行, 换上时才短暂持有锁
+    bool CompactPack(const std::function<bool()>& keepGoing);
+    // 删除目录中不属于任何条目的文件 (派生文件写完时原始数据已被淘汰等情况留下的)
+    // 最近 STRAY_MIN_AGE 秒内修改过的文件可能正在写入, 保留
+    bool RemoveStrayFiles(const std::function<bool()>& keepGoing);
+
+    uint64_t GetTotalBytes();
+    uint64_t GetBudget();
+    size_t GetEntryCount();
+    void SetBudget(uint64_t bytes);
+
+    static uint64_t Hash(const std::string& url); // XXH64, seed 0
+
+private:
+    std::string mDir;              // 以 '/' 结尾
+    uint64_t mBudget;
+    uint64_t mTotalBytes = 0;
+    bool mDirty = false;           // 有未写回的改动
+    bool mCompactIndexPending = false; // CompactPack 留下的 index.compact 还没被新的索引取代
+    int mPendingChanges = 0;       // 未写回的新增/删除次数, 达到上限时自动写回
+    std::unordered_map<std::string, Entry> mEntries;
+    std::unordered_map<std::string, std::string> mFiles; // 文件名 -> URL, 用于检测冲突
+    uint64_t mPackLive = 0;        // 打包文件中仍被条目使用的字节数
+    std::mutex mMutex;
+
+    // 打包文件, 由 mPackMutex 保护 (需要两个锁时先取 mMutex); mPackGeneration 只在同时持有两个锁时修改
+    FileIO mPack;
+    uint64_t mPackEnd = 0;         // 下一次追加的位置
+    uint32_t mPackGeneration = 0;  // 每次 CompactPack 换上新文件时加一, 之前取得的偏移作废
+    std::mutex mPackMutex;
+
+    static constexpr int SAVE_AFTER_CHANGES = 32;
+    static constexpr int64_t STRAY_MIN_AGE = 600;
+    static constexpr uint64_t PACK_COMPACT_MIN = 1024 * 1024;
+    static constexpr uint64_t MAX_DATA_SIZE = 10 * 1024 * 1024;  // 单个条目的上限 (更大的视为损坏)
+
+    static uint64_t EntryBytes(const Entry& entry);
+    Entry& InsertLocked(const std::string& url, const char* type, uint64_t size);
+    bool OpenPackLocked();
+    void RemoveFilesLocked(const Entry& entry);
+    void EraseLocked(std::unordered_map<std::string, Entry>::iterator it);
+    void EvictLocked(const std::string& keepUrl);
+    // 把索引写到 path; packOffsets 不为空时打包文件中的条目用其中的新位置 (不在其中的不写)
+    bool WriteIndexLocked(const std::string& path, const std::unordered_map<std::string, int64_t>* packOffsets);
+    // 上次 CompactPack 在删除旧打包文件和改名之间中断时, 用 .tmp 和 index.compact 恢复
+    void RecoverCompactionLocked();
+    bool SaveLocked();
+    void NoteChangeLocked();
+};
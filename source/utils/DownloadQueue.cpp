@@ -1,28 +1,173 @@
 #include "DownloadQueue.hpp"
 #include "logger.h"
 #include "FileLogger.hpp"
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include "AllocTracker.hpp"
+#include "FrameScheduler.hpp"
+#include "AppLifecycle.hpp"
+#include "ProgressChannel.hpp"
 #include <cstring>
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
 
 // 全局单例
 DownloadQueue* DownloadQueue::sDownloadQueue = nullptr;
 
+// FILE 模式的写缓冲
+static constexpr size_t FILE_SINK_BUFFER_SIZE = 64 * 1024;
+
+// MEMORY 模式根据 Content-Length 预分配的上限, 防止服务器返回异常长度
+static constexpr curl_off_t MAX_RESERVE_SIZE = 16 * 1024 * 1024;
+
 // CURL 写入回调
 static size_t WriteCallback(char* data, size_t n, size_t l, void* userp) {
     DownloadOperation* download = (DownloadOperation*)userp;
-    download->buffer.append(data, n * l);
-    return n * l;
+    size_t size = n * l;
+    
+    // 第一个数据块: 记录 Content-Length
+    if (download->bytesReceived == 0 && download->eh) {
+        curl_off_t length = -1;
+        if (curl_easy_getinfo(download->eh, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) == CURLE_OK) {
+            download->contentLength = length;
+        }
+    }
+    
+    switch (download->sink) {
+        case DownloadSink::FILE:
+            // 收到数据时才创建文件, 304 等没有内容的响应不会覆盖已有文件
+            if (!download->file) {
+                download->file = fopen(download->filePath.c_str(), "wb");
+                if (!download->file) {
+                    FileLogger::GetInstance().LogError("[DOWNLOAD] Failed to open sink file: %s", download->filePath.c_str());
+                    return 0;
+                }
+                setvbuf(download->file, nullptr, _IOFBF, FILE_SINK_BUFFER_SIZE);
+            }
+            if (fwrite(data, 1, size, download->file) != size) {
+                return 0; // 写入失败, 中止传输
+            }
+            break;
+            
+        case DownloadSink::CALLBACK:
+            if (!download->chunkCb || !download->chunkCb(data, size)) {
+                return 0;
+            }
+            break;
+            
+        case DownloadSink::MEMORY:
+        default:
+            // 第一个数据块到达时按 Content-Length 一次性分配, 避免反复扩容
+            // (压缩传输的 Content-Length 是压缩后的长度, 不能用来预分配)
+            if (download->bytesReceived == 0 && !download->compressed && download->contentLength > 0 &&
+                download->contentLength <= MAX_RESERVE_SIZE) {
+                download->buffer.reserve((size_t)download->contentLength);
+            }
+            download->buffer.append(data, size);
+            break;
+    }
+    
+    download->bytesReceived += size;
+    if (download->progress) {
+        uint64_t elapsedMs = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - download->startTime).count();
+        download->progress->Update([download, elapsedMs](ProgressSnapshot& snapshot) {
+            snapshot.bytes = download->bytesReceived;
+            snapshot.total = download->contentLength > 0 ? (uint64_t)download->contentLength : 0;
+            snapshot.progress = snapshot.total > 0 ? std::min(1.0f, (float)snapshot.bytes / (float)snapshot.total) : 0.0f;
+            snapshot.rate = elapsedMs > 0 ? (uint32_t)(snapshot.bytes * 1000 / elapsedMs) : 0;
+        });
+    }
+    return size;
+}
+
+// 去掉头部值两端的空白和换行
+static std::string TrimHeaderValue(const char* data, size_t length) {
+    size_t start = 0;
+    while (start < length && (data[start] == ' ' || data[start] == '\t')) start++;
+    while (length > start && (data[length - 1] == '\r' || data[length - 1] == '\n' || data[length - 1] == ' ')) length--;
+    return std::string(data + start, length - start);
+}
+
+// CURL 响应头回调, 记录缓存校验信息
+static size_t HeaderCallback(char* data, size_t n, size_t l, void* userp) {
+    DownloadOperation* download = (DownloadOperation*)userp;
+    size_t size = n * l;
+    
+    if (size > 5 && strncasecmp(data, "ETag:", 5) == 0) {
+        download->etag = TrimHeaderValue(data + 5, size - 5);
+    } else if (size > 14 && strncasecmp(data, "Last-Modified:", 14) == 0) {
+        download->lastModified = TrimHeaderValue(data + 14, size - 14);
+    } else if (size > 14 && strncasecmp(data, "Content-Range:", 14) == 0) {
+        download->contentRange = TrimHeaderValue(data + 14, size - 14);
+    } else if (size > 12 && strncasecmp(data, "Repr-Digest:", 12) == 0) {
+        download->digest = TrimHeaderValue(data + 12, size - 12);
+    } else if (size > 7 && strncasecmp(data, "Digest:", 7) == 0 && download->digest.empty()) {
+        // 旧的 Digest 头 (RFC 3230), 同时有 Repr-Digest 时用后者
+        download->digest = TrimHeaderValue(data + 7, size - 7);
+    }
+    return size;
+}
+
+bool DownloadQueue::LoadValidators(const std::string& metaPath, DownloadOperation* download) {
+    FILE* file = fopen(metaPath.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "etag=", 5) == 0) {
+            download->ifNoneMatch = TrimHeaderValue(line + 5, strlen(line + 5));
+        } else if (strncmp(line, "last-modified=", 14) == 0) {
+            download->ifModifiedSince = TrimHeaderValue(line + 14, strlen(line + 14));
+        }
+    }
+    fclose(file);
+    
+    return !download->ifNoneMatch.empty() || !download->ifModifiedSince.empty();
 }
 
-void DownloadQueue::Init() {
+bool DownloadQueue::SaveValidators(const std::string& metaPath, const DownloadOperation* download) {
+    // 304 响应可能不带校验信息, 沿用请求中的
+    const std::string& etag = !download->etag.empty() ? download->etag : download->ifNoneMatch;
+    const std::string& lastModified = !download->lastModified.empty() ? download->lastModified : download->ifModifiedSince;
+    
+    if (etag.empty() && lastModified.empty()) {
+        unlink(metaPath.c_str());
+        return false;
+    }
+    
+    FILE* file = fopen(metaPath.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    if (!etag.empty()) {
+        fprintf(file, "etag=%s\n", etag.c_str());
+    }
+    if (!lastModified.empty()) {
+        fprintf(file, "last-modified=%s\n", lastModified.c_str());
+    }
+    fclose(file);
+    return true;
+}
+
+void DownloadQueue::Init(bool useNetworkThread) {
     if (sDownloadQueue == nullptr) {
-        sDownloadQueue = new DownloadQueue();
+        sDownloadQueue = new DownloadQueue(useNetworkThread);
+        sDownloadQueue->mLifecycleListener = AppLifecycle::AddListener("DownloadQueue",
+            []() { sDownloadQueue->Suspend(); }, []() { sDownloadQueue->Resume(); });
         DEBUG_FUNCTION_LINE("DownloadQueue initialized");
-        FileLogger::GetInstance().LogInfo("DownloadQueue initialized");
+        FileLogger::GetInstance().LogInfo("DownloadQueue initialized (%s)",
+                                          sDownloadQueue->mThreaded ? "network thread" : "main loop");
     }
 }
 
 void DownloadQueue::Quit() {
     if (sDownloadQueue != nullptr) {
+        sDownloadQueue->LogStats();
+        AppLifecycle::RemoveListener(sDownloadQueue->mLifecycleListener);
         delete sDownloadQueue;
         sDownloadQueue = nullptr;
         DEBUG_FUNCTION_LINE("DownloadQueue cleaned up");
@@ -30,53 +175,433 @@ void DownloadQueue::Quit() {
     }
 }
 
-DownloadQueue::DownloadQueue() {
+DownloadQueue::DownloadQueue(bool useNetworkThread)
+    : mRng((unsigned)std::chrono::steady_clock::now().time_since_epoch().count()) {
     mCurlMulti = curl_multi_init();
     if (mCurlMulti) {
         curl_multi_setopt(mCurlMulti, CURLMOPT_MAXCONNECTS, MAX_PARALLEL_DOWNLOADS);
-        DEBUG_FUNCTION_LINE("CURLM initialized with max %d parallel downloads", MAX_PARALLEL_DOWNLOADS);
-        FileLogger::GetInstance().LogInfo("CURLM initialized with max %d parallel downloads", MAX_PARALLEL_DOWNLOADS);
+        // 服务器支持 HTTP/2 时在同一连接上多路复用
+        curl_multi_setopt(mCurlMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        DEBUG_FUNCTION_LINE("CURLM initialized with %d-%d parallel downloads", MIN_PARALLEL_DOWNLOADS, MAX_PARALLEL_DOWNLOADS);
+        FileLogger::GetInstance().LogInfo("CURLM initialized with %d-%d parallel downloads (start %d)",
+                                          MIN_PARALLEL_DOWNLOADS, MAX_PARALLEL_DOWNLOADS, INITIAL_PARALLEL_DOWNLOADS);
     } else {
         DEBUG_FUNCTION_LINE("Failed to initialize CURLM!");
         FileLogger::GetInstance().LogError("Failed to initialize CURLM!");
     }
+    
+    // 所有传输共享 DNS 缓存、TLS 会话和连接池, 避免每张缩略图都重新握手
+    mCurlShare = curl_share_init();
+    if (mCurlShare) {
+        curl_share_setopt(mCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(mCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(mCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    } else {
+        FileLogger::GetInstance().LogWarning("Failed to initialize CURLSH, connections will not be shared");
+    }
+    
+    // 网络线程开始之前读入
+    mResolveCache.Load();
+    
+    if (useNetworkThread && mCurlMulti) {
+        mThreaded = true;
+        mThread = std::thread(&DownloadQueue::NetworkThreadFunc, this);
+    }
 }
 
 DownloadQueue::~DownloadQueue() {
-    // 清理所有队列中的任务
-    for (auto* download : mQueue) {
-        if (download->status == DownloadStatus::DOWNLOADING) {
-            TransferFinish(download);
+    // 先停止网络线程, 之后的清理都在当前线程完成
+    if (mThreaded) {
+        mStopThread = true;
+        curl_multi_wakeup(mCurlMulti);
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+        mThreaded = false;
+        mCommandCv.notify_all();
+    }
+    
+    // 清理所有活动的传输, 其余任务只从链表中摘下 (归调用者所有, 预热请求除外)
+    while (!mActive.Empty()) {
+        DownloadOperation* download = mActive.Front();
+        TransferFinish(download);
+        if (download->prewarm) {
+            delete download;
+        }
+    }
+    auto drain = [](DownloadList& list) {
+        while (!list.Empty()) {
+            DownloadOperation* download = list.Front();
+            list.Remove(download);
+            if (download->prewarm) {
+                delete download;
+            }
         }
+    };
+    for (auto& queue : mQueue) {
+        drain(queue);
+    }
+    drain(mRetrying);
+    
+    mResolveCache.Save();
+    
+    // easy handle 必须在 share handle 之前清理
+    for (CURL* handle : mHandlePool) {
+        curl_easy_cleanup(handle);
     }
-    mQueue.clear();
+    mHandlePool.clear();
     
     if (mCurlMulti) {
         curl_multi_cleanup(mCurlMulti);
         mCurlMulti = nullptr;
     }
+    
+    if (mCurlShare) {
+        curl_share_cleanup(mCurlShare);
+        mCurlShare = nullptr;
+    }
 }
 
-void DownloadQueue::DownloadAdd(DownloadOperation* download) {
+DownloadHandle DownloadQueue::DownloadAdd(DownloadOperation* download) {
     download->status = DownloadStatus::QUEUED;
-    mQueue.push_back(download);
-    if (FileLogger::GetInstance().IsVerbose()) {
-        FileLogger::GetInstance().LogDebug("[DOWNLOAD] Added to queue: %s", download->url.c_str());
+    DownloadHandle handle = AllocateSlot(download);
+    download->handle = handle;
+    if (mThreaded) {
+        PostCommand({Command::ADD, download, handle, download->priority});
+    } else {
+        ApplyAdd(download);
+    }
+    return handle;
+}
+
+DownloadHandle DownloadQueue::AllocateSlot(DownloadOperation* download) {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    uint32_t index;
+    if (!mFreeSlots.empty()) {
+        index = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        index = (uint32_t)mSlots.size();
+        mSlots.emplace_back();
+    }
+    Slot& slot = mSlots[index];
+    slot.download = download;
+    return {index, slot.generation};
+}
+
+DownloadOperation* DownloadQueue::Resolve(DownloadHandle handle) const {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    if (!handle.IsValid() || handle.slot >= mSlots.size() || mSlots[handle.slot].generation != handle.generation) {
+        return nullptr;
+    }
+    return mSlots[handle.slot].download;
+}
+
+void DownloadQueue::ReleaseSlot(DownloadOperation* download) {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    DownloadHandle handle = download->handle;
+    if (!handle.IsValid() || handle.slot >= mSlots.size() || mSlots[handle.slot].generation != handle.generation) {
+        return;
+    }
+    Slot& slot = mSlots[handle.slot];
+    slot.download = nullptr;
+    // 代数加 1 使旧句柄失效 (跳过表示空句柄的 0)
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+    mFreeSlots.push_back(handle.slot);
+}
+
+bool DownloadQueue::IsPending(DownloadHandle handle) const {
+    return Resolve(handle) != nullptr;
+}
+
+void DownloadQueue::ApplyAdd(DownloadOperation* download) {
+    download->host = ParseHost(download->url);
+    download->queuedTime = std::chrono::steady_clock::now();
+    download->expired = false;
+    InsertQueued(download, false);
+    mQueuedCount = CountQueued();
+    ULOG_DEBUG(NET, "[DOWNLOAD] Added to queue (priority %d): %s",
+                    (int)download->priority, download->url.c_str());
+}
+
+DownloadList& DownloadQueue::QueueFor(DownloadPriority priority) {
+    int index = (int)priority;
+    if (index < 0 || index >= PRIORITY_COUNT) {
+        index = (int)DownloadPriority::NORMAL;
     }
+    return mQueue[index];
 }
 
-void DownloadQueue::DownloadCancel(DownloadOperation* download) {
-    if (download->status == DownloadStatus::DOWNLOADING) {
+void DownloadQueue::InsertQueued(DownloadOperation* download, bool front) {
+    DownloadList& queue = QueueFor(download->priority);
+    const auto none = std::chrono::steady_clock::time_point{};
+    bool timed = download->deadline != none;
+    if (!timed && !front) {
+        queue.PushBack(download);
+        return;
+    }
+    
+    // 有截止时间的任务按截止时间排在队列前部, 只需要走过这一段
+    DownloadOperation* position = queue.Front();
+    while (position && position->deadline != none) {
+        if (timed && (front ? position->deadline >= download->deadline : position->deadline > download->deadline)) {
+            break;
+        }
+        position = position->listNext;
+    }
+    queue.InsertBefore(download, position);
+}
+
+void DownloadQueue::DownloadSetPriority(DownloadHandle handle, DownloadPriority priority,
+                                        std::chrono::steady_clock::time_point expiresAt) {
+    if (mThreaded) {
+        PostCommand({Command::SET_PRIORITY, nullptr, handle, priority, expiresAt});
+    } else {
+        ApplyPriority(handle, priority, expiresAt);
+    }
+}
+
+bool DownloadQueue::IsQueued(const DownloadOperation* download) const {
+    return download->list >= &mQueue[0] && download->list < &mQueue[PRIORITY_COUNT];
+}
+
+void DownloadQueue::ApplyPriority(DownloadHandle handle, DownloadPriority priority,
+                                  std::chrono::steady_clock::time_point expiresAt) {
+    // 句柄失效说明任务已结束 (可能已被释放, 不能访问)
+    DownloadOperation* download = Resolve(handle);
+    if (!download) {
+        return;
+    }
+    // 已经开始的传输不受影响; 等待重试的任务重新排队时按新的优先级
+    if (mRetrying.Contains(download)) {
+        download->priority = priority;
+        download->expiresAt = expiresAt;
+        return;
+    }
+    if (!IsQueued(download)) {
+        return;
+    }
+    download->expiresAt = expiresAt;
+    if (download->priority == priority && priority != DownloadPriority::HIGH) {
+        return;
+    }
+    
+    download->list->Remove(download);
+    download->priority = priority;
+    
+    // 最近请求的高优先级任务最先开始
+    InsertQueued(download, priority == DownloadPriority::HIGH);
+    
+    ULOG_DEBUG(NET, "[DOWNLOAD] Priority changed to %d: %s", (int)priority, download->url.c_str());
+}
+
+CURL* DownloadQueue::AcquireHandle() {
+    CURL* handle = nullptr;
+    if (!mHandlePool.empty()) {
+        handle = mHandlePool.back();
+        mHandlePool.pop_back();
+    } else {
+        handle = curl_easy_init();
+    }
+    
+    if (handle && mCurlShare) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, mCurlShare);
+    }
+    return handle;
+}
+
+void DownloadQueue::ReleaseHandle(CURL* handle) {
+    if ((int)mHandlePool.size() >= MAX_PARALLEL_DOWNLOADS) {
+        curl_easy_cleanup(handle);
+        return;
+    }
+    
+    // curl_easy_reset 清除选项但保留连接缓存和会话
+    curl_easy_reset(handle);
+    mHandlePool.push_back(handle);
+}
+
+void DownloadQueue::Prewarm(const std::string& url) {
+    std::string host = ParseHost(url);
+    auto now = std::chrono::steady_clock::now();
+    auto it = mPrewarmedAt.find(host);
+    if (it != mPrewarmedAt.end() && now - it->second < std::chrono::seconds(PREWARM_INTERVAL_SECONDS)) {
+        return;
+    }
+    mPrewarmedAt[host] = now;
+    
+    DownloadOperation* download = new DownloadOperation();
+    download->url = url;
+    download->headOnly = true;
+    download->prewarm = true;
+    download->maxRetries = 0;
+    DownloadAdd(download);
+}
+
+size_t DownloadQueue::GetQueuedCount() const {
+    return mQueuedCount;
+}
+
+size_t DownloadQueue::CountQueued() const {
+    size_t count = 0;
+    for (const auto& queue : mQueue) {
+        count += queue.Size();
+    }
+    return count;
+}
+
+void DownloadQueue::DownloadCancel(DownloadHandle handle) {
+    if (!handle.IsValid()) {
+        return;
+    }
+    if (!mThreaded) {
+        ApplyCancel(handle);
+        return;
+    }
+    
+    // 等待网络线程处理完取消命令, 返回后调用者可以安全释放 download
+    std::unique_lock<std::mutex> lock(mPostMutex);
+    mCommands.push_back({Command::CANCEL, nullptr, handle, DownloadPriority::NORMAL});
+    uint32_t ticket = ++mCommandsPosted;
+    curl_multi_wakeup(mCurlMulti);
+    mCommandCv.wait(lock, [this, ticket]() {
+        return (int32_t)(mCommandsDone - ticket) >= 0 || mStopThread.load();
+    });
+    
+    // 取消前可能已经完成, 不再回调 (等待回调的任务还没交还调用者, 可以访问)
+    mCompleted.erase(std::remove_if(mCompleted.begin(), mCompleted.end(),
+                                    [handle](const DownloadOperation* download) { return download->handle == handle; }),
+                     mCompleted.end());
+}
+
+void DownloadQueue::ApplyCancel(DownloadHandle handle) {
+    DownloadOperation* download = Resolve(handle);
+    if (!download) {
+        return;
+    }
+    
+    if (mActive.Contains(download)) {
         TransferFinish(download);
-        if (FileLogger::GetInstance().IsVerbose()) {
-            FileLogger::GetInstance().LogDebug("[DOWNLOAD] Cancelled active transfer: %s", download->url.c_str());
+        ULOG_DEBUG(NET, "[DOWNLOAD] Cancelled active transfer: %s", download->url.c_str());
+    } else if (download->list) {
+        bool queued = IsQueued(download);
+        download->list->Remove(download);
+        if (queued) {
+            mQueuedCount = CountQueued();
+            ULOG_DEBUG(NET, "[DOWNLOAD] Removed from queue: %s", download->url.c_str());
         }
-    } else if (download->status == DownloadStatus::QUEUED && !mQueue.empty()) {
-        mQueue.remove(download);
-        if (FileLogger::GetInstance().IsVerbose()) {
-            FileLogger::GetInstance().LogDebug("[DOWNLOAD] Removed from queue: %s", download->url.c_str());
+    }
+    ReleaseSlot(download);
+}
+
+void DownloadQueue::Suspend() {
+    if (mThreaded) {
+        PostCommand({Command::SUSPEND, nullptr, {}, DownloadPriority::NORMAL});
+    } else {
+        ApplySuspend(true);
+    }
+}
+
+void DownloadQueue::Resume() {
+    if (mThreaded) {
+        PostCommand({Command::RESUME, nullptr, {}, DownloadPriority::NORMAL});
+    } else {
+        ApplySuspend(false);
+    }
+}
+
+void DownloadQueue::ApplySuspend(bool suspended) {
+    if (suspended == mSuspended) {
+        return;
+    }
+    mSuspended = suspended;
+    auto now = std::chrono::steady_clock::now();
+    for (DownloadOperation* download : mActive) {
+        if (download->eh) {
+            curl_easy_pause(download->eh, suspended ? CURLPAUSE_ALL : CURLPAUSE_CONT);
         }
+        // 暂停的时间不算作停滞
+        download->lastProgress = now;
+        download->lastProgressBytes = download->bytesReceived;
     }
+    FileLogger::GetInstance().LogInfo("[DOWNLOAD] %s %zu active transfers (%zu queued)",
+                                      suspended ? "Suspended" : "Resumed", mActive.Size(), CountQueued());
+}
+
+void DownloadQueue::PostCommand(const Command& command) {
+    {
+        std::lock_guard<std::mutex> lock(mPostMutex);
+        mCommands.push_back(command);
+        ++mCommandsPosted;
+    }
+    curl_multi_wakeup(mCurlMulti);
+}
+
+void DownloadQueue::ProcessCommands() {
+    std::vector<Command> commands;
+    uint32_t posted;
+    {
+        std::lock_guard<std::mutex> lock(mPostMutex);
+        commands.swap(mCommands);
+        posted = mCommandsPosted;
+    }
+    
+    for (const auto& command : commands) {
+        switch (command.type) {
+            case Command::ADD:
+                ApplyAdd(command.download);
+                break;
+            case Command::CANCEL:
+                ApplyCancel(command.handle);
+                break;
+            case Command::SET_PRIORITY:
+                ApplyPriority(command.handle, command.priority, command.expiresAt);
+                break;
+            case Command::SUSPEND:
+                ApplySuspend(true);
+                break;
+            case Command::RESUME:
+                ApplySuspend(false);
+                break;
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mPostMutex);
+        mCommandsDone = posted;
+    }
+    mCommandCv.notify_all();
+}
+
+void DownloadQueue::NotifyComplete(DownloadOperation* download) {
+    if (mThreaded && !download->callbackOnNetworkThread) {
+        std::lock_guard<std::mutex> lock(mPostMutex);
+        mCompleted.push_back(download);
+        return;
+    }
+    
+    if (download->cb) {
+        download->cb(download);
+    }
+}
+
+void DownloadQueue::NetworkThreadFunc() {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_NETWORK);
+    FileLogger::GetInstance().LogInfo("[DOWNLOAD] Network thread started");
+    
+    while (!mStopThread) {
+        ProcessCommands();
+        StartTransfersFromQueue();
+        mBusy = Perform() != 0;
+        
+        // 有活动传输时等待 socket 事件, 空闲时等待 curl_multi_wakeup
+        int numfds = 0;
+        curl_multi_poll(mCurlMulti, nullptr, 0, mBusy ? 100 : 1000, &numfds);
+    }
+    
+    FileLogger::GetInstance().LogInfo("[DOWNLOAD] Network thread stopped");
 }
 
 void DownloadQueue::TransferStart(DownloadOperation* download) {
@@ -86,59 +611,114 @@ void DownloadQueue::TransferStart(DownloadOperation* download) {
         return;
     }
     
-    download->eh = curl_easy_init();
+    download->eh = AcquireHandle();
     if (!download->eh) {
         DEBUG_FUNCTION_LINE("[DOWNLOAD] Failed to create easy handle for: %s", download->url.c_str());
         FileLogger::GetInstance().LogError("[DOWNLOAD] Failed to create easy handle for: %s", download->url.c_str());
         return;
     }
     
+    // 准备数据接收
+    download->bytesReceived = 0;
+    download->contentLength = -1;
+    download->contentRange.clear();
+    download->digest.clear();
+    download->etag.clear();
+    download->lastModified.clear();
+    download->notModified = false;
+    
     // 配置 CURL
     curl_easy_setopt(download->eh, CURLOPT_URL, download->url.c_str());
     curl_easy_setopt(download->eh, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(download->eh, CURLOPT_WRITEDATA, download);
+    curl_easy_setopt(download->eh, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(download->eh, CURLOPT_HEADERDATA, download);
     curl_easy_setopt(download->eh, CURLOPT_PRIVATE, download);
     curl_easy_setopt(download->eh, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(download->eh, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(download->eh, CURLOPT_CONNECTTIMEOUT, 10L);
+    // 有时间预算的小请求: 连接慢时尽早放弃 (重试会建立新的连接), 整个传输也不超过预算
+    // 没有预算的按停滞时间判断超时, 慢速但正常的大文件不会被中断 (easy handle 会复用, 两项每次都要设置)
+    long connectTimeoutMs = CONNECT_TIMEOUT_MS;
+    if (download->budgetMs > 0) {
+        connectTimeoutMs = std::min<long>(download->budgetMs, FAST_CONNECT_TIMEOUT_MS);
+    }
+    curl_easy_setopt(download->eh, CURLOPT_CONNECTTIMEOUT_MS, connectTimeoutMs);
+    curl_easy_setopt(download->eh, CURLOPT_TIMEOUT_MS, (long)std::max(0, download->budgetMs));
+    curl_easy_setopt(download->eh, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(download->eh, CURLOPT_LOW_SPEED_TIME, (long)STALL_TIMEOUT_SECONDS);
+    
+    // 连接复用
+    curl_easy_setopt(download->eh, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(download->eh, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(download->eh, CURLOPT_TCP_KEEPALIVE, 1L);
     
     // SSL 设置
     curl_easy_setopt(download->eh, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(download->eh, CURLOPT_SSL_VERIFYHOST, 0L);
     
+    // 流量类别的限速 (新的 easy handle 不限速)
+    download->recvLimit = 0;
+    ApplyRecvLimit(download);
+    
+    // 本次运行第一次连接该主机时使用上次保存的地址, 不等 DNS
+    download->resolve = mResolveCache.BuildResolveList(download->host, download->cachedAddress);
+    if (download->resolve) {
+        curl_easy_setopt(download->eh, CURLOPT_RESOLVE, download->resolve);
+    }
+    
+    if (download->headOnly) {
+        curl_easy_setopt(download->eh, CURLOPT_NOBODY, 1L);
+    }
+    
+    // 压缩传输: 空字符串表示接受 curl 支持的所有编码
+    if (download->compressed) {
+        curl_easy_setopt(download->eh, CURLOPT_ACCEPT_ENCODING, "");
+    }
+    
+    // 范围请求
+    if (!download->range.empty()) {
+        curl_easy_setopt(download->eh, CURLOPT_RANGE, download->range.c_str());
+    }
+    
     // POST 数据支持
-    struct curl_slist* headers = nullptr;
     if (!download->postData.empty()) {
         curl_easy_setopt(download->eh, CURLOPT_POST, 1L);
         curl_easy_setopt(download->eh, CURLOPT_POSTFIELDS, download->postData.c_str());
         curl_easy_setopt(download->eh, CURLOPT_POSTFIELDSIZE, download->postData.size());
         
         // 设置 Content-Type 为 JSON
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(download->eh, CURLOPT_HTTPHEADER, headers);
+        download->headers = curl_slist_append(download->headers, "Content-Type: application/json");
         
-        if (FileLogger::GetInstance().IsVerbose()) {
-            FileLogger::GetInstance().LogDebug("[DOWNLOAD] POST request with %zu bytes data", download->postData.size());
-        }
+        ULOG_DEBUG(NET, "[DOWNLOAD] POST request with %zu bytes data", download->postData.size());
+    }
+    
+    // 条件请求
+    if (!download->ifNoneMatch.empty()) {
+        download->headers = curl_slist_append(download->headers, ("If-None-Match: " + download->ifNoneMatch).c_str());
+    }
+    if (!download->ifModifiedSince.empty()) {
+        download->headers = curl_slist_append(download->headers, ("If-Modified-Since: " + download->ifModifiedSince).c_str());
+    }
+    if (!download->range.empty() && !download->ifRange.empty()) {
+        download->headers = curl_slist_append(download->headers, ("If-Range: " + download->ifRange).c_str());
+    }
+    if (download->headers) {
+        curl_easy_setopt(download->eh, CURLOPT_HTTPHEADER, download->headers);
     }
     
     // 添加到 multi handle
     curl_multi_add_handle(mCurlMulti, download->eh);
     mActiveTransfers++;
-    mActive.push_back(download); // 添加到活动列表
+    mActiveSnapshot = mActiveTransfers;
+    mHosts[download->host].active++;
+    mActive.PushBack(download); // 添加到活动列表
     
     // 记录开始时间
     download->startTime = std::chrono::steady_clock::now();
+    download->lastProgress = download->startTime;
+    download->lastProgressBytes = 0;
+    download->traceStart = Trace::IsRecording() ? OSGetSystemTime() : 0;
     
-    if (FileLogger::GetInstance().IsVerbose()) {
-        FileLogger::GetInstance().LogDebug("[DOWNLOAD] Started transfer (%d active): %s", mActiveTransfers, download->url.c_str());
-    }
-    
-    // 注意: headers 会在 TransferFinish 时被清理
-    if (headers) {
-        // 将 headers 存储到 cbdata 中以便后续清理
-        // 暂时不清理,让 CURL 在传输时使用
-    }
+    ULOG_DEBUG(NET, "[DOWNLOAD] Started transfer (%d active): %s", mActiveTransfers, download->url.c_str());
 }
 
 void DownloadQueue::TransferFinish(DownloadOperation* download) {
@@ -149,67 +729,555 @@ void DownloadQueue::TransferFinish(DownloadOperation* download) {
     if (mCurlMulti) {
         curl_multi_remove_handle(mCurlMulti, download->eh);
     }
-    curl_easy_cleanup(download->eh);
+    if (download->traceStart) {
+        Trace::Record("net", "transfer", download->traceStart, OSGetSystemTime(), download->url.c_str());
+        download->traceStart = 0;
+    }
+    ReleaseHandle(download->eh);
     download->eh = nullptr;
-    mActiveTransfers--;
-    mActive.remove(download); // 从活动列表移除
     
-    if (FileLogger::GetInstance().IsVerbose()) {
-        FileLogger::GetInstance().LogDebug("[DOWNLOAD] Finished transfer (%d active): %s", mActiveTransfers, download->url.c_str());
+    // headers 必须在 easy handle 重置之后释放
+    if (download->headers) {
+        curl_slist_free_all(download->headers);
+        download->headers = nullptr;
     }
+    if (download->resolve) {
+        curl_slist_free_all(download->resolve);
+        download->resolve = nullptr;
+    }
+    
+    // 关闭 FILE 模式的文件
+    if (download->file) {
+        fclose(download->file);
+        download->file = nullptr;
+    }
+    
+    mActiveTransfers--;
+    mActiveSnapshot = mActiveTransfers;
+    mHosts[download->host].active--;
+    mActive.Remove(download); // 从活动列表移除
+    
+    ULOG_DEBUG(NET, "[DOWNLOAD] Finished transfer (%d active): %s", mActiveTransfers, download->url.c_str());
 }
 
 void DownloadQueue::StartTransfersFromQueue() {
-    while (mActiveTransfers < MAX_PARALLEL_DOWNLOADS && !mQueue.empty()) {
-        DownloadOperation* download = mQueue.front();
-        mQueue.pop_front();
-        
-        download->status = DownloadStatus::DOWNLOADING;
-        TransferStart(download);
+    if (mSuspended) {
+        mQueuedCount = CountQueued();
+        return;
+    }
+    for (int lane = 0; lane < PRIORITY_COUNT && mActiveTransfers < mParallelLimit; lane++) {
+        DownloadList& queue = mQueue[lane];
+        DownloadOperation* next = queue.Front();
+        while (next && mActiveTransfers < mParallelLimit) {
+            DownloadOperation* download = next;
+            next = download->listNext;
+            
+            // 该主机已达上限, 让其他主机的任务先开始
+            if (!CanStart(download)) {
+                continue;
+            }
+            
+            queue.Remove(download);
+            
+            download->status = DownloadStatus::DOWNLOADING;
+            TransferStart(download);
+            
+            // 启动失败 (无法创建 handle) 直接回调失败; 回调可能取消或释放其它任务, 从队首重新开始
+            if (!download->eh) {
+                download->status = DownloadStatus::FAILED;
+                ReleaseSlot(download);
+                NotifyComplete(download);
+                next = queue.Front();
+            }
+        }
+    }
+    
+    mQueuedCount = CountQueued();
+}
+
+std::string DownloadQueue::ParseHost(const std::string& url) {
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t end = url.find_first_of(":/?#", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+bool DownloadQueue::CanStart(const DownloadOperation* download) {
+    // 界面在等待内容时后台下载先不开始
+    if (download->traffic == DownloadTraffic::BACKGROUND && mShaping) {
+        return false;
+    }
+    const HostState& host = mHosts[download->host];
+    return host.active < host.limit;
+}
+
+bool DownloadQueue::HasInteractiveDemand() const {
+    auto interactive = [](const DownloadOperation* download) {
+        return download->traffic == DownloadTraffic::INTERACTIVE && download->priority != DownloadPriority::LOW;
+    };
+    if (std::any_of(mActive.begin(), mActive.end(), interactive)) {
+        return true;
+    }
+    // 排队中的交互请求 (LOW 队列中不会有)
+    for (int lane = 0; lane < (int)DownloadPriority::LOW; lane++) {
+        if (std::any_of(mQueue[lane].begin(), mQueue[lane].end(), interactive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DownloadQueue::ShapeTraffic() {
+    auto now = std::chrono::steady_clock::now();
+    if (HasInteractiveDemand()) {
+        mLastInteractive = now;
+    }
+    bool shaping = now - mLastInteractive < std::chrono::milliseconds(INTERACTIVE_HOLD_MS);
+    if (shaping != mShaping) {
+        mShaping = shaping;
+        ULOG_DEBUG(NET, "[DOWNLOAD] %s bulk and background transfers", shaping ? "Throttling" : "Unthrottling");
+    }
+    for (DownloadOperation* download : mActive) {
+        ApplyRecvLimit(download);
+    }
+}
+
+void DownloadQueue::ApplyRecvLimit(DownloadOperation* download) {
+    curl_off_t limit = 0;
+    if (mShaping) {
+        if (download->traffic == DownloadTraffic::BULK) {
+            limit = BULK_SHARE_BYTES_PER_SEC;
+        } else if (download->traffic == DownloadTraffic::BACKGROUND) {
+            limit = BACKGROUND_BYTES_PER_SEC;
+        }
+    }
+    // 限速在传输过程中修改也会生效; 限速高于停滞检测的阈值, 不会被当作卡住
+    if (download->eh && limit != download->recvLimit) {
+        curl_easy_setopt(download->eh, CURLOPT_MAX_RECV_SPEED_LARGE, limit);
+        download->recvLimit = limit;
+    }
+}
+
+void DownloadQueue::AdaptConcurrency(DownloadOperation* download, CURLcode result) {
+    HostState& host = mHosts[download->host];
+    
+    // 超时、连接失败或服务器限流: 说明已经过载, 并发减半
+    bool congested = (result == CURLE_OPERATION_TIMEDOUT || result == CURLE_COULDNT_CONNECT ||
+                      download->response_code == 429 || download->response_code == 503);
+    
+    if (congested) {
+        host.limit = std::max(MIN_PARALLEL_DOWNLOADS, host.limit / 2);
+        host.successStreak = 0;
+        mParallelLimit = std::max(MIN_PARALLEL_DOWNLOADS, mParallelLimit / 2);
+        mGlobalSuccessStreak = 0;
+        FileLogger::GetInstance().LogWarning("[DOWNLOAD] Congestion on %s, limit now %d (global %d)",
+                                             download->host.c_str(), host.limit, mParallelLimit.load());
+        return;
+    }
+    
+    if (result != CURLE_OK) {
+        return; // 其他错误与拥塞无关, 不调整
+    }
+    
+    // 仍有任务在排队说明带宽没有用满: 每完成一轮 (limit 个) 成功传输后加 1
+    bool backlog = CountQueued() > 0;
+    
+    if (backlog && host.active + 1 >= host.limit && ++host.successStreak >= host.limit) {
+        if (host.limit < MAX_PARALLEL_DOWNLOADS) {
+            host.limit++;
+            ULOG_DEBUG(NET, "[DOWNLOAD] Host %s limit raised to %d", download->host.c_str(), host.limit);
+        }
+        host.successStreak = 0;
+    }
+    
+    if (backlog && mActiveTransfers + 1 >= mParallelLimit && ++mGlobalSuccessStreak >= mParallelLimit) {
+        if (mParallelLimit < MAX_PARALLEL_DOWNLOADS) {
+            mParallelLimit++;
+            ULOG_DEBUG(NET, "[DOWNLOAD] Global limit raised to %d", mParallelLimit.load());
+        }
+        mGlobalSuccessStreak = 0;
     }
 }
 
 void DownloadQueue::CheckForStuckDownloads() {
+    if (mSuspended) {
+        return;
+    }
     auto now = std::chrono::steady_clock::now();
     
-    // 检查所有活动下载是否超时
-    for (auto it = mActive.begin(); it != mActive.end(); ) {
-        DownloadOperation* download = *it;
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - download->startTime).count();
+    // 检查活动下载是否长时间没有收到数据 (curl 的 LOW_SPEED 之外的保险)
+    // 先记下卡住的任务: 结束一个任务时的回调可能取消或释放其它任务, 之后按句柄重新查找
+    std::vector<DownloadHandle> stalledHandles;
+    for (DownloadOperation* download : mActive) {
+        if (download->bytesReceived != download->lastProgressBytes) {
+            download->lastProgressBytes = download->bytesReceived;
+            download->lastProgress = now;
+            continue;
+        }
+        
+        auto stalled = std::chrono::duration_cast<std::chrono::seconds>(now - download->lastProgress).count();
+        if (stalled > STALL_TIMEOUT_SECONDS + CONNECT_GRACE_SECONDS) {
+            FileLogger::GetInstance().LogError("[DOWNLOAD] Stalled for %lld seconds: %s", (long long)stalled, download->url.c_str());
+            stalledHandles.push_back(download->handle);
+        }
+    }
+    
+    for (DownloadHandle handle : stalledHandles) {
+        DownloadOperation* download = Resolve(handle);
+        if (!download || !mActive.Contains(download)) {
+            continue;
+        }
         
-        if (elapsed > DOWNLOAD_TIMEOUT_SECONDS) {
-            FileLogger::GetInstance().LogError("[DOWNLOAD] Timeout after %ld seconds: %s", elapsed, download->url.c_str());
+        download->response_code = 0; // 超时用 0 表示
+        CollectMetrics(download);
+        
+        // 从 multi handle 移除
+        TransferFinish(download);
+        HandleResult(download, CURLE_OPERATION_TIMEDOUT);
+    }
+}
+
+bool DownloadQueue::IsTransientError(CURLcode result, long responseCode) {
+    switch (result) {
+        case CURLE_OK:
+            break;
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+            return true;
+        default:
+            return false;
+    }
+    
+    return responseCode == 408 || responseCode == 429 || responseCode == 500 ||
+           responseCode == 502 || responseCode == 503 || responseCode == 504;
+}
+
+bool DownloadQueue::ScheduleRetry(DownloadOperation* download, curl_off_t retryAfterSeconds) {
+    if (download->attempt >= download->maxRetries) {
+        return false;
+    }
+    
+    // CALLBACK 模式的数据已经交给调用者, 无法重来
+    if (download->sink == DownloadSink::CALLBACK && download->bytesReceived > 0) {
+        return false;
+    }
+    
+    // 指数退避 + 抖动: 在 [d/2, d] 中随机, d = min(max, base * 2^attempt); 有时间预算的任务用短的退避
+    bool fast = download->budgetMs > 0;
+    int ceiling = std::min(fast ? FAST_RETRY_MAX_DELAY_MS : RETRY_MAX_DELAY_MS,
+                           (fast ? FAST_RETRY_BASE_DELAY_MS : RETRY_BASE_DELAY_MS) << download->attempt);
+    int delayMs = std::uniform_int_distribution<int>(ceiling / 2, ceiling)(mRng);
+    if (retryAfterSeconds > 0) {
+        delayMs = std::max(delayMs, (int)std::min<curl_off_t>(retryAfterSeconds * 1000, RETRY_MAX_DELAY_MS * 4));
+    }
+    
+    // 重试时结果已经没有用了: 和 DropExpired 一样按过期结束
+    auto retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+    if (download->expiresAt != std::chrono::steady_clock::time_point{} && retryAt >= download->expiresAt) {
+        download->expired = true;
+        ULOG_DEBUG(NET, "[DOWNLOAD] Expired before retry: %s", download->url.c_str());
+        return false;
+    }
+    
+    download->attempt++;
+    download->buffer.clear();
+    download->bytesReceived = 0;
+    download->response_code = 0;
+    download->status = DownloadStatus::QUEUED;
+    download->retryAt = retryAt;
+    mRetrying.PushBack(download);
+    
+    FileLogger::GetInstance().LogWarning("[DOWNLOAD] Retry %d/%d in %d ms: %s",
+                                         download->attempt, download->maxRetries, delayMs, download->url.c_str());
+    return true;
+}
+
+void DownloadQueue::RequeueDueRetries() {
+    auto now = std::chrono::steady_clock::now();
+    DownloadOperation* next = mRetrying.Front();
+    while (next) {
+        DownloadOperation* download = next;
+        next = download->listNext;
+        if (now >= download->retryAt) {
+            mRetrying.Remove(download);
+            download->queuedTime = now;
+            // 重试的任务排在同优先级队列的最前面 (有截止时间的按截止时间)
+            InsertQueued(download, true);
+        }
+    }
+}
+
+void DownloadQueue::DropExpired() {
+    auto now = std::chrono::steady_clock::now();
+    auto expired = [now](const DownloadOperation* download) {
+        return download->expiresAt != std::chrono::steady_clock::time_point{} && now >= download->expiresAt;
+    };
+    
+    auto drop = [this, &expired](DownloadList& list) {
+        DownloadOperation* next = list.Front();
+        while (next) {
+            DownloadOperation* download = next;
+            next = download->listNext;
+            if (!expired(download)) {
+                continue;
+            }
             
-            // 设置为失败状态
+            list.Remove(download);
             download->status = DownloadStatus::FAILED;
-            download->response_code = 0; // 超时用 0 表示
-            
-            // 从 multi handle 移除
-            TransferFinish(download);
-            
-            // 调用回调
-            if (download->cb) {
-                download->cb(download);
+            download->result = CURLE_OPERATION_TIMEDOUT;
+            download->response_code = 0;
+            download->expired = true;
+            {
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                mTotalExpired++;
             }
-            
-            // it 已经在 TransferFinish 中被移除,需要重新开始
-            it = mActive.begin();
-            
-            // 启动队列中的新传输
-            StartTransfersFromQueue();
-        } else {
-            ++it;
+            ULOG_DEBUG(NET, "[DOWNLOAD] Expired before starting: %s", download->url.c_str());
+            ReleaseSlot(download);
+            // 回调可能取消或释放其它任务, 从头重新开始
+            NotifyComplete(download);
+            next = list.Front();
         }
+    };
+    for (int lane = 0; lane < PRIORITY_COUNT; lane++) {
+        drop(mQueue[lane]);
+    }
+    drop(mRetrying);
+}
+
+void DownloadQueue::HandleResult(DownloadOperation* download, CURLcode result) {
+    // 保存的地址已经失效: 重试 (和之后的传输) 重新解析
+    if (download->cachedAddress && (result == CURLE_COULDNT_CONNECT || result == CURLE_OPERATION_TIMEDOUT ||
+                                    result == CURLE_SSL_CONNECT_ERROR)) {
+        mResolveCache.Invalidate(download->host);
+    }
+    download->cachedAddress = false;
+    
+    // 预热请求: 响应码无关紧要, 连接已经留在连接缓存中; 不计入统计和并发调整
+    if (download->prewarm) {
+        ULOG_DEBUG(NET, "[DOWNLOAD] Prewarmed %s (CURL %d, HTTP %ld): connect %.0f tls %.0f ms",
+                        download->host.c_str(), result, download->response_code,
+                        download->metrics.connectMs, download->metrics.tlsMs);
+        ReleaseSlot(download);
+        delete download;
+        return;
+    }
+    
+    AdaptConcurrency(download, result);
+    download->result = result;
+    
+    bool partial = !download->range.empty() && download->response_code == 206;
+    if (result == CURLE_OK && (download->response_code == 200 || partial)) {
+        RecordStats(download, true, false);
+        download->status = DownloadStatus::COMPLETE;
+        ULOG_DEBUG(NET, "[DOWNLOAD] Complete (HTTP %ld): %s (%zu bytes)", 
+                        download->response_code, download->url.c_str(), download->bytesReceived);
+        ReleaseSlot(download);
+        NotifyComplete(download);
+        return;
+    }
+    
+    // 304: 本地缓存仍然有效
+    if (result == CURLE_OK && download->response_code == 304 &&
+        (!download->ifNoneMatch.empty() || !download->ifModifiedSince.empty())) {
+        RecordStats(download, true, false);
+        download->status = DownloadStatus::COMPLETE;
+        download->notModified = true;
+        download->buffer.clear();
+        ULOG_DEBUG(NET, "[DOWNLOAD] Not modified (HTTP 304): %s", download->url.c_str());
+        ReleaseSlot(download);
+        NotifyComplete(download);
+        return;
+    }
+    
+    if (result != CURLE_OK) {
+        FileLogger::GetInstance().LogError("[DOWNLOAD] Failed (CURL error %d: %s): %s", 
+                   result, curl_easy_strerror(result), download->url.c_str());
+    } else {
+        FileLogger::GetInstance().LogError("[DOWNLOAD] Failed (HTTP %ld): %s", 
+                   download->response_code, download->url.c_str());
+    }
+    
+    if (IsTransientError(result, download->response_code) && ScheduleRetry(download, download->retryAfter)) {
+        RecordStats(download, false, true);
+        return;
     }
+    
+    RecordStats(download, false, false);
+    download->status = DownloadStatus::FAILED;
+    ReleaseSlot(download);
+    NotifyComplete(download);
+}
+
+void DownloadQueue::CollectMetrics(DownloadOperation* download) {
+    if (!download->eh) {
+        return;
+    }
+    
+    // 各阶段时间 (微秒, 从请求开始累计)
+    curl_off_t dns = 0, connect = 0, tls = 0, ttfb = 0, total = 0, size = 0, speed = 0;
+    curl_easy_getinfo(download->eh, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(download->eh, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(download->eh, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(download->eh, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+    curl_easy_getinfo(download->eh, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(download->eh, CURLINFO_SIZE_DOWNLOAD_T, &size);
+    curl_easy_getinfo(download->eh, CURLINFO_SPEED_DOWNLOAD_T, &speed);
+    
+    long newConnections = 0;
+    curl_easy_getinfo(download->eh, CURLINFO_NUM_CONNECTS, &newConnections);
+    if (newConnections > 0 && download->response_code > 0) {
+        mResolveCache.Record(download->eh, download->host);
+    }
+    
+    TransferMetrics& m = download->metrics;
+    m.queueMs = std::chrono::duration<float, std::milli>(download->startTime - download->queuedTime).count();
+    m.dnsMs = dns / 1000.0f;
+    m.connectMs = connect / 1000.0f;
+    m.tlsMs = tls / 1000.0f;
+    m.ttfbMs = ttfb / 1000.0f;
+    m.totalMs = total / 1000.0f;
+    m.bytes = (size_t)size;
+    m.bytesPerSec = (float)speed;
+    m.reusedConnection = (newConnections == 0);
+    
+    ULOG_DEBUG(NET, "[DOWNLOAD] Timing %s: queue %.0f dns %.0f connect %.0f tls %.0f ttfb %.0f total %.0f ms, %zu bytes%s",
+                    download->url.c_str(), m.queueMs, m.dnsMs, m.connectMs, m.tlsMs, m.ttfbMs, m.totalMs,
+                    m.bytes, m.reusedConnection ? " (reused)" : "");
+    if (download->compressed && m.bytes > 0 && download->bytesReceived > m.bytes) {
+        ULOG_DEBUG(NET, "[DOWNLOAD] Compressed %zu -> %zu bytes (%.1fx)", m.bytes, download->bytesReceived,
+                        (float)download->bytesReceived / m.bytes);
+    }
+}
+
+void DownloadQueue::RecordStats(const DownloadOperation* download, bool success, bool retrying) {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    
+    const TransferMetrics& m = download->metrics;
+    StatsSample sample = { m.totalMs, m.ttfbMs, m.queueMs, m.bytes, !success };
+    if (mStatsWindow.size() < STATS_WINDOW) {
+        mStatsWindow.push_back(sample);
+    } else {
+        mStatsWindow[mStatsNext] = sample;
+    }
+    mStatsNext = (mStatsNext + 1) % STATS_WINDOW;
+    
+    mTotalBytes += m.bytes;
+    if (success) {
+        mTotalCompleted++;
+    } else if (retrying) {
+        mTotalRetries++;
+    } else if (download->expired) {
+        mTotalExpired++;
+    } else {
+        mTotalFailed++;
+    }
+}
+
+// 取第 percent 百分位 (会打乱 values 的顺序)
+static float Percentile(std::vector<float>& values, int percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, values.size() * percent / 100);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+NetworkStats DownloadQueue::GetStats() const {
+    NetworkStats stats;
+    stats.queued = mQueuedCount;
+    stats.active = mActiveSnapshot;
+    stats.parallelLimit = mParallelLimit;
+    
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    stats.samples = mStatsWindow.size();
+    stats.totalCompleted = mTotalCompleted;
+    stats.totalFailed = mTotalFailed;
+    stats.totalRetries = mTotalRetries;
+    stats.totalExpired = mTotalExpired;
+    stats.totalBytes = mTotalBytes;
+    if (mStatsWindow.empty()) {
+        return stats;
+    }
+    
+    // 延迟只统计成功的传输, 失败的超时会拉高分位数
+    std::vector<float> total, ttfb, queue;
+    size_t failed = 0;
+    size_t bytes = 0;
+    float seconds = 0;
+    for (const auto& sample : mStatsWindow) {
+        queue.push_back(sample.queueMs);
+        if (sample.failed) {
+            failed++;
+            continue;
+        }
+        total.push_back(sample.totalMs);
+        ttfb.push_back(sample.ttfbMs);
+        bytes += sample.bytes;
+        seconds += sample.totalMs / 1000.0f;
+    }
+    
+    stats.latencyP50Ms = Percentile(total, 50);
+    stats.latencyP95Ms = Percentile(total, 95);
+    stats.ttfbP50Ms = Percentile(ttfb, 50);
+    stats.queueP50Ms = Percentile(queue, 50);
+    stats.bytesPerSec = seconds > 0 ? bytes / seconds : 0;
+    stats.failureRate = (float)failed / mStatsWindow.size();
+    return stats;
+}
+
+void DownloadQueue::LogStats() const {
+    NetworkStats stats = GetStats();
+    FileLogger::GetInstance().LogInfo("[DOWNLOAD] Stats: p50 %.0f ms, p95 %.0f ms, ttfb p50 %.0f ms, queue p50 %.0f ms, %.1f KB/s, failure %.0f%% (%zu samples)",
+                                      stats.latencyP50Ms, stats.latencyP95Ms, stats.ttfbP50Ms, stats.queueP50Ms,
+                                      stats.bytesPerSec / 1024.0f, stats.failureRate * 100.0f, stats.samples);
+    FileLogger::GetInstance().LogInfo("[DOWNLOAD] Totals: %u complete, %u failed, %u retries, %u expired, %llu bytes; %zu queued, %d active, limit %d",
+                                      stats.totalCompleted, stats.totalFailed, stats.totalRetries, stats.totalExpired,
+                                      (unsigned long long)stats.totalBytes, stats.queued, stats.active, stats.parallelLimit);
 }
 
 int DownloadQueue::Process() {
+    Profiler::Scope profile(Profiler::SECTION_DOWNLOAD_QUEUE);
     if (!mCurlMulti) {
         return 0;
     }
     
+    if (!mThreaded) {
+        return Perform();
+    }
+    
+    // 网络线程模式: 只执行已完成任务的回调
+    // 每次至少执行一个, 之后只在这一帧的预算还有剩余时继续, 其余的留给下一次
+    bool hadCompleted = false;
+    for (bool first = true; first || FrameScheduler::HasTime(); first = false) {
+        DownloadOperation* download;
+        {
+            std::lock_guard<std::mutex> lock(mPostMutex);
+            if (mCompleted.empty()) {
+                break;
+            }
+            download = mCompleted.front();
+            mCompleted.erase(mCompleted.begin());
+        }
+        hadCompleted = true;
+        if (download->cb) {
+            download->cb(download);
+        }
+    }
+    
+    return (mBusy || hadCompleted || mQueuedCount > 0);
+}
+
+int DownloadQueue::Perform() {
     // 检查卡住的下载
     CheckForStuckDownloads();
+    ShapeTraffic();
     
     int still_alive = 1;
     int msgs_left = -1;
@@ -227,40 +1295,22 @@ int DownloadQueue::Process() {
         DownloadOperation* download = nullptr;
         curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &download);
         curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &download->response_code);
+        download->retryAfter = 0;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_RETRY_AFTER, &download->retryAfter);
         
         // 检查 CURL 错误
         CURLcode result = msg->data.result;
         
+        CollectMetrics(download);
         TransferFinish(download);
-        StartTransfersFromQueue();
-        
-        // 设置状态
-        if (result == CURLE_OK && download->response_code == 200) {
-            download->status = DownloadStatus::COMPLETE;
-            if (FileLogger::GetInstance().IsVerbose()) {
-                FileLogger::GetInstance().LogDebug("[DOWNLOAD] Complete (HTTP %ld): %s (%zu bytes)", 
-                           download->response_code, download->url.c_str(), download->buffer.size());
-            }
-        } else {
-            download->status = DownloadStatus::FAILED;
-            if (result != CURLE_OK) {
-                FileLogger::GetInstance().LogError("[DOWNLOAD] Failed (CURL error %d: %s): %s", 
-                           result, curl_easy_strerror(result), download->url.c_str());
-            } else {
-                FileLogger::GetInstance().LogError("[DOWNLOAD] Failed (HTTP %ld): %s", 
-                           download->response_code, download->url.c_str());
-            }
-        }
-        
-        // 调用回调
-        if (download->cb) {
-            download->cb(download);
-        }
+        HandleResult(download, result);
     }
     
-    // 启动队列中的新传输
+    // 启动队列中的新传输 (包括到期的重试), 已经过期的不再开始
+    DropExpired();
+    RequeueDueRetries();
     StartTransfersFromQueue();
     
     // 返回是否还有活动的下载
-    return (still_alive || msgs_left > 0 || !mQueue.empty());
+    return (still_alive || msgs_left > 0 || CountQueued() > 0 || !mRetrying.Empty());
 }
@@ -1,10 +1,20 @@
 #pragma once
 
 #include <string>
-#include <list>
+#include <iterator>
+#include <vector>
+#include <map>
 #include <functional>
 #include <curl/curl.h>
+#include <coreinit/time.h>
+#include "ResolveCache.hpp"
 #include <chrono>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
 
 // 下载状态
 enum class DownloadStatus {
@@ -14,40 +24,312 @@ enum class DownloadStatus {
     FAILED       // 下载失败
 };
 
+// 下载优先级 (数值越小越先开始)
+enum class DownloadPriority {
+    HIGH = 0,    // 用户正在查看的内容
+    NORMAL,      // 默认
+    LOW,         // 已滚出屏幕或预取的内容
+    COUNT
+};
+
+// 流量类别: 有交互流量 (HIGH / NORMAL 优先级的 INTERACTIVE 传输) 时, 限制其它类别的速度,
+// 后台传输也暂不开始, 界面等待的内容先拿到带宽
+enum class DownloadTraffic {
+    INTERACTIVE, // 缩略图、高清预览、API 请求 (默认)
+    BULK,        // 用户要求的大文件 (主题包), 限速到 BULK_SHARE_BYTES_PER_SEC
+    BACKGROUND   // 用户不在等待的下载 (背景音乐、插件、安装后的预览图), 限速到 BACKGROUND_BYTES_PER_SEC
+};
+
+// 下载数据的去向
+enum class DownloadSink {
+    MEMORY,   // 写入 buffer (默认, 根据 Content-Length 预分配)
+    FILE,     // 直接写入 filePath 指定的文件
+    CALLBACK  // 每个数据块交给 chunkCb 处理
+};
+
+// 单次传输的耗时统计 (毫秒, 由 curl_easy_getinfo 获得; 各阶段从请求开始累计)
+struct TransferMetrics {
+    float queueMs = 0;        // 入队到开始传输的等待时间
+    float dnsMs = 0;          // DNS 解析完成
+    float connectMs = 0;      // TCP 连接完成
+    float tlsMs = 0;          // TLS 握手完成 (复用连接时为 0)
+    float ttfbMs = 0;         // 收到第一个字节
+    float totalMs = 0;        // 传输结束
+    size_t bytes = 0;         // 下载字节数
+    float bytesPerSec = 0;    // 平均速度
+    bool reusedConnection = false; // 没有建立新连接
+};
+
+// 下载队列的滚动统计 (最近 STATS_WINDOW 次传输)
+struct NetworkStats {
+    float latencyP50Ms = 0;   // 总耗时中位数
+    float latencyP95Ms = 0;
+    float ttfbP50Ms = 0;      // 首字节中位数 (区分服务器慢还是带宽慢)
+    float queueP50Ms = 0;     // 排队等待中位数 (区分网络慢还是我们自己排队慢)
+    float bytesPerSec = 0;    // 窗口内的平均吞吐
+    float failureRate = 0;    // 窗口内失败的比例 (0-1)
+    size_t samples = 0;       // 窗口内的样本数
+    uint32_t totalCompleted = 0;
+    uint32_t totalFailed = 0;
+    uint32_t totalRetries = 0;
+    uint32_t totalExpired = 0;   // 过期后没有开始就被丢弃的请求
+    uint64_t totalBytes = 0;
+    size_t queued = 0;        // 当前排队数
+    int active = 0;           // 当前活动传输数
+    int parallelLimit = 0;    // 当前并发上限
+};
+
+// 下载任务的句柄: 任务表中的槽位编号和代数
+// 任务结束 (完成、失败) 或被取消时槽位回收、代数加 1, 旧句柄不再指向任何任务;
+// 界面可以一直保存句柄, 之后用它取消或调整优先级时只会什么都不做, 不会访问已经释放的 DownloadOperation
+struct DownloadHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0;  // 0 表示空句柄
+    
+    bool IsValid() const { return generation != 0; }
+    bool operator==(const DownloadHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const DownloadHandle& other) const { return !(*this == other); }
+};
+
+class DownloadList;
+class ProgressChannel;
+
 // 下载操作
 struct DownloadOperation {
     std::string url;                                     // URL
     std::string postData;                                // POST 数据 (空表示 GET 请求)
-    std::string buffer;                                  // 下载数据缓冲区
+    std::string buffer;                                  // 下载数据缓冲区 (仅 MEMORY 模式)
+    
+    // 数据接收方式
+    DownloadSink sink = DownloadSink::MEMORY;
+    std::string filePath;                                // FILE 模式的目标文件
+    std::function<bool(const char*, size_t)> chunkCb;    // CALLBACK 模式, 返回 false 中止传输
+                                                         // (网络线程模式下在网络线程中调用)
+    FILE* file = nullptr;                                // FILE 模式的文件句柄 (由队列管理)
+    size_t bytesReceived = 0;                            // 已接收字节数
+    curl_off_t contentLength = -1;                       // 响应的 Content-Length (-1 表示未知)
+    ProgressChannel* progress = nullptr;                 // 不为空时网络线程收到数据就更新其中的字节数和速度
+                                                         // (界面读取这里, 不直接读上面两个字段)
+    
+    // 压缩传输: 请求服务器压缩响应 (gzip / deflate, curl 支持时也包括 br), curl 边接收边解压,
+    // buffer / 文件 / chunkCb 收到的都是解压后的数据, contentLength 是压缩后的长度
+    // 用于 JSON 这类文本响应; 图片和压缩包本身已经压缩, 不需要
+    bool compressed = false;
+    
+    // 只发送 HEAD 请求, 不接收内容 (预热连接用)
+    bool headOnly = false;
+    
+    // 范围请求: 不为空时发送 Range (例如 "100-199"), 服务器返回 206 视为成功
+    std::string range;
+    // 和 range 一起发送的 If-Range (强 ETag 或 Last-Modified): 文件已经改变时服务器返回 200 和完整内容
+    std::string ifRange;
+    std::string contentRange;                            // 响应的 Content-Range
+    std::string digest;                                  // 响应的 Repr-Digest / Digest (完整内容的摘要, 范围请求也一样)
+    
     DownloadStatus status = DownloadStatus::QUEUED;     // 状态
+    DownloadPriority priority = DownloadPriority::NORMAL; // 优先级
+    DownloadTraffic traffic = DownloadTraffic::INTERACTIVE; // 流量类别
+    curl_off_t recvLimit = 0;                            // 当前设置的接收限速 (0 表示不限)
     CURL* eh = nullptr;                                  // Easy handle
     std::function<void(DownloadOperation*)> cb;          // 完成回调
     void* cbdata = nullptr;                              // 回调数据
     long response_code = 0;                              // HTTP 响应码
+    CURLcode result = CURLE_OK;                          // 最近一次传输的 curl 结果
+    // 网络线程模式下直接在网络线程中回调, 不等主循环的 Process()
+    // (给自己有工作线程并等待结果的调用者使用, 回调中只能做同步通知)
+    bool callbackOnNetworkThread = false;
     std::chrono::steady_clock::time_point startTime;     // 下载开始时间
+    std::chrono::steady_clock::time_point queuedTime;    // 加入队列的时间
+    OSTime traceStart = 0;                               // 传输开始的系统时间 (Trace 记录)
+    TransferMetrics metrics;                             // 最近一次传输的耗时统计
+    
+    // 重试策略: 暂时性的网络错误和 5xx/429 会在退避后自动重试
+    int maxRetries = 2;                                  // 最大重试次数 (0 表示不重试)
+    int attempt = 0;                                     // 已经重试的次数
+    std::chrono::steady_clock::time_point retryAt;       // 下次重试的时间
+    std::chrono::steady_clock::time_point lastProgress;  // 最近一次收到数据的时间
+    size_t lastProgressBytes = 0;
+    curl_off_t retryAfter = 0;                           // 服务器的 Retry-After (秒)
+    
+    // 时间预算 (界面等待的小请求, 例如缩略图): 大于 0 时每次尝试的总时间不超过 budgetMs,
+    // 连接超时缩短到 FAST_CONNECT_TIMEOUT_MS 以内, 重试按 FAST_RETRY_* 的短退避; 慢的连接尽早放弃换一个新的
+    // 为 0 (默认) 时只按停滞检测判断超时, 慢速但正常的大文件不会被中断
+    int budgetMs = 0;
+    // 截止时间: 同一优先级的队列中有截止时间的任务按截止时间先后排在没有的前面; 默认值表示没有
+    std::chrono::steady_clock::time_point deadline{};
+    // 结果在这之后不再有用: 到时还在排队或等待重试的任务不再开始, 以 FAILED / CURLE_OPERATION_TIMEDOUT 回调
+    // (expired 为 true); 已经开始的传输不受影响. 默认值表示一直有用, 可以用 DownloadSetPriority 延长或清除
+    std::chrono::steady_clock::time_point expiresAt{};
+    bool expired = false;
+    
+    // 条件请求: 设置后发送 If-None-Match / If-Modified-Since
+    // 服务器返回 304 时 status 为 COMPLETE 且 notModified 为 true, buffer 为空
+    std::string ifNoneMatch;
+    std::string ifModifiedSince;
+    std::string etag;                                    // 响应的 ETag
+    std::string lastModified;                            // 响应的 Last-Modified
+    bool notModified = false;
+    struct curl_slist* headers = nullptr;                // 请求头 (传输结束时释放)
+    struct curl_slist* resolve = nullptr;                // CURLOPT_RESOLVE 列表 (传输结束时释放)
+    bool cachedAddress = false;                          // 使用了 ResolveCache 中保存的地址
+    std::string host;                                    // URL 中的主机名 (入队时解析)
+    bool prewarm = false;                                // 队列自己创建的预热请求, 结束后由队列释放
+    
+    // 以下由队列管理
+    DownloadHandle handle;                               // DownloadAdd 返回的句柄 (结束后保留原值)
+    DownloadList* list = nullptr;                        // 所在的链表 (等待、活动或重试), 不在队列中时为空
+    DownloadOperation* listPrev = nullptr;
+    DownloadOperation* listNext = nullptr;
+};
+
+// 侵入式双向链表: 链接保存在 DownloadOperation 中, 一个任务同一时间最多在一个链表里
+// (某个优先级的等待队列、活动的传输、等待重试), 加入和移除都是 O(1), 不分配内存
+// 只在驱动 curl 的线程中使用; 遍历时要移除当前节点的, 先取出下一个节点
+class DownloadList {
+public:
+    class Iterator {
+    public:
+        explicit Iterator(DownloadOperation* node) : mNode(node) {}
+        DownloadOperation* operator*() const { return mNode; }
+        Iterator& operator++() { mNode = mNode->listNext; return *this; }
+        bool operator!=(const Iterator& other) const { return mNode != other.mNode; }
+        bool operator==(const Iterator& other) const { return mNode == other.mNode; }
+        
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = DownloadOperation*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = DownloadOperation* const*;
+        using reference = DownloadOperation*;
+        
+    private:
+        DownloadOperation* mNode;
+    };
+    
+    DownloadList() = default;
+    DownloadList(const DownloadList&) = delete;
+    DownloadList& operator=(const DownloadList&) = delete;
+    
+    Iterator begin() const { return Iterator(mHead); }
+    Iterator end() const { return Iterator(nullptr); }
+    DownloadOperation* Front() const { return mHead; }
+    bool Empty() const { return mHead == nullptr; }
+    size_t Size() const { return mSize; }
+    bool Contains(const DownloadOperation* download) const { return download->list == this; }
+    
+    void PushBack(DownloadOperation* download) {
+        download->list = this;
+        download->listPrev = mTail;
+        download->listNext = nullptr;
+        (mTail ? mTail->listNext : mHead) = download;
+        mTail = download;
+        mSize++;
+    }
+    
+    // 插到 position 前面, position 为空时加到末尾
+    void InsertBefore(DownloadOperation* download, DownloadOperation* position) {
+        if (!position) {
+            PushBack(download);
+            return;
+        }
+        download->list = this;
+        download->listPrev = position->listPrev;
+        download->listNext = position;
+        (position->listPrev ? position->listPrev->listNext : mHead) = download;
+        position->listPrev = download;
+        mSize++;
+    }
+    
+    void PushFront(DownloadOperation* download) {
+        download->list = this;
+        download->listPrev = nullptr;
+        download->listNext = mHead;
+        (mHead ? mHead->listPrev : mTail) = download;
+        mHead = download;
+        mSize++;
+    }
+    
+    // download 必须在这个链表中
+    void Remove(DownloadOperation* download) {
+        (download->listPrev ? download->listPrev->listNext : mHead) = download->listNext;
+        (download->listNext ? download->listNext->listPrev : mTail) = download->listPrev;
+        download->list = nullptr;
+        download->listPrev = nullptr;
+        download->listNext = nullptr;
+        mSize--;
+    }
+    
+private:
+    DownloadOperation* mHead = nullptr;
+    DownloadOperation* mTail = nullptr;
+    size_t mSize = 0;
 };
 
 // 下载队列管理器 (单例)
+// 网络线程模式下由后台线程驱动 curl (curl_multi_poll), 完成回调仍然在
+// 调用 Process() 的线程 (主循环) 中执行
 class DownloadQueue {
 public:
-    static void Init();
+    static void Init(bool useNetworkThread = false);
     static void Quit();
     
-    // 添加下载任务
-    void DownloadAdd(DownloadOperation* download);
+    // 添加下载任务, 返回它的句柄 (同时保存在 download->handle 中)
+    // download 由调用者拥有, 在完成回调中或 DownloadCancel 返回后才能释放
+    DownloadHandle DownloadAdd(DownloadOperation* download);
+    
+    // 取消下载任务; 返回后不会再有回调. 句柄已经失效 (任务已结束) 时只丢弃还没执行的回调
+    void DownloadCancel(DownloadHandle handle);
+    void DownloadCancel(DownloadOperation* download) { DownloadCancel(download->handle); }
     
-    // 取消下载任务
-    void DownloadCancel(DownloadOperation* download);
+    // 调整排队中任务的优先级 (已开始的传输不受影响, 句柄失效时不做任何事)
+    // 提升到 HIGH 的任务会排到该优先级队列的最前面 (有截止时间的任务之后)
+    // 同时把过期时间设为 expiresAt (等待重试的任务也一样), 默认值表示一直有用
+    void DownloadSetPriority(DownloadHandle handle, DownloadPriority priority,
+                             std::chrono::steady_clock::time_point expiresAt = {});
+    void DownloadSetPriority(DownloadOperation* download, DownloadPriority priority,
+                             std::chrono::steady_clock::time_point expiresAt = {}) {
+        DownloadSetPriority(download->handle, priority, expiresAt);
+    }
+    
+    // 任务还在队列中 (排队、传输或等待重试), 可以在任意线程调用
+    bool IsPending(DownloadHandle handle) const;
+    
+    // 预热连接: 在后台向 url 的主机发送一个 HEAD 请求, 完成 DNS / TCP / TLS 握手,
+    // 之后的请求复用连接缓存中的连接和 TLS 会话; 同一主机 PREWARM_INTERVAL_SECONDS 内只预热一次
+    // 只在主线程调用
+    void Prewarm(const std::string& url);
+    
+    // 暂停所有传输 (进入后台时由 AppLifecycle 调用): 不再开始新的传输, 正在进行的传输用 curl_easy_pause 停住,
+    // 已经收到的数据、文件位置和连接都保留, Resume 后接着传输; 暂停期间不做卡住检测
+    // 连接在暂停期间被服务器关闭时按普通的网络错误重试
+    void Suspend();
+    void Resume();
+    
+    // 排队中 (未开始) 的任务数量
+    size_t GetQueuedCount() const;
     
     // 处理下载队列 (在主循环中调用)
+    // 网络线程模式下只负责执行已完成任务的回调
     // 返回值: 是否还有活动的下载
     int Process();
     
+    bool IsThreaded() const { return mThreaded; }
+    
+    // 缓存校验信息 (ETag / Last-Modified) 的读写, 保存在缓存文件旁的 .meta 文件中
+    static bool LoadValidators(const std::string& metaPath, DownloadOperation* download);
+    static bool SaveValidators(const std::string& metaPath, const DownloadOperation* download);
+    
+    // 当前的全局并发上限 (根据吞吐和错误动态调整)
+    int GetParallelLimit() const { return mParallelLimit; }
+    
+    // 网络统计 (可以在任意线程调用)
+    NetworkStats GetStats() const;
+    void LogStats() const;
+    
     // 获取全局实例
     static DownloadQueue* GetInstance() { return sDownloadQueue; }
     
 private:
-    DownloadQueue();
+    explicit DownloadQueue(bool useNetworkThread);
     ~DownloadQueue();
     
     void TransferStart(DownloadOperation* download);
@@ -55,12 +337,144 @@ private:
     void StartTransfersFromQueue();
     void CheckForStuckDownloads(); // 检查卡住的下载
     
+    // 传输结束: 成功、失败回调或安排重试
+    void HandleResult(DownloadOperation* download, CURLcode result);
+    
+    // 统计
+    struct StatsSample {
+        float totalMs;
+        float ttfbMs;
+        float queueMs;
+        size_t bytes;
+        bool failed;
+    };
+    void CollectMetrics(DownloadOperation* download);
+    void RecordStats(const DownloadOperation* download, bool success, bool retrying);
+    static bool IsTransientError(CURLcode result, long responseCode);
+    bool ScheduleRetry(DownloadOperation* download, curl_off_t retryAfterSeconds);
+    void RequeueDueRetries();
+    DownloadList& QueueFor(DownloadPriority priority);
+    // 按截止时间放进所在优先级的等待队列; front 为 true 时排在没有截止时间 (或截止时间相同) 的任务前面
+    void InsertQueued(DownloadOperation* download, bool front);
+    // 丢弃已经过期的排队和等待重试的任务
+    void DropExpired();
+    bool IsQueued(const DownloadOperation* download) const; // 在某个优先级的等待队列中
+    size_t CountQueued() const;
+    
+    // 任务表: 槽位保存任务的指针和代数; 分配在调用 DownloadAdd 的线程, 查找和回收在驱动 curl 的线程
+    struct Slot {
+        DownloadOperation* download = nullptr;
+        uint32_t generation = 1;
+    };
+    DownloadHandle AllocateSlot(DownloadOperation* download);
+    DownloadOperation* Resolve(DownloadHandle handle) const;  // 句柄失效时返回 nullptr
+    void ReleaseSlot(DownloadOperation* download);            // 任务离开队列 (完成回调或取消之前)
+    
+    // 自适应并发控制 (AIMD: 成功时缓慢增加, 超时/限流时减半)
+    struct HostState {
+        int active = 0;                        // 该主机的活动传输数
+        int limit = INITIAL_PARALLEL_DOWNLOADS; // 该主机的并发上限
+        int successStreak = 0;                 // 上次调整后连续成功的次数
+    };
+    static std::string ParseHost(const std::string& url);
+    bool CanStart(const DownloadOperation* download);
+    
+    // 流量整形: 有交互流量时 (以及之后 INTERACTIVE_HOLD_MS 内) 限制 BULK / BACKGROUND 传输的速度
+    bool HasInteractiveDemand() const;
+    void ShapeTraffic();
+    void ApplyRecvLimit(DownloadOperation* download);
+    void AdaptConcurrency(DownloadOperation* download, CURLcode result);
+    
+    // 驱动 multi handle 一轮, 返回是否还有活动的下载
+    int Perform();
+    // 下载结束: 单线程模式直接回调, 网络线程模式投递到 mCompleted
+    void NotifyComplete(DownloadOperation* download);
+    
+    // easy handle 复用 (保留连接和 TLS 会话)
+    CURL* AcquireHandle();
+    void ReleaseHandle(CURL* handle);
+    
+    // 以下仅在队列线程中执行 (单线程模式即主线程)
+    void ApplyAdd(DownloadOperation* download);
+    void ApplyCancel(DownloadHandle handle);
+    void ApplyPriority(DownloadHandle handle, DownloadPriority priority,
+                       std::chrono::steady_clock::time_point expiresAt);
+    void ApplySuspend(bool suspended);
+    
+    // 网络线程
+    struct Command {
+        enum Type { ADD, CANCEL, SET_PRIORITY, SUSPEND, RESUME } type;
+        DownloadOperation* download;  // 只有 ADD 使用
+        DownloadHandle handle;
+        DownloadPriority priority;
+        std::chrono::steady_clock::time_point expiresAt;  // 只有 SET_PRIORITY 使用
+    };
+    void NetworkThreadFunc();
+    void PostCommand(const Command& command);
+    void ProcessCommands();
+    
+    bool mThreaded = false;
+    std::thread mThread;
+    std::atomic<bool> mStopThread{false};
+    std::atomic<bool> mBusy{false};              // 网络线程是否还有任务
+    std::atomic<size_t> mQueuedCount{0};         // 排队任务数快照
+    
+    // mPostMutex 保护 mCommands / mCompleted, 只在很短的时间内持有
+    // 网络线程在持有它时不会调用 curl, 主线程不会因为网络阻塞
+    std::mutex mPostMutex;
+    std::condition_variable mCommandCv;
+    std::vector<Command> mCommands;              // 主线程 -> 网络线程
+    std::vector<DownloadOperation*> mCompleted;  // 网络线程 -> 主线程
+    uint32_t mCommandsPosted = 0;
+    uint32_t mCommandsDone = 0;
+    
     CURLM* mCurlMulti = nullptr;           // CURL multi handle
-    std::list<DownloadOperation*> mQueue;  // 等待队列
-    std::list<DownloadOperation*> mActive; // 活动的下载
+    CURLSH* mCurlShare = nullptr;          // 共享 DNS / TLS 会话 / 连接缓存
+    std::vector<CURL*> mHandlePool;        // 空闲的 easy handle
+    ResolveCache mResolveCache;            // 上次运行时各主机的地址 (驱动 curl 的线程)
+    static constexpr int PRIORITY_COUNT = (int)DownloadPriority::COUNT;
+    DownloadList mQueue[PRIORITY_COUNT];   // 按优先级分开的等待队列
+    DownloadList mActive;                  // 活动的下载
+    DownloadList mRetrying;                // 等待重试的下载
+    mutable std::mutex mSlotMutex;         // 保护 mSlots / mFreeSlots, 不在持有时调用 curl
+    std::vector<Slot> mSlots;
+    std::vector<uint32_t> mFreeSlots;
+    std::minstd_rand mRng;                 // 退避抖动
     int mActiveTransfers = 0;              // 活动的传输数量
+    std::atomic<int> mParallelLimit{INITIAL_PARALLEL_DOWNLOADS}; // 全局并发上限
+    int mGlobalSuccessStreak = 0;
+    std::map<std::string, HostState> mHosts; // 按主机分开的并发状态 (API / CDN)
+    bool mShaping = false;                   // 正在限制 BULK / BACKGROUND 传输
+    bool mSuspended = false;                 // 在后台, 传输都已暂停 (驱动 curl 的线程)
+    int mLifecycleListener = 0;
+    std::chrono::steady_clock::time_point mLastInteractive; // 最近一次有交互流量的时间
+    std::map<std::string, std::chrono::steady_clock::time_point> mPrewarmedAt; // 上次预热的时间 (主线程)
+    
+    mutable std::mutex mStatsMutex;                  // 保护以下统计数据
+    std::vector<StatsSample> mStatsWindow;           // 环形缓冲
+    size_t mStatsNext = 0;
+    uint32_t mTotalCompleted = 0;
+    uint32_t mTotalFailed = 0;
+    uint32_t mTotalRetries = 0;
+    uint32_t mTotalExpired = 0;
+    uint64_t mTotalBytes = 0;
+    std::atomic<int> mActiveSnapshot{0};             // mActiveTransfers 的快照
     
     static DownloadQueue* sDownloadQueue;  // 全局单例
-    static constexpr int MAX_PARALLEL_DOWNLOADS = 4; // 最大并发下载数
-    static constexpr int DOWNLOAD_TIMEOUT_SECONDS = 60; // 下载超时 (60秒)
+    static constexpr int INITIAL_PARALLEL_DOWNLOADS = 4; // 初始并发下载数
+    static constexpr int MIN_PARALLEL_DOWNLOADS = 1;     // 并发下限
+    static constexpr int MAX_PARALLEL_DOWNLOADS = 8;     // 并发上限 (也是连接池大小)
+    static constexpr int STALL_TIMEOUT_SECONDS = 30;    // 超过此时间没有收到任何数据视为卡住
+    static constexpr long CONNECT_TIMEOUT_MS = 10000;   // 连接超时 (没有时间预算的任务)
+    static constexpr long FAST_CONNECT_TIMEOUT_MS = 3000; // 有时间预算的任务的连接超时上限
+    static constexpr int CONNECT_GRACE_SECONDS = 10;    // 停滞检测额外给出的连接时间
+    static constexpr int RETRY_BASE_DELAY_MS = 500;     // 第一次重试的基础延迟
+    static constexpr int RETRY_MAX_DELAY_MS = 8000;     // 重试延迟上限
+    static constexpr int FAST_RETRY_BASE_DELAY_MS = 150; // 有时间预算的任务的重试延迟
+    static constexpr int FAST_RETRY_MAX_DELAY_MS = 1000;
+    static constexpr size_t STATS_WINDOW = 64;          // 滚动统计的样本数
+    static constexpr int PREWARM_INTERVAL_SECONDS = 60; // 空闲连接大约保持这么久, 之内不再重复预热
+    static constexpr curl_off_t BULK_SHARE_BYTES_PER_SEC = 256 * 1024; // 有交互流量时每个 BULK 传输的限速
+    static constexpr curl_off_t BACKGROUND_BYTES_PER_SEC = 32 * 1024;  // 有交互流量时每个 BACKGROUND 传输的限速
+    static constexpr int INTERACTIVE_HOLD_MS = 1000;    // 交互流量结束后继续限速的时间 (翻页时不反复切换)
 };
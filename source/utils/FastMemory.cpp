@@ -0,0 +1,166 @@
+#include "FastMemory.hpp"
+#include "FileLogger.hpp"
+#include "AppLifecycle.hpp"
+#include "MemoryPressure.hpp"
+#include <coreinit/memexpheap.h>
+#include <coreinit/memfrmheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/time.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <malloc.h>
+#include <mutex>
+
+// 下面的状态都受 sMutex 保护
+static std::mutex sMutex;
+static std::condition_variable sReleasedCv;  // sBlocks 变为 0 时通知
+static MEMHeapHandle sHeap = nullptr;        // 建在 MEM1 那一块上的扩展堆, 不可用时为空
+static uint8_t* sBase = nullptr;
+static size_t sSize = 0;
+static size_t sBlocks = 0;                    // 还没释放的 MEM1 块
+static size_t sUsed = 0;
+static size_t sPeak = 0;
+static uint32_t sFallbacks = 0;
+static bool sReleasing = false;
+
+// 调用者持有 sMutex
+static void Acquire() {
+    if (sHeap) {
+        return;
+    }
+    MEMHeapHandle mem1 = MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1);
+    // 帧堆的尾部只有这里使用. SDL 进入后台时按它记录的状态释放, 可能把尾部恢复成上次被占用的样子,
+    // 所以先把尾部整个释放: 无论 SDL 先还是后取得 MEM1, 这一块都还在原来的位置
+    MEMFreeToFrmHeap(mem1, MEM_FRM_HEAP_FREE_TAIL);
+    size_t available = MEMGetAllocatableSizeForFrmHeapEx(mem1, (int)FastMemory::DEFAULT_ALIGNMENT);
+    size_t size = std::min(available, FastMemory::ARENA_SIZE) & ~(FastMemory::DEFAULT_ALIGNMENT - 1);
+    if (size < FastMemory::MIN_ARENA_SIZE) {
+        FileLogger::GetInstance().LogWarning("[FastMemory] MEM1 unavailable (%zu bytes free), using MEM2", available);
+        return;
+    }
+    // 负的对齐值表示从尾部分配
+    void* base = MEMAllocFromFrmHeapEx(mem1, (uint32_t)size, -(int)FastMemory::DEFAULT_ALIGNMENT);
+    if (!base) {
+        return;
+    }
+    sHeap = MEMCreateExpHeapEx(base, (uint32_t)size, 0);
+    if (!sHeap) {
+        MEMFreeToFrmHeap(mem1, MEM_FRM_HEAP_FREE_TAIL);
+        return;
+    }
+    sBase = (uint8_t*)base;
+    sSize = size;
+    FileLogger::GetInstance().LogInfo("[FastMemory] Acquired %zu KB of MEM1", size >> 10);
+}
+
+static void Release() {
+    std::unique_lock<std::mutex> lock(sMutex);
+    if (!sHeap) {
+        return;
+    }
+    // 新的分配退回 MEM2, 等正在使用的块释放 (持有者只在一次操作之内持有)
+    sReleasing = true;
+    OSTime start = OSGetSystemTime();
+    sReleasedCv.wait(lock, []() { return sBlocks == 0; });
+    MEMDestroyExpHeap(sHeap);
+    MEMFreeToFrmHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1), MEM_FRM_HEAP_FREE_TAIL);
+    sHeap = nullptr;
+    sBase = nullptr;
+    sSize = 0;
+    sUsed = 0;
+    sReleasing = false;
+    FileLogger::GetInstance().LogInfo("[FastMemory] Released MEM1 (waited %llu ms)",
+                                      (unsigned long long)OSTicksToMilliseconds(OSGetSystemTime() - start));
+}
+
+void FastMemory::Init() {
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        Acquire();
+    }
+    // 最先注册, 进入后台时最后释放: 其它流水线已经暂停, 只等还在用的块
+    AppLifecycle::AddListener("FastMemory", Release, []() {
+        std::lock_guard<std::mutex> lock(sMutex);
+        Acquire();
+    });
+}
+
+void FastMemory::Shutdown() {
+    Release();
+}
+
+void* FastMemory::Alloc(size_t size, size_t align) {
+    if (size == 0) {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        if (sHeap && !sReleasing) {
+            void* ptr = MEMAllocFromExpHeapEx(sHeap, (uint32_t)size, (int)align);
+            if (ptr) {
+                sBlocks++;
+                sUsed += MEMGetSizeForMBlockExpHeap(ptr);
+                sPeak = std::max(sPeak, sUsed);
+                return ptr;
+            }
+            sFallbacks++;
+        }
+    }
+    void* ptr = memalign(align, size);
+    if (!ptr) {
+        MemoryPressure::Signal(MemoryPressure::LEVEL_CRITICAL, "FastMemory");
+    }
+    return ptr;
+}
+
+void FastMemory::Free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        if ((uint8_t*)ptr >= sBase && (uint8_t*)ptr < sBase + sSize) {
+            sUsed -= MEMGetSizeForMBlockExpHeap(ptr);
+            MEMFreeToExpHeap(sHeap, ptr);
+            if (--sBlocks == 0 && sReleasing) {
+                sReleasedCv.notify_all();
+            }
+            return;
+        }
+    }
+    free(ptr);
+}
+
+bool FastMemory::Owns(const void* ptr) {
+    std::lock_guard<std::mutex> lock(sMutex);
+    return (const uint8_t*)ptr >= sBase && (const uint8_t*)ptr < sBase + sSize;
+}
+
+voidpf FastMemory::ZAlloc(voidpf, uInt items, uInt size) {
+    return Alloc((size_t)items * size);
+}
+
+void FastMemory::ZFree(voidpf, voidpf ptr) {
+    Free(ptr);
+}
+
+size_t FastMemory::GetCapacity() {
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sSize;
+}
+
+size_t FastMemory::GetUsed() {
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sUsed;
+}
+
+size_t FastMemory::GetPeak() {
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sPeak;
+}
+
+uint32_t FastMemory::GetFallbackCount() {
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sFallbacks;
+}
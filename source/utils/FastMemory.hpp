@@ -0,0 +1,39 @@
+#pragma once
+
+#include <zlib.h>
+#include <cstddef>
+#include <cstdint>
+
+// MEM1 快速内存: 前台时从 MEM1 帧堆的尾部取一块 (ARENA_SIZE), 在上面建一个扩展堆,
+// 给访问密集、用完就释放的工作缓冲区使用 (解压窗口、补丁的源文件窗口、上传纹理前的临时像素等)
+// MEM1 没有空间、已经用完或正在进入后台时 Alloc 退回 MEM2 (memalign), Free 按地址判断来源, 调用者不用区分
+// 进入后台时 (AppLifecycle, 在主线程上) 先停止分配, 等所有 MEM1 块都释放后才交还 MEM1;
+// 所以这里分配的块只能在一次操作 (一个条目、一个文件) 之内持有, 持有期间不能等待主线程、网络或暂停的流水线
+// 回到前台时重新取得
+class FastMemory {
+public:
+    static constexpr size_t ARENA_SIZE = 4 * 1024 * 1024;
+    static constexpr size_t MIN_ARENA_SIZE = 512 * 1024;
+    static constexpr size_t DEFAULT_ALIGNMENT = 0x40;
+
+    // AppLifecycle::Init 之后、Gfx::Init 之前调用 (SDL 会占用 MEM1 帧堆剩下的全部空间)
+    static void Init();
+    // 所有使用者的线程停止之后调用
+    static void Shutdown();
+
+    static void* Alloc(size_t size, size_t align = DEFAULT_ALIGNMENT);
+    // 可以传入 Alloc 退回 MEM2 时分配的块或 nullptr
+    static void Free(void* ptr);
+    // ptr 在 MEM1 的那一块里 (文件读写不能直接传输, 见 FileIO)
+    static bool Owns(const void* ptr);
+
+    // 给 z_stream 的 zalloc / zfree, inflate 的状态和 32KB 窗口放在 MEM1
+    static voidpf ZAlloc(voidpf opaque, uInt items, uInt size);
+    static void ZFree(voidpf opaque, voidpf ptr);
+
+    static size_t GetCapacity();
+    static size_t GetUsed();
+    static size_t GetPeak();
+    // MEM1 可用但空间不够、退回 MEM2 的次数
+    static uint32_t GetFallbackCount();
+};
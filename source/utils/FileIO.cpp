@@ -0,0 +1,386 @@
+#include "FileIO.hpp"
+#include "FileLogger.hpp"
+#include "FastMemory.hpp"
+#include "../common.h"
+#include <coreinit/filesystem_fsa.h>
+#include <mocha/mocha.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+
+static const char* SD_PREFIX = "fs:/vol/external01/";
+static const char* SD_FSA_PREFIX = "/vol/external01/";
+static const char* MLC_PREFIX = MLC_STORAGE_PATH ":/";
+static const char* MLC_FSA_PREFIX = "/vol/storage_mlc01/";
+
+// 进程共用一个 FSA 客户端 (FSA 调用本身可以在多个线程同时进行)
+static std::mutex sClientMutex;
+static FSAClientHandle sClient = -1;
+static bool sClientTried = false;
+static bool sMlcUnlocked = false;
+
+static bool StartsWith(const std::string& str, const char* prefix) {
+    return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// 返回 FSA 路径, 这个路径不能 (或不应该) 用 FSA 访问时返回空字符串
+static std::string ToFsaPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(sClientMutex);
+    if (!sClientTried) {
+        sClientTried = true;
+        FSAInit();
+        sClient = FSAAddClient(nullptr);
+        if (sClient < 0) {
+            FileLogger::GetInstance().LogWarning("[FileIO] FSAAddClient failed (%d), using POSIX I/O", (int)sClient);
+        }
+    }
+    if (sClient < 0) {
+        return "";
+    }
+
+    if (StartsWith(path, SD_PREFIX)) {
+        return SD_FSA_PREFIX + path.substr(strlen(SD_PREFIX));
+    }
+    if (StartsWith(path, MLC_PREFIX)) {
+        // MLC 需要 Mocha 给客户端加上权限; Mocha 初始化之前会失败, 下次再试
+        if (!sMlcUnlocked) {
+            sMlcUnlocked = (Mocha_UnlockFSClientEx(sClient) == MOCHA_RESULT_SUCCESS);
+        }
+        if (sMlcUnlocked) {
+            return MLC_FSA_PREFIX + path.substr(strlen(MLC_PREFIX));
+        }
+    }
+    return "";
+}
+
+static bool IsAligned(const void* ptr) {
+    return ((uintptr_t)ptr & (FileIO::BUFFER_ALIGNMENT - 1)) == 0;
+}
+
+// FSA 要求对齐; IOS 只能访问 MEM2, MEM1 里的缓冲区 (FastMemory) 不论哪个后端都经过中转
+bool FileIO::NeedsBounce(const void* ptr) const {
+    return (mBackend == BACKEND_FSA && !IsAligned(ptr)) || FastMemory::Owns(ptr);
+}
+
+FileIO::Buffer::~Buffer() {
+    FastMemory::Free(mData);
+}
+
+FileIO::Buffer::Buffer(Buffer&& other) noexcept {
+    swap(other);
+}
+
+FileIO::Buffer& FileIO::Buffer::operator=(Buffer&& other) noexcept {
+    swap(other);
+    return *this;
+}
+
+void FileIO::Buffer::resize(size_t size, bool fastMemory) {
+    if (size == mSize) {
+        return;
+    }
+    FastMemory::Free(mData);
+    mData = nullptr;
+    mSize = 0;
+    if (size > 0) {
+        // 大小也补齐到对齐单位: FSA 按缓存行刷新和失效, 缓冲区末尾不能和别的数据共用缓存行
+        size_t allocSize = (size + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+        mData = fastMemory ? (uint8_t*)FastMemory::Alloc(allocSize, BUFFER_ALIGNMENT)
+                           : (uint8_t*)memalign(BUFFER_ALIGNMENT, allocSize);
+        mSize = mData ? size : 0;
+    }
+}
+
+void FileIO::Buffer::swap(Buffer& other) noexcept {
+    std::swap(mData, other.mData);
+    std::swap(mSize, other.mSize);
+}
+
+FileIO::~FileIO() {
+    Close();
+}
+
+bool FileIO::Open(const std::string& path, Mode mode) {
+    Close();
+    mPos = 0;
+    mEnd = 0;
+    mReserved = 0;
+    mFailed = false;
+
+    std::string fsaPath = ToFsaPath(path);
+    if (!fsaPath.empty()) {
+        const char* fsaMode = (mode == MODE_READ) ? "r" : (mode == MODE_WRITE) ? "w" : (mode == MODE_UPDATE) ? "r+" : "w+";
+        FSAFileHandle handle;
+        FSError err = FSAOpenFileEx(sClient, fsaPath.c_str(), fsaMode, (FSMode)0x660,
+                                    (FSOpenFileFlags)0, 0, &handle);
+        if (mode == MODE_UPDATE && err == FS_ERROR_NOT_FOUND) {
+            // "r+" 不创建文件; 文件还不存在, 没有要保留的内容
+            err = FSAOpenFileEx(sClient, fsaPath.c_str(), "w+", (FSMode)0x660, (FSOpenFileFlags)0, 0, &handle);
+        }
+        if (err == FS_ERROR_OK) {
+            mHandle = handle;
+            mBackend = BACKEND_FSA;
+            return true;
+        }
+        if (mode == MODE_READ && err == FS_ERROR_NOT_FOUND) {
+            return false;
+        }
+        // 其它错误 (权限等) 再用 POSIX 试一次
+    }
+
+    int flags = (mode == MODE_READ) ? O_RDONLY : (mode == MODE_WRITE) ? (O_WRONLY | O_CREAT | O_TRUNC)
+              : (mode == MODE_UPDATE) ? (O_RDWR | O_CREAT) : (O_RDWR | O_CREAT | O_TRUNC);
+    mFd = open(path.c_str(), flags, 0666);
+    if (mFd < 0) {
+        return false;
+    }
+    mBackend = BACKEND_POSIX;
+    return true;
+}
+
+bool FileIO::Close() {
+    bool ok = !mFailed;
+    if (mReserved > mEnd && IsOpen()) {
+        // 没有写满预留的空间 (出错或大小和预计的不同): 文件大小以实际写入的为准
+        ok = TruncateAt(mEnd) && ok;
+    }
+    mReserved = 0;
+    if (mBackend == BACKEND_FSA) {
+        ok = (FSACloseFile(sClient, mHandle) == FS_ERROR_OK) && ok;
+    } else if (mBackend == BACKEND_POSIX) {
+        ok = (close(mFd) == 0) && ok;
+    }
+    mBackend = BACKEND_NONE;
+    mHandle = 0;
+    mFd = -1;
+    return ok;
+}
+
+bool FileIO::TruncateAt(uint64_t size) {
+    if (mBackend == BACKEND_FSA) {
+        return FSASetPosFile(sClient, mHandle, (uint32_t)size) == FS_ERROR_OK &&
+               FSATruncateFile(sClient, mHandle) == FS_ERROR_OK;
+    }
+    return ftruncate(mFd, (off_t)size) == 0;
+}
+
+bool FileIO::Reserve(uint64_t size) {
+    if (!IsOpen() || size <= mEnd || size <= mReserved) {
+        return IsOpen();
+    }
+    bool ok;
+    if (mBackend == BACKEND_FSA) {
+        // FSAAppendFile 在文件末尾分配 size * count 字节, 之后把位置设回来
+        uint64_t current = std::max(mEnd, mReserved);
+        ok = size - current <= 0xffffffffull &&
+             FSAAppendFile(sClient, mHandle, 1, (uint32_t)(size - current)) >= 0 &&
+             FSASetPosFile(sClient, mHandle, (uint32_t)mPos) == FS_ERROR_OK;
+    } else {
+        ok = ftruncate(mFd, (off_t)size) == 0;
+    }
+    if (!ok) {
+        FileLogger::GetInstance().LogWarning("[FileIO] Failed to reserve %llu bytes", (unsigned long long)size);
+        return false;
+    }
+    mReserved = size;
+    return true;
+}
+
+bool FileIO::GetFreeSpace(const std::string& path, uint64_t& freeBytes) {
+    std::string fsaPath = ToFsaPath(path);
+    if (!fsaPath.empty()) {
+        uint64_t size = 0;
+        if (FSAGetFreeSpaceSize(sClient, fsaPath.c_str(), &size) == FS_ERROR_OK) {
+            freeBytes = size;
+            return true;
+        }
+    }
+    struct statvfs st;
+    if (statvfs(path.c_str(), &st) == 0) {
+        freeBytes = (uint64_t)st.f_bavail * st.f_frsize;
+        return true;
+    }
+    return false;
+}
+
+bool FileIO::HasFreeSpace(const std::string& path, uint64_t required) {
+    uint64_t freeBytes = 0;
+    if (!GetFreeSpace(path, freeBytes)) {
+        FileLogger::GetInstance().LogWarning("[FileIO] Could not query free space for %s", path.c_str());
+        return true;
+    }
+    if (freeBytes < required) {
+        FileLogger::GetInstance().LogError("[FileIO] Not enough free space on %s: %llu bytes needed, %llu free",
+                                           path.c_str(), (unsigned long long)required, (unsigned long long)freeBytes);
+        return false;
+    }
+    return true;
+}
+
+bool FileIO::Sync() {
+    if (mBackend == BACKEND_FSA) {
+        return !mFailed && FSAFlushFile(sClient, mHandle) == FS_ERROR_OK;
+    } else if (mBackend == BACKEND_POSIX) {
+        return !mFailed && fsync(mFd) == 0;
+    }
+    return false;
+}
+
+uint64_t FileIO::Size() {
+    if (mBackend == BACKEND_FSA) {
+        FSAStat st;
+        if (FSAGetStatFile(sClient, mHandle, &st) == FS_ERROR_OK) {
+            return st.size;
+        }
+    } else if (mBackend == BACKEND_POSIX) {
+        struct stat st;
+        if (fstat(mFd, &st) == 0) {
+            return (uint64_t)st.st_size;
+        }
+    }
+    return 0;
+}
+
+bool FileIO::Seek(uint64_t offset) {
+    if (offset == mPos) {
+        return true;
+    }
+    bool ok = false;
+    if (mBackend == BACKEND_FSA) {
+        ok = FSASetPosFile(sClient, mHandle, (uint32_t)offset) == FS_ERROR_OK;
+    } else if (mBackend == BACKEND_POSIX) {
+        ok = lseek(mFd, (off_t)offset, SEEK_SET) == (off_t)offset;
+    }
+    if (ok) {
+        mPos = offset;
+    }
+    return ok;
+}
+
+uint8_t* FileIO::Bounce() {
+    if (mBounce.size() == 0) {
+        mBounce.resize(CHUNK_SIZE);
+    }
+    return mBounce.data();
+}
+
+size_t FileIO::RawRead(void* dst, size_t n) {
+    if (mBackend == BACKEND_FSA) {
+        FSError result = FSAReadFile(sClient, dst, 1, (uint32_t)n, mHandle, (FSAReadFlag)0);
+        return result > 0 ? (size_t)result : 0;
+    }
+    ssize_t result = read(mFd, dst, n);
+    return result > 0 ? (size_t)result : 0;
+}
+
+bool FileIO::RawWrite(const void* src, size_t n) {
+    if (mBackend == BACKEND_FSA) {
+        FSError result = FSAWriteFile(sClient, (void*)src, 1, (uint32_t)n, mHandle, (FSAWriteFlag)0);
+        return result == (FSError)n;
+    }
+    return write(mFd, src, n) == (ssize_t)n;
+}
+
+size_t FileIO::Read(void* dst, size_t n) {
+    if (!IsOpen()) {
+        return 0;
+    }
+    uint8_t* out = (uint8_t*)dst;
+    size_t done = 0;
+    while (done < n) {
+        size_t chunk = std::min(n - done, CHUNK_SIZE);
+        size_t got;
+        if (NeedsBounce(out + done)) {
+            uint8_t* bounce = Bounce();
+            if (!bounce) {
+                break;
+            }
+            got = RawRead(bounce, chunk);
+            memcpy(out + done, bounce, got);
+        } else {
+            got = RawRead(out + done, chunk);
+        }
+        done += got;
+        mPos += got;
+        if (got < chunk) {
+            break;
+        }
+    }
+    return done;
+}
+
+size_t FileIO::ReadAt(uint64_t offset, void* dst, size_t n) {
+    if (!Seek(offset)) {
+        return 0;
+    }
+    return Read(dst, n);
+}
+
+bool FileIO::Write(const void* src, size_t n) {
+    if (!IsOpen()) {
+        return false;
+    }
+    const uint8_t* in = (const uint8_t*)src;
+    size_t done = 0;
+    while (done < n) {
+        size_t chunk = std::min(n - done, CHUNK_SIZE);
+        bool ok;
+        if (NeedsBounce(in + done)) {
+            uint8_t* bounce = Bounce();
+            if (!bounce) {
+                ok = false;
+            } else {
+                memcpy(bounce, in + done, chunk);
+                ok = RawWrite(bounce, chunk);
+            }
+        } else {
+            ok = RawWrite(in + done, chunk);
+        }
+        if (!ok) {
+            mFailed = true;
+            return false;
+        }
+        done += chunk;
+        mPos += chunk;
+    }
+    mEnd = std::max(mEnd, mPos);
+    return true;
+}
+
+template <typename Container>
+bool FileIO::ReadAllInto(const std::string& path, Container& out) {
+    FileIO file;
+    if (!file.Open(path, MODE_READ)) {
+        return false;
+    }
+    // 按文件大小一次读完; 读到的比预期少时以实际读到的为准
+    uint64_t size = file.Size();
+    out.resize((size_t)size);
+    size_t got = size > 0 ? file.Read(&out[0], (size_t)size) : 0;
+    out.resize(got);
+    return got == size;
+}
+
+bool FileIO::ReadAll(const std::string& path, std::vector<uint8_t>& out) {
+    return ReadAllInto(path, out);
+}
+
+bool FileIO::ReadAll(const std::string& path, std::string& out) {
+    return ReadAllInto(path, out);
+}
+
+void FileIO::Shutdown() {
+    std::lock_guard<std::mutex> lock(sClientMutex);
+    if (sClient >= 0) {
+        FSADelClient(sClient);
+        FSAShutdown();
+    }
+    sClient = -1;
+    sClientTried = false;
+    sMlcUnlocked = false;
+}
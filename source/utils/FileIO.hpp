@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 大块文件读写, 不经过 stdio 的小缓冲区
+// SD 卡 (fs:/vol/external01/) 和 Mocha 挂载的 MLC (storage_mlc_UTheme:/) 直接调用 FSA,
+// 其它路径或 FSA 不可用时退回 POSIX read/write (devoptab 也直接转给 FS, 同样不经过 stdio 缓冲)
+// FSA 要求缓冲区按 BUFFER_ALIGNMENT 对齐: 用 FileIO::Buffer 时直接传输, 其它缓冲区经过内部的对齐缓冲区中转
+// 一个 FileIO 同一时间只能由一个线程使用; 不同的 FileIO 可以在不同线程上同时使用
+class FileIO {
+public:
+    enum Mode {
+        MODE_READ,        // 只读, 文件必须存在
+        MODE_WRITE,       // 只写, 创建或清空
+        MODE_READ_WRITE,  // 读写, 创建或清空 (写完还要读回的输出)
+        MODE_UPDATE       // 读写, 不存在时创建, 保留原有内容 (追加写入的打包文件)
+    };
+
+    static constexpr size_t BUFFER_ALIGNMENT = 0x40;
+    // 顺序复制和整文件读取使用的块大小
+    static constexpr size_t CHUNK_SIZE = 256 * 1024;
+
+    // 对齐的缓冲区; fastMemory 为 true 时优先放在 MEM1 (见 FastMemory), 只用于一次操作之内的工作缓冲区
+    class Buffer {
+    public:
+        Buffer() = default;
+        explicit Buffer(size_t size, bool fastMemory = false) { resize(size, fastMemory); }
+        ~Buffer();
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        // 不保留原有内容
+        void resize(size_t size, bool fastMemory = false);
+        void swap(Buffer& other) noexcept;
+        uint8_t* data() { return mData; }
+        const uint8_t* data() const { return mData; }
+        size_t size() const { return mSize; }
+        uint8_t& operator[](size_t i) { return mData[i]; }
+        const uint8_t& operator[](size_t i) const { return mData[i]; }
+
+    private:
+        uint8_t* mData = nullptr;
+        size_t mSize = 0;
+    };
+
+    FileIO() = default;
+    ~FileIO();
+    FileIO(const FileIO&) = delete;
+    FileIO& operator=(const FileIO&) = delete;
+
+    bool Open(const std::string& path, Mode mode);
+    // 返回 false 表示之前有写入失败或关闭失败
+    bool Close();
+    // 把已写入的内容刷到存储设备 (改名提交之前调用), 失败时返回 false
+    bool Sync();
+    // 写入前一次把文件扩展到 size 字节, FAT32 上簇链一次分配, 不会随追加写入零散增长; 空间不够时马上失败
+    // 当前位置不变; Close 时截掉实际写入末尾之后多预留的部分
+    bool Reserve(uint64_t size);
+    bool IsOpen() const { return mBackend != BACKEND_NONE; }
+
+    uint64_t Size();
+    uint64_t Tell() const { return mPos; }
+    bool Seek(uint64_t offset);
+
+    // 从当前位置读, 返回读到的字节数 (0 表示文件末尾或出错)
+    size_t Read(void* dst, size_t n);
+    size_t ReadAt(uint64_t offset, void* dst, size_t n);
+    // 写在当前位置, 全部写入才返回 true
+    bool Write(const void* src, size_t n);
+
+    // 读入整个文件
+    static bool ReadAll(const std::string& path, std::vector<uint8_t>& out);
+    static bool ReadAll(const std::string& path, std::string& out);
+
+    // path 所在设备的剩余空间, 查不到时返回 false
+    static bool GetFreeSpace(const std::string& path, uint64_t& freeBytes);
+    // 开始耗时的写入之前检查空间: 剩余空间查不到时不阻止 (返回 true), 不够时记录日志并返回 false
+    static bool HasFreeSpace(const std::string& path, uint64_t required);
+
+    // 程序退出前释放 FSA 客户端
+    static void Shutdown();
+
+private:
+    enum Backend {
+        BACKEND_NONE,
+        BACKEND_FSA,
+        BACKEND_POSIX
+    };
+
+    Backend mBackend = BACKEND_NONE;
+    uint32_t mHandle = 0;   // FSA 文件句柄
+    int mFd = -1;           // POSIX 文件描述符
+    uint64_t mPos = 0;
+    bool mFailed = false;
+    uint64_t mEnd = 0;      // 写入到的最远位置
+    uint64_t mReserved = 0; // Reserve 扩展到的大小
+    Buffer mBounce;         // 未对齐的缓冲区经过这里中转, 第一次需要时分配
+
+    size_t RawRead(void* dst, size_t n);
+    bool RawWrite(const void* src, size_t n);
+    bool TruncateAt(uint64_t size);
+    uint8_t* Bounce();
+    bool NeedsBounce(const void* ptr) const;
+
+    template <typename Container>
+    static bool ReadAllInto(const std::string& path, Container& out);
+};
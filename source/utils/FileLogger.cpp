@@ -2,19 +2,40 @@
 #include <cstdarg>
 #include <ctime>
 #include <sys/stat.h>
-#include <dirent.h>
 #include <cstring>
+#include <chrono>
+#include <algorithm>
+
+static const char* const sLevelNames[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+static const char* const LOG_DIR = "fs:/vol/external01/log/UTheme";
+static const char* const LOG_INDEX_PATH = "fs:/vol/external01/log/UTheme/index";
+static const char* const sCategoryTags[FileLogger::CAT_COUNT] = {"", "[NET]", "[IMG]", "[PATCH]", "[UI]"};
 
 FileLogger::FileLogger() 
     : mLogFile(nullptr)
+    , mWriteBuffer(nullptr)
+    , mRing(new Record[RING_SIZE])
+    , mEnqueuePos(0)
+    , mDequeuePos(0)
+    , mDropped(0)
+    , mRunning(false)
+    , mStopWriter(false)
+    , mFlushRequested(false)
+    , mLogNumber(0)
+    , mIndexMissing(false)
     , mEnabled(true)      // 默认启用
     , mVerbose(false)     // 默认不详细
     , mLogLevel(LOG_INFO) // 默认INFO级别
+    , mCategoryMask(~0u)  // 默认所有分类
 {
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        mRing[i].sequence.store(i, std::memory_order_relaxed);
+    }
 }
 
 FileLogger::~FileLogger() {
     EndLog();
+    delete[] mRing;
 }
 
 FileLogger& FileLogger::GetInstance() {
@@ -49,37 +70,54 @@ FileLogger::LogLevel FileLogger::GetLogLevel() const {
     return mLogLevel;
 }
 
+void FileLogger::SetCategoryEnabled(LogCategory category, bool enabled) {
+    if (enabled) {
+        mCategoryMask |= 1u << category;
+    } else {
+        mCategoryMask &= ~(1u << category);
+    }
+}
+
 int FileLogger::GetNextLogNumber() {
-    const char* logDir = "fs:/vol/external01/log/UTheme";
-    DIR* dir = opendir(logDir);
-    if (!dir) {
-        return 0;
+    int next = -1;
+    FILE* index = fopen(LOG_INDEX_PATH, "r");
+    if (index) {
+        if (fscanf(index, "%d", &next) != 1 || next < 0 || next >= LOG_NUMBER_COUNT) {
+            next = -1;
+        }
+        fclose(index);
     }
-    
-    int maxNumber = -1;
-    struct dirent* entry;
-    
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string name = entry->d_name;
-        
-        // 检查文件名格式: utheme##.log
-        if (name.length() >= 11 && // "utheme##.log"
-            name.substr(0, 6) == "utheme" &&
-            name.substr(name.length() - 4) == ".log") {
-            
-            // 提取数字部分
-            std::string numStr = name.substr(6, name.length() - 10);
-            if (numStr.length() == 2 && isdigit(numStr[0]) && isdigit(numStr[1])) {
-                int num = (numStr[0] - '0') * 10 + (numStr[1] - '0');
-                if (num > maxNumber) {
-                    maxNumber = num;
-                }
-            }
+    mIndexMissing = next < 0;
+    return mIndexMissing ? 0 : next;
+}
+
+void FileLogger::PruneLogs() {
+    // 从新到旧检查之前的日志; 平时只有最近 MAX_LOG_FILES 个编号可能存在, 检查次数是固定的
+    int lastAge = mIndexMissing ? LOG_NUMBER_COUNT - 1 : MAX_LOG_FILES;
+    uint64_t total = 0;
+    int kept = 0;
+    int removed = 0;
+    bool pruning = false;
+    for (int age = 1; age <= lastAge; age++) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/utheme%02d.log", LOG_DIR,
+                 (mLogNumber - age + LOG_NUMBER_COUNT) % LOG_NUMBER_COUNT);
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        // 超出之后更旧的都删除, 最近的一个再大也保留
+        pruning = pruning || (kept > 0 && (kept + 1 >= MAX_LOG_FILES || total + (uint64_t)st.st_size > MAX_LOG_BYTES));
+        if (pruning) {
+            removed += remove(path) == 0;
+        } else {
+            total += (uint64_t)st.st_size;
+            kept++;
         }
     }
-    
-    closedir(dir);
-    return maxNumber + 1;
+    if (removed > 0) {
+        fprintf(mLogFile, "[INFO] Removed %d old log file(s)\n", removed);
+    }
 }
 
 bool FileLogger::StartLog() {
@@ -90,12 +128,9 @@ bool FileLogger::StartLog() {
     // 结束之前的日志
     EndLog();
     
-    // 创建日志目录
-    const char* logDir = "fs:/vol/external01/log/UTheme";
-    
     // 递归创建目录
     struct stat st;
-    if (stat(logDir, &st) != 0) {
+    if (stat(LOG_DIR, &st) != 0) {
         // 目录不存在,创建
         const char* paths[] = {
             "fs:/vol/external01/log",
@@ -111,15 +146,17 @@ bool FileLogger::StartLog() {
         }
     }
     
-    // 获取下一个日志编号
-    int logNum = GetNextLogNumber();
-    if (logNum > 99) {
-        logNum = 0; // 重置到 00
+    // 获取下一个日志编号, 同时把再下一个写回索引
+    mLogNumber = GetNextLogNumber();
+    FILE* index = fopen(LOG_INDEX_PATH, "w");
+    if (index) {
+        fprintf(index, "%d\n", (mLogNumber + 1) % LOG_NUMBER_COUNT);
+        fclose(index);
     }
     
     // 创建日志文件路径
     char filename[512];
-    snprintf(filename, sizeof(filename), "%s/utheme%02d.log", logDir, logNum);
+    snprintf(filename, sizeof(filename), "%s/utheme%02d.log", LOG_DIR, mLogNumber);
     mCurrentLogPath = filename;
     
     // 打开日志文件
@@ -127,6 +164,9 @@ bool FileLogger::StartLog() {
     if (!mLogFile) {
         return false;
     }
+    // 写入线程成批写出, 缓冲区满或需要 fflush 时才真正写卡
+    mWriteBuffer = new char[WRITE_BUFFER_SIZE];
+    setvbuf(mLogFile, mWriteBuffer, _IOFBF, WRITE_BUFFER_SIZE);
     
     // 写入日志头
     time_t now = time(nullptr);
@@ -145,80 +185,171 @@ bool FileLogger::StartLog() {
     fprintf(mLogFile, "========================================\n\n");
     fflush(mLogFile);
     
+    mStopWriter = false;
+    mWriter = std::thread(&FileLogger::WriterThread, this);
+    mRunning = true;
     return true;
 }
 
-void FileLogger::WriteLog(const char* level, const char* format, va_list args) {
-    if (!mLogFile) {
-        return;
+// 在调用线程只格式化消息; 占用环形缓冲区的一个位置 (多生产者有界队列, 按序号判断位置是否可写)
+void FileLogger::WriteLog(LogLevel level, LogCategory category, const char* format, va_list args) {
+    uint32_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    Record* record;
+    while (true) {
+        record = &mRing[pos & (RING_SIZE - 1)];
+        uint32_t sequence = record->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 写入线程跟不上, 不阻塞调用方
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
     }
     
-    // 获取时间戳
-    time_t now = time(nullptr);
-    struct tm* timeinfo = localtime(&now);
-    char timebuf[64];
-    strftime(timebuf, sizeof(timebuf), "%H:%M:%S", timeinfo);
+    record->time = OSGetSystemTime();
+    record->level = (uint8_t)level;
+    record->category = (uint8_t)category;
+    int length = vsnprintf(record->message, MESSAGE_SIZE, format, args);
+    record->length = (uint16_t)std::max(0, std::min(length, (int)MESSAGE_SIZE - 1));
+    record->sequence.store(pos + 1, std::memory_order_release);
     
-    // 写入级别和时间
-    fprintf(mLogFile, "[%s][%s] ", timebuf, level);
+    if (level == LOG_ERROR) {
+        mFlushRequested = true;
+        mWakeCv.notify_one();
+    } else if ((pos & (RING_SIZE / 2 - 1)) == 0) {
+        // 短时间内大量日志时不等写入线程的定时唤醒
+        mWakeCv.notify_one();
+    }
+}
+
+size_t FileLogger::DrainRing() {
+    size_t count = 0;
+    while (true) {
+        Record& record = mRing[mDequeuePos & (RING_SIZE - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != mDequeuePos + 1) {
+            break;
+        }
+        
+        OSCalendarTime calendar;
+        OSTicksToCalendarTime(record.time, &calendar);
+        fprintf(mLogFile, "[%02d:%02d:%02d][%s]%s ", calendar.tm_hour, calendar.tm_min, calendar.tm_sec,
+                sLevelNames[record.level], sCategoryTags[record.category]);
+        fwrite(record.message, 1, record.length, mLogFile);
+        fputc('\n', mLogFile);
+        
+        record.sequence.store(mDequeuePos + RING_SIZE, std::memory_order_release);
+        mDequeuePos++;
+        count++;
+    }
     
-    // 写入消息
-    vfprintf(mLogFile, format, args);
-    fprintf(mLogFile, "\n");
-    fflush(mLogFile);
+    uint32_t dropped = mDropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        fprintf(mLogFile, "[WARN] %u log messages dropped (buffer full)\n", (unsigned) dropped);
+    }
+    return count;
+}
+
+void FileLogger::WriterThread() {
+    PruneLogs();
+    while (true) {
+        bool stopping = mStopWriter.load();
+        // 先取出标记再写: 看到标记时触发它的 ERROR 一定已经在缓冲区中
+        bool flush = mFlushRequested.exchange(false);
+        size_t written = DrainRing();
+        if (flush || stopping) {
+            fflush(mLogFile);
+        }
+        if (stopping) {
+            break;
+        }
+        
+        if (written == 0) {
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWakeCv.wait_for(lock, std::chrono::milliseconds(WRITER_INTERVAL_MS),
+                            [this] { return mStopWriter.load() || mFlushRequested.load(); });
+        }
+    }
 }
 
 void FileLogger::LogDebug(const char* format, ...) {
-    if (!mLogFile || mLogLevel > LOG_DEBUG) return;
+    if (!ShouldLog(LOG_DEBUG, CAT_GENERAL)) return;
     
     va_list args;
     va_start(args, format);
-    WriteLog("DEBUG", format, args);
+    WriteLog(LOG_DEBUG, CAT_GENERAL, format, args);
     va_end(args);
 }
 
 void FileLogger::LogInfo(const char* format, ...) {
-    if (!mLogFile || mLogLevel > LOG_INFO) return;
+    if (!mRunning || mLogLevel > LOG_INFO) return;
     
     va_list args;
     va_start(args, format);
-    WriteLog("INFO", format, args);
+    WriteLog(LOG_INFO, CAT_GENERAL, format, args);
     va_end(args);
 }
 
 void FileLogger::Log(const char* format, ...) {
-    if (!mLogFile) return;
+    if (!mRunning) return;
     
     va_list args;
     va_start(args, format);
-    WriteLog("INFO", format, args);
+    WriteLog(LOG_INFO, CAT_GENERAL, format, args);
     va_end(args);
 }
 
 void FileLogger::LogWarning(const char* format, ...) {
-    if (!mLogFile || mLogLevel > LOG_WARNING) return;
+    if (!mRunning || mLogLevel > LOG_WARNING) return;
     
     va_list args;
     va_start(args, format);
-    WriteLog("WARN", format, args);
+    WriteLog(LOG_WARNING, CAT_GENERAL, format, args);
     va_end(args);
 }
 
 void FileLogger::LogError(const char* format, ...) {
-    if (!mLogFile || mLogLevel > LOG_ERROR) return;
+    if (!mRunning || mLogLevel > LOG_ERROR) return;
+    
+    va_list args;
+    va_start(args, format);
+    WriteLog(LOG_ERROR, CAT_GENERAL, format, args);
+    va_end(args);
+}
+
+void FileLogger::LogCategorized(LogLevel level, LogCategory category, const char* format, ...) {
+    if (!ShouldLog(level, category)) return;
     
     va_list args;
     va_start(args, format);
-    WriteLog("ERROR", format, args);
+    WriteLog(level, category, format, args);
     va_end(args);
 }
 
 void FileLogger::EndLog() {
     if (mLogFile) {
+        // 写入线程写完缓冲区中剩下的日志后退出
+        mRunning = false;
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mStopWriter = true;
+        }
+        mWakeCv.notify_one();
+        if (mWriter.joinable()) {
+            mWriter.join();
+        }
+        
         fprintf(mLogFile, "\n========================================\n");
         fprintf(mLogFile, "Log End\n");
         fprintf(mLogFile, "========================================\n");
         fclose(mLogFile);
         mLogFile = nullptr;
+        delete[] mWriteBuffer;
+        mWriteBuffer = nullptr;
     }
 }
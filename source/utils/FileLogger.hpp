@@ -1,7 +1,19 @@
 #pragma once
 #include <string>
 #include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <coreinit/time.h>
 
+// 日志先格式化到固定大小的环形缓冲区 (多个线程无锁写入, 时间只记下系统时钟),
+// 由后台线程成批写入 SD 卡; 只在 ERROR 和结束日志时立即 fflush
+// 缓冲区满时丢弃新日志而不等待, 之后在日志中记下丢弃的条数
+// 频繁的日志 (每张图片、每个请求) 用下面的 ULOG_* 宏: 低于 UTHEME_LOG_MIN_LEVEL 的级别不会编译进去,
+// 其余的先检查是否需要记录, 不需要时不计算参数
 class FileLogger {
 public:
     static FileLogger& GetInstance();
@@ -14,6 +26,16 @@ public:
         LOG_ERROR = 3
     };
     
+    // 日志分类, 可以分别关闭
+    enum LogCategory {
+        CAT_GENERAL = 0,
+        CAT_NET,     // 下载队列和网络请求
+        CAT_IMG,     // 图片加载和纹理缓存
+        CAT_PATCH,   // 主题补丁和安装
+        CAT_UI,      // 界面
+        CAT_COUNT
+    };
+    
     // 开始一个新的日志会话
     bool StartLog();
     
@@ -24,6 +46,16 @@ public:
     void LogWarning(const char* format, ...);
     void LogError(const char* format, ...);
     
+    // 带分类的日志, 输出为 "[时间][级别][分类] 消息"; 一般通过 ULOG_* 宏调用
+    void LogCategorized(LogLevel level, LogCategory category, const char* format, ...);
+    
+    // 开启详细日志时也记录 DEBUG 级别
+    bool ShouldLog(LogLevel level, LogCategory category) const {
+        return mRunning.load(std::memory_order_relaxed) &&
+               level >= (mVerbose ? LOG_DEBUG : mLogLevel) &&
+               (mCategoryMask & (1u << category));
+    }
+    
     // 结束日志会话
     void EndLog();
     
@@ -37,6 +69,9 @@ public:
     void SetLogLevel(LogLevel level);
     LogLevel GetLogLevel() const;
     
+    void SetCategoryEnabled(LogCategory category, bool enabled);
+    bool IsCategoryEnabled(LogCategory category) const { return mCategoryMask & (1u << category); }
+    
     // 获取当前日志文件路径
     const std::string& GetCurrentLogPath() const { return mCurrentLogPath; }
     
@@ -46,12 +81,72 @@ private:
     FileLogger(const FileLogger&) = delete;
     FileLogger& operator=(const FileLogger&) = delete;
     
-    void WriteLog(const char* level, const char* format, va_list args);
+    static constexpr uint32_t RING_SIZE = 512;        // 必须是 2 的幂
+    static constexpr size_t MESSAGE_SIZE = 500;       // 更长的消息会被截断
+    static constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+    static constexpr int WRITER_INTERVAL_MS = 50;
+    // 日志文件 utheme00.log ~ utheme99.log 循环使用, 下一个编号记在索引文件里 (启动时不扫描目录)
+    // 连同当前的日志最多保留 MAX_LOG_FILES 个, 之前的日志总共不超过 MAX_LOG_BYTES (最近的一个总是保留)
+    static constexpr int LOG_NUMBER_COUNT = 100;
+    static constexpr int MAX_LOG_FILES = 10;
+    static constexpr uint64_t MAX_LOG_BYTES = 4 * 1024 * 1024;
+    
+    struct Record {
+        std::atomic<uint32_t> sequence;  // 等于写入位置时可写, 等于位置 + 1 时可读
+        OSTime time;
+        uint8_t level;
+        uint8_t category;
+        uint16_t length;
+        char message[MESSAGE_SIZE];
+    };
+    
+    void WriteLog(LogLevel level, LogCategory category, const char* format, va_list args);
+    void WriterThread();
+    size_t DrainRing();  // 只在写入线程调用, 返回写出的条数
     int GetNextLogNumber();
+    void PruneLogs();    // 在写入线程开始时删除超出个数或大小的旧日志
     
     FILE* mLogFile;
+    char* mWriteBuffer;                   // mLogFile 的 stdio 缓冲区
+    Record* mRing;
+    std::atomic<uint32_t> mEnqueuePos;
+    uint32_t mDequeuePos;                 // 只在写入线程访问
+    std::atomic<uint32_t> mDropped;
+    std::atomic<bool> mRunning;           // 日志文件已打开, 可以写入
+    std::atomic<bool> mStopWriter;
+    std::atomic<bool> mFlushRequested;
+    std::thread mWriter;
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeCv;
     std::string mCurrentLogPath;
+    int mLogNumber;
+    bool mIndexMissing;                   // 没有索引文件 (第一次运行或旧版本留下的目录), 清理时检查所有编号
     bool mEnabled;
     bool mVerbose;
     LogLevel mLogLevel;
+    uint32_t mCategoryMask;
 };
+
+// 编译进程序的最低日志级别, 默认为 INFO (DEBUG 构建为 DEBUG); 可以用 make LOG_MIN_LEVEL=0 指定
+#ifndef UTHEME_LOG_MIN_LEVEL
+#ifdef DEBUG
+#define UTHEME_LOG_MIN_LEVEL 0
+#else
+#define UTHEME_LOG_MIN_LEVEL 1
+#endif
+#endif
+
+#define ULOG(level, category, ...)                                                          \
+    do {                                                                                    \
+        if constexpr (FileLogger::level >= UTHEME_LOG_MIN_LEVEL) {                          \
+            FileLogger& ulogLogger = FileLogger::GetInstance();                             \
+            if (ulogLogger.ShouldLog(FileLogger::level, FileLogger::CAT_##category)) {      \
+                ulogLogger.LogCategorized(FileLogger::level, FileLogger::CAT_##category, __VA_ARGS__); \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
+#define ULOG_DEBUG(category, ...) ULOG(LOG_DEBUG, category, __VA_ARGS__)
+#define ULOG_INFO(category, ...)  ULOG(LOG_INFO, category, __VA_ARGS__)
+#define ULOG_WARN(category, ...)  ULOG(LOG_WARNING, category, __VA_ARGS__)
+#define ULOG_ERROR(category, ...) ULOG(LOG_ERROR, category, __VA_ARGS__)
@@ -0,0 +1,85 @@
+#include "FrameArena.hpp"
+#include "FileLogger.hpp"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+alignas(std::max_align_t) static unsigned char sBuffer[FrameArena::CAPACITY];
+static size_t sUsed = 0;
+static size_t sPeak = 0;
+static size_t sOverflowBytes = 0;   // 这一帧从堆分配的字节数
+static uint32_t sOverflowCount = 0; // 超出容量的帧数
+static std::vector<void*> sOverflow;
+
+void* FrameArena::Alloc(size_t size, size_t align) {
+    size_t offset = (sUsed + align - 1) & ~(align - 1);
+    if (offset + size <= CAPACITY) {
+        sUsed = offset + size;
+        return sBuffer + offset;
+    }
+
+    // 缓冲区用完: 从堆分配, Reset 时释放
+    void* block = aligned_alloc(align, (size + align - 1) & ~(align - 1));
+    if (block) {
+        sOverflow.push_back(block);
+        sOverflowBytes += size;
+    }
+    return block;
+}
+
+std::string_view FrameArena::Format(const char* format, ...) {
+    size_t offset = sUsed;
+    size_t available = CAPACITY - offset;
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf((char*)sBuffer + offset, available, format, args);
+    va_end(args);
+    if (len < 0) {
+        return {};
+    }
+    if ((size_t)len < available) {
+        sUsed = offset + len + 1;
+        return std::string_view((const char*)sBuffer + offset, len);
+    }
+
+    char* text = (char*)Alloc(len + 1, 1);
+    if (!text) {
+        return {};
+    }
+    va_start(args, format);
+    vsnprintf(text, len + 1, format, args);
+    va_end(args);
+    return std::string_view(text, len);
+}
+
+void FrameArena::Reset() {
+    if (sUsed > sPeak) {
+        sPeak = sUsed;
+    }
+    sUsed = 0;
+
+    if (!sOverflow.empty()) {
+        for (void* block : sOverflow) {
+            free(block);
+        }
+        sOverflow.clear();
+        sOverflowCount++;
+        FileLogger::GetInstance().LogWarning("[FrameArena] Frame needed %zu bytes more than the %zu byte buffer",
+                                             sOverflowBytes, CAPACITY);
+        sOverflowBytes = 0;
+    }
+}
+
+size_t FrameArena::GetUsed() {
+    return sUsed;
+}
+
+size_t FrameArena::GetPeak() {
+    return sPeak;
+}
+
+uint32_t FrameArena::GetOverflowCount() {
+    return sOverflowCount;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 每帧的临时内存: 绘制时拼出来的文字 (数字、"标签: 值"、底部提示等) 从固定的缓冲区里顺序分配,
+// Gfx::Render 之后一起丢弃, 稳定运行时绘制不再分配堆内存
+// 绘制命令在 Gfx::Render 时才真正执行, 所以分配出来的内存要保留到 Render 之后
+// 只在主线程使用; 一帧用完缓冲区时改为从堆分配, 在 Reset 时释放并写日志
+class FrameArena {
+public:
+    static constexpr size_t CAPACITY = 64 * 1024;
+
+    static void* Alloc(size_t size, size_t align = alignof(std::max_align_t));
+
+    // 按 printf 格式生成文字, 在这一帧内有效 (后面带 '\0', 可以当 C 字符串用)
+    static std::string_view Format(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+    // 每帧 Gfx::Render 之后调用
+    static void Reset();
+
+    static size_t GetUsed();
+    static size_t GetPeak();
+    static uint32_t GetOverflowCount();
+};
@@ -0,0 +1,55 @@
+#include "FrameScheduler.hpp"
+#include <coreinit/time.h>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct Entry {
+    std::string name;
+    FrameScheduler::Priority priority;
+    FrameScheduler::Step step;
+};
+
+} // namespace
+
+static std::vector<Entry> sEntries;
+static OSTime sFrameStart = 0;
+
+void FrameScheduler::Register(const std::string& name, Priority priority, Step step) {
+    Entry entry;
+    entry.name = name;
+    entry.priority = priority;
+    entry.step = std::move(step);
+    // 保持按优先级排序, 同一优先级保持添加顺序
+    auto it = std::upper_bound(sEntries.begin(), sEntries.end(), priority,
+                               [](Priority p, const Entry& e) { return p < e.priority; });
+    sEntries.insert(it, std::move(entry));
+}
+
+void FrameScheduler::BeginFrame() {
+    sFrameStart = OSGetSystemTime();
+}
+
+uint32_t FrameScheduler::ElapsedUs() {
+    if (!sFrameStart) {
+        return 0;
+    }
+    return (uint32_t)OSTicksToMicroseconds(OSGetSystemTime() - sFrameStart);
+}
+
+bool FrameScheduler::HasTime() {
+    return ElapsedUs() < FRAME_BUDGET_US;
+}
+
+void FrameScheduler::Run() {
+    for (Entry& entry : sEntries) {
+        if (entry.priority != PRIORITY_HIGH && !HasTime()) {
+            // 低优先级的工作不会在高优先级之前运行, 后面的都不用再看
+            break;
+        }
+        // HIGH 的第一步不受预算限制, 之后和其它工作一样
+        while (entry.step() && HasTime()) {
+        }
+    }
+}
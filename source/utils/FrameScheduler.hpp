@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 主线程每帧的工作时间预算
+// 帧从 BeginFrame 开始 (主循环开头, 也就是上一帧垂直同步返回之后), 后台结果的处理
+// (纹理上传、下载完成回调、启动阶段等) 只在 FRAME_BUDGET_US 之内进行, 剩下的留给绘制和提交
+// 没有时间的工作留到下一帧, 几个完成结果挤在同一帧时不会掉帧
+class FrameScheduler {
+public:
+    enum Priority {
+        PRIORITY_HIGH,    // 每帧至少运行一次, 即使已经超出预算
+        PRIORITY_NORMAL,
+        PRIORITY_LOW      // 前面的工作都做完后还有时间才运行
+    };
+
+    // 做一份工作; 还有剩下的工作时返回 true, 有时间会再次调用
+    using Step = std::function<bool()>;
+
+    static constexpr uint32_t FRAME_BUDGET_US = 8000;  // 约为 60 fps 一帧的一半
+
+    // 在主线程调用, 按优先级排序, 同一优先级按添加顺序运行
+    static void Register(const std::string& name, Priority priority, Step step);
+
+    // 每次主循环开头调用
+    static void BeginFrame();
+
+    // 这一帧的预算是否还有剩余; 自己循环处理结果的地方 (例如图片上传) 也用它判断是否继续
+    static bool HasTime();
+    static uint32_t ElapsedUs();
+
+    // 按优先级运行登记的工作, 直到预算用完
+    static void Run();
+};
@@ -0,0 +1,45 @@
+#include "HitGrid.hpp"
+#include <algorithm>
+
+void HitGrid::Clear() {
+    // 保留各个格子的容量, 每帧重新登记时不再分配
+    for (auto& cell : mCells) {
+        cell.clear();
+    }
+    mRegions.clear();
+}
+
+void HitGrid::Add(int id, const SDL_Rect& rect) {
+    if (rect.w <= 0 || rect.h <= 0) {
+        return;
+    }
+    const int col0 = std::max(rect.x / CELL_SIZE, 0);
+    const int row0 = std::max(rect.y / CELL_SIZE, 0);
+    const int col1 = std::min((rect.x + rect.w - 1) / CELL_SIZE, COLUMNS - 1);
+    const int row1 = std::min((rect.y + rect.h - 1) / CELL_SIZE, ROWS - 1);
+    if (col0 > col1 || row0 > row1) {
+        return;  // 完全在屏幕外
+    }
+
+    const uint16_t index = (uint16_t) mRegions.size();
+    mRegions.push_back({id, rect});
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            mCells[row * COLUMNS + col].push_back(index);
+        }
+    }
+}
+
+int HitGrid::Hit(int x, int y) const {
+    if (x < 0 || y < 0 || x >= COLUMNS * CELL_SIZE || y >= ROWS * CELL_SIZE) {
+        return -1;
+    }
+    const auto& cell = mCells[(y / CELL_SIZE) * COLUMNS + x / CELL_SIZE];
+    for (auto it = cell.rbegin(); it != cell.rend(); ++it) {
+        const SDL_Rect& r = mRegions[*it].rect;
+        if (x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h) {
+            return mRegions[*it].id;
+        }
+    }
+    return -1;
+}
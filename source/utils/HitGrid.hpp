@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <SDL2/SDL.h>
+
+// 触摸命中区域: 绘制时登记每个可点击区域 (卡片等) 的矩形, 触摸时只查询触摸点所在的格子
+// 屏幕 (1920x1080) 分成 CELL_SIZE 大小的均匀网格, 每个格子记录和它相交的区域
+// 绘制和命中测试使用同一份布局, 不会出现两边坐标不一致; 只在主线程使用
+class HitGrid {
+public:
+    static constexpr int CELL_SIZE = 120;
+    static constexpr int COLUMNS = 1920 / CELL_SIZE;
+    static constexpr int ROWS = 1080 / CELL_SIZE;
+
+    // 每次绘制前清空, 再按绘制顺序登记
+    void Clear();
+    void Add(int id, const SDL_Rect& rect);
+    // 包含 (x, y) 的区域 id, 重叠时返回最后登记 (画在最上面) 的区域; 没有时返回 -1
+    int Hit(int x, int y) const;
+    bool Empty() const { return mRegions.empty(); }
+
+private:
+    struct Region {
+        int id;
+        SDL_Rect rect;
+    };
+
+    std::vector<Region> mRegions;
+    std::vector<uint16_t> mCells[COLUMNS * ROWS];  // 每个格子中区域的下标 (登记顺序)
+};
@@ -0,0 +1,64 @@
+#include "IdleTasks.hpp"
+#include "JobSystem.hpp"
+#include <coreinit/time.h>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+struct Task {
+    std::string name;
+    uint32_t intervalMs;
+    IdleTasks::Step step;
+    uint64_t nextRunMs = 0;   // 这之前不开始新的一轮
+};
+
+} // namespace
+
+static std::vector<Task> sTasks;
+static size_t sCurrent = 0;                       // 正在进行的工作 (一轮没结束时下一帧继续它)
+static std::atomic<uint64_t> sLastInputMs{0};     // 0 表示还没有调用过 NoteInput
+
+static uint64_t NowMs() {
+    return OSTicksToMilliseconds(OSGetSystemTime());
+}
+
+void IdleTasks::Register(const std::string& name, uint32_t intervalMs, Step step) {
+    Task task;
+    task.name = name;
+    task.intervalMs = intervalMs;
+    task.step = std::move(step);
+    sTasks.push_back(std::move(task));
+}
+
+void IdleTasks::NoteInput() {
+    sLastInputMs.store(NowMs(), std::memory_order_relaxed);
+}
+
+bool IdleTasks::IsIdle() {
+    uint64_t lastInput = sLastInputMs.load(std::memory_order_relaxed);
+    return lastInput != 0 && NowMs() - lastInput >= IDLE_DELAY_MS && !JobSystem::IsHeavyWorkActive();
+}
+
+bool IdleTasks::Run() {
+    if (sTasks.empty() || !IsIdle()) {
+        return false;
+    }
+    uint64_t now = NowMs();
+    // 从正在进行的工作开始找第一个到时间的
+    for (size_t i = 0; i < sTasks.size(); i++) {
+        size_t index = (sCurrent + i) % sTasks.size();
+        Task& task = sTasks[index];
+        if (now < task.nextRunMs) {
+            continue;
+        }
+        sCurrent = index;
+        if (!task.step()) {
+            task.nextRunMs = now + task.intervalMs;
+            sCurrent = (index + 1) % sTasks.size();
+        }
+        break;
+    }
+    // 每帧只做一步
+    return false;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 界面空闲时的维护工作 (磁盘缓存整理、索引写回等)
+// 最后一次输入之后 IDLE_DELAY_MS 才开始, 安装、解压、备份进行期间 (JobSystem::IsHeavyWorkActive) 也不开始
+// 工作分成小步, 空闲时每帧在主线程运行一步 (FrameScheduler 的低优先级工作, 受同一预算限制);
+// 访问 SD 卡的部分由步骤交给 JobSystem 在后台做, 后台工作经常检查 IsIdle, 一有输入就提前结束, 下次空闲时继续
+class IdleTasks {
+public:
+    static constexpr uint32_t IDLE_DELAY_MS = 3000;
+
+    // 做一步工作; 还有剩下的工作时返回 true, 下一个空闲帧再调用
+    // 返回 false 后这一轮结束, intervalMs 之后 (仍然要空闲) 开始下一轮
+    using Step = std::function<bool()>;
+
+    // 在主线程调用, 按添加顺序运行 (前一个工作这一轮结束后才轮到下一个)
+    static void Register(const std::string& name, uint32_t intervalMs, Step step);
+
+    // 主循环收到输入时调用 (启动时也调用一次, 启动阶段不算空闲)
+    static void NoteInput();
+
+    // 可以在任何线程调用
+    static bool IsIdle();
+
+    // 每帧在主线程调用 (FrameScheduler 的工作)
+    static bool Run();
+};
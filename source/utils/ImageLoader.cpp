@@ -2,34 +2,336 @@
 #include "DownloadQueue.hpp"
 #include "logger.h"
 #include "FileLogger.hpp"
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include "AllocTracker.hpp"
+#include "FrameScheduler.hpp"
+#include "JobSystem.hpp"
+#include "AppLifecycle.hpp"
+#include "Config.hpp"
+#include "IdleTasks.hpp"
 #include "../Gfx.hpp"
 #include <SDL2/SDL_image.h>
 #include <curl/curl.h>
+#include <cerrno>
 #include <cstring>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <condition_variable>
 
 // libwebp 解码器
 #include "src/webp/decode.h"
+#include "WebPThreads.hpp"
+#include "DiskCacheIndex.hpp"
+#include "FileIO.hpp"
+#include "ObjectPool.hpp"
+
+// libjpeg (SDL_image 使用的 libjpeg-turbo), 用于缩放解码
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
 
 // 静态成员初始化
-std::map<std::string, SDL_Texture*> ImageLoader::mTextureCache;
-std::vector<ImageLoader::LoadRequest> ImageLoader::mLoadQueue;
+std::unordered_map<std::string, ImageLoader::CacheEntry> ImageLoader::mTextureCache;
+std::list<std::string> ImageLoader::mLruList;
+std::unordered_map<std::string, ImageLoader::TextureHandle::Slot*> ImageLoader::mHandleSlots;
+std::map<std::string, int> ImageLoader::mPinnedUrls;
+size_t ImageLoader::mCacheBytes = 0;
+size_t ImageLoader::mCacheBudget = ImageLoader::DEFAULT_CACHE_BUDGET;
+uint32_t ImageLoader::mFrame = 0;
+std::vector<ImageLoader::AtlasPage> ImageLoader::mAtlasPages;
+std::unordered_map<std::string, ImageLoader::AtlasEntry> ImageLoader::mAtlasEntries;
+std::multimap<std::string, AsyncDownloadContext*> ImageLoader::mPendingLoads;
+std::vector<AsyncDownloadContext*> ImageLoader::mProgressiveLoads;
 bool ImageLoader::mInitialized = false;
+Uint32 ImageLoader::mTextureFormat = SDL_PIXELFORMAT_UNKNOWN;
+Uint32 ImageLoader::mCompactFormat = SDL_PIXELFORMAT_UNKNOWN;
+bool ImageLoader::mCompactChecked = false;
 
 // 缓存目录
 static const char* CACHE_DIR = "fs:/vol/external01/UTheme/temp/images/";
+static const uint64_t DISK_CACHE_BUDGET = 64 * 1024 * 1024; // 磁盘缓存上限 (原始图片 + 像素缓存)
+static DiskCacheIndex sDiskCache(CACHE_DIR, DISK_CACHE_BUDGET);
+// 空闲时淘汰到上限的这个比例, 浏览时写入新图片不用马上同步淘汰
+static const uint64_t DISK_CACHE_IDLE_PERCENT = 75;
+static JobHandle sCacheMaintenanceJob;
+static std::vector<JobHandle> sCacheWrites;  // 下载后在后台写入磁盘缓存的任务 (只在主线程访问), Cleanup 之前等待
+static std::atomic<bool> sStrayFilesRemoved{false};  // 无主文件每次运行只清理一次 (启动时 Load 已经清理过一次)
+
+// 像素缓存的文件名后缀 (跟在原始图片的文件名后面)
+static std::string ProcessedCacheSuffix(int width, int height) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%dx%d.px", width, height);
+    return suffix;
+}
+
+// 高清图的 16 位像素缓存 (原始尺寸)
+static const char* COMPACT_CACHE_SUFFIX = "_hd565.px";
+
+// 32 位 surface 的所有像素都不透明
+static bool IsOpaque(SDL_Surface* surface) {
+    Uint32 amask = surface->format->Amask;
+    if (amask == 0) {
+        return true;
+    }
+    if (surface->format->BytesPerPixel != 4) {
+        return false;
+    }
+    for (int y = 0; y < surface->h; y++) {
+        const Uint32* row = (const Uint32*)((const uint8_t*)surface->pixels + (size_t)y * surface->pitch);
+        for (int x = 0; x < surface->w; x++) {
+            if ((row[x] & amask) != amask) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 缩略图的平均颜色 (0xFFRRGGBB), 图片到达前卡片先用它占位; 在解码线程中对均匀分布的 AVERAGE_SAMPLES x AVERAGE_SAMPLES 个像素取平均
+static const int AVERAGE_SAMPLES = 16;
+
+static uint32_t AverageColor(SDL_Surface* surface) {
+    if (!surface || surface->w <= 0 || surface->h <= 0 || surface->format->BytesPerPixel != 4) {
+        return 0;
+    }
+    uint32_t r = 0, g = 0, b = 0, count = 0;
+    for (int sy = 0; sy < AVERAGE_SAMPLES; sy++) {
+        int y = (2 * sy + 1) * surface->h / (2 * AVERAGE_SAMPLES);
+        const Uint32* row = (const Uint32*)((const uint8_t*)surface->pixels + (size_t)y * surface->pitch);
+        for (int sx = 0; sx < AVERAGE_SAMPLES; sx++) {
+            Uint8 pr, pg, pb;
+            SDL_GetRGB(row[(2 * sx + 1) * surface->w / (2 * AVERAGE_SAMPLES)], surface->format, &pr, &pg, &pb);
+            r += pr;
+            g += pg;
+            b += pb;
+            count++;
+        }
+    }
+    return 0xFF000000u | (r / count) << 16 | (g / count) << 8 | (b / count);
+}
+
+// 不透明的图片转换成 16 位格式; 有透明像素或转换失败时返回 nullptr (继续使用 32 位)
+static SDL_Surface* ConvertToCompact(SDL_Surface* surface, Uint32 format) {
+    if (!IsOpaque(surface)) {
+        return nullptr;
+    }
+    return SDL_ConvertSurfaceFormat(surface, format, 0);
+}
+
+// 解码器可以直接写入的像素格式: 与渲染器格式相同时不需要再转换一次
+// SDL 的 RGBA32 / BGRA32 / ARGB32 / ABGR32 是按字节顺序的别名, 在大端的 Wii U 上就是 RGBA8888 等打包格式
+// 字节顺序只在取得渲染器格式后选择一次, 不支持的格式按 RGBA 解码再转换
+static Uint32 DirectJpegFormat(Uint32 format) {
+    switch (format) {
+        case SDL_PIXELFORMAT_BGRA32:
+        case SDL_PIXELFORMAT_ARGB32:
+        case SDL_PIXELFORMAT_ABGR32:
+            return format;
+        default:
+            return SDL_PIXELFORMAT_RGBA32;
+    }
+}
+
+static J_COLOR_SPACE JpegColorSpace(Uint32 format) {
+    switch (format) {
+        case SDL_PIXELFORMAT_BGRA32: return JCS_EXT_BGRA;
+        case SDL_PIXELFORMAT_ARGB32: return JCS_EXT_ARGB;
+        case SDL_PIXELFORMAT_ABGR32: return JCS_EXT_ABGR;
+        default:                     return JCS_EXT_RGBA;
+    }
+}
+
+// libwebp 没有 ABGR 输出 (MODE_rgbA 等是预乘 alpha 的, 不能用)
+static Uint32 DirectWebPFormat(Uint32 format) {
+    switch (format) {
+        case SDL_PIXELFORMAT_BGRA32:
+        case SDL_PIXELFORMAT_ARGB32:
+            return format;
+        default:
+            return SDL_PIXELFORMAT_RGBA32;
+    }
+}
+
+static WEBP_CSP_MODE WebPColorMode(Uint32 format) {
+    switch (format) {
+        case SDL_PIXELFORMAT_BGRA32: return MODE_BGRA;
+        case SDL_PIXELFORMAT_ARGB32: return MODE_ARGB;
+        default:                     return MODE_RGBA;
+    }
+}
+
+// 渐进解码状态: 数据块在下载线程中送入 WebPIDecoder, 主线程把已完成的行上传到纹理
+struct ProgressiveDecode {
+    std::string data;                   // 收到的全部数据 (完成后写入磁盘缓存)
+    WebPIDecoder* idec = nullptr;
+    Uint32 format = SDL_PIXELFORMAT_RGBA32; // pixels 的格式, 创建时按渲染器格式选择 (DirectWebPFormat)
+    std::vector<uint8_t> pixels;        // 32 位输出缓冲 (创建解码器后大小不变)
+    int width = 0;
+    int height = 0;
+    std::atomic<bool> ready{false};     // width / height / pixels 已确定
+    std::atomic<int> rowsReady{0};      // 已解码完成的行数
+    bool failed = false;                // 不是 WEBP 或解码出错, 下载完成后按普通方式解码
+    bool finished = false;              // 已全部解码
+    
+    // 以下仅在主线程使用
+    SDL_Texture* texture = nullptr;
+    int rowsUploaded = 0;
+    
+    ~ProgressiveDecode() {
+        if (idec) {
+            WebPIDelete(idec);
+        }
+    }
+};
+
+// 下载线程中调用, 返回 false 会中止下载
+static bool AppendProgressive(ProgressiveDecode* p, const char* chunk, size_t size) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_IMAGES);
+    p->data.append(chunk, size);
+    if (p->failed || p->finished) {
+        return true;
+    }
+    
+    VP8StatusCode status;
+    if (!p->idec) {
+        // 先等到文件头完整, 得到尺寸后分配固定的输出缓冲
+        WebPBitstreamFeatures features;
+        status = WebPGetFeatures((const uint8_t*)p->data.data(), p->data.size(), &features);
+        if (status == VP8_STATUS_NOT_ENOUGH_DATA) {
+            return true;
+        }
+        if (status != VP8_STATUS_OK || features.has_animation ||
+            features.width <= 0 || features.height <= 0 || features.width > 4096 || features.height > 4096) {
+            p->failed = true;
+            return true;
+        }
+        
+        p->width = features.width;
+        p->height = features.height;
+        p->pixels.resize((size_t)p->width * p->height * 4);
+        p->idec = WebPINewRGB(WebPColorMode(p->format), p->pixels.data(), p->pixels.size(), p->width * 4);
+        if (!p->idec) {
+            p->failed = true;
+            return true;
+        }
+        p->ready = true;
+        status = WebPIAppend(p->idec, (const uint8_t*)p->data.data(), p->data.size());
+    } else {
+        status = WebPIAppend(p->idec, (const uint8_t*)chunk, size);
+    }
+    
+    if (status == VP8_STATUS_OK) {
+        p->finished = true;
+    } else if (status != VP8_STATUS_SUSPENDED) {
+        p->failed = true;
+        return true;
+    }
+    
+    int lastY = 0;
+    if (WebPIDecGetRGB(p->idec, &lastY, nullptr, nullptr, nullptr)) {
+        p->rowsReady = lastY;
+    }
+    return true;
+}
 
 // 辅助结构:异步下载上下文
+// 一个请求者的回调; owner 不为空时只在它仍然有效时调用
+struct ImageCallback {
+    std::shared_ptr<bool> owner;
+    std::function<void(SDL_Texture*)> fn;
+    
+    void operator()(SDL_Texture* texture) const {
+        if (!owner || *owner) {
+            fn(texture);
+        }
+    }
+};
+
 struct AsyncDownloadContext {
     std::string url;
-    std::function<void(SDL_Texture*)> callback;
-    DownloadOperation* download;
+    std::vector<ImageCallback> callbacks; // 同一 URL 的所有请求者
+    DownloadOperation* download = nullptr; // 下载中的操作 (解码阶段为空)
+    bool highPriority = false;
+    bool lowPriority = false;   // 预取请求, 以 LOW 优先级下载
+    int targetWidth = 0;        // 解码尺寸上限 (0 表示原始尺寸)
+    int targetHeight = 0;
+    bool fromDiskCache = false; // 数据来自磁盘缓存, 解码失败时重新下载
+    bool fromProcessedCache = false; // 读取像素缓存, 失败时改为解码原始图片
+    bool skipProcessed = false;
+    bool progressive = false;   // 请求了渐进加载
+    bool localFile = false;     // url 是本地文件路径 (fs:/), 不使用磁盘缓存
+    std::function<bool(std::string&)> source; // 自定义来源, 只使用像素缓存
+    bool atlas = false;         // 结果打包进缩略图图集
+    bool unowned = false;       // 有不属于任何 Owner 的请求者 (包括没有回调的预取), CancelOwner 不停止加载
+    std::chrono::steady_clock::time_point expiresAt{}; // 请求都只在这之前有用 (LoadRequest::usefulMs), 默认值表示一直有用
+    ProgressiveDecode* progress = nullptr;
+    std::vector<ImageCallback> progressCallbacks;
+    SDL_Texture* partialTexture = nullptr; // 已交给 progressCallback 的纹理
+};
+
+// 请求上下文和下载操作都在主线程创建和释放, 从固定的池中分配
+// (同时进行的加载一般不超过可见的缩略图加上预取; 超出时改用 new)
+static ObjectPool<AsyncDownloadContext, 64> sContextPool;
+static ObjectPool<DownloadOperation, 64> sDownloadPool;
+
+static DownloadPriority DownloadPriorityFor(const AsyncDownloadContext* ctx) {
+    return ctx->highPriority ? DownloadPriority::HIGH :
+           ctx->lowPriority ? DownloadPriority::LOW : DownloadPriority::NORMAL;
+}
+
+// 限定了显示尺寸的是缩略图, 原始尺寸的是高清图
+static TextureRegistry::Category TextureCategory(const AsyncDownloadContext* ctx) {
+    return (ctx->atlas || ctx->targetWidth > 0) ? TextureRegistry::CATEGORY_THUMBNAIL : TextureRegistry::CATEGORY_HD;
+}
+
+// 后台解码: 工作线程把图片解码成 surface, 主线程只负责创建纹理
+struct DecodeJob {
+    AsyncDownloadContext* ctx = nullptr;
+    std::shared_ptr<const std::string> data;  // 与后台的磁盘缓存写入共享
+    Uint32 format = SDL_PIXELFORMAT_UNKNOWN;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    std::string url;
+    std::string processedPath;  // 像素缓存 (有目标尺寸时使用)
+    std::string processedSuffix;
+    std::string sourcePath;     // 原始图片的磁盘缓存
+    std::string filePath;       // 本地文件: 在解码线程中读取, 代替 data
+    std::function<bool(std::string&)> source; // 自定义来源: 在解码线程中读取, 代替 data
+    bool loadProcessed = false; // 读取像素缓存而不是解码 data
+    bool sourcePending = false; // 原始数据正在后台写入磁盘缓存, 解码后再确定 processedPath
+    Uint32 compactFormat = SDL_PIXELFORMAT_UNKNOWN; // 高清图: 不透明时转换成这个 16 位格式
+};
+
+struct DecodeResult {
+    AsyncDownloadContext* ctx = nullptr;
+    SDL_Surface* surface = nullptr;
+    uint32_t averageColor = 0;  // 图集中的缩略图才计算
 };
 
+static std::mutex sDecodeMutex;            // 保护 sDecodeJobs / sDecodeResults / sDecodeStop / sDecodePaused / sDecodeInFlight
+static std::condition_variable sDecodeCv;  // sDecodeInFlight 变化
+static std::deque<DecodeJob> sDecodeJobs;
+static std::deque<DecodeResult> sDecodeResults;
+static bool sDecodeStop = false;
+static bool sDecodePaused = false;
+static int sLifecycleListener = 0;
+static int sPressureListener = 0;
+static int sDecodeInFlight = 0;            // 已提交给 JobSystem 还没结束的解码任务
+
+// 统计: 解码相关的计数在任务线程中更新, 其余只在主线程更新
+static ImageLoader::Stats sStats;
+static std::atomic<uint64_t> sBytesDecoded{0};
+static std::atomic<uint64_t> sDecodeCount[ImageLoader::DECODE_FORMAT_COUNT];
+static std::atomic<uint64_t> sDecodeUs[ImageLoader::DECODE_FORMAT_COUNT];
+
+// 磁盘缓存超过此时间后向服务器确认一次 (7天)
+static const time_t CACHE_REVALIDATE_SECONDS = 7 * 24 * 60 * 60;
+
 void ImageLoader::Init() {
     if (mInitialized) {
         return;
@@ -71,8 +373,18 @@ void ImageLoader::Init() {
     // 初始化 CURL
     curl_global_init(CURL_GLOBAL_ALL);
     
-    // 初始化下载队列
-    DownloadQueue::Init();
+    // 初始化下载队列 (使用独立的网络线程, 不占用渲染帧时间)
+    DownloadQueue::Init(true);
+    
+    // 图片解码放到后台任务线程 (JobSystem), 避免在一帧内解码多张大图造成卡顿
+    WebPThreads::Install();
+    sDecodeStop = false;
+    sLifecycleListener = AppLifecycle::AddListener("ImageLoader", PauseDecoding, ResumeDecoding);
+    
+    // 纹理总量超出预算时先淘汰不在显示的高清图
+    TextureRegistry::SetReclaimer(EvictCache);
+    // 内存不足时淘汰所有不在显示的图片
+    sPressureListener = MemoryPressure::AddListener("ImageLoader", MemoryPressure::ORDER_CACHE, ReleaseMemory);
     
     // 创建缓存目录
     const char* paths[] = {
@@ -90,6 +402,11 @@ void ImageLoader::Init() {
         }
     }
     
+    // 磁盘缓存索引只在启动时读一次, 之后的查询不再访问 SD 卡
+    sDiskCache.Load();
+    FileLogger::GetInstance().LogInfo("Disk cache: %zu entries, %llu bytes",
+                                      sDiskCache.GetEntryCount(), (unsigned long long)sDiskCache.GetTotalBytes());
+    
     mInitialized = true;
     FileLogger::GetInstance().LogInfo("ImageLoader initialized (Async CURLM)");
 }
@@ -100,13 +417,25 @@ void ImageLoader::Cleanup() {
     }
     
     // 清理纹理缓存
+    TextureRegistry::SetReclaimer(nullptr);
+    MemoryPressure::RemoveListener(sPressureListener);
     ClearCache();
     
-    // 清理加载队列
-    mLoadQueue.clear();
+    LogStats();
     
-    // 清理下载队列
+    // 清理下载队列和解码任务 (要在 JobSystem::Shutdown 之前)
+    AppLifecycle::RemoveListener(sLifecycleListener);
     DownloadQueue::Quit();
+    StopDecoding();
+    mPendingLoads.clear();
+    sCacheMaintenanceJob.Cancel();
+    sCacheMaintenanceJob.Wait();
+    for (JobHandle& job : sCacheWrites) {
+        job.Wait();
+    }
+    sCacheWrites.clear();
+    sDiskCache.Save();
+    sDiskCache.Close();
     
     // 清理 CURL
     curl_global_cleanup();
@@ -118,16 +447,134 @@ void ImageLoader::Cleanup() {
     FileLogger::GetInstance().LogInfo("ImageLoader cleaned up");
 }
 
+size_t ImageLoader::GetQueueSize() {
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    return sDecodeJobs.size() + sDecodeResults.size();
+}
+
+ImageLoader::Stats ImageLoader::GetStats() {
+    Stats stats = sStats;
+    stats.bytesDecoded = sBytesDecoded.load(std::memory_order_relaxed);
+    for (int i = 0; i < DECODE_FORMAT_COUNT; i++) {
+        stats.decodeCount[i] = sDecodeCount[i].load(std::memory_order_relaxed);
+        stats.decodeUs[i] = sDecodeUs[i].load(std::memory_order_relaxed);
+    }
+    stats.residentBytes = mCacheBytes + GetAtlasBytes();
+    return stats;
+}
+
+void ImageLoader::LogStats() {
+    static const char* formatNames[DECODE_FORMAT_COUNT] = {"jpeg", "png", "webp", "other", "pixels"};
+    Stats stats = GetStats();
+    FileLogger::GetInstance().LogInfo("[ImageLoader] %llu requests: %.0f%% memory hits, %llu coalesced, %llu pixel cache, "
+                                      "%llu disk, %llu local, %llu downloads (%llu failed), %llu decode failures",
+                                      (unsigned long long)stats.Requests(), stats.HitRate() * 100,
+                                      (unsigned long long)stats.coalesced, (unsigned long long)stats.pixelCacheHits,
+                                      (unsigned long long)stats.diskHits, (unsigned long long)stats.localLoads,
+                                      (unsigned long long)stats.downloads, (unsigned long long)stats.downloadFailures,
+                                      (unsigned long long)stats.decodeFailures);
+    char decodes[256];
+    int len = 0;
+    for (int i = 0; i < DECODE_FORMAT_COUNT && len < (int)sizeof(decodes); i++) {
+        len += snprintf(decodes + len, sizeof(decodes) - len, " %s %llu x %.1fms", formatNames[i],
+                        (unsigned long long)stats.decodeCount[i], stats.AverageDecodeMs(i));
+    }
+    FileLogger::GetInstance().LogInfo("[ImageLoader] decoded %llu KB:%s; %llu evictions (%llu KB), %llu atlas pages; %zu KB resident",
+                                      (unsigned long long)(stats.bytesDecoded / 1024), decodes,
+                                      (unsigned long long)stats.evictions, (unsigned long long)(stats.evictedBytes / 1024),
+                                      (unsigned long long)stats.atlasEvictions, stats.residentBytes / 1024);
+}
+
 void ImageLoader::Update() {
+    Profiler::Scope profile(Profiler::SECTION_IMAGE_LOADER);
+    mFrame++;
+    
     // 处理下载队列 (非阻塞,异步)
     if (DownloadQueue::GetInstance()) {
         DownloadQueue::GetInstance()->Process();
     }
+    
+    UploadProgressive();
+    UploadDecoded();
+}
+
+ImageLoader::TextureHandle::TextureHandle(const std::string& url) {
+    if (url.empty()) {
+        return;
+    }
+    Slot*& slot = mHandleSlots[url];
+    bool created = !slot;
+    if (created) {
+        slot = new Slot();
+        slot->url = url;
+    }
+    mSlot = slot;
+    mSlot->refs++;
+    if (created) {
+        ResolveHandles(url);
+    }
+}
+
+ImageLoader::TextureHandle::TextureHandle(const TextureHandle& other) : mSlot(other.mSlot) {
+    if (mSlot) {
+        mSlot->refs++;
+    }
+}
+
+ImageLoader::TextureHandle& ImageLoader::TextureHandle::operator=(const TextureHandle& other) {
+    if (other.mSlot) {
+        other.mSlot->refs++;
+    }
+    Reset();
+    mSlot = other.mSlot;
+    return *this;
+}
+
+void ImageLoader::TextureHandle::Reset() {
+    if (mSlot && --mSlot->refs == 0) {
+        mHandleSlots.erase(mSlot->url);
+        delete mSlot;
+    }
+    mSlot = nullptr;
+}
+
+SDL_Texture* ImageLoader::TextureHandle::Get() const {
+    if (!mSlot || !mSlot->texture) {
+        return nullptr;
+    }
+    // 渐进加载中的纹理还不在缓存里
+    GetCached(mSlot->url);
+    return mSlot->texture;
+}
+
+void ImageLoader::ResolveHandles(const std::string& url) {
+    auto slot = mHandleSlots.find(url);
+    if (slot == mHandleSlots.end()) {
+        return;
+    }
+    SDL_Texture* texture = nullptr;
+    auto cached = mTextureCache.find(url);
+    if (cached != mTextureCache.end()) {
+        texture = cached->second.texture;
+    } else {
+        auto range = mPendingLoads.equal_range(url);
+        for (auto it = range.first; it != range.second && !texture; ++it) {
+            texture = it->second->partialTexture;
+        }
+    }
+    slot->second->texture = texture;
 }
 
 SDL_Texture* ImageLoader::GetCached(const std::string& url) {
     auto it = mTextureCache.find(url);
-    return (it != mTextureCache.end()) ? it->second : nullptr;
+    if (it == mTextureCache.end()) {
+        return nullptr;
+    }
+    
+    // 移到 LRU 链表头部, 并记录本帧用到了它 (正在显示的纹理不会被淘汰)
+    mLruList.splice(mLruList.begin(), mLruList, it->second.lru);
+    it->second.lastUsedFrame = mFrame;
+    return it->second.texture;
 }
 
 void ImageLoader::CacheTexture(const std::string& url, SDL_Texture* texture) {
@@ -135,33 +582,120 @@ void ImageLoader::CacheTexture(const std::string& url, SDL_Texture* texture) {
     
     // 如果已缓存,先释放旧的
     auto it = mTextureCache.find(url);
-    if (it != mTextureCache.end() && it->second) {
-        SDL_DestroyTexture(it->second);
+    if (it != mTextureCache.end()) {
+        if (it->second.texture == texture) {
+            GetCached(url);
+            return;
+        }
+        TextureRegistry::Destroy(it->second.texture);
+        mCacheBytes -= it->second.bytes;
+        mLruList.erase(it->second.lru);
+        mTextureCache.erase(it);
     }
     
-    mTextureCache[url] = texture;
+    Uint32 format = SDL_PIXELFORMAT_UNKNOWN;
+    int w = 0, h = 0;
+    SDL_QueryTexture(texture, &format, nullptr, &w, &h);
+    
+    CacheEntry entry;
+    entry.texture = texture;
+    entry.bytes = (size_t)w * h * std::max(1, (int)SDL_BYTESPERPIXEL(format));
+    entry.hd = TextureRegistry::GetCategory(texture) == TextureRegistry::CATEGORY_HD;
+    entry.lastUsedFrame = mFrame;
+    entry.lru = mLruList.insert(mLruList.begin(), url);
+    mTextureCache[url] = entry;
+    mCacheBytes += entry.bytes;
+    ResolveHandles(url);
     
-    // 限制缓存大小 (最多 100 张)
-    if (mTextureCache.size() > 100) {
-        auto oldest = mTextureCache.begin();
-        if (oldest->second) {
-            SDL_DestroyTexture(oldest->second);
+    EvictToBudget();
+    
+    ULOG_DEBUG(IMG, "[CACHE] Texture cached: %s (%dx%d, %zu KB / %zu KB)",
+                    url.c_str(), w, h, mCacheBytes / 1024, mCacheBudget / 1024);
+}
+
+void ImageLoader::EvictToBudget() {
+    if (mCacheBytes > mCacheBudget) {
+        EvictCache(mCacheBytes - mCacheBudget);
+    }
+}
+
+size_t ImageLoader::EvictCache(size_t bytes) {
+    // 先只淘汰高清图 (界面上有缩略图可以代替), 不够时再淘汰其它图片
+    // 都从最久未使用的一端开始, 跳过固定的和最近两帧内绘制过的纹理
+    size_t freed = 0;
+    for (int pass = 0; pass < 2 && freed < bytes; pass++) {
+        auto it = mLruList.end();
+        while (freed < bytes && it != mLruList.begin()) {
+            --it;
+            auto entry = mTextureCache.find(*it);
+            if (entry == mTextureCache.end()) {
+                continue;
+            }
+            
+            if ((pass == 0 && !entry->second.hd) ||
+                mFrame - entry->second.lastUsedFrame <= 2 || mPinnedUrls.count(*it)) {
+                continue;
+            }
+            
+            ULOG_DEBUG(IMG, "[CACHE] Evicted: %s (%zu KB%s)", it->c_str(), entry->second.bytes / 1024,
+                            entry->second.hd ? ", HD" : "");
+            TextureRegistry::Destroy(entry->second.texture);
+            mCacheBytes -= entry->second.bytes;
+            freed += entry->second.bytes;
+            sStats.evictions++;
+            sStats.evictedBytes += entry->second.bytes;
+            mTextureCache.erase(entry);
+            ResolveHandles(*it);
+            it = mLruList.erase(it);
         }
-        mTextureCache.erase(oldest);
     }
-    
-    if (FileLogger::GetInstance().IsVerbose()) {
-        FileLogger::GetInstance().LogDebug("[CACHE] Texture cached: %s", url.c_str());
+    return freed;
+}
+
+size_t ImageLoader::ReleaseMemory(MemoryPressure::Level level) {
+    size_t freed = EvictCache(mCacheBytes);
+    if (level == MemoryPressure::LEVEL_CRITICAL) {
+        // 末尾没在显示的图集页整页释放 (前面的页还在用时不能移动它们的编号)
+        while (!mAtlasPages.empty() && mFrame - mAtlasPages.back().lastUsedFrame > 2) {
+            EvictAtlasPage((int)mAtlasPages.size() - 1);
+            TextureRegistry::Destroy(mAtlasPages.back().texture);
+            mAtlasPages.pop_back();
+            freed += (size_t)ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4;
+        }
+    }
+    return freed;
+}
+
+void ImageLoader::SetCacheBudget(size_t bytes) {
+    mCacheBudget = bytes;
+    EvictToBudget();
+    FileLogger::GetInstance().LogInfo("Texture cache budget set to %zu KB", bytes / 1024);
+}
+
+void ImageLoader::PinTexture(const std::string& url) {
+    mPinnedUrls[url]++;
+}
+
+void ImageLoader::UnpinTexture(const std::string& url) {
+    auto it = mPinnedUrls.find(url);
+    if (it != mPinnedUrls.end() && --it->second <= 0) {
+        mPinnedUrls.erase(it);
     }
 }
 
 void ImageLoader::ClearCache() {
     for (auto& pair : mTextureCache) {
-        if (pair.second) {
-            SDL_DestroyTexture(pair.second);
+        if (pair.second.texture) {
+            TextureRegistry::Destroy(pair.second.texture);
         }
     }
     mTextureCache.clear();
+    mLruList.clear();
+    mCacheBytes = 0;
+    for (const auto& slot : mHandleSlots) {
+        ResolveHandles(slot.first);
+    }
+    ClearAtlas();
     DEBUG_FUNCTION_LINE("Image cache cleared");
     FileLogger::GetInstance().LogInfo("Texture cache cleared");
 }
@@ -169,271 +703,623 @@ void ImageLoader::ClearCache() {
 void ImageLoader::RemoveFromCache(const std::string& url) {
     auto it = mTextureCache.find(url);
     if (it != mTextureCache.end()) {
-        if (it->second) {
-            SDL_DestroyTexture(it->second);
+        if (it->second.texture) {
+            TextureRegistry::Destroy(it->second.texture);
         }
+        mCacheBytes -= it->second.bytes;
+        mLruList.erase(it->second.lru);
         mTextureCache.erase(it);
+        ResolveHandles(url);
         
-        if (FileLogger::GetInstance().IsVerbose()) {
-            FileLogger::GetInstance().LogDebug("[CACHE] Removed: %s", url.c_str());
+        ULOG_DEBUG(IMG, "[CACHE] Removed: %s", url.c_str());
+    }
+}
+
+bool ImageLoader::GetAtlasSprite(const std::string& url, AtlasSprite& sprite) {
+    auto it = mAtlasEntries.find(url);
+    if (it != mAtlasEntries.end()) {
+        AtlasPage& page = mAtlasPages[it->second.page];
+        page.lastUsedFrame = mFrame;
+        sprite.texture = page.texture;
+        sprite.rect = it->second.rect;
+        sprite.averageColor = it->second.averageColor;
+        return true;
+    }
+    
+    // 图集放不下时使用的普通纹理
+    SDL_Texture* texture = GetCached(url);
+    if (!texture) {
+        return false;
+    }
+    auto cached = mTextureCache.find(url);
+    sprite.texture = texture;
+    sprite.averageColor = (cached != mTextureCache.end()) ? cached->second.averageColor : 0;
+    sprite.rect.x = 0;
+    sprite.rect.y = 0;
+    SDL_QueryTexture(texture, nullptr, nullptr, &sprite.rect.w, &sprite.rect.h);
+    return true;
+}
+
+bool ImageLoader::AllocateInAtlasPage(AtlasPage& page, int width, int height, SDL_Rect& rect) {
+    // 放进剩余宽度足够的最矮的行, 没有时在下面开一行
+    AtlasShelf* best = nullptr;
+    for (auto& shelf : page.shelves) {
+        if (shelf.height >= height && shelf.x + width <= ATLAS_PAGE_SIZE &&
+            (!best || shelf.height < best->height)) {
+            best = &shelf;
+        }
+    }
+    
+    if (!best) {
+        if (page.nextY + height > ATLAS_PAGE_SIZE) {
+            return false;
         }
+        AtlasShelf shelf;
+        shelf.y = page.nextY;
+        shelf.height = height;
+        page.shelves.push_back(shelf);
+        page.nextY += height;
+        best = &page.shelves.back();
     }
+    
+    rect.x = best->x;
+    rect.y = best->y;
+    best->x += width;
+    return true;
 }
 
-std::string ImageLoader::UrlToFilename(const std::string& url) {
-    // URL -> 文件名: 使用简单的哈希
-    std::hash<std::string> hasher;
-    size_t hash = hasher(url);
+void ImageLoader::EvictAtlasPage(int index) {
+    AtlasPage& page = mAtlasPages[index];
+    for (const auto& url : page.urls) {
+        auto it = mAtlasEntries.find(url);
+        if (it != mAtlasEntries.end() && it->second.page == index) {
+            mAtlasEntries.erase(it);
+        }
+    }
+    page.urls.clear();
+    page.shelves.clear();
+    page.nextY = 0;
+    sStats.atlasEvictions++;
+    
+    ULOG_DEBUG(IMG, "[ATLAS] Evicted page %d", index);
+}
+
+bool ImageLoader::AddAtlasThumbnail(const std::string& url, SDL_Surface* surface) {
+    if (!surface || surface->format->format != GetTextureFormat() || mAtlasEntries.count(url) ||
+        mPendingLoads.count(url)) {
+        return false;
+    }
+    return AddToAtlas(url, surface, AverageColor(surface)) != nullptr;
+}
+
+SDL_Texture* ImageLoader::AddToAtlas(const std::string& url, SDL_Surface* surface, uint32_t averageColor) {
+    int width = surface->w + ATLAS_PADDING;
+    int height = surface->h + ATLAS_PADDING;
+    SDL_Rect rect = {0, 0, surface->w, surface->h};
+    int pageIndex = -1;
+    
+    if (width <= ATLAS_PAGE_SIZE && height <= ATLAS_PAGE_SIZE) {
+        for (int i = 0; i < (int)mAtlasPages.size() && pageIndex < 0; i++) {
+            if (AllocateInAtlasPage(mAtlasPages[i], width, height, rect)) {
+                pageIndex = i;
+            }
+        }
+        
+        // 新建一页
+        SDL_Renderer* renderer = Gfx::GetRenderer();
+        if (pageIndex < 0 && (int)mAtlasPages.size() < MAX_ATLAS_PAGES && renderer) {
+            AtlasPage page;
+            page.texture = TextureRegistry::Create(TextureRegistry::CATEGORY_THUMBNAIL, renderer, surface->format->format,
+                                                   SDL_TEXTUREACCESS_STATIC, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+            if (page.texture) {
+                SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+                mAtlasPages.push_back(page);
+                if (AllocateInAtlasPage(mAtlasPages.back(), width, height, rect)) {
+                    pageIndex = (int)mAtlasPages.size() - 1;
+                }
+                FileLogger::GetInstance().LogInfo("[ATLAS] Created page %zu", mAtlasPages.size());
+            }
+        }
+        
+        // 整页淘汰最久未绘制的一页 (最近两帧内绘制过的页不淘汰)
+        if (pageIndex < 0) {
+            int oldest = -1;
+            for (int i = 0; i < (int)mAtlasPages.size(); i++) {
+                if (mFrame - mAtlasPages[i].lastUsedFrame > 2 &&
+                    (oldest < 0 || mAtlasPages[i].lastUsedFrame < mAtlasPages[oldest].lastUsedFrame)) {
+                    oldest = i;
+                }
+            }
+            if (oldest >= 0) {
+                EvictAtlasPage(oldest);
+                if (AllocateInAtlasPage(mAtlasPages[oldest], width, height, rect)) {
+                    pageIndex = oldest;
+                }
+            }
+        }
+    }
     
-    std::ostringstream oss;
-    oss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    if (pageIndex < 0) {
+        // 图集放不下 (图片太大或所有页都在显示), 使用普通纹理
+        SDL_Texture* texture = CreateTexture(surface, TextureRegistry::CATEGORY_THUMBNAIL);
+        if (texture) {
+            CacheTexture(url, texture);
+            auto cached = mTextureCache.find(url);
+            if (cached != mTextureCache.end()) {
+                cached->second.averageColor = averageColor;
+            }
+        }
+        return texture;
+    }
     
-    // 检测文件扩展名
-    std::string ext = ".jpg";
-    if (url.find(".png") != std::string::npos) {
-        ext = ".png";
-    } else if (url.find(".webp") != std::string::npos) {
-        ext = ".webp";
+    AtlasPage& page = mAtlasPages[pageIndex];
+    rect.w = surface->w;
+    rect.h = surface->h;
+    if (SDL_UpdateTexture(page.texture, &rect, surface->pixels, surface->pitch) != 0) {
+        FileLogger::GetInstance().LogError("[ATLAS] SDL_UpdateTexture failed: %s", SDL_GetError());
+        return nullptr;
     }
     
-    return oss.str() + ext;
+    AtlasEntry entry;
+    entry.page = pageIndex;
+    entry.rect = rect;
+    entry.averageColor = averageColor;
+    mAtlasEntries[url] = entry;
+    page.urls.push_back(url);
+    page.lastUsedFrame = mFrame;
+    
+    ULOG_DEBUG(IMG, "[ATLAS] Packed %s into page %d at %d,%d (%dx%d)",
+                    url.c_str(), pageIndex, rect.x, rect.y, rect.w, rect.h);
+    return page.texture;
+}
+
+void ImageLoader::ClearAtlas() {
+    for (auto& page : mAtlasPages) {
+        if (page.texture) {
+            TextureRegistry::Destroy(page.texture);
+        }
+    }
+    mAtlasPages.clear();
+    mAtlasEntries.clear();
+}
+
+std::string ImageLoader::UrlToFilename(const std::string& url) {
+    // URL -> 文件名的基础部分 (XXH64), 扩展名按数据类型由索引决定
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)DiskCacheIndex::Hash(url));
+    return name;
 }
 
 std::string ImageLoader::GetCachePath(const std::string& url) {
-    return std::string(CACHE_DIR) + UrlToFilename(url);
+    return sDiskCache.GetPath(url);
+}
+
+bool ImageLoader::IsInDiskCache(const std::string& url) {
+    DiskCacheIndex::Entry entry;
+    return sDiskCache.Find(url, entry, false);
 }
 
 bool ImageLoader::SaveToCache(const std::string& url, const void* data, size_t size) {
     if (!data || size == 0) return false;
     
-    std::string path = GetCachePath(url);
-    FILE* file = fopen(path.c_str(), "wb");
-    if (!file) {
-        FileLogger::GetInstance().LogWarning("Failed to open cache file for writing: %s", path.c_str());
+    // 追加到打包文件, 不在缓存目录中创建新文件
+    if (!sDiskCache.Store(url, data, size)) {
+        FileLogger::GetInstance().LogWarning("Failed to save to disk cache: %s", url.c_str());
         return false;
     }
     
-    size_t written = fwrite(data, 1, size, file);
-    fclose(file);
+    ULOG_DEBUG(IMG, "[CACHE SAVED] %s (%zu bytes)", url.c_str(), size);
     
-    if (written != size) {
-        FileLogger::GetInstance().LogError("Failed to write complete cache file: %s", path.c_str());
+    return true;
+}
+
+bool ImageLoader::RunCacheMaintenance() {
+    if (sCacheMaintenanceJob.IsValid()) {
+        if (!sCacheMaintenanceJob.IsDone()) {
+            return true;
+        }
+        sCacheMaintenanceJob = JobHandle();
         return false;
     }
-    
-    if (FileLogger::GetInstance().IsVerbose()) {
-        FileLogger::GetInstance().LogDebug("[CACHE SAVED] %s -> %s (%zu bytes)", url.c_str(), path.c_str(), size);
-    }
-    
+    sCacheMaintenanceJob = JobSystem::Submit([](const CancelToken& token) {
+        AllocTracker::TagScope allocTag(AllocTracker::TAG_IMAGES);
+        // 有输入时停下, 下次空闲时从头再来
+        auto keepGoing = [&token]() { return !token.IsCancelled() && IdleTasks::IsIdle(); };
+        uint64_t target = sDiskCache.GetBudget() / 100 * DISK_CACHE_IDLE_PERCENT;
+        if (sDiskCache.Trim(target, keepGoing) && sDiskCache.CompactPack(keepGoing) && !sStrayFilesRemoved &&
+            sDiskCache.RemoveStrayFiles(keepGoing)) {
+            sStrayFilesRemoved = true;
+        }
+        // 浏览时只更新了最后使用时间的改动不会自动写回
+        sDiskCache.Save();
+    });
     return true;
 }
 
+bool ImageLoader::IsDiskCacheStale(const std::string& url) {
+    // 没有 ETag / Last-Modified 的条目无法确认, 视为有效
+    DiskCacheIndex::Entry entry;
+    if (!sDiskCache.Find(url, entry, false) || entry.validatedAt == 0) {
+        return false;
+    }
+    int64_t age = (int64_t)time(NULL) - entry.validatedAt;
+    return age < 0 || age >= CACHE_REVALIDATE_SECONDS;
+}
+
+// 校验信息保存在磁盘缓存索引中
+static bool LoadValidators(const std::string& url, DownloadOperation* download) {
+    DiskCacheIndex::Entry entry;
+    if (!sDiskCache.Find(url, entry, false)) {
+        return false;
+    }
+    download->ifNoneMatch = entry.etag;
+    download->ifModifiedSince = entry.lastModified;
+    return !download->ifNoneMatch.empty() || !download->ifModifiedSince.empty();
+}
+
+// 304 响应不一定带校验信息, 沿用请求时的值
+static const std::string& ResponseEtag(const DownloadOperation* download) {
+    return !download->etag.empty() ? download->etag : download->ifNoneMatch;
+}
+
+static const std::string& ResponseLastModified(const DownloadOperation* download) {
+    return !download->lastModified.empty() ? download->lastModified : download->ifModifiedSince;
+}
+
+static void SaveValidators(const std::string& url, const DownloadOperation* download) {
+    sDiskCache.SetValidators(url, ResponseEtag(download), ResponseLastModified(download));
+}
+
+// 下载完成的数据在后台任务中写入磁盘缓存, 收到数据的那一帧不写 SD 卡
+// 数据与解码任务共享同一份 (不复制); then 在写入结束后由主线程执行
+static void StoreInBackground(const std::string& url, std::shared_ptr<const std::string> data,
+                              const DownloadOperation* download, JobSystem::Continuation then = nullptr) {
+    sCacheWrites.erase(std::remove_if(sCacheWrites.begin(), sCacheWrites.end(),
+                                      [](const JobHandle& job) { return job.IsDone(); }),
+                       sCacheWrites.end());
+    std::string etag = ResponseEtag(download);
+    std::string lastModified = ResponseLastModified(download);
+    sCacheWrites.push_back(JobSystem::Submit([url, data, etag, lastModified](const CancelToken&) {
+        AllocTracker::TagScope allocTag(AllocTracker::TAG_IMAGES);
+        if (ImageLoader::SaveToCache(url, data->data(), data->size())) {
+            sDiskCache.SetValidators(url, etag, lastModified);
+        }
+    }, std::move(then)));
+}
+
+// 过期的磁盘缓存照常使用 (离线时也能马上显示), 同时在后台用 ETag / Last-Modified 向服务器确认
+// 有新版本时写入磁盘缓存 (旧的像素缓存随之失效), 下次加载这张图时使用
+static std::set<std::string> sRevalidating;  // 正在确认的 URL, 每个只发一个请求
+
+static void RevalidateInBackground(const std::string& url) {
+    if (!DownloadQueue::GetInstance() || !sRevalidating.insert(url).second) {
+        return;
+    }
+    DownloadOperation* download = sDownloadPool.Create();
+    if (!LoadValidators(url, download)) {
+        sDownloadPool.Destroy(download);
+        sRevalidating.erase(url);
+        return;
+    }
+    download->url = url;
+    download->priority = DownloadPriority::LOW;
+    download->traffic = DownloadTraffic::BACKGROUND;  // 不和正在显示的图片抢带宽
+    download->cb = [](DownloadOperation* download) {
+        if (download->notModified) {
+            SaveValidators(download->url, download); // 刷新确认时间
+            ULOG_DEBUG(IMG, "[CACHE REVALIDATED] %s", download->url.c_str());
+        } else if (download->status == DownloadStatus::COMPLETE && download->response_code == 200 &&
+                   !download->buffer.empty()) {
+            ULOG_DEBUG(IMG, "[CACHE UPDATED] %s (%zu bytes)", download->url.c_str(), download->buffer.size());
+            StoreInBackground(download->url, std::make_shared<const std::string>(std::move(download->buffer)), download);
+        } else {
+            FileLogger::GetInstance().LogWarning("[REVALIDATE FAILED] Keeping stale cache: %s", download->url.c_str());
+        }
+        sRevalidating.erase(download->url);
+        sDownloadPool.Destroy(download);
+    };
+    DownloadQueue::GetInstance()->DownloadAdd(download);
+}
+
 std::vector<uint8_t> ImageLoader::LoadFromCache(const std::string& url) {
+    // 打包的数据只需一次定位和读取; 读不到或校验失败时条目已经作废
     std::vector<uint8_t> data;
-    std::string path = GetCachePath(url);
-    
-    FILE* file = fopen(path.c_str(), "rb");
-    if (!file) {
+    if (!sDiskCache.Read(url, data)) {
         return data;
     }
     
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    ULOG_DEBUG(IMG, "[CACHE HIT - DISK] %s (%zu bytes)", url.c_str(), data.size());
     
-    if (fileSize <= 0 || fileSize > 10 * 1024 * 1024) {
-        fclose(file);
-        FileLogger::GetInstance().LogWarning("Invalid cache file size: %ld", fileSize);
-        return data;
+    return data;
+}
+
+Uint32 ImageLoader::GetTextureFormat() {
+    // 渲染器原生格式, 解码线程直接转换成这个格式, 上传纹理时不用再转换
+    if (mTextureFormat != SDL_PIXELFORMAT_UNKNOWN) {
+        return mTextureFormat;
     }
     
-    data.resize(fileSize);
-    size_t bytesRead = fread(data.data(), 1, fileSize, file);
-    fclose(file);
-    
-    if (bytesRead != (size_t)fileSize) {
-        FileLogger::GetInstance().LogError("Failed to read complete cache file");
-        data.clear();
-        return data;
+    SDL_Renderer* renderer = Gfx::GetRenderer();
+    if (!renderer) {
+        return SDL_PIXELFORMAT_RGBA8888;
     }
     
-    if (FileLogger::GetInstance().IsVerbose()) {
-        FileLogger::GetInstance().LogDebug("[CACHE HIT - DISK] %s (%zu bytes)", path.c_str(), data.size());
+    mTextureFormat = SDL_PIXELFORMAT_RGBA8888; // 默认格式
+    SDL_RendererInfo renderer_info;
+    if (SDL_GetRendererInfo(renderer, &renderer_info) == 0 && renderer_info.num_texture_formats > 0) {
+        mTextureFormat = renderer_info.texture_formats[0];
     }
-    
-    return data;
+    FileLogger::GetInstance().LogInfo("[ImageLoader] Using renderer format: %s", SDL_GetPixelFormatName(mTextureFormat));
+    return mTextureFormat;
 }
 
-SDL_Texture* ImageLoader::LoadFromMemory(const void* data, size_t size) {
-    if (!data || size == 0) {
-        FileLogger::GetInstance().LogError("[LoadFromMemory] Invalid data: data=%p, size=%zu", data, size);
-        return nullptr;
+Uint32 ImageLoader::GetCompactFormat() {
+    // 渲染器原生支持 RGB565 时使用, 否则高清图仍然使用 32 位纹理
+    if (!Config::GetInstance().IsCompactPreviewsEnabled()) {
+        return SDL_PIXELFORMAT_UNKNOWN;
+    }
+    if (mCompactChecked) {
+        return mCompactFormat;
     }
     
-    FileLogger::GetInstance().LogInfo("[LoadFromMemory] Attempting to load %zu bytes", size);
+    SDL_Renderer* renderer = Gfx::GetRenderer();
+    if (!renderer) {
+        return SDL_PIXELFORMAT_UNKNOWN;
+    }
     
-    // 检测图片格式
-    const unsigned char* bytes = (const unsigned char*)data;
-    std::string format = "unknown";
+    mCompactChecked = true;
+    SDL_RendererInfo renderer_info;
+    if (SDL_GetRendererInfo(renderer, &renderer_info) == 0) {
+        for (Uint32 i = 0; i < renderer_info.num_texture_formats; i++) {
+            if (renderer_info.texture_formats[i] == SDL_PIXELFORMAT_RGB565) {
+                mCompactFormat = SDL_PIXELFORMAT_RGB565;
+            }
+        }
+    }
+    FileLogger::GetInstance().LogInfo("[ImageLoader] Compact HD previews: %s",
+                                      mCompactFormat != SDL_PIXELFORMAT_UNKNOWN ? "RGB565" : "not supported by renderer");
+    return mCompactFormat;
+}
+
+SDL_Texture* ImageLoader::LoadFromMemory(const void* data, size_t size) {
+    SDL_Surface* surface = DecodeToSurface(data, size, GetTextureFormat());
+    if (!surface) {
+        return nullptr;
+    }
     
+    SDL_Texture* texture = CreateTexture(surface, TextureRegistry::CATEGORY_HD);
+    SDL_FreeSurface(surface);
+    return texture;
+}
+
+SDL_Texture* ImageLoader::CreateTexture(SDL_Surface* surface, TextureRegistry::Category category) {
+    SDL_Renderer* renderer = Gfx::GetRenderer();
+    if (!renderer) {
+        FileLogger::GetInstance().LogError("[LoadFromMemory] Renderer is null!");
+        return nullptr;
+    }
+    
+    // 失败时 TextureRegistry 已经回收过一次并记录了日志
+    SDL_Texture* texture = TextureRegistry::CreateFromSurface(category, renderer, surface);
+    if (texture) {
+        // 16 位纹理没有 alpha, SDL 不会打开混合, 界面的淡入淡出需要它
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+    return texture;
+}
+
+// 在 maxW x maxH 内保持比例的尺寸, 不放大; max 为 0 表示不限制
+static void FitSize(int srcW, int srcH, int maxW, int maxH, int& outW, int& outH) {
+    outW = srcW;
+    outH = srcH;
+    if (maxW <= 0 || maxH <= 0 || srcW <= 0 || srcH <= 0 || (srcW <= maxW && srcH <= maxH)) {
+        return;
+    }
+    float scale = std::min((float)maxW / srcW, (float)maxH / srcH);
+    outW = std::max(1, (int)(srcW * scale + 0.5f));
+    outH = std::max(1, (int)(srcH * scale + 0.5f));
+}
+
+// libjpeg 出错时跳回调用处, 默认的处理会直接退出程序
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr cinfo) {
+    longjmp(((JpegErrorManager*)cinfo->err)->jump, 1);
+}
+
+// libjpeg 解码, 需要缩小时用 DCT 缩放 (1/2, 1/4, 1/8) 解码到不小于目标尺寸的最小分辨率
+// 像素直接写入新建的 surface
+static SDL_Surface* DecodeJpeg(const uint8_t* data, size_t size, int maxW, int maxH, Uint32 format) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = JpegErrorExit;
+    
+    SDL_Surface* volatile surface = nullptr; // longjmp 之后仍需要它的值
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+    
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, size);
+    jpeg_read_header(&cinfo, TRUE);
+    
+    int denom = 1;
+    while (maxW > 0 && maxH > 0 && denom < 8 &&
+           (int)cinfo.image_width / (denom * 2) >= maxW && (int)cinfo.image_height / (denom * 2) >= maxH) {
+        denom *= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.out_color_space = JpegColorSpace(format);
+    
+    jpeg_start_decompress(&cinfo);
+    surface = SDL_CreateRGBSurfaceWithFormat(0, cinfo.output_width, cinfo.output_height, 32, format);
+    if (!surface) {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+    
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = (uint8_t*)surface->pixels + (size_t)cinfo.output_scanline * surface->pitch;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return surface;
+}
+
+// libwebp 解码, 需要缩小时在解码过程中直接缩放, 像素直接写入新建的 surface
+static SDL_Surface* DecodeWebP(const uint8_t* data, size_t size, int maxW, int maxH, Uint32 format) {
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(data, size, &config.input) != VP8_STATUS_OK) {
+        return nullptr;
+    }
+    
+    int width = 0, height = 0;
+    FitSize(config.input.width, config.input.height, maxW, maxH, width, height);
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, format);
+    if (!surface) {
+        return nullptr;
+    }
+    
+    config.options.use_scaling = (width != config.input.width || height != config.input.height);
+    config.options.scaled_width = width;
+    config.options.scaled_height = height;
+    // use_threads: 大图的环路滤波在另一个核心上进行 (见 WebPThreads)
+    config.options.use_threads = 1;
+    config.output.colorspace = WebPColorMode(format);
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = (uint8_t*)surface->pixels;
+    config.output.u.RGBA.stride = surface->pitch;
+    config.output.u.RGBA.size = (size_t)surface->pitch * height;
+    
+    VP8StatusCode status = WebPDecode(data, size, &config);
+    WebPFreeDecBuffer(&config.output);
+    if (status != VP8_STATUS_OK) {
+        FileLogger::GetInstance().LogError("[LoadFromMemory] WEBP decode failed: status %d", (int)status);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+    return surface;
+}
+
+// 按文件头判断格式, 返回 SDL_image 的类型名; 不认识时返回 "unknown"
+static const char* DetectImageType(const unsigned char* bytes, size_t size) {
     if (size >= 4) {
         if (bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF) {
-            format = "JPEG";
+            return "JPEG";
         } else if (bytes[0] == 0x89 && bytes[1] == 0x50 && bytes[2] == 0x4E && bytes[3] == 0x47) {
-            format = "PNG";
+            return "PNG";
         } else if (bytes[0] == 'R' && bytes[1] == 'I' && bytes[2] == 'F' && bytes[3] == 'F') {
             // 检查是否是 WEBP (RIFF....WEBP)
             if (size >= 12 && bytes[8] == 'W' && bytes[9] == 'E' && bytes[10] == 'B' && bytes[11] == 'P') {
-                format = "WEBP";
+                return "WEBP";
             }
         } else if (bytes[0] == 'G' && bytes[1] == 'I' && bytes[2] == 'F') {
-            format = "GIF";
+            return "GIF";
         }
     }
-    FileLogger::GetInstance().LogInfo("[LoadFromMemory] Image format: %s (header: %02X %02X %02X %02X)", 
-        format.c_str(), bytes[0], bytes[1], bytes[2], bytes[3]);
-    
-    // 如果是 WEBP 格式，使用 libwebp 解码
-    if (format == "WEBP") {
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] Using libwebp decoder for WEBP image");
-        
-        // 获取图片尺寸
-        int width = 0, height = 0;
-        if (!WebPGetInfo(bytes, size, &width, &height)) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] WebPGetInfo failed - invalid WEBP data");
-            return nullptr;
-        }
-        
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] WEBP dimensions: %dx%d", width, height);
-        
-        // 解码为 RGBA
-        uint8_t* rgba_data = WebPDecodeRGBA(bytes, size, &width, &height);
-        if (!rgba_data) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] WebPDecodeRGBA failed");
-            return nullptr;
-        }
-        
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] WEBP decoded successfully to RGBA buffer");
-        
-        // 创建临时 SDL Surface 使用 RGBA 格式
-        // 注意：WebPDecodeRGBA 返回的是 R,G,B,A 字节顺序（与字节序无关）
-        SDL_Surface* temp_surface = SDL_CreateRGBSurfaceFrom(
-            rgba_data,
-            width, height,
-            32,                    // 32 bits per pixel
-            width * 4,             // pitch (bytes per row)
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-            0xFF000000,            // R mask (大端序)
-            0x00FF0000,            // G mask
-            0x0000FF00,            // B mask
-            0x000000FF             // A mask
-#else
-            0x000000FF,            // R mask (小端序)
-            0x0000FF00,            // G mask
-            0x00FF0000,            // B mask
-            0xFF000000             // A mask
-#endif
-        );
-        
-        if (!temp_surface) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] SDL_CreateRGBSurfaceFrom failed: %s", SDL_GetError());
-            WebPFree(rgba_data);
-            return nullptr;
-        }
-        
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] Temp surface created: format=%s", 
-            SDL_GetPixelFormatName(temp_surface->format->format));
-        
-        // 获取渲染器
-        SDL_Renderer* renderer = Gfx::GetRenderer();
-        if (!renderer) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] Renderer is null!");
-            SDL_FreeSurface(temp_surface);
-            WebPFree(rgba_data);
-            return nullptr;
-        }
-        
-        // 转换为渲染器原生格式以获得最佳性能和正确颜色
-        Uint32 renderer_format = SDL_PIXELFORMAT_RGBA8888; // 默认格式
-        SDL_RendererInfo renderer_info;
-        if (SDL_GetRendererInfo(renderer, &renderer_info) == 0) {
-            if (renderer_info.num_texture_formats > 0) {
-                renderer_format = renderer_info.texture_formats[0];
-                FileLogger::GetInstance().LogInfo("[LoadFromMemory] Using renderer format: %s", 
-                    SDL_GetPixelFormatName(renderer_format));
-            }
-        }
-        
-        // 转换 surface 到渲染器格式
-        SDL_Surface* converted_surface = SDL_ConvertSurfaceFormat(temp_surface, renderer_format, 0);
-        SDL_FreeSurface(temp_surface);
-        WebPFree(rgba_data);
-        
-        if (!converted_surface) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] SDL_ConvertSurfaceFormat failed: %s", SDL_GetError());
-            return nullptr;
-        }
-        
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] Surface converted to: %s", 
-            SDL_GetPixelFormatName(converted_surface->format->format));
-        
-        // 创建纹理
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, converted_surface);
-        SDL_FreeSurface(converted_surface);
-        
-        if (!texture) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
-            return nullptr;
-        }
-        
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] [SUCCESS] WEBP texture created successfully");
-        return texture;
+    return "unknown";
+}
+
+static ImageLoader::DecodeFormat GetDecodeFormat(const std::string& data) {
+    const char* type = DetectImageType((const unsigned char*)data.data(), data.size());
+    if (strcmp(type, "JPEG") == 0) {
+        return ImageLoader::DECODE_JPEG;
+    } else if (strcmp(type, "PNG") == 0) {
+        return ImageLoader::DECODE_PNG;
+    } else if (strcmp(type, "WEBP") == 0) {
+        return ImageLoader::DECODE_WEBP;
     }
-    
-    // 对于其他格式，使用 SDL_image
-    SDL_RWops* rw = SDL_RWFromConstMem(data, size);
-    if (!rw) {
-        FileLogger::GetInstance().LogError("[LoadFromMemory] Failed to create RWops: %s", SDL_GetError());
+    return ImageLoader::DECODE_OTHER;
+}
+
+static void RecordDecode(ImageLoader::DecodeFormat format, OSTime start) {
+    sDecodeCount[format].fetch_add(1, std::memory_order_relaxed);
+    sDecodeUs[format].fetch_add(OSTicksToMicroseconds(OSGetSystemTime() - start), std::memory_order_relaxed);
+}
+
+SDL_Surface* ImageLoader::DecodeToSurface(const void* data, size_t size, Uint32 format, int targetWidth, int targetHeight) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_IMAGES);
+    if (!data || size == 0) {
+        FileLogger::GetInstance().LogError("[LoadFromMemory] Invalid data: data=%p, size=%zu", data, size);
         return nullptr;
     }
     
+    ULOG_DEBUG(IMG, "[LoadFromMemory] Attempting to decode %zu bytes", size);
+    
+    // 检测图片格式 (只检测一次, 按格式选择唯一的解码器)
+    const unsigned char* bytes = (const unsigned char*)data;
+    const char* type = DetectImageType(bytes, size);
+    
+    bool scaled = (targetWidth > 0 && targetHeight > 0);
     SDL_Surface* surface = nullptr;
-    if (format == "JPEG") {
-        FileLogger::GetInstance().LogInfo("[LoadFromMemory] Trying IMG_LoadTyped_RW with 'JPG' hint");
-        surface = IMG_LoadTyped_RW(rw, 1, "JPG");
+    
+    if (strcmp(type, "WEBP") == 0) {
+        surface = DecodeWebP(bytes, size, targetWidth, targetHeight, DirectWebPFormat(format));
+    } else if (strcmp(type, "JPEG") == 0) {
+        // DCT 缩放后剩余的缩放由下面的线性缩放完成
+        surface = DecodeJpeg(bytes, size, targetWidth, targetHeight, DirectJpegFormat(format));
         if (!surface) {
-            FileLogger::GetInstance().LogError("[LoadFromMemory] IMG_LoadTyped_RW('JPG') failed: %s", IMG_GetError());
-            return nullptr;
+            FileLogger::GetInstance().LogError("[LoadFromMemory] JPEG decode failed");
         }
     } else {
-        surface = IMG_Load_RW(rw, 1);
+        // 其他格式使用 SDL_image
+        SDL_RWops* rw = SDL_RWFromConstMem(data, size);
+        if (!rw) {
+            FileLogger::GetInstance().LogError("[LoadFromMemory] Failed to create RWops: %s", SDL_GetError());
+            return nullptr;
+        }
+        
+        if (strcmp(type, "unknown") != 0) {
+            surface = IMG_LoadTyped_RW(rw, 1, type);
+        } else {
+            surface = IMG_Load_RW(rw, 1);
+        }
+        if (!surface) {
+            FileLogger::GetInstance().LogError("[LoadFromMemory] Decoding %s failed: %s", type, IMG_GetError());
+        }
     }
     
     if (!surface) {
-        FileLogger::GetInstance().LogError("[LoadFromMemory] All decoders failed");
         return nullptr;
     }
     
-    FileLogger::GetInstance().LogInfo("[LoadFromMemory] Surface created: %dx%d, format=%d", 
-        surface->w, surface->h, surface->format->format);
-    
-    SDL_Renderer* renderer = Gfx::GetRenderer();
-    if (!renderer) {
-        FileLogger::GetInstance().LogError("[LoadFromMemory] Renderer is null!");
+    // 解码器不能直接输出渲染器格式时转换一次
+    if (surface->format->format != format) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, format, 0);
         SDL_FreeSurface(surface);
-        return nullptr;
+        if (!converted) {
+            FileLogger::GetInstance().LogError("[LoadFromMemory] SDL_ConvertSurfaceFormat failed: %s", SDL_GetError());
+            return nullptr;
+        }
+        surface = converted;
     }
     
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface);
-    
-    if (!texture) {
-        FileLogger::GetInstance().LogError("[LoadFromMemory] SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
-        return nullptr;
+    // 解码器不能直接缩放到目标尺寸的 (PNG, DCT 缩放后的 JPEG) 在这里线性缩小
+    int fitW = surface->w, fitH = surface->h;
+    if (scaled) {
+        FitSize(surface->w, surface->h, targetWidth, targetHeight, fitW, fitH);
+    }
+    if (fitW != surface->w || fitH != surface->h) {
+        SDL_Surface* resized = SDL_CreateRGBSurfaceWithFormat(0, fitW, fitH, 32, format);
+        if (resized && SDL_SoftStretchLinear(surface, nullptr, resized, nullptr) == 0) {
+            SDL_FreeSurface(surface);
+            surface = resized;
+        } else if (resized) {
+            SDL_FreeSurface(resized);
+        }
     }
     
-    FileLogger::GetInstance().LogInfo("[LoadFromMemory] [SUCCESS] Texture created successfully (%s format)", format.c_str());
-    return texture;
+    ULOG_DEBUG(IMG, "[LoadFromMemory] Decoded %s %dx%d", type, surface->w, surface->h);
+    return surface;
 }
 
 SDL_Texture* ImageLoader::LoadFromUrl(const std::string& url) {
@@ -442,9 +1328,7 @@ SDL_Texture* ImageLoader::LoadFromUrl(const std::string& url) {
     SDL_Texture* cached = GetCached(url);
     if (cached) {
         DEBUG_FUNCTION_LINE("Image loaded from memory cache: %s", url.c_str());
-        if (FileLogger::GetInstance().IsVerbose()) {
-            FileLogger::GetInstance().LogDebug("[CACHE HIT - MEMORY] %s", url.c_str());
-        }
+        ULOG_DEBUG(IMG, "[CACHE HIT - MEMORY] %s", url.c_str());
         return cached;
     }
     
@@ -453,17 +1337,17 @@ SDL_Texture* ImageLoader::LoadFromUrl(const std::string& url) {
         SDL_Texture* texture = LoadFromMemory(diskData.data(), diskData.size());
         if (texture) {
             CacheTexture(url, texture);
-            FileLogger::GetInstance().LogInfo("[CACHE HIT - DISK] %s", url.c_str());
+            ULOG_DEBUG(IMG, "[CACHE HIT - DISK] %s", url.c_str());
             return texture;
         } else {
             FileLogger::GetInstance().LogWarning("[CACHE CORRUPT] Failed to load texture from cache: %s", GetCachePath(url).c_str());
         }
     } else {
-        FileLogger::GetInstance().LogInfo("[CACHE MISS] Not found in disk cache: %s", url.c_str());
+        ULOG_DEBUG(IMG, "[CACHE MISS] Not found in disk cache: %s", url.c_str());
     }
     
     DEBUG_FUNCTION_LINE("Downloading image synchronously: %s", url.c_str());
-    FileLogger::GetInstance().LogInfo("[DOWNLOADING - SYNC] %s", url.c_str());
+    ULOG_DEBUG(IMG, "[DOWNLOADING - SYNC] %s", url.c_str());
     
     std::vector<uint8_t> data = DownloadData(url);
     if (data.empty()) {
@@ -508,7 +1392,7 @@ std::vector<uint8_t> ImageLoader::DownloadData(const std::string& url) {
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "UTheme/1.0 (Wii U)");
     curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);  // 启用详细日志
     
-    FileLogger::GetInstance().LogInfo("[CURL] Starting download: %s", url.c_str());
+    ULOG_DEBUG(IMG, "[CURL] Starting download: %s", url.c_str());
     
     CURLcode res = curl_easy_perform(curl);
     
@@ -524,7 +1408,7 @@ std::vector<uint8_t> ImageLoader::DownloadData(const std::string& url) {
             FileLogger::GetInstance().LogError("HTTP error %ld: %s", http_code, url.c_str());
             data.clear();
         } else {
-            FileLogger::GetInstance().LogInfo("[CURL] Successfully downloaded %zu bytes", data.size());
+            ULOG_DEBUG(IMG, "[CURL] Successfully downloaded %zu bytes", data.size());
         }
     }
     
@@ -536,216 +1420,324 @@ void ImageLoader::LoadAsync(const LoadRequest& request) {
     if (request.url.empty()) return;
     
     // 检查是否是本地文件 (以 fs:/ 开头的路径)
+    // 本地文件在主线程不做任何文件操作 (SD 卡上的 stat 也可能很慢), 打开、读取和检查都在解码线程中进行
     bool isLocalFile = (request.url.find("fs:/") == 0);
-    std::string localPath;
     
-    FileLogger::GetInstance().LogInfo("[LoadAsync] URL: %s, isLocal: %d", request.url.c_str(), isLocalFile);
+    ULOG_DEBUG(IMG, "[LoadAsync] URL: %s, isLocal: %d", request.url.c_str(), isLocalFile);
     
-    if (isLocalFile) {
-        // 直接使用本地文件路径
-        localPath = request.url;
-        FileLogger::GetInstance().LogInfo("[LOCAL FILE] Loading: %s", localPath.c_str());
-        
-        // 检查文件是否存在
-        struct stat st;
-        int statResult = stat(localPath.c_str(), &st);
-        int statErrno = errno;
-        FileLogger::GetInstance().LogInfo("[STAT CALL] path='%s', result=%d, errno=%d", localPath.c_str(), statResult, statErrno);
-        
-        if (statResult != 0) {
-            FileLogger::GetInstance().LogError("[LOCAL FILE NOT FOUND] %s (errno: %d)", localPath.c_str(), statErrno);
-            if (request.callback) {
-                request.callback(nullptr);
-            }
-            return;
+    // 本地文件和网络图片共用内存缓存、请求合并和后台解码
+    std::shared_ptr<bool> owner = request.owner ? request.owner->mAlive : nullptr;
+    bool atlas = request.atlas && request.targetWidth > 0 && request.targetHeight > 0;
+    AtlasSprite sprite;
+    SDL_Texture* cached = nullptr;
+    if (atlas) {
+        cached = GetAtlasSprite(request.url, sprite) ? sprite.texture : nullptr;
+    } else {
+        cached = GetCached(request.url);
+    }
+    if (cached) {
+        sStats.memoryHits++;
+        ULOG_DEBUG(IMG, "[CACHE HIT - MEMORY] Async: %s", request.url.c_str());
+        if (request.callback) {
+            request.callback(cached);
         }
-        
-        FileLogger::GetInstance().LogInfo("[LOCAL FILE EXISTS] Size: %lld bytes, mode: 0x%x", (long long)st.st_size, st.st_mode);
-        
-        // 检查是否真的是文件
-        if (S_ISDIR(st.st_mode)) {
-            FileLogger::GetInstance().LogError("[ERROR] Path is a directory, not a file: %s", localPath.c_str());
-            if (request.callback) {
-                request.callback(nullptr);
+        return;
+    }
+    
+    // 同一 URL 已在下载或解码中: 合并到现有请求, 不重复下载和解码
+    auto inflight = mPendingLoads.equal_range(request.url);
+    while (inflight.first != inflight.second && inflight.first->second->atlas != atlas) {
+        ++inflight.first;
+    }
+    if (inflight.first != inflight.second) {
+        AsyncDownloadContext* pendingCtx = inflight.first->second;
+        sStats.coalesced++;
+        pendingCtx->unowned = pendingCtx->unowned || !owner;
+        if (request.callback) {
+            pendingCtx->callbacks.push_back({owner, request.callback});
+        }
+        if (request.progressCallback) {
+            pendingCtx->progressCallbacks.push_back({owner, request.progressCallback});
+            if (pendingCtx->partialTexture) {
+                request.progressCallback(pendingCtx->partialTexture);
             }
-            return;
         }
-        
-        if (!S_ISREG(st.st_mode)) {
-            FileLogger::GetInstance().LogWarning("[WARNING] Path is not a regular file (mode: 0x%x): %s", st.st_mode, localPath.c_str());
+        // 合并的请求需要更大的尺寸时按大的解码 (还没开始解码时有效)
+        if (request.targetWidth <= 0 || request.targetHeight <= 0) {
+            pendingCtx->targetWidth = 0;
+            pendingCtx->targetHeight = 0;
+        } else if (pendingCtx->targetWidth > 0 && pendingCtx->targetHeight > 0) {
+            pendingCtx->targetWidth = std::max(pendingCtx->targetWidth, request.targetWidth);
+            pendingCtx->targetHeight = std::max(pendingCtx->targetHeight, request.targetHeight);
         }
-        
-        // 检查文件大小 - 即使显示0字节也尝试加载(可能是stat的问题)
-        if (st.st_size == 0) {
-            FileLogger::GetInstance().LogWarning("[WARNING] File appears empty (0 bytes), but will try to load anyway: %s", localPath.c_str());
+        bool changed = false;
+        if (request.highPriority) {
+            pendingCtx->highPriority = true;
+            pendingCtx->lowPriority = false;
+            changed = true;
+        } else if (!request.highPriority && !request.lowPriority && pendingCtx->lowPriority) {
+            // 预取的图片现在真正需要了
+            pendingCtx->lowPriority = false;
+            changed = true;
         }
-        
-        // 尝试加载本地文件 - 先用 IMG_Load 让它自动检测格式
-        SDL_Surface* surface = IMG_Load(localPath.c_str());
-        
-        // 如果失败,尝试强制作为 WEBP 加载
-        if (!surface) {
-            FileLogger::GetInstance().LogWarning("[IMG_Load FAILED] %s, trying as WEBP...", IMG_GetError());
-            
-            SDL_RWops* rwops = SDL_RWFromFile(localPath.c_str(), "rb");
-            if (rwops) {
-                FileLogger::GetInstance().LogInfo("[SDL_RWFromFile OK] Trying IMG_LoadTyped_RW with WEBP");
-                surface = IMG_LoadTyped_RW(rwops, 1, "WEBP");
-                if (!surface) {
-                    FileLogger::GetInstance().LogError("[WEBP Load FAILED via SDL_image] %s", IMG_GetError());
-                }
-            } else {
-                FileLogger::GetInstance().LogError("[SDL_RWFromFile FAILED] %s", SDL_GetError());
+        // 一直需要结果的请求者合并进来后不再过期, 都是预取时按最晚的过期时间
+        const auto none = std::chrono::steady_clock::time_point{};
+        if (pendingCtx->expiresAt != none) {
+            auto expiresAt = request.usefulMs > 0 ?
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(request.usefulMs) : none;
+            if (expiresAt == none || expiresAt > pendingCtx->expiresAt) {
+                pendingCtx->expiresAt = expiresAt;
+                changed = true;
             }
-        } else {
-            FileLogger::GetInstance().LogInfo("[IMG_Load SUCCESS] Surface created directly");
         }
-        
-        // 如果 SDL_image 失败,尝试直接使用 libwebp 解码
-        if (!surface) {
-            FileLogger::GetInstance().LogInfo("[Trying libwebp directly]");
-            
-            FILE* fp = fopen(localPath.c_str(), "rb");
-            if (fp) {
-                fseek(fp, 0, SEEK_END);
-                long fileSize = ftell(fp);
-                fseek(fp, 0, SEEK_SET);
-                
-                uint8_t* fileData = (uint8_t*)malloc(fileSize);
-                if (fileData) {
-                    size_t readSize = fread(fileData, 1, fileSize, fp);
-                    fclose(fp);
-                    
-                    if (readSize == (size_t)fileSize) {
-                        int width, height;
-                        uint8_t* rgbaData = WebPDecodeRGBA(fileData, fileSize, &width, &height);
-                        
-                        if (rgbaData) {
-                            FileLogger::GetInstance().LogInfo("[libwebp SUCCESS] Decoded %dx%d WEBP image", width, height);
-                            
-                            // 创建 SDL_Surface - 使用正确的像素格式
-                            // WebPDecodeRGBA 返回 RGBA 字节序: R, G, B, A
-                            #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-                                Uint32 rmask = 0xff000000;
-                                Uint32 gmask = 0x00ff0000;
-                                Uint32 bmask = 0x0000ff00;
-                                Uint32 amask = 0x000000ff;
-                            #else
-                                Uint32 rmask = 0x000000ff;
-                                Uint32 gmask = 0x0000ff00;
-                                Uint32 bmask = 0x00ff0000;
-                                Uint32 amask = 0xff000000;
-                            #endif
-                            
-                            surface = SDL_CreateRGBSurfaceFrom(
-                                rgbaData,
-                                width, height,
-                                32, // bits per pixel
-                                width * 4, // pitch
-                                rmask, gmask, bmask, amask
-                            );
-                            
-                            if (surface) {
-                                // 复制数据因为 WebPFree 会释放 rgbaData
-                                SDL_Surface* copiedSurface = SDL_ConvertSurface(surface, surface->format, 0);
-                                SDL_FreeSurface(surface);
-                                surface = copiedSurface;
-                                FileLogger::GetInstance().LogInfo("[libwebp] Surface created and copied");
-                            }
-                            
-                            WebPFree(rgbaData);
-                        } else {
-                            FileLogger::GetInstance().LogError("[libwebp FAILED] Could not decode WEBP data");
-                        }
-                    } else {
-                        FileLogger::GetInstance().LogError("[FILE READ FAILED] Expected %ld bytes, read %zu bytes", fileSize, readSize);
-                    }
-                    
-                    free(fileData);
-                } else {
-                    FileLogger::GetInstance().LogError("[MALLOC FAILED] Could not allocate %ld bytes", fileSize);
-                    fclose(fp);
-                }
-            } else {
-                FileLogger::GetInstance().LogError("[FILE OPEN FAILED] Could not open: %s", localPath.c_str());
-            }
+        if (changed && pendingCtx->download && DownloadQueue::GetInstance()) {
+            DownloadQueue::GetInstance()->DownloadSetPriority(pendingCtx->download, DownloadPriorityFor(pendingCtx),
+                                                              pendingCtx->expiresAt);
         }
-        
-        if (surface) {
-            FileLogger::GetInstance().LogInfo("[SURFACE CREATED] %dx%d, format: %s", 
-                surface->w, surface->h, SDL_GetPixelFormatName(surface->format->format));
-                
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(Gfx::GetRenderer(), surface);
-            SDL_FreeSurface(surface);
-            
-            if (texture) {
-                FileLogger::GetInstance().LogInfo("[LOCAL FILE LOADED] %s -> texture: %p", localPath.c_str(), texture);
-                // 缓存纹理
-                CacheTexture(request.url, texture);
-                if (request.callback) {
-                    request.callback(texture);
-                }
-            } else {
-                FileLogger::GetInstance().LogError("[LOCAL FILE TEXTURE FAILED] %s: %s", localPath.c_str(), SDL_GetError());
-                if (request.callback) {
-                    request.callback(nullptr);
-                }
-            }
+        ULOG_DEBUG(IMG, "[COALESCED] %s (%zu waiting)", request.url.c_str(), pendingCtx->callbacks.size());
+        return;
+    }
+    
+    AsyncDownloadContext* context = sContextPool.Create();
+    context->url = request.url;
+    context->highPriority = request.highPriority;
+    context->lowPriority = request.lowPriority && !request.highPriority;
+    context->targetWidth = request.targetWidth;
+    context->targetHeight = request.targetHeight;
+    context->progressive = request.progressive && (request.targetWidth <= 0 || request.targetHeight <= 0);
+    context->atlas = atlas;
+    context->unowned = !owner;
+    if (request.usefulMs > 0) {
+        context->expiresAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(request.usefulMs);
+    }
+    if (request.progressCallback) {
+        context->progressCallbacks.push_back({owner, request.progressCallback});
+    }
+    if (request.callback) {
+        context->callbacks.push_back({owner, request.callback});
+    }
+    mPendingLoads.emplace(request.url, context); // 同一 URL 已有另一种请求时另外登记, 取消时一起找到
+    
+    if (request.source) {
+        // 自定义来源没有原始图片的磁盘缓存, 只查像素缓存
+        context->source = request.source;
+        if (context->targetWidth > 0 && context->targetHeight > 0 && !atlas &&
+            sDiskCache.HasVariant(request.url, ProcessedCacheSuffix(context->targetWidth, context->targetHeight))) {
+            sStats.pixelCacheHits++;
+            context->fromProcessedCache = true;
         } else {
-            FileLogger::GetInstance().LogError("[LOCAL FILE LOAD FAILED] %s: All methods failed", localPath.c_str());
-            if (request.callback) {
-                request.callback(nullptr);
-            }
+            sStats.localLoads++;
         }
+        SubmitDecode(context, nullptr);
         return;
     }
     
-    // 网络URL - 原有逻辑
-    SDL_Texture* cached = GetCached(request.url);
-    if (cached) {
-        if (FileLogger::GetInstance().IsVerbose()) {
-            FileLogger::GetInstance().LogDebug("[CACHE HIT - MEMORY] Async: %s", request.url.c_str());
-        }
-        if (request.callback) {
-            request.callback(cached);
+    if (isLocalFile) {
+        // 本地文件在解码线程中读取, 只读一次
+        context->localFile = true;
+        sStats.localLoads++;
+        SubmitDecode(context, nullptr);
+        return;
+    }
+    LoadFromDiskOrNetwork(context);
+}
+
+void ImageLoader::LoadFromDiskOrNetwork(AsyncDownloadContext* context) {
+    const std::string& url = context->url;
+    // 过期的条目先照常使用, 在后台确认
+    if (IsDiskCacheStale(url)) {
+        RevalidateInBackground(url);
+    }
+    
+    // 已解码缩放好的像素缓存: 后台线程读出后直接上传
+    if (!context->skipProcessed && context->targetWidth > 0 && context->targetHeight > 0) {
+        if (sDiskCache.HasVariant(url, ProcessedCacheSuffix(context->targetWidth, context->targetHeight))) {
+            ULOG_DEBUG(IMG, "[CACHE HIT - PIXELS] Async: %s", url.c_str());
+            sStats.pixelCacheHits++;
+            context->fromProcessedCache = true;
+            SubmitDecode(context, nullptr);
+            return;
         }
+    }
+    
+    // 高清图的 16 位像素缓存: 不用下载、不用渐进解码
+    if (!context->skipProcessed && context->targetWidth <= 0 && !context->atlas &&
+        GetCompactFormat() != SDL_PIXELFORMAT_UNKNOWN && sDiskCache.HasVariant(url, COMPACT_CACHE_SUFFIX)) {
+        ULOG_DEBUG(IMG, "[CACHE HIT - PIXELS 565] Async: %s", url.c_str());
+        sStats.pixelCacheHits++;
+        context->fromProcessedCache = true;
+        SubmitDecode(context, nullptr);
         return;
     }
     
-    std::vector<uint8_t> diskData = LoadFromCache(request.url);
+    // 磁盘缓存
+    std::vector<uint8_t> diskData = LoadFromCache(url);
     if (!diskData.empty()) {
-        SDL_Texture* texture = LoadFromMemory(diskData.data(), diskData.size());
-        if (texture) {
-            CacheTexture(request.url, texture);
-            FileLogger::GetInstance().LogInfo("[CACHE HIT - DISK] Async: %s", request.url.c_str());
-            if (request.callback) {
-                request.callback(texture);
-            }
-            return;
+        ULOG_DEBUG(IMG, "[CACHE HIT - DISK] Async: %s", url.c_str());
+        sStats.diskHits++;
+        context->fromDiskCache = true;
+        SubmitDecode(context, std::make_shared<const std::string>(diskData.begin(), diskData.end()));
+        return;
+    }
+    
+    StartDownload(context, sDownloadPool.Create());
+}
+
+std::string ImageLoader::GetProcessedCachePath(const std::string& url, int width, int height) {
+    std::string path = GetCachePath(url);
+    if (path.empty()) {
+        return path;
+    }
+    return path + ProcessedCacheSuffix(width, height);
+}
+
+// 像素缓存文件头, 后面紧跟 pitch * height 字节的像素数据
+struct ProcessedCacheHeader {
+    char magic[4];     // "UTPX"
+    uint32_t version;
+    uint32_t format;   // SDL 像素格式 (渲染器原生格式)
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+};
+static const uint32_t PROCESSED_CACHE_VERSION = 1;
+
+SDL_Surface* ImageLoader::LoadProcessedCache(const std::string& path, const std::string& sourcePath, Uint32 format) {
+    // 原始图片比像素缓存新 (重新下载过), 缓存作废
+    struct stat processedSt, sourceSt;
+    if (stat(path.c_str(), &processedSt) != 0) {
+        return nullptr;
+    }
+    if (stat(sourcePath.c_str(), &sourceSt) == 0 && sourceSt.st_mtime > processedSt.st_mtime) {
+        unlink(path.c_str());
+        return nullptr;
+    }
+    
+    FileIO file;
+    if (!file.Open(path, FileIO::MODE_READ)) {
+        return nullptr;
+    }
+    
+    ProcessedCacheHeader header;
+    if (file.Read(&header, sizeof(header)) != sizeof(header) || memcmp(header.magic, "UTPX", 4) != 0 ||
+        header.version != PROCESSED_CACHE_VERSION || header.format != format ||
+        header.width == 0 || header.height == 0 || header.width > 4096 || header.height > 4096) {
+        file.Close();
+        unlink(path.c_str());
+        return nullptr;
+    }
+    
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, header.width, header.height, SDL_BITSPERPIXEL(format), format);
+    if (!surface) {
+        return nullptr;
+    }
+    
+    bool ok = true;
+    if ((uint32_t)surface->pitch == header.pitch) {
+        size_t pixelBytes = (size_t)header.pitch * header.height;
+        ok = file.Read(surface->pixels, pixelBytes) == pixelBytes;
+    } else {
+        // pitch 不同时逐行读取
+        size_t rowBytes = std::min((size_t)surface->pitch, (size_t)header.pitch);
+        std::vector<uint8_t> row(header.pitch);
+        for (uint32_t y = 0; ok && y < header.height; y++) {
+            ok = file.Read(row.data(), header.pitch) == header.pitch;
+            memcpy((uint8_t*)surface->pixels + (size_t)y * surface->pitch, row.data(), rowBytes);
         }
     }
+    file.Close();
     
-    FileLogger::GetInstance().LogInfo("[DOWNLOADING - ASYNC] %s", request.url.c_str());
+    if (!ok) {
+        SDL_FreeSurface(surface);
+        unlink(path.c_str());
+        return nullptr;
+    }
+    return surface;
+}
+
+bool ImageLoader::SaveProcessedCache(const std::string& path, SDL_Surface* surface) {
+    // 先写临时文件再改名, 写到一半断电时不会留下损坏的缓存
+    std::string tempPath = path + ".tmp";
+    FileIO file;
+    if (!file.Open(tempPath, FileIO::MODE_WRITE)) {
+        return false;
+    }
     
-    AsyncDownloadContext* context = new AsyncDownloadContext();
-    context->url = request.url;
-    context->callback = request.callback;
-    context->download = new DownloadOperation();
-    context->download->url = request.url;
+    ProcessedCacheHeader header;
+    memcpy(header.magic, "UTPX", 4);
+    header.version = PROCESSED_CACHE_VERSION;
+    header.format = surface->format->format;
+    header.width = surface->w;
+    header.height = surface->h;
+    header.pitch = surface->pitch;
+    
+    bool ok = file.Write(&header, sizeof(header)) &&
+              file.Write(surface->pixels, (size_t)surface->pitch * surface->h);
+    ok = file.Close() && ok;
+    
+    // FAT 上不能改名覆盖已有的文件 (过期的像素缓存), 写成功后先删除它
+    if (ok) {
+        unlink(path.c_str());
+    }
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ImageLoader::StartDownload(AsyncDownloadContext* context, DownloadOperation* download) {
+    ULOG_DEBUG(IMG, "[DOWNLOADING - ASYNC] %s", context->url.c_str());
     
-    context->download->cb = [](DownloadOperation* download) {
+    if (!DownloadQueue::GetInstance()) {
+        FileLogger::GetInstance().LogError("DownloadQueue not initialized!");
+        sDownloadPool.Destroy(download);
+        FinishLoad(context, nullptr);
+        return;
+    }
+    
+    sStats.downloads++;
+    context->download = download;
+    download->url = context->url;
+    download->priority = DownloadPriorityFor(context);
+    download->expiresAt = context->expiresAt;
+    download->cbdata = context;
+    
+    // 缩略图很小, 界面在等它: 慢的连接尽早放弃重试, 并排在同优先级的高清图前面
+    if (context->targetWidth > 0 && context->targetHeight > 0) {
+        download->budgetMs = THUMBNAIL_BUDGET_MS;
+        download->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(THUMBNAIL_BUDGET_MS);
+    }
+    
+    // 渐进加载: 数据块直接送入增量解码器, 解码和下载同时进行
+    if (context->progressive) {
+        ProgressiveDecode* progress = new ProgressiveDecode();
+        progress->format = DirectWebPFormat(GetTextureFormat());
+        context->progress = progress;
+        download->sink = DownloadSink::CALLBACK;
+        download->chunkCb = [progress](const char* chunk, size_t size) {
+            return AppendProgressive(progress, chunk, size);
+        };
+        mProgressiveLoads.push_back(context);
+    }
+    
+    download->cb = [](DownloadOperation* download) {
         AsyncDownloadContext* ctx = (AsyncDownloadContext*)download->cbdata;
+        if (ctx->progress) {
+            FinishProgressive(ctx, download);
+            return;
+        }
         
-        SDL_Texture* texture = nullptr;
+        std::shared_ptr<const std::string> data;
         
         if (download->status == DownloadStatus::COMPLETE && !download->buffer.empty()) {
             // 先记录下载的数据信息
-            FileLogger::GetInstance().LogInfo("[DOWNLOAD COMPLETE] %s (%zu bytes)", ctx->url.c_str(), download->buffer.size());
+            ULOG_DEBUG(IMG, "[DOWNLOAD COMPLETE] %s (%zu bytes)", ctx->url.c_str(), download->buffer.size());
             
             // 检查前几个字节
             if (download->buffer.size() >= 4) {
                 const unsigned char* bytes = (const unsigned char*)download->buffer.data();
-                FileLogger::GetInstance().LogInfo("[DOWNLOAD DATA] First 4 bytes: %02X %02X %02X %02X", 
+                ULOG_DEBUG(IMG, "[DOWNLOAD DATA] First 4 bytes: %02X %02X %02X %02X", 
                     bytes[0], bytes[1], bytes[2], bytes[3]);
                     
                 // 检查前16字节看是否是HTML错误
@@ -755,37 +1747,576 @@ void ImageLoader::LoadAsync(const LoadRequest& request) {
                     for (int i = 0; i < 16; i++) {
                         if (preview[i] < 32 || preview[i] > 126) preview[i] = '.';
                     }
-                    FileLogger::GetInstance().LogInfo("[DOWNLOAD DATA] First 16 chars: %s", preview);
+                    ULOG_DEBUG(IMG, "[DOWNLOAD DATA] First 16 chars: %s", preview);
                 }
             }
             
-            SaveToCache(ctx->url, download->buffer.data(), download->buffer.size());
-            
-            texture = LoadFromMemory(download->buffer.data(), download->buffer.size());
-            if (texture) {
-                CacheTexture(ctx->url, texture);
-            } else {
-                FileLogger::GetInstance().LogError("[TEXTURE CREATION FAILED] %s", ctx->url.c_str());
-            }
+            // 写入磁盘缓存和解码同时在后台进行, 两者共享下载的缓冲区
+            data = std::make_shared<const std::string>(std::move(download->buffer));
+            StoreInBackground(ctx->url, data, download);
+        } else if (download->expired) {
+            ULOG_DEBUG(IMG, "[EXPIRED] %s", ctx->url.c_str());
         } else if (download->status == DownloadStatus::FAILED) {
             FileLogger::GetInstance().LogError("[DOWNLOAD FAILED] %s (HTTP %ld)", ctx->url.c_str(), download->response_code);
         }
         
-        if (ctx->callback) {
-            ctx->callback(texture);
-        }
+        bool expired = download->expired;
+        ctx->download = nullptr;
+        sDownloadPool.Destroy(download);
         
-        delete ctx->download;
-        delete ctx;
+        if (!data) {
+            if (!expired) {
+                sStats.downloadFailures++;
+            }
+            FinishLoad(ctx, nullptr);
+        } else {
+            SubmitDecode(ctx, std::move(data), true);
+        }
     };
     
-    context->download->cbdata = context;
+    DownloadQueue::GetInstance()->DownloadAdd(download);
+}
+
+void ImageLoader::CancelCallbacks(const std::string& url) {
+    // 加载本身继续进行, 完成后纹理仍然进入缓存
+    auto range = mPendingLoads.equal_range(url);
+    for (auto it = range.first; it != range.second; ++it) {
+        it->second->callbacks.clear();
+        it->second->progressCallbacks.clear();
+    }
+}
+
+// 删除 owner 的回调, 返回是否有被删除的
+static bool RemoveOwnerCallbacks(std::vector<ImageCallback>& callbacks, const std::shared_ptr<bool>& owner) {
+    size_t before = callbacks.size();
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                   [&owner](const ImageCallback& callback) { return callback.owner == owner; }),
+                    callbacks.end());
+    return callbacks.size() != before;
+}
+
+// 从解码队列撤回还没开始的任务 (已提交的 JobSystem 任务会处理队列中的下一张)
+static bool RemoveQueuedDecode(AsyncDownloadContext* ctx) {
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    for (auto it = sDecodeJobs.begin(); it != sDecodeJobs.end(); ++it) {
+        if (it->ctx == ctx) {
+            sDecodeJobs.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ImageLoader::CancelOwner(const std::shared_ptr<bool>& owner) {
+    int dropped = 0;
+    int cancelled = 0;
+    for (auto it = mPendingLoads.begin(); it != mPendingLoads.end(); ) {
+        AsyncDownloadContext* ctx = it->second;
+        bool removed = RemoveOwnerCallbacks(ctx->callbacks, owner);
+        removed = RemoveOwnerCallbacks(ctx->progressCallbacks, owner) || removed;
+        if (!removed) {
+            ++it;
+            continue;
+        }
+        dropped++;
+        
+        // 还有其它请求者时继续加载; 渐进加载和正在解码的请求完成后照常进入缓存
+        bool stop = false;
+        if (!ctx->unowned && ctx->callbacks.empty() && ctx->progressCallbacks.empty()) {
+            if (ctx->download && !ctx->progress && DownloadQueue::GetInstance()) {
+                // 取消后下载队列不会再调用完成回调, 可以直接释放
+                DownloadQueue::GetInstance()->DownloadCancel(ctx->download);
+                sDownloadPool.Destroy(ctx->download);
+                stop = true;
+            } else if (!ctx->download && RemoveQueuedDecode(ctx)) {
+                stop = true;
+            }
+        }
+        if (stop) {
+            cancelled++;
+            it = mPendingLoads.erase(it);
+            sContextPool.Destroy(ctx);
+        } else {
+            ++it;
+        }
+    }
     
-    if (DownloadQueue::GetInstance()) {
-        DownloadQueue::GetInstance()->DownloadAdd(context->download);
+    if (dropped > 0) {
+        ULOG_DEBUG(IMG, "[OWNER CANCELLED] %d request(s) dropped, %d load(s) stopped", dropped, cancelled);
+    }
+}
+
+// 回调是否都属于 owner
+static bool OnlyOwnerCallbacks(const std::vector<ImageCallback>& callbacks, const std::shared_ptr<bool>& owner) {
+    return std::all_of(callbacks.begin(), callbacks.end(),
+                       [&owner](const ImageCallback& callback) { return owner && callback.owner == owner; });
+}
+
+bool ImageLoader::CancelLoad(const std::string& url, const Owner* owner) {
+    if (!DownloadQueue::GetInstance()) {
+        return false;
+    }
+    std::shared_ptr<bool> alive = owner ? owner->mAlive : nullptr;
+    bool cancelled = false;
+    auto range = mPendingLoads.equal_range(url);
+    for (auto it = range.first; it != range.second; ) {
+        AsyncDownloadContext* ctx = it->second;
+        // 其它请求者合并进来后等待这个结果, 取消会让它们一直等不到回调
+        if (!ctx->download || ctx->progress || !OnlyOwnerCallbacks(ctx->callbacks, alive) ||
+            !OnlyOwnerCallbacks(ctx->progressCallbacks, alive)) {
+            ++it;
+            continue;
+        }
+        
+        // 取消后下载队列不会再调用完成回调, 可以直接释放
+        DownloadQueue::GetInstance()->DownloadCancel(ctx->download);
+        sDownloadPool.Destroy(ctx->download);
+        it = mPendingLoads.erase(it);
+        sContextPool.Destroy(ctx);
+        cancelled = true;
+    }
+    
+    if (cancelled) {
+        ULOG_DEBUG(IMG, "[CANCELLED] %s", url.c_str());
+    }
+    return cancelled;
+}
+
+void ImageLoader::SetPriority(const std::string& url, DownloadPriority priority) {
+    if (!DownloadQueue::GetInstance()) {
+        return;
+    }
+    auto range = mPendingLoads.equal_range(url);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->download) {
+            // 保留预取的过期时间
+            DownloadQueue::GetInstance()->DownloadSetPriority(it->second->download, priority, it->second->expiresAt);
+        }
+    }
+}
+
+void ImageLoader::FinishLoad(AsyncDownloadContext* ctx, SDL_Texture* texture) {
+    if (texture && !ctx->atlas) {
+        CacheTexture(ctx->url, texture);
+    }
+    
+    auto range = mPendingLoads.equal_range(ctx->url);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == ctx) {
+            mPendingLoads.erase(it);
+            break;
+        }
+    }
+    
+    for (auto& callback : ctx->callbacks) {
+        callback(texture);
+    }
+    
+    // 渐进加载失败后改为普通解码时, 调用者已经换成了新的纹理
+    if (ctx->partialTexture && ctx->partialTexture != texture) {
+        TextureRegistry::Destroy(ctx->partialTexture);
+        ResolveHandles(ctx->url);
+    }
+    sContextPool.Destroy(ctx);
+}
+
+void ImageLoader::UploadProgressive() {
+    for (auto* ctx : mProgressiveLoads) {
+        ProgressiveDecode* p = ctx->progress;
+        if (!p->ready) {
+            continue;
+        }
+        
+        int rows = p->rowsReady;
+        if (rows <= p->rowsUploaded) {
+            continue;
+        }
+        
+        if (!p->texture) {
+            SDL_Renderer* renderer = Gfx::GetRenderer();
+            if (!renderer) {
+                continue;
+            }
+            p->texture = TextureRegistry::Create(TextureRegistry::CATEGORY_HD, renderer, p->format,
+                                                 SDL_TEXTUREACCESS_STATIC, p->width, p->height);
+            if (!p->texture) {
+                continue;
+            }
+            SDL_SetTextureBlendMode(p->texture, SDL_BLENDMODE_BLEND);
+            
+            // 还没解码的部分保持透明
+            std::vector<uint8_t> clear((size_t)p->width * 4, 0);
+            SDL_Rect line = {0, 0, p->width, 1};
+            for (line.y = rows; line.y < p->height; line.y++) {
+                SDL_UpdateTexture(p->texture, &line, clear.data(), p->width * 4);
+            }
+        }
+        
+        // 已完成的行不会再被解码器改写, 可以在下载线程继续解码的同时读取
+        SDL_Rect rect = {0, p->rowsUploaded, p->width, rows - p->rowsUploaded};
+        SDL_UpdateTexture(p->texture, &rect, p->pixels.data() + (size_t)p->rowsUploaded * p->width * 4, p->width * 4);
+        p->rowsUploaded = rows;
+        
+        if (!ctx->partialTexture) {
+            ctx->partialTexture = p->texture;
+            ResolveHandles(ctx->url);
+            for (auto& callback : ctx->progressCallbacks) {
+                callback(p->texture);
+            }
+        }
+    }
+}
+
+void ImageLoader::FinishProgressive(AsyncDownloadContext* ctx, DownloadOperation* download) {
+    mProgressiveLoads.erase(std::remove(mProgressiveLoads.begin(), mProgressiveLoads.end(), ctx), mProgressiveLoads.end());
+    
+    ProgressiveDecode* p = ctx->progress;
+    ctx->progress = nullptr;
+    ctx->download = nullptr;
+    
+    bool complete = (download->status == DownloadStatus::COMPLETE && !p->data.empty());
+    std::shared_ptr<const std::string> data;
+    if (complete) {
+        ULOG_DEBUG(IMG, "[DOWNLOAD COMPLETE] %s (%zu bytes, progressive)", ctx->url.c_str(), p->data.size());
+        data = std::make_shared<const std::string>(std::move(p->data));
     } else {
-        FileLogger::GetInstance().LogError("DownloadQueue not initialized!");
-        delete context->download;
-        delete context;
+        FileLogger::GetInstance().LogError("[DOWNLOAD FAILED] %s (HTTP %ld)", ctx->url.c_str(), download->response_code);
+    }
+    
+    if (complete && p->finished) {
+        // 上传剩余的行, 纹理原地完成
+        SDL_Texture* texture = p->texture;
+        if (texture && p->rowsUploaded < p->height) {
+            SDL_Rect rect = {0, p->rowsUploaded, p->width, p->height - p->rowsUploaded};
+            SDL_UpdateTexture(texture, &rect, p->pixels.data() + (size_t)p->rowsUploaded * p->width * 4, p->width * 4);
+        } else if (!texture) {
+            SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(p->pixels.data(), p->width, p->height, 32,
+                                                                      p->width * 4, p->format);
+            if (surface) {
+                texture = CreateTexture(surface, TextureRegistry::CATEGORY_HD);
+                SDL_FreeSurface(surface);
+            }
+        }
+        // 16 位像素缓存是原始图片的派生文件, 原始数据写入之后再生成
+        auto pixels = std::make_shared<std::vector<uint8_t>>(std::move(p->pixels));
+        std::string url = ctx->url;
+        Uint32 format = p->format;
+        int width = p->width, height = p->height;
+        StoreInBackground(url, data, download, [url, pixels, format, width, height]() {
+            SaveCompactCache(url, pixels, format, width, height);
+        });
+        sDownloadPool.Destroy(download);
+        delete p;
+        FinishLoad(ctx, texture);
+        return;
+    }
+    
+    // 不是 WEBP 或增量解码失败: 用完整数据走普通的解码流程
+    if (data) {
+        StoreInBackground(ctx->url, data, download);
+    }
+    sDownloadPool.Destroy(download);
+    if (p->texture && !ctx->partialTexture) {
+        TextureRegistry::Destroy(p->texture);
+    }
+    delete p;
+    
+    if (!data) {
+        FinishLoad(ctx, nullptr);
+    } else {
+        SubmitDecode(ctx, std::move(data), true);
+    }
+}
+
+void ImageLoader::SaveCompactCache(const std::string& url, std::shared_ptr<std::vector<uint8_t>> pixels, Uint32 format,
+                                   int width, int height) {
+    // 渐进加载的纹理已经是 32 位; 在后台转换出 16 位像素缓存, 下次打开时直接读取
+    Uint32 compactFormat = GetCompactFormat();
+    std::string sourcePath = GetCachePath(url);
+    if (compactFormat == SDL_PIXELFORMAT_UNKNOWN || sourcePath.empty()) {
+        return;
+    }
+    
+    JobSystem::Submit([url, sourcePath, compactFormat, pixels, format, width, height](const CancelToken&) {
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels->data(), width, height, 32,
+                                                                  width * 4, format);
+        if (!surface) {
+            return;
+        }
+        SDL_Surface* compact = ConvertToCompact(surface, compactFormat);
+        SDL_FreeSurface(surface);
+        if (!compact) {
+            return;
+        }
+        if (SaveProcessedCache(sourcePath + COMPACT_CACHE_SUFFIX, compact)) {
+            sDiskCache.AddVariant(url, COMPACT_CACHE_SUFFIX,
+                                  sizeof(ProcessedCacheHeader) + (uint64_t)compact->pitch * compact->h);
+        }
+        SDL_FreeSurface(compact);
+    });
+}
+
+void ImageLoader::StopDecoding() {
+    // 还没开始的任务看到 sDecodeStop 后直接结束, 等待正在解码的任务
+    std::unique_lock<std::mutex> lock(sDecodeMutex);
+    sDecodeStop = true;
+    sDecodeCv.wait(lock, []() { return sDecodeInFlight == 0; });
+    
+    // 丢弃还没有处理的任务
+    for (auto& job : sDecodeJobs) {
+        sContextPool.Destroy(job.ctx);
+    }
+    sDecodeJobs.clear();
+    for (auto& result : sDecodeResults) {
+        if (result.surface) {
+            SDL_FreeSurface(result.surface);
+        }
+        sContextPool.Destroy(result.ctx);
+    }
+    sDecodeResults.clear();
+}
+
+void ImageLoader::PauseDecoding() {
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    sDecodePaused = true;
+}
+
+void ImageLoader::ResumeDecoding() {
+    size_t waiting;
+    {
+        std::lock_guard<std::mutex> lock(sDecodeMutex);
+        sDecodePaused = false;
+        // 暂停期间运行的任务没有取图片就结束了; 每张剩下的图片补一个任务 (多出来的任务看到队列空了直接结束)
+        waiting = sDecodeJobs.size();
+        sDecodeInFlight += (int)waiting;
+    }
+    for (size_t i = 0; i < waiting; i++) {
+        JobSystem::Submit([](const CancelToken&) { RunDecodeJob(); });
+    }
+}
+
+// 每个提交的任务处理队列最前面的一张图, 不一定是提交时加入的那张 (高优先级的图片排在前面)
+void ImageLoader::RunDecodeJob() {
+    DecodeJob job;
+    {
+        std::lock_guard<std::mutex> lock(sDecodeMutex);
+        if (sDecodeStop || sDecodePaused || sDecodeJobs.empty()) {
+            sDecodeInFlight--;
+            sDecodeCv.notify_all();
+            return;
+        }
+        job = std::move(sDecodeJobs.front());
+        sDecodeJobs.pop_front();
+    }
+    
+    SDL_Surface* surface;
+    uint32_t averageColor = 0;
+    {
+        Trace::Span span("image", "decode", job.ctx->url);
+        surface = ProcessJob(job);
+        if (job.ctx->atlas) {
+            averageColor = AverageColor(surface);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    sDecodeResults.push_back({job.ctx, surface, averageColor});
+    sDecodeInFlight--;
+    sDecodeCv.notify_all();
+}
+
+// 一次读入整个文件 (解码线程中调用)
+static bool ReadFile(const std::string& path, std::string& data) {
+    FileIO file;
+    if (!file.Open(path, FileIO::MODE_READ)) {
+        return false;
+    }
+    
+    uint64_t fileSize = file.Size();
+    if (fileSize == 0 || fileSize > 32 * 1024 * 1024) {
+        return false;
+    }
+    data.resize((size_t)fileSize);
+    return file.Read(&data[0], (size_t)fileSize) == (size_t)fileSize;
+}
+
+SDL_Surface* ImageLoader::ProcessJob(const DecodeJob& job) {
+    if (job.loadProcessed) {
+        Uint32 format = job.compactFormat != SDL_PIXELFORMAT_UNKNOWN ? job.compactFormat : job.format;
+        OSTime start = OSGetSystemTime();
+        SDL_Surface* surface = LoadProcessedCache(job.processedPath, job.sourcePath, format);
+        RecordDecode(DECODE_PIXELS, start);
+        return surface;
+    }
+    
+    static const std::string EMPTY_DATA;
+    std::string fileData;
+    const std::string* data = job.data ? job.data.get() : &EMPTY_DATA;
+    if (!job.filePath.empty()) {
+        // 不存在、是目录、为空或太大时都在这里失败, 回调收到 nullptr
+        if (!ReadFile(job.filePath, fileData)) {
+            FileLogger::GetInstance().LogError("[LOCAL FILE READ FAILED] %s (errno: %d)", job.filePath.c_str(), errno);
+            return nullptr;
+        }
+        data = &fileData;
+    } else if (job.source) {
+        if (!job.source(fileData) || fileData.empty()) {
+            FileLogger::GetInstance().LogError("[SOURCE READ FAILED] %s", job.url.c_str());
+            return nullptr;
+        }
+        data = &fileData;
+    }
+    
+    OSTime start = OSGetSystemTime();
+    SDL_Surface* surface = DecodeToSurface(data->data(), data->size(), job.format,
+                                           job.targetWidth, job.targetHeight);
+    RecordDecode(GetDecodeFormat(*data), start);
+    sBytesDecoded.fetch_add(data->size(), std::memory_order_relaxed);
+    
+    // 高清图: 不透明时换成 16 位, 有透明像素的保持 32 位, 也不保存像素缓存
+    if (surface && job.compactFormat != SDL_PIXELFORMAT_UNKNOWN) {
+        SDL_Surface* compact = ConvertToCompact(surface, job.compactFormat);
+        if (!compact) {
+            return surface;
+        }
+        SDL_FreeSurface(surface);
+        surface = compact;
+    }
+    
+    // 原始数据和解码同时开始写入: 已经写完时像素缓存作为它的派生文件保存, 还没写完时这次不保存
+    std::string processedPath = job.processedPath;
+    if (processedPath.empty() && job.sourcePending) {
+        std::string sourcePath = sDiskCache.GetPath(job.url);
+        if (!sourcePath.empty()) {
+            processedPath = sourcePath + job.processedSuffix;
+        }
+    }
+    
+    // 缩放后的像素写入缓存, 下次启动不用再解码 (失败不影响本次显示)
+    if (surface && !processedPath.empty() && SaveProcessedCache(processedPath, surface)) {
+        sDiskCache.AddVariant(job.url, job.processedSuffix,
+                              sizeof(ProcessedCacheHeader) + (uint64_t)surface->pitch * surface->h);
+    }
+    return surface;
+}
+
+void ImageLoader::SubmitDecode(AsyncDownloadContext* ctx, std::shared_ptr<const std::string> data, bool sourcePending) {
+    DecodeJob job;
+    job.ctx = ctx;
+    job.data = std::move(data);
+    job.format = GetTextureFormat(); // 需要渲染器, 只能在主线程获取
+    job.targetWidth = ctx->targetWidth;
+    job.targetHeight = ctx->targetHeight;
+    if (!ctx->atlas && job.targetWidth <= 0) {
+        job.compactFormat = GetCompactFormat();
+    }
+    if (ctx->localFile) {
+        job.filePath = ctx->url;
+    } else if (ctx->source) {
+        job.source = ctx->source;
+        job.url = ctx->url;
+        if (job.targetWidth > 0 && job.targetHeight > 0 && !ctx->atlas) {
+            // 没有原始图片, 登记一个空条目, 像素缓存作为它的派生文件随它淘汰
+            job.sourcePath = GetCachePath(ctx->url);
+            if (job.sourcePath.empty()) {
+                job.sourcePath = sDiskCache.Insert(ctx->url, nullptr, 0);
+            }
+            job.processedSuffix = ProcessedCacheSuffix(job.targetWidth, job.targetHeight);
+            job.processedPath = job.sourcePath + job.processedSuffix;
+            job.loadProcessed = ctx->fromProcessedCache;
+        }
+    } else if (sourcePending && ((job.targetWidth > 0 && job.targetHeight > 0) ||
+                                 job.compactFormat != SDL_PIXELFORMAT_UNKNOWN)) {
+        // 刚下载的原始数据还在后台写入, 像素缓存的路径在解码之后确定
+        job.url = ctx->url;
+        job.processedSuffix = job.targetWidth > 0 ? ProcessedCacheSuffix(job.targetWidth, job.targetHeight)
+                                                  : std::string(COMPACT_CACHE_SUFFIX);
+        job.sourcePending = true;
+    } else if (job.targetWidth > 0 && job.targetHeight > 0) {
+        // 原始图片没有写入磁盘缓存 (例如下载后立即被淘汰) 时不保存像素缓存
+        job.sourcePath = GetCachePath(ctx->url);
+        if (!job.sourcePath.empty()) {
+            job.url = ctx->url;
+            job.processedSuffix = ProcessedCacheSuffix(job.targetWidth, job.targetHeight);
+            job.processedPath = job.sourcePath + job.processedSuffix;
+            job.loadProcessed = ctx->fromProcessedCache;
+        }
+    } else if (job.compactFormat != SDL_PIXELFORMAT_UNKNOWN) {
+        // 高清图转换后的 16 位像素保存下来, 再次打开时不用解码
+        job.sourcePath = GetCachePath(ctx->url);
+        if (!job.sourcePath.empty()) {
+            job.url = ctx->url;
+            job.processedSuffix = COMPACT_CACHE_SUFFIX;
+            job.processedPath = job.sourcePath + job.processedSuffix;
+            job.loadProcessed = ctx->fromProcessedCache;
+        }
+    }
+    
+    bool highPriority = ctx->highPriority;
+    {
+        std::lock_guard<std::mutex> lock(sDecodeMutex);
+        if (highPriority) {
+            sDecodeJobs.push_front(std::move(job));
+        } else {
+            sDecodeJobs.push_back(std::move(job));
+        }
+        sDecodeInFlight++;
+    }
+    
+    // JobSystem 没有启动时直接在当前线程解码, 结果仍然在 Update 中上传
+    JobSystem::Submit([](const CancelToken&) { RunDecodeJob(); }, nullptr,
+                      highPriority ? JobSystem::PRIORITY_HIGH : JobSystem::PRIORITY_NORMAL);
+}
+
+void ImageLoader::UploadDecoded() {
+    int uploads = 0;
+    // 每帧至少上传一张, 之后只在这一帧的预算还有剩余时继续
+    while (uploads < MAX_UPLOADS_PER_FRAME && (uploads == 0 || FrameScheduler::HasTime())) {
+        DecodeResult result;
+        {
+            std::lock_guard<std::mutex> lock(sDecodeMutex);
+            if (sDecodeResults.empty()) {
+                return;
+            }
+            result = sDecodeResults.front();
+            sDecodeResults.pop_front();
+        }
+        
+        if (!result.surface) {
+            // 像素缓存无效, 改为解码原始图片
+            if (result.ctx->fromProcessedCache) {
+                result.ctx->fromProcessedCache = false;
+                result.ctx->skipProcessed = true;
+                if (result.ctx->source) {
+                    SubmitDecode(result.ctx, nullptr);
+                } else {
+                    LoadFromDiskOrNetwork(result.ctx);
+                }
+                continue;
+            }
+            
+            // 磁盘缓存损坏, 重新完整下载
+            if (result.ctx->fromDiskCache) {
+                FileLogger::GetInstance().LogWarning("[CACHE CORRUPT] Re-downloading: %s", result.ctx->url.c_str());
+                result.ctx->fromDiskCache = false;
+                StartDownload(result.ctx, sDownloadPool.Create());
+                continue;
+            }
+            
+            FileLogger::GetInstance().LogError("[TEXTURE CREATION FAILED] %s", result.ctx->url.c_str());
+            sStats.decodeFailures++;
+            FinishLoad(result.ctx, nullptr);
+            continue;
+        }
+        
+        SDL_Texture* texture;
+        {
+            Trace::Span span("image", "upload", result.ctx->url);
+            texture = result.ctx->atlas ? AddToAtlas(result.ctx->url, result.surface, result.averageColor)
+                                        : CreateTexture(result.surface, TextureCategory(result.ctx));
+        }
+        SDL_FreeSurface(result.surface);
+        uploads++;
+        FinishLoad(result.ctx, texture);
     }
 }
@@ -2,9 +2,18 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <list>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <SDL2/SDL.h>
+#include "DownloadQueue.hpp"
+#include "TextureRegistry.hpp"
+#include "MemoryPressure.hpp"
+
+struct AsyncDownloadContext;
+struct DecodeJob;
 
 // 图片加载器 - 从 URL 下载并创建 SDL 纹理
 class ImageLoader {
@@ -21,38 +30,277 @@ public:
     // 从内存数据加载图片
     static SDL_Texture* LoadFromMemory(const void* data, size_t size);
     
+    // 请求的所有者, 通常是界面的成员: 回调中引用了界面时把请求交给它
+    // 析构时丢弃它的所有请求的回调; 没有其它请求者的图片停止下载, 还没开始解码的不再解码
+    class Owner {
+    public:
+        Owner() : mAlive(std::make_shared<bool>(true)) {}
+        ~Owner() { Cancel(); }
+        Owner(const Owner&) = delete;
+        Owner& operator=(const Owner&) = delete;
+        
+        // 提前放弃请求 (例如界面准备释放它引用的数据), 之后的新请求不受影响
+        void Cancel() {
+            *mAlive = false;
+            ImageLoader::CancelOwner(mAlive);
+            mAlive = std::make_shared<bool>(true);
+        }
+        
+    private:
+        friend class ImageLoader;
+        std::shared_ptr<bool> mAlive;  // 已经排队的回调共享它, 变为 false 后不再调用
+    };
+    
     // 异步加载图片 (非阻塞,使用回调)
     struct LoadRequest {
         std::string url;
         std::function<void(SDL_Texture*)> callback;
         bool highPriority = false;
+        bool lowPriority = false;    // 预取: 排在普通请求之后下载 (highPriority 优先)
+        // 显示尺寸: 不为 0 时解码时直接缩小到该范围内 (保持比例, 不放大)
+        // 纹理缓存按 URL 保存, 同一 URL 应使用相同的尺寸
+        int targetWidth = 0;
+        int targetHeight = 0;
+        // 渐进加载 (仅限从网络下载的 WEBP, 且没有 targetWidth/targetHeight):
+        // 一边下载一边解码, 收到第一批像素后用 progressCallback 交出纹理,
+        // 该纹理会随着数据到达在原地更新, 完成后 callback 收到最终的纹理
+        bool progressive = false;
+        std::function<void(SDL_Texture*)> progressCallback;
+        // 打包进缩略图图集 (需要 targetWidth/targetHeight): callback 收到的是所在页的纹理,
+        // 绘制时用 GetAtlasSprite 取得纹理和区域
+        bool atlas = false;
+        // 回调引用的对象, 为空时回调在图片完成前一直有效
+        Owner* owner = nullptr;
+        // 结果在请求后 usefulMs 毫秒内有用 (只给没有回调的预取使用): 到时还没开始下载就不再下载;
+        // 有一直需要结果的请求合并进来时不再过期. 0 表示一直有用
+        int usefulMs = 0;
+        // 自定义来源 (例如压缩包中的条目): 在解码线程中调用, 读出未解码的图片数据
+        // 这时 url 只作为缓存的键, 来源的内容变化时应换一个键; 有 targetWidth/targetHeight 时保存像素缓存
+        std::function<bool(std::string& data)> source;
     };
     static void LoadAsync(const LoadRequest& request);
     
+    // url 是否还在下载或解码 (渐进加载时已经交出的纹理还没有完成)
+    static bool IsLoading(const std::string& url) { return mPendingLoads.count(url) > 0; }
+    
+    // 调整尚未开始下载的图片的优先级 (例如滚出屏幕后降级)
+    static void SetPriority(const std::string& url, DownloadPriority priority);
+    
+    // 丢弃还没完成的请求的回调 (回调中引用的对象即将销毁时调用)
+    static void CancelCallbacks(const std::string& url);
+    
+    // 丢弃 owner 的所有请求的回调, 没有其它请求者的下载和排队的解码一起取消 (Owner 析构时调用)
+    static void CancelOwner(const std::shared_ptr<bool>& owner);
+    
+    // 取消还在下载的请求 (例如预取后滚远了), 回调不会被调用
+    // 只取消回调都属于 owner 的请求 (owner 为空时只取消没有回调的预取): 合并进来的其它请求者还在等待结果
+    // 已经在解码或渐进加载的请求不能取消, 返回 false
+    static bool CancelLoad(const std::string& url, const Owner* owner = nullptr);
+    
     // 处理异步加载队列 (在主循环中调用)
+    // 完成解码的图片在这里上传为纹理, 每帧至少一张, 帧预算 (FrameScheduler) 有剩余时最多 MAX_UPLOADS_PER_FRAME 张
     static void Update();
     
-    // 缓存管理
+    // 纹理句柄: 缓存中某个 URL 的纹理的弱引用, Theme 等数据结构保存它而不是 SDL_Texture*
+    // 同一 URL 的句柄共享一个槽位 (侵入式引用计数, 复制只增减计数); 纹理被淘汰、替换或清空时缓存同时更新槽位,
+    // 句柄不会拿到已经释放的纹理: 不在缓存中时 Get 返回 nullptr, 同一 URL 重新加载后自动指向新纹理
+    // 渐进加载中交出的纹理也会登记到槽位上; 只在主线程使用
+    class TextureHandle {
+    public:
+        TextureHandle() = default;
+        explicit TextureHandle(const std::string& url);
+        TextureHandle(const TextureHandle& other);
+        TextureHandle& operator=(const TextureHandle& other);
+        ~TextureHandle() { Reset(); }
+        
+        // 当前的纹理, 同时像 GetCached 一样标记正在显示; 已被淘汰或还没加载完时返回 nullptr
+        SDL_Texture* Get() const;
+        // 没有指向任何 URL
+        bool IsEmpty() const { return mSlot == nullptr; }
+        void Reset();
+        
+    private:
+        friend class ImageLoader;
+        struct Slot {
+            std::string url;
+            SDL_Texture* texture = nullptr;
+            uint32_t refs = 0;
+        };
+        Slot* mSlot = nullptr;
+    };
+    
+    // 缓存管理 (LRU, 按纹理占用的显存字节数限制)
+    // 缓存中的纹理可能被淘汰, 保存纹理指针的界面应在绘制前用 GetCached 确认
+    // GetCached 同时会标记纹理正在显示, 最近两帧内用到的纹理不会被淘汰
     static SDL_Texture* GetCached(const std::string& url);
     static void CacheTexture(const std::string& url, SDL_Texture* texture);
     static void ClearCache();
     static void RemoveFromCache(const std::string& url);
+    static void SetCacheBudget(size_t bytes);
+    static size_t GetCacheBytes() { return mCacheBytes; }
+    
+    // 缩略图图集: 卡片大小的图片按行 (shelf) 打包到几张大纹理中, 减少纹理切换和显存分配
+    // 所有页都满时整页淘汰最久未绘制的一页; 仍然放不下时退回为普通缓存纹理 (rect 为整张纹理)
+    struct AtlasSprite {
+        SDL_Texture* texture = nullptr;
+        SDL_Rect rect = {0, 0, 0, 0};
+        uint32_t averageColor = 0;    // 图片的平均颜色 (0xFFRRGGBB, 解码时计算), 可以保存下来在下次加载前占位
+    };
+    static bool GetAtlasSprite(const std::string& url, AtlasSprite& sprite); // 同时标记所在页正在显示
+    static void ClearAtlas();
+    // 已经解码缩放好的缩略图 (热启动快照中的像素) 直接放进图集, 格式必须是 GetTextureFormat;
+    // 已经在图集中或正在加载时不做任何事; surface 由调用者释放
+    static bool AddAtlasThumbnail(const std::string& url, SDL_Surface* surface);
+    static Uint32 GetTextureFormat();   // 渲染器的像素格式 (像素缓存和图集使用), 只能在主线程调用
+    
+    // 固定的 URL 不会被淘汰 (可以在加载完成前固定), 引用计数
+    static void PinTexture(const std::string& url);
+    static void UnpinTexture(const std::string& url);
     
     // 磁盘缓存
     static bool SaveToCache(const std::string& url, const void* data, size_t size);
+    static bool IsInDiskCache(const std::string& url);  // 只查索引, 不访问 SD 卡
     static std::vector<uint8_t> LoadFromCache(const std::string& url);
-    static std::string GetCachePath(const std::string& url);
+    static std::string GetCachePath(const std::string& url);  // 条目的文件名; 打包的数据没有这个文件, 只作为像素缓存的前缀
     static std::string UrlToFilename(const std::string& url);
+    static bool IsDiskCacheStale(const std::string& url); // 是否需要向服务器重新确认
+    // 空闲时整理磁盘缓存 (IdleTasks 的工作): 后台淘汰到上限的 DISK_CACHE_IDLE_PERCENT, 需要时压缩打包文件,
+    // 第一次还删除无主文件, 然后写回索引; 后台任务没结束时返回 true
+    static bool RunCacheMaintenance();
+    
+    // 像素缓存: 按显示尺寸解码缩放后的像素, 下次加载只需读一次文件
+    static std::string GetProcessedCachePath(const std::string& url, int width, int height);
+    static SDL_Surface* LoadProcessedCache(const std::string& path, const std::string& sourcePath, Uint32 format);
+    static bool SaveProcessedCache(const std::string& path, SDL_Surface* surface);
     
     // 统计信息
     static size_t GetCacheSize() { return mTextureCache.size(); }
-    static size_t GetQueueSize() { return mLoadQueue.size(); }
+    static size_t GetQueueSize();    // 等待解码和等待上传的图片数
+    static size_t GetPendingCount() { return mPendingLoads.size(); }
+    static size_t GetAtlasBytes() { return mAtlasPages.size() * ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4; }
+    
+    // 解码耗时按来源格式分开统计
+    enum DecodeFormat {
+        DECODE_JPEG,
+        DECODE_PNG,
+        DECODE_WEBP,
+        DECODE_OTHER,
+        DECODE_PIXELS,    // 像素缓存 (只读文件, 不解码)
+        DECODE_FORMAT_COUNT
+    };
+    
+    // 本次运行的累计计数, 用于调整缓存上限和预取距离 (性能 HUD 显示, 退出时写入日志)
+    struct Stats {
+        uint64_t memoryHits = 0;        // 内存中已有纹理
+        uint64_t coalesced = 0;         // 合并到正在进行的加载
+        uint64_t pixelCacheHits = 0;    // 磁盘上的像素缓存
+        uint64_t diskHits = 0;          // 磁盘上的原始图片
+        uint64_t localLoads = 0;        // fs:/ 本地文件
+        uint64_t downloads = 0;
+        uint64_t downloadFailures = 0;
+        uint64_t decodeFailures = 0;    // 最终没有得到纹理的加载
+        uint64_t bytesDecoded = 0;      // 送入解码器的压缩数据
+        uint64_t decodeCount[DECODE_FORMAT_COUNT] = {};
+        uint64_t decodeUs[DECODE_FORMAT_COUNT] = {};
+        uint64_t evictions = 0;         // 被淘汰的缓存纹理
+        uint64_t evictedBytes = 0;
+        uint64_t atlasEvictions = 0;    // 被清空的图集页
+        size_t residentBytes = 0;       // 缓存纹理和图集页占用的显存
+        
+        uint64_t Requests() const { return memoryHits + coalesced + pixelCacheHits + diskHits + localLoads + downloads; }
+        float HitRate() const { return Requests() ? (float)memoryHits / Requests() : 0.0f; }
+        float AverageDecodeMs(int format) const {
+            return decodeCount[format] ? decodeUs[format] / 1000.0f / decodeCount[format] : 0.0f;
+        }
+    };
+    static Stats GetStats();
+    static void LogStats();
     
 private:
-    static std::map<std::string, SDL_Texture*> mTextureCache;
-    static std::vector<LoadRequest> mLoadQueue;
+    struct CacheEntry {
+        SDL_Texture* texture = nullptr;
+        size_t bytes = 0;                     // 估算的显存占用 (w * h * 每像素字节数)
+        bool hd = false;                      // 高清图, 显存不足时先淘汰
+        uint32_t averageColor = 0;            // 放不下图集的缩略图的平均颜色 (AtlasSprite)
+        uint32_t lastUsedFrame = 0;
+        std::list<std::string>::iterator lru; // 在 mLruList 中的位置
+    };
+    static std::unordered_map<std::string, CacheEntry> mTextureCache;
+    static std::unordered_map<std::string, TextureHandle::Slot*> mHandleSlots; // 有句柄的 URL
+    static std::list<std::string> mLruList;   // 头部为最近使用
+    static std::map<std::string, int> mPinnedUrls;
+    static size_t mCacheBytes;
+    static size_t mCacheBudget;
+    static uint32_t mFrame;                   // Update 的调用次数
+    
+    static constexpr size_t DEFAULT_CACHE_BUDGET = 96 * 1024 * 1024; // 纹理缓存默认上限
+    
+    struct AtlasShelf {
+        int y = 0;
+        int height = 0;
+        int x = 0;                            // 下一个图片的位置
+    };
+    struct AtlasPage {
+        SDL_Texture* texture = nullptr;
+        std::vector<AtlasShelf> shelves;
+        int nextY = 0;                        // 下一行的位置
+        uint32_t lastUsedFrame = 0;
+        std::vector<std::string> urls;        // 这一页中的图片
+    };
+    struct AtlasEntry {
+        int page = 0;
+        SDL_Rect rect = {0, 0, 0, 0};
+        uint32_t averageColor = 0;
+    };
+    static std::vector<AtlasPage> mAtlasPages;
+    static std::unordered_map<std::string, AtlasEntry> mAtlasEntries;
+    
+    static constexpr int ATLAS_PAGE_SIZE = 1024;  // 每页 1024x1024 (4 MB)
+    static constexpr int MAX_ATLAS_PAGES = 4;
+    static constexpr int ATLAS_PADDING = 1;       // 图片之间留空, 避免缩放时采样到相邻的图片
+    // 正在下载或解码的图片; 同一 URL 的图集和普通请求不合并, 最多各有一个
+    static std::multimap<std::string, AsyncDownloadContext*> mPendingLoads;
+    static std::vector<AsyncDownloadContext*> mProgressiveLoads;        // 正在渐进解码的图片
     static bool mInitialized;
+    static Uint32 mTextureFormat;
+    static Uint32 mCompactFormat;           // 高清图的 16 位格式, 渲染器不支持时为 UNKNOWN
+    static bool mCompactChecked;
+    
+    static constexpr int MAX_UPLOADS_PER_FRAME = 4;   // 每帧最多创建的纹理数 (另外受帧预算限制)
+    static constexpr int THUMBNAIL_BUDGET_MS = 5000;  // 缩略图每次下载尝试的时间预算, 同时是排队的截止时间
     
     // 内部辅助函数
     static std::vector<uint8_t> DownloadData(const std::string& url);
+    static void EvictToBudget();
+    static void ResolveHandles(const std::string& url);  // 缓存或渐进加载的纹理变化后更新句柄的槽位
+    static size_t EvictCache(size_t bytes);   // 淘汰不在显示的纹理, 先淘汰高清图 (TextureRegistry 的回收函数)
+    static size_t ReleaseMemory(MemoryPressure::Level level);  // MemoryPressure 的释放函数
+    static SDL_Texture* AddToAtlas(const std::string& url, SDL_Surface* surface, uint32_t averageColor);
+    static bool AllocateInAtlasPage(AtlasPage& page, int width, int height, SDL_Rect& rect);
+    static void EvictAtlasPage(int index);
+    
+    // 解码 (可以在任意线程调用) 和纹理创建 (只能在渲染线程调用)
+    static SDL_Surface* DecodeToSurface(const void* data, size_t size, Uint32 format,
+                                        int targetWidth = 0, int targetHeight = 0);
+    static SDL_Texture* CreateTexture(SDL_Surface* surface, TextureRegistry::Category category);
+    static Uint32 GetCompactFormat();       // 未启用或不支持时返回 SDL_PIXELFORMAT_UNKNOWN
+    
+    // 后台解码 (在 JobSystem 的任务线程上运行)
+    static void StopDecoding();
+    // 在后台时任务不再取新的图片, 回到前台时为剩下的图片重新提交任务 (AppLifecycle)
+    static void PauseDecoding();
+    static void ResumeDecoding();
+    static void RunDecodeJob();
+    static void LoadFromDiskOrNetwork(AsyncDownloadContext* ctx);
+    static void StartDownload(AsyncDownloadContext* ctx, DownloadOperation* download);
+    static SDL_Surface* ProcessJob(const DecodeJob& job);
+    // sourcePending: data 是刚下载的, 正在后台写入磁盘缓存 (见 StoreInBackground)
+    static void SubmitDecode(AsyncDownloadContext* ctx, std::shared_ptr<const std::string> data,
+                             bool sourcePending = false);
+    static void UploadDecoded();
+    static void UploadProgressive();
+    static void FinishProgressive(AsyncDownloadContext* ctx, DownloadOperation* download);
+    static void SaveCompactCache(const std::string& url, std::shared_ptr<std::vector<uint8_t>> pixels, Uint32 format,
+                                 int width, int height);
+    static void FinishLoad(AsyncDownloadContext* ctx, SDL_Texture* texture);
 };
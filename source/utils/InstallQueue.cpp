@@ -0,0 +1,277 @@
+#include "InstallQueue.hpp"
+#include "ThemeDownloader.hpp"
+#include "ThemePatcher.hpp"
+#include "FileLogger.hpp"
+#include "FrameArena.hpp"
+#include "LanguageManager.hpp"
+#include "../Gfx.hpp"
+#include "../Screen.hpp"
+#include <algorithm>
+
+InstallQueue& InstallQueue::GetInstance() {
+    static InstallQueue instance;
+    return instance;
+}
+
+InstallQueue::Job* InstallQueue::FindJob(const std::string& themeId) const {
+    // 同一主题可能有已结束的旧任务, 从后往前找最近的
+    for (auto it = mJobs.rbegin(); it != mJobs.rend(); ++it) {
+        if ((*it)->theme.id == themeId) {
+            return it->get();
+        }
+    }
+    return nullptr;
+}
+
+bool InstallQueue::Enqueue(const Theme& theme) {
+    if (theme.id.empty() || theme.GetDetails().downloadUrl.empty()) {
+        FileLogger::GetInstance().LogError("[InstallQueue] Theme '%s' has no download URL", theme.name.c_str());
+        return false;
+    }
+    Job* existing = FindJob(theme.id);
+    if (existing && IsActive(existing->state)) {
+        return false;
+    }
+
+    auto job = std::make_unique<Job>();
+    job->theme = theme;
+    // 只用到下载地址和元数据, 不保留列表的纹理
+    ThemeDetails& details = job->theme.EditDetails();
+    for (ThemeImage* image : {&job->theme.collagePreview, &details.launcherScreenshot, &details.waraWaraScreenshot}) {
+        image->thumbTexture.Reset();
+        image->hdTexture.Reset();
+    }
+    mJobs.push_back(std::move(job));
+    FileLogger::GetInstance().LogInfo("[InstallQueue] Queued '%s' (%zu pending)", theme.name.c_str(), GetPendingCount());
+
+    // 有空位时这一帧就开始下载
+    Update();
+    return true;
+}
+
+bool InstallQueue::Cancel(const std::string& themeId) {
+    Job* job = FindJob(themeId);
+    if (!job || !IsActive(job->state)) {
+        return true;
+    }
+    if (job->state == JOB_INSTALLING) {
+        return false;
+    }
+    if (job->downloader) {
+        job->downloader->Cancel();
+        delete job->downloader;
+        job->downloader = nullptr;
+    }
+    job->state = JOB_CANCELLED;
+    job->progress = 0.0f;
+    FileLogger::GetInstance().LogInfo("[InstallQueue] Cancelled '%s'", job->theme.name.c_str());
+    PruneFinished();
+    return true;
+}
+
+bool InstallQueue::GetStatus(const std::string& themeId, Status& status) const {
+    const Job* job = FindJob(themeId);
+    if (!job) {
+        return false;
+    }
+    status.state = job->state;
+    status.progress = job->state == JOB_INSTALLING ? job->installProgress.load() : job->progress;
+    status.error = job->error;
+    return true;
+}
+
+size_t InstallQueue::GetPendingCount() const {
+    return std::count_if(mJobs.begin(), mJobs.end(), [](const std::unique_ptr<Job>& job) {
+        return IsActive(job->state);
+    });
+}
+
+void InstallQueue::StartDownload(Job& job) {
+    FileLogger::GetInstance().LogInfo("[InstallQueue] Downloading '%s' from %s", job.theme.name.c_str(),
+                                      job.theme.GetDetails().downloadUrl.c_str());
+    job.state = JOB_DOWNLOADING;
+    job.progress = 0.0f;
+    job.downloader = new ThemeDownloader();
+    job.downloader->DownloadThemeAsync(job.theme.GetDetails().downloadUrl, job.theme.name);
+}
+
+void InstallQueue::PollDownload(Job& job) {
+    ThemeDownloader* downloader = job.downloader;
+    ProgressSnapshot snapshot = downloader->GetSnapshot();
+    job.progress = snapshot.progress;
+
+    switch ((DownloadState)snapshot.state) {
+        case DOWNLOAD_EXTRACTING:
+            job.state = JOB_EXTRACTING;
+            break;
+        case DOWNLOAD_COMPLETE:
+            // 压缩包在下载器删除后保留 (安装记录中的补丁来源)
+            job.archivePath = downloader->GetDownloadedFilePath();
+            job.extractedPath = downloader->GetExtractedPath();
+            job.state = JOB_WAITING_INSTALL;
+            job.progress = 0.0f;
+            break;
+        case DOWNLOAD_ERROR:
+        case DOWNLOAD_CANCELLED:
+            job.error = "Download failed: " + downloader->GetError();
+            job.state = JOB_FAILED;
+            FileLogger::GetInstance().LogError("[InstallQueue] '%s': %s", job.theme.name.c_str(), job.error.c_str());
+            Screen::GetBgmNotification().ShowError(_("install_queue.failed") + ": " + job.theme.name);
+            break;
+        default:
+            return;
+    }
+
+    if (!IsActive(job.state) || job.state == JOB_WAITING_INSTALL) {
+        // 下载线程在报告最终状态后马上结束, 这里的 join 不会等待
+        delete downloader;
+        job.downloader = nullptr;
+    }
+}
+
+void InstallQueue::StartInstall(Job& job) {
+    if (mInstallThread.joinable()) {
+        mInstallThread.join();
+    }
+    FileLogger::GetInstance().LogInfo("[InstallQueue] Installing '%s' from %s", job.theme.name.c_str(),
+                                      job.archivePath.c_str());
+    job.state = JOB_INSTALLING;
+    job.installProgress = 0.0f;
+    job.installFinished = false;
+    mInstalling = &job;
+
+    // 安装期间任务不会被删除 (只删除已结束的任务)
+    Job* target = &job;
+    mInstallThread = std::thread([target]() {
+        bool ok = false;
+        if (target->extractedPath.empty()) {
+            FileLogger::GetInstance().LogError("[InstallQueue] Extracted folder path is empty");
+        } else {
+            // 元数据和预览图任务 (预览图在主线程的 UpdateImageJobs 中下载)
+            ThemeManager::SaveThemeMetadata(target->theme, target->extractedPath);
+
+            ThemePatcher patcher;
+            patcher.SetProgressCallback([target](float progress, const std::string& message) {
+                target->installProgress = progress;
+            });
+            ok = patcher.InstallThemeFromArchive(target->archivePath, target->extractedPath, target->theme.id,
+                                                 target->theme.name, target->theme.author);
+        }
+        target->installOk = ok;
+        target->installFinished.store(true);
+    });
+}
+
+void InstallQueue::FinishInstall(Job& job) {
+    if (mInstallThread.joinable()) {
+        mInstallThread.join();
+    }
+    mInstalling = nullptr;
+
+    if (job.installOk) {
+        job.state = JOB_DONE;
+        job.progress = 1.0f;
+        mFinishedCount++;
+        FileLogger::GetInstance().LogInfo("[InstallQueue] Installed '%s'", job.theme.name.c_str());
+        Screen::GetBgmNotification().ShowNowPlaying(_("install_queue.installed") + ": " + job.theme.name);
+    } else {
+        job.state = JOB_FAILED;
+        job.error = "Installation failed";
+        FileLogger::GetInstance().LogError("[InstallQueue] Failed to install '%s'", job.theme.name.c_str());
+        Screen::GetBgmNotification().ShowError(_("install_queue.failed") + ": " + job.theme.name);
+    }
+}
+
+void InstallQueue::PruneFinished() {
+    size_t finished = mJobs.size() - GetPendingCount();
+    for (auto it = mJobs.begin(); it != mJobs.end() && finished > MAX_FINISHED;) {
+        if (!IsActive((*it)->state)) {
+            it = mJobs.erase(it);
+            finished--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void InstallQueue::Update() {
+    if (mJobs.empty()) {
+        return;
+    }
+
+    if (mInstalling && mInstalling->installFinished.load()) {
+        FinishInstall(*mInstalling);
+    }
+
+    size_t downloading = 0;
+    for (const auto& job : mJobs) {
+        if (job->downloader) {
+            PollDownload(*job);
+        }
+        if (job->downloader) {
+            downloading++;
+        }
+    }
+
+    // 按加入顺序开始下载和安装
+    for (const auto& job : mJobs) {
+        if (job->state == JOB_QUEUED && downloading < MAX_DOWNLOADS) {
+            StartDownload(*job);
+            downloading++;
+        } else if (job->state == JOB_WAITING_INSTALL && !mInstalling) {
+            StartInstall(*job);
+        }
+    }
+    PruneFinished();
+}
+
+void InstallQueue::DrawOverlay() {
+    const Job* current = nullptr;
+    size_t pending = 0;
+    for (const auto& job : mJobs) {
+        if (!IsActive(job->state)) {
+            continue;
+        }
+        pending++;
+        // 显示正在安装的主题, 没有时显示最早的下载
+        if (job.get() == mInstalling || (!current && job->state != JOB_QUEUED && job->state != JOB_WAITING_INSTALL)) {
+            current = job.get();
+        }
+    }
+    if (pending == 0) {
+        return;
+    }
+
+    const int w = 460;
+    const int h = 70;
+    const int x = Gfx::SCREEN_WIDTH - w - 20;
+    const int y = Gfx::SCREEN_HEIGHT - h - 110;
+    Gfx::DrawRectFilled(x, y, w, h, {0x00, 0x00, 0x00, 0xc0});
+    Gfx::Print(x + 12, y + 20, 24, Gfx::COLOR_TEXT,
+               FrameArena::Format("%s: %zu", _("install_queue.title").c_str(), pending), Gfx::ALIGN_VERTICAL);
+    if (current) {
+        float progress = current->state == JOB_INSTALLING ? current->installProgress.load() : current->progress;
+        const std::string& stage = current->state == JOB_INSTALLING ? _("theme_detail.installing")
+                                                                     : _("theme_detail.downloading");
+        Gfx::Print(x + 12, y + 50, 20, Gfx::COLOR_ALT_TEXT,
+                   FrameArena::Format("%s %.0f%%  %s", stage.c_str(), progress * 100, current->theme.name.c_str()),
+                   Gfx::ALIGN_VERTICAL);
+    }
+}
+
+void InstallQueue::Shutdown() {
+    for (const auto& job : mJobs) {
+        if (job->downloader) {
+            job->downloader->Cancel();
+            delete job->downloader;
+            job->downloader = nullptr;
+        }
+    }
+    // 打了一半补丁的主题不能留下, 等待安装结束
+    if (mInstallThread.joinable()) {
+        FileLogger::GetInstance().LogInfo("[InstallQueue] Waiting for install to finish...");
+        mInstallThread.join();
+    }
+    mInstalling = nullptr;
+    mJobs.clear();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ThemeManager.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+class ThemeDownloader;
+
+// 主题下载和安装队列 - 可以连续加入几个主题, 离开详情页或下载界面后继续进行
+// 最多 MAX_DOWNLOADS 个主题同时下载 (传输按 BULK 流量交给 DownloadQueue, 有界面请求时自动限速),
+// 安装一次只进行一个: 打补丁要把菜单文件和补丁读入内存, 同时安装两个会超出内存预算, 也会同时写同一组输出
+// 除安装线程外只在主线程使用
+class InstallQueue {
+public:
+    enum JobState {
+        JOB_QUEUED,            // 等待下载
+        JOB_DOWNLOADING,
+        JOB_EXTRACTING,
+        JOB_WAITING_INSTALL,   // 下载完成, 等待前面的主题安装完
+        JOB_INSTALLING,
+        JOB_DONE,
+        JOB_FAILED,
+        JOB_CANCELLED
+    };
+
+    struct Status {
+        JobState state = JOB_QUEUED;
+        float progress = 0.0f;   // 当前阶段 (下载或安装) 的进度
+        std::string error;
+    };
+
+    static constexpr size_t MAX_DOWNLOADS = 2;
+    static constexpr size_t MAX_FINISHED = 8;   // 保留的已结束任务数 (详情页读取结果)
+
+    static InstallQueue& GetInstance();
+
+    // 加入队列 (复制主题信息); 没有下载地址或已在队列中时返回 false
+    bool Enqueue(const Theme& theme);
+    // 取消还没开始安装的任务, 已经在安装时返回 false
+    bool Cancel(const std::string& themeId);
+
+    // 最近一次加入的该主题的任务, 没有时返回 false
+    bool GetStatus(const std::string& themeId, Status& status) const;
+    static bool IsActive(JobState state) { return state < JOB_DONE; }
+
+    size_t GetPendingCount() const;     // 还没结束的任务数
+    bool IsInstalling() const { return mInstalling != nullptr; }
+    uint32_t GetFinishedCount() const { return mFinishedCount; } // 安装成功一个主题时递增
+
+    // 每帧调用: 开始下载和安装, 处理结束的任务
+    void Update();
+    // 有任务时在屏幕角落显示队列进度
+    void DrawOverlay();
+    // 退出时调用: 取消所有下载, 等待正在进行的安装结束
+    void Shutdown();
+
+private:
+    InstallQueue() = default;
+    ~InstallQueue() = default;
+    InstallQueue(const InstallQueue&) = delete;
+    InstallQueue& operator=(const InstallQueue&) = delete;
+
+    struct Job {
+        Theme theme;
+        JobState state = JOB_QUEUED;
+        float progress = 0.0f;
+        std::string error;
+        ThemeDownloader* downloader = nullptr;
+        std::string archivePath;      // 下载的压缩包 (补丁直接从这里读取)
+        std::string extractedPath;    // 解压后的主题目录
+        // 安装线程写入
+        std::atomic<float> installProgress{0.0f};
+        std::atomic<bool> installFinished{false};
+        bool installOk = false;
+    };
+
+    void StartDownload(Job& job);
+    void PollDownload(Job& job);
+    void StartInstall(Job& job);
+    void FinishInstall(Job& job);
+    void PruneFinished();
+    Job* FindJob(const std::string& themeId) const;
+
+    std::deque<std::unique_ptr<Job>> mJobs;  // 按加入顺序
+    Job* mInstalling = nullptr;
+    std::thread mInstallThread;
+    uint32_t mFinishedCount = 0;
+};
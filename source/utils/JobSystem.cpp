@@ -0,0 +1,254 @@
+#include "JobSystem.hpp"
+#include "FileLogger.hpp"
+#include <coreinit/thread.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct JobSystem::JobState {
+    Work work;
+    Continuation then;
+    CancelToken token;
+    std::mutex mutex;
+    std::condition_variable doneCv;
+    bool done = false;
+};
+
+namespace {
+
+struct Worker {
+    std::mutex mutex;   // 保护 queue
+    std::deque<std::shared_ptr<JobSystem::JobState>> queue;
+    std::thread thread;
+};
+
+// 核心 1 留给主线程和 GX2
+struct CoreInfo {
+    uint32_t affinity;
+    const char* name;
+};
+const CoreInfo sCores[] = {
+    {OS_THREAD_ATTRIB_AFFINITY_CPU0, "UTheme job (core 0)"},
+    {OS_THREAD_ATTRIB_AFFINITY_CPU2, "UTheme job (core 2)"},
+};
+constexpr int WORKER_COUNT = sizeof(sCores) / sizeof(sCores[0]);
+
+} // namespace
+
+static Worker sWorkers[WORKER_COUNT];
+static bool sRunning = false;
+static std::atomic<uint32_t> sNextWorker{0};
+
+static std::mutex sWakeMutex;             // 保护 sQueued / sStop
+static std::condition_variable sWakeCv;
+static int sQueued = 0;
+static bool sStop = false;
+
+static std::atomic<int> sHeavyWork{0};    // 活动的 HeavyWorkScope 个数
+
+static std::mutex sContinuationMutex;     // 保护 sContinuations
+static std::deque<std::shared_ptr<JobSystem::JobState>> sContinuations;
+
+static void FinishJob(const std::shared_ptr<JobSystem::JobState>& job) {
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        job->work = nullptr;
+    }
+    job->doneCv.notify_all();
+}
+
+static void RunJob(const std::shared_ptr<JobSystem::JobState>& job) {
+    if (!job->token.IsCancelled()) {
+        job->work(job->token);
+    }
+    if (job->then && !job->token.IsCancelled()) {
+        std::lock_guard<std::mutex> lock(sContinuationMutex);
+        sContinuations.push_back(job);
+    }
+    FinishJob(job);
+}
+
+// 先取自己队列的任务, 没有时从其它线程的队列取
+static std::shared_ptr<JobSystem::JobState> TakeJob(int self) {
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        Worker& worker = sWorkers[(self + i) % WORKER_COUNT];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.queue.empty()) {
+            std::shared_ptr<JobSystem::JobState> job = std::move(worker.queue.front());
+            worker.queue.pop_front();
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+static void WorkerThread(int index) {
+    OSSetThreadAffinity(OSGetCurrentThread(), sCores[index].affinity);
+    OSSetThreadName(OSGetCurrentThread(), sCores[index].name);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(sWakeMutex);
+            sWakeCv.wait(lock, []() { return sStop || sQueued > 0; });
+            if (sStop) {
+                return;
+            }
+            sQueued--;
+        }
+
+        // 每个计数对应队列中的一个任务, 取到的不一定是自己队列中的 (空闲时从其它线程取)
+        std::shared_ptr<JobSystem::JobState> job = TakeJob(index);
+        if (job) {
+            RunJob(job);
+        }
+    }
+}
+
+bool JobSystem::JobHandle::IsDone() const {
+    if (!mState) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    return mState->done;
+}
+
+void JobSystem::JobHandle::Cancel() {
+    if (mState) {
+        mState->token.Cancel();
+    }
+}
+
+void JobSystem::JobHandle::Wait() {
+    if (!mState) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mState->mutex);
+    mState->doneCv.wait(lock, [this]() { return mState->done; });
+}
+
+void JobSystem::Init() {
+    if (sRunning) {
+        return;
+    }
+    sStop = false;
+    sQueued = 0;
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        sWorkers[i].thread = std::thread(WorkerThread, i);
+    }
+    sRunning = true;
+    FileLogger::GetInstance().LogInfo("[JobSystem] Started %d worker(s) on cores 0 and 2", WORKER_COUNT);
+}
+
+void JobSystem::Shutdown() {
+    if (!sRunning) {
+        return;
+    }
+    sRunning = false;
+
+    {
+        std::lock_guard<std::mutex> lock(sWakeMutex);
+        sStop = true;
+    }
+    sWakeCv.notify_all();
+    for (Worker& worker : sWorkers) {
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+    }
+
+    // 还没开始的任务不再运行, 等待它们的线程也能继续
+    int dropped = 0;
+    for (Worker& worker : sWorkers) {
+        for (auto& job : worker.queue) {
+            job->token.Cancel();
+            FinishJob(job);
+            dropped++;
+        }
+        worker.queue.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(sContinuationMutex);
+        sContinuations.clear();
+    }
+    FileLogger::GetInstance().LogInfo("[JobSystem] Stopped, %d queued job(s) dropped", dropped);
+}
+
+JobSystem::JobHandle JobSystem::Submit(Work work, Continuation then, Priority priority) {
+    auto job = std::make_shared<JobState>();
+    job->work = std::move(work);
+    job->then = std::move(then);
+
+    if (!sRunning) {
+        RunJob(job);
+        return JobHandle(job);
+    }
+
+    Worker& worker = sWorkers[sNextWorker++ % WORKER_COUNT];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (priority == PRIORITY_HIGH) {
+            worker.queue.push_front(job);
+        } else {
+            worker.queue.push_back(job);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(sWakeMutex);
+        sQueued++;
+    }
+    sWakeCv.notify_one();
+    return JobHandle(job);
+}
+
+void JobSystem::RunOnMainThread(Continuation fn) {
+    // 没有工作的任务, 直接放进续接队列
+    auto job = std::make_shared<JobState>();
+    job->then = std::move(fn);
+    job->done = true;
+    std::lock_guard<std::mutex> lock(sContinuationMutex);
+    sContinuations.push_back(std::move(job));
+}
+
+bool JobSystem::Update() {
+    std::shared_ptr<JobState> job;
+    bool more;
+    {
+        std::lock_guard<std::mutex> lock(sContinuationMutex);
+        if (sContinuations.empty()) {
+            return false;
+        }
+        job = std::move(sContinuations.front());
+        sContinuations.pop_front();
+        more = !sContinuations.empty();
+    }
+
+    if (!job->token.IsCancelled()) {
+        job->then();
+    }
+    job->then = nullptr;
+    return more;
+}
+
+int JobSystem::GetWorkerCount() {
+    return WORKER_COUNT;
+}
+
+int JobSystem::GetQueuedCount() {
+    std::lock_guard<std::mutex> lock(sWakeMutex);
+    return sQueued;
+}
+
+JobSystem::HeavyWorkScope::HeavyWorkScope() {
+    sHeavyWork.fetch_add(1, std::memory_order_relaxed);
+}
+
+JobSystem::HeavyWorkScope::~HeavyWorkScope() {
+    sHeavyWork.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool JobSystem::IsHeavyWorkActive() {
+    return sHeavyWork.load(std::memory_order_relaxed) > 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// 共享的后台任务池
+// Espresso 有 3 个核心, 主线程和 GX2 在核心 1 上, 任务线程固定在核心 0 和 2 上 (OSSetThreadAffinity)
+// 每个任务线程有自己的任务队列, 自己的队列空了就从其它线程的队列末尾取任务
+// 解码、补丁、解压这类计算用它, 不再各自创建线程; 长时间等待网络或 SD 卡的工作仍然用自己的线程
+//
+// 注意: 不要在任务中等待其它任务 (JobHandle::Wait), 任务线程都在等待时没有线程能执行被等待的任务
+class JobSystem {
+public:
+    enum Priority {
+        PRIORITY_HIGH,    // 放在队列前面, 例如正在显示的图片
+        PRIORITY_NORMAL
+    };
+
+    // 取消标记: 任务开始前取消则不运行, 运行中的任务自己检查 IsCancelled 提前结束
+    class CancelToken {
+    public:
+        CancelToken() : mFlag(std::make_shared<std::atomic<bool>>(false)) {}
+        void Cancel() const { mFlag->store(true); }
+        bool IsCancelled() const { return mFlag->load(); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> mFlag;
+    };
+
+    struct JobState;
+
+    // 任务句柄, 可以复制; 空句柄的 IsDone 为 true
+    class JobHandle {
+    public:
+        JobHandle() = default;
+
+        bool IsValid() const { return mState != nullptr; }
+        bool IsDone() const;
+        // 取消任务, 也不再执行主线程续接
+        void Cancel();
+        // 阻塞等待任务结束 (或取消后没有运行)
+        void Wait();
+
+    private:
+        friend class JobSystem;
+        explicit JobHandle(std::shared_ptr<JobState> state) : mState(std::move(state)) {}
+        std::shared_ptr<JobState> mState;
+    };
+
+    using Work = std::function<void(const CancelToken& token)>;
+    using Continuation = std::function<void()>;
+
+    // 在主线程调用 (Gfx::Init 之后), Shutdown 之后不能再提交任务
+    static void Init();
+    // 取消还没开始的任务, 等待正在运行的任务结束
+    static void Shutdown();
+
+    // 提交任务, 可以在任何线程调用; then 在任务完成后由主线程的 Update 执行 (任务被取消时不执行)
+    // Init 之前或 Shutdown 之后提交的任务直接在调用线程中运行
+    static JobHandle Submit(Work work, Continuation then = nullptr, Priority priority = PRIORITY_NORMAL);
+
+    // 在主线程的 Update 中执行 fn, 可以在任何线程调用 (不能取消)
+    static void RunOnMainThread(Continuation fn);
+
+    // 每帧在主线程调用: 执行一个完成任务的续接, 还有剩下的续接时返回 true (FrameScheduler 的工作)
+    static bool Update();
+
+    static int GetWorkerCount();
+    // 已提交、还没开始运行的任务数
+    static int GetQueuedCount();
+
+    // 占满 CPU 的长时间工作 (安装主题、解压、备份) 进行期间持有, 可以嵌套, 可以在任何线程创建
+    // 背景音乐在这期间按配置暂停解码 (MusicPlayer::Update 每帧检查 IsHeavyWorkActive)
+    class HeavyWorkScope {
+    public:
+        HeavyWorkScope();
+        ~HeavyWorkScope();
+        HeavyWorkScope(const HeavyWorkScope&) = delete;
+        HeavyWorkScope& operator=(const HeavyWorkScope&) = delete;
+    };
+    static bool IsHeavyWorkActive();
+};
+
+// 简写
+using JobHandle = JobSystem::JobHandle;
+using CancelToken = JobSystem::CancelToken;
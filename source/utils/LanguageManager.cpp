@@ -1,16 +1,13 @@
 #include "LanguageManager.hpp"
 #include "Config.hpp"
 #include "Utils.hpp"
+#include "AssetBundle.hpp"
 #include "logger.h"
+#include "../Gfx.hpp"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 
-// 包含嵌入的语言文件
-#include <zh-cn_json.h>
-#include <en-us_json.h>
-#include <ja-jp_json.h>
-
 LanguageManager* LanguageManager::mInstance = nullptr;
 
 // 简单的JSON解析器（只处理字符串值）
@@ -193,28 +190,20 @@ bool LanguageManager::Initialize() {
 bool LanguageManager::LoadLanguage(const std::string& languageCode) {
     DEBUG_FUNCTION_LINE("Loading language: %s", languageCode.c_str());
     
-    // 获取嵌入的语言数据
-    const uint8_t* langData = nullptr;
-    size_t langSize = 0;
-    
-    if (languageCode == "zh-cn") {
-        langData = zh_cn_json;
-        langSize = zh_cn_json_size;
-    } else if (languageCode == "en-us") {
-        langData = en_us_json;
-        langSize = en_us_json_size;
-    } else if (languageCode == "ja-jp") {
-        langData = ja_jp_json;
-        langSize = ja_jp_json_size;
+    // 从资源包解压语言数据, 解析完就释放
+    AssetBundle::Data langData;
+    if (languageCode == "zh-cn" || languageCode == "en-us" || languageCode == "ja-jp") {
+        langData = AssetBundle::Load(languageCode + ".json");
     }
     
-    if (!langData || langSize == 0) {
+    if (!langData || langData->empty()) {
         DEBUG_FUNCTION_LINE("Language data not found: %s", languageCode.c_str());
         return false;
     }
     
     // 转换为字符串
-    std::string content(reinterpret_cast<const char*>(langData), langSize);
+    std::string content(reinterpret_cast<const char*>(langData->data()), langData->size());
+    langData.reset();
     
     if (content.empty()) {
         DEBUG_FUNCTION_LINE("Language content is empty: %s", languageCode.c_str());
@@ -222,39 +211,78 @@ bool LanguageManager::LoadLanguage(const std::string& languageCode) {
     }
     
     // 解析JSON
-    mTexts = SimpleJsonParser::ParseFlat(content);
+    std::map<std::string, std::string> texts = SimpleJsonParser::ParseFlat(content);
     
-    if (mTexts.empty()) {
+    if (texts.empty()) {
         DEBUG_FUNCTION_LINE("Failed to parse language data: %s", languageCode.c_str());
         return false;
     }
     
+    // 建立按哈希查找的表; 两个键的哈希相同时后一个查不到, 需要改键名
+    size_t capacity = 16;
+    while (capacity < texts.size() * 2) {
+        capacity *= 2;
+    }
+    mTexts.assign(capacity, TextSlot());
+    mTextCount = texts.size();
+    mMissingKeys.clear();
+    
+    std::string allTexts;
+    for (auto& [key, text] : texts) {
+        uint32_t hash = TextKey::Hash(key.c_str());
+        size_t index = hash & (capacity - 1);
+        while (mTexts[index].used && mTexts[index].hash != hash) {
+            index = (index + 1) & (capacity - 1);
+        }
+        if (mTexts[index].used) {
+            DEBUG_FUNCTION_LINE("Language key hash collision: %s", key.c_str());
+            continue;
+        }
+        allTexts += text;
+        mTexts[index].hash = hash;
+        mTexts[index].used = true;
+        mTexts[index].text = std::move(text);
+    }
+    
     mCurrentLanguage = languageCode;
+
+    // 这个语言用到的字符在后台逐帧预先光栅化, 进入新界面时不用临时生成字形
+    Gfx::PrewarmGlyphs(allTexts);
+
     DEBUG_FUNCTION_LINE("Successfully loaded language: %s (%d texts)", 
-                       languageCode.c_str(), (int)mTexts.size());
+                       languageCode.c_str(), (int)mTextCount);
     
     // 测试几个关键键是否存在
-    DEBUG_FUNCTION_LINE("Test key 'app_name': %s", GetText("app_name").c_str());
-    DEBUG_FUNCTION_LINE("Test key 'theme_detail.by': %s", GetText("theme_detail.by").c_str());
+    DEBUG_FUNCTION_LINE("Test key 'app_name': %s", _("app_name").c_str());
+    DEBUG_FUNCTION_LINE("Test key 'theme_detail.by': %s", _("theme_detail.by").c_str());
     
     return true;
 }
 
-std::string LanguageManager::GetText(const std::string& key) const {
-    auto it = mTexts.find(key);
-    if (it != mTexts.end()) {
-        return it->second;
+const std::string& LanguageManager::GetText(TextKey key) const {
+    if (!mTexts.empty()) {
+        size_t mask = mTexts.size() - 1;
+        for (size_t index = key.hash & mask; mTexts[index].used; index = (index + 1) & mask) {
+            if (mTexts[index].hash == key.hash) {
+                return mTexts[index].text;
+            }
+        }
     }
     
     // 如果没找到，返回键本身
-    // DEBUG_FUNCTION_LINE("Language key not found: %s (total keys: %d)", key.c_str(), (int)mTexts.size());
-    return key;
+    auto it = mMissingKeys.find(key.hash);
+    if (it == mMissingKeys.end()) {
+        it = mMissingKeys.emplace(key.hash, key.key).first;
+    }
+    return it->second;
 }
 
 void LanguageManager::SetCurrentLanguage(const std::string& languageCode) {
     if (LoadLanguage(languageCode)) {
         mCurrentLanguage = languageCode;
         SaveLanguageSettings();
+        // 预渲染的文字都是旧语言的
+        Gfx::ClearStaticText();
     }
 }
 
@@ -2,6 +2,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <cstdint>
 
 class LanguageManager {
 public:
@@ -11,6 +12,23 @@ public:
         std::string filename;
     };
 
+    // 文本键: 编译时计算键的哈希 (FNV-1a), 查找时只需按哈希索引, 不构造字符串
+    // 只能用字符串常量构造; 需要在运行时选择键时使用 TextKey 数组
+    struct TextKey {
+        consteval TextKey(const char* key) : hash(Hash(key)), key(key) {}
+
+        static constexpr uint32_t Hash(const char* str) {
+            uint32_t h = 2166136261u;
+            while (*str) {
+                h = (h ^ (uint8_t)*str++) * 16777619u;
+            }
+            return h;
+        }
+
+        uint32_t hash;
+        const char* key;
+    };
+
     static LanguageManager& getInstance();
     
     // 初始化语言系统
@@ -19,8 +37,8 @@ public:
     // 加载指定语言
     bool LoadLanguage(const std::string& languageCode);
     
-    // 获取文本
-    std::string GetText(const std::string& key) const;
+    // 获取文本, 找不到时返回键本身; 返回的引用在切换语言前有效
+    const std::string& GetText(TextKey key) const;
     
     // 获取当前语言代码
     const std::string& GetCurrentLanguage() const { return mCurrentLanguage; }
@@ -47,7 +65,15 @@ private:
     void LoadSettings();
     
     std::string mCurrentLanguage = "zh-cn";
-    std::map<std::string, std::string> mTexts;
+    // 当前语言的文本, 按键的哈希开放寻址 (容量为 2 的幂, 至少是文本数的两倍)
+    struct TextSlot {
+        uint32_t hash = 0;
+        bool used = false;
+        std::string text;
+    };
+    std::vector<TextSlot> mTexts;
+    size_t mTextCount = 0;
+    mutable std::map<uint32_t, std::string> mMissingKeys;  // 找不到的键, 用于返回引用
     std::vector<LanguageInfo> mAvailableLanguages;
     
     static LanguageManager* mInstance;
@@ -55,4 +81,4 @@ private:
 
 // 便捷宏定义
 #define Lang() LanguageManager::getInstance()
-#define _(key) Lang().GetText(key)
+#define _(key) Lang().GetText(LanguageManager::TextKey(key))
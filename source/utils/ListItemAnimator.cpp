@@ -0,0 +1,133 @@
+#include "ListItemAnimator.hpp"
+#include <algorithm>
+
+void ListItemAnimator::Reset(int itemCount, int selected, bool animate) {
+    for (Slot& slot : mSlots) {
+        slot.index = -1;
+    }
+    mItemCount = itemCount;
+    mSelected = -1;
+
+    if (selected < 0 || selected >= itemCount) {
+        return;
+    }
+
+    mSelected = selected;
+    Slot& slot = Acquire(selected);
+    if (animate) {
+        slot.scaleAnim.SetTarget(mSelectedScale, mDuration);
+        slot.highlightAnim.SetTarget(1.0f, mDuration);
+    } else {
+        slot.scaleAnim.SetImmediate(mSelectedScale);
+        slot.highlightAnim.SetImmediate(1.0f);
+    }
+}
+
+void ListItemAnimator::Append(int itemCount, int selected, int first, int end) {
+    int previousCount = mItemCount;
+    if (itemCount <= previousCount) {
+        return;
+    }
+    mItemCount = itemCount;
+
+    for (int i = std::max(previousCount, first); i < std::min(itemCount, end); i++) {
+        Slot& slot = Acquire(i);
+        slot.appearAnim.Start(0.0f, 1.0f, mDuration);
+    }
+    if (mSelected < 0 && selected >= 0 && selected < itemCount) {
+        mSelected = selected;
+        Slot& slot = Acquire(selected);
+        slot.scaleAnim.SetTarget(mSelectedScale, mDuration);
+        slot.highlightAnim.SetTarget(1.0f, mDuration);
+    }
+}
+
+void ListItemAnimator::Select(int previous, int selected) {
+    if (Slot* slot = Find(previous)) {
+        slot->scaleAnim.SetTarget(1.0f, mDuration);
+        slot->highlightAnim.SetTarget(0.0f, mDuration);
+    }
+
+    mSelected = -1;
+    if (selected >= 0 && selected < mItemCount) {
+        mSelected = selected;
+        Slot& slot = Acquire(selected);
+        slot.scaleAnim.SetTarget(mSelectedScale, mDuration);
+        slot.highlightAnim.SetTarget(1.0f, mDuration);
+    }
+}
+
+void ListItemAnimator::Update(int first, int end) {
+    for (Slot& slot : mSlots) {
+        if (slot.index < 0) {
+            continue;
+        }
+
+        // 选中项一直保留; 其他看不见的项不用播完动画
+        bool selected = slot.index == mSelected;
+        if (!selected && (slot.index < first || slot.index >= end || slot.index >= mItemCount)) {
+            slot.index = -1;
+            continue;
+        }
+
+        slot.scaleAnim.Update();
+        slot.highlightAnim.Update();
+        slot.appearAnim.Update();
+        if (!selected && !slot.scaleAnim.IsAnimating() && !slot.highlightAnim.IsAnimating() &&
+            !slot.appearAnim.IsAnimating()) {
+            slot.index = -1;  // 已回到静止状态
+        }
+    }
+}
+
+float ListItemAnimator::GetScale(int index) const {
+    const Slot* slot = Find(index);
+    return slot ? slot->scaleAnim.GetValue() : 1.0f;
+}
+
+float ListItemAnimator::GetHighlight(int index) const {
+    const Slot* slot = Find(index);
+    return slot ? slot->highlightAnim.GetValue() : 0.0f;
+}
+
+float ListItemAnimator::GetAppear(int index) const {
+    const Slot* slot = Find(index);
+    return slot ? slot->appearAnim.GetValue() : 1.0f;
+}
+
+// 槽位数不超过可见项数加一, 线性查找即可
+ListItemAnimator::Slot* ListItemAnimator::Find(int index) {
+    if (index < 0) {
+        return nullptr;
+    }
+    for (Slot& slot : mSlots) {
+        if (slot.index == index) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+ListItemAnimator::Slot& ListItemAnimator::Acquire(int index) {
+    Slot* slot = Find(index);
+    if (slot) {
+        return *slot;
+    }
+
+    for (Slot& free : mSlots) {
+        if (free.index < 0) {
+            slot = &free;
+            break;
+        }
+    }
+    if (!slot) {
+        mSlots.emplace_back();
+        slot = &mSlots.back();
+    }
+
+    slot->index = index;
+    slot->scaleAnim.SetImmediate(1.0f);
+    slot->highlightAnim.SetImmediate(0.0f);
+    slot->appearAnim.SetImmediate(1.0f);
+    return *slot;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include "Animation.hpp"
+
+// 列表项的选中动画 (缩放和高亮), 只为选中项和可见范围内还在播放动画的项保留状态
+// 没有状态的项处于静止状态 (缩放 1, 高亮 0); 滚动时离开可见范围或回到静止的项归还槽位给之后的项使用
+// 所以每帧的开销只和可见项数有关, 不随列表长度增长
+class ListItemAnimator {
+public:
+    explicit ListItemAnimator(float selectedScale = 1.05f, float durationMs = 300)
+        : mSelectedScale(selectedScale), mDuration(durationMs) {}
+
+    // 列表内容改变后调用, 丢弃所有动画状态; animate 为 false 时选中项直接处于选中状态
+    void Reset(int itemCount, int selected, bool animate = true);
+
+    // 只在末尾追加了项时调用 (例如目录的页边下载边到达), 已有的动画保持不变
+    // 落在可见范围 [first, end) 内的新项从下方滑入; 原来没有选中项 (列表是空的) 时选中 selected
+    void Append(int itemCount, int selected, int first, int end);
+    int GetItemCount() const { return mItemCount; }
+
+    // 选中项改变: 原来的项恢复, 新的项放大并高亮
+    void Select(int previous, int selected);
+
+    // 每帧调用一次, [first, end) 为可见的项
+    void Update(int first, int end);
+
+    float GetScale(int index) const;
+    float GetHighlight(int index) const;
+    float GetAppear(int index) const;   // 0 刚追加, 1 已就位
+
+private:
+    struct Slot {
+        int index = -1;  // -1 表示空闲
+        Animation scaleAnim;
+        Animation highlightAnim;
+        Animation appearAnim;
+    };
+
+    Slot* Find(int index);
+    const Slot* Find(int index) const { return const_cast<ListItemAnimator*>(this)->Find(index); }
+    Slot& Acquire(int index);
+
+    std::vector<Slot> mSlots;
+    float mSelectedScale;
+    float mDuration;
+    int mItemCount = 0;
+    int mSelected = -1;
+};
@@ -0,0 +1,365 @@
+#include "LocalThemeIndex.hpp"
+#include "FileLogger.hpp"
+#include "FileIO.hpp"
+#include "FastMemory.hpp"
+#include "DiskCacheIndex.hpp"
+#include "SimpleJsonParser.hpp"
+#include "ZipExtractor.hpp"
+#include "ZipIndex.hpp"
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <strings.h>
+#include <set>
+#include <algorithm>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+static const char* INDEX_FILE = "index.txt";
+static const char* INDEX_MAGIC = "UTLI";
+static const int INDEX_VERSION = 2;     // 版本 1 多一个缩略图文件名字段
+static const char* THEME_EXTENSION = ".utheme";
+static const size_t MAX_METADATA_SIZE = 64 * 1024;
+
+// 预览图的候选, 越靠前越优先; 可以在压缩包根目录或 images/ 下
+static const char* PREVIEW_NAMES[] = {"collage_thumb", "collage", "launcher_thumb", "launcher"};
+static const char* PREVIEW_EXTENSIONS[] = {".jpg", ".jpeg", ".png", ".webp"};
+
+static std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        if (tab == std::string::npos) {
+            fields.push_back(line.substr(start));
+            break;
+        }
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    return fields;
+}
+
+// 字段中不能有制表符和换行
+static std::string CleanField(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c != '\t' && c != '\r' && c != '\n') {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static bool EndsWith(const std::string& str, const char* suffix) {
+    size_t length = strlen(suffix);
+    return str.length() >= length && strcasecmp(str.c_str() + str.length() - length, suffix) == 0;
+}
+
+// 条目作为预览图的优先级 (越小越优先), 不是预览图时返回 -1
+static int PreviewRank(const std::string& name) {
+    std::string base = name;
+    if (base.compare(0, 7, "images/") == 0) {
+        base = base.substr(7);
+    }
+    if (base.find('/') != std::string::npos) {
+        return -1;
+    }
+    for (int i = 0; i < (int)(sizeof(PREVIEW_NAMES) / sizeof(PREVIEW_NAMES[0])); i++) {
+        for (const char* ext : PREVIEW_EXTENSIONS) {
+            if (strcasecmp(base.c_str(), (std::string(PREVIEW_NAMES[i]) + ext).c_str()) == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// metadata.json: { "Metadata": { "themeID": ... } }, 也接受字段直接在根节点的格式
+static void ParseMetadata(const std::string& json, LocalThemeIndex::Entry& entry) {
+    try {
+        JsonDocument doc = SimpleJsonParser::Parse(json);
+        const JsonValue& root = doc.Root();
+        const JsonValue& node = root.has("Metadata") ? root["Metadata"] : root;
+        entry.themeID = node.has("themeID") ? std::string(node["themeID"].asString()) : "";
+        entry.themeName = node.has("themeName") ? std::string(node["themeName"].asString()) : "";
+        entry.themeAuthor = node.has("themeAuthor") ? std::string(node["themeAuthor"].asString()) : "";
+        entry.themeVersion = node.has("themeVersion") ? std::string(node["themeVersion"].asString()) : "";
+    } catch (...) {
+        FileLogger::GetInstance().LogWarning("[LocalIndex] Failed to parse metadata.json in %s", entry.fileName.c_str());
+    }
+}
+
+LocalThemeIndex::LocalThemeIndex(const std::string& themesDir, const std::string& dir)
+    : mThemesDir(themesDir), mDir(dir) {
+    if (!mDir.empty() && mDir.back() != '/') {
+        mDir += '/';
+    }
+}
+
+bool LocalThemeIndex::Load() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+    mDirty = false;
+
+    std::string indexPath = mDir + INDEX_FILE;
+    FILE* file = fopen(indexPath.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    bool loaded = false;
+    std::string line;
+    char buffer[1024];
+    bool header = true;
+    int version = 0;
+    while (fgets(buffer, sizeof(buffer), file)) {
+        line += buffer;
+        if (line.empty() || line.back() != '\n') {
+            continue; // 超长的行, 继续读
+        }
+        line.pop_back();
+
+        std::vector<std::string> fields = SplitFields(line);
+        line.clear();
+
+        if (header) {
+            header = false;
+            version = fields.size() >= 2 && fields[0] == INDEX_MAGIC ? atoi(fields[1].c_str()) : 0;
+            if (version != 1 && version != INDEX_VERSION) {
+                FileLogger::GetInstance().LogWarning("[LocalIndex] Index version mismatch, starting empty");
+                break;
+            }
+            loaded = true;
+            mDirty = version != INDEX_VERSION;
+            continue;
+        }
+
+        // fileName size mtime themeID themeName themeAuthor themeVersion
+        // previewEntry previewOffset previewCompressedSize previewSize previewCrc previewMethod
+        size_t fieldCount = version == 1 ? 14 : 13;
+        if (fields.size() != fieldCount || fields[0].empty()) {
+            continue;
+        }
+        if (version == 1 && !fields[13].empty()) {
+            // 旧版本写出的缩略图文件, 现在直接从压缩包读取
+            remove((mDir + fields[13]).c_str());
+        }
+        Entry entry;
+        entry.fileName = fields[0];
+        entry.size = strtoull(fields[1].c_str(), nullptr, 10);
+        entry.mtime = strtoll(fields[2].c_str(), nullptr, 10);
+        entry.themeID = fields[3];
+        entry.themeName = fields[4];
+        entry.themeAuthor = fields[5];
+        entry.themeVersion = fields[6];
+        entry.previewEntry = fields[7];
+        entry.previewOffset = strtoull(fields[8].c_str(), nullptr, 10);
+        entry.previewCompressedSize = (uint32_t)strtoul(fields[9].c_str(), nullptr, 10);
+        entry.previewSize = (uint32_t)strtoul(fields[10].c_str(), nullptr, 10);
+        entry.previewCrc = (uint32_t)strtoul(fields[11].c_str(), nullptr, 16);
+        entry.previewMethod = (uint16_t)atoi(fields[12].c_str());
+        mEntries[entry.fileName] = std::move(entry);
+    }
+    fclose(file);
+    FileLogger::GetInstance().LogInfo("[LocalIndex] %zu indexed theme file(s)", mEntries.size());
+    return loaded;
+}
+
+bool LocalThemeIndex::Save() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mDirty) {
+        return true;
+    }
+
+    std::string indexPath = mDir + INDEX_FILE;
+    std::string tempPath = indexPath + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[LocalIndex] Failed to write index: %s", tempPath.c_str());
+        return false;
+    }
+
+    bool ok = fprintf(file, "%s\t%d\n", INDEX_MAGIC, INDEX_VERSION) > 0;
+    for (const auto& pair : mEntries) {
+        const Entry& entry = pair.second;
+        ok = fprintf(file, "%s\t%llu\t%lld\t%s\t%s\t%s\t%s\t%s\t%llu\t%u\t%u\t%08x\t%u\n",
+                     entry.fileName.c_str(), (unsigned long long)entry.size, (long long)entry.mtime,
+                     CleanField(entry.themeID).c_str(), CleanField(entry.themeName).c_str(),
+                     CleanField(entry.themeAuthor).c_str(), CleanField(entry.themeVersion).c_str(),
+                     CleanField(entry.previewEntry).c_str(), (unsigned long long)entry.previewOffset,
+                     (unsigned)entry.previewCompressedSize, (unsigned)entry.previewSize,
+                     (unsigned)entry.previewCrc, (unsigned)entry.previewMethod) > 0 && ok;
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    remove(indexPath.c_str());
+    if (!ok || rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[LocalIndex] Failed to save index");
+        return false;
+    }
+    mDirty = false;
+    return true;
+}
+
+bool LocalThemeIndex::ReadArchive(const std::string& path, Entry& entry) {
+    ZipIndex zip;
+    if (!zip.Open(path)) {
+        FileLogger::GetInstance().LogWarning("[LocalIndex] Failed to open %s", path.c_str());
+        return false;
+    }
+
+    // 在解析好的中央目录中找出最合适的预览图
+    const ZipIndex::Entry* preview = nullptr;
+    int bestRank = INT_MAX;
+    for (const ZipIndex::Entry& zipEntry : zip.GetEntries()) {
+        int rank = PreviewRank(zipEntry.name);
+        if (rank >= 0 && rank < bestRank && zipEntry.size <= UINT32_MAX && zipEntry.compressedSize <= UINT32_MAX &&
+            (zipEntry.method == ZipIndex::METHOD_STORED || zipEntry.method == ZipIndex::METHOD_DEFLATE)) {
+            bestRank = rank;
+            preview = &zipEntry;
+        }
+    }
+
+    // 压缩数据的偏移要读过本地文件头才知道
+    FileIO file;
+    uint64_t offset = 0;
+    if (preview && file.Open(path, FileIO::MODE_READ) && zip.GetDataOffset(file, *preview, offset)) {
+        entry.previewEntry = preview->name;
+        entry.previewOffset = offset;
+        entry.previewCompressedSize = (uint32_t)preview->compressedSize;
+        entry.previewSize = (uint32_t)preview->size;
+        entry.previewCrc = preview->crc;
+        entry.previewMethod = preview->method;
+    }
+    file.Close();
+
+    const ZipIndex::Entry* metadata = zip.Find("metadata.json");
+    std::string json;
+    if (metadata && zip.Read(*metadata, json, MAX_METADATA_SIZE)) {
+        ParseMetadata(json, entry);
+    }
+    return true;
+}
+
+std::string LocalThemeIndex::GetPreviewKey(const Entry& entry) {
+    if (entry.previewEntry.empty()) {
+        return "";
+    }
+    // 由 .utheme 的文件名、大小和修改时间决定, 文件变了就是另一个键
+    char name[48];
+    std::string key = entry.fileName + "\t" + std::to_string(entry.size) + "\t" + std::to_string(entry.mtime);
+    snprintf(name, sizeof(name), "utheme:%016llx", (unsigned long long)DiskCacheIndex::Hash(key));
+    return name;
+}
+
+bool LocalThemeIndex::ReadPreview(const std::string& archivePath, const Entry& entry, std::string& data) {
+    FileIO file;
+    std::vector<uint8_t> compressed(entry.previewCompressedSize);
+    if (compressed.empty() || !file.Open(archivePath, FileIO::MODE_READ) ||
+        file.ReadAt(entry.previewOffset, compressed.data(), compressed.size()) != compressed.size()) {
+        return false;
+    }
+    file.Close();
+
+    if (entry.previewMethod == 0) {
+        data.assign((const char*)compressed.data(), compressed.size());
+    } else {
+        data.resize(entry.previewSize);
+        z_stream zs = {};
+        zs.zalloc = FastMemory::ZAlloc;
+        zs.zfree = FastMemory::ZFree;
+        if (data.empty() || inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+            return false;
+        }
+        zs.next_in = compressed.data();
+        zs.avail_in = (uInt)compressed.size();
+        zs.next_out = (Bytef*)&data[0];
+        zs.avail_out = (uInt)data.size();
+        int ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END || zs.avail_out != 0) {
+            return false;
+        }
+    }
+    if (data.size() != entry.previewSize ||
+        (uint32_t)crc32(0, (const Bytef*)data.data(), (uInt)data.size()) != entry.previewCrc) {
+        FileLogger::GetInstance().LogWarning("[LocalIndex] Preview of %s is corrupt", entry.fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LocalThemeIndex::Refresh() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    DIR* dir = opendir(mThemesDir.c_str());
+    if (!dir) {
+        FileLogger::GetInstance().LogError("[LocalIndex] Failed to open directory: %s", mThemesDir.c_str());
+        return false;
+    }
+    std::set<std::string> created;
+    ZipExtractor::EnsureDirectory(mDir.substr(0, mDir.length() - 1), created);
+
+    bool changed = false;
+    int opened = 0;
+    std::set<std::string> seen;
+    struct dirent* dirEntry;
+    while ((dirEntry = readdir(dir)) != nullptr) {
+        if (dirEntry->d_type != DT_REG && dirEntry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+        std::string fileName = dirEntry->d_name;
+        if (!EndsWith(fileName, THEME_EXTENSION)) {
+            continue;
+        }
+        std::string fullPath = mThemesDir + "/" + fileName;
+        struct stat st;
+        if (stat(fullPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        seen.insert(fileName);
+
+        auto it = mEntries.find(fileName);
+        if (it != mEntries.end() && it->second.size == (uint64_t)st.st_size && it->second.mtime == (int64_t)st.st_mtime) {
+            continue;
+        }
+
+        // 打不开的文件也记下来, 文件不变就不再尝试
+        Entry entry;
+        entry.fileName = fileName;
+        entry.size = (uint64_t)st.st_size;
+        entry.mtime = (int64_t)st.st_mtime;
+        ReadArchive(fullPath, entry);
+        opened++;
+        mEntries[fileName] = std::move(entry);
+        changed = true;
+    }
+    closedir(dir);
+
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (seen.count(it->first)) {
+            ++it;
+            continue;
+        }
+        it = mEntries.erase(it);
+        changed = true;
+    }
+
+    mDirty = mDirty || changed;
+    FileLogger::GetInstance().LogInfo("[LocalIndex] %zu theme file(s), %d read from archive", mEntries.size(), opened);
+    return changed;
+}
+
+std::vector<LocalThemeIndex::Entry> LocalThemeIndex::GetEntries() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<Entry> entries;
+    entries.reserve(mEntries.size());
+    for (const auto& pair : mEntries) {
+        entries.push_back(pair.second);
+    }
+    return entries;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+// 本地 .utheme 文件的索引: 以 (文件名, 大小, 修改时间) 为键, 记录压缩包里 metadata.json 的内容
+// 和预览图条目的位置, 保存在 index.txt 中
+// 打开界面时先用 Load 读入的索引显示, 再由 Refresh 在后台扫描目录, 只打开新增或改变了的文件
+// 预览图按记录的偏移直接从压缩包读出 (不用再解析中央目录), 由 ImageLoader 在解码线程中解压解码,
+// 缩小后的像素按压缩包指纹 (文件名、大小、修改时间) 保存在 ImageLoader 的像素缓存中, 不写出中间文件
+class LocalThemeIndex {
+public:
+    struct Entry {
+        std::string fileName;      // 主题目录中的 .utheme 文件名
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        // metadata.json 的内容 (没有时为空)
+        std::string themeID;
+        std::string themeName;
+        std::string themeAuthor;
+        std::string themeVersion;
+        // 预览图条目 (previewEntry 为空表示没有)
+        std::string previewEntry;
+        uint64_t previewOffset = 0;     // 压缩数据在 .utheme 中的偏移
+        uint32_t previewCompressedSize = 0;
+        uint32_t previewSize = 0;
+        uint32_t previewCrc = 0;
+        uint16_t previewMethod = 0;     // 0 = stored, 8 = deflate
+    };
+
+    // themesDir: 扫描 .utheme 的目录; dir: 索引和缩略图所在的目录
+    LocalThemeIndex(const std::string& themesDir, const std::string& dir);
+
+    // 读入上次保存的索引 (不访问 .utheme 文件)
+    bool Load();
+    // 有改动时写回索引 (先写临时文件再改名)
+    bool Save();
+
+    // 扫描目录: 删除不存在的文件, 读取新增或改变了的文件
+    // 返回 true 表示条目有变化
+    bool Refresh();
+
+    // 按文件名排序的条目
+    std::vector<Entry> GetEntries();
+    // 预览图的缓存键 (压缩包指纹), 文件变了就是另一个键; 条目没有预览图时为空
+    static std::string GetPreviewKey(const Entry& entry);
+    // 读出并解压预览图条目, 校验 CRC32 (可以在任意线程调用)
+    static bool ReadPreview(const std::string& archivePath, const Entry& entry, std::string& data);
+
+private:
+    std::string mThemesDir;     // 不以 '/' 结尾
+    std::string mDir;           // 以 '/' 结尾
+    std::map<std::string, Entry> mEntries;  // 文件名 -> 条目
+    bool mDirty = false;
+    std::mutex mMutex;
+
+    static bool ReadArchive(const std::string& path, Entry& entry);
+};
@@ -0,0 +1,134 @@
+#include "MemoryPressure.hpp"
+#include "FileLogger.hpp"
+#include <coreinit/memexpheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/time.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+struct Listener {
+    int id;
+    int order;
+    std::string name;
+    MemoryPressure::Handler handler;
+};
+
+static std::vector<Listener> sListeners;   // 按 order 排序, 相同时按添加顺序
+static int sNextId = 1;
+static std::atomic<int> sPendingLevel{MemoryPressure::LEVEL_NONE};
+static std::atomic<const char*> sPendingReason{nullptr};
+static uint64_t sNextCheckMs = 0;
+static uint64_t sLastLowReleaseMs = 0;
+static bool sReleasing = false;
+static uint32_t sReleaseCount = 0;
+
+static uint64_t NowMs() {
+    return OSTicksToMilliseconds(OSGetSystemTime());
+}
+
+static size_t GetMem2Free() {
+    return MEMGetTotalFreeSizeForExpHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2));
+}
+
+// 分配失败的线程可能是任何线程: 只记下来, 然后和默认行为一样抛出异常
+static void OnNewFailed() {
+    MemoryPressure::Signal(MemoryPressure::LEVEL_CRITICAL, "operator new");
+    throw std::bad_alloc();
+}
+
+void MemoryPressure::Init() {
+    std::set_new_handler(OnNewFailed);
+}
+
+void MemoryPressure::Shutdown() {
+    std::set_new_handler(nullptr);
+    sListeners.clear();
+}
+
+int MemoryPressure::AddListener(const char* name, int order, Handler handler) {
+    int id = sNextId++;
+    auto pos = std::upper_bound(sListeners.begin(), sListeners.end(), order,
+                                [](int value, const Listener& listener) { return value < listener.order; });
+    sListeners.insert(pos, Listener{id, order, name, std::move(handler)});
+    return id;
+}
+
+void MemoryPressure::RemoveListener(int id) {
+    sListeners.erase(std::remove_if(sListeners.begin(), sListeners.end(),
+                                    [id](const Listener& listener) { return listener.id == id; }),
+                     sListeners.end());
+}
+
+void MemoryPressure::Signal(Level level, const char* reason) {
+    // 只用原子变量: 可能在分配函数里 (持有堆的锁) 调用
+    int current = sPendingLevel.load(std::memory_order_relaxed);
+    while (current < level && !sPendingLevel.compare_exchange_weak(current, level, std::memory_order_relaxed)) {
+    }
+    sPendingReason.store(reason, std::memory_order_relaxed);
+}
+
+size_t MemoryPressure::Release(Level level, size_t bytes, const char* reason, int beforeOrder) {
+    // 释放函数中再次失败 (例如重新创建纹理) 时不重入
+    if (sReleasing || level == LEVEL_NONE) {
+        return 0;
+    }
+    sReleasing = true;
+    OSTime start = OSGetSystemTime();
+    size_t before = GetMem2Free();
+    size_t freed = 0;
+    int called = 0;
+    // 释放函数中可能增删监听者, 按副本通知
+    std::vector<Listener> listeners = sListeners;
+    for (const Listener& listener : listeners) {
+        if (listener.order >= beforeOrder || (level == LEVEL_LOW && bytes > 0 && freed >= bytes)) {
+            break;
+        }
+        size_t released = listener.handler(level);
+        called++;
+        if (released > 0) {
+            FileLogger::GetInstance().LogDebug("[MemoryPressure] %s released %zu KB", listener.name.c_str(),
+                                               released / 1024);
+        }
+        freed += released;
+    }
+    sReleasing = false;
+    sReleaseCount++;
+    if (level == LEVEL_LOW) {
+        sLastLowReleaseMs = NowMs();
+    }
+    FileLogger::GetInstance().LogWarning("[MemoryPressure] %s (%s): %d listeners released %zu KB, "
+                                         "MEM2 free %zu -> %zu KB in %llu ms",
+                                         level == LEVEL_CRITICAL ? "critical" : "low", reason ? reason : "?",
+                                         called, freed / 1024, before / 1024, GetMem2Free() / 1024,
+                                         (unsigned long long)OSTicksToMilliseconds(OSGetSystemTime() - start));
+    return freed;
+}
+
+bool MemoryPressure::Update() {
+    Level level = (Level)sPendingLevel.exchange(LEVEL_NONE, std::memory_order_relaxed);
+    const char* reason = sPendingReason.exchange(nullptr, std::memory_order_relaxed);
+
+    uint64_t now = NowMs();
+    if (level == LEVEL_NONE && now >= sNextCheckMs) {
+        sNextCheckMs = now + CHECK_INTERVAL_MS;
+        if (GetMem2Free() < LOW_MEM2_BYTES) {
+            level = LEVEL_LOW;
+            reason = "MEM2 below watermark";
+        }
+    }
+    // 水位附近时不要每次检查都清空缓存; 分配失败时总是处理
+    if (level == LEVEL_LOW && sReleaseCount > 0 && now - sLastLowReleaseMs < LOW_COOLDOWN_MS) {
+        return false;
+    }
+    if (level != LEVEL_NONE) {
+        Release(level, 0, reason);
+    }
+    return false;
+}
+
+uint32_t MemoryPressure::GetReleaseCount() {
+    return sReleaseCount;
+}
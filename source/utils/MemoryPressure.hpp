@@ -0,0 +1,56 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// 内存不足的通知: 各子系统登记释放函数, 内存紧张时按顺序丢弃可以重建的状态
+// (不在显示的纹理、被盖住的界面的卡片纹理、预读的目录、文字缓存等), 避免长时间浏览之后分配失败
+// 触发来源: MEM2 剩余低于 LOW_MEM2_BYTES (每 CHECK_INTERVAL_MS 检查一次)、默认堆或 operator new 分配失败
+// (Signal, 可以在任何线程调用, 不分配内存, 在下一帧的 Update 中处理)、纹理创建失败 (Release, 在主线程直接处理)
+// 释放函数按 order 从小到大调用 (先丢重建代价小的), LEVEL_LOW 时释放够了就停下, LEVEL_CRITICAL 时全部调用
+// 释放函数只在主线程调用, 不能等待其它线程
+class MemoryPressure {
+public:
+    enum Level {
+        LEVEL_NONE = 0,
+        LEVEL_LOW,        // 剩余内存低于水位, 只丢弃当前用不到的
+        LEVEL_CRITICAL    // 已经有分配失败, 丢弃所有能重建的
+    };
+
+    // 释放顺序
+    enum Order {
+        ORDER_HIDDEN = 0,     // 被盖住的界面、预读但还没使用的数据
+        ORDER_CACHE = 10,     // 不在显示的图片
+        ORDER_TEXT = 20       // 文字的纹理和排版缓存 (下一帧就要重建可见的部分)
+    };
+
+    static constexpr size_t LOW_MEM2_BYTES = 24 * 1024 * 1024;
+    static constexpr uint64_t CHECK_INTERVAL_MS = 500;
+    static constexpr uint64_t LOW_COOLDOWN_MS = 5000;   // LEVEL_LOW 两次释放之间至少间隔这么久
+
+    // 返回释放的字节数 (估算)
+    using Handler = std::function<size_t(Level level)>;
+
+    // 安装 operator new 失败的处理函数; AppLifecycle::Init 之后调用
+    static void Init();
+    static void Shutdown();
+
+    // 返回的编号交给 RemoveListener; 只在主线程调用
+    static int AddListener(const char* name, int order, Handler handler);
+    static void RemoveListener(int id);
+
+    // 记下内存不足, 下一次 Update 时释放; reason 必须是字符串常量
+    static void Signal(Level level, const char* reason);
+
+    // 在主线程立即释放, bytes 为 0 时按级别全部调用; 返回释放的字节数
+    // 只调用 order 小于 beforeOrder 的释放函数: 调用者还持有某类缓存的引用时 (例如正在排版的文字)
+    // 不能在这里销毁它, 留给下一帧的 Update
+    static size_t Release(Level level, size_t bytes, const char* reason, int beforeOrder = INT_MAX);
+
+    // 每帧在主线程调用 (FrameScheduler 的工作): 检查 MEM2 水位, 处理 Signal
+    static bool Update();
+
+    static uint32_t GetReleaseCount();
+};
@@ -0,0 +1,228 @@
+#include "MenuSourceCache.hpp"
+#include "FileLogger.hpp"
+#include "hips.hpp"
+#include "FileIO.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <dirent.h>
+
+static const char* INDEX_FILE = "sources.txt";
+static const char* INDEX_MAGIC = "UTMS";
+static const int INDEX_VERSION = 1;
+
+static std::string BaseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+MenuSourceCache::MenuSourceCache(const std::string& dir, const std::string& titlePath)
+    : mDir(dir), mTitlePath(titlePath) {
+}
+
+uint32_t MenuSourceCache::ReadTitleVersion(const std::string& titlePath) {
+    // meta.xml 中的 <title_version type="unsignedInt" length="4">N</title_version>
+    std::string metaPath = titlePath + "meta/meta.xml";
+    FILE* file = fopen(metaPath.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+    std::string content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, n);
+    }
+    fclose(file);
+
+    size_t tag = content.find("<title_version");
+    if (tag == std::string::npos) {
+        return 0;
+    }
+    size_t close = content.find('>', tag);
+    if (close == std::string::npos) {
+        return 0;
+    }
+    return (uint32_t)strtoul(content.c_str() + close + 1, nullptr, 10);
+}
+
+void MenuSourceCache::RemoveAllFiles() {
+    DIR* dir = opendir(mDir.c_str());
+    if (!dir) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        remove((mDir + entry->d_name).c_str());
+    }
+    closedir(dir);
+}
+
+bool MenuSourceCache::Load() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+    mDirty = false;
+    mTitleVersion = ReadTitleVersion(mTitlePath);
+
+    std::string indexPath = mDir + INDEX_FILE;
+    FILE* file = fopen(indexPath.c_str(), "r");
+    bool valid = false;
+    if (file) {
+        char line[512];
+        if (fgets(line, sizeof(line), file)) {
+            char magic[8] = {0};
+            int version = 0;
+            unsigned long titleVersion = 0;
+            valid = sscanf(line, "%7s %d %lu", magic, &version, &titleVersion) == 3 &&
+                    strcmp(magic, INDEX_MAGIC) == 0 && version == INDEX_VERSION &&
+                    titleVersion == mTitleVersion;
+        }
+        while (valid && fgets(line, sizeof(line), file)) {
+            // name size mtime crc
+            char name[256];
+            unsigned long long size = 0;
+            long long mtime = 0;
+            unsigned long crc = 0;
+            if (sscanf(line, "%255s %llu %lld %lx", name, &size, &mtime, &crc) != 4) {
+                continue;
+            }
+            Entry entry;
+            entry.size = size;
+            entry.mtime = mtime;
+            entry.crc = (uint32_t)crc;
+            mEntries[name] = entry;
+        }
+        fclose(file);
+    }
+
+    if (!valid) {
+        // 第一次使用、格式变化或系统菜单已更新: 旧副本全部作废
+        if (file) {
+            FileLogger::GetInstance().LogInfo("[MenuCache] System menu changed (title version %u), clearing cache", mTitleVersion);
+        }
+        RemoveAllFiles();
+        mDirty = true;
+    }
+    FileLogger::GetInstance().LogInfo("[MenuCache] %zu cached source file(s)", mEntries.size());
+    return valid;
+}
+
+bool MenuSourceCache::Save() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mDirty) {
+        return true;
+    }
+
+    std::string indexPath = mDir + INDEX_FILE;
+    std::string tempPath = indexPath + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[MenuCache] Failed to write index: %s", tempPath.c_str());
+        return false;
+    }
+    bool ok = fprintf(file, "%s %d %u\n", INDEX_MAGIC, INDEX_VERSION, mTitleVersion) > 0;
+    for (const auto& pair : mEntries) {
+        ok = ok && fprintf(file, "%s %llu %lld %08x\n", pair.first.c_str(),
+                           (unsigned long long)pair.second.size, (long long)pair.second.mtime,
+                           (unsigned)pair.second.crc) > 0;
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    remove(indexPath.c_str());
+    if (!ok || rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[MenuCache] Failed to save index");
+        return false;
+    }
+    mDirty = false;
+    return true;
+}
+
+bool MenuSourceCache::CopyWithCrc(const std::string& sourcePath, const std::string& destPath, uint64_t& size, uint32_t& crc) {
+    FileIO in;
+    if (!in.Open(sourcePath, FileIO::MODE_READ)) {
+        return false;
+    }
+    std::string tempPath = destPath + ".tmp";
+    FileIO out;
+    if (!out.Open(tempPath, FileIO::MODE_WRITE)) {
+        return false;
+    }
+
+    // 分块复制, CRC32 在数据刚读入时顺便计算
+    FileIO::Buffer buffer(FileIO::CHUNK_SIZE);
+    uint64_t expected = in.Size();
+    bool ok = buffer.size() > 0;
+    size = 0;
+    crc = 0;
+    size_t n;
+    while (ok && (n = in.Read(buffer.data(), buffer.size())) > 0) {
+        crc = Hips::Detail::crc32(buffer.data(), n, crc);
+        if (!out.Write(buffer.data(), n)) {
+            ok = false;
+            break;
+        }
+        size += n;
+    }
+    ok = ok && size == expected;
+    in.Close();
+    ok = out.Close() && ok;
+
+    remove(destPath.c_str());
+    if (!ok || rename(tempPath.c_str(), destPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string MenuSourceCache::Acquire(const std::string& originalPath, uint32_t& crc, bool& crcKnown) {
+    crcKnown = false;
+
+    struct stat original;
+    if (stat(originalPath.c_str(), &original) != 0) {
+        return originalPath;
+    }
+
+    std::string name = BaseName(originalPath);
+    std::string cachedPath = mDir + name;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(name);
+        if (it != mEntries.end()) {
+            struct stat cached;
+            if (it->second.size == (uint64_t)original.st_size && it->second.mtime == (int64_t)original.st_mtime &&
+                stat(cachedPath.c_str(), &cached) == 0 && (uint64_t)cached.st_size == it->second.size) {
+                crc = it->second.crc;
+                crcKnown = true;
+                return cachedPath;
+            }
+            // 原文件变了或副本丢失
+            mEntries.erase(it);
+            mDirty = true;
+        }
+    }
+
+    Entry entry;
+    if (!CopyWithCrc(originalPath, cachedPath, entry.size, entry.crc) || entry.size != (uint64_t)original.st_size) {
+        FileLogger::GetInstance().LogWarning("[MenuCache] Failed to cache %s, reading it from the system", name.c_str());
+        remove(cachedPath.c_str());
+        return originalPath;
+    }
+    entry.mtime = (int64_t)original.st_mtime;
+    FileLogger::GetInstance().LogInfo("[MenuCache] Cached %s (%llu bytes, crc %08x)",
+        name.c_str(), (unsigned long long)entry.size, (unsigned)entry.crc);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEntries[name] = entry;
+        mDirty = true;
+    }
+    crc = entry.crc;
+    crcKnown = true;
+    return cachedPath;
+}
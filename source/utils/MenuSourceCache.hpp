@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+// 系统菜单原始文件 (.pack / .bfsar) 在 SD 卡上的副本, 安装主题时从这里读取而不是从 MLC 读取
+// 每个副本记录原文件的大小、修改时间和内容的 CRC32 (复制时顺便算出, 只算一次)
+// 原文件的大小或修改时间变化时重新复制; 系统菜单 title 版本变化 (系统更新) 时整个缓存作废
+// Acquire 可以在多个线程同时调用 (同一个文件不能同时 Acquire)
+class MenuSourceCache {
+public:
+    // dir: 缓存目录 (以 '/' 结尾); titlePath: 系统菜单 title 目录 (以 '/' 结尾, 包含 content/ 和 meta/)
+    MenuSourceCache(const std::string& dir, const std::string& titlePath);
+
+    // 读入索引, title 版本不一致时清空缓存
+    bool Load();
+    // 有改动时写回索引 (先写临时文件再改名)
+    bool Save();
+
+    // 返回读取 originalPath 时应该使用的路径: 缓存的副本, 复制失败时为原文件
+    // 使用副本时 crcKnown 为 true, crc 为文件内容的 CRC32
+    std::string Acquire(const std::string& originalPath, uint32_t& crc, bool& crcKnown);
+
+private:
+    struct Entry {
+        uint64_t size = 0;    // 原文件的大小和修改时间 (判断原文件是否变化)
+        int64_t mtime = 0;
+        uint32_t crc = 0;
+    };
+
+    std::string mDir;
+    std::string mTitlePath;
+    uint32_t mTitleVersion = 0;
+    std::mutex mMutex;
+    std::map<std::string, Entry> mEntries;  // 文件名 -> 条目
+    bool mDirty = false;
+
+    bool CopyWithCrc(const std::string& sourcePath, const std::string& destPath, uint64_t& size, uint32_t& crc);
+    void RemoveAllFiles();
+    static uint32_t ReadTitleVersion(const std::string& titlePath);
+};
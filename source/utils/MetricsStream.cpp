@@ -0,0 +1,108 @@
+#include "MetricsStream.hpp"
+#include "Config.hpp"
+#include "DownloadQueue.hpp"
+#include "FastMemory.hpp"
+#include "FileLogger.hpp"
+#include "ImageLoader.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "TextureRegistry.hpp"
+#include <coreinit/memexpheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static int sSocket = -1;
+static struct sockaddr_in sTarget;
+static uint64_t sNextSendMs = 0;
+static uint32_t sLastFrames = 0;
+static uint32_t sSequence = 0;
+
+static uint64_t NowMs() {
+    return OSTicksToMilliseconds(OSGetSystemTime());
+}
+
+void MetricsStream::Init() {
+    if (!Config::GetInstance().IsMetricsStreamEnabled()) {
+        return;
+    }
+    sSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sSocket < 0) {
+        FileLogger::GetInstance().LogWarning("[Metrics] Failed to create UDP socket");
+        return;
+    }
+    int broadcast = 1;
+    setsockopt(sSocket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+    memset(&sTarget, 0, sizeof(sTarget));
+    sTarget.sin_family = AF_INET;
+    sTarget.sin_port = htons(PORT);
+    sTarget.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    sNextSendMs = NowMs() + INTERVAL_MS;
+    FileLogger::GetInstance().LogInfo("[Metrics] Broadcasting metrics on UDP port %u", (unsigned)PORT);
+}
+
+void MetricsStream::Shutdown() {
+    if (sSocket >= 0) {
+        close(sSocket);
+        sSocket = -1;
+    }
+}
+
+bool MetricsStream::Update() {
+    if (sSocket < 0) {
+        return false;
+    }
+    uint64_t now = NowMs();
+    if (now < sNextSendMs) {
+        return false;
+    }
+    // 落后很多时 (进入后台、长时间的加载) 不补发
+    sNextSendMs = std::max(sNextSendMs + INTERVAL_MS, now);
+
+    Profiler::Summary frame = Profiler::GetSummary();
+    uint32_t frames = frame.totalFrames - sLastFrames;
+    sLastFrames = frame.totalFrames;
+
+    NetworkStats net;
+    if (DownloadQueue::GetInstance()) {
+        net = DownloadQueue::GetInstance()->GetStats();
+    }
+    ImageLoader::Stats images = ImageLoader::GetStats();
+    size_t mem2Free = MEMGetTotalFreeSizeForExpHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2));
+
+    char line[1024];
+    int len = snprintf(line, sizeof(line),
+        "{\"seq\":%u,\"ms\":%llu,"
+        "\"frame\":{\"count\":%u,\"p50\":%.2f,\"p95\":%.2f,\"p99\":%.2f,\"update\":%.2f,\"draw\":%.2f,"
+        "\"images\":%.2f,\"net\":%.2f,\"music\":%.2f,\"render\":%.2f,\"drawCalls\":%.0f},"
+        "\"queues\":{\"jobs\":%d,\"decode\":%zu,\"pending\":%zu,\"downloads\":%zu,\"active\":%d},"
+        "\"net\":{\"bps\":%.0f,\"p50\":%.1f,\"ttfb\":%.1f,\"failRate\":%.3f,\"limit\":%d,"
+        "\"completed\":%u,\"failed\":%u,\"retries\":%u,\"expired\":%u,\"bytes\":%llu},"
+        "\"images\":{\"requests\":%llu,\"memory\":%llu,\"coalesced\":%llu,\"pixel\":%llu,\"disk\":%llu,"
+        "\"downloads\":%llu,\"evictions\":%llu,\"hitRate\":%.3f},"
+        "\"memory\":{\"mem2Free\":%zu,\"mem1Used\":%zu,\"mem1Capacity\":%zu,\"textures\":%zu,\"textureCache\":%zu}}\n",
+        sSequence++, (unsigned long long)now,
+        frames, frame.p50Ms, frame.p95Ms, frame.p99Ms,
+        frame.sectionAvgMs[Profiler::SECTION_UPDATE], frame.sectionAvgMs[Profiler::SECTION_DRAW],
+        frame.sectionAvgMs[Profiler::SECTION_IMAGE_LOADER], frame.sectionAvgMs[Profiler::SECTION_DOWNLOAD_QUEUE],
+        frame.sectionAvgMs[Profiler::SECTION_MUSIC], frame.sectionAvgMs[Profiler::SECTION_RENDER], frame.drawCallsAvg,
+        JobSystem::GetQueuedCount(), ImageLoader::GetQueueSize(), ImageLoader::GetPendingCount(), net.queued, net.active,
+        net.bytesPerSec, net.latencyP50Ms, net.ttfbP50Ms, net.failureRate, net.parallelLimit,
+        net.totalCompleted, net.totalFailed, net.totalRetries, net.totalExpired, (unsigned long long)net.totalBytes,
+        (unsigned long long)images.Requests(), (unsigned long long)images.memoryHits, (unsigned long long)images.coalesced,
+        (unsigned long long)images.pixelCacheHits, (unsigned long long)images.diskHits,
+        (unsigned long long)images.downloads, (unsigned long long)images.evictions, images.HitRate(),
+        mem2Free, FastMemory::GetUsed(), FastMemory::GetCapacity(), TextureRegistry::GetTotalBytes(),
+        ImageLoader::GetCacheBytes());
+    if (len <= 0 || len >= (int)sizeof(line)) {
+        return false;
+    }
+    // 丢包或没有接收者都无所谓, 不重试
+    sendto(sSocket, line, len, 0, (struct sockaddr*)&sTarget, sizeof(sTarget));
+    return false;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// 远程性能分析: 每秒一次把帧时间、队列长度、网络吞吐、图片缓存命中和内存用量作为一行 JSON 用 UDP 广播出去
+// 电脑上在 PORT 端口接收 (例如 nc -ul 4406), 不写 SD 卡, 不影响被测量的 I/O
+// 只在配置文件中 metrics=1 时打开; 累计计数原样发送, 速率由接收方按相邻两行相减
+class MetricsStream {
+public:
+    static constexpr uint16_t PORT = 4406;          // WHBLogUdp 的文字日志用 4405
+    static constexpr uint32_t INTERVAL_MS = 1000;
+
+    // Config 加载之后调用, 没有打开时什么都不做
+    static void Init();
+    static void Shutdown();
+
+    // 每帧在主线程调用 (FrameScheduler 的工作), 到时间时发送一行
+    static bool Update();
+};
@@ -1,9 +1,14 @@
 #include "MusicPlayer.hpp"
 #include "Config.hpp"
 #include "FileLogger.hpp"
+#include "AppLifecycle.hpp"
+#include "MusicStream.hpp"
+#include "JobSystem.hpp"
 #include <SDL2/SDL.h>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
+#include <vector>
 
 MusicPlayer::MusicPlayer() 
     : mMusic(nullptr)
@@ -11,7 +16,15 @@ MusicPlayer::MusicPlayer()
     , mEnabled(true)
     , mInitialized(false)
     , mWasEnabled(true)
-    , mCurrentFilePath("") {
+    , mPausedForBackground(false)
+    , mPausedForWork(false)
+    , mWorkFade(1.0f)
+    , mFadeTick(0)
+    , mLifecycleListener(0)
+    , mCurrentFilePath("")
+    , mLoadGeneration(0)
+    , mLoadDone(false)
+    , mLoadedMusic(nullptr) {
 }
 
 MusicPlayer::~MusicPlayer() {
@@ -49,6 +62,18 @@ bool MusicPlayer::Init() {
     Mix_AllocateChannels(16);
     
     mInitialized = true;
+    // 进入后台时暂停正在播放的音乐, 回到前台时从原来的位置继续
+    mLifecycleListener = AppLifecycle::AddListener("MusicPlayer", [this]() {
+        mPausedForBackground = IsPlaying();
+        if (mPausedForBackground) {
+            Pause();
+        }
+    }, [this]() {
+        if (mPausedForBackground) {
+            mPausedForBackground = false;
+            Resume();
+        }
+    });
     FileLogger::GetInstance().LogInfo("MusicPlayer: Initialized successfully");
     return true;
 }
@@ -60,8 +85,26 @@ void MusicPlayer::Shutdown() {
     
     FileLogger::GetInstance().LogInfo("MusicPlayer: Shutting down...");
     
+    AppLifecycle::RemoveListener(mLifecycleListener);
+    mLifecycleListener = 0;
     Stop();
     
+    {
+        std::lock_guard<std::mutex> loaderLock(mLoaderMutex);
+        if (mLoader.joinable()) {
+            mLoader.join();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLoadMutex);
+        if (mLoadedMusic) {
+            Mix_FreeMusic(mLoadedMusic);
+            mLoadedMusic = nullptr;
+        }
+        mLoadDone = false;
+        mLoadCallback = nullptr;
+    }
+    
     if (mMusic) {
         Mix_FreeMusic(mMusic);
         mMusic = nullptr;
@@ -73,35 +116,73 @@ void MusicPlayer::Shutdown() {
     FileLogger::GetInstance().LogInfo("MusicPlayer: Shutdown complete");
 }
 
-bool MusicPlayer::LoadMusic(const std::string& filepath) {
+bool MusicPlayer::LoadMusic(const std::string& filepath, LoadCallback callback) {
     if (!mInitialized) {
         FileLogger::GetInstance().LogError("MusicPlayer: Not initialized");
         return false;
     }
     
+    FILE* file = fopen(filepath.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    fclose(file);
+    
     FileLogger::GetInstance().LogInfo("MusicPlayer: Loading music from %s", filepath.c_str());
     
-    // 释放之前的音乐
-    if (mMusic) {
-        Mix_FreeMusic(mMusic);
-        mMusic = nullptr;
+    std::lock_guard<std::mutex> loaderLock(mLoaderMutex);
+    // 上一次加载还没结束时等它结束 (只是探测格式, 很快); 它的结果会被丢弃
+    if (mLoader.joinable()) {
+        mLoader.join();
     }
     
-    // 加载新音乐
-    mMusic = Mix_LoadMUS(filepath.c_str());
-    if (!mMusic) {
-        FileLogger::GetInstance().LogError("MusicPlayer: Failed to load music: %s", Mix_GetError());
-        mCurrentFilePath = "";
-        return false;
+    unsigned generation;
+    {
+        std::lock_guard<std::mutex> lock(mLoadMutex);
+        generation = ++mLoadGeneration;
+        if (mLoadedMusic) {
+            Mix_FreeMusic(mLoadedMusic);
+            mLoadedMusic = nullptr;
+        }
+        mLoadDone = false;
+        mLoadCallback = callback;
     }
     
-    // 保存文件路径
-    mCurrentFilePath = filepath;
-    
-    FileLogger::GetInstance().LogInfo("MusicPlayer: Music loaded successfully");
+    mLoader = std::thread(&MusicPlayer::LoadThread, this, filepath, generation);
     return true;
 }
 
+void MusicPlayer::LoadThread(std::string filepath, unsigned generation) {
+    Mix_Music* music = nullptr;
+    SDL_RWops* rw = MusicStream::Open(filepath);
+    if (rw) {
+        // freesrc = 1: 释放音乐 (或加载失败) 时关闭流
+        music = Mix_LoadMUS_RW(rw, 1);
+    }
+    if (!music) {
+        FileLogger::GetInstance().LogError("MusicPlayer: Failed to load music: %s", rw ? Mix_GetError() : filepath.c_str());
+    }
+    
+    std::string title;
+    std::string artist;
+    if (music) {
+        ReadTrackInfo(filepath, title, artist);
+    }
+    
+    std::lock_guard<std::mutex> lock(mLoadMutex);
+    if (generation != mLoadGeneration) {
+        if (music) {
+            Mix_FreeMusic(music);
+        }
+        return;
+    }
+    mLoadDone = true;
+    mLoadedMusic = music;
+    mLoadedPath = filepath;
+    mLoadedTitle = title;
+    mLoadedArtist = artist;
+}
+
 void MusicPlayer::Play() {
     if (!mInitialized || !mMusic || !mEnabled) {
         return;
@@ -110,7 +191,7 @@ void MusicPlayer::Play() {
     if (!IsPlaying()) {
         FileLogger::GetInstance().LogInfo("MusicPlayer: Starting music playback");
         Mix_PlayMusic(mMusic, -1);  // -1 = 循环播放
-        Mix_VolumeMusic(mVolume);
+        ApplyVolume();
     }
 }
 
@@ -150,7 +231,53 @@ void MusicPlayer::SetVolume(int volume) {
     mVolume = volume;
     
     if (mInitialized) {
-        Mix_VolumeMusic(mVolume);
+        ApplyVolume();
+    }
+}
+
+void MusicPlayer::ApplyVolume() {
+    Mix_VolumeMusic((int)(mVolume * mWorkFade));
+}
+
+void MusicPlayer::UpdateWorkPause() {
+    Config::BgmWorkMode mode = Config::GetInstance().GetBgmWorkMode();
+    bool busy = mode != Config::BGM_WORK_PLAY && JobSystem::IsHeavyWorkActive();
+    uint32_t now = SDL_GetTicks();
+    uint32_t elapsed = now - mFadeTick;
+    mFadeTick = now;
+    // 不淡出时一帧就降到 0
+    float step = mode == Config::BGM_WORK_FADE ? (float)elapsed / WORK_FADE_MS : 1.0f;
+    
+    if (busy) {
+        // 没有在播放 (已关闭、进入后台时暂停) 时不用管
+        if (mPausedForWork || !IsPlaying()) {
+            return;
+        }
+        mWorkFade = std::max(0.0f, mWorkFade - step);
+        if (mWorkFade <= 0.0f) {
+            // 暂停后混音器不再解码, 把 CPU 留给工作线程
+            FileLogger::GetInstance().LogInfo("MusicPlayer: Pausing music during heavy work");
+            Mix_PauseMusic();
+            mPausedForWork = true;
+        }
+        ApplyVolume();
+        return;
+    }
+    
+    if (mPausedForWork) {
+        mPausedForWork = false;
+        if (IsPaused()) {
+            if (mEnabled) {
+                FileLogger::GetInstance().LogInfo("MusicPlayer: Resuming music after heavy work");
+                Mix_ResumeMusic();
+            } else {
+                Mix_HaltMusic();  // 暂停期间关闭了音乐
+            }
+        }
+    }
+    if (mWorkFade < 1.0f) {
+        mWorkFade = mode == Config::BGM_WORK_FADE ? std::min(1.0f, mWorkFade + step) : 1.0f;
+        ApplyVolume();
     }
 }
 
@@ -185,97 +312,89 @@ std::string MusicPlayer::GetCurrentTrackName() const {
     if (mCurrentFilePath.empty()) {
         return "No Music";
     }
-    
-    // 先尝试读取ID3v2标签
-    std::string title = ReadID3Title(mCurrentFilePath);
-    FileLogger::GetInstance().LogInfo("[MusicPlayer] GetCurrentTrackName: path=%s, ID3v2title='%s'", 
-                                       mCurrentFilePath.c_str(), title.c_str());
-    if (!title.empty()) {
-        return title;
+    return mTrackName;
+}
+
+std::string MusicPlayer::GetCurrentArtist() const {
+    return mArtist;
+}
+
+void MusicPlayer::ReadTrackInfo(const std::string& filepath, std::string& title, std::string& artist) const {
+    // 只打开一次文件: 先读文件头的 ID3v2 标签, 缺标题或艺术家时再读末尾的 ID3v1 标签
+    FILE* file = fopen(filepath.c_str(), "rb");
+    if (file) {
+        ReadID3v2Tag(file, title, artist);
+        if (title.empty() || artist.empty()) {
+            std::string v1Title;
+            std::string v1Artist;
+            if (ReadID3v1Tag(file, v1Title, v1Artist)) {
+                if (title.empty()) {
+                    title = v1Title;
+                }
+                if (artist.empty()) {
+                    artist = v1Artist;
+                }
+            }
+        }
+        fclose(file);
+    } else {
+        FileLogger::GetInstance().LogWarning("[ID3] Failed to open file: %s", filepath.c_str());
     }
     
-    // 尝试读取ID3v1标签
-    std::string artist;
-    if (ReadID3v1Tag(mCurrentFilePath, title, artist)) {
-        FileLogger::GetInstance().LogInfo("[MusicPlayer] Found ID3v1 title: '%s'", title.c_str());
-        if (!title.empty()) {
-            return title;
-        }
+    if (!title.empty()) {
+        FileLogger::GetInstance().LogInfo("[ID3] Title: '%s', Artist: '%s'", title.c_str(), artist.c_str());
+        return;
     }
     
     // 如果没有ID3标签,从路径中提取文件名
-    size_t lastSlash = mCurrentFilePath.find_last_of("/\\");
-    std::string filename;
+    size_t lastSlash = filepath.find_last_of("/\\");
     if (lastSlash != std::string::npos) {
-        filename = mCurrentFilePath.substr(lastSlash + 1);
+        title = filepath.substr(lastSlash + 1);
     } else {
-        filename = mCurrentFilePath;
+        title = filepath;
     }
     
     // 去掉扩展名
-    size_t lastDot = filename.find_last_of('.');
+    size_t lastDot = title.find_last_of('.');
     if (lastDot != std::string::npos) {
-        filename = filename.substr(0, lastDot);
+        title = title.substr(0, lastDot);
     }
     
-    FileLogger::GetInstance().LogInfo("[MusicPlayer] No ID3 tag, using filename: %s", filename.c_str());
-    return filename;
+    FileLogger::GetInstance().LogInfo("[MusicPlayer] No ID3 tag, using filename: %s", title.c_str());
 }
 
-std::string MusicPlayer::GetCurrentArtist() const {
-    if (mCurrentFilePath.empty()) {
-        return "";
-    }
+// 提取文本帧的内容 (跳过编码字节, 假设是UTF-8或ISO-8859-1)
+static std::string ReadTextFrame(const unsigned char* data, int size) {
+    std::string text((const char*)(data + 1), size - 1);
     
-    // 先尝试读取ID3v2标签的艺术家信息
-    std::string artist = ReadID3Artist(mCurrentFilePath);
-    FileLogger::GetInstance().LogInfo("[MusicPlayer] GetCurrentArtist: path=%s, ID3v2artist='%s'", 
-                                       mCurrentFilePath.c_str(), artist.c_str());
-    if (!artist.empty()) {
-        return artist;
+    // 移除可能的空字符
+    size_t nullPos = text.find('\0');
+    if (nullPos != std::string::npos) {
+        text = text.substr(0, nullPos);
     }
-    
-    // 尝试读取ID3v1标签
-    std::string title;
-    if (ReadID3v1Tag(mCurrentFilePath, title, artist)) {
-        FileLogger::GetInstance().LogInfo("[MusicPlayer] Found ID3v1 artist: '%s'", artist.c_str());
-        return artist;
-    }
-    
-    return "";
+    return text;
 }
 
-// 读取MP3文件的ID3v2标签标题
-std::string MusicPlayer::ReadID3Title(const std::string& filepath) const {
-    FILE* file = fopen(filepath.c_str(), "rb");
-    if (!file) {
-        FileLogger::GetInstance().LogWarning("[ID3] Failed to open file: %s", filepath.c_str());
-        return "";
-    }
-    
+// 一次解析ID3v2标签的所有帧, 找到TIT2(标题)和TPE1(艺术家)
+// 只读取标签头声明的大小, 不读音频数据
+bool MusicPlayer::ReadID3v2Tag(FILE* file, std::string& title, std::string& artist) {
     // 读取ID3v2头部(10字节)
     unsigned char header[10];
-    if (fread(header, 1, 10, file) != 10) {
-        fclose(file);
-        FileLogger::GetInstance().LogWarning("[ID3] Failed to read header from: %s", filepath.c_str());
-        return "";
+    if (fseek(file, 0, SEEK_SET) != 0 || fread(header, 1, 10, file) != 10) {
+        return false;
     }
     
-    // 输出前10个字节的十六进制用于调试
-    FileLogger::GetInstance().LogInfo("[ID3] First 10 bytes: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X", 
-        header[0], header[1], header[2], header[3], header[4], 
-        header[5], header[6], header[7], header[8], header[9]);
-    FileLogger::GetInstance().LogInfo("[ID3] As text: '%c%c%c' version %d.%d", 
-        header[0], header[1], header[2], header[3], header[4]);
-    
     // 检查ID3v2标识 "ID3"
     if (header[0] != 'I' || header[1] != 'D' || header[2] != '3') {
-        fclose(file);
-        FileLogger::GetInstance().LogInfo("[ID3] No ID3v2 tag found in: %s", filepath.c_str());
-        return "";
+        return false;
     }
     
-    FileLogger::GetInstance().LogInfo("[ID3] Found ID3v2.%d tag in: %s", header[3], filepath.c_str());
+    // ID3v2.2的帧ID只有3字节, 不支持
+    unsigned char version = header[3];
+    if (version != 3 && version != 4) {
+        ULOG_DEBUG(GENERAL, "[ID3] Unsupported ID3v2.%d tag", version);
+        return false;
+    }
     
     // 获取标签大小(使用同步安全整数,每字节只用7位)
     int tagSize = ((header[6] & 0x7F) << 21) |
@@ -283,61 +402,47 @@ std::string MusicPlayer::ReadID3Title(const std::string& filepath) const {
                   ((header[8] & 0x7F) << 7) |
                   (header[9] & 0x7F);
     
-    FileLogger::GetInstance().LogInfo("[ID3] Tag size: %d bytes", tagSize);
-    
     // 读取整个标签数据
-    unsigned char* tagData = new unsigned char[tagSize];
-    if (fread(tagData, 1, tagSize, file) != (size_t)tagSize) {
-        delete[] tagData;
-        fclose(file);
+    std::vector<unsigned char> tagData(tagSize);
+    if (tagSize <= 0 || fread(tagData.data(), 1, tagSize, file) != (size_t)tagSize) {
         FileLogger::GetInstance().LogWarning("[ID3] Failed to read tag data");
-        return "";
+        return false;
     }
-    fclose(file);
     
-    // 解析帧来查找TIT2(标题)帧
-    std::string title;
+    // 跳过扩展头部 (v2.3 的大小不含自身 4 字节, v2.4 含)
     int offset = 0;
-    int frameCount = 0;
-    
-    // ID3v2.3和v2.4的帧ID是4字节
-    while (offset + 10 < tagSize) {
-        // 帧头: 4字节ID + 4字节大小 + 2字节标志
-        char frameID[5] = {0};
-        memcpy(frameID, tagData + offset, 4);
-        
-        // 如果遇到填充(00 00 00 00),停止解析
-        if (frameID[0] == 0) {
-            FileLogger::GetInstance().LogInfo("[ID3] Reached padding at offset %d, parsed %d frames", offset, frameCount);
-            break;
-        }
-        
-        frameCount++;
-        if (frameCount <= 10) {  // 只记录前10个帧
-            FileLogger::GetInstance().LogInfo("[ID3] Frame #%d: ID='%s' at offset %d", frameCount, frameID, offset);
+    if ((header[5] & 0x40) && tagSize >= 4) {
+        int extSize = (tagData[0] << 24) | (tagData[1] << 16) | (tagData[2] << 8) | tagData[3];
+        if (version == 4) {
+            extSize = ((tagData[0] & 0x7F) << 21) | ((tagData[1] & 0x7F) << 14) |
+                      ((tagData[2] & 0x7F) << 7) | (tagData[3] & 0x7F);
+        } else {
+            extSize += 4;
         }
+        offset = extSize;
+    }
+    
+    // 帧头: 4字节ID + 4字节大小 + 2字节标志
+    while (offset + 10 < tagSize && (title.empty() || artist.empty())) {
+        const unsigned char* frame = tagData.data() + offset;
         
         // 如果遇到填充(00 00 00 00),停止解析
-        if (frameID[0] == 0) {
+        if (frame[0] == 0) {
             break;
         }
         
         // 获取帧大小
         int frameSize;
-        if (header[3] == 4) {  // ID3v2.4使用同步安全整数
-            frameSize = ((tagData[offset + 4] & 0x7F) << 21) |
-                       ((tagData[offset + 5] & 0x7F) << 14) |
-                       ((tagData[offset + 6] & 0x7F) << 7) |
-                       (tagData[offset + 7] & 0x7F);
+        if (version == 4) {  // ID3v2.4使用同步安全整数
+            frameSize = ((frame[4] & 0x7F) << 21) |
+                       ((frame[5] & 0x7F) << 14) |
+                       ((frame[6] & 0x7F) << 7) |
+                       (frame[7] & 0x7F);
         } else {  // ID3v2.3使用普通整数(大端序)
-            frameSize = (tagData[offset + 4] << 24) |
-                       (tagData[offset + 5] << 16) |
-                       (tagData[offset + 6] << 8) |
-                       tagData[offset + 7];
-        }
-        
-        if (frameCount <= 10) {
-            FileLogger::GetInstance().LogInfo("[ID3]   Frame size: %d bytes", frameSize);
+            frameSize = (frame[4] << 24) |
+                       (frame[5] << 16) |
+                       (frame[6] << 8) |
+                       frame[7];
         }
         
         // 检查帧大小是否合理
@@ -346,49 +451,58 @@ std::string MusicPlayer::ReadID3Title(const std::string& filepath) const {
             break;
         }
         
-        // 检查是否是TIT2(标题)帧
-        if (strcmp(frameID, "TIT2") == 0 && frameSize > 1) {
-            // 跳过帧头(10字节)和编码字节(1字节)
-            int textStart = offset + 10 + 1;
-            int textSize = frameSize - 1;
-            
-            unsigned char encoding = tagData[offset + 10];
-            FileLogger::GetInstance().LogInfo("[ID3] Found TIT2 frame, encoding: %d, text size: %d", encoding, textSize);
-            
-            // 确保不越界
-            if (textStart + textSize <= tagSize) {
-                // 提取文本(假设是UTF-8或ISO-8859-1)
-                title = std::string((char*)(tagData + textStart), textSize);
-                
-                // 移除可能的空字符
-                size_t nullPos = title.find('\0');
-                if (nullPos != std::string::npos) {
-                    title = title.substr(0, nullPos);
-                }
-                
-                FileLogger::GetInstance().LogInfo("[ID3] Found TIT2 (Title): '%s'", title.c_str());
-                break;
+        if (frameSize > 1) {
+            if (memcmp(frame, "TIT2", 4) == 0 && title.empty()) {
+                title = ReadTextFrame(frame + 10, frameSize);
+            } else if (memcmp(frame, "TPE1", 4) == 0 && artist.empty()) {
+                artist = ReadTextFrame(frame + 10, frameSize);
             }
         }
         
         // 移动到下一帧
         offset += 10 + frameSize;
-        
-        // 防止无限循环
-        if (frameSize == 0) {
-            break;
-        }
     }
     
-    delete[] tagData;
-    return title;
+    return true;
 }
 
+
 void MusicPlayer::Update() {
     if (!mInitialized) {
         return;
     }
     
+    // 换上加载完成的音乐
+    bool loadDone = false;
+    Mix_Music* loaded = nullptr;
+    LoadCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mLoadMutex);
+        if (mLoadDone) {
+            loadDone = true;
+            loaded = mLoadedMusic;
+            mLoadedMusic = nullptr;
+            mLoadDone = false;
+            callback = std::move(mLoadCallback);
+            mLoadCallback = nullptr;
+            if (loaded) {
+                mCurrentFilePath = mLoadedPath;
+                mTrackName = mLoadedTitle;
+                mArtist = mLoadedArtist;
+            }
+        }
+    }
+    if (loaded) {
+        if (mMusic) {
+            Mix_FreeMusic(mMusic);  // 正在播放时会先停止
+        }
+        mMusic = loaded;
+        FileLogger::GetInstance().LogInfo("MusicPlayer: Music loaded successfully");
+    }
+    if (loadDone && callback) {
+        callback(loaded != nullptr);
+    }
+    
     // 检查配置是否改变
     bool configEnabled = Config::GetInstance().IsBgmEnabled();
     if (configEnabled != mWasEnabled) {
@@ -396,189 +510,49 @@ void MusicPlayer::Update() {
         SetEnabled(configEnabled);
     }
     
+    UpdateWorkPause();
+    
     // 如果启用但没有播放,则开始播放
-    if (mEnabled && mMusic && !IsPlaying() && !IsPaused()) {
+    if (mEnabled && mMusic && !IsPlaying() && !IsPaused() && !mPausedForWork) {
         Play();
     }
 }
 
-// 读取MP3文件的ID3v2标签艺术家
-std::string MusicPlayer::ReadID3Artist(const std::string& filepath) const {
-    FILE* file = fopen(filepath.c_str(), "rb");
-    if (!file) {
-        FileLogger::GetInstance().LogWarning("[ID3] Failed to open file for artist: %s", filepath.c_str());
-        return "";
-    }
-    
-    // 读取ID3v2头部(10字节)
-    unsigned char header[10];
-    if (fread(header, 1, 10, file) != 10) {
-        fclose(file);
-        return "";
-    }
-    
-    // 检查ID3v2标识 "ID3"
-    if (header[0] != 'I' || header[1] != 'D' || header[2] != '3') {
-        fclose(file);
-        return "";
-    }
-    
-    FileLogger::GetInstance().LogInfo("[ID3] Reading artist from ID3v2.%d tag", header[3]);
-    
-    // 获取标签大小(使用同步安全整数,每字节只用7位)
-    int tagSize = ((header[6] & 0x7F) << 21) |
-                  ((header[7] & 0x7F) << 14) |
-                  ((header[8] & 0x7F) << 7) |
-                  (header[9] & 0x7F);
-    
-    // 读取整个标签数据
-    unsigned char* tagData = new unsigned char[tagSize];
-    if (fread(tagData, 1, tagSize, file) != (size_t)tagSize) {
-        delete[] tagData;
-        fclose(file);
-        return "";
-    }
-    fclose(file);
-    
-    // 解析帧来查找TPE1(艺术家)帧
-    std::string artist;
-    int offset = 0;
-    int frameCount = 0;
-    
-    // ID3v2.3和v2.4的帧ID是4字节
-    while (offset + 10 < tagSize) {
-        // 帧头: 4字节ID + 4字节大小 + 2字节标志
-        char frameID[5] = {0};
-        memcpy(frameID, tagData + offset, 4);
-        
-        // 如果遇到填充(00 00 00 00),停止解析
-        if (frameID[0] == 0) {
-            FileLogger::GetInstance().LogInfo("[ID3] Artist search: reached padding at offset %d after %d frames", offset, frameCount);
-            break;
-        }
-        
-        frameCount++;
-        
-        // 获取帧大小
-        int frameSize;
-        if (header[3] == 4) {  // ID3v2.4使用同步安全整数
-            frameSize = ((tagData[offset + 4] & 0x7F) << 21) |
-                       ((tagData[offset + 5] & 0x7F) << 14) |
-                       ((tagData[offset + 6] & 0x7F) << 7) |
-                       (tagData[offset + 7] & 0x7F);
-        } else {  // ID3v2.3使用普通整数(大端序)
-            frameSize = (tagData[offset + 4] << 24) |
-                       (tagData[offset + 5] << 16) |
-                       (tagData[offset + 6] << 8) |
-                       tagData[offset + 7];
-        }
-        
-        // 检查帧大小是否合理
-        if (frameSize <= 0 || frameSize > tagSize - offset - 10) {
-            FileLogger::GetInstance().LogWarning("[ID3] Invalid frame size %d at offset %d, stopping", frameSize, offset);
-            break;
-        }
-        
-        // 记录前几个帧
-        if (frameCount <= 10) {
-            FileLogger::GetInstance().LogInfo("[ID3] Artist search frame #%d: '%s' (size=%d)", frameCount, frameID, frameSize);
-        }
-        
-        // 检查是否是TPE1(艺术家)帧
-        if (strcmp(frameID, "TPE1") == 0 && frameSize > 1) {
-            // 跳过帧头(10字节)和编码字节(1字节)
-            int textStart = offset + 10 + 1;
-            int textSize = frameSize - 1;
-            
-            unsigned char encoding = tagData[offset + 10];
-            FileLogger::GetInstance().LogInfo("[ID3] Found TPE1 frame, encoding: %d, text size: %d", encoding, textSize);
-            
-            // 确保不越界
-            if (textStart + textSize <= tagSize) {
-                // 提取文本(假设是UTF-8或ISO-8859-1)
-                artist = std::string((char*)(tagData + textStart), textSize);
-                
-                // 移除可能的空字符
-                size_t nullPos = artist.find('\0');
-                if (nullPos != std::string::npos) {
-                    artist = artist.substr(0, nullPos);
-                }
-                
-                FileLogger::GetInstance().LogInfo("[ID3] Found TPE1 (Artist): '%s'", artist.c_str());
-                break;
-            }
-        }
-        
-        // 移动到下一帧
-        offset += 10 + frameSize;
-        
-        // 防止无限循环
-        if (frameSize == 0) {
-            break;
-        }
-    }
-    
-    delete[] tagData;
-    return artist;
-}
-
 // 读取MP3文件的ID3v1标签 (文件末尾128字节)
 // ID3v1格式: TAG(3) + Title(30) + Artist(30) + Album(30) + Year(4) + Comment(30) + Genre(1)
-bool MusicPlayer::ReadID3v1Tag(const std::string& filepath, std::string& title, std::string& artist) const {
-    FILE* file = fopen(filepath.c_str(), "rb");
-    if (!file) {
-        return false;
-    }
-    
+bool MusicPlayer::ReadID3v1Tag(FILE* file, std::string& title, std::string& artist) {
     // 移动到文件末尾前128字节
     if (fseek(file, -128, SEEK_END) != 0) {
-        fclose(file);
         return false;
     }
     
     // 读取128字节的ID3v1标签
     unsigned char tag[128];
     if (fread(tag, 1, 128, file) != 128) {
-        fclose(file);
         return false;
     }
-    fclose(file);
     
     // 检查 "TAG" 标识
     if (tag[0] != 'T' || tag[1] != 'A' || tag[2] != 'G') {
-        FileLogger::GetInstance().LogInfo("[ID3] No ID3v1 tag found in: %s", filepath.c_str());
         return false;
     }
     
-    FileLogger::GetInstance().LogInfo("[ID3] Found ID3v1 tag in: %s", filepath.c_str());
-    
-    // 提取标题 (字节 3-32, 30字节)
-    char titleBuf[31] = {0};
-    memcpy(titleBuf, tag + 3, 30);
+    // 提取标题 (字节 3-32, 30字节) 和艺术家 (字节 33-62, 30字节)
     // 去掉尾部空格和空字符
-    for (int i = 29; i >= 0; i--) {
-        if (titleBuf[i] == ' ' || titleBuf[i] == '\0') {
-            titleBuf[i] = '\0';
-        } else {
-            break;
+    auto field = [&tag](int start) {
+        int length = 30;
+        while (length > 0 && (tag[start + length - 1] == ' ' || tag[start + length - 1] == '\0')) {
+            length--;
         }
-    }
-    title = std::string(titleBuf);
-    
-    // 提取艺术家 (字节 33-62, 30字节)
-    char artistBuf[31] = {0};
-    memcpy(artistBuf, tag + 33, 30);
-    // 去掉尾部空格和空字符
-    for (int i = 29; i >= 0; i--) {
-        if (artistBuf[i] == ' ' || artistBuf[i] == '\0') {
-            artistBuf[i] = '\0';
-        } else {
-            break;
+        std::string text((const char*)(tag + start), length);
+        size_t nullPos = text.find('\0');
+        if (nullPos != std::string::npos) {
+            text = text.substr(0, nullPos);
         }
-    }
-    artist = std::string(artistBuf);
-    
-    FileLogger::GetInstance().LogInfo("[ID3v1] Title: '%s', Artist: '%s'", title.c_str(), artist.c_str());
+        return text;
+    };
+    title = field(3);
+    artist = field(33);
     
     return true;
 }
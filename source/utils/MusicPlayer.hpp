@@ -1,9 +1,18 @@
 #pragma once
 #include <SDL2/SDL_mixer.h>
 #include <string>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <mutex>
 
+// 音乐文件通过 MusicStream 边读边解码, 内存中只有一个小的预读缓冲区
+// LoadMusic 在后台线程打开文件、探测格式并读取 ID3 标签, 不阻塞 UI;
+// 加载完成后由 Update (UI 线程) 换上新音乐并调用回调
 class MusicPlayer {
 public:
+    using LoadCallback = std::function<void(bool success)>;
+
     static MusicPlayer& GetInstance();
     
     // 初始化和清理
@@ -11,7 +20,9 @@ public:
     void Shutdown();
     
     // 播放控制
-    bool LoadMusic(const std::string& filepath);
+    // 文件不存在时返回 false; 否则开始在后台加载, 完成后在 Update 中调用 callback
+    // 可以在任意线程调用, 加载中再次调用时以最后一次为准
+    bool LoadMusic(const std::string& filepath, LoadCallback callback = nullptr);
     void Play();
     void Stop();
     void Pause();
@@ -29,13 +40,14 @@ public:
     bool IsPlaying() const;
     bool IsPaused() const;
     
-    // 获取当前音乐名称(优先从ID3标签读取,否则从文件名提取)
+    // 获取当前音乐名称(优先从ID3标签读取,否则从文件名提取; 加载时读好)
     std::string GetCurrentTrackName() const;
     
     // 获取当前音乐的艺术家名称
     std::string GetCurrentArtist() const;
     
-    // 每帧更新 - 根据配置自动控制播放
+    // 每帧更新 - 换上加载完成的音乐, 根据配置自动控制播放,
+    // 安装主题、解压、备份期间 (JobSystem::IsHeavyWorkActive) 按配置淡出并暂停, 结束后继续
     void Update();
     
 private:
@@ -44,19 +56,50 @@ private:
     MusicPlayer(const MusicPlayer&) = delete;
     MusicPlayer& operator=(const MusicPlayer&) = delete;
     
-    // 读取MP3的ID3v2标签标题
-    std::string ReadID3Title(const std::string& filepath) const;
+    static constexpr uint32_t WORK_FADE_MS = 600;
+
+    // Update 中检查耗时工作, 推进淡出/淡入
+    void UpdateWorkPause();
+    // 实际音量 = mVolume × 淡出系数
+    void ApplyVolume();
+
+    // 在加载线程运行
+    void LoadThread(std::string filepath, unsigned generation);
+
+    // 读取标题和艺术家: 只打开一次文件, 先读 ID3v2, 缺的再读 ID3v1, 标题最后用文件名
+    void ReadTrackInfo(const std::string& filepath, std::string& title, std::string& artist) const;
     
-    // 读取MP3的ID3v2标签艺术家
-    std::string ReadID3Artist(const std::string& filepath) const;
+    // 一次解析MP3的ID3v2标签, 同时找标题和艺术家 (只读取标签头声明的大小)
+    static bool ReadID3v2Tag(FILE* file, std::string& title, std::string& artist);
     
     // 读取MP3的ID3v1标签 (文件末尾128字节)
-    bool ReadID3v1Tag(const std::string& filepath, std::string& title, std::string& artist) const;
+    static bool ReadID3v1Tag(FILE* file, std::string& title, std::string& artist);
     
     Mix_Music* mMusic;
     int mVolume;
     bool mEnabled;
     bool mInitialized;
     bool mWasEnabled;  // 用于检测配置变化
+    bool mPausedForBackground;  // 进入后台时由我们暂停, 回到前台时继续
+    bool mPausedForWork;        // 耗时工作期间由我们暂停, 工作结束时继续
+    float mWorkFade;            // 淡出系数, 1 为正常音量
+    uint32_t mFadeTick;         // 上次 UpdateWorkPause 的 SDL_GetTicks
+    int mLifecycleListener;
     std::string mCurrentFilePath;  // 当前加载的音乐文件路径
+    std::string mTrackName;
+    std::string mArtist;
+
+    // 加载线程; mLoaderMutex 只保护线程对象 (加载线程不会获取它)
+    std::mutex mLoaderMutex;
+    std::thread mLoader;
+
+    // 由 mLoadMutex 保护: 加载线程的结果, 等待 Update 取走
+    std::mutex mLoadMutex;
+    unsigned mLoadGeneration;  // 每次 LoadMusic 加一, 丢弃过时的结果
+    bool mLoadDone;
+    Mix_Music* mLoadedMusic;
+    std::string mLoadedPath;
+    std::string mLoadedTitle;
+    std::string mLoadedArtist;
+    LoadCallback mLoadCallback;
 };
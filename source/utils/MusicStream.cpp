@@ -0,0 +1,210 @@
+#include "MusicStream.hpp"
+#include "FileLogger.hpp"
+#include "AllocTracker.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace {
+
+struct Stream {
+    FILE* file = nullptr;
+    Sint64 fileSize = 0;
+
+    // 由 mutex 保护: 缓冲区中是文件的 [bufferStart, bufferStart + bufferLength), 从 ring[head] 开始
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<uint8_t> ring;
+    size_t head = 0;
+    Sint64 bufferStart = 0;
+    size_t bufferLength = 0;
+    Sint64 readPos = 0;        // 解码器的读取位置
+    uint32_t generation = 0;   // 跳转后加一, 丢弃读到一半的旧数据
+    bool ioError = false;
+    bool stop = false;
+
+    std::thread reader;
+};
+
+// 在后台线程运行: 缓冲区没满就继续读下一块
+void ReaderThread(Stream* stream) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_AUDIO);
+    std::vector<uint8_t> chunk(MusicStream::CHUNK_SIZE);
+    Sint64 filePos = -1;
+
+    std::unique_lock<std::mutex> lock(stream->mutex);
+    while (!stream->stop) {
+        Sint64 next = stream->bufferStart + (Sint64)stream->bufferLength;
+        size_t space = stream->ring.size() - stream->bufferLength;
+        if (next >= stream->fileSize || space < MusicStream::CHUNK_SIZE / 2 || stream->ioError) {
+            stream->cv.wait(lock);
+            continue;
+        }
+
+        size_t toRead = (size_t)std::min<Sint64>(std::min(space, chunk.size()), stream->fileSize - next);
+        uint32_t generation = stream->generation;
+        lock.unlock();
+
+        size_t got = 0;
+        if (filePos == next || fseek(stream->file, (long)next, SEEK_SET) == 0) {
+            got = fread(chunk.data(), 1, toRead, stream->file);
+        }
+        filePos = next + (Sint64)got;
+
+        lock.lock();
+        if (generation != stream->generation) {
+            continue;  // 读的时候解码器跳到了别处
+        }
+        if (got == 0) {
+            FileLogger::GetInstance().LogError("[MusicStream] Read failed at %lld", (long long)next);
+            stream->ioError = true;
+        }
+        size_t tail = (stream->head + stream->bufferLength) % stream->ring.size();
+        size_t first = std::min(got, stream->ring.size() - tail);
+        memcpy(&stream->ring[tail], chunk.data(), first);
+        memcpy(&stream->ring[0], chunk.data() + first, got - first);
+        stream->bufferLength += got;
+        stream->cv.notify_all();
+    }
+}
+
+// 读取位置不在缓冲区中时从那里重新预读
+void Restart(Stream* stream) {
+    stream->head = 0;
+    stream->bufferStart = stream->readPos;
+    stream->bufferLength = 0;
+    stream->generation++;
+    stream->ioError = false;
+    stream->cv.notify_all();
+}
+
+Sint64 SDLCALL StreamSize(SDL_RWops* rw) {
+    return static_cast<Stream*>(rw->hidden.unknown.data1)->fileSize;
+}
+
+Sint64 SDLCALL StreamSeek(SDL_RWops* rw, Sint64 offset, int whence) {
+    Stream* stream = static_cast<Stream*>(rw->hidden.unknown.data1);
+    std::lock_guard<std::mutex> lock(stream->mutex);
+
+    Sint64 pos = offset;
+    if (whence == RW_SEEK_CUR) {
+        pos = stream->readPos + offset;
+    } else if (whence == RW_SEEK_END) {
+        pos = stream->fileSize + offset;
+    }
+    pos = std::max<Sint64>(0, std::min(pos, stream->fileSize));
+    stream->readPos = pos;
+
+    if (pos < stream->bufferStart || pos > stream->bufferStart + (Sint64)stream->bufferLength) {
+        Restart(stream);
+    }
+    return pos;
+}
+
+// 在音频线程调用; 已经读过的数据立即让出空间给预读
+size_t SDLCALL StreamRead(SDL_RWops* rw, void* ptr, size_t size, size_t maxnum) {
+    Stream* stream = static_cast<Stream*>(rw->hidden.unknown.data1);
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>(ptr);
+    size_t wanted = size * maxnum;
+    size_t copied = 0;
+
+    std::unique_lock<std::mutex> lock(stream->mutex);
+    if (stream->readPos < stream->bufferStart || stream->readPos > stream->bufferStart + (Sint64)stream->bufferLength) {
+        Restart(stream);
+    }
+
+    while (copied < wanted && stream->readPos < stream->fileSize) {
+        size_t skip = (size_t)(stream->readPos - stream->bufferStart);
+        stream->head = (stream->head + skip) % stream->ring.size();
+        stream->bufferStart += (Sint64)skip;
+        stream->bufferLength -= skip;
+
+        if (stream->bufferLength == 0) {
+            if (stream->ioError) {
+                break;
+            }
+            stream->cv.notify_all();
+            stream->cv.wait(lock);
+            continue;
+        }
+
+        size_t n = std::min(wanted - copied, stream->bufferLength);
+        size_t first = std::min(n, stream->ring.size() - stream->head);
+        memcpy(out + copied, &stream->ring[stream->head], first);
+        memcpy(out + copied + first, &stream->ring[0], n - first);
+        copied += n;
+        stream->readPos += (Sint64)n;
+    }
+
+    // 释放刚读过的数据
+    size_t skip = (size_t)(stream->readPos - stream->bufferStart);
+    stream->head = (stream->head + skip) % stream->ring.size();
+    stream->bufferStart += (Sint64)skip;
+    stream->bufferLength -= skip;
+    stream->cv.notify_all();
+
+    return copied / size;
+}
+
+size_t SDLCALL StreamWrite(SDL_RWops*, const void*, size_t, size_t) {
+    return 0;
+}
+
+int SDLCALL StreamClose(SDL_RWops* rw) {
+    Stream* stream = static_cast<Stream*>(rw->hidden.unknown.data1);
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->stop = true;
+    }
+    stream->cv.notify_all();
+    stream->reader.join();
+    fclose(stream->file);
+    delete stream;
+    SDL_FreeRW(rw);
+    return 0;
+}
+
+} // namespace
+
+SDL_RWops* MusicStream::Open(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return nullptr;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return nullptr;
+    }
+
+    SDL_RWops* rw = SDL_AllocRW();
+    if (!rw) {
+        fclose(file);
+        return nullptr;
+    }
+
+    Stream* stream = new Stream();
+    stream->file = file;
+    stream->fileSize = size;
+    stream->ring.resize(BUFFER_SIZE);
+    stream->reader = std::thread(ReaderThread, stream);
+
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->size = StreamSize;
+    rw->seek = StreamSeek;
+    rw->read = StreamRead;
+    rw->write = StreamWrite;
+    rw->close = StreamClose;
+    rw->hidden.unknown.data1 = stream;
+    return rw;
+}
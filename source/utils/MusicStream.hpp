@@ -0,0 +1,14 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <string>
+
+// 给 SDL_mixer 读取的音乐文件: 后台线程按块把文件预读到一个小的环形缓冲区
+// 解码器在音频线程读取时通常只需复制内存, 不会因为等待 SD 卡而断音
+// 整个文件不会读入内存, 占用的只有 BUFFER_SIZE; 循环播放时跳回开头会重新预读
+namespace MusicStream {
+    constexpr size_t CHUNK_SIZE  = 32 * 1024;
+    constexpr size_t BUFFER_SIZE = 256 * 1024;
+
+    // 失败时返回 nullptr; 关闭返回的 RWops 时停止后台线程并关闭文件
+    SDL_RWops* Open(const std::string& path);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// 固定数量的对象池: 经常创建和销毁的同一类对象 (例如每个图片请求的上下文和下载操作)
+// 复用预先留好的存储, 不必每次都从堆分配; 池用完时改用 new, Destroy 按地址区分两种对象
+// 不加锁, 同一个池只能在一个线程中使用
+template <class T, size_t N>
+class ObjectPool {
+public:
+    ObjectPool() : mFreeCount(N) {
+        for (size_t i = 0; i < N; i++) {
+            mFree[i] = N - 1 - i;
+        }
+    }
+
+    // 池中的对象要在池之前销毁
+    ~ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template <class... Args>
+    T* Create(Args&&... args) {
+        if (mFreeCount == 0) {
+            mOverflowCount++;
+            return new T(std::forward<Args>(args)...);
+        }
+        size_t slot = mFree[--mFreeCount];
+        return new (mSlots[slot].bytes) T(std::forward<Args>(args)...);
+    }
+
+    void Destroy(T* object) {
+        if (!object) {
+            return;
+        }
+        if (!Owns(object)) {
+            delete object;
+            return;
+        }
+        size_t slot = ((uintptr_t)object - (uintptr_t)mSlots) / sizeof(Slot);
+        object->~T();
+        mFree[mFreeCount++] = slot;
+    }
+
+    size_t GetInUse() const { return N - mFreeCount; }
+    // 池满时改用 new 的次数
+    uint32_t GetOverflowCount() const { return mOverflowCount; }
+
+private:
+    struct alignas(T) Slot {
+        unsigned char bytes[sizeof(T)];
+    };
+
+    bool Owns(const T* object) const {
+        uintptr_t address = (uintptr_t)object;
+        return address >= (uintptr_t)mSlots && address < (uintptr_t)(mSlots + N);
+    }
+
+    Slot mSlots[N];
+    size_t mFree[N];  // 空闲的槽, 后放回的先用 (缓存中还热)
+    size_t mFreeCount;
+    uint32_t mOverflowCount = 0;
+};
@@ -0,0 +1,109 @@
+#include "PatchStore.hpp"
+#include "Config.hpp"
+#include "FileIO.hpp"
+#include "FileLogger.hpp"
+#include "hips.hpp"
+#include <cstdio>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool PatchStore::IsEnabled() {
+    return Config::GetInstance().IsPatchStoreEnabled();
+}
+
+std::string PatchStore::ObjectName(const std::string& output, uint64_t size, uint32_t crc) {
+    size_t slash = output.find_last_of('/');
+    std::string name = (slash == std::string::npos) ? output : output.substr(slash + 1);
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%llu.%08x", (unsigned long long)size, (unsigned)crc);
+    return name + suffix;
+}
+
+bool PatchStore::Put(const std::string& filePath, const std::string& output, uint64_t size, uint32_t crc) {
+    struct stat st;
+    if (stat(filePath.c_str(), &st) != 0 || (uint64_t)st.st_size != size) {
+        return false;
+    }
+
+    mkdir(STORE_ROOT, 0777);
+    std::string objectPath = std::string(STORE_ROOT) + "/" + ObjectName(output, size, crc);
+    if (stat(objectPath.c_str(), &st) == 0 && (uint64_t)st.st_size == size) {
+        // 别的主题已经放进了相同的内容
+        unlink(filePath.c_str());
+        return true;
+    }
+    unlink(objectPath.c_str());
+    if (rename(filePath.c_str(), objectPath.c_str()) != 0) {
+        FileLogger::GetInstance().LogWarning("[PatchStore] Failed to move %s into the store", filePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PatchStore::Get(const std::string& output, uint64_t size, uint32_t crc, const std::string& destPath) {
+    std::string objectPath = std::string(STORE_ROOT) + "/" + ObjectName(output, size, crc);
+    FileIO in;
+    if (!in.Open(objectPath, FileIO::MODE_READ)) {
+        return false;
+    }
+    FileIO out;
+    if (!out.Open(destPath, FileIO::MODE_WRITE)) {
+        FileLogger::GetInstance().LogError("[PatchStore] Failed to create %s", destPath.c_str());
+        return false;
+    }
+
+    FileIO::Buffer buffer(FileIO::CHUNK_SIZE);
+    bool ok = buffer.size() > 0;
+    uint32_t actualCrc = 0;
+    uint64_t copied = 0;
+    size_t n;
+    while (ok && (n = in.Read(buffer.data(), buffer.size())) > 0) {
+        actualCrc = Hips::Detail::crc32(buffer.data(), n, actualCrc);
+        copied += n;
+        ok = out.Write(buffer.data(), n);
+    }
+    ok = out.Close() && ok;
+    in.Close();
+
+    if (ok && (copied != size || actualCrc != crc)) {
+        // 损坏的对象不能留给其它主题使用
+        FileLogger::GetInstance().LogWarning("[PatchStore] Damaged object %s, removing", objectPath.c_str());
+        unlink(objectPath.c_str());
+        ok = false;
+    }
+    if (!ok) {
+        unlink(destPath.c_str());
+    }
+    return ok;
+}
+
+uint64_t PatchStore::CollectGarbage(const std::set<std::string>& referenced) {
+    DIR* dir = opendir(STORE_ROOT);
+    if (!dir) {
+        return 0;
+    }
+
+    uint64_t freed = 0;
+    int removed = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name == "." || name == ".." || referenced.count(name)) {
+            continue;
+        }
+        std::string path = std::string(STORE_ROOT) + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && unlink(path.c_str()) == 0) {
+            freed += (uint64_t)st.st_size;
+            removed++;
+        }
+    }
+    closedir(dir);
+
+    if (removed > 0) {
+        FileLogger::GetInstance().LogInfo("[PatchStore] Removed %d unreferenced object(s), %llu bytes freed", removed,
+                                          (unsigned long long)freed);
+    }
+    return freed;
+}
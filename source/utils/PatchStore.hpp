@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+
+// 补丁输出的内容寻址存储 (可选, 配置文件中 patchstore=1)
+// 切换到别的主题时, 原来主题 patched/ 下的输出移到 STORE_ROOT, 按内容 (文件名、大小、CRC32) 命名,
+// 多个主题相同的输出只保存一份; 再切换回来时从这里复制回它的 patched/ 目录
+// 清单就是安装记录 (UTheme/installed/*.json) 中每个输出的大小和 CRC32
+// FAT32 没有硬链接, 当前主题的输出必须是真实的文件, 所以当前主题总有一份展开的副本
+// 关闭选项后不再移入新的对象, 已有的对象仍然可以取回
+class PatchStore {
+public:
+    static constexpr const char* STORE_ROOT = "fs:/vol/external01/UTheme/store";
+
+    static bool IsEnabled();
+
+    // 输出文件对应的对象名 (不含目录)
+    static std::string ObjectName(const std::string& output, uint64_t size, uint32_t crc);
+
+    // 把输出文件放进存储: 已有相同的对象时只删除文件, 否则改名移入 (同一张 SD 卡上, 不复制数据)
+    // 文件大小和记录不一致时不移入, 返回 false
+    static bool Put(const std::string& filePath, const std::string& output, uint64_t size, uint32_t crc);
+
+    // 把对象复制到 destPath, 复制时校验 CRC32; 没有对象或对象损坏 (同时删除) 时返回 false
+    static bool Get(const std::string& output, uint64_t size, uint32_t crc, const std::string& destPath);
+
+    // 删除不在 referenced 中的对象, 返回释放的字节数
+    static uint64_t CollectGarbage(const std::set<std::string>& referenced);
+};
@@ -0,0 +1,112 @@
+#include "PerfProfile.hpp"
+#include "Config.hpp"
+#include "DownloadQueue.hpp"
+#include "FastMemory.hpp"
+#include "FileLogger.hpp"
+#include <coreinit/memexpheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/time.h>
+#include <algorithm>
+#include <atomic>
+
+static const char* TIER_NAMES[] = {"low", "normal", "high"};
+static const uint64_t NETWORK_CHECK_INTERVAL_MS = 1000;
+
+static std::atomic<int> sMemoryTier{PerfProfile::TIER_NORMAL};
+static std::atomic<int> sNetworkTier{PerfProfile::TIER_NORMAL};
+static std::atomic<bool> sNetworkMeasured{false};
+static uint64_t sNextNetworkCheckMs = 0;
+
+// 按档位取值
+template <typename T>
+static T ByTier(PerfProfile::Tier tier, T low, T normal, T high) {
+    return tier == PerfProfile::TIER_LOW ? low : (tier == PerfProfile::TIER_HIGH ? high : normal);
+}
+
+void PerfProfile::Init() {
+    size_t mem2Free = MEMGetTotalFreeSizeForExpHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2));
+    int fixed = Config::GetInstance().GetPerfProfile();
+    Tier tier;
+    if (fixed >= 0) {
+        tier = (Tier)fixed;
+        sNetworkTier = tier;
+        sNetworkMeasured = true;
+    } else if (mem2Free < LOW_MEM2_BYTES) {
+        tier = TIER_LOW;
+    } else if (mem2Free > HIGH_MEM2_BYTES) {
+        tier = TIER_HIGH;
+    } else {
+        tier = TIER_NORMAL;
+    }
+    sMemoryTier = tier;
+
+    // MEM1 在 FastMemory::Init 时已经取走, 它的大小只决定工作缓冲区放在哪里, 这里只记录
+    FileLogger::GetInstance().LogInfo("[PerfProfile] MEM2 free %zu MB, MEM1 arena %zu KB: memory tier %s%s",
+                                      mem2Free >> 20, FastMemory::GetCapacity() >> 10, TIER_NAMES[tier],
+                                      fixed >= 0 ? " (from config)" : "");
+}
+
+bool PerfProfile::Update() {
+    if (sNetworkMeasured.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    uint64_t now = OSTicksToMilliseconds(OSGetSystemTime());
+    if (now < sNextNetworkCheckMs) {
+        return false;
+    }
+    sNextNetworkCheckMs = now + NETWORK_CHECK_INTERVAL_MS;
+
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (!queue) {
+        return false;
+    }
+    NetworkStats stats = queue->GetStats();
+    if (stats.samples < NETWORK_SAMPLES || stats.totalBytes < NETWORK_MIN_BYTES) {
+        return false;
+    }
+    Tier tier = TIER_NORMAL;
+    if (stats.bytesPerSec < LOW_BYTES_PER_SEC || stats.failureRate > 0.25f) {
+        tier = TIER_LOW;
+    } else if (stats.bytesPerSec > HIGH_BYTES_PER_SEC) {
+        tier = TIER_HIGH;
+    }
+    sNetworkTier = tier;
+    sNetworkMeasured = true;
+    FileLogger::GetInstance().LogInfo("[PerfProfile] %.0f KB/s over %zu transfers (%.0f%% failed): network tier %s",
+                                      stats.bytesPerSec / 1024, stats.samples, stats.failureRate * 100,
+                                      TIER_NAMES[tier]);
+    return false;
+}
+
+PerfProfile::Tier PerfProfile::GetMemoryTier() {
+    return (Tier)sMemoryTier.load(std::memory_order_relaxed);
+}
+
+PerfProfile::Tier PerfProfile::GetNetworkTier() {
+    return (Tier)sNetworkTier.load(std::memory_order_relaxed);
+}
+
+bool PerfProfile::IsNetworkMeasured() {
+    return sNetworkMeasured.load(std::memory_order_relaxed);
+}
+
+size_t PerfProfile::GetTextureCacheBudget() {
+    return ByTier<size_t>(GetMemoryTier(), 48 * 1024 * 1024, 96 * 1024 * 1024, 128 * 1024 * 1024);
+}
+
+size_t PerfProfile::GetCopyBufferSize() {
+    return ByTier<size_t>(GetMemoryTier(), 256 * 1024, 1024 * 1024, 2 * 1024 * 1024);
+}
+
+size_t PerfProfile::GetDetailBatchSize() {
+    return ByTier<size_t>(GetNetworkTier(), 6, 12, 20);
+}
+
+size_t PerfProfile::GetSyncBatchSize() {
+    return ByTier<size_t>(GetNetworkTier(), 10, 20, 40);
+}
+
+size_t PerfProfile::GetBackgroundThemeLimit() {
+    Tier tier = std::min(GetMemoryTier(), GetNetworkTier());
+    return ByTier<size_t>(tier, 90, 200, 400);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 运行时的性能档位: 代替固定的缓存上限、缓冲区大小和批量大小
+// 内存档位在启动时按 MEM2 剩余空间选择 (Config 加载之后, 纹理缓存和备份缓冲区按它设置);
+// 网络档位在前几次传输之后按 DownloadQueue 统计的吞吐选择, 之前使用 TIER_NORMAL, 选定后本次运行不再改变
+// 配置文件中的 perfprofile= 可以把两个档位都固定下来 (见 Config::GetPerfProfile)
+// 所有读取函数可以在任何线程调用
+class PerfProfile {
+public:
+    enum Tier {
+        TIER_LOW = 0,
+        TIER_NORMAL = 1,
+        TIER_HIGH = 2
+    };
+
+    static constexpr size_t LOW_MEM2_BYTES = 256 * 1024 * 1024;    // 低于此值为 TIER_LOW
+    static constexpr size_t HIGH_MEM2_BYTES = 512 * 1024 * 1024;   // 高于此值为 TIER_HIGH
+    static constexpr size_t NETWORK_SAMPLES = 8;                   // 至少这么多次传输之后才判断网络
+    static constexpr uint64_t NETWORK_MIN_BYTES = 256 * 1024;      // 传输太少时吞吐主要是延迟, 不判断
+    static constexpr float LOW_BYTES_PER_SEC = 128 * 1024;
+    static constexpr float HIGH_BYTES_PER_SEC = 1024 * 1024;
+
+    // Config::Load 之后在主线程调用
+    static void Init();
+    // 每帧在主线程调用 (FrameScheduler 的工作), 网络档位选定之后什么都不做
+    static bool Update();
+
+    static Tier GetMemoryTier();
+    static Tier GetNetworkTier();
+    static bool IsNetworkMeasured();
+
+    // 按内存档位
+    static size_t GetTextureCacheBudget();   // ImageLoader 的纹理缓存上限
+    static size_t GetCopyBufferSize();       // 备份时每个复制缓冲区的大小
+    // 按网络档位
+    static size_t GetDetailBatchSize();      // 每个预取请求获取详情的主题数
+    static size_t GetSyncBatchSize();        // 增量同步每个请求获取的主题数
+    // 两者中较低的档位 (主题越多占用内存越多, 网络慢时加载越久)
+    static size_t GetBackgroundThemeLimit(); // 自动连续加载的主题数上限
+};
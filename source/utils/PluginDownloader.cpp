@@ -1,57 +1,79 @@
 #include "PluginDownloader.hpp"
 #include "FileLogger.hpp"
+#include "Config.hpp"
+#include "DownloadQueue.hpp"
 #include "../Screen.hpp"
-#include <curl/curl.h>
 #include <cstdio>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 PluginDownloader& PluginDownloader::GetInstance() {
     static PluginDownloader instance;
     return instance;
 }
 
-bool PluginDownloader::CheckAndDownloadStyleMiiU() {
+void PluginDownloader::CheckStyleMiiU() {
     const char* pluginPath = "fs:/vol/external01/wiiu/environments/aroma/plugins/stylemiiu.wps";
     const char* downloadUrl = "https://github.com/Themiify-hb/StyleMiiU-Plugin/releases/download/0.4.3/stylemiiu.wps";
     
+    if (Config::GetInstance().IsStyleMiiUPresent()) {
+        FileLogger::GetInstance().LogInfo("[PluginDownloader] StyleMiiU plugin present (cached)");
+        return;
+    }
+    
     FileLogger::GetInstance().LogInfo("[PluginDownloader] Checking for StyleMiiU plugin at: %s", pluginPath);
     
     // 检查文件是否存在
     struct stat st;
     if (stat(pluginPath, &st) == 0) {
         FileLogger::GetInstance().LogInfo("[PluginDownloader] StyleMiiU plugin already exists");
-        return true;
+        Config::GetInstance().SetStyleMiiUPresent(true);
+        return;
     }
     
     FileLogger::GetInstance().LogInfo("[PluginDownloader] StyleMiiU plugin not found, downloading...");
     
     // 下载插件
-    bool success = DownloadFile(downloadUrl, pluginPath);
-    
-    if (success) {
-        FileLogger::GetInstance().LogInfo("[PluginDownloader] StyleMiiU plugin downloaded successfully");
-        Screen::GetBgmNotification().ShowNowPlaying("StyleMiiU Plugin Downloaded");
-    } else {
-        FileLogger::GetInstance().LogError("[PluginDownloader] Failed to download StyleMiiU plugin");
+    if (!StartDownload(downloadUrl, pluginPath)) {
         Screen::GetBgmNotification().ShowError("Failed to download StyleMiiU plugin");
     }
-    
-    return success;
 }
 
-size_t PluginDownloader::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    size_t totalSize = size * nmemb;
-    FILE* file = static_cast<FILE*>(userp);
+void PluginDownloader::Update() {
+    if (!mDownload) {
+        return;
+    }
     
-    if (file) {
-        return fwrite(contents, 1, totalSize, file);
+    // 当前界面不一定在处理下载队列, 下载中由这里执行完成回调
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (queue) {
+        queue->Process();
+    }
+}
+
+void PluginDownloader::Shutdown() {
+    if (!mDownload) {
+        return;
     }
     
-    return totalSize;
+    FileLogger::GetInstance().LogInfo("[PluginDownloader] Abandoning unfinished plugin download");
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (queue) {
+        queue->DownloadCancel(mDownload);
+    }
+    unlink(mDownload->filePath.c_str());
+    delete mDownload;
+    mDownload = nullptr;
 }
 
-bool PluginDownloader::DownloadFile(const std::string& url, const std::string& destPath) {
+bool PluginDownloader::StartDownload(const std::string& url, const std::string& destPath) {
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (!queue || mDownload) {
+        FileLogger::GetInstance().LogError("[PluginDownloader] Download queue unavailable or busy");
+        return false;
+    }
+    
     FileLogger::GetInstance().LogInfo("[PluginDownloader] Downloading from: %s", url.c_str());
     FileLogger::GetInstance().LogInfo("[PluginDownloader] Destination: %s", destPath.c_str());
     
@@ -74,67 +96,49 @@ bool PluginDownloader::DownloadFile(const std::string& url, const std::string& d
         mkdir(dirPath.c_str(), 0777);
     }
     
-    // 使用临时文件
-    std::string tempPath = destPath + ".tmp";
-    
-    // 打开文件
-    FILE* file = fopen(tempPath.c_str(), "wb");
-    if (!file) {
-        FileLogger::GetInstance().LogError("[PluginDownloader] Failed to create file: %s", tempPath.c_str());
-        return false;
-    }
-    
-    // 初始化 CURL
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        FileLogger::GetInstance().LogError("[PluginDownloader] Failed to initialize CURL");
-        fclose(file);
-        remove(tempPath.c_str());
-        return false;
-    }
-    
-    // 配置 CURL
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L); // 5分钟超时
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "UTheme/1.0");
-    
-    // 执行下载
-    CURLcode res = curl_easy_perform(curl);
-    
-    // 获取 HTTP 状态码
-    long httpCode = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-    
-    // 清理
-    curl_easy_cleanup(curl);
-    fclose(file);
-    
-    // 检查结果
-    if (res != CURLE_OK) {
-        FileLogger::GetInstance().LogError("[PluginDownloader] Download failed: %s", curl_easy_strerror(res));
-        remove(tempPath.c_str());
-        return false;
-    }
-    
-    if (httpCode != 200) {
-        FileLogger::GetInstance().LogError("[PluginDownloader] HTTP error: %ld", httpCode);
-        remove(tempPath.c_str());
-        return false;
+    // 使用临时文件, 由下载队列直接写入
+    mDestPath = destPath;
+    mDownload = new DownloadOperation();
+    mDownload->url = url;
+    mDownload->sink = DownloadSink::FILE;
+    mDownload->filePath = destPath + ".tmp";
+    mDownload->priority = DownloadPriority::LOW;  // 不和正在浏览的界面抢连接
+    mDownload->traffic = DownloadTraffic::BACKGROUND;
+    mDownload->cb = [this](DownloadOperation* download) {
+        OnDownloadFinished(download);
+    };
+    queue->DownloadAdd(mDownload);
+    return true;
+}
+
+void PluginDownloader::OnDownloadFinished(DownloadOperation* download) {
+    mDownload = nullptr;
+    
+    bool success = false;
+    if (download->status != DownloadStatus::COMPLETE) {
+        FileLogger::GetInstance().LogError("[PluginDownloader] Download failed: %s", download->url.c_str());
+    } else if (download->response_code != 200 || download->bytesReceived == 0) {
+        FileLogger::GetInstance().LogError("[PluginDownloader] HTTP error: %ld", download->response_code);
+    } else {
+        // 重命名临时文件
+        remove(mDestPath.c_str());
+        if (rename(download->filePath.c_str(), mDestPath.c_str()) != 0) {
+            FileLogger::GetInstance().LogError("[PluginDownloader] Failed to rename file");
+        } else {
+            success = true;
+        }
     }
     
-    // 重命名临时文件
-    remove(destPath.c_str());
-    if (rename(tempPath.c_str(), destPath.c_str()) != 0) {
-        FileLogger::GetInstance().LogError("[PluginDownloader] Failed to rename file");
-        remove(tempPath.c_str());
-        return false;
+    if (success) {
+        FileLogger::GetInstance().LogInfo("[PluginDownloader] StyleMiiU plugin downloaded successfully (%zu bytes)",
+                                          download->bytesReceived);
+        Config::GetInstance().SetStyleMiiUPresent(true);
+        Screen::GetBgmNotification().ShowNowPlaying("StyleMiiU Plugin Downloaded");
+    } else {
+        FileLogger::GetInstance().LogError("[PluginDownloader] Failed to download StyleMiiU plugin");
+        remove(download->filePath.c_str());
+        Screen::GetBgmNotification().ShowError("Failed to download StyleMiiU plugin");
     }
     
-    FileLogger::GetInstance().LogInfo("[PluginDownloader] Download completed successfully");
-    return true;
+    delete download; // 同时释放这个回调, 之后不能再访问捕获的变量
 }
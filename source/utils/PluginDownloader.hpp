@@ -1,26 +1,37 @@
 #pragma once
 
 #include <string>
-#include <functional>
+
+struct DownloadOperation;
 
 // 插件下载器 - 检查并下载必需的插件
+// 下载交给共享的 DownloadQueue, 直接写入文件, 不阻塞主循环
 class PluginDownloader {
 public:
     static PluginDownloader& GetInstance();
-    
-    // 检查并下载 StyleMiiU 插件
-    // 返回: true=已存在或下载成功, false=下载失败
-    bool CheckAndDownloadStyleMiiU();
-    
-    // 下载指定URL的文件到指定路径
-    bool DownloadFile(const std::string& url, const std::string& destPath);
-    
+
+    // 检查 StyleMiiU 插件, 不存在时开始后台下载 (在主线程调用)
+    // 插件存在的结果记在配置中, 之后启动不再检查文件
+    void CheckStyleMiiU();
+
+    // 每帧调用: 有下载时处理下载队列, 完成后显示通知
+    void Update();
+
+    // 退出时调用: 放弃没下载完的插件
+    void Shutdown();
+
+    bool IsDownloading() const { return mDownload != nullptr; }
+
 private:
     PluginDownloader() = default;
     ~PluginDownloader() = default;
     PluginDownloader(const PluginDownloader&) = delete;
     PluginDownloader& operator=(const PluginDownloader&) = delete;
-    
-    // CURL 写入回调
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+
+    // 开始下载指定URL的文件到指定路径 (先写入 .tmp, 成功后改名)
+    bool StartDownload(const std::string& url, const std::string& destPath);
+    void OnDownloadFinished(DownloadOperation* download);
+
+    DownloadOperation* mDownload = nullptr;
+    std::string mDestPath;
 };
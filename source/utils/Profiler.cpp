@@ -0,0 +1,232 @@
+#include "Profiler.hpp"
+#include "AllocTracker.hpp"
+#include "FileLogger.hpp"
+#include "ImageLoader.hpp"
+#include "DownloadQueue.hpp"
+#include "FastMemory.hpp"
+#include "TextureRegistry.hpp"
+#include "../Gfx.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+bool Profiler::sHudVisible = false;
+OSTime Profiler::sLastFrameEnd = 0;
+OSTime Profiler::sCurrent[SECTION_COUNT] = {};
+Profiler::FrameStats Profiler::sHistory[HISTORY_FRAMES] = {};
+int Profiler::sHistoryPos = 0;
+int Profiler::sHistoryCount = 0;
+int Profiler::sFramesSinceDump = 0;
+uint32_t Profiler::sTotalFrames = 0;
+
+static const char* const sSectionNames[Profiler::SECTION_COUNT] = {
+    "Update", "Draw", "Images", "Net", "Music", "Render"
+};
+
+static float TicksToMs(OSTime ticks) {
+    return OSTicksToMicroseconds(ticks) / 1000.0f;
+}
+
+// "thumb 12M  hd 30M  ..." 各类纹理占用的显存 (MB, 不足 1 MB 的显示为 KB)
+static std::string FormatTextureBytes() {
+    std::string text;
+    char part[32];
+    for (int c = 0; c < TextureRegistry::CATEGORY_COUNT; c++) {
+        auto category = (TextureRegistry::Category)c;
+        size_t bytes = TextureRegistry::GetBytes(category);
+        if (bytes >= 1024 * 1024) {
+            snprintf(part, sizeof(part), "%s%s %zuM", c ? "  " : "", TextureRegistry::GetCategoryName(category), bytes >> 20);
+        } else {
+            snprintf(part, sizeof(part), "%s%s %zuK", c ? "  " : "", TextureRegistry::GetCategoryName(category), bytes >> 10);
+        }
+        text += part;
+    }
+    return text;
+}
+
+void Profiler::AddTime(Section section, OSTime ticks) {
+    sCurrent[section] += ticks;
+}
+
+void Profiler::ToggleHud() {
+    sHudVisible = !sHudVisible;
+    FileLogger::GetInstance().LogInfo("[Profiler] HUD %s", sHudVisible ? "shown" : "hidden");
+}
+
+void Profiler::EndFrame() {
+    OSTime now = OSGetSystemTime();
+
+    FrameStats& frame = sHistory[sHistoryPos];
+    frame.frameMs = sLastFrameEnd ? TicksToMs(now - sLastFrameEnd) : 0.0f;
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        frame.sectionMs[i] = TicksToMs(sCurrent[i]);
+        sCurrent[i] = 0;
+    }
+    frame.drawCalls = Gfx::GetDrawCallCount();
+    AllocTracker::EndFrame();
+
+    sLastFrameEnd = now;
+    sHistoryPos = (sHistoryPos + 1) % HISTORY_FRAMES;
+    sHistoryCount = std::min(sHistoryCount + 1, HISTORY_FRAMES);
+    sTotalFrames++;
+
+    if (++sFramesSinceDump >= DUMP_INTERVAL_FRAMES) {
+        sFramesSinceDump = 0;
+        if (FileLogger::GetInstance().IsEnabled()) {
+            DumpToLog();
+        }
+    }
+}
+
+float Profiler::Percentile(float p) {
+    if (sHistoryCount == 0) {
+        return 0.0f;
+    }
+
+    float times[HISTORY_FRAMES];
+    for (int i = 0; i < sHistoryCount; i++) {
+        times[i] = sHistory[i].frameMs;
+    }
+    int index = std::min(sHistoryCount - 1, (int)(p * sHistoryCount));
+    std::nth_element(times, times + index, times + sHistoryCount);
+    return times[index];
+}
+
+Profiler::Summary Profiler::GetSummary() {
+    Summary summary;
+    summary.totalFrames = sTotalFrames;
+    if (sHistoryCount == 0) {
+        return summary;
+    }
+    summary.p50Ms = Percentile(0.50f);
+    summary.p95Ms = Percentile(0.95f);
+    summary.p99Ms = Percentile(0.99f);
+    for (int i = 0; i < sHistoryCount; i++) {
+        for (int s = 0; s < SECTION_COUNT; s++) {
+            summary.sectionAvgMs[s] += sHistory[i].sectionMs[s];
+        }
+        summary.drawCallsAvg += sHistory[i].drawCalls;
+    }
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        summary.sectionAvgMs[s] /= sHistoryCount;
+    }
+    summary.drawCallsAvg /= sHistoryCount;
+    return summary;
+}
+
+void Profiler::DumpToLog() {
+    Summary summary = GetSummary();
+    FileLogger::GetInstance().LogInfo("[Profiler] frame p50 %.1fms p95 %.1fms p99 %.1fms; avg update %.2f draw %.2f images %.2f net %.2f music %.2f render %.2f ms; %.0f draw calls",
+                                      summary.p50Ms, summary.p95Ms, summary.p99Ms,
+                                      summary.sectionAvgMs[SECTION_UPDATE], summary.sectionAvgMs[SECTION_DRAW],
+                                      summary.sectionAvgMs[SECTION_IMAGE_LOADER], summary.sectionAvgMs[SECTION_DOWNLOAD_QUEUE],
+                                      summary.sectionAvgMs[SECTION_MUSIC], summary.sectionAvgMs[SECTION_RENDER],
+                                      summary.drawCallsAvg);
+
+    size_t queued = 0;
+    int active = 0;
+    if (DownloadQueue::GetInstance()) {
+        NetworkStats stats = DownloadQueue::GetInstance()->GetStats();
+        queued = stats.queued;
+        active = stats.active;
+    }
+    FileLogger::GetInstance().LogInfo("[Profiler] textures: %zu KB total (%s), %d failed; image queue %zu, pending %zu; downloads %zu queued, %d active",
+                                      TextureRegistry::GetTotalBytes() / 1024, FormatTextureBytes().c_str(), TextureRegistry::GetFailureCount(),
+                                      ImageLoader::GetQueueSize(), ImageLoader::GetPendingCount(), queued, active);
+    AllocTracker::DumpToLog();
+}
+
+void Profiler::DrawHud() {
+    if (!sHudVisible) {
+        return;
+    }
+
+    const int x = 20;
+    const int y = 130;
+    const int w = 640;
+    const int h = AllocTracker::ENABLED ? 420 : 390;
+    const int lineH = 30;
+    Gfx::DrawRectFilled(x, y, w, h, {0x00, 0x00, 0x00, 0xc0});
+
+    int last = (sHistoryPos + HISTORY_FRAMES - 1) % HISTORY_FRAMES;
+    const FrameStats& frame = sHistory[last];
+
+    char line[160];
+    int textY = y + 20;
+    snprintf(line, sizeof(line), "frame %.1fms  p50 %.1f  p95 %.1f  p99 %.1f",
+             frame.frameMs, Percentile(0.50f), Percentile(0.95f), Percentile(0.99f));
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    textY += lineH;
+    int len = 0;
+    for (int s = 0; s < SECTION_COUNT && len < (int)sizeof(line); s++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s %.1f  ", sSectionNames[s], frame.sectionMs[s]);
+    }
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    textY += lineH;
+    snprintf(line, sizeof(line), "draw calls %d", frame.drawCalls);
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    textY += lineH;
+    snprintf(line, sizeof(line), "textures %zu/%zu MB  %s",
+             TextureRegistry::GetTotalBytes() >> 20, TextureRegistry::TEXTURE_BUDGET >> 20, FormatTextureBytes().c_str());
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    textY += lineH;
+    size_t queued = 0;
+    int active = 0;
+    if (DownloadQueue::GetInstance()) {
+        NetworkStats stats = DownloadQueue::GetInstance()->GetStats();
+        queued = stats.queued;
+        active = stats.active;
+    }
+    snprintf(line, sizeof(line), "queues: images %zu  pending %zu  downloads %zu  active %d",
+             ImageLoader::GetQueueSize(), ImageLoader::GetPendingCount(), queued, active);
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    textY += lineH;
+    // 图片缓存命中率和解码耗时 (本次运行累计)
+    ImageLoader::Stats images = ImageLoader::GetStats();
+    uint64_t decodes = 0, decodeUs = 0;
+    for (int i = 0; i < ImageLoader::DECODE_FORMAT_COUNT; i++) {
+        decodes += images.decodeCount[i];
+        decodeUs += images.decodeUs[i];
+    }
+    snprintf(line, sizeof(line), "images: hit %.0f%%  disk %llu  net %llu  fail %llu  evict %llu  decode %.1fms",
+             images.HitRate() * 100, (unsigned long long)(images.diskHits + images.pixelCacheHits),
+             (unsigned long long)images.downloads, (unsigned long long)(images.decodeFailures + images.downloadFailures),
+             (unsigned long long)images.evictions, decodes ? decodeUs / 1000.0f / decodes : 0.0f);
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    textY += lineH;
+    // MEM1 工作缓冲区: 占用 (峰值) / 容量, 空间不够退回 MEM2 的次数
+    snprintf(line, sizeof(line), "mem1 %zuK (peak %zuK) / %zuK  fallback %u",
+             FastMemory::GetUsed() >> 10, FastMemory::GetPeak() >> 10, FastMemory::GetCapacity() >> 10,
+             FastMemory::GetFallbackCount());
+    Gfx::Print(x + 12, textY, 24, Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+
+    if (AllocTracker::ENABLED) {
+        textY += lineH;
+        // 堆占用 (峰值)、默认堆剩余、上一帧的分配次数和字节数; 有分配失败时显示为红色
+        snprintf(line, sizeof(line), "heap %.1fM (peak %.1fM)  free %.0fM  allocs %u / %zuK",
+                 AllocTracker::GetLiveBytes() / 1048576.0f, AllocTracker::GetPeakBytes() / 1048576.0f,
+                 AllocTracker::GetHeapFreeBytes() / 1048576.0f, AllocTracker::GetFrameAllocs(),
+                 AllocTracker::GetFrameBytes() >> 10);
+        Gfx::Print(x + 12, textY, 24, AllocTracker::GetFailedCount() ? Gfx::COLOR_ERROR : Gfx::COLOR_WHITE, line, Gfx::ALIGN_VERTICAL);
+    }
+
+    // 最近 HISTORY_FRAMES 帧的帧时间, 顶部为 33ms, 横线为 16.7ms
+    const int graphX = x + 12;
+    const int graphY = textY + 25;
+    const int graphH = y + h - 12 - graphY;
+    const int barW = (w - 24) / HISTORY_FRAMES;
+    const float maxMs = 33.3f;
+    for (int i = 0; i < sHistoryCount; i++) {
+        const FrameStats& f = sHistory[(sHistoryPos + HISTORY_FRAMES - sHistoryCount + i) % HISTORY_FRAMES];
+        int barH = (int)(std::min(f.frameMs, maxMs) / maxMs * graphH);
+        SDL_Color color = f.frameMs > 17.5f ? Gfx::COLOR_ERROR : Gfx::COLOR_SUCCESS;
+        Gfx::DrawRectFilled(graphX + i * barW, graphY + graphH - barH, std::max(1, barW - 1), barH, color);
+    }
+    Gfx::DrawRectFilled(graphX, graphY + graphH - (int)(16.7f / maxMs * graphH), barW * HISTORY_FRAMES, 1, Gfx::COLOR_WARNING);
+}
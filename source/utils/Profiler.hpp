@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <coreinit/time.h>
+
+// 帧耗时统计: 主循环和几个耗时的函数用 Profiler::Scope 计时 (只在主线程使用)
+// 打开 HUD 后在屏幕左上角显示帧时间、最近帧的耗时图、各部分耗时、提交次数、纹理内存和队列长度
+// 开启日志时每 DUMP_INTERVAL_FRAMES 帧向日志写一行汇总, 用于对比性能变化
+class Profiler {
+public:
+    enum Section {
+        SECTION_UPDATE,
+        SECTION_DRAW,
+        SECTION_IMAGE_LOADER,
+        SECTION_DOWNLOAD_QUEUE,
+        SECTION_MUSIC,
+        SECTION_RENDER,
+        SECTION_COUNT
+    };
+
+    static constexpr int HISTORY_FRAMES = 120;
+    static constexpr int DUMP_INTERVAL_FRAMES = 600;  // 约 10 秒
+
+    // 作用域计时, 嵌套时外层也包含内层的时间
+    class Scope {
+    public:
+        explicit Scope(Section section) : mSection(section), mStart(OSGetSystemTime()) {}
+        ~Scope() { Profiler::AddTime(mSection, OSGetSystemTime() - mStart); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Section mSection;
+        OSTime mStart;
+    };
+
+    static void AddTime(Section section, OSTime ticks);
+
+    // 每画完一帧调用一次 (跳过的空闲帧不算)
+    static void EndFrame();
+
+    // 最近 HISTORY_FRAMES 帧的汇总 (日志和 MetricsStream 使用)
+    struct Summary {
+        float p50Ms = 0;
+        float p95Ms = 0;
+        float p99Ms = 0;
+        float sectionAvgMs[SECTION_COUNT] = {};
+        float drawCallsAvg = 0;
+        uint32_t totalFrames = 0;           // 本次运行画完的帧数
+    };
+    static Summary GetSummary();
+
+    static void ToggleHud();
+    static bool IsHudVisible() { return sHudVisible; }
+    static void DrawHud();
+
+private:
+    struct FrameStats {
+        float frameMs = 0;                  // 和上一帧的间隔
+        float sectionMs[SECTION_COUNT] = {};
+        int drawCalls = 0;
+    };
+
+    static float Percentile(float p);
+    static void DumpToLog();
+
+    static bool sHudVisible;
+    static OSTime sLastFrameEnd;
+    static OSTime sCurrent[SECTION_COUNT];        // 这一帧到目前为止的累计
+    static FrameStats sHistory[HISTORY_FRAMES];   // 环形缓冲
+    static int sHistoryPos;
+    static int sHistoryCount;
+    static int sFramesSinceDump;
+    static uint32_t sTotalFrames;
+};
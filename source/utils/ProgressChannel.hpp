@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 后台任务 (下载、解压) 报告给界面的进度, 界面每帧读取一次
+// state 和 message 的含义由使用者定义 (例如 DownloadState 和它自己的消息编号), 字符串不经过这里
+struct ProgressSnapshot {
+    uint32_t state = 0;
+    uint32_t message = 0;
+    uint64_t bytes = 0;
+    uint64_t total = 0;      // 0 表示未知
+    uint32_t rate = 0;       // 字节/秒
+    float progress = 0.0f;   // 0 ~ 1
+};
+
+// 进度通道: 顺序锁保护的一份快照, 工作线程写入, 任何线程读取, 不分配内存也不用互斥锁
+// 写入时序号为奇数, 读取者看到奇数或读取前后序号变了就重读, 从不阻塞写入者;
+// 重读最多 READ_ATTEMPTS 次, 之后返回上一次读到的完整快照: 写入者在写到一半时被抢占 (Cafe OS 按优先级调度,
+// 优先级更高的界面线程在同一个核上空转时它不会再运行), 读取者也不会一直等下去
+// 写入者之间用 CAS 抢序号; 同一通道的写入者很少 (网络线程报告字节数, 工作线程切换状态), 几乎不会碰上
+// 快照按 32 位字存放在原子变量里, 读到一半被改写也不是数据竞争, 只会被序号检查丢弃
+class ProgressChannel {
+public:
+    ProgressChannel() = default;  // 全部为 0, 和 ProgressSnapshot() 相同
+
+    ProgressChannel(const ProgressChannel&) = delete;
+    ProgressChannel& operator=(const ProgressChannel&) = delete;
+
+    void Publish(const ProgressSnapshot& snapshot) {
+        Update([&snapshot](ProgressSnapshot& current) { current = snapshot; });
+    }
+
+    // 在写入期间修改当前快照的部分字段; update 里不能再写入同一个通道
+    template <typename F>
+    void Update(F&& update) {
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        while ((sequence & 1) != 0 ||
+               !mSequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire,
+                                                std::memory_order_relaxed)) {
+            sequence = mSequence.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        ProgressSnapshot snapshot = Load();
+        update(snapshot);
+        uint32_t words[WORDS];
+        memcpy(words, &snapshot, sizeof(words));
+        for (size_t i = 0; i < WORDS; i++) {
+            mWords[i].store(words[i], std::memory_order_relaxed);
+        }
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    ProgressSnapshot Read() const {
+        ProgressSnapshot snapshot;
+        if (TryRead(mSequence, mWords, snapshot)) {
+            StoreLastGood(snapshot);
+            return snapshot;
+        }
+        // 写入者停在写入中: 用上一次的快照. 缓存只在另一个读取者正在更新它时才读不到, 那时返回空的快照
+        TryRead(mLastGoodSequence, mLastGood, snapshot);
+        return snapshot;
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<ProgressSnapshot>::value && sizeof(ProgressSnapshot) % 4 == 0,
+                  "ProgressSnapshot is copied as 32-bit words");
+    static constexpr size_t WORDS = sizeof(ProgressSnapshot) / 4;
+    static constexpr int READ_ATTEMPTS = 16;
+
+    static ProgressSnapshot LoadWords(const std::atomic<uint32_t> (&source)[WORDS]) {
+        uint32_t words[WORDS];
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i] = source[i].load(std::memory_order_relaxed);
+        }
+        ProgressSnapshot snapshot;
+        memcpy(&snapshot, words, sizeof(snapshot));
+        return snapshot;
+    }
+
+    ProgressSnapshot Load() const {
+        return LoadWords(mWords);
+    }
+
+    // 按顺序锁读取, 最多 READ_ATTEMPTS 次; 读不到一致的快照时返回 false, snapshot 不变
+    static bool TryRead(const std::atomic<uint32_t>& sequence, const std::atomic<uint32_t> (&source)[WORDS],
+                        ProgressSnapshot& snapshot) {
+        for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                continue;
+            }
+            ProgressSnapshot loaded = LoadWords(source);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                snapshot = loaded;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 保存读到的完整快照; 同时有另一个读取者在保存时放弃, 不等待
+    void StoreLastGood(const ProgressSnapshot& snapshot) const {
+        uint32_t sequence = mLastGoodSequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) != 0 ||
+            !mLastGoodSequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire,
+                                                       std::memory_order_relaxed)) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        uint32_t words[WORDS];
+        memcpy(words, &snapshot, sizeof(words));
+        for (size_t i = 0; i < WORDS; i++) {
+            mLastGood[i].store(words[i], std::memory_order_relaxed);
+        }
+        mLastGoodSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    std::atomic<uint32_t> mSequence{0};
+    std::atomic<uint32_t> mWords[WORDS] = {};
+    // 读取者缓存的上一次完整快照, 用同样的顺序锁保护 (写入者是读取者自己)
+    mutable std::atomic<uint32_t> mLastGoodSequence{0};
+    mutable std::atomic<uint32_t> mLastGood[WORDS] = {};
+};
@@ -0,0 +1,139 @@
+#include "ResolveCache.hpp"
+#include "FileLogger.hpp"
+#include "logger.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+static const char* const FILE_MAGIC = "UTRSLV";
+static constexpr int FILE_VERSION = 1;
+
+void ResolveCache::Load() {
+    mEntries.clear();
+    mDirty = false;
+
+    FILE* file = fopen(CACHE_FILE, "r");
+    if (!file) {
+        return;
+    }
+
+    int64_t now = (int64_t)time(nullptr);
+    char line[512];
+    bool valid = false;
+    if (fgets(line, sizeof(line), file)) {
+        char magic[8] = {0};
+        int version = 0;
+        valid = sscanf(line, "%7s %d", magic, &version) == 2 &&
+                strcmp(magic, FILE_MAGIC) == 0 && version == FILE_VERSION;
+    }
+    while (valid && fgets(line, sizeof(line), file)) {
+        // host port address expires
+        char host[256];
+        char address[64];
+        long port = 0;
+        long long expires = 0;
+        if (sscanf(line, "%255s %ld %63s %lld", host, &port, address, &expires) != 4) {
+            continue;
+        }
+        if (expires <= now) {
+            mDirty = true;  // 过期的项不再写回
+            continue;
+        }
+        Entry& entry = mEntries[host];
+        entry.address = address;
+        entry.port = port;
+        entry.expires = expires;
+    }
+    fclose(file);
+
+    FileLogger::GetInstance().LogInfo("[Resolve] %zu cached host address(es)", mEntries.size());
+}
+
+void ResolveCache::Save() {
+    if (!mDirty) {
+        return;
+    }
+
+    std::string tempPath = std::string(CACHE_FILE) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[Resolve] Failed to write %s", tempPath.c_str());
+        return;
+    }
+    bool ok = fprintf(file, "%s %d\n", FILE_MAGIC, FILE_VERSION) > 0;
+    for (const auto& pair : mEntries) {
+        if (pair.second.evict) {
+            continue;
+        }
+        ok = ok && fprintf(file, "%s %ld %s %lld\n", pair.first.c_str(), pair.second.port,
+                           pair.second.address.c_str(), (long long)pair.second.expires) > 0;
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    remove(CACHE_FILE);
+    if (!ok || rename(tempPath.c_str(), CACHE_FILE) != 0) {
+        remove(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[Resolve] Failed to save %s", CACHE_FILE);
+        return;
+    }
+    mDirty = false;
+}
+
+curl_slist* ResolveCache::BuildResolveList(const std::string& host, bool& injected) {
+    injected = false;
+    auto it = mEntries.find(host);
+    if (it == mEntries.end()) {
+        return nullptr;
+    }
+    Entry& entry = it->second;
+
+    char item[384];
+    if (entry.evict) {
+        // 删除 curl DNS 缓存中的旧地址, 之后的传输重新解析
+        snprintf(item, sizeof(item), "-%s:%ld", host.c_str(), entry.port);
+        mEntries.erase(it);
+        return curl_slist_append(nullptr, item);
+    }
+    if (entry.used || entry.expires <= (int64_t)time(nullptr)) {
+        return nullptr;
+    }
+
+    // IPv6 地址要加方括号
+    bool ipv6 = entry.address.find(':') != std::string::npos;
+    snprintf(item, sizeof(item), ipv6 ? "+%s:%ld:[%s]" : "+%s:%ld:%s", host.c_str(), entry.port, entry.address.c_str());
+    entry.used = true;
+    injected = true;
+    ULOG_DEBUG(NET, "[Resolve] Using cached address for %s: %s", host.c_str(), entry.address.c_str());
+    return curl_slist_append(nullptr, item);
+}
+
+void ResolveCache::Record(CURL* eh, const std::string& host) {
+    char* address = nullptr;
+    long port = 0;
+    if (host.empty() ||
+        curl_easy_getinfo(eh, CURLINFO_PRIMARY_IP, &address) != CURLE_OK || !address || !address[0] ||
+        curl_easy_getinfo(eh, CURLINFO_PRIMARY_PORT, &port) != CURLE_OK || port <= 0) {
+        return;
+    }
+
+    Entry& entry = mEntries[host];
+    if (entry.address != address || entry.port != port) {
+        entry.address = address;
+        entry.port = port;
+        entry.evict = false;
+    }
+    entry.used = true;  // 这次运行已经解析过, 不需要再交给 curl
+    entry.expires = (int64_t)time(nullptr) + TTL_SECONDS;
+    mDirty = true;
+}
+
+void ResolveCache::Invalidate(const std::string& host) {
+    auto it = mEntries.find(host);
+    if (it == mEntries.end()) {
+        return;
+    }
+    FileLogger::GetInstance().LogWarning("[Resolve] Cached address %s for %s failed, resolving again",
+                                         it->second.address.c_str(), host.c_str());
+    it->second.evict = true;
+    mDirty = true;
+}
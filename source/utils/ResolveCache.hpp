@@ -0,0 +1,44 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// 主机地址的持久缓存: 记录每个主机最近一次建立连接的地址, 退出时写入 CACHE_FILE, 下次启动时读入
+// 本次运行中每个主机的第一次传输把还没过期的地址通过 CURLOPT_RESOLVE 交给 curl,
+// 跳过启动后的第一次 DNS 查询 ("+" 前缀的项和普通 DNS 缓存项一样会过期, 之后照常解析)
+// 用缓存的地址连接失败时丢弃该项, 并从 curl 的 DNS 缓存中删除, 重试时重新解析
+// 只在驱动 curl 的线程中使用 (Load / Save 在该线程开始之前和结束之后调用)
+class ResolveCache {
+public:
+    static constexpr const char* CACHE_FILE = "fs:/vol/external01/UTheme/temp/resolve_cache.txt";
+    static constexpr int64_t TTL_SECONDS = 6 * 60 * 60;  // 地址保存的时间
+
+    void Load();
+    // 有改动时写回 (先写临时文件再改名)
+    void Save();
+
+    // 传输开始前调用: 返回这次传输要设置的 CURLOPT_RESOLVE 列表, 没有时为 nullptr
+    // 列表要保留到传输结束, 之后用 curl_slist_free_all 释放
+    // injected 为 true 表示使用了缓存的地址
+    curl_slist* BuildResolveList(const std::string& host, bool& injected);
+
+    // 建立了新连接的传输结束时 (easy handle 还没有释放) 记录实际连接的地址
+    void Record(CURL* eh, const std::string& host);
+
+    // 使用缓存地址的传输连接失败
+    void Invalidate(const std::string& host);
+
+private:
+    struct Entry {
+        std::string address;
+        long port = 0;
+        int64_t expires = 0;     // time() 秒数
+        bool used = false;       // 本次运行已经交给过 curl
+        bool evict = false;      // 下次传输时从 curl 的 DNS 缓存中删除
+    };
+
+    std::map<std::string, Entry> mEntries;  // 主机名 -> 地址
+    bool mDirty = false;
+};
@@ -254,8 +254,8 @@ FC_GlyphData FC_MakeGlyphData(int cache_level, Sint16 x, Sint16 y, Uint16 w,
     return gd;
 }
 
-// Enough to hold all of the ascii characters and some.
-#define FC_DEFAULT_NUM_BUCKETS 300
+// Only glyphs outside the BMP go into a map (see FC_GlyphTable), a few buckets are enough.
+#define FC_DEFAULT_NUM_BUCKETS 64
 
 typedef struct FC_MapNode {
     Uint32 key;
@@ -379,6 +379,155 @@ static FC_GlyphData *FC_MapFind(FC_Map *map, Uint32 codepoint) {
     return NULL;
 }
 
+// Glyph lookup table. Codepoints arrive in SDL_FontCache's packed form (the
+// UTF-8 bytes in one Uint32) and are decoded to Unicode scalars here. ASCII and
+// Latin-1 sit in a page that is always present, the rest of the BMP in 256-entry
+// pages allocated the first time a glyph of that block is cached (CJK text
+// touches a few dozen pages). Codepoints outside the BMP and malformed sequences
+// are rare and keep using the chained map.
+#define FC_GLYPH_PAGE_SIZE 256
+#define FC_GLYPH_PAGE_COUNT 256 // U+0000 - U+FFFF
+#define FC_NOT_IN_PAGES 0xFFFFFFFF
+
+typedef struct FC_GlyphPage {
+    FC_GlyphData glyphs[FC_GLYPH_PAGE_SIZE];
+    Uint8 present[FC_GLYPH_PAGE_SIZE];
+} FC_GlyphPage;
+
+typedef struct FC_GlyphTable {
+    FC_GlyphPage latin1;
+    FC_GlyphPage *pages[FC_GLYPH_PAGE_COUNT]; // pages[0] is latin1
+    FC_Map *others;                           // created on first use
+} FC_GlyphTable;
+
+// Packed UTF-8 to a BMP scalar, FC_NOT_IN_PAGES for anything else
+static_inline Uint32 FC_UnpackCodepoint(Uint32 c) {
+    Uint32 u;
+    if (c < 0x80)
+        return c;
+    if (c <= 0xFFFF) {
+        if ((c & 0xE0C0) != 0xC080)
+            return FC_NOT_IN_PAGES;
+        u = ((c >> 8) & 0x1F) << 6 | (c & 0x3F);
+        return u >= 0x80 ? u : FC_NOT_IN_PAGES;
+    }
+    if (c <= 0xFFFFFF) {
+        if ((c & 0xF0C0C0) != 0xE08080)
+            return FC_NOT_IN_PAGES;
+        u = ((c >> 16) & 0x0F) << 12 | ((c >> 8) & 0x3F) << 6 | (c & 0x3F);
+        return u >= 0x800 ? u : FC_NOT_IN_PAGES;
+    }
+    return FC_NOT_IN_PAGES;
+}
+
+static Uint32 FC_PackCodepoint(Uint32 u) {
+    if (u < 0x80)
+        return u;
+    if (u < 0x800)
+        return (0xC0 | (u >> 6)) << 8 | (0x80 | (u & 0x3F));
+    return (0xE0 | (u >> 12)) << 16 | (0x80 | ((u >> 6) & 0x3F)) << 8 |
+           (0x80 | (u & 0x3F));
+}
+
+static FC_GlyphTable *FC_GlyphTableCreate(void) {
+    FC_GlyphTable *table = (FC_GlyphTable *) calloc(1, sizeof(FC_GlyphTable));
+    if (table != NULL)
+        table->pages[0] = &table->latin1;
+    return table;
+}
+
+static void FC_GlyphTableFree(FC_GlyphTable *table) {
+    int i;
+    if (table == NULL)
+        return;
+
+    for (i = 1; i < FC_GLYPH_PAGE_COUNT; ++i)
+        free(table->pages[i]);
+    FC_MapFree(table->others);
+    free(table);
+}
+
+static_inline FC_GlyphData *FC_GlyphTableFind(FC_GlyphTable *table,
+                                              Uint32 codepoint) {
+    FC_GlyphPage *page;
+    Uint32 u;
+    if (table == NULL)
+        return NULL;
+
+    // ASCII fast path
+    if (codepoint < 0x80)
+        return table->latin1.present[codepoint] ? &table->latin1.glyphs[codepoint]
+                                                : NULL;
+
+    u = FC_UnpackCodepoint(codepoint);
+    if (u == FC_NOT_IN_PAGES)
+        return FC_MapFind(table->others, codepoint);
+
+    page = table->pages[u >> 8];
+    if (page == NULL || !page->present[u & 0xFF])
+        return NULL;
+    return &page->glyphs[u & 0xFF];
+}
+
+static FC_GlyphData *FC_GlyphTableInsert(FC_GlyphTable *table, Uint32 codepoint,
+                                         FC_GlyphData glyph) {
+    FC_GlyphPage *page;
+    Uint32 u;
+    if (table == NULL)
+        return NULL;
+
+    u = FC_UnpackCodepoint(codepoint);
+    if (u == FC_NOT_IN_PAGES) {
+        if (table->others == NULL)
+            table->others = FC_MapCreate(FC_DEFAULT_NUM_BUCKETS);
+        return FC_MapInsert(table->others, codepoint, glyph);
+    }
+
+    page = table->pages[u >> 8];
+    if (page == NULL) {
+        page = table->pages[u >> 8] = (FC_GlyphPage *) calloc(1, sizeof(FC_GlyphPage));
+        if (page == NULL)
+            return NULL;
+    }
+    page->glyphs[u & 0xFF]  = glyph;
+    page->present[u & 0xFF] = 1;
+    return &page->glyphs[u & 0xFF];
+}
+
+// Stores each cached codepoint (in packed form) in result if it is not NULL,
+// returns the count
+static unsigned int FC_GlyphTableForEach(FC_GlyphTable *table, Uint32 *result) {
+    unsigned int count = 0;
+    int i, j;
+    if (table == NULL)
+        return 0;
+
+    for (i = 0; i < FC_GLYPH_PAGE_COUNT; ++i) {
+        FC_GlyphPage *page = table->pages[i];
+        if (page == NULL)
+            continue;
+        for (j = 0; j < FC_GLYPH_PAGE_SIZE; ++j) {
+            if (page->present[j]) {
+                if (result != NULL)
+                    result[count] = FC_PackCodepoint((Uint32) (i << 8 | j));
+                count++;
+            }
+        }
+    }
+
+    if (table->others != NULL) {
+        for (i = 0; i < table->others->num_buckets; ++i) {
+            FC_MapNode *node;
+            for (node = table->others->buckets[i]; node != NULL; node = node->next) {
+                if (result != NULL)
+                    result[count] = node->key;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
 struct FC_Font {
 #ifndef FC_USE_SDL_GPU
     SDL_Renderer *renderer;
@@ -402,8 +551,8 @@ struct FC_Font {
 
     // Uses 32-bit (4-byte) Unicode codepoints to refer to each glyph
     // Codepoints are little endian (reversed from UTF-8) so that something like
-    // 0x00000005 is ASCII 5 and the map can be indexed by ASCII values
-    FC_Map *glyphs;
+    // 0x00000005 is ASCII 5 and the table can be indexed by ASCII values
+    FC_GlyphTable *glyphs;
 
     FC_GlyphData last_glyph; // Texture packing cursor
     int glyph_cache_size;
@@ -420,6 +569,11 @@ static FC_GlyphData *FC_PackGlyphData(FC_Font *font, Uint32 codepoint,
 
 static FC_Rect FC_RenderLeft(FC_Font *font, FC_Target *dest, float x, float y,
                              FC_Scale scale, const char *text);
+static FC_Rect FC_RenderLeftN(FC_Font *font, FC_Target *dest, float x, float y,
+                              FC_Scale scale, const char *text, size_t length);
+static FC_Rect FC_RenderAlignedN(FC_Font *font, FC_Target *dest, float x, float y,
+                                 FC_Scale scale, const char *text, size_t length,
+                                 float factor);
 static FC_Rect FC_RenderCenter(FC_Font *font, FC_Target *dest, float x, float y,
                                FC_Scale scale, const char *text);
 static FC_Rect FC_RenderRight(FC_Font *font, FC_Target *dest, float x, float y,
@@ -784,9 +938,9 @@ static void FC_Init(FC_Font *font) {
     font->last_glyph.cache_level = 0;
 
     if (font->glyphs != NULL)
-        FC_MapFree(font->glyphs);
+        FC_GlyphTableFree(font->glyphs);
 
-    font->glyphs = FC_MapCreate(FC_DEFAULT_NUM_BUCKETS);
+    font->glyphs = FC_GlyphTableCreate();
 
     font->glyph_cache_size  = 3;
     font->glyph_cache_count = 0;
@@ -973,7 +1127,7 @@ Uint8 FC_UploadGlyphCache(FC_Font *font, int cache_level,
 static FC_GlyphData *FC_PackGlyphData(FC_Font *font, Uint32 codepoint,
                                       Uint16 width, Uint16 maxWidth,
                                       Uint16 maxHeight) {
-    FC_Map *glyphs           = font->glyphs;
+    FC_GlyphTable *glyphs    = font->glyphs;
     FC_GlyphData *last_glyph = &font->last_glyph;
     Uint16 height            = font->height + FC_CACHE_PADDING;
 
@@ -1005,7 +1159,7 @@ static FC_GlyphData *FC_PackGlyphData(FC_Font *font, Uint32 codepoint,
     last_glyph->rect.x += last_glyph->rect.w + 1 + FC_CACHE_PADDING;
     last_glyph->rect.w = width;
 
-    return FC_MapInsert(glyphs, codepoint,
+    return FC_GlyphTableInsert(glyphs, codepoint,
                         FC_MakeGlyphData(last_glyph->cache_level,
                                          last_glyph->rect.x, last_glyph->rect.y,
                                          last_glyph->rect.w, last_glyph->rect.h));
@@ -1321,8 +1475,8 @@ void FC_ClearFont(FC_Font *font) {
     font->owns_ttf_source = 0;
     font->ttf_source      = NULL;
 
-    // Delete glyph map
-    FC_MapFree(font->glyphs);
+    // Delete glyph table
+    FC_GlyphTableFree(font->glyphs);
     font->glyphs = NULL;
 
     // Delete glyph cache
@@ -1349,8 +1503,8 @@ void FC_FreeFont(FC_Font *font) {
     if (font->owns_ttf_source)
         TTF_CloseFont(font->ttf_source);
 
-    // Delete glyph map
-    FC_MapFree(font->glyphs);
+    // Delete glyph table
+    FC_GlyphTableFree(font->glyphs);
 
     // Delete glyph cache
     for (i = 0; i < font->glyph_cache_count; ++i) {
@@ -1457,44 +1611,21 @@ Uint8 FC_AddGlyphToCache(FC_Font *font, SDL_Surface *glyph_surface) {
 }
 
 unsigned int FC_GetNumCodepoints(FC_Font *font) {
-    FC_Map *glyphs;
-    int i;
-    unsigned int result = 0;
     if (font == NULL || font->glyphs == NULL)
         return 0;
 
-    glyphs = font->glyphs;
-
-    for (i = 0; i < glyphs->num_buckets; ++i) {
-        FC_MapNode *node;
-        for (node = glyphs->buckets[i]; node != NULL; node = node->next) {
-            result++;
-        }
-    }
-
-    return result;
+    return FC_GlyphTableForEach(font->glyphs, NULL);
 }
 
 void FC_GetCodepoints(FC_Font *font, Uint32 *result) {
-    FC_Map *glyphs;
-    int i;
-    unsigned int count = 0;
-    if (font == NULL || font->glyphs == NULL)
+    if (font == NULL || font->glyphs == NULL || result == NULL)
         return;
 
-    glyphs = font->glyphs;
-
-    for (i = 0; i < glyphs->num_buckets; ++i) {
-        FC_MapNode *node;
-        for (node = glyphs->buckets[i]; node != NULL; node = node->next) {
-            result[count] = node->key;
-            count++;
-        }
-    }
+    FC_GlyphTableForEach(font->glyphs, result);
 }
 
 Uint8 FC_GetGlyphData(FC_Font *font, FC_GlyphData *result, Uint32 codepoint) {
-    FC_GlyphData *e = FC_MapFind(font->glyphs, codepoint);
+    FC_GlyphData *e = FC_GlyphTableFind(font->glyphs, codepoint);
     if (e == NULL) {
         char buff[5];
         int w, h;
@@ -1553,13 +1684,22 @@ Uint8 FC_GetGlyphData(FC_Font *font, FC_GlyphData *result, Uint32 codepoint) {
 
 FC_GlyphData *FC_SetGlyphData(FC_Font *font, Uint32 codepoint,
                               FC_GlyphData glyph_data) {
-    return FC_MapInsert(font->glyphs, codepoint, glyph_data);
+    return FC_GlyphTableInsert(font->glyphs, codepoint, glyph_data);
 }
 
 // Drawing
 static FC_Rect FC_RenderLeft(FC_Font *font, FC_Target *dest, float x, float y,
                              FC_Scale scale, const char *text) {
-    const char *c = text;
+    return FC_RenderLeftN(font, dest, x, y, scale, text,
+                          text == NULL ? 0 : strlen(text));
+}
+
+// Renders 'length' bytes of text, which does not need to be terminated.
+// A multibyte character cut off by the end of the range is not drawn.
+static FC_Rect FC_RenderLeftN(FC_Font *font, FC_Target *dest, float x, float y,
+                              FC_Scale scale, const char *text, size_t length) {
+    const char *c   = text;
+    const char *end = text + length;
     FC_Rect srcRect;
     FC_Rect dstRect;
     FC_Rect dirtyRect = FC_MakeRect(x, y, 0, 0);
@@ -1585,15 +1725,21 @@ static FC_Rect FC_RenderLeft(FC_Font *font, FC_Target *dest, float x, float y,
 
     int newlineX = x;
 
-    for (; *c != '\0'; c++) {
+    for (; c < end; c++) {
         if (*c == '\n') {
             destX = newlineX;
             destY += destH + destLineSpacing;
             continue;
         }
 
-        codepoint = FC_GetCodepointFromUTF8(
-                &c, 1); // Increments 'c' to skip the extra UTF-8 bytes
+        if ((unsigned char) *c < 0x80) {
+            codepoint = (unsigned char) *c; // ASCII fast path
+        } else {
+            if (c + U8_charsize(c) > end)
+                break;
+            codepoint = FC_GetCodepointFromUTF8(
+                    &c, 1); // Increments 'c' to skip the extra UTF-8 bytes
+        }
         if (!FC_GetGlyphData(font, &glyph, codepoint)) {
             codepoint = ' ';
             if (!FC_GetGlyphData(font, &glyph, codepoint))
@@ -2173,76 +2319,45 @@ FC_Rect FC_DrawColumnEffect(FC_Font *font, FC_Target *dest, float x, float y,
     return FC_MakeRect(box.x, box.y, width, total_height);
 }
 
-static FC_Rect FC_RenderCenter(FC_Font *font, FC_Target *dest, float x, float y,
-                               FC_Scale scale, const char *text) {
+// Each line is measured once and then drawn, 'factor' is the part of its width
+// to move left (0.5 centered, 1 right aligned). Works on the caller's buffer, no
+// copy of the text and no formatting pass per line.
+static FC_Rect FC_RenderAlignedN(FC_Font *font, FC_Target *dest, float x, float y,
+                                 FC_Scale scale, const char *text, size_t length,
+                                 float factor) {
     FC_Rect result = {x, y, 0, 0};
     if (text == NULL || font == NULL)
         return result;
 
-    char *str = U8_strdup(text);
-    char *del = str;
-    char *c;
-
-    // Go through str, when you find a \n, replace it with \0 and print it
-    // then move down, back, and continue.
-    for (c = str; *c != '\0';) {
-        if (*c == '\n') {
-            *c     = '\0';
-            result = FC_RectUnion(
-                    FC_RenderLeft(font, dest,
-                                  x - scale.x * FC_GetWidth(font, "%s", str) / 2.0f, y,
-                                  scale, str),
-                    result);
-            *c = '\n';
-            c++;
-            str = c;
-            y += scale.y * font->height;
-        } else
-            c++;
+    const char *line = text;
+    const char *end  = text + length;
+    for (;;) {
+        const char *lineEnd = memchr(line, '\n', end - line);
+        size_t lineLength   = (lineEnd ? lineEnd : end) - line;
+
+        float width = scale.x * FC_GetWidthN(font, line, lineLength);
+        result      = FC_RectUnion(FC_RenderLeftN(font, dest, x - width * factor, y,
+                                                  scale, line, lineLength),
+                                   result);
+        if (lineEnd == NULL)
+            break;
+        line = lineEnd + 1;
+        y += scale.y * font->height;
     }
 
-    result = FC_RectUnion(
-            FC_RenderLeft(font, dest,
-                          x - scale.x * FC_GetWidth(font, "%s", str) / 2.0f, y, scale,
-                          str),
-            result);
-
-    free(del);
     return result;
 }
 
+static FC_Rect FC_RenderCenter(FC_Font *font, FC_Target *dest, float x, float y,
+                               FC_Scale scale, const char *text) {
+    return FC_RenderAlignedN(font, dest, x, y, scale, text,
+                             text == NULL ? 0 : strlen(text), 0.5f);
+}
+
 static FC_Rect FC_RenderRight(FC_Font *font, FC_Target *dest, float x, float y,
                               FC_Scale scale, const char *text) {
-    FC_Rect result = {x, y, 0, 0};
-    if (text == NULL || font == NULL)
-        return result;
-
-    char *str = U8_strdup(text);
-    char *del = str;
-    char *c;
-
-    for (c = str; *c != '\0';) {
-        if (*c == '\n') {
-            *c     = '\0';
-            result = FC_RectUnion(
-                    FC_RenderLeft(font, dest, x - scale.x * FC_GetWidth(font, "%s", str),
-                                  y, scale, str),
-                    result);
-            *c = '\n';
-            c++;
-            str = c;
-            y += scale.y * font->height;
-        } else
-            c++;
-    }
-
-    result = FC_RectUnion(
-            FC_RenderLeft(font, dest, x - scale.x * FC_GetWidth(font, "%s", str), y,
-                          scale, str),
-            result);
-
-    free(del);
-    return result;
+    return FC_RenderAlignedN(font, dest, x, y, scale, text,
+                             text == NULL ? 0 : strlen(text), 1.0f);
 }
 
 FC_Rect FC_DrawScale(FC_Font *font, FC_Target *dest, float x, float y,
@@ -2325,6 +2440,25 @@ FC_Rect FC_DrawEffect(FC_Font *font, FC_Target *dest, float x, float y,
     return result;
 }
 
+FC_Rect FC_DrawEffectN(FC_Font *font, FC_Target *dest, float x, float y,
+                       FC_Effect effect, const char *text, size_t length) {
+    if (text == NULL || font == NULL)
+        return FC_MakeRect(x, y, 0, 0);
+
+    set_color_for_all_caches(font, effect.color);
+
+    switch (effect.alignment) {
+        case FC_ALIGN_LEFT:
+            return FC_RenderLeftN(font, dest, x, y, effect.scale, text, length);
+        case FC_ALIGN_CENTER:
+            return FC_RenderAlignedN(font, dest, x, y, effect.scale, text, length, 0.5f);
+        case FC_ALIGN_RIGHT:
+            return FC_RenderAlignedN(font, dest, x, y, effect.scale, text, length, 1.0f);
+        default:
+            return FC_MakeRect(x, y, 0, 0);
+    }
+}
+
 // Getters
 
 FC_FilterEnum FC_GetFilterMode(FC_Font *font) {
@@ -2366,11 +2500,19 @@ Uint16 FC_GetWidth(FC_Font *font, const char *formatted_text, ...) {
 
     FC_EXTRACT_VARARGS(fc_buffer, formatted_text);
 
+    return FC_GetWidthN(font, fc_buffer, strlen(fc_buffer));
+}
+
+Uint16 FC_GetWidthN(FC_Font *font, const char *text, size_t length) {
+    if (text == NULL || font == NULL)
+        return 0;
+
     const char *c;
+    const char *end = text + length;
     Uint16 width    = 0;
     Uint16 bigWidth = 0; // Allows for multi-line strings
 
-    for (c = fc_buffer; *c != '\0'; c++) {
+    for (c = text; c < end; c++) {
         if (*c == '\n') {
             bigWidth = bigWidth >= width ? bigWidth : width;
             width    = 0;
@@ -2378,7 +2520,14 @@ Uint16 FC_GetWidth(FC_Font *font, const char *formatted_text, ...) {
         }
 
         FC_GlyphData glyph;
-        Uint32 codepoint = FC_GetCodepointFromUTF8(&c, 1);
+        Uint32 codepoint;
+        if ((unsigned char) *c < 0x80) {
+            codepoint = (unsigned char) *c; // ASCII fast path
+        } else {
+            if (c + U8_charsize(c) > end)
+                break;
+            codepoint = FC_GetCodepointFromUTF8(&c, 1);
+        }
         if (FC_GetGlyphData(font, &glyph, codepoint) ||
             FC_GetGlyphData(font, &glyph, ' '))
             width += glyph.rect.w;
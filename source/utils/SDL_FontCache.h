@@ -282,6 +282,14 @@ FC_Rect FC_DrawColor(FC_Font *font, FC_Target *dest, float x, float y,
 FC_Rect FC_DrawEffect(FC_Font *font, FC_Target *dest, float x, float y,
                       FC_Effect effect, const char *formatted_text, ...);
 
+/*!
+Same as FC_DrawEffect, but draws 'length' bytes of 'text' as they are: no
+printf formatting, and the text does not need to be terminated. Aligned lines
+are measured once each. The returned rect covers the drawn glyphs.
+*/
+FC_Rect FC_DrawEffectN(FC_Font *font, FC_Target *dest, float x, float y,
+                       FC_Effect effect, const char *text, size_t length);
+
 FC_Rect FC_DrawBox(FC_Font *font, FC_Target *dest, FC_Rect box,
                    const char *formatted_text, ...);
 FC_Rect FC_DrawBoxAlign(FC_Font *font, FC_Target *dest, FC_Rect box,
@@ -314,6 +322,8 @@ FC_FilterEnum FC_GetFilterMode(FC_Font *font);
 Uint16 FC_GetLineHeight(FC_Font *font);
 Uint16 FC_GetHeight(FC_Font *font, const char *formatted_text, ...);
 Uint16 FC_GetWidth(FC_Font *font, const char *formatted_text, ...);
+// Same as FC_GetWidth for 'length' bytes of unformatted, unterminated text
+Uint16 FC_GetWidthN(FC_Font *font, const char *text, size_t length);
 
 // Returns a 1-pixel wide box in front of the character in the given position
 // (index)
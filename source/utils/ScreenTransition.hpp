@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Animation.hpp"
+#include "TextureRegistry.hpp"
+#include <SDL2/SDL.h>
 #include <memory>
 
 class Screen;
@@ -17,15 +19,26 @@ public:
         : mType(NONE)
         , mActive(false)
         , mOldScreen(nullptr)
-        , mNewScreen(nullptr) {
+        , mNewScreen(nullptr)
+        , mOldSnapshot(nullptr) {
         mAnimation.SetImmediate(0.0f);
     }
 
+    ~ScreenTransition() {
+        ReleaseSnapshot();
+    }
+
+    ScreenTransition(const ScreenTransition&) = delete;
+    ScreenTransition& operator=(const ScreenTransition&) = delete;
+
     // Start transition
-    void Start(Type type, Screen* oldScreen, Screen* newScreen) {
+    // oldSnapshot: 旧界面的静态画面 (Gfx::CaptureScreen), 切换期间代替旧界面绘制, 由切换负责释放
+    void Start(Type type, Screen* oldScreen, Screen* newScreen, SDL_Texture* oldSnapshot = nullptr) {
+        ReleaseSnapshot();
         mType = type;
         mOldScreen = oldScreen;
         mNewScreen = newScreen;
+        mOldSnapshot = oldSnapshot;
         mActive = true;
         mAnimation.SetImmediate(0.0f);
         mAnimation.SetTarget(1.0f, 250);  // 250ms duration - optimized for smoother performance
@@ -38,6 +51,7 @@ public:
             if (mAnimation.GetValue() >= 0.99f) {
                 mActive = false;
                 mOldScreen = nullptr;
+                ReleaseSnapshot();
             }
         }
     }
@@ -63,10 +77,23 @@ public:
         return mNewScreen;
     }
 
+    // 旧界面的静态画面, 没有时为 nullptr (需要实时绘制旧界面)
+    SDL_Texture* GetOldSnapshot() const {
+        return mOldSnapshot;
+    }
+
 private:
+    void ReleaseSnapshot() {
+        if (mOldSnapshot) {
+            TextureRegistry::Destroy(mOldSnapshot);
+            mOldSnapshot = nullptr;
+        }
+    }
+
     Type mType;
     bool mActive;
     Animation mAnimation;
     Screen* mOldScreen;
     Screen* mNewScreen;
+    SDL_Texture* mOldSnapshot;
 };
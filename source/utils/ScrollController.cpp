@@ -0,0 +1,177 @@
+#include "ScrollController.hpp"
+#include "Animation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static constexpr float REST_EPSILON_PX = 0.5f;   // 离目标不到半个像素时停下
+
+void ScrollController::SetLimits(int itemCount, int visibleCount) {
+    mMaxRow = (float)std::max(0, itemCount - visibleCount);
+    // 列表变短时停在新的末尾; 拖动中松开后再弹回
+    if (mMode == MODE_IDLE) {
+        mPosition = ClampRow(mPosition);
+    }
+    mTarget = ClampRow(mTarget);
+}
+
+float ScrollController::ClampRow(float row) const {
+    return std::max(0.0f, std::min(row, mMaxRow));
+}
+
+void ScrollController::MoveTo(float target, Mode mode) {
+    mTarget = target;
+    mMode = mode;
+    mLastUpdateMs = Animation::FrameTimeMs();
+}
+
+void ScrollController::Jump(int row) {
+    mPosition = ClampRow((float)row);
+    mTarget = mPosition;
+    if (mMode != MODE_DRAG) {
+        mMode = MODE_IDLE;
+        mVelocity = 0.0f;
+    }
+}
+
+void ScrollController::ScrollTo(int row) {
+    float target = ClampRow((float)row);
+    if (mMode == MODE_IDLE && target == mPosition) {
+        return;
+    }
+    mTouchScrolled = false;
+    MoveTo(target, MODE_SETTLE);
+}
+
+void ScrollController::TouchDown(int y) {
+    mCaught = (mMode == MODE_FLING);
+    mTouchScrolled = mTouchScrolled || mCaught;
+    mMode = MODE_DRAG;
+    mVelocity = 0.0f;
+    mDownY = y;
+    mLastY = y;
+    mLastMoveMs = Animation::FrameTimeMs();
+    mMoved = false;
+}
+
+void ScrollController::TouchMove(int y) {
+    if (mMode != MODE_DRAG || y == mLastY) {
+        return;
+    }
+    if (!mMoved) {
+        if (std::abs(y - mDownY) <= TAP_SLOP_PX) {
+            return;
+        }
+        mMoved = true;
+        mTouchScrolled = true;
+    }
+    // 手指向上移动时列表向后滚动
+    float delta = (float)(mLastY - y) / mRowHeight;
+    mLastY = y;
+
+    // 超出两端时只跟随一半的移动
+    float next = mPosition + delta;
+    if (next < 0.0f || next > mMaxRow) {
+        next = mPosition + delta * 0.5f;
+    }
+    mPosition = std::max(-OVERSCROLL_ROWS, std::min(next, mMaxRow + OVERSCROLL_ROWS));
+
+    // 速度按触摸点到达的时间估计, 并和之前的估计平滑, 单个抖动的采样不会决定滑行距离
+    uint64_t now = Animation::FrameTimeMs();
+    if (now > mLastMoveMs) {
+        float instant = delta / (float)(now - mLastMoveMs);
+        mVelocity = 0.8f * instant + 0.2f * mVelocity;
+        mLastMoveMs = now;
+    }
+}
+
+bool ScrollController::TouchUp() {
+    if (mMode != MODE_DRAG) {
+        return false;
+    }
+    bool tap = !mMoved && !mCaught;
+    if (Animation::FrameTimeMs() - mLastMoveMs > STOP_MS) {
+        mVelocity = 0.0f;
+    }
+    float velocity = std::max(-MAX_FLING_VELOCITY, std::min(mVelocity, MAX_FLING_VELOCITY));
+    mVelocity = 0.0f;
+    if (std::fabs(velocity) < MIN_FLING_VELOCITY) {
+        MoveTo(ClampRow(std::round(mPosition)), MODE_SETTLE);
+    } else {
+        // 停下的位置取整到行, 滑行按到达这一行来衰减 (和 GetRestingRow 的预测一致)
+        MoveTo(ClampRow(std::round(mPosition + velocity * DECAY_MS)), MODE_FLING);
+    }
+    return tap;
+}
+
+void ScrollController::Update() {
+    if (mMode == MODE_IDLE || mMode == MODE_DRAG) {
+        return;
+    }
+    Animation::MarkActivity();
+    uint64_t now = Animation::FrameTimeMs();
+    uint64_t step = std::min(now - mLastUpdateMs, MAX_STEP_MS);
+    mLastUpdateMs = now;
+
+    // 指数趋近目标: 剩余距离每 timeConstant 毫秒变为 1/e, 速度随剩余距离一起衰减
+    float timeConstant = (mMode == MODE_FLING) ? DECAY_MS : SNAP_MS;
+    float remaining = mTarget - mPosition;
+    remaining *= std::exp(-(float)step / timeConstant);
+    if (std::fabs(remaining) * mRowHeight < REST_EPSILON_PX) {
+        mPosition = mTarget;
+        mMode = MODE_IDLE;
+        return;
+    }
+    mPosition = mTarget - remaining;
+}
+
+int ScrollController::GetFirstRow() const {
+    return (int)std::floor(mPosition);
+}
+
+int ScrollController::GetRestingRow() const {
+    switch (mMode) {
+        case MODE_FLING:
+        case MODE_SETTLE:
+            return (int)mTarget;
+        case MODE_DRAG: {
+            float velocity = std::max(-MAX_FLING_VELOCITY, std::min(mVelocity, MAX_FLING_VELOCITY));
+            if (std::fabs(velocity) < MIN_FLING_VELOCITY) {
+                velocity = 0.0f;
+            }
+            return (int)ClampRow(std::round(mPosition + velocity * DECAY_MS));
+        }
+        default:
+            return (int)ClampRow(std::round(mPosition));
+    }
+}
+
+bool ScrollController::ConsumeTouchSettled() {
+    if (!mTouchScrolled || mMode != MODE_IDLE) {
+        return false;
+    }
+    mTouchScrolled = false;
+    return true;
+}
+
+bool KeyRepeat::Update(bool pressed, bool held) {
+    uint64_t now = Animation::FrameTimeMs();
+    if (pressed) {
+        mHolding = true;
+        mNextRepeatMs = now + DELAY_MS;
+        return true;
+    }
+    if (!held) {
+        mHolding = false;
+        return false;
+    }
+    if (!mHolding || now < mNextRepeatMs) {
+        return false;
+    }
+    // 卡顿后不补回错过的次数
+    mNextRepeatMs += INTERVAL_MS;
+    if (mNextRepeatMs <= now) {
+        mNextRepeatMs = now + INTERVAL_MS;
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+
+// 列表的滚动位置 (以行为单位的小数): 按键时平滑移动到目标行, 触摸拖动时跟着手指, 松开后按速度惯性滑行并减速, 最后停在整行上
+// 全部按时间戳 (Animation::FrameTimeMs) 计算, 和帧率无关
+// 惯性滑行是按指数衰减的速度走完 速度 * DECAY_MS 的距离, 松开时就知道会停在哪一行 (GetRestingRow),
+// 缩略图的预取和卡片的准备按停下的位置进行, 而不是按滑行途中经过的行
+class ScrollController {
+public:
+    static constexpr float DECAY_MS = 325.0f;        // 惯性滑行的时间常数, 滑行距离 = 松开时的速度 * DECAY_MS
+    static constexpr float SNAP_MS = 70.0f;          // 按键或松开时速度很小: 移动到目标行的时间常数
+    static constexpr float MIN_FLING_VELOCITY = 0.002f;   // 行/毫秒, 松开时低于这个速度不滑行, 直接对齐到最近的行
+    static constexpr float MAX_FLING_VELOCITY = 0.08f;    // 行/毫秒, 一次最多滑过约 26 行
+    static constexpr float OVERSCROLL_ROWS = 0.3f;   // 拖过两端时最多超出的距离 (有阻力, 松开后弹回)
+    static constexpr int TAP_SLOP_PX = 24;           // 移动不超过这个距离的触摸算作点击
+    static constexpr uint64_t STOP_MS = 80;          // 松开前手指停住这么久时不滑行
+    static constexpr uint64_t MAX_STEP_MS = 100;     // 两帧的间隔超过这么久 (加载卡顿) 时按这么久计算
+
+    // rowHeight: 一行的高度 (卡片加间距, 像素), 用来把手指的移动换算成行
+    explicit ScrollController(float rowHeight) : mRowHeight(rowHeight) {}
+
+    // 列表长度或可见行数改变时调用, 之后的目标按新的范围限制
+    void SetLimits(int itemCount, int visibleCount);
+
+    // 直接跳到 row (列表内容改变、循环到另一端); 拖动中只移动位置
+    void Jump(int row);
+    // 平滑移动到 row (按键导航), 会打断惯性滑行
+    void ScrollTo(int row);
+
+    // 触摸, y 为屏幕坐标; 按下时正在惯性滑行则停住, 这次触摸不算点击
+    void TouchDown(int y);
+    void TouchMove(int y);
+    // 松开: 开始惯性滑行或弹回; 返回这次触摸是否是点击 (没有拖动)
+    bool TouchUp();
+    bool IsDragging() const { return mMode == MODE_DRAG; }
+
+    // 每帧调用一次; 移动中时标记动画活动, 主循环不会跳过绘制
+    void Update();
+
+    float GetPosition() const { return mPosition; }
+    // 最上面露出的行 (可能只露出一部分, 拖过开头时为 -1)
+    int GetFirstRow() const;
+    // 停下时最上面的行; 拖动中按现在松开时的速度预测
+    int GetRestingRow() const;
+    bool IsMoving() const { return mMode != MODE_IDLE; }
+
+    // 触摸引起的滚动已经停下 (每次只返回一次 true): 选中项可能已经不在屏幕上
+    bool ConsumeTouchSettled();
+
+private:
+    enum Mode {
+        MODE_IDLE,
+        MODE_DRAG,
+        MODE_FLING,    // 以 DECAY_MS 减速到 mTarget
+        MODE_SETTLE    // 以 SNAP_MS 移动到 mTarget
+    };
+
+    float ClampRow(float row) const;
+    void MoveTo(float target, Mode mode);
+
+    float mRowHeight;
+    float mMaxRow = 0.0f;
+    float mPosition = 0.0f;
+    float mTarget = 0.0f;
+    float mVelocity = 0.0f;      // 行/毫秒, 只在拖动中估计
+    Mode mMode = MODE_IDLE;
+    uint64_t mLastUpdateMs = 0;
+
+    int mDownY = 0;
+    int mLastY = 0;
+    uint64_t mLastMoveMs = 0;
+    bool mMoved = false;         // 超出 TAP_SLOP_PX
+    bool mCaught = false;        // 按下时停住了惯性滑行
+    bool mTouchScrolled = false;
+};
+
+// 长按方向键时的连续移动: 按下时移动一次, 按住 DELAY_MS 后每 INTERVAL_MS 移动一次, 按时间计算, 和帧率无关
+class KeyRepeat {
+public:
+    static constexpr uint64_t DELAY_MS = 500;
+    static constexpr uint64_t INTERVAL_MS = 100;
+
+    // 每帧调用一次, pressed 为这一帧刚按下, held 为按住; 返回这一帧是否应该移动
+    bool Update(bool pressed, bool held);
+
+private:
+    uint64_t mNextRepeatMs = 0;
+    bool mHolding = false;
+};
@@ -1,184 +1,624 @@
 #include "SimpleJsonParser.hpp"
 #include <cstring>
 #include <cctype>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
 
-void SimpleJsonParser::SkipWhitespace(const char*& ptr) {
-    while (*ptr && std::isspace(*ptr)) {
-        ptr++;
-    }
+const JsonValue JsonValue::sNull;
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    return (mType == JSON_ARRAY && index < mCount) ? mItems[index] : sNull;
 }
 
-std::string SimpleJsonParser::UnescapeString(const std::string& str) {
-    std::string result;
-    result.reserve(str.length());
-    
-    for (size_t i = 0; i < str.length(); i++) {
-        if (str[i] == '\\' && i + 1 < str.length()) {
-            switch (str[i + 1]) {
-                case 'n': result += '\n'; break;
-                case 't': result += '\t'; break;
-                case 'r': result += '\r'; break;
-                case '"': result += '"'; break;
-                case '\\': result += '\\'; break;
-                case '/': result += '/'; break;
-                default: result += str[i + 1]; break;
+const JsonValue& JsonValue::operator[](std::string_view key) const {
+    const JsonValue* value = Find(key);
+    return value ? *value : sNull;
+}
+
+const JsonMember* JsonValue::begin() const {
+    return mType == JSON_OBJECT ? mMembers : nullptr;
+}
+
+const JsonMember* JsonValue::end() const {
+    return mType == JSON_OBJECT ? mMembers + mCount : nullptr;
+}
+
+const JsonValue* JsonValue::Find(std::string_view key) const {
+    if (mType != JSON_OBJECT) {
+        return nullptr;
+    }
+    if (mCount <= SORTED_OBJECT_THRESHOLD) {
+        for (uint32_t i = 0; i < mCount; i++) {
+            if (mMembers[i].name() == key) {
+                return &mMembers[i].value;
             }
-            i++;
-        } else {
-            result += str[i];
         }
+        return nullptr;
     }
-    
+    const JsonMember* it = std::lower_bound(mMembers, mMembers + mCount, key,
+        [](const JsonMember& member, std::string_view k) { return member.name() < k; });
+    return (it != mMembers + mCount && it->name() == key) ? &it->value : nullptr;
+}
+
+void* JsonDocument::Allocate(size_t bytes) {
+    bytes = (bytes + 7) & ~(size_t)7;
+    if (bytes > mRemaining) {
+        // 大的数组单独占一块, 不浪费当前块剩下的空间
+        if (bytes > BLOCK_SIZE / 4) {
+            mBlocks.emplace_back(new char[bytes]);
+            return mBlocks.back().get();
+        }
+        mBlocks.emplace_back(new char[BLOCK_SIZE]);
+        mCursor = mBlocks.back().get();
+        mRemaining = BLOCK_SIZE;
+    }
+    void* result = mCursor;
+    mCursor += bytes;
+    mRemaining -= bytes;
     return result;
 }
 
-JsonValue SimpleJsonParser::ParseString(const char*& ptr) {
-    JsonValue value;
-    value.type = JSON_STRING;
-    
-    ptr++; // Skip opening quote
-    
-    std::string str;
-    while (*ptr && *ptr != '"') {
-        if (*ptr == '\\' && *(ptr + 1)) {
-            str += *ptr++;
-            str += *ptr++;
-        } else {
-            str += *ptr++;
+const char* SimpleJsonParser::CopyString(JsonDocument& doc, std::string_view str) {
+    char* copy = (char*)doc.Allocate(str.size() + 1);
+    memcpy(copy, str.data(), str.size());
+    copy[str.size()] = '\0';
+    return copy;
+}
+
+void SimpleJsonParser::ParseValue(JsonReader& reader, JsonDocument& doc, JsonValue& value, BuildStacks& stacks) {
+    switch (reader.Peek()) {
+        case JSON_STRING: {
+            std::string_view str;
+            if (reader.ReadString(str)) {
+                value.mType = JSON_STRING;
+                value.mString = CopyString(doc, str);
+                value.mCount = str.size();
+            }
+            break;
+        }
+        case JSON_NUMBER: {
+            double number;
+            if (reader.ReadNumber(number)) {
+                value.mType = JSON_NUMBER;
+                value.mNumber = number;
+            }
+            break;
+        }
+        case JSON_BOOL: {
+            bool b;
+            if (reader.ReadBool(b)) {
+                value.mType = JSON_BOOL;
+                value.mBool = b;
+            }
+            break;
+        }
+        case JSON_ARRAY: {
+            reader.EnterArray();
+            size_t base = stacks.items.size();
+            while (reader.NextElement()) {
+                JsonValue item;
+                ParseValue(reader, doc, item, stacks);
+                stacks.items.push_back(item);
+            }
+            
+            uint32_t count = stacks.items.size() - base;
+            JsonValue* items = (JsonValue*)doc.Allocate(count * sizeof(JsonValue));
+            std::copy(stacks.items.begin() + base, stacks.items.end(), items);
+            stacks.items.resize(base);
+            
+            value.mType = JSON_ARRAY;
+            value.mItems = items;
+            value.mCount = count;
+            break;
         }
+        case JSON_OBJECT: {
+            reader.EnterObject();
+            size_t base = stacks.members.size();
+            std::string_view key;
+            while (reader.NextMember(key)) {
+                JsonMember member;
+                member.key = CopyString(doc, key); // 读取值会覆盖 key 指向的缓冲
+                member.keyLength = key.size();
+                ParseValue(reader, doc, member.value, stacks);
+                stacks.members.push_back(member);
+            }
+            
+            uint32_t count = stacks.members.size() - base;
+            JsonMember* members = (JsonMember*)doc.Allocate(count * sizeof(JsonMember));
+            std::copy(stacks.members.begin() + base, stacks.members.end(), members);
+            stacks.members.resize(base);
+            if (count > JsonValue::SORTED_OBJECT_THRESHOLD) {
+                // 稳定排序, 重复的键以第一个为准
+                std::stable_sort(members, members + count, [](const JsonMember& a, const JsonMember& b) {
+                    return a.name() < b.name();
+                });
+            }
+            
+            value.mType = JSON_OBJECT;
+            value.mMembers = members;
+            value.mCount = count;
+            break;
+        }
+        default:
+            reader.Skip(); // null
+            break;
+    }
+}
+
+JsonDocument SimpleJsonParser::Parse(std::string_view json) {
+    JsonDocument doc;
+    JsonReader reader(json);
+    BuildStacks stacks;
+    ParseValue(reader, doc, doc.mRoot, stacks);
+    doc.mError = reader.HasError();
+    return doc;
+}
+
+JsonReader::JsonReader(std::string_view json)
+    : mPtr(json.data()), mEnd(json.data() + json.size()) {
+}
+
+void JsonReader::SkipWhitespace() {
+    while (mPtr < mEnd && (*mPtr == ' ' || *mPtr == '\n' || *mPtr == '\r' || *mPtr == '\t')) {
+        mPtr++;
+    }
+}
+
+bool JsonReader::Fail() {
+    mError = true;
+    mPtr = mEnd;
+    return false;
+}
+
+JsonType JsonReader::Peek() {
+    SkipWhitespace();
+    if (mError || mPtr >= mEnd) {
+        return JSON_NULL;
+    }
+    switch (*mPtr) {
+        case '"': return JSON_STRING;
+        case '{': return JSON_OBJECT;
+        case '[': return JSON_ARRAY;
+        case 't':
+        case 'f': return JSON_BOOL;
+        case 'n': return JSON_NULL;
+        default:  return JSON_NUMBER;
+    }
+}
+
+bool JsonReader::EnterObject() {
+    if (Peek() != JSON_OBJECT) {
+        return false;
+    }
+    mPtr++;
+    return true;
+}
+
+bool JsonReader::NextMember(std::string_view& key) {
+    SkipWhitespace();
+    if (mPtr >= mEnd) {
+        return Fail();
+    }
+    if (*mPtr == '}') {
+        mPtr++;
+        return false;
+    }
+    if (*mPtr == ',') {
+        mPtr++;
+        SkipWhitespace();
     }
     
-    if (*ptr == '"') ptr++; // Skip closing quote
+    if (mPtr >= mEnd || *mPtr != '"' || !ReadString(key)) {
+        return Fail();
+    }
+    SkipWhitespace();
+    if (mPtr >= mEnd || *mPtr != ':') {
+        return Fail();
+    }
+    mPtr++;
+    return true;
+}
+
+bool JsonReader::FindMember(std::string_view key) {
+    std::string_view name;
+    while (NextMember(name)) {
+        if (name == key) {
+            return true;
+        }
+        Skip();
+    }
+    return false;
+}
+
+bool JsonReader::EnterArray() {
+    if (Peek() != JSON_ARRAY) {
+        return false;
+    }
+    mPtr++;
+    return true;
+}
+
+bool JsonReader::NextElement() {
+    SkipWhitespace();
+    if (mPtr >= mEnd) {
+        return Fail();
+    }
+    if (*mPtr == ']') {
+        mPtr++;
+        return false;
+    }
+    if (*mPtr == ',') {
+        mPtr++;
+        SkipWhitespace();
+        if (mPtr >= mEnd) {
+            return Fail();
+        }
+    }
+    return true;
+}
+
+bool JsonReader::ScanString(std::string_view& raw, bool& escaped) {
+    const char* start = ++mPtr; // 跳过 '"'
+    escaped = false;
+    while (mPtr < mEnd && *mPtr != '"') {
+        if (*mPtr == '\\') {
+            escaped = true;
+            mPtr++;
+        }
+        mPtr++;
+    }
+    if (mPtr >= mEnd) {
+        return Fail();
+    }
+    raw = std::string_view(start, mPtr - start);
+    mPtr++; // 跳过 '"'
+    return true;
+}
+
+// 把一个码位按 UTF-8 追加到 out
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+static bool ParseHex4(const char* p, uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+bool JsonReader::Unescape(std::string_view raw, std::string& out) {
+    out.clear();
+    out.reserve(raw.size());
     
-    value.stringValue = UnescapeString(str);
-    return value;
+    const char* p = raw.data();
+    const char* end = p + raw.size();
+    while (p < end) {
+        if (*p != '\\') {
+            out += *p++;
+            continue;
+        }
+        if (++p >= end) {
+            return Fail();
+        }
+        char c = *p++;
+        switch (c) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                uint32_t cp;
+                if (end - p < 4 || !ParseHex4(p, cp)) {
+                    return Fail();
+                }
+                p += 4;
+                // 代理对
+                uint32_t low;
+                if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                    ParseHex4(p + 2, low) && low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default: out += c; break; // '"' '\\' '/'
+        }
+    }
+    return true;
 }
 
-JsonValue SimpleJsonParser::ParseNumber(const char*& ptr) {
-    JsonValue value;
-    value.type = JSON_NUMBER;
+bool JsonReader::ReadString(std::string_view& value) {
+    if (Peek() != JSON_STRING) {
+        return false;
+    }
+    std::string_view raw;
+    bool escaped;
+    if (!ScanString(raw, escaped)) {
+        return false;
+    }
+    if (!escaped) {
+        value = raw;
+        return true;
+    }
+    if (!Unescape(raw, mScratch)) {
+        return false;
+    }
+    value = mScratch;
+    return true;
+}
+
+bool JsonReader::ReadString(std::string& value) {
+    if (Peek() != JSON_STRING) {
+        return false;
+    }
+    std::string_view raw;
+    bool escaped;
+    if (!ScanString(raw, escaped)) {
+        return false;
+    }
+    if (!escaped) {
+        value.assign(raw.data(), raw.size());
+        return true;
+    }
+    return Unescape(raw, value);
+}
+
+bool JsonReader::ReadNumber(double& value) {
+    if (Peek() != JSON_NUMBER) {
+        return false;
+    }
+    // 原文不一定以 '\0' 结尾, 复制到局部缓冲再转换
+    char buffer[64];
+    size_t length = 0;
+    while (mPtr + length < mEnd && length < sizeof(buffer) - 1 &&
+           (std::isdigit((unsigned char)mPtr[length]) || std::strchr("+-.eE", mPtr[length]))) {
+        length++;
+    }
+    if (length == 0) {
+        return Fail();
+    }
+    memcpy(buffer, mPtr, length);
+    buffer[length] = '\0';
     
     char* end;
-    value.numberValue = std::strtod(ptr, &end);
-    ptr = end;
-    
-    return value;
+    value = std::strtod(buffer, &end);
+    if (end == buffer) {
+        return Fail();
+    }
+    mPtr += end - buffer;
+    return true;
 }
 
-JsonValue SimpleJsonParser::ParseBool(const char*& ptr) {
-    JsonValue value;
-    value.type = JSON_BOOL;
-    
-    if (std::strncmp(ptr, "true", 4) == 0) {
-        value.boolValue = true;
-        ptr += 4;
-    } else if (std::strncmp(ptr, "false", 5) == 0) {
-        value.boolValue = false;
-        ptr += 5;
+bool JsonReader::ReadInt(int& value) {
+    double number;
+    if (!ReadNumber(number)) {
+        return false;
     }
-    
-    return value;
+    value = (int)number;
+    return true;
 }
 
-JsonValue SimpleJsonParser::ParseNull(const char*& ptr) {
-    JsonValue value;
-    value.type = JSON_NULL;
-    ptr += 4; // Skip "null"
-    return value;
+bool JsonReader::ReadBool(bool& value) {
+    if (Peek() != JSON_BOOL) {
+        return false;
+    }
+    if (mEnd - mPtr >= 4 && std::strncmp(mPtr, "true", 4) == 0) {
+        value = true;
+        mPtr += 4;
+    } else if (mEnd - mPtr >= 5 && std::strncmp(mPtr, "false", 5) == 0) {
+        value = false;
+        mPtr += 5;
+    } else {
+        return Fail();
+    }
+    return true;
 }
 
-JsonValue SimpleJsonParser::ParseArray(const char*& ptr) {
-    JsonValue value;
-    value.type = JSON_ARRAY;
-    
-    ptr++; // Skip '['
-    SkipWhitespace(ptr);
+void JsonReader::Skip() {
+    SkipWhitespace();
+    if (mError || mPtr >= mEnd) {
+        Fail();
+        return;
+    }
     
-    if (*ptr == ']') {
-        ptr++;
-        return value;
+    if (*mPtr == '"') {
+        std::string_view raw;
+        bool escaped;
+        ScanString(raw, escaped);
+        return;
     }
     
-    while (*ptr) {
-        value.arrayValue.push_back(ParseValue(ptr));
-        SkipWhitespace(ptr);
-        
-        if (*ptr == ',') {
-            ptr++;
-            SkipWhitespace(ptr);
-        } else if (*ptr == ']') {
-            ptr++;
-            break;
-        } else {
-            break;
+    if (*mPtr == '{' || *mPtr == '[') {
+        // 只按括号计数, 引号内的括号不算
+        int depth = 0;
+        while (mPtr < mEnd) {
+            char c = *mPtr;
+            if (c == '"') {
+                std::string_view raw;
+                bool escaped;
+                if (!ScanString(raw, escaped)) {
+                    return;
+                }
+                continue;
+            }
+            mPtr++;
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    return;
+                }
+            }
         }
+        Fail();
+        return;
     }
     
-    return value;
+    // 数字、true、false、null
+    const char* start = mPtr;
+    while (mPtr < mEnd && *mPtr != ',' && *mPtr != '}' && *mPtr != ']' &&
+           *mPtr != ' ' && *mPtr != '\n' && *mPtr != '\r' && *mPtr != '\t') {
+        mPtr++;
+    }
+    if (mPtr == start) {
+        Fail();
+    }
 }
 
-JsonValue SimpleJsonParser::ParseObject(const char*& ptr) {
-    JsonValue value;
-    value.type = JSON_OBJECT;
-    
-    ptr++; // Skip '{'
-    SkipWhitespace(ptr);
-    
-    if (*ptr == '}') {
-        ptr++;
-        return value;
+JsonArrayStream::JsonArrayStream(std::vector<std::string> path, std::function<void(std::string_view)> onElement)
+    : mPath(std::move(path)), mOnElement(std::move(onElement)) {
+}
+
+bool JsonArrayStream::PathMatches() const {
+    if (mStack.size() != mPath.size()) {
+        return false;
     }
-    
-    while (*ptr) {
-        SkipWhitespace(ptr);
-        
-        // Parse key
-        if (*ptr != '"') break;
-        JsonValue key = ParseString(ptr);
-        
-        SkipWhitespace(ptr);
-        if (*ptr != ':') break;
-        ptr++; // Skip ':'
-        
-        // Parse value
-        SkipWhitespace(ptr);
-        value.objectValue[key.stringValue] = ParseValue(ptr);
-        
-        SkipWhitespace(ptr);
-        if (*ptr == ',') {
-            ptr++;
-        } else if (*ptr == '}') {
-            ptr++;
-            break;
-        } else {
-            break;
+    for (size_t i = 0; i < mStack.size(); i++) {
+        if (!mStack[i].isObject || mStack[i].key != mPath[i]) {
+            return false;
         }
     }
-    
-    return value;
+    return true;
 }
 
-JsonValue SimpleJsonParser::ParseValue(const char*& ptr) {
-    SkipWhitespace(ptr);
-    
-    if (*ptr == '"') {
-        return ParseString(ptr);
-    } else if (*ptr == '{') {
-        return ParseObject(ptr);
-    } else if (*ptr == '[') {
-        return ParseArray(ptr);
-    } else if (*ptr == 't' || *ptr == 'f') {
-        return ParseBool(ptr);
-    } else if (*ptr == 'n') {
-        return ParseNull(ptr);
-    } else if (*ptr == '-' || std::isdigit(*ptr)) {
-        return ParseNumber(ptr);
+void JsonArrayStream::EmitElement() {
+    if (!mElement.empty()) {
+        mOnElement(mElement);
+        mElement.clear();
+    }
+}
+
+void JsonArrayStream::FeedElement(char c) {
+    if (mElementDepth == 0 && !mInString) {
+        // 元素之间
+        if (c == ']') {
+            EmitElement(); // 最后一个元素是数字等简单值时
+            mCapturing = false;
+            mFinished = true;
+            return;
+        }
+        if (c == ',') {
+            EmitElement();
+            return;
+        }
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            return;
+        }
     }
     
-    return JsonValue();
+    mElement += c;
+    if (mInString) {
+        if (mEscape) {
+            mEscape = false;
+        } else if (c == '\\') {
+            mEscape = true;
+        } else if (c == '"') {
+            mInString = false;
+        }
+    } else if (c == '"') {
+        mInString = true;
+    } else if (c == '{' || c == '[') {
+        mElementDepth++;
+    } else if (c == '}' || c == ']') {
+        if (--mElementDepth == 0) {
+            EmitElement();
+        } else if (mElementDepth < 0) {
+            mError = true;
+        }
+    }
 }
 
-JsonValue SimpleJsonParser::Parse(const std::string& json) {
-    const char* ptr = json.c_str();
-    return ParseValue(ptr);
+bool JsonArrayStream::Feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !mError && !mFinished; i++) {
+        char c = data[i];
+        
+        if (mCapturing) {
+            FeedElement(c);
+            continue;
+        }
+        
+        if (mInString) {
+            if (mEscape) {
+                mEscape = false;
+                if (mCapturingKey) mKey += c;
+            } else if (c == '\\') {
+                mEscape = true;
+                if (mCapturingKey) mKey += c;
+            } else if (c == '"') {
+                mInString = false;
+                if (mCapturingKey) {
+                    mCapturingKey = false;
+                    mStack.back().key = mKey;
+                }
+            } else if (mCapturingKey) {
+                mKey += c;
+            }
+            continue;
+        }
+        
+        switch (c) {
+            case '"':
+                mInString = true;
+                mCapturingKey = !mStack.empty() && mStack.back().isObject && mStack.back().expectKey;
+                mKey.clear();
+                break;
+            case ':':
+                if (!mStack.empty() && mStack.back().isObject) {
+                    mStack.back().expectKey = false;
+                }
+                break;
+            case ',':
+                if (!mStack.empty() && mStack.back().isObject) {
+                    mStack.back().expectKey = true;
+                }
+                break;
+            case '{':
+                mStack.push_back({true, true, std::string()});
+                break;
+            case '[':
+                if (PathMatches()) {
+                    mCapturing = true;
+                    mElementDepth = 0;
+                    mElement.clear();
+                } else {
+                    mStack.push_back({false, false, std::string()});
+                }
+                break;
+            case '}':
+            case ']':
+                if (mStack.empty()) {
+                    mError = true;
+                } else {
+                    mStack.pop_back();
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return !mError;
 }
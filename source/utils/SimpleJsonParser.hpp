@@ -1,8 +1,11 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <string_view>
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
 
 // 简单的JSON值类型
 enum JsonType {
@@ -14,67 +17,205 @@ enum JsonType {
     JSON_OBJECT
 };
 
-// 简单的JSON值
+struct JsonMember;
+class JsonDocument;
+class JsonReader;
+
+// JSON 值 (16 字节的标签联合), 数组、对象和字符串的内容都在所属 JsonDocument 的内存池中
+// 只能通过 JsonDocument 得到, JsonDocument 销毁后不能再使用
 class JsonValue {
 public:
-    JsonType type = JSON_NULL;
-    
-    // 值存储
-    bool boolValue = false;
-    double numberValue = 0.0;
-    std::string stringValue;
-    std::vector<JsonValue> arrayValue;
-    std::map<std::string, JsonValue> objectValue;
+    constexpr JsonValue() : mNumber(0.0) {}
     
-    JsonValue() = default;
+    JsonType type() const { return mType; }
     
     // 类型检查
-    bool isNull() const { return type == JSON_NULL; }
-    bool isBool() const { return type == JSON_BOOL; }
-    bool isNumber() const { return type == JSON_NUMBER; }
-    bool isString() const { return type == JSON_STRING; }
-    bool isArray() const { return type == JSON_ARRAY; }
-    bool isObject() const { return type == JSON_OBJECT; }
-    
-    // 获取值
-    bool asBool() const { return boolValue; }
-    int asInt() const { return (int)numberValue; }
-    double asDouble() const { return numberValue; }
-    const std::string& asString() const { return stringValue; }
-    
-    // 数组访问
-    size_t size() const { return arrayValue.size(); }
-    const JsonValue& operator[](size_t index) const { 
-        static JsonValue null;
-        return index < arrayValue.size() ? arrayValue[index] : null;
-    }
+    bool isNull() const { return mType == JSON_NULL; }
+    bool isBool() const { return mType == JSON_BOOL; }
+    bool isNumber() const { return mType == JSON_NUMBER; }
+    bool isString() const { return mType == JSON_STRING; }
+    bool isArray() const { return mType == JSON_ARRAY; }
+    bool isObject() const { return mType == JSON_OBJECT; }
     
-    // 对象访问
-    bool has(const std::string& key) const {
-        return objectValue.find(key) != objectValue.end();
+    // 获取值 (类型不符时返回 false / 0 / 空字符串)
+    bool asBool() const { return mType == JSON_BOOL && mBool; }
+    int asInt() const { return mType == JSON_NUMBER ? (int)mNumber : 0; }
+    double asDouble() const { return mType == JSON_NUMBER ? mNumber : 0.0; }
+    std::string_view asString() const {
+        return mType == JSON_STRING ? std::string_view(mString, mCount) : std::string_view();
     }
     
-    const JsonValue& operator[](const std::string& key) const {
-        static JsonValue null;
-        auto it = objectValue.find(key);
-        return it != objectValue.end() ? it->second : null;
-    }
+    // 数组访问 (对象返回成员数)
+    size_t size() const { return (mType == JSON_ARRAY || mType == JSON_OBJECT) ? mCount : 0; }
+    const JsonValue& operator[](size_t index) const;
+    
+    // 对象访问: 成员少时线性查找, 多时成员按键排序并二分查找
+    bool has(std::string_view key) const { return Find(key) != nullptr; }
+    const JsonValue& operator[](std::string_view key) const;
+    const JsonValue& operator[](const char* key) const { return (*this)[std::string_view(key)]; }
+    const JsonMember* begin() const;
+    const JsonMember* end() const;
+    
+private:
+    friend class SimpleJsonParser;
+    
+    JsonType mType = JSON_NULL;
+    uint32_t mCount = 0;            // 字符串长度 / 元素数 / 成员数
+    union {
+        bool mBool;
+        double mNumber;
+        const char* mString;
+        const JsonValue* mItems;
+        const JsonMember* mMembers;
+    };
+    
+    const JsonValue* Find(std::string_view key) const;
+    static const JsonValue sNull;
+    static constexpr uint32_t SORTED_OBJECT_THRESHOLD = 8; // 成员多于这个数时排序
+};
+
+struct JsonMember {
+    const char* key;
+    uint32_t keyLength;
+    JsonValue value;
+    
+    std::string_view name() const { return std::string_view(key, keyLength); }
 };
 
-// 简单的JSON解析器
+// 解析结果: 持有所有节点所在的内存池 (按块分配, 一起释放)
+class JsonDocument {
+public:
+    JsonDocument() = default;
+    JsonDocument(JsonDocument&&) = default;
+    JsonDocument& operator=(JsonDocument&&) = default;
+    JsonDocument(const JsonDocument&) = delete;
+    JsonDocument& operator=(const JsonDocument&) = delete;
+    
+    const JsonValue& Root() const { return mRoot; }
+    bool HasError() const { return mError; }
+    
+private:
+    friend class SimpleJsonParser;
+    
+    JsonValue mRoot;
+    bool mError = false;
+    std::vector<std::unique_ptr<char[]>> mBlocks;
+    char* mCursor = nullptr;        // 当前块中下一个可用的位置
+    size_t mRemaining = 0;
+    
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;
+    
+    void* Allocate(size_t bytes);   // 按 8 字节对齐
+};
+
+// 简单的JSON解析器: 一次解析出整个文档
 class SimpleJsonParser {
 public:
-    static JsonValue Parse(const std::string& json);
+    static JsonDocument Parse(std::string_view json);
     
 private:
-    static JsonValue ParseValue(const char*& ptr);
-    static JsonValue ParseObject(const char*& ptr);
-    static JsonValue ParseArray(const char*& ptr);
-    static JsonValue ParseString(const char*& ptr);
-    static JsonValue ParseNumber(const char*& ptr);
-    static JsonValue ParseBool(const char*& ptr);
-    static JsonValue ParseNull(const char*& ptr);
-    
-    static void SkipWhitespace(const char*& ptr);
-    static std::string UnescapeString(const std::string& str);
+    struct BuildStacks {
+        std::vector<JsonValue> items;     // 解析中的数组元素 (各层共用)
+        std::vector<JsonMember> members;  // 解析中的对象成员 (各层共用)
+    };
+    
+    static void ParseValue(JsonReader& reader, JsonDocument& doc, JsonValue& value, BuildStacks& stacks);
+    static const char* CopyString(JsonDocument& doc, std::string_view str);
+};
+
+// 逐个读取的 JSON 解析器 (pull 模式), 不构建 JsonValue 树
+// 字符串尽量直接指向原文, 适合解析大的 API 响应并直接填充结构体:
+//
+//     JsonReader reader(json);
+//     std::string_view key;
+//     if (reader.EnterObject()) {
+//         while (reader.NextMember(key)) {
+//             if (key == "name") reader.ReadString(name);
+//             else reader.Skip();
+//         }
+//     }
+//
+// 读取函数在类型不符或格式错误时返回 false, 格式错误之后的读取全部失败 (HasError)
+// 原文必须在 JsonReader 使用期间保持有效
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view json);
+    
+    // 下一个值的类型 (出错或已到末尾时返回 JSON_NULL, 用 HasError 区分)
+    JsonType Peek();
+    
+    // 对象: EnterObject 读入 '{', NextMember 读入下一个键和 ':', 遇到 '}' 时读入并返回 false
+    // 每次 NextMember 之后必须读取或 Skip 这个成员的值
+    bool EnterObject();
+    bool NextMember(std::string_view& key);
+    // 跳过其他成员直到键为 key 的成员, 没有时读完整个对象并返回 false
+    bool FindMember(std::string_view key);
+    
+    // 数组: 还有元素时 NextElement 返回 true, 遇到 ']' 时读入并返回 false
+    bool EnterArray();
+    bool NextElement();
+    
+    // 没有转义字符时 value 直接指向原文, 否则指向内部缓冲 (在下一次读取字符串或键之前有效)
+    bool ReadString(std::string_view& value);
+    bool ReadString(std::string& value);
+    bool ReadNumber(double& value);
+    bool ReadInt(int& value);
+    bool ReadBool(bool& value);
+    
+    // 跳过一个值 (整个对象或数组)
+    void Skip();
+    
+    bool HasError() const { return mError; }
+    
+private:
+    const char* mPtr;
+    const char* mEnd;
+    bool mError = false;
+    std::string mScratch;   // 有转义的字符串解码到这里
+    
+    void SkipWhitespace();
+    bool Fail();
+    bool ScanString(std::string_view& raw, bool& escaped); // 读入整个字符串, raw 不含引号
+    bool Unescape(std::string_view raw, std::string& out);
+};
+
+// 流式拆分 JSON 数组: 数据分块到达时逐块 Feed, 找到 path 指定的数组 (从根对象开始的键,
+// 例如 {"data", "wiiuThemes", "nodes"}) 后, 每个元素一完整就把它的原文交给 onElement
+// 只保留当前元素的数据, 不需要整个响应留在内存中; 元素可以再用 JsonReader 解析
+class JsonArrayStream {
+public:
+    JsonArrayStream(std::vector<std::string> path, std::function<void(std::string_view)> onElement);
+    
+    // 格式错误时返回 false, 之后的数据全部忽略
+    bool Feed(const char* data, size_t size);
+    
+    bool Finished() const { return mFinished; }   // 目标数组已经结束
+    bool HasError() const { return mError; }
+    
+private:
+    struct Level {
+        bool isObject;
+        bool expectKey;        // 对象中下一个字符串是键
+        std::string key;       // 当前成员的键
+    };
+    
+    std::vector<std::string> mPath;
+    std::function<void(std::string_view)> mOnElement;
+    std::vector<Level> mStack;
+    bool mInString = false;
+    bool mEscape = false;
+    bool mCapturingKey = false;
+    std::string mKey;
+    
+    // 在目标数组之内
+    bool mCapturing = false;
+    int mElementDepth = 0;
+    std::string mElement;
+    
+    bool mFinished = false;
+    bool mError = false;
+    
+    bool PathMatches() const;
+    void EmitElement();
+    void FeedElement(char c);
 };
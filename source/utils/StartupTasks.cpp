@@ -0,0 +1,149 @@
+#include "StartupTasks.hpp"
+#include "FileLogger.hpp"
+#include <coreinit/time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace {
+
+enum StageState {
+    STAGE_PENDING,
+    STAGE_RUNNING,
+    STAGE_DONE
+};
+
+struct Stage {
+    std::string name;
+    StartupTasks::Thread thread;
+    StartupTasks::Task task;
+    std::vector<std::string> deps;
+    StageState state = STAGE_PENDING;
+};
+
+} // namespace
+
+static std::mutex sMutex;
+static std::condition_variable sCv;
+static std::vector<Stage> sStages;
+static std::thread sWorker;
+static bool sStarted = false;
+static bool sStop = false;
+
+// 调用时持有 sMutex; 不存在的依赖视为已完成
+static bool IsReady(const Stage& stage) {
+    if (stage.state != STAGE_PENDING) {
+        return false;
+    }
+    for (const std::string& dep : stage.deps) {
+        for (const Stage& other : sStages) {
+            if (other.name == dep && other.state != STAGE_DONE) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 调用时持有 sMutex
+static Stage* FindReady(StartupTasks::Thread thread) {
+    for (Stage& stage : sStages) {
+        if (stage.thread == thread && IsReady(stage)) {
+            return &stage;
+        }
+    }
+    return nullptr;
+}
+
+// 运行时不持有 sMutex; sStages 在第一次 Update 之后不再增加, 指针保持有效
+static void RunStage(Stage* stage) {
+    OSTime start = OSGetSystemTime();
+    stage->task();
+    FileLogger::GetInstance().LogInfo("[Startup] %s finished in %llu ms%s", stage->name.c_str(),
+                                      (unsigned long long)OSTicksToMilliseconds(OSGetSystemTime() - start),
+                                      stage->thread == StartupTasks::BACKGROUND ? " (background)" : "");
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    stage->state = STAGE_DONE;
+    stage->task = nullptr;
+    sCv.notify_all();
+}
+
+static void WorkerThread() {
+    std::unique_lock<std::mutex> lock(sMutex);
+    while (!sStop) {
+        Stage* stage = FindReady(StartupTasks::BACKGROUND);
+        if (!stage) {
+            bool pending = false;
+            for (const Stage& other : sStages) {
+                pending |= other.thread == StartupTasks::BACKGROUND && other.state == STAGE_PENDING;
+            }
+            if (!pending) {
+                break;
+            }
+            // 等待依赖的 MAIN_THREAD 阶段
+            sCv.wait(lock);
+            continue;
+        }
+
+        stage->state = STAGE_RUNNING;
+        lock.unlock();
+        RunStage(stage);
+        lock.lock();
+    }
+}
+
+void StartupTasks::Add(const std::string& name, Thread thread, Task task, std::vector<std::string> deps) {
+    std::lock_guard<std::mutex> lock(sMutex);
+    if (sStarted) {
+        FileLogger::GetInstance().LogError("[Startup] Stage %s added after startup began", name.c_str());
+        return;
+    }
+    Stage stage;
+    stage.name = name;
+    stage.thread = thread;
+    stage.task = std::move(task);
+    stage.deps = std::move(deps);
+    sStages.push_back(std::move(stage));
+}
+
+void StartupTasks::Update() {
+    Stage* stage;
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        if (!sStarted) {
+            sStarted = true;
+            sWorker = std::thread(WorkerThread);
+        }
+        if (sStop) {
+            return;
+        }
+        stage = FindReady(MAIN_THREAD);
+        if (!stage) {
+            return;
+        }
+        stage->state = STAGE_RUNNING;
+    }
+    RunStage(stage);
+}
+
+bool StartupTasks::IsDone() {
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (const Stage& stage : sStages) {
+        if (stage.state != STAGE_DONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StartupTasks::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        sStop = true;
+        sCv.notify_all();
+    }
+    if (sWorker.joinable()) {
+        sWorker.join();
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// 启动时不急着完成的工作 (背景音乐、插件检查、主题登记表等) 分成几个阶段, 在第一帧显示之后进行
+// 阶段可以依赖其它阶段 (按名字), 依赖的阶段都完成后才开始
+// BACKGROUND 阶段按顺序在一个后台线程上运行; MAIN_THREAD 阶段在 Update 中运行, 每帧最多一个
+class StartupTasks {
+public:
+    enum Thread {
+        MAIN_THREAD,
+        BACKGROUND
+    };
+
+    using Task = std::function<void()>;
+
+    // 在第一次 Update 之前添加
+    static void Add(const std::string& name, Thread thread, Task task, std::vector<std::string> deps = {});
+
+    // 每帧调用: 运行一个可以开始的 MAIN_THREAD 阶段, 第一次调用时启动后台线程
+    static void Update();
+    static bool IsDone();
+
+    // 退出时调用: 还没开始的阶段不再运行, 等待正在运行的后台阶段结束
+    static void Shutdown();
+};
@@ -0,0 +1,66 @@
+#include "StringPool.hpp"
+#include <unordered_set>
+#include <mutex>
+
+// 用 string_view 直接查找, 不为查询构造临时字符串
+struct PoolHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>()(str); }
+};
+
+using PoolSet = std::unordered_set<std::string, PoolHash, std::equal_to<>>;
+
+// unordered_set 的节点在重新散列时不会移动, 所以句柄可以直接保存元素的地址
+static PoolSet& Pool() {
+    static PoolSet pool;
+    return pool;
+}
+
+static std::mutex sPoolMutex;
+static size_t sPoolBytes = 0;
+
+const std::string& PooledString::Empty() {
+    static const std::string empty;
+    return empty;
+}
+
+const std::string* PooledString::Intern(std::string_view str) {
+    if (str.empty()) {
+        return &Empty();
+    }
+    
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    auto& pool = Pool();
+    auto it = pool.find(str);
+    if (it == pool.end()) {
+        it = pool.emplace(str).first;
+        sPoolBytes += str.size();
+    }
+    return &*it;
+}
+
+bool PooledString::Lookup(std::string_view str, PooledString& out) {
+    if (str.empty()) {
+        out = PooledString();
+        return true;
+    }
+    
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    auto& pool = Pool();
+    auto it = pool.find(str);
+    if (it == pool.end()) {
+        return false;
+    }
+    out.mStr = &*it;
+    return true;
+}
+
+size_t PooledString::GetPoolSize() {
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    return Pool().size();
+}
+
+size_t PooledString::GetPoolBytes() {
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    return sPoolBytes;
+}
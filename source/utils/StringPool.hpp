@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// 驻留字符串: 相同内容的字符串在进程中只保存一份, 句柄只有一个指针
+// 用于目录中大量重复的字段 (作者、标签) 和需要频繁比较的 uuid
+// 池中的字符串不会释放, 句柄可以在任意线程读取; 创建句柄 (驻留) 时加锁
+class PooledString {
+public:
+    PooledString() : mStr(&Empty()) {}
+    PooledString(std::string_view str) : mStr(Intern(str)) {}
+    PooledString(const std::string& str) : mStr(Intern(str)) {}
+    PooledString(const char* str) : mStr(Intern(str)) {}
+    
+    const std::string& str() const { return *mStr; }
+    operator const std::string&() const { return *mStr; }
+    const char* c_str() const { return mStr->c_str(); }
+    bool empty() const { return mStr->empty(); }
+    size_t size() const { return mStr->size(); }
+    size_t length() const { return mStr->size(); }
+    
+    // 同一个池中内容相同就是同一个指针
+    bool operator==(const PooledString& other) const { return mStr == other.mStr; }
+    bool operator!=(const PooledString& other) const { return mStr != other.mStr; }
+    bool operator==(std::string_view other) const { return *mStr == other; }
+    bool operator!=(std::string_view other) const { return *mStr != other; }
+    bool operator==(const std::string& other) const { return *mStr == other; }
+    bool operator!=(const std::string& other) const { return *mStr != other; }
+    bool operator==(const char* other) const { return *mStr == other; }
+    bool operator!=(const char* other) const { return *mStr != other; }
+    bool operator<(const PooledString& other) const { return *mStr < *other.mStr; }
+    
+    // 不驻留, 只查找: 池中没有时返回 false (说明没有任何句柄等于它)
+    static bool Lookup(std::string_view str, PooledString& out);
+    
+    static size_t GetPoolSize();   // 驻留的字符串数
+    static size_t GetPoolBytes();  // 字符串内容的总字节数
+    
+private:
+    const std::string* mStr;
+    
+    static const std::string& Empty();
+    static const std::string* Intern(std::string_view str);
+};
+
+inline bool operator==(const std::string& a, const PooledString& b) { return b == a; }
+inline bool operator!=(const std::string& a, const PooledString& b) { return b != a; }
+inline std::string operator+(const std::string& a, const PooledString& b) { return a + b.str(); }
+inline std::string operator+(const char* a, const PooledString& b) { return a + b.str(); }
+inline std::string operator+(const PooledString& a, const std::string& b) { return a.str() + b; }
+inline std::string operator+(const PooledString& a, const char* b) { return a.str() + b; }
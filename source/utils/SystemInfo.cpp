@@ -0,0 +1,87 @@
+#include "SystemInfo.hpp"
+#include "FileLogger.hpp"
+#include "../common.h"
+#include <sysapp/title.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+#define WII_U_MENU_JPN_TID 0x0005001010040000ULL
+#define WII_U_MENU_USA_TID 0x0005001010040100ULL
+#define WII_U_MENU_EUR_TID 0x0005001010040200ULL
+
+static std::once_flag sInitOnce;
+static uint64_t sMenuTitleID = 0;
+static SystemRegion sRegion = REGION_USA;
+static std::string sMenuContentPath;
+static std::string sMenuTitleDir;
+static std::atomic<bool> sMenuContentAvailable{false};
+
+static void Resolve() {
+    sMenuTitleID = _SYSGetSystemApplicationTitleId(SYSTEM_APP_ID_WII_U_MENU);
+
+    switch (sMenuTitleID) {
+        case WII_U_MENU_JPN_TID:
+            sRegion = REGION_JPN;
+            break;
+        case WII_U_MENU_EUR_TID:
+            sRegion = REGION_EUR;
+            break;
+        default:
+            sRegion = REGION_USA; // 默认美版
+            break;
+    }
+
+    // Title ID 格式: 0x0005001010040X00, 高32位是父目录, 低32位是子目录
+    // 使用 storage_mlc_UTheme 设备名 (与 BackupManager 一致)
+    char path[80];
+    snprintf(path, sizeof(path), MLC_STORAGE_PATH ":/sys/title/%08x/%08x/content/",
+             (uint32_t)(sMenuTitleID >> 32), (uint32_t)sMenuTitleID);
+    sMenuContentPath = path;
+
+    char titleDir[32];
+    snprintf(titleDir, sizeof(titleDir), "%016llx", (unsigned long long)sMenuTitleID);
+    sMenuTitleDir = titleDir;
+
+    FileLogger::GetInstance().LogInfo("[SystemInfo] Menu title %016llx, region %d, content %s",
+                                      (unsigned long long)sMenuTitleID, (int)sRegion, sMenuContentPath.c_str());
+}
+
+void SystemInfo::Init() {
+    std::call_once(sInitOnce, Resolve);
+}
+
+void SystemInfo::ValidateMenuContent() {
+    Init();
+    struct stat st;
+    bool available = stat(sMenuContentPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    if (!available) {
+        FileLogger::GetInstance().LogError("[SystemInfo] Menu content directory not found: %s", sMenuContentPath.c_str());
+    }
+    sMenuContentAvailable = available;
+}
+
+uint64_t SystemInfo::GetMenuTitleID() {
+    Init();
+    return sMenuTitleID;
+}
+
+SystemRegion SystemInfo::GetRegion() {
+    Init();
+    return sRegion;
+}
+
+const std::string& SystemInfo::GetMenuContentPath() {
+    Init();
+    return sMenuContentPath;
+}
+
+const std::string& SystemInfo::GetMenuTitleDir() {
+    Init();
+    return sMenuTitleDir;
+}
+
+bool SystemInfo::IsMenuContentAvailable() {
+    return sMenuContentAvailable.load();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// 系统区域
+enum SystemRegion {
+    REGION_JPN = 0,
+    REGION_USA = 1,
+    REGION_EUR = 2,
+    REGION_UNIVERSAL = 3
+};
+
+// 进程内只查一次的系统信息: Wii U 菜单的 title ID、区域和 MLC 上的 content 目录
+// Init 在启动时调用 (不需要 Mocha); MLC 挂载后调用 ValidateMenuContent 确认 content 目录存在
+// 之后各处直接读取缓存的值, 可以在任何线程上调用
+class SystemInfo {
+public:
+    static void Init();
+    // MLC 挂载成功后调用
+    static void ValidateMenuContent();
+
+    static uint64_t GetMenuTitleID();
+    static SystemRegion GetRegion();
+    // "storage_mlc_UTheme:/sys/title/00050010/10040X00/content/" (以 '/' 结尾)
+    static const std::string& GetMenuContentPath();
+    // title ID 的 16 位十六进制字符串, 用作按系统版本区分的缓存目录名
+    static const std::string& GetMenuTitleDir();
+    // ValidateMenuContent 确认过 content 目录存在 (MLC 没有挂载时为 false)
+    static bool IsMenuContentAvailable();
+};
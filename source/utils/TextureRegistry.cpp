@@ -0,0 +1,129 @@
+#include "TextureRegistry.hpp"
+#include "FileLogger.hpp"
+#include "MemoryPressure.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+struct Entry {
+    TextureRegistry::Category category;
+    size_t bytes;
+};
+
+const char* const sCategoryNames[TextureRegistry::CATEGORY_COUNT] = {
+    "thumb", "hd", "glyph", "icon", "target"
+};
+
+} // namespace
+
+static std::unordered_map<SDL_Texture*, Entry> sTextures;
+static size_t sBytes[TextureRegistry::CATEGORY_COUNT] = {};
+static size_t sTotalBytes = 0;
+static TextureRegistry::Reclaimer sReclaimer;
+
+int TextureRegistry::sFailures = 0;
+
+void TextureRegistry::SetReclaimer(Reclaimer reclaimer) {
+    sReclaimer = std::move(reclaimer);
+}
+
+bool TextureRegistry::Reserve(size_t bytes) {
+    if (sTotalBytes + bytes <= TEXTURE_BUDGET) {
+        return true;
+    }
+    if (sReclaimer) {
+        size_t over = sTotalBytes + bytes - TEXTURE_BUDGET;
+        size_t freed = sReclaimer(over);
+        FileLogger::GetInstance().LogInfo("[TextureRegistry] Over budget by %zu KB, reclaimed %zu KB",
+                                          over / 1024, freed / 1024);
+    }
+    return sTotalBytes + bytes <= TEXTURE_BUDGET;
+}
+
+SDL_Texture* TextureRegistry::Track(Category category, SDL_Texture* texture, size_t bytes) {
+    if (!texture) {
+        return nullptr;
+    }
+    sTextures[texture] = Entry{category, bytes};
+    sBytes[category] += bytes;
+    sTotalBytes += bytes;
+    return texture;
+}
+
+// 调用者可能正持有文字缓存的引用 (Gfx::GetStaticText 创建文字纹理时), 这里不释放文字缓存,
+// 只记下内存不足, 由下一帧的 MemoryPressure::Update 全部释放
+static size_t ReleaseForTexture(size_t bytes) {
+    size_t freed = MemoryPressure::Release(MemoryPressure::LEVEL_CRITICAL, bytes, "texture", MemoryPressure::ORDER_TEXT);
+    MemoryPressure::Signal(MemoryPressure::LEVEL_CRITICAL, "texture");
+    return freed;
+}
+
+SDL_Texture* TextureRegistry::Create(Category category, SDL_Renderer* renderer, Uint32 format, int access, int width, int height) {
+    size_t bytes = (size_t)width * height * std::max(1, (int)SDL_BYTESPERPIXEL(format));
+    // 超出预算时仍然尝试创建: 预算是估算值, 只用来提前淘汰
+    Reserve(bytes);
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, format, access, width, height);
+    if (!texture && sReclaimer && sReclaimer(bytes) > 0) {
+        texture = SDL_CreateTexture(renderer, format, access, width, height);
+    }
+    if (!texture && ReleaseForTexture(bytes) > 0) {
+        texture = SDL_CreateTexture(renderer, format, access, width, height);
+    }
+    if (!texture) {
+        sFailures++;
+        FileLogger::GetInstance().LogError("[TextureRegistry] Creating %s texture %dx%d failed: %s (%zu KB in use)",
+                                           sCategoryNames[category], width, height, SDL_GetError(), sTotalBytes / 1024);
+    }
+    return Track(category, texture, bytes);
+}
+
+SDL_Texture* TextureRegistry::CreateFromSurface(Category category, SDL_Renderer* renderer, SDL_Surface* surface) {
+    size_t bytes = (size_t)surface->w * surface->h * surface->format->BytesPerPixel;
+    Reserve(bytes);
+
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (!texture && sReclaimer && sReclaimer(bytes) > 0) {
+        texture = SDL_CreateTextureFromSurface(renderer, surface);
+    }
+    if (!texture && ReleaseForTexture(bytes) > 0) {
+        texture = SDL_CreateTextureFromSurface(renderer, surface);
+    }
+    if (!texture) {
+        sFailures++;
+        FileLogger::GetInstance().LogError("[TextureRegistry] Creating %s texture %dx%d failed: %s (%zu KB in use)",
+                                           sCategoryNames[category], surface->w, surface->h, SDL_GetError(), sTotalBytes / 1024);
+    }
+    return Track(category, texture, bytes);
+}
+
+void TextureRegistry::Destroy(SDL_Texture* texture) {
+    if (!texture) {
+        return;
+    }
+    auto it = sTextures.find(texture);
+    if (it != sTextures.end()) {
+        sBytes[it->second.category] -= it->second.bytes;
+        sTotalBytes -= it->second.bytes;
+        sTextures.erase(it);
+    }
+    SDL_DestroyTexture(texture);
+}
+
+TextureRegistry::Category TextureRegistry::GetCategory(SDL_Texture* texture) {
+    auto it = sTextures.find(texture);
+    return it != sTextures.end() ? it->second.category : CATEGORY_TARGET;
+}
+
+size_t TextureRegistry::GetBytes(Category category) {
+    return sBytes[category];
+}
+
+size_t TextureRegistry::GetTotalBytes() {
+    return sTotalBytes;
+}
+
+const char* TextureRegistry::GetCategoryName(Category category) {
+    return sCategoryNames[category];
+}
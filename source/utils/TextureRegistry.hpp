@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <SDL2/SDL.h>
+
+// 纹理显存统计: 所有纹理通过这里创建和释放, 按类别记录占用的字节数 (w * h * 每像素字节数)
+// 总量超过 TEXTURE_BUDGET 时, 先让回收函数 (ImageLoader) 淘汰不在显示的图片再创建;
+// 创建仍然失败时回收一次后重试, 再失败时通知 MemoryPressure (所有可以重建的状态) 后再试一次;
+// 高清图创建失败时界面显示缩略图
+// 只能在主线程 (渲染线程) 调用
+class TextureRegistry {
+public:
+    enum Category {
+        CATEGORY_THUMBNAIL,   // 缩略图和图集页
+        CATEGORY_HD,          // 高清预览图 (包括渐进加载中的纹理)
+        CATEGORY_GLYPH,       // 预渲染的文字
+        CATEGORY_ICON,        // 图标图集
+        CATEGORY_TARGET,      // 其它渲染目标 (界面切换的截图等)
+        CATEGORY_COUNT
+    };
+
+    static constexpr size_t TEXTURE_BUDGET = 128 * 1024 * 1024;
+
+    // 释放至少 bytes 字节 (做不到时尽量释放), 返回实际释放的字节数
+    using Reclaimer = std::function<size_t(size_t bytes)>;
+    static void SetReclaimer(Reclaimer reclaimer);
+
+    // 失败时返回 nullptr
+    static SDL_Texture* Create(Category category, SDL_Renderer* renderer, Uint32 format, int access, int width, int height);
+    static SDL_Texture* CreateFromSurface(Category category, SDL_Renderer* renderer, SDL_Surface* surface);
+    // 也可以释放不是从这里创建的纹理; nullptr 时什么都不做
+    static void Destroy(SDL_Texture* texture);
+
+    static Category GetCategory(SDL_Texture* texture);  // 未登记的纹理返回 CATEGORY_TARGET
+    static size_t GetBytes(Category category);
+    static size_t GetTotalBytes();
+    static int GetFailureCount() { return sFailures; }  // 回收后仍然创建失败的次数
+    static const char* GetCategoryName(Category category);
+
+private:
+    static bool Reserve(size_t bytes);
+    static SDL_Texture* Track(Category category, SDL_Texture* texture, size_t bytes);
+
+    static int sFailures;
+};
@@ -0,0 +1,330 @@
+#include "ThemeCatalogIndex.hpp"
+#include "ThemeManager.hpp"
+#include <algorithm>
+
+std::string ThemeCatalogIndex::Lowercase(const std::string& str) {
+    // 只转换 ASCII, UTF-8 的多字节字符原样保留
+    std::string result = str;
+    for (char& c : result) {
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c - 'A' + 'a');
+        }
+    }
+    return result;
+}
+
+uint32_t ThemeCatalogIndex::Trigram(const char* p) {
+    return ((uint32_t)(uint8_t)p[0] << 16) | ((uint32_t)(uint8_t)p[1] << 8) | (uint32_t)(uint8_t)p[2];
+}
+
+// 单词由字母、数字和非 ASCII 字符组成
+static bool IsWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (uint8_t)c >= 0x80;
+}
+
+void ThemeCatalogIndex::Clear() {
+    mSearchText.clear();
+    mDownloads.clear();
+    mLikes.clear();
+    mUpdatedAt.clear();
+    mCount = 0;
+    mBuilt = false;
+    mTrigrams.clear();
+    mWords.clear();
+    mTags.clear();
+    for (int order = 0; order < SORT_COUNT; order++) {
+        mOrders[order].clear();
+        mRanks[order].clear();
+    }
+    if (!mView.empty()) {
+        mView.clear();
+        mViewVersion++;
+    }
+}
+
+bool ThemeCatalogIndex::Update(const std::vector<Theme>& themes, uint32_t catalogVersion) {
+    if (!mBuilt || catalogVersion != mCatalogVersion || themes.size() < mCount) {
+        // 主题换了位置或内容: 同一个下标可能已经是另一个主题, 视图一定算作改变
+        Clear();
+        mBuilt = true;
+        mCatalogVersion = catalogVersion;
+        IndexThemes(themes, 0);
+        MergeOrders(0);
+        RefreshView();
+        mViewVersion++;
+        return true;
+    }
+
+    if (themes.size() > mCount) {
+        size_t first = mCount;
+        IndexThemes(themes, first);
+        MergeOrders(first);
+        return RefreshView();
+    }
+    return false;
+}
+
+void ThemeCatalogIndex::IndexThemes(const std::vector<Theme>& themes, size_t first) {
+    size_t firstWord = mWords.size();
+
+    for (size_t i = first; i < themes.size(); i++) {
+        const Theme& theme = themes[i];
+        int index = (int)i;
+
+        // 名称和作者之间用 '\n' 分隔, 跨过分隔符的三元组不建立索引 (查询中不会有 '\n')
+        std::string text = Lowercase(theme.name) + '\n' + Lowercase(theme.author);
+        for (size_t p = 0; p + 3 <= text.size(); p++) {
+            if (text[p] == '\n' || text[p + 1] == '\n' || text[p + 2] == '\n') {
+                continue;
+            }
+            std::vector<int>& list = mTrigrams[Trigram(text.data() + p)];
+            if (list.empty() || list.back() != index) {
+                list.push_back(index);
+            }
+        }
+
+        size_t p = 0;
+        while (p < text.size()) {
+            while (p < text.size() && !IsWordChar(text[p])) {
+                p++;
+            }
+            size_t start = p;
+            while (p < text.size() && IsWordChar(text[p])) {
+                p++;
+            }
+            if (p > start) {
+                mWords.emplace_back(text.substr(start, p - start), index);
+            }
+        }
+
+        for (const PooledString& tag : theme.tags) {
+            if (tag.empty()) {
+                continue;
+            }
+            TagBits& tagBits = mTags[tag];
+            size_t word = i / 64;
+            uint64_t bit = (uint64_t)1 << (i % 64);
+            if (tagBits.bits.size() <= word) {
+                tagBits.bits.resize(word + 1, 0);
+            }
+            if (!(tagBits.bits[word] & bit)) {
+                tagBits.bits[word] |= bit;
+                tagBits.count++;
+            }
+        }
+
+        mSearchText.push_back(std::move(text));
+        mDownloads.push_back(theme.downloads);
+        mLikes.push_back(theme.likes);
+        mUpdatedAt.push_back(theme.updatedAt);
+    }
+    mCount = themes.size();
+
+    // 新单词排序后和已有的有序部分合并
+    std::sort(mWords.begin() + firstWord, mWords.end());
+    std::inplace_merge(mWords.begin(), mWords.begin() + firstWord, mWords.end());
+}
+
+bool ThemeCatalogIndex::Before(SortOrder order, int a, int b) const {
+    // 相同时按 API 顺序, 保证是全序 (合并后和完整排序的结果一致)
+    switch (order) {
+        case SORT_DOWNLOADS:
+            if (mDownloads[a] != mDownloads[b]) return mDownloads[a] > mDownloads[b];
+            break;
+        case SORT_LIKES:
+            if (mLikes[a] != mLikes[b]) return mLikes[a] > mLikes[b];
+            break;
+        case SORT_UPDATED:
+            if (mUpdatedAt[a] != mUpdatedAt[b]) return mUpdatedAt[a] > mUpdatedAt[b];
+            break;
+        default:
+            break;
+    }
+    return a < b;
+}
+
+void ThemeCatalogIndex::MergeOrders(size_t first) {
+    for (int o = 0; o < SORT_COUNT; o++) {
+        SortOrder order = (SortOrder)o;
+        std::vector<int>& perm = mOrders[o];
+        for (size_t i = first; i < mCount; i++) {
+            perm.push_back((int)i);
+        }
+        if (order != SORT_DEFAULT) {
+            auto less = [this, order](int a, int b) { return Before(order, a, b); };
+            std::sort(perm.begin() + first, perm.end(), less);
+            std::inplace_merge(perm.begin(), perm.begin() + first, perm.end(), less);
+        }
+
+        std::vector<int>& ranks = mRanks[o];
+        ranks.resize(mCount);
+        for (size_t pos = 0; pos < perm.size(); pos++) {
+            ranks[perm[pos]] = (int)pos;
+        }
+    }
+}
+
+void ThemeCatalogIndex::CollectMatches(std::vector<int>& out) const {
+    out.clear();
+    bool haveCandidates = false;
+
+    if (!mQuery.empty()) {
+        if (mQuery.size() >= 3) {
+            // 取查询中最短的倒排表作为候选, 再在原文中确认子串 (同时覆盖了其它三元组)
+            const std::vector<int>* shortest = nullptr;
+            for (size_t p = 0; p + 3 <= mQuery.size(); p++) {
+                auto it = mTrigrams.find(Trigram(mQuery.data() + p));
+                if (it == mTrigrams.end()) {
+                    return;
+                }
+                if (!shortest || it->second.size() < shortest->size()) {
+                    shortest = &it->second;
+                }
+            }
+            for (int index : *shortest) {
+                if (mSearchText[index].find(mQuery) != std::string::npos) {
+                    out.push_back(index);
+                }
+            }
+        } else {
+            // 短查询: 以它开头的单词
+            auto it = std::lower_bound(mWords.begin(), mWords.end(), std::make_pair(mQuery, -1));
+            for (; it != mWords.end() && it->first.compare(0, mQuery.size(), mQuery) == 0; ++it) {
+                out.push_back(it->second);
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+        haveCandidates = true;
+    }
+
+    if (mTagFilter.empty()) {
+        return;
+    }
+
+    std::vector<const TagBits*> filters;
+    for (const PooledString& tag : mTagFilter) {
+        auto it = mTags.find(tag);
+        if (it == mTags.end()) {
+            out.clear();
+            return;
+        }
+        filters.push_back(&it->second);
+    }
+
+    if (!haveCandidates) {
+        // 没有搜索词: 候选为所有位图按字相与的结果
+        const std::vector<uint64_t>& firstBits = filters[0]->bits;
+        for (size_t word = 0; word < firstBits.size(); word++) {
+            uint64_t bits = firstBits[word];
+            for (size_t f = 1; f < filters.size() && bits; f++) {
+                const std::vector<uint64_t>& other = filters[f]->bits;
+                bits &= (word < other.size()) ? other[word] : 0;
+            }
+            while (bits) {
+                int bit = __builtin_ctzll(bits);
+                out.push_back((int)(word * 64 + bit));
+                bits &= bits - 1;
+            }
+        }
+        return;
+    }
+
+    out.erase(std::remove_if(out.begin(), out.end(), [&filters](int index) {
+        size_t word = (size_t)index / 64;
+        uint64_t bit = (uint64_t)1 << (index % 64);
+        for (const TagBits* tagBits : filters) {
+            if (word >= tagBits->bits.size() || !(tagBits->bits[word] & bit)) {
+                return true;
+            }
+        }
+        return false;
+    }), out.end());
+}
+
+bool ThemeCatalogIndex::RefreshView() {
+    std::vector<int> view;
+    if (mQuery.empty() && mTagFilter.empty()) {
+        view = mOrders[mSort];
+    } else {
+        std::vector<int> matches;
+        CollectMatches(matches);  // 升序, 即 API 顺序
+        if (mSort == SORT_DEFAULT) {
+            view.swap(matches);
+        } else if (matches.size() * SCAN_RATIO > mCount) {
+            // 结果很多: 按排列顺序扫描一遍
+            std::vector<bool> selected(mCount, false);
+            for (int index : matches) {
+                selected[index] = true;
+            }
+            view.reserve(matches.size());
+            for (int index : mOrders[mSort]) {
+                if (selected[index]) {
+                    view.push_back(index);
+                }
+            }
+        } else {
+            // 结果不多: 只在结果上按名次排序
+            const std::vector<int>& ranks = mRanks[mSort];
+            std::sort(matches.begin(), matches.end(), [&ranks](int a, int b) {
+                return ranks[a] < ranks[b];
+            });
+            view.swap(matches);
+        }
+    }
+
+    if (view == mView) {
+        return false;
+    }
+    bool appended = view.size() >= mView.size() && std::equal(mView.begin(), mView.end(), view.begin());
+    if (!appended) {
+        mViewVersion++;
+    }
+    mView.swap(view);
+    return true;
+}
+
+void ThemeCatalogIndex::SetQuery(const std::string& query) {
+    // 去掉首尾空白, 转为小写
+    size_t start = query.find_first_not_of(" \t\r\n");
+    size_t end = query.find_last_not_of(" \t\r\n");
+    std::string normalized = (start == std::string::npos) ? std::string() : Lowercase(query.substr(start, end - start + 1));
+    if (normalized == mQuery) {
+        return;
+    }
+    mQuery = std::move(normalized);
+    if (mBuilt) {
+        RefreshView();
+    }
+}
+
+void ThemeCatalogIndex::SetTagFilter(const std::vector<PooledString>& tags) {
+    if (tags == mTagFilter) {
+        return;
+    }
+    mTagFilter = tags;
+    if (mBuilt) {
+        RefreshView();
+    }
+}
+
+void ThemeCatalogIndex::SetSort(SortOrder order) {
+    if (order < 0 || order >= SORT_COUNT || order == mSort) {
+        return;
+    }
+    mSort = order;
+    if (mBuilt) {
+        RefreshView();
+    }
+}
+
+std::vector<ThemeCatalogIndex::TagInfo> ThemeCatalogIndex::GetTags() const {
+    std::vector<TagInfo> tags;
+    for (const auto& entry : mTags) {
+        TagInfo info;
+        info.name = entry.first;
+        info.count = entry.second.count;
+        tags.push_back(info);
+    }
+    return tags;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include "StringPool.hpp"
+
+struct Theme;
+
+// 主题目录索引: 在 ThemeManager 的列表之上做搜索、按标签过滤和排序, 不复制也不重排主题本身
+// 结果 (视图) 是 mThemes 中的下标序列. 名称和作者按小写建立三元组倒排表 (子串搜索)
+// 和排好序的单词表 (少于 3 个字符时按单词前缀搜索); 每个标签一个位图;
+// 每种排序预先算好排列和名次, 换排序或过滤条件时只需在结果上按名次排序
+// 列表末尾追加主题时增量建立索引, 其它变化 (目录版本改变) 时重建
+// 只在主线程使用
+class ThemeCatalogIndex {
+public:
+    enum SortOrder {
+        SORT_DEFAULT,    // API 顺序
+        SORT_DOWNLOADS,  // 下载数从多到少
+        SORT_LIKES,      // 收藏数从多到少
+        SORT_UPDATED,    // 最近更新的在前
+        SORT_COUNT
+    };
+
+    struct TagInfo {
+        PooledString name;
+        size_t count = 0;  // 带这个标签的主题数
+    };
+
+    // 和主题列表同步, catalogVersion 为 ThemeManager::GetCatalogVersion
+    // 返回视图是否变化
+    bool Update(const std::vector<Theme>& themes, uint32_t catalogVersion);
+    void Clear();
+
+    // 搜索名称和作者 (不区分 ASCII 大小写), 空字符串表示不搜索
+    void SetQuery(const std::string& query);
+    const std::string& GetQuery() const { return mQuery; }
+    // 只显示同时带有这些标签的主题, 空表示不过滤
+    void SetTagFilter(const std::vector<PooledString>& tags);
+    const std::vector<PooledString>& GetTagFilter() const { return mTagFilter; }
+    void SetSort(SortOrder order);
+    SortOrder GetSort() const { return mSort; }
+
+    // 当前的结果 (主题下标)
+    const std::vector<int>& GetView() const { return mView; }
+    // 视图中已有的主题改变了位置或被移除时递增; 只在末尾追加结果时不变
+    uint32_t GetViewVersion() const { return mViewVersion; }
+
+    // 目录中出现过的标签 (按名称排序)
+    std::vector<TagInfo> GetTags() const;
+
+private:
+    // 每个主题的索引数据 (建索引时从 Theme 复制, 排序和搜索不再访问主题列表)
+    std::vector<std::string> mSearchText;  // 小写的 "名称\n作者"
+    std::vector<int> mDownloads;
+    std::vector<int> mLikes;
+    std::vector<std::string> mUpdatedAt;   // ISO 8601, 按字符串比较即按时间比较
+    size_t mCount = 0;
+    uint32_t mCatalogVersion = 0;
+    bool mBuilt = false;
+
+    // 三元组 -> 包含它的主题 (升序, 不重复)
+    std::unordered_map<uint32_t, std::vector<int>> mTrigrams;
+    // (单词, 主题) 按单词排序, 用于短查询的前缀搜索
+    std::vector<std::pair<std::string, int>> mWords;
+
+    // 标签 -> 位图 (第 i 位表示第 i 个主题带有该标签)
+    struct TagBits {
+        std::vector<uint64_t> bits;
+        size_t count = 0;
+    };
+    std::map<PooledString, TagBits> mTags;
+
+    // 每种排序的排列 (主题下标) 和名次 (mRanks[order][主题下标] = 在排列中的位置)
+    std::vector<int> mOrders[SORT_COUNT];
+    std::vector<int> mRanks[SORT_COUNT];
+
+    // 查询条件和结果
+    std::string mQuery;
+    std::vector<PooledString> mTagFilter;
+    SortOrder mSort = SORT_DEFAULT;
+    std::vector<int> mView;
+    uint32_t mViewVersion = 0;
+
+    // 候选结果超过总数的这个比例时, 按排列顺序扫描并用位图判断, 而不是按名次排序
+    static constexpr size_t SCAN_RATIO = 8;
+
+    void IndexThemes(const std::vector<Theme>& themes, size_t first);
+    void MergeOrders(size_t first);
+    bool Before(SortOrder order, int a, int b) const;
+    void CollectMatches(std::vector<int>& out) const;
+    bool RefreshView();
+
+    static std::string Lowercase(const std::string& str);
+    static uint32_t Trigram(const char* p);
+};
@@ -1,10 +1,16 @@
 #include "ThemeDownloader.hpp"
 #include "FileLogger.hpp"
 #include "logger.h"
-#include "minizip/unzip.h"
+#include "FileIO.hpp"
+#include "ZipExtractor.hpp"
+#include "ZipStreamExtractor.hpp"
+#include "DownloadQueue.hpp"
+#include "Trace.hpp"
 #include <algorithm>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
@@ -12,19 +18,14 @@
 
 #define THEMES_BASE_PATH "fs:/vol/external01/wiiu/themes"
 
-// 静态初始化 CURL (只执行一次)
-static bool curl_initialized = false;
-static void EnsureCurlInitialized() {
-    if (!curl_initialized) {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl_initialized = true;
-        FileLogger::GetInstance().LogInfo("[CURL] Global initialization completed");
-    }
+// 解压时跳过 BPS 补丁 (安装时直接从 ZIP 读取)
+static bool IsNotPatchFile(const std::string& name) {
+    return !(name.length() > 4 && name.compare(name.length() - 4, 4, ".bps") == 0);
 }
 
 ThemeDownloader::ThemeDownloader() 
-    : mState(DOWNLOAD_IDLE), mProgress(0.0f), mCancelRequested(false) {
-    EnsureCurlInitialized();
+    : mCancelRequested(false) {
+    mbedtls_sha256_init(&mHash);
     FileLogger::GetInstance().LogInfo("[ThemeDownloader] Constructor called");
 }
 
@@ -51,20 +52,22 @@ ThemeDownloader::~ThemeDownloader() {
         }
     }
     
-    // 清理临时文件
-    if (!mTempFilePath.empty()) {
+    // 清理没下载完的文件; 完成的压缩包要保留 (安装记录从这里读取补丁)
+    if (!mTempFilePath.empty() && GetState() != DOWNLOAD_COMPLETE) {
         unlink(mTempFilePath.c_str());
     }
+    mbedtls_sha256_free(&mHash);
     
     FileLogger::GetInstance().LogInfo("[ThemeDownloader] Destructor completed");
 }
 
-void ThemeDownloader::SetProgressCallback(std::function<void(float progress, long downloaded, long total)> callback) {
-    mProgressCallback = callback;
-}
-
-void ThemeDownloader::SetStateCallback(std::function<void(DownloadState state, const std::string& message)> callback) {
-    mStateCallback = callback;
+void ThemeDownloader::SetState(DownloadState state, float progress) {
+    mProgress.Update([state, progress](ProgressSnapshot& snapshot) {
+        snapshot.state = state;
+        if (progress >= 0.0f) {
+            snapshot.progress = progress;
+        }
+    });
 }
 
 void ThemeDownloader::Cancel() {
@@ -81,10 +84,7 @@ void ThemeDownloader::Cancel() {
             FileLogger::GetInstance().LogInfo("[ThemeDownloader] Thread joined in Cancel()");
         }
         
-        mState.store(DOWNLOAD_CANCELLED);
-        if (mStateCallback) {
-            mStateCallback(DOWNLOAD_CANCELLED, "Download cancelled");
-        }
+        SetState(DOWNLOAD_CANCELLED);
         FileLogger::GetInstance().LogInfo("[ThemeDownloader] Cancel completed");
     }
 }
@@ -99,8 +99,7 @@ void ThemeDownloader::DownloadThemeAsync(const std::string& downloadUrl, const s
     }
     
     // 重置状态
-    mState.store(DOWNLOAD_IDLE);
-    mProgress.store(0.0f);
+    mProgress.Publish(ProgressSnapshot());
     mCancelRequested.store(false);
     mErrorMessage.clear();
     
@@ -108,35 +107,94 @@ void ThemeDownloader::DownloadThemeAsync(const std::string& downloadUrl, const s
     mDownloadThread = std::thread(&ThemeDownloader::DownloadThreadFunc, this, downloadUrl, themeName);
 }
 
-size_t ThemeDownloader::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    FILE* fp = (FILE*)userp;
-    return fwrite(contents, size, nmemb, fp);
-}
-
-int ThemeDownloader::ProgressCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow, 
-                                     curl_off_t ultotal, curl_off_t ulnow) {
-    ThemeDownloader* downloader = (ThemeDownloader*)clientp;
-    
+bool ThemeDownloader::WriteSegment(Segment* segment, const char* data, size_t size) {
     // 检查是否需要取消
-    if (downloader->mCancelRequested.load()) {
+    if (mCancelRequested.load()) {
         DEBUG_FUNCTION_LINE("Download cancelled by user");
-        return 1; // 非0返回值会让CURL中止
+        return false;
     }
     
-    if (dltotal > 0) {
-        float progress = (float)dlnow / (float)dltotal;
-        downloader->mProgress.store(progress * 0.9f); // 下载占90%，解压占10%
-        
-        // 调用进度回调
-        if (downloader->mProgressCallback) {
-            downloader->mProgressCallback(progress, (long)dlnow, (long)dltotal);
+    // 第一个数据块: 检查服务器是否接受了 Range 请求
+    if (segment->received == 0) {
+        long httpCode = 0;
+        curl_easy_getinfo(segment->op->eh, CURLINFO_RESPONSE_CODE, &httpCode);
+        if (segment->rangeRequested && httpCode == 200) {
+            if (mSegments.size() > 1) {
+                // 多段下载无法使用完整响应, 中止并回退到单线程
+                segment->rangeIgnored = true;
+                return false;
+            }
+            // 单段: 从头重新写入 (服务器不支持 Range 或 If-Range 不匹配)
+            FileLogger::GetInstance().LogWarning("[ThemeDownloader] Server ignored Range or file changed, restarting from 0");
+            segment->fp = freopen(segment->partPath.c_str(), "wb", segment->fp);
+            if (!segment->fp) {
+                return false;
+            }
+            segment->have = 0;
+            segment->rangeRequested = false;
+            if (segment->stream) {
+                segment->stream->Abandon();
+                segment->stream = nullptr;
+            }
+            ResetHash();
         }
         
-        DEBUG_FUNCTION_LINE("Download progress: %.1f%% (%lld / %lld bytes)", 
-                          progress * 100.0f, dlnow, dltotal);
+        // 单段且大小未知时, 用本次响应的长度推算总大小
+        if (mTotalSize <= 0 && segment->op->contentLength > 0 && mSegments.size() == 1) {
+            mTotalSize = segment->have + segment->op->contentLength;
+        }
+    }
+    
+    size_t written = fwrite(data, 1, size, segment->fp);
+    if (mHashStreaming) {
+        mbedtls_sha256_update(&mHash, (const unsigned char*)data, written);
+    }
+    if (segment->stream) {
+        segment->stream->Feed(data, written);
+    }
+    segment->received += (curl_off_t)written;
+    
+    ReportProgress();
+    return written == size;
+}
+
+void ThemeDownloader::ReportProgress() {
+    if (mTotalSize <= 0) {
+        return;
+    }
+    
+    curl_off_t now = 0;
+    for (const auto& segment : mSegments) {
+        now += segment.have + segment.received;
+    }
+    
+    // 速度每 RATE_INTERVAL_MS 采样一次, 其间沿用上次的值
+    OSTime time = OSGetSystemTime();
+    uint32_t rate = 0;
+    bool sampled = false;
+    if (mRateTime == 0 || now < mRateBytes) {
+        mRateTime = time;
+        mRateBytes = now;
+    } else {
+        uint64_t elapsedMs = OSTicksToMilliseconds(time - mRateTime);
+        if (elapsedMs >= RATE_INTERVAL_MS) {
+            rate = (uint32_t)((uint64_t)(now - mRateBytes) * 1000 / elapsedMs);
+            sampled = true;
+            mRateTime = time;
+            mRateBytes = now;
+        }
     }
     
-    return 0;
+    float progress = std::min(1.0f, (float)now / (float)mTotalSize);
+    curl_off_t total = mTotalSize;
+    mProgress.Update([&](ProgressSnapshot& snapshot) {
+        snapshot.bytes = (uint64_t)now;
+        snapshot.total = (uint64_t)total;
+        snapshot.progress = progress * 0.9f; // 下载占90%，解压占10%
+        if (sampled) {
+            snapshot.rate = rate;
+        }
+    });
 }
 
 // 清理文件名中的非法字符
@@ -254,18 +312,14 @@ void ThemeDownloader::DownloadThreadFunc(const std::string& url, const std::stri
         mTempFilePath.c_str(), mExtractPath.c_str());
     
     // 状态：开始下载
-    mState.store(DOWNLOAD_DOWNLOADING);
-    if (mStateCallback) {
-        mStateCallback(DOWNLOAD_DOWNLOADING, "Downloading theme...");
-    }
+    SetState(DOWNLOAD_DOWNLOADING);
     
-    // 下载文件
-    if (!DownloadFile(url, mTempFilePath)) {
+    // 下载文件, 同时尝试边下载边解压 (BPS 补丁同样不解压)
+    ZipStreamExtractor stream(mExtractPath);
+    stream.SetFilter(IsNotPatchFile);
+    if (!DownloadFile(url, mTempFilePath, &stream)) {
         if (!mCancelRequested.load()) {
-            mState.store(DOWNLOAD_ERROR);
-            if (mStateCallback) {
-                mStateCallback(DOWNLOAD_ERROR, mErrorMessage);
-            }
+            SetState(DOWNLOAD_ERROR);
         }
         return;
     }
@@ -276,29 +330,20 @@ void ThemeDownloader::DownloadThreadFunc(const std::string& url, const std::stri
     }
     
     // 状态：解压缩
-    mState.store(DOWNLOAD_EXTRACTING);
-    mProgress.store(0.9f); // 显示90%
-    if (mStateCallback) {
-        mStateCallback(DOWNLOAD_EXTRACTING, "Extracting theme files...");
-    }
+    SetState(DOWNLOAD_EXTRACTING, 0.9f); // 显示90%
     
-    // 解压文件到 wiiu/themes/themeName/ （包含 BPS 补丁文件和 metadata.json）
-    if (!ExtractZip(mTempFilePath, mExtractPath)) {
+    // 解压文件到 wiiu/themes/themeName/ （metadata.json 等）
+    // BPS 补丁留在 ZIP 里, 安装时直接从 ZIP 读取 (ThemePatcher::InstallThemeFromArchive)
+    // 下载时已经解压完的不再解压; 续传、分段下载或需要中央目录的压缩包在这里完整解压
+    if (!stream.Finish(mTempFilePath) && !ExtractZip(mTempFilePath, mExtractPath, true)) {
         if (!mCancelRequested.load()) {
-            mState.store(DOWNLOAD_ERROR);
-            if (mStateCallback) {
-                mStateCallback(DOWNLOAD_ERROR, mErrorMessage);
-            }
+            SetState(DOWNLOAD_ERROR);
         }
         return;
     }
     
     // 完成下载和解压，ZIP 文件和解压后的文件都保留
-    mState.store(DOWNLOAD_COMPLETE);
-    mProgress.store(1.0f);
-    if (mStateCallback) {
-        mStateCallback(DOWNLOAD_COMPLETE, "Download complete!");
-    }
+    SetState(DOWNLOAD_COMPLETE, 1.0f);
     
     DEBUG_FUNCTION_LINE("Download thread finished, extracted to: %s", mExtractPath.c_str());
     FileLogger::GetInstance().LogInfo("Download and extraction completed, path: %s", mExtractPath.c_str());
@@ -333,161 +378,592 @@ bool ThemeDownloader::CreateDirectoryRecursive(const std::string& path) {
     return true;
 }
 
-bool ThemeDownloader::DownloadFile(const std::string& url, const std::string& outputPath) {
-    FileLogger::GetInstance().LogInfo("Downloading: %s -> %s", url.c_str(), outputPath.c_str());
+bool ThemeDownloader::RunTransfers(const std::vector<DownloadOperation*>& ops) {
+    // 在下载线程中添加和取消任务, 需要网络线程模式
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (!queue || !queue->IsThreaded()) {
+        FileLogger::GetInstance().LogError("[ThemeDownloader] Download queue not running on a network thread");
+        return false;
+    }
     
-    // 创建输出目录
-    std::string dir = outputPath.substr(0, outputPath.find_last_of('/'));
-    CreateDirectoryRecursive(dir);
+    // 完成回调在网络线程中执行, 只记录结束并唤醒这里
+    std::vector<bool> finished(ops.size(), false);
+    size_t remaining = ops.size();
+    for (size_t i = 0; i < ops.size(); i++) {
+        ops[i]->callbackOnNetworkThread = true;
+        ops[i]->cb = [this, &finished, &remaining, i](DownloadOperation*) {
+            std::lock_guard<std::mutex> lock(mTransferMutex);
+            finished[i] = true;
+            remaining--;
+            mTransferCv.notify_all();
+        };
+        queue->DownloadAdd(ops[i]);
+    }
     
-    // 打开输出文件
-    FILE* fp = fopen(outputPath.c_str(), "wb");
-    if (!fp) {
-        mErrorMessage = "Failed to create temp file";
-        FileLogger::GetInstance().LogError("Failed to create file: %s", outputPath.c_str());
+    std::unique_lock<std::mutex> lock(mTransferMutex);
+    while (remaining > 0) {
+        if (mCancelRequested.load()) {
+            // 撤回还没结束的传输; DownloadCancel 返回后不会再有回调
+            for (size_t i = 0; i < ops.size(); i++) {
+                if (!finished[i]) {
+                    lock.unlock();
+                    queue->DownloadCancel(ops[i]);
+                    lock.lock();
+                }
+            }
+            return false;
+        }
+        mTransferCv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    return true;
+}
+
+bool ThemeDownloader::ProbeRemoteFile(const std::string& url, curl_off_t& size, bool& acceptRanges) {
+    size = -1;
+    acceptRanges = false;
+    
+    // 只请求第一个字节: 返回 206 说明支持 Range, Content-Range 中带有总大小
+    // 服务器忽略 Range 时不接收完整文件
+    DownloadOperation probe;
+    probe.url = url;
+    probe.range = "0-0";
+    probe.sink = DownloadSink::CALLBACK;
+    probe.chunkCb = [&probe](const char*, size_t size) {
+        return probe.bytesReceived + size <= 1;
+    };
+    
+    if (!RunTransfers({&probe})) {
         return false;
     }
     
-    // 初始化 CURL
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        fclose(fp);
-        mErrorMessage = "Failed to initialize CURL";
+    long httpCode = probe.response_code;
+    if (httpCode == 0) {
+        FileLogger::GetInstance().LogWarning("[ThemeDownloader] Probe failed: %s", curl_easy_strerror(probe.result));
         return false;
     }
+    mRemoteEtag = probe.etag;
+    TakeExpectedDigest(probe.digest);
+    
+    // 弱 ETag 不能用于 If-Range (服务器总是返回完整内容)
+    if (!probe.etag.empty() && probe.etag.compare(0, 2, "W/") != 0) {
+        mIfRange = probe.etag;
+    } else {
+        mIfRange = probe.lastModified;
+    }
+    
+    // Content-Range: bytes 0-0/12345
+    size_t slash = probe.contentRange.find('/');
+    if (httpCode == 206 && slash != std::string::npos) {
+        long long total = atoll(probe.contentRange.c_str() + slash + 1);
+        if (total > 0) {
+            size = (curl_off_t)total;
+            acceptRanges = true;
+        }
+    }
+    
+    FileLogger::GetInstance().LogInfo("[ThemeDownloader] Probe: HTTP %ld, size %lld, ranges %s",
+                                      httpCode, (long long)size, acceptRanges ? "yes" : "no");
+    return true;
+}
+
+void ThemeDownloader::CheckResumeInfo(const std::string& outputPath, curl_off_t size) {
+    std::string infoPath = outputPath + ".partinfo";
     
-    // 设置 CURL 选项
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L); // 5分钟超时
-    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    // 没有校验信息时无法确认旧的分段来自同一个文件, 不续传
+    std::string current;
+    if (!mIfRange.empty()) {
+        current = "validator=" + mIfRange + "\nsize=" + std::to_string((long long)size) + "\n";
+    }
     
-    // 设置进度回调
-    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
-    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
-    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    std::string saved;
+    FILE* file = fopen(infoPath.c_str(), "r");
+    if (file) {
+        char buffer[512];
+        size_t n = fread(buffer, 1, sizeof(buffer), file);
+        saved.assign(buffer, n);
+        fclose(file);
+    }
     
-    // 执行下载
-    CURLcode res = curl_easy_perform(curl);
+    if (!current.empty() && saved == current) {
+        return;
+    }
     
-    // 清理
-    fclose(fp);
+    bool discarded = (unlink((outputPath + ".part").c_str()) == 0);
+    for (int i = 0; i < PARALLEL_SEGMENTS; i++) {
+        discarded = (unlink((outputPath + ".part" + std::to_string(i)).c_str()) == 0) || discarded;
+    }
+    if (discarded) {
+        FileLogger::GetInstance().LogWarning("[ThemeDownloader] Remote file changed or unverifiable, discarding partial download of %s",
+                                             outputPath.c_str());
+    }
+    
+    if (current.empty()) {
+        unlink(infoPath.c_str());
+        return;
+    }
+    file = fopen(infoPath.c_str(), "w");
+    if (file) {
+        fputs(current.c_str(), file);
+        fclose(file);
+    }
+}
+
+void ThemeDownloader::PrepareSegments(const std::string& outputPath, curl_off_t size, bool parallel) {
+    mSegments.clear();
+    mTotalSize = size;
+    mRateTime = 0;
+    
+    int count = parallel ? PARALLEL_SEGMENTS : 1;
+    
+    // 服务器上的文件改变后旧的分段不能和新数据拼接
+    CheckResumeInfo(outputPath, size);
+    
+    // 删除另一种分段方式留下的文件, 避免混用
+    if (parallel) {
+        unlink((outputPath + ".part").c_str());
+    } else {
+        for (int i = 0; i < PARALLEL_SEGMENTS; i++) {
+            unlink((outputPath + ".part" + std::to_string(i)).c_str());
+        }
+    }
     
-    if (res != CURLE_OK) {
-        curl_easy_cleanup(curl);
+    curl_off_t segmentSize = parallel ? size / count : 0;
+    for (int i = 0; i < count; i++) {
+        Segment segment;
+        segment.owner = this;
+        segment.partPath = parallel ? outputPath + ".part" + std::to_string(i) : outputPath + ".part";
+        segment.start = parallel ? segmentSize * i : 0;
+        segment.end = parallel ? ((i == count - 1) ? size - 1 : segmentSize * (i + 1) - 1) : -1;
         
-        // 如果是用户取消，不报告错误
-        if (mCancelRequested.load()) {
-            FileLogger::GetInstance().LogInfo("Download cancelled by user");
-            return false;
+        // 续传: .part 中已有的数据
+        struct stat st;
+        if (stat(segment.partPath.c_str(), &st) == 0 && st.st_size > 0) {
+            segment.have = (curl_off_t)st.st_size;
+            curl_off_t length = (segment.end >= 0) ? segment.end - segment.start + 1 : -1;
+            if (length >= 0 && segment.have >= length) {
+                // 多余的数据说明文件已损坏, 重新下载该段
+                if (segment.have > length) {
+                    unlink(segment.partPath.c_str());
+                    segment.have = 0;
+                } else {
+                    segment.done = true;
+                }
+            } else if (length < 0 && size > 0 && segment.have >= size) {
+                segment.done = (segment.have == size);
+                if (!segment.done) {
+                    unlink(segment.partPath.c_str());
+                    segment.have = 0;
+                }
+            }
+            
+            if (segment.have > 0) {
+                FileLogger::GetInstance().LogInfo("[ThemeDownloader] Resuming %s at %lld bytes%s",
+                                                  segment.partPath.c_str(), (long long)segment.have,
+                                                  segment.done ? " (complete)" : "");
+            }
         }
         
-        mErrorMessage = std::string("Download failed: ") + curl_easy_strerror(res);
-        FileLogger::GetInstance().LogError("CURL error [%d]: %s", res, curl_easy_strerror(res));
-        return false;
+        mSegments.push_back(segment);
+    }
+}
+
+bool ThemeDownloader::RunSegments(const std::string& url, std::string& error) {
+    std::vector<DownloadOperation*> ops;
+    for (auto& segment : mSegments) {
+        if (segment.done) {
+            continue;
+        }
+        
+        segment.received = 0;
+        segment.rangeIgnored = false;
+        segment.fp = fopen(segment.partPath.c_str(), segment.have > 0 ? "ab" : "wb");
+        if (!segment.fp) {
+            error = "Failed to create temp file";
+            FileLogger::GetInstance().LogError("Failed to create file: %s", segment.partPath.c_str());
+            break;
+        }
+        setvbuf(segment.fp, nullptr, _IOFBF, 64 * 1024);
+        
+        // 只有需要时才发送 Range
+        char range[64] = "";
+        curl_off_t from = segment.start + segment.have;
+        if (segment.end >= 0) {
+            snprintf(range, sizeof(range), "%lld-%lld", (long long)from, (long long)segment.end);
+        } else if (from > 0) {
+            snprintf(range, sizeof(range), "%lld-", (long long)from);
+        }
+        segment.rangeRequested = (range[0] != '\0');
+        
+        // 数据直接写入 .part, 续传和重试由这里按已有大小处理, 队列不自动重试
+        segment.op = new DownloadOperation();
+        segment.op->url = url;
+        segment.op->range = range;
+        segment.op->ifRange = mIfRange;
+        segment.op->priority = DownloadPriority::NORMAL;
+        segment.op->traffic = DownloadTraffic::BULK;  // 浏览缩略图时让出带宽
+        segment.op->maxRetries = 0;
+        segment.op->sink = DownloadSink::CALLBACK;
+        segment.op->chunkCb = [this, seg = &segment](const char* data, size_t size) {
+            return WriteSegment(seg, data, size);
+        };
+        ops.push_back(segment.op);
+        
+        FileLogger::GetInstance().LogInfo("[ThemeDownloader] Segment %s range [%s]",
+                                          segment.partPath.c_str(), range[0] ? range : "full");
     }
     
-    // 检查 HTTP 状态码
-    long httpCode = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-    curl_easy_cleanup(curl);
+    // 所有分段同时交给下载队列, 等待结束
+    if (error.empty()) {
+        RunTransfers(ops);
+    }
     
-    if (httpCode != 200) {
-        mErrorMessage = "HTTP error: " + std::to_string(httpCode);
-        FileLogger::GetInstance().LogError("HTTP error: %ld", httpCode);
-        return false;
+    for (auto& segment : mSegments) {
+        DownloadOperation* op = segment.op;
+        if (!op) {
+            continue;
+        }
+        
+        segment.have += segment.received;
+        segment.received = 0;
+        
+        if (mCancelRequested.load() || !error.empty()) {
+            // 已取消或没有开始
+        } else if (op->status == DownloadStatus::COMPLETE) {
+            curl_off_t length = (segment.end >= 0) ? segment.end - segment.start + 1 : -1;
+            segment.done = (length < 0 || segment.have == length);
+            if (!segment.done) {
+                error = "Incomplete segment";
+            }
+        } else if (op->response_code == 416) {
+            // 请求范围无效: 丢弃该段, 下一次尝试重新下载
+            FileLogger::GetInstance().LogWarning("[ThemeDownloader] HTTP 416 for %s, discarding", segment.partPath.c_str());
+            segment.fp = freopen(segment.partPath.c_str(), "wb", segment.fp);
+            segment.have = 0;
+            if (segment.stream) {
+                segment.stream->Abandon();
+                segment.stream = nullptr;
+            }
+            ResetHash();
+            error = "HTTP error: 416";
+        } else if (segment.rangeIgnored) {
+            error = "Range not supported";
+        } else if (op->result != CURLE_OK) {
+            error = std::string("Download failed: ") + curl_easy_strerror(op->result);
+            FileLogger::GetInstance().LogError("CURL error [%d]: %s", op->result, curl_easy_strerror(op->result));
+        } else {
+            error = "HTTP error: " + std::to_string(op->response_code);
+            FileLogger::GetInstance().LogError("HTTP error: %ld", op->response_code);
+        }
+        
+        if (mRemoteEtag.empty()) {
+            mRemoteEtag = op->etag;
+        }
+        TakeExpectedDigest(op->digest);
+        
+        delete op;
+        segment.op = nullptr;
     }
     
-    FileLogger::GetInstance().LogInfo("Download completed successfully");
+    // 清理, .part 文件保留用于续传
+    for (auto& segment : mSegments) {
+        if (segment.fp) {
+            fclose(segment.fp);
+            segment.fp = nullptr;
+        }
+    }
+    
+    for (const auto& segment : mSegments) {
+        if (!segment.done) {
+            if (error.empty()) {
+                error = "Download interrupted";
+            }
+            return false;
+        }
+    }
     return true;
 }
 
-bool ThemeDownloader::ExtractZip(const std::string& zipPath, const std::string& extractPath) {
-    FileLogger::GetInstance().LogInfo("Extracting: %s -> %s", zipPath.c_str(), extractPath.c_str());
+bool ThemeDownloader::MergeSegments(const std::string& outputPath, unsigned char digest[32]) {
+    unlink(outputPath.c_str());
     
-    // 创建目标目录
-    CreateDirectoryRecursive(extractPath);
+    if (mSegments.size() == 1) {
+        if (rename(mSegments[0].partPath.c_str(), outputPath.c_str()) != 0) {
+            return false;
+        }
+        unlink((outputPath + ".partinfo").c_str());
+        if (mHashStreaming) {
+            mbedtls_sha256_finish(&mHash, digest);
+            return true;
+        }
+    }
     
-    // 打开 ZIP 文件
-    unzFile zipFile = unzOpen(zipPath.c_str());
-    if (!zipFile) {
-        mErrorMessage = "Failed to open ZIP file";
-        FileLogger::GetInstance().LogError("Failed to open ZIP: %s", zipPath.c_str());
-        return false;
+    // 分段或续传的数据没有按顺序经过 WriteSegment: 合并时 (单段时读一遍文件) 计算摘要
+    mbedtls_sha256_starts(&mHash, 0);
+    FileIO::Buffer buffer(FileIO::CHUNK_SIZE);
+    bool ok = buffer.size() > 0;
+    
+    if (mSegments.size() == 1) {
+        FileIO in;
+        ok = ok && in.Open(outputPath, FileIO::MODE_READ);
+        size_t n;
+        while (ok && (n = in.Read(buffer.data(), buffer.size())) > 0) {
+            mbedtls_sha256_update(&mHash, buffer.data(), n);
+        }
+        mbedtls_sha256_finish(&mHash, digest);
+        return ok;
     }
     
-    // 获取文件信息
-    unz_global_info globalInfo;
-    if (unzGetGlobalInfo(zipFile, &globalInfo) != UNZ_OK) {
-        unzClose(zipFile);
-        mErrorMessage = "Failed to get ZIP info";
+    FileIO out;
+    if (!out.Open(outputPath, FileIO::MODE_WRITE)) {
         return false;
     }
     
-    // 解压每个文件
-    char filename[256];
-    unz_file_info fileInfo;
-    
-    for (uLong i = 0; i < globalInfo.number_entry; i++) {
-        // 检查是否取消
-        if (mCancelRequested.load()) {
-            unzClose(zipFile);
-            return false;
+    for (const auto& segment : mSegments) {
+        if (!ok) {
+            break;
         }
-        
-        if (unzGetCurrentFileInfo(zipFile, &fileInfo, filename, sizeof(filename), 
-                                 nullptr, 0, nullptr, 0) != UNZ_OK) {
+        FileIO in;
+        if (!in.Open(segment.partPath, FileIO::MODE_READ)) {
+            ok = false;
             break;
         }
-        
-        std::string fullPath = extractPath + "/" + filename;
-        
-        // 如果是目录
-        if (filename[strlen(filename) - 1] == '/') {
-            CreateDirectoryRecursive(fullPath);
-        } else {
-            // 创建父目录
-            std::string dir = fullPath.substr(0, fullPath.find_last_of('/'));
-            CreateDirectoryRecursive(dir);
-            
-            // 打开 ZIP 中的文件
-            if (unzOpenCurrentFile(zipFile) != UNZ_OK) {
+        size_t n;
+        while ((n = in.Read(buffer.data(), buffer.size())) > 0) {
+            mbedtls_sha256_update(&mHash, buffer.data(), n);
+            if (!out.Write(buffer.data(), n)) {
+                ok = false;
                 break;
             }
-            
-            // 创建输出文件
-            FILE* outFile = fopen(fullPath.c_str(), "wb");
-            if (outFile) {
-                char buffer[8192];
-                int bytesRead;
-                
-                while ((bytesRead = unzReadCurrentFile(zipFile, buffer, sizeof(buffer))) > 0) {
-                    fwrite(buffer, 1, bytesRead, outFile);
+        }
+    }
+    ok = out.Close() && ok;
+    mbedtls_sha256_finish(&mHash, digest);
+    
+    if (!ok) {
+        unlink(outputPath.c_str());
+        return false;
+    }
+    
+    for (const auto& segment : mSegments) {
+        unlink(segment.partPath.c_str());
+    }
+    unlink((outputPath + ".partinfo").c_str());
+    return true;
+}
+
+void ThemeDownloader::ResetHash() {
+    mHashStreaming = (mSegments.size() == 1 && mSegments[0].have == 0);
+    if (mHashStreaming) {
+        mbedtls_sha256_starts(&mHash, 0);
+    }
+}
+
+static std::string ToHex(const unsigned char* data, size_t size) {
+    static const char* digits = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = 0; i < size; i++) {
+        hex += digits[data[i] >> 4];
+        hex += digits[data[i] & 0xf];
+    }
+    return hex;
+}
+
+void ThemeDownloader::TakeExpectedDigest(const std::string& header) {
+    // Repr-Digest: sha-256=:<base64>:, sha-512=:...:   Digest: SHA-256=<base64>
+    if (!mExpectedDigest.empty() || header.empty()) {
+        return;
+    }
+    size_t pos = 0;
+    while (pos < header.size() && strncasecmp(header.c_str() + pos, "sha-256=", 8) != 0) {
+        pos++;
+    }
+    if (pos >= header.size()) {
+        return;
+    }
+    pos += 8;
+    if (pos < header.size() && header[pos] == ':') {
+        pos++;
+    }
+    
+    unsigned char digest[32];
+    size_t length = 0;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (; pos < header.size() && length < sizeof(digest); pos++) {
+        char c = header[pos];
+        int value;
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '+') value = 62;
+        else if (c == '/') value = 63;
+        else break;
+        bits = (bits << 6) | (uint32_t)value;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            digest[length++] = (unsigned char)(bits >> bitCount);
+        }
+    }
+    if (length == sizeof(digest)) {
+        mExpectedDigest = ToHex(digest, sizeof(digest));
+    }
+}
+
+bool ThemeDownloader::VerifyDownload(const std::string& url, const std::string& outputPath, const unsigned char digest[32]) {
+    std::string actual = ToHex(digest, 32);
+    std::string recordPath = outputPath + ".sha256";
+    
+    struct stat st;
+    long long size = (stat(outputPath.c_str(), &st) == 0) ? (long long)st.st_size : -1;
+    
+    // 服务器没有提供摘要时, 用同一地址、同一 ETag (同一份内容) 上次下载记录的摘要
+    std::string expected = mExpectedDigest;
+    const char* source = "server";
+    if (expected.empty() && !mRemoteEtag.empty()) {
+        FILE* file = fopen(recordPath.c_str(), "r");
+        if (file) {
+            std::string recordUrl, recordEtag, recordHash;
+            long long recordSize = -1;
+            char line[1024];
+            while (fgets(line, sizeof(line), file)) {
+                std::string entry(line);
+                while (!entry.empty() && (entry.back() == '\n' || entry.back() == '\r')) {
+                    entry.pop_back();
+                }
+                if (entry.compare(0, 4, "url=") == 0) {
+                    recordUrl = entry.substr(4);
+                } else if (entry.compare(0, 5, "etag=") == 0) {
+                    recordEtag = entry.substr(5);
+                } else if (entry.compare(0, 5, "size=") == 0) {
+                    recordSize = atoll(entry.c_str() + 5);
+                } else if (entry.compare(0, 7, "sha256=") == 0) {
+                    recordHash = entry.substr(7);
                 }
-                
-                fclose(outFile);
             }
-            
-            unzCloseCurrentFile(zipFile);
+            fclose(file);
+            if (recordUrl == url && recordEtag == mRemoteEtag && recordSize == size) {
+                expected = recordHash;
+                source = "recorded";
+            }
+        }
+    }
+    
+    if (!expected.empty() && expected != actual) {
+        FileLogger::GetInstance().LogError("[ThemeDownloader] SHA-256 mismatch for %s: %s, expected %s (%s)",
+                                           outputPath.c_str(), actual.c_str(), expected.c_str(), source);
+        unlink(outputPath.c_str());
+        unlink(recordPath.c_str());
+        mErrorMessage = "Downloaded file is corrupted";
+        return false;
+    }
+    FileLogger::GetInstance().LogInfo("[ThemeDownloader] SHA-256 %s (%s)", actual.c_str(),
+                                      expected.empty() ? "not verified" : source);
+    
+    FILE* file = fopen(recordPath.c_str(), "w");
+    if (file) {
+        fprintf(file, "url=%s\n", url.c_str());
+        if (!mRemoteEtag.empty()) {
+            fprintf(file, "etag=%s\n", mRemoteEtag.c_str());
+        }
+        fprintf(file, "size=%lld\nsha256=%s\n", size, actual.c_str());
+        fclose(file);
+    }
+    return true;
+}
+
+bool ThemeDownloader::DownloadFile(const std::string& url, const std::string& outputPath, ZipStreamExtractor* stream) {
+    FileLogger::GetInstance().LogInfo("Downloading: %s -> %s", url.c_str(), outputPath.c_str());
+    
+    // 创建输出目录
+    std::string dir = outputPath.substr(0, outputPath.find_last_of('/'));
+    CreateDirectoryRecursive(dir);
+    
+    // 探测文件大小和 Range 支持, 大文件分段并行下载
+    curl_off_t size = -1;
+    bool acceptRanges = false;
+    mExpectedDigest.clear();
+    mRemoteEtag.clear();
+    mIfRange.clear();
+    ProbeRemoteFile(url, size, acceptRanges);
+    bool parallel = acceptRanges && size >= PARALLEL_MIN_SIZE;
+    
+    PrepareSegments(outputPath, acceptRanges ? size : -1, parallel);
+    ResetHash();
+    
+    // 单连接从头下载时数据按文件顺序到达, 可以边下载边解压; 续传时已有的数据不再经过回调
+    // 之后的重试从 .part 的末尾续传, 交给解压的数据仍然是连续的
+    if (stream && mSegments.size() == 1 && mSegments[0].have == 0) {
+        mSegments[0].stream = stream->Start() ? stream : nullptr;
+    }
+    
+    std::string error;
+    for (int attempt = 1; attempt <= MAX_DOWNLOAD_ATTEMPTS; attempt++) {
+        error.clear();
+        if (RunSegments(url, error)) {
+            break;
         }
         
-        // 移动到下一个文件
-        if (i + 1 < globalInfo.number_entry) {
-            if (unzGoToNextFile(zipFile) != UNZ_OK) {
-                break;
-            }
+        // 如果是用户取消，不报告错误 (.part 保留, 下次继续)
+        if (mCancelRequested.load()) {
+            FileLogger::GetInstance().LogInfo("Download cancelled by user");
+            return false;
+        }
+        
+        // 服务器不支持分段, 回退到单个连接
+        if (error == "Range not supported" && mSegments.size() > 1) {
+            FileLogger::GetInstance().LogWarning("[ThemeDownloader] Falling back to a single connection");
+            PrepareSegments(outputPath, size, false);
+            ResetHash();
         }
         
-        // 更新进度
-        float extractProgress = 0.9f + (0.1f * (float)(i + 1) / (float)globalInfo.number_entry);
-        mProgress.store(extractProgress);
+        FileLogger::GetInstance().LogWarning("[ThemeDownloader] Attempt %d/%d failed: %s",
+                                             attempt, MAX_DOWNLOAD_ATTEMPTS, error.c_str());
+        if (attempt == MAX_DOWNLOAD_ATTEMPTS) {
+            mErrorMessage = error;
+            return false;
+        }
+        
+        // 等待后续传 (1s, 2s, 4s), 期间响应取消
+        for (int i = 0; i < (10 << (attempt - 1)) && !mCancelRequested.load(); i++) {
+            usleep(100 * 1000);
+        }
+    }
+    
+    unsigned char digest[32];
+    if (!MergeSegments(outputPath, digest)) {
+        mErrorMessage = "Failed to write downloaded file";
+        FileLogger::GetInstance().LogError("Failed to assemble %s", outputPath.c_str());
+        return false;
+    }
+    
+    // 校验不通过时不再解压和安装 (边下载边解压随之放弃)
+    if (!VerifyDownload(url, outputPath, digest)) {
+        return false;
     }
     
-    unzClose(zipFile);
+    FileLogger::GetInstance().LogInfo("Download completed successfully");
+    return true;
+}
+
+bool ThemeDownloader::ExtractZip(const std::string& zipPath, const std::string& extractPath, bool skipPatches) {
+    Trace::Span span("download", "extract", zipPath);
+    ZipExtractor extractor;
+    if (skipPatches) {
+        // 补丁不解压
+        extractor.SetFilter(IsNotPatchFile);
+    }
+    extractor.SetCancelFlag(&mCancelRequested);
+    extractor.SetProgressCallback([this](uint64_t done, uint64_t total) {
+        if (total > 0) {
+            SetState(DOWNLOAD_EXTRACTING, 0.9f + 0.1f * (float)((double)done / (double)total));
+        }
+    });
+    
+    if (!extractor.Extract(zipPath, extractPath)) {
+        mErrorMessage = extractor.GetError();
+        return false;
+    }
     
     FileLogger::GetInstance().LogInfo("Extraction completed");
     return true;
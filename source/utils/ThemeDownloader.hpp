@@ -1,10 +1,18 @@
 #pragma once
 
 #include <string>
-#include <functional>
+#include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <curl/curl.h>
+#include <coreinit/time.h>
+#include <mbedtls/sha256.h>
+#include "ProgressChannel.hpp"
+
+class ZipStreamExtractor;
+struct DownloadOperation;
 
 // 下载状态
 enum DownloadState {
@@ -17,6 +25,8 @@ enum DownloadState {
 };
 
 // 主题下载器
+// 传输交给共享的 DownloadQueue (和缩略图共用连接池和并发控制), 工作线程只负责等待、续传和解压
+// 状态和进度经过 ProgressChannel: 网络线程和工作线程写入, 界面每帧用 GetSnapshot 读一次, 双方都不等待
 class ThemeDownloader {
 public:
     ThemeDownloader();
@@ -25,24 +35,24 @@ public:
     // 下载并安装主题（异步）
     void DownloadThemeAsync(const std::string& downloadUrl, const std::string& themeName);
     
-    // 状态查询
-    DownloadState GetState() const { return mState; }
-    float GetProgress() const { return mProgress; }
+    // 状态查询; state 是 DownloadState, progress 中下载占 90%, 解压占 10%, bytes / total / rate 是下载的字节数和速度
+    ProgressSnapshot GetSnapshot() const { return mProgress.Read(); }
+    DownloadState GetState() const { return (DownloadState)mProgress.Read().state; }
+    float GetProgress() const { return mProgress.Read().progress; }
+    bool IsDownloading() const {
+        DownloadState state = GetState();
+        return state == DOWNLOAD_DOWNLOADING || state == DOWNLOAD_EXTRACTING;
+    }
+    // 以下只在状态变为 DOWNLOAD_ERROR / DOWNLOAD_COMPLETE 之后读取: 工作线程先写好再发布状态
     const std::string& GetError() const { return mErrorMessage; }
-    bool IsDownloading() const { return mState == DOWNLOAD_DOWNLOADING || mState == DOWNLOAD_EXTRACTING; }
     std::string GetDownloadedFilePath() const { return mTempFilePath; }
     std::string GetExtractedPath() const { return mExtractPath; }
     
-    // 回调设置
-    void SetProgressCallback(std::function<void(float progress, long downloaded, long total)> callback);
-    void SetStateCallback(std::function<void(DownloadState state, const std::string& message)> callback);
-    
     // 取消下载
     void Cancel();
     
 private:
-    std::atomic<DownloadState> mState;
-    std::atomic<float> mProgress;
+    ProgressChannel mProgress;
     std::atomic<bool> mCancelRequested;
     std::string mErrorMessage;
     
@@ -51,19 +61,76 @@ private:
     
     std::thread mDownloadThread;
     
-    // 回调
-    std::function<void(float progress, long downloaded, long total)> mProgressCallback;
-    std::function<void(DownloadState state, const std::string& message)> mStateCallback;
+    // 下载速度的采样 (只在网络线程中访问)
+    OSTime mRateTime = 0;
+    curl_off_t mRateBytes = 0;
+    static constexpr uint32_t RATE_INTERVAL_MS = 500;
+    
+    // 分段下载: 每段写入自己的 .part 文件, 中断后按已有大小续传
+    struct Segment {
+        ThemeDownloader* owner = nullptr;
+        std::string partPath;   // 分段文件
+        curl_off_t start = 0;   // 在完整文件中的起始偏移
+        curl_off_t end = -1;    // 结束偏移 (包含), -1 表示直到末尾 (大小未知)
+        curl_off_t have = 0;    // 已写入 .part 的字节数
+        curl_off_t received = 0; // 本次传输收到的字节数 (用于进度)
+        bool rangeRequested = false;
+        bool rangeIgnored = false; // 服务器忽略 Range 返回了 200
+        bool done = false;
+        FILE* fp = nullptr;
+        DownloadOperation* op = nullptr;
+        ZipStreamExtractor* stream = nullptr; // 不为空时写入的数据同时交给它边下载边解压
+    };
+    std::vector<Segment> mSegments;
+    curl_off_t mTotalSize = -1;
+    
+    // 等待队列中的传输结束 (回调在网络线程中执行)
+    std::mutex mTransferMutex;
+    std::condition_variable mTransferCv;
+    
+    static constexpr int PARALLEL_SEGMENTS = 3;                        // 大文件的并行分段数
+    static constexpr curl_off_t PARALLEL_MIN_SIZE = 8 * 1024 * 1024;   // 超过此大小才分段
+    static constexpr int MAX_DOWNLOAD_ATTEMPTS = 4;                    // 每次下载的最大尝试次数
+    
+    // 完整性校验: 数据边到达边计算 SHA-256, 合并后和服务器的 Repr-Digest / Digest 比较,
+    // 服务器没有提供时和同一地址、同一 ETag 上次记录的值比较 (记录在压缩包旁边的 .sha256 文件)
+    // 不一致时删除压缩包, 不解压也不安装
+    mbedtls_sha256_context mHash;
+    bool mHashStreaming = false;    // 数据按文件顺序经过 WriteSegment (从头开始的单连接下载)
+    std::string mExpectedDigest;    // 服务器提供的 SHA-256 (小写十六进制)
+    std::string mRemoteEtag;
+    
+    // 续传校验: 探测得到的校验信息和大小记录在 .part 旁边的 .partinfo 文件,
+    // 和这次探测不一致 (服务器上的文件已经改变) 或没有记录时丢弃旧的分段;
+    // 范围请求带 If-Range, 下载期间文件改变时服务器返回 200 和完整内容, 按忽略 Range 处理
+    std::string mIfRange;           // 强 ETag, 没有时用 Last-Modified
     
     // 内部方法
     void DownloadThreadFunc(const std::string& url, const std::string& themeName);
     std::string SanitizeFileName(const std::string& fileName); // 清理文件名
-    bool DownloadFile(const std::string& url, const std::string& outputPath);
-    bool ExtractZip(const std::string& zipPath, const std::string& extractPath);
+    // stream 不为空时尝试边下载边解压 (只用于从头开始的单连接下载)
+    bool DownloadFile(const std::string& url, const std::string& outputPath, ZipStreamExtractor* stream = nullptr);
+    bool ProbeRemoteFile(const std::string& url, curl_off_t& size, bool& acceptRanges);
+    // 把 ops 交给下载队列并等待全部结束; 取消时撤回没结束的传输, 返回 false
+    bool RunTransfers(const std::vector<DownloadOperation*>& ops);
+    void PrepareSegments(const std::string& outputPath, curl_off_t size, bool parallel);
+    // 检查 .partinfo 是否和这次探测一致, 不一致时删除所有分段文件并记录新的信息
+    void CheckResumeInfo(const std::string& outputPath, curl_off_t size);
+    bool RunSegments(const std::string& url, std::string& error);
+    // 合并分段并得到整个文件的 SHA-256
+    bool MergeSegments(const std::string& outputPath, unsigned char digest[32]);
+    // 单连接从头下载时在 WriteSegment 中计算摘要, 否则在合并时计算
+    void ResetHash();
+    // 从 Repr-Digest / Digest 响应头中取出 SHA-256
+    void TakeExpectedDigest(const std::string& header);
+    bool VerifyDownload(const std::string& url, const std::string& outputPath, const unsigned char digest[32]);
+    void ReportProgress();
+    // 发布新的状态和进度 (进度为负时不变)
+    void SetState(DownloadState state, float progress = -1.0f);
+    // skipPatches: 不解压 .bps 文件 (安装时直接从 ZIP 读取)
+    bool ExtractZip(const std::string& zipPath, const std::string& extractPath, bool skipPatches);
     bool CreateDirectoryRecursive(const std::string& path);
     
-    // CURL 回调
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
-    static int ProgressCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow, 
-                               curl_off_t ultotal, curl_off_t ulnow);
+    // 分段数据回调 (在网络线程中执行), 返回 false 中止该段
+    bool WriteSegment(Segment* segment, const char* data, size_t size);
 };
@@ -1,14 +1,28 @@
 #include "ThemeManager.hpp"
-#include "ThemeDownloader.hpp"
 #include "SimpleJsonParser.hpp"
 #include "DownloadQueue.hpp"
 #include "logger.h"
 #include "FileLogger.hpp"
-#include <curl/curl.h>
+#include "AllocTracker.hpp"
+#include "ThemeRegistry.hpp"
+#include "Utils.hpp"
+#include "Async.hpp"
+#include "JobSystem.hpp"
+#include "PerfProfile.hpp"
+#include "FileIO.hpp"
 #include <nn/ac.h>
 #include <coreinit/thread.h>
+#include <coreinit/time.h>
 #include <cstring>
 #include <sstream>
+#include <set>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -16,35 +30,16 @@
 #define THEMEZER_GRAPHQL_URL "https://api.themezer.net/graphql"
 #define THEMEZER_CDN_URL "https://cdn.themezer.net"
 #define CACHE_DIR "fs:/vol/external01/UTheme/temp"
-#define CACHE_FILE "fs:/vol/external01/UTheme/temp/themes_cache.json"
-
-// CURL回调函数
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    size_t realsize = size * nmemb;
-    std::string* str = (std::string*)userp;
-    str->append((char*)contents, realsize);
-    return realsize;
-}
-
-// 用于文件下载的回调函数
-struct FileDownloadData {
-    FILE* fp;
-    size_t totalWritten;
-};
+#define CACHE_FILE "fs:/vol/external01/UTheme/temp/themes_cache.bin"
+#define CACHE_META_FILE "fs:/vol/external01/UTheme/temp/themes_cache.bin.meta"
+// 热启动快照 (离开列表时的视图和第一屏缩略图)
+#define WARM_START_FILE "fs:/vol/external01/UTheme/temp/warm_start.bin"
+#define LEGACY_CACHE_FILE "fs:/vol/external01/UTheme/temp/themes_cache.json"
 
-static size_t WriteFileCallback(char* ptr, size_t size, size_t nmemb, void* userp) {
-    FileDownloadData* data = (FileDownloadData*)userp;
-    size_t totalSize = size * nmemb;
-    size_t written = fwrite(ptr, 1, totalSize, data->fp);  // 以字节为单位写入
-    data->totalWritten += written;
-    
-    // 每 100KB 输出一次进度
-    if (data->totalWritten % (100 * 1024) < totalSize) {
-        FileLogger::GetInstance().LogInfo("[DOWNLOAD PROGRESS] Written: %zu bytes", data->totalWritten);
-    }
-    
-    return written;  // 返回实际写入的字节数
-}
+// 列表卡片用到的字段 (描述只显示一行, 但也在卡片上), 其余字段打开详情页时由 FetchThemeDetails 获取
+#define THEME_LIST_FIELDS "uuid name description downloadCount saveCount updatedAt creator { username } tags { name } collagePreview { thumbUrl }"
+// 详情字段 (单个详情和预取窗口的批量详情共用)
+#define THEME_DETAIL_FIELDS "uuid description downloadUrl collagePreview { hdUrl } launcherScreenshot { thumbUrl hdUrl } waraWaraPlazaScreenshot { thumbUrl hdUrl } launcherBgUrl waraWaraPlazaBgUrl tags { name }"
 
 ThemeManager::ThemeManager() {
     // 初始化网络
@@ -55,6 +50,11 @@ ThemeManager::ThemeManager() {
 ThemeManager::~ThemeManager() {
     FileLogger::GetInstance().LogInfo("[ThemeManager] Destructor called");
     
+    // 离开列表时还没写入的占位颜色 (目录本身还在下载时不写, 和 Update 中一样)
+    if (mPlaceholderChangedMs != 0 && !mFetchOp && !mFetchStream && !mSyncing) {
+        SaveCache();
+    }
+    
     // 取消未完成的下载操作
     if (mFetchOp && DownloadQueue::GetInstance()) {
         FileLogger::GetInstance().LogInfo("[ThemeManager] Cancelling fetch operation");
@@ -68,236 +68,204 @@ ThemeManager::~ThemeManager() {
         FileLogger::GetInstance().LogInfo("[ThemeManager] Fetch operation exists but DownloadQueue is null");
     }
     
-    FileLogger::GetInstance().LogInfo("[ThemeManager] About to clean up downloader");
-    
-    // 清理主题下载器
-    if (mDownloader) {
-        FileLogger::GetInstance().LogInfo("[ThemeManager] Cancelling downloader");
-        mDownloader->Cancel();
-        FileLogger::GetInstance().LogInfo("[ThemeManager] Cancel completed, skipping delete");
-        // 注意: 不要 delete mDownloader,因为在 Wii U 上 delete 操作会阻塞
-        // 让对象泄漏,进程退出时会自动清理
-        // delete mDownloader;  // ← 这行会导致卡死!
-        mDownloader = nullptr;
-        FileLogger::GetInstance().LogInfo("[ThemeManager] Downloader cleanup complete");
+    // 同步和详情请求的回调引用了 this
+    if (mSyncOp && DownloadQueue::GetInstance()) {
+        DownloadQueue::GetInstance()->DownloadCancel(mSyncOp);
+        mSyncOp = nullptr;
+    }
+    if (DownloadQueue::GetInstance()) {
+        // 批量请求在多个 uuid 下登记同一个操作, 每个只取消一次
+        std::set<DownloadOperation*> detailOps;
+        for (auto& entry : mDetailOps) {
+            detailOps.insert(entry.second);
+        }
+        for (DownloadOperation* op : detailOps) {
+            DownloadQueue::GetInstance()->DownloadCancel(op);
+        }
     }
+    mDetailOps.clear();
     
     // 注意: 不要调用 nn::ac::Finalize(),因为其他地方可能还在使用网络
     // nn::ac 是全局的,应该在程序退出时由 ImageLoader::Cleanup 统一清理
     FileLogger::GetInstance().LogInfo("[ThemeManager] Destructor completed");
 }
 
-std::string ThemeManager::FetchUrl(const std::string& url, const std::string& postData) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        DEBUG_FUNCTION_LINE("Failed to initialize CURL");
-        return "";
-    }
-    
-    std::string response;
-    struct curl_slist* headers = nullptr;
-    
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "UTheme/1.0 (Wii U)");
-    
-    // 如果有 POST 数据,设置 POST 请求
-    if (!postData.empty()) {
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-        
-        // 设置 Content-Type 为 JSON
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+// 类型符合时读入, 否则跳过 (例如字段为 null)
+static void ReadStringField(JsonReader& reader, std::string& value) {
+    if (reader.Peek() != JSON_STRING || !reader.ReadString(value)) {
+        reader.Skip();
     }
-    
-    CURLcode res = curl_easy_perform(curl);
-    
-    // 清理 headers
-    if (headers) {
-        curl_slist_free_all(headers);
+}
+
+static void ReadStringField(JsonReader& reader, PooledString& value) {
+    std::string_view str;
+    if (reader.Peek() == JSON_STRING && reader.ReadString(str)) {
+        value = PooledString(str);
+    } else {
+        reader.Skip();
     }
-    
-    if (res != CURLE_OK) {
-        DEBUG_FUNCTION_LINE("CURL error: %s", curl_easy_strerror(res));
-        mErrorMessage = std::string("Network error: ") + curl_easy_strerror(res);
-        curl_easy_cleanup(curl);
-        return "";
+}
+
+static void ReadIntField(JsonReader& reader, int& value) {
+    if (reader.Peek() != JSON_NUMBER || !reader.ReadInt(value)) {
+        reader.Skip();
     }
-    
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    
-    curl_easy_cleanup(curl);
-    
-    if (http_code != 200) {
-        DEBUG_FUNCTION_LINE("HTTP error: %ld", http_code);
-        mErrorMessage = "HTTP error: " + std::to_string(http_code);
-        return "";
+}
+
+// 解析 ImageSizes 对象, 只覆盖响应中出现的字段
+static void ReadImageSizes(JsonReader& reader, ThemeImage& img) {
+    if (!reader.EnterObject()) {
+        reader.Skip();
+        return;
+    }
+    std::string_view key;
+    while (reader.NextMember(key)) {
+        if (key == "thumbUrl") {
+            ReadStringField(reader, img.thumbUrl);
+        } else if (key == "hdUrl") {
+            ReadStringField(reader, img.hdUrl);
+        } else {
+            reader.Skip();
+        }
     }
-    
-    return response;
 }
 
-// 解析 Themezer GraphQL 响应
-bool ThemeManager::ParseThemezerResponse(const std::string& jsonData) {
-    mThemes.clear();
-    
-    DEBUG_FUNCTION_LINE("Parsing JSON response (%zu bytes)", jsonData.size());
+// 解析主题节点 (列表或详情查询), 只覆盖响应中出现的字段
+// 节点不是对象时跳过并返回 false
+static bool ReadThemeNode(JsonReader& reader, Theme& theme) {
+    if (!reader.EnterObject()) {
+        reader.Skip();
+        return false;
+    }
     
-    try {
-        JsonValue root = SimpleJsonParser::Parse(jsonData);
-        
-        if (!root.isObject()) {
-            DEBUG_FUNCTION_LINE("Expected object at root");
-            return false;
-        }
-        
-        // GraphQL 响应格式: { "data": { "wiiuThemes": { "nodes": [...] } } }
-        if (!root.has("data") || !root["data"].isObject()) {
-            DEBUG_FUNCTION_LINE("Missing 'data' field");
-            return false;
-        }
-        
-        const JsonValue& data = root["data"];
-        if (!data.has("wiiuThemes") || !data["wiiuThemes"].isObject()) {
-            DEBUG_FUNCTION_LINE("Missing 'wiiuThemes' field");
-            return false;
-        }
-        
-        const JsonValue& wiiuThemes = data["wiiuThemes"];
-        if (!wiiuThemes.has("nodes") || !wiiuThemes["nodes"].isArray()) {
-            DEBUG_FUNCTION_LINE("Missing 'nodes' array");
-            return false;
-        }
-        
-        const JsonValue& nodes = wiiuThemes["nodes"];
-        
-        // 辅助函数: 解析 ImageSizes 对象
-        auto parseImageSizes = [](const JsonValue& imgObj) -> ThemeImage {
-            ThemeImage img;
-            if (imgObj.has("thumbUrl") && imgObj["thumbUrl"].isString()) {
-                img.thumbUrl = imgObj["thumbUrl"].asString();
-            }
-            if (imgObj.has("hdUrl") && imgObj["hdUrl"].isString()) {
-                img.hdUrl = imgObj["hdUrl"].asString();
-            }
-            return img;
-        };
-        
-        // 遍历主题数组
-        for (size_t i = 0; i < nodes.size(); i++) {
-            const JsonValue& themeJson = nodes[i];
-            
-            if (!themeJson.isObject()) {
-                continue;
-            }
-            
-            Theme theme;
-            
-            // 解析主题数据
-            if (themeJson.has("uuid") && themeJson["uuid"].isString()) {
-                theme.id = themeJson["uuid"].asString();
-            }
-            
-            if (themeJson.has("name") && themeJson["name"].isString()) {
-                theme.name = themeJson["name"].asString();
-            }
-            
-            if (themeJson.has("description") && themeJson["description"].isString()) {
-                theme.description = themeJson["description"].asString();
-            } else {
-                theme.description = "";
-            }
-            
+    std::string_view key;
+    while (reader.NextMember(key)) {
+        if (key == "uuid") {
+            ReadStringField(reader, theme.id);
+        } else if (key == "name") {
+            ReadStringField(reader, theme.name);
+        } else if (key == "description") {
+            ReadStringField(reader, theme.EditDetails().description);
+        } else if (key == "creator") {
             // 作者信息
-            if (themeJson.has("creator") && themeJson["creator"].isObject()) {
-                const JsonValue& creator = themeJson["creator"];
-                if (creator.has("username") && creator["username"].isString()) {
-                    theme.author = creator["username"].asString();
+            if (reader.EnterObject()) {
+                while (reader.NextMember(key)) {
+                    if (key == "username") {
+                        ReadStringField(reader, theme.author);
+                    } else {
+                        reader.Skip();
+                    }
                 }
+            } else {
+                reader.Skip();
             }
-            
+        } else if (key == "downloadCount") {
             // 统计信息 (GraphQL 使用 downloadCount 和 saveCount)
-            if (themeJson.has("downloadCount") && themeJson["downloadCount"].isNumber()) {
-                theme.downloads = themeJson["downloadCount"].asInt();
-            }
-            
-            if (themeJson.has("saveCount") && themeJson["saveCount"].isNumber()) {
-                theme.likes = themeJson["saveCount"].asInt();
-            }
-            
-            // 版本 (GraphQL 没有 version 字段,使用空字符串)
-            theme.version = "1.0";
-            
-            // 更新时间
-            if (themeJson.has("updatedAt") && themeJson["updatedAt"].isString()) {
-                theme.updatedAt = themeJson["updatedAt"].asString();
-            }
-            
-            // 解析图片 URLs
-            if (themeJson.has("collagePreview") && themeJson["collagePreview"].isObject()) {
-                theme.collagePreview = parseImageSizes(themeJson["collagePreview"]);
-            }
-            
-            if (themeJson.has("launcherScreenshot") && themeJson["launcherScreenshot"].isObject()) {
-                theme.launcherScreenshot = parseImageSizes(themeJson["launcherScreenshot"]);
-            }
-            
-            if (themeJson.has("waraWaraPlazaScreenshot") && themeJson["waraWaraPlazaScreenshot"].isObject()) {
-                theme.waraWaraScreenshot = parseImageSizes(themeJson["waraWaraPlazaScreenshot"]);
-            }
-            
-            // 背景图 URLs
-            if (themeJson.has("launcherBgUrl") && themeJson["launcherBgUrl"].isString()) {
-                theme.launcherBgUrl = themeJson["launcherBgUrl"].asString();
-            }
-            
-            if (themeJson.has("waraWaraPlazaBgUrl") && themeJson["waraWaraPlazaBgUrl"].isString()) {
-                theme.waraWaraBgUrl = themeJson["waraWaraPlazaBgUrl"].asString();
-            }
-            
-            // 下载 URL
-            if (themeJson.has("downloadUrl") && themeJson["downloadUrl"].isString()) {
-                theme.downloadUrl = themeJson["downloadUrl"].asString();
-            }
-            
-            // 标签
-            if (themeJson.has("tags") && themeJson["tags"].isArray()) {
-                const JsonValue& tagsArray = themeJson["tags"];
-                for (size_t j = 0; j < tagsArray.size(); j++) {
-                    const JsonValue& tagObj = tagsArray[j];
-                    if (tagObj.isObject() && tagObj.has("name") && tagObj["name"].isString()) {
-                        theme.tags.push_back(tagObj["name"].asString());
+            ReadIntField(reader, theme.downloads);
+        } else if (key == "saveCount") {
+            ReadIntField(reader, theme.likes);
+        } else if (key == "updatedAt") {
+            ReadStringField(reader, theme.updatedAt);
+        } else if (key == "collagePreview") {
+            ReadImageSizes(reader, theme.collagePreview);
+        } else if (key == "launcherScreenshot") {
+            ReadImageSizes(reader, theme.EditDetails().launcherScreenshot);
+        } else if (key == "waraWaraPlazaScreenshot") {
+            ReadImageSizes(reader, theme.EditDetails().waraWaraScreenshot);
+        } else if (key == "launcherBgUrl") {
+            ReadStringField(reader, theme.EditDetails().launcherBgUrl);
+        } else if (key == "waraWaraPlazaBgUrl") {
+            ReadStringField(reader, theme.EditDetails().waraWaraBgUrl);
+        } else if (key == "downloadUrl") {
+            ReadStringField(reader, theme.EditDetails().downloadUrl);
+        } else if (key == "tags" && reader.EnterArray()) {
+            theme.tags.clear();
+            while (reader.NextElement()) {
+                if (!reader.EnterObject()) {
+                    reader.Skip();
+                    continue;
+                }
+                while (reader.NextMember(key)) {
+                    std::string_view tag;
+                    if (key == "name" && reader.Peek() == JSON_STRING && reader.ReadString(tag)) {
+                        theme.tags.emplace_back(tag);
+                    } else {
+                        reader.Skip();
                     }
                 }
             }
-            
-            // 只添加有效的主题
-            if (!theme.id.empty() && !theme.name.empty()) {
-                mThemes.push_back(theme);
-                DEBUG_FUNCTION_LINE("Loaded theme: %s by %s", theme.name.c_str(), theme.author.c_str());
-            }
+        } else {
+            reader.Skip();
         }
-        
-        return !mThemes.empty();
-        
-    } catch (...) {
-        DEBUG_FUNCTION_LINE("Exception while parsing JSON");
-        return false;
     }
+    ThemeManager::BuildDisplayStrings(theme);
+    return !reader.HasError();
+}
+
+// 定位到 GraphQL 响应中的 data.<field>, 成功时 reader 停在该字段的值上
+static bool EnterGraphQLData(JsonReader& reader, std::string_view field) {
+    return reader.EnterObject() && reader.FindMember("data") &&
+           reader.EnterObject() && reader.FindMember(field);
 }
 
+// 定位到 data.wiiuThemes.nodes 数组之内
+static bool EnterThemeNodes(JsonReader& reader) {
+    return EnterGraphQLData(reader, "wiiuThemes") &&
+           reader.EnterObject() && reader.FindMember("nodes") && reader.EnterArray();
+}
+
+// 正在下载的一页目录: 网络线程在数据块到达时拆分出 nodes 数组的元素并解析成 Theme,
+// 主线程在 Update 中取走 (详情页打开期间不改变 mThemes)
+struct CatalogPageStream {
+    int page = 1;
+    bool intoList = false;         // 第一页且列表为空: 边下载边显示
+    
+    JsonArrayStream splitter;
+    std::mutex mutex;
+    std::vector<Theme> ready;      // 已解析, 等待主线程取走 (受 mutex 保护)
+    size_t nodeCount = 0;          // 数组元素数, 用来判断是否还有下一页 (受 mutex 保护)
+    
+    // 以下只在主线程访问
+    std::vector<Theme> received;   // 刷新第一页时先收集, 完整后再替换列表
+    bool completed = false;        // 传输已结束
+    bool transferOk = false;
+    long responseCode = 0;
+    DownloadOperation validators;  // 响应的 ETag / Last-Modified
+    
+    CatalogPageStream()
+        : splitter({"data", "wiiuThemes", "nodes"}, [this](std::string_view node) { ParseNode(node); }) {
+    }
+    
+    void ParseNode(std::string_view node) {
+        AllocTracker::TagScope allocTag(AllocTracker::TAG_CATALOG);
+        JsonReader reader(node);
+        Theme theme;
+        bool valid = ReadThemeNode(reader, theme) && !theme.id.empty() && !theme.name.empty();
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        nodeCount++;
+        if (valid) {
+            ready.push_back(std::move(theme));
+        }
+    }
+};
+
 void ThemeManager::FetchThemes() {
     if (mState == FETCH_IN_PROGRESS) {
         return;
     }
     
+    // 后台加载中的后续页作废, 从第一页重新开始
+    if (mFetchOp && DownloadQueue::GetInstance()) {
+        DownloadQueue::GetInstance()->DownloadCancel(mFetchOp);
+        delete mFetchOp;
+        mFetchOp = nullptr;
+    }
+    mFetchStream.reset();
+    mPendingThemes.clear();
+    mHasMorePages = false;
+    CancelSync();
+    
     mState = FETCH_IN_PROGRESS;
     mErrorMessage.clear();
     
@@ -308,17 +276,34 @@ void ThemeManager::FetchThemes() {
     DEBUG_FUNCTION_LINE("Fetching themes from Themezer GraphQL API (ASYNC)");
     FileLogger::GetInstance().LogInfo("Starting async FetchThemes");
     
-    // 构造 GraphQL 查询 (包含图片URL) - 设置limit为200以获取更多主题
-    std::string query = R"({
-        "query": "{ wiiuThemes(limit: 200) { nodes { uuid name description downloadCount saveCount updatedAt creator { username } downloadUrl collagePreview { thumbUrl hdUrl } launcherScreenshot { thumbUrl hdUrl } waraWaraPlazaScreenshot { thumbUrl hdUrl } launcherBgUrl waraWaraPlazaBgUrl tags { name } } } }"
-    })";
-    
+    FetchPage(1);
+}
+
+void ThemeManager::LoadMoreThemes() {
+    if (mFetchOp || mFetchStream || !mHasMorePages || mState == FETCH_IN_PROGRESS) {
+        return;
+    }
+    FetchPage(mNextPage);
+}
+
+std::string ThemeManager::BuildThemesQuery(int page) const {
+    // 构造 GraphQL 查询, 每页 CATALOG_PAGE_SIZE 个主题, 只取列表字段
+    char query[512];
+    snprintf(query, sizeof(query), R"({
+        "query": "{ wiiuThemes(limit: %d, page: %d) { nodes { )" THEME_LIST_FIELDS R"( } } }"
+    })", CATALOG_PAGE_SIZE, page);
+    return query;
+}
+
+void ThemeManager::FetchPage(int page) {
     // 使用 DownloadQueue 进行异步请求
     if (!DownloadQueue::GetInstance()) {
-        mState = FETCH_ERROR;
-        mErrorMessage = "DownloadQueue not initialized";
-        if (mStateCallback) {
-            mStateCallback(FETCH_ERROR, mErrorMessage);
+        if (page == 1) {
+            mState = FETCH_ERROR;
+            mErrorMessage = "DownloadQueue not initialized";
+            if (mStateCallback) {
+                mStateCallback(FETCH_ERROR, mErrorMessage);
+            }
         }
         return;
     }
@@ -326,46 +311,33 @@ void ThemeManager::FetchThemes() {
     // 创建下载操作
     mFetchOp = new DownloadOperation();
     mFetchOp->url = THEMEZER_GRAPHQL_URL;
-    mFetchOp->postData = query;  // GraphQL 查询作为 POST 数据
+    mFetchOp->postData = BuildThemesQuery(page);  // GraphQL 查询作为 POST 数据
+    mFetchOp->compressed = true;                   // JSON 中大量重复的字段名和 CDN 地址, 压缩后小很多
     
-    // 设置回调
-    mFetchOp->cb = [this](DownloadOperation* op) {
-        if (op->status == DownloadStatus::COMPLETE && !op->buffer.empty()) {
-            FileLogger::GetInstance().LogInfo("Async FetchThemes COMPLETE: %zu bytes", op->buffer.size());
-            
-            // 解析响应
-            if (ParseThemezerResponse(op->buffer)) {
-                mState = FETCH_SUCCESS;
-                if (mStateCallback) {
-                    mStateCallback(FETCH_SUCCESS, "Themes loaded successfully");
-                }
-                DEBUG_FUNCTION_LINE("Successfully loaded %zu themes", mThemes.size());
-                FileLogger::GetInstance().LogInfo("FetchThemes SUCCESS: %zu themes loaded", mThemes.size());
-                
-                // 保存到缓存
-                if (SaveCache()) {
-                    FileLogger::GetInstance().LogInfo("Cache saved successfully after FetchThemes");
-                } else {
-                    FileLogger::GetInstance().LogError("Failed to save cache after FetchThemes");
-                }
-            } else {
-                mState = FETCH_ERROR;
-                mErrorMessage = "Failed to parse theme data";
-                if (mStateCallback) {
-                    mStateCallback(FETCH_ERROR, mErrorMessage);
-                }
-                FileLogger::GetInstance().LogError("Failed to parse theme response");
-            }
-        } else {
-            mState = FETCH_ERROR;
-            mErrorMessage = "Network request failed";
-            if (mStateCallback) {
-                mStateCallback(FETCH_ERROR, mErrorMessage);
-            }
-            FileLogger::GetInstance().LogError("Async FetchThemes FAILED: HTTP %ld", op->response_code);
-        }
+    // GraphQL 查询是 POST, 条件请求没有意义, 不发送 If-None-Match / If-Modified-Since
+    // (已有缓存时的刷新走 SyncThemes 的增量同步); 后续页只在后台加载, 不抢占缩略图的带宽
+    if (page > 1) {
+        mFetchOp->priority = DownloadPriority::LOW;
+    }
+    
+    // 响应边下载边解析, 不在内存中保留整个响应
+    auto stream = std::make_shared<CatalogPageStream>();
+    stream->page = page;
+    stream->intoList = (page == 1 && mThemes.empty());
+    mFetchStream = stream;
+    mFetchOp->sink = DownloadSink::CALLBACK;
+    mFetchOp->chunkCb = [stream](const char* data, size_t size) {
+        return stream->splitter.Feed(data, size); // 在网络线程中调用
+    };
+    
+    // 传输结束: 记下结果, 在 Update 中处理
+    mFetchOp->cb = [this, stream](DownloadOperation* op) {
+        stream->completed = true;
+        stream->transferOk = (op->status == DownloadStatus::COMPLETE);
+        stream->responseCode = op->response_code;
+        stream->validators.etag = op->etag;
+        stream->validators.lastModified = op->lastModified;
         
-        // 清理
         delete mFetchOp;
         mFetchOp = nullptr;
     };
@@ -374,128 +346,320 @@ void ThemeManager::FetchThemes() {
     
     //  添加到异步下载队列 (不阻塞!)
     DownloadQueue::GetInstance()->DownloadAdd(mFetchOp);
-    FileLogger::GetInstance().LogInfo("FetchThemes request added to DownloadQueue");
+    FileLogger::GetInstance().LogInfo("FetchThemes page %d request added to DownloadQueue", page);
 }
 
-void ThemeManager::DownloadTheme(const Theme& theme) {
-    FileLogger::GetInstance().LogInfo("Starting async theme download: %s", theme.name.c_str());
-    FileLogger::GetInstance().LogInfo("Download URL: %s", theme.downloadUrl.c_str());
-    
-    if (theme.downloadUrl.empty()) {
-        FileLogger::GetInstance().LogError("Download URL is empty!");
-        if (mStateCallback) {
-            mStateCallback(FETCH_ERROR, "Download URL is empty");
-        }
+// 取走网络线程解析好的主题, 传输结束后完成这一页
+void ThemeManager::DrainFetchStream() {
+    std::shared_ptr<CatalogPageStream> stream = mFetchStream;
+    if (!stream) {
         return;
     }
     
-    // 如果已有下载器，清理 (包括待清理的)
-    if (mDownloader) {
-        FileLogger::GetInstance().LogInfo("[DownloadTheme] Cleaning up existing downloader");
-        mDownloader->Cancel();
-        delete mDownloader;
-        mDownloader = nullptr;
-        mDownloaderNeedsCleanup = false;  // 重置标志
+    std::vector<Theme> ready;
+    size_t nodeCount;
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        ready.swap(stream->ready);
+        nodeCount = stream->nodeCount;
     }
     
-    // 创建新的下载器
-    mDownloader = new ThemeDownloader();
-    
-    // 设置回调
-    mDownloader->SetProgressCallback([this](float progress, long downloaded, long total) {
-        if (mProgressCallback) {
-            mProgressCallback(progress, downloaded, total);
-        }
-        // 只在重要节点打印日志，避免刷屏
-        if (progress == 1.0f || (int)(progress * 10) != (int)((progress - 0.01f) * 10)) {
-            FileLogger::GetInstance().LogInfo("Download progress: %.1f%% (%ld / %ld bytes)", 
-                progress * 100, downloaded, total);
+    if (!ready.empty()) {
+        if (stream->intoList) {
+            // 冷启动: 第一批主题到达就显示列表, 之后的追加到末尾 (不改变已有主题的位置)
+            for (Theme& theme : ready) {
+                mThemes.push_back(std::move(theme));
+            }
+            if (mState != FETCH_SUCCESS) {
+                mState = FETCH_SUCCESS;
+                mListVersion++;
+                mCatalogVersion++;
+                if (mStateCallback) {
+                    mStateCallback(FETCH_SUCCESS, "Themes loaded successfully");
+                }
+            }
+        } else if (stream->page == 1) {
+            for (Theme& theme : ready) {
+                stream->received.push_back(std::move(theme));
+            }
+        } else {
+            // 后续页和其他页一样在下面合并并去重
+            for (Theme& theme : ready) {
+                mPendingThemes.push_back(std::move(theme));
+            }
         }
-    });
+    }
     
-    mDownloader->SetStateCallback([this, theme](DownloadState state, const std::string& message) {
-        FileLogger::GetInstance().LogInfo("Download state: %d - %s", state, message.c_str());
+    if (stream->completed) {
+        mFetchStream.reset();
+        FinishPage(*stream, nodeCount);
+    }
+}
+
+void ThemeManager::FinishPage(CatalogPageStream& stream, size_t nodeCount) {
+    int page = stream.page;
+    bool ok = false;
+    
+    if (stream.transferOk && stream.splitter.Finished()) {
+        mHasMorePages = (nodeCount >= (size_t)CATALOG_PAGE_SIZE);
+        mNextPage = page + 1;
+        FileLogger::GetInstance().LogInfo("FetchThemes page %d: %zu themes%s", page, nodeCount,
+                                          mHasMorePages ? "" : " (last page)");
         
-        // 转换状态到 FetchState
-        if (state == DOWNLOAD_COMPLETE) {
-            // 下载完成后，保存主题元数据和图片
-            std::string extractedPath = mDownloader->GetExtractedPath();
-            SaveThemeMetadata(theme, extractedPath);
-            
-            if (mStateCallback) mStateCallback(FETCH_SUCCESS, message);
-            
-            // 标记下载器需要清理(不能在回调中直接删除,因为回调可能还在下载器对象的方法中执行)
-            FileLogger::GetInstance().LogInfo("[ThemeManager] Marking downloader for cleanup after success");
-            mDownloaderNeedsCleanup = true;
-        } else if (state == DOWNLOAD_ERROR || state == DOWNLOAD_CANCELLED) {
-            if (mStateCallback) mStateCallback(FETCH_ERROR, message);
+        if (page == 1 && !stream.intoList && !stream.received.empty()) {
+            // 刷新: 整页到达后替换列表, 没有变化的主题沿用已获取的详情
+            for (Theme& theme : stream.received) {
+                const Theme* old = FindTheme(theme.id);
+                if (old && old->detailsLoaded && old->updatedAt == theme.updatedAt) {
+                    CopyDetails(*old, theme);
+                }
+            }
+            mThemes.swap(stream.received);
+            mListVersion++;
+            mCatalogVersion++;
+        }
+        
+        ok = (page > 1 || !mThemes.empty());
+        if (page == 1 && ok) {
+            if (mState != FETCH_SUCCESS) {
+                mState = FETCH_SUCCESS;
+                if (mStateCallback) {
+                    mStateCallback(FETCH_SUCCESS, "Themes loaded successfully");
+                }
+            }
+            DEBUG_FUNCTION_LINE("Successfully loaded %zu themes", mThemes.size());
             
-            // 标记下载器需要清理
-            FileLogger::GetInstance().LogInfo("[ThemeManager] Marking downloader for cleanup after error/cancel");
-            mDownloaderNeedsCleanup = true;
+            // 保存到缓存 (后台写入)
+            SaveCache(&stream.validators);
         }
-    });
+    }
     
-    // 启动异步下载
-    mDownloader->DownloadThemeAsync(theme.downloadUrl, theme.name);
+    if (!ok) {
+        if (page == 1 && stream.intoList && !mThemes.empty()) {
+            // 已经显示了一部分: 保留, 之后重新加载这一页 (合并时去重)
+            mNextPage = page;
+            mHasMorePages = true;
+            FileLogger::GetInstance().LogWarning("FetchThemes page 1 incomplete (HTTP %ld), kept %zu themes",
+                                                 stream.responseCode, mThemes.size());
+        } else if (page == 1) {
+            mState = FETCH_ERROR;
+            mErrorMessage = stream.transferOk ? "Failed to parse theme data" : "Network request failed";
+            if (mStateCallback) {
+                mStateCallback(FETCH_ERROR, mErrorMessage);
+            }
+            FileLogger::GetInstance().LogError("Async FetchThemes FAILED: HTTP %ld", stream.responseCode);
+        } else {
+            // 后续页失败时保留 mHasMorePages, 之后按需重试 (已经收到的部分合并时去重)
+            FileLogger::GetInstance().LogWarning("Async FetchThemes page %d FAILED: HTTP %ld", page, stream.responseCode);
+        }
+    }
     
-    FileLogger::GetInstance().LogInfo("Async download started");
-}
-
-float ThemeManager::GetDownloadProgress() const {
-    if (mDownloader) {
-        return mDownloader->GetProgress();
+    // 前 GetBackgroundThemeLimit 个主题在后台连续加载, 之后的等列表接近末尾时再加载
+    if (ok && mHasMorePages && mThemes.size() + mPendingThemes.size() < PerfProfile::GetBackgroundThemeLimit()) {
+        FetchPage(mNextPage);
     }
-    return 0.0f;
 }
 
-int ThemeManager::GetDownloadState() const {
-    // 先检查是否需要清理下载器(在主线程中安全清理)
-    if (mDownloaderNeedsCleanup && mDownloader) {
-        FileLogger::GetInstance().LogInfo("[ThemeManager] Performing deferred downloader cleanup");
-        ThemeDownloader* downloaderToDelete = mDownloader;
-        const_cast<ThemeManager*>(this)->mDownloader = nullptr;
-        const_cast<ThemeManager*>(this)->mDownloaderNeedsCleanup = false;
-        delete downloaderToDelete;
-        FileLogger::GetInstance().LogInfo("[ThemeManager] Deferred cleanup completed");
-        return (int)DOWNLOAD_IDLE;
+const Theme* ThemeManager::FindTheme(const std::string& id) const {
+    // 驻留池中没有这个 id 就不可能有对应的主题; 有的话逐个比较指针
+    PooledString key;
+    if (!PooledString::Lookup(id, key)) {
+        return nullptr;
     }
-    
-    if (mDownloader) {
-        return (int)mDownloader->GetState();
+    for (const Theme& theme : mThemes) {
+        if (theme.id == key) {
+            return &theme;
+        }
     }
-    return (int)DOWNLOAD_IDLE;
+    return nullptr;
 }
 
-std::string ThemeManager::GetDownloadError() const {
-    if (mDownloader) {
-        return mDownloader->GetError();
-    }
-    return "";
+Theme* ThemeManager::FindTheme(const std::string& id) {
+    return const_cast<Theme*>(static_cast<const ThemeManager*>(this)->FindTheme(id));
+}
+
+const ThemeDetails& Theme::GetDetails() const {
+    static const ThemeDetails EMPTY_DETAILS;
+    const ThemeDetails* cold = details.Get();
+    return cold ? *cold : EMPTY_DETAILS;
+}
+
+void ThemeManager::BuildDisplayStrings(Theme& theme) {
+    ThemeDisplay& display = theme.display;
+    const std::string& description = theme.GetDetails().description;
+    display.name = Utils::SanitizeThemeNameForDisplay(theme.name);
+    display.author = "by " + theme.author;
+    display.description = Utils::TruncateForDisplay(
+        description.empty() ? std::string_view("No description available") : std::string_view(description),
+        CARD_DESCRIPTION_COLUMNS);
+    display.downloads = std::to_string(theme.downloads);
+    display.likes = std::to_string(theme.likes);
+}
+
+void ThemeManager::CopyDetails(const Theme& from, Theme& to) {
+    const ThemeDetails& source = from.GetDetails();
+    ThemeDetails& target = to.EditDetails();
+    target.description = source.description;
+    target.downloadUrl = source.downloadUrl;
+    to.tags = from.tags;
+    to.collagePreview.hdUrl = from.collagePreview.hdUrl;
+    target.launcherScreenshot.thumbUrl = source.launcherScreenshot.thumbUrl;
+    target.launcherScreenshot.hdUrl = source.launcherScreenshot.hdUrl;
+    target.waraWaraScreenshot.thumbUrl = source.waraWaraScreenshot.thumbUrl;
+    target.waraWaraScreenshot.hdUrl = source.waraWaraScreenshot.hdUrl;
+    target.launcherBgUrl = source.launcherBgUrl;
+    target.waraWaraBgUrl = source.waraWaraBgUrl;
+    to.detailsLoaded = true;
+    BuildDisplayStrings(to);
 }
 
-std::string ThemeManager::GetDownloadedFilePath() const {
-    if (mDownloader) {
-        return mDownloader->GetDownloadedFilePath();
+void ThemeManager::FetchThemeDetails(const std::string& id) {
+    if (id.empty() || !DownloadQueue::GetInstance()) {
+        return;
+    }
+    auto it = mDetailOps.find(id);
+    if (it != mDetailOps.end()) {
+        // 已经在预取的批量请求中, 详情页正在等待, 提高它的优先级
+        DownloadQueue::GetInstance()->DownloadSetPriority(it->second, DownloadPriority::HIGH);
+        return;
+    }
+    const Theme* theme = FindTheme(id);
+    if (!theme || theme->detailsLoaded) {
+        return;
     }
-    return "";
+    
+    FileLogger::GetInstance().LogInfo("Fetching details for theme %s", id.c_str());
+    SendDetailBatch({id}, DownloadPriority::HIGH); // 详情页正在等待
 }
 
-std::string ThemeManager::GetExtractedPath() const {
-    if (mDownloader) {
-        return mDownloader->GetExtractedPath();
+void ThemeManager::PrefetchThemeDetails(const std::vector<std::string>& ids) {
+    if (!DownloadQueue::GetInstance()) {
+        return;
+    }
+    std::vector<std::string> batch;
+    for (const std::string& id : ids) {
+        if (id.empty() || mDetailOps.count(id) ||
+            std::find(batch.begin(), batch.end(), id) != batch.end()) {
+            continue;
+        }
+        const Theme* theme = FindTheme(id);
+        if (!theme || theme->detailsLoaded) {
+            continue;
+        }
+        batch.push_back(id);
+        if (batch.size() >= PerfProfile::GetDetailBatchSize()) {
+            SendDetailBatch(batch, DownloadPriority::LOW);
+            batch.clear();
+        }
+    }
+    if (!batch.empty()) {
+        SendDetailBatch(batch, DownloadPriority::LOW);
     }
-    return "";
 }
 
-void ThemeManager::CancelDownload() {
-    if (mDownloader) {
-        mDownloader->Cancel();
+void ThemeManager::SendDetailBatch(const std::vector<std::string>& ids, DownloadPriority priority) {
+    // 每个主题一个别名 dN, 和同步的批量请求相同; 结果按别名的序号对应回 uuid
+    std::string fields = "{ ";
+    for (size_t i = 0; i < ids.size(); i++) {
+        fields += "d" + std::to_string(i) + ": wiiuTheme(uuid: \\\"" + ids[i] + "\\\") { " THEME_DETAIL_FIELDS " } ";
+    }
+    fields += "}";
+    
+    DownloadOperation* op = new DownloadOperation();
+    op->url = THEMEZER_GRAPHQL_URL;
+    op->postData = "{ \"query\": \"" + fields + "\" }";
+    op->compressed = true;
+    op->priority = priority;
+    op->cb = [this, ids](DownloadOperation* op) {
+        for (const std::string& id : ids) {
+            mDetailOps.erase(id);
+        }
+        
+        size_t loaded = 0;
+        if (op->status == DownloadStatus::COMPLETE && !op->buffer.empty()) {
+            // 列表可能在请求期间刷新过, 按 uuid 重新查找; 已删除的主题为 null
+            JsonReader reader(op->buffer);
+            if (reader.EnterObject() && reader.FindMember("data") && reader.EnterObject()) {
+                std::string_view alias;
+                while (reader.NextMember(alias)) {
+                    size_t index = ids.size();
+                    if (alias.size() > 1 && alias[0] == 'd') {
+                        index = (size_t)strtoul(std::string(alias.substr(1)).c_str(), nullptr, 10);
+                    }
+                    Theme* theme = (index < ids.size()) ? FindTheme(ids[index]) : nullptr;
+                    if (!theme || reader.Peek() != JSON_OBJECT) {
+                        reader.Skip();
+                        continue;
+                    }
+                    theme->detailsLoaded = ReadThemeNode(reader, *theme);
+                    if (theme->detailsLoaded) {
+                        loaded++;
+                    }
+                    mCacheDirty = true;
+                }
+            }
+        }
+        
+        if (loaded == ids.size()) {
+            FileLogger::GetInstance().LogInfo("Theme details loaded: %zu theme(s)", loaded);
+        } else {
+            FileLogger::GetInstance().LogError("Failed to load theme details: %zu of %zu loaded (HTTP %ld)",
+                                               loaded, ids.size(), op->response_code);
+        }
+        delete op;
+    };
+    
+    for (const std::string& id : ids) {
+        mDetailOps[id] = op;
     }
+    DownloadQueue::GetInstance()->DownloadAdd(op);
 }
 
 void ThemeManager::Update() {
-    // 无需处理缓存加载
+    if (mSyncReady) {
+        mSyncReady = false;
+        ApplySync();
+    }
+    
+    DrainFetchStream();
+    
+    // 合并后台加载到的后续页, 跳过已有的主题 (翻页期间目录可能有变化)
+    if (!mPendingThemes.empty()) {
+        std::set<std::string> ids;
+        for (const Theme& theme : mThemes) {
+            ids.insert(theme.id);
+        }
+        size_t before = mThemes.size();
+        for (Theme& theme : mPendingThemes) {
+            if (ids.insert(theme.id).second) {
+                mThemes.push_back(std::move(theme));
+            }
+        }
+        mPendingThemes.clear();
+        mCacheDirty = true;
+        FileLogger::GetInstance().LogInfo("Merged %zu more themes (%zu total)", mThemes.size() - before, mThemes.size());
+    }
+    
+    // 新记下的占位颜色在缩略图停止到达一段时间后写入
+    if (mPlaceholderChangedMs != 0 &&
+        OSTicksToMilliseconds(OSGetSystemTime()) - mPlaceholderChangedMs >= PLACEHOLDER_SAVE_DELAY_MS) {
+        mCacheDirty = true;
+    }
+    
+    // 连续加载的页全部到达后一次写入缓存
+    if (mCacheDirty && !mFetchOp && !mFetchStream && !mSyncing) {
+        SaveCache();
+        mCacheDirty = false;
+        mPlaceholderChangedMs = 0;
+    }
+}
+
+void ThemeManager::SetPlaceholderColor(Theme& theme, uint32_t color) {
+    if (color == 0 || theme.collagePreview.placeholderColor == color) {
+        return;
+    }
+    theme.collagePreview.placeholderColor = color;
+    mPlaceholderChangedMs = OSTicksToMilliseconds(OSGetSystemTime());
 }
 
 void ThemeManager::SetProgressCallback(std::function<void(float progress, long downloaded, long total)> callback) {
@@ -510,125 +674,236 @@ std::string ThemeManager::GetCachePath() const {
     return CACHE_FILE;
 }
 
-// 序列化主题列表为 JSON 字符串
+// 主题缓存文件: 文件头 + 定长记录 + 字符串表, 一次读入后直接按偏移取字段
+// 使用本机字节序, 只在同一台机器上读写
+struct ThemeCacheHeader {
+    char magic[4];         // "UTTC"
+    uint32_t version;
+    uint32_t count;        // 记录数
+    uint32_t recordSize;   // sizeof(ThemeCacheRecord), 结构变化时旧文件作废
+    uint32_t stringsSize;  // 字符串表字节数
+};
+
+struct ThemeCacheString {
+    uint32_t offset;       // 在字符串表中的位置
+    uint32_t length;
+};
+
+enum ThemeCacheField {
+    TCF_ID,
+    TCF_NAME,
+    TCF_AUTHOR,
+    TCF_DESCRIPTION,
+    TCF_DOWNLOAD_URL,
+    TCF_VERSION,
+    TCF_UPDATED_AT,
+    TCF_TAGS,              // 以 '\n' 分隔
+    TCF_COLLAGE_THUMB,
+    TCF_COLLAGE_HD,
+    TCF_LAUNCHER_THUMB,
+    TCF_LAUNCHER_HD,
+    TCF_WARAWARA_THUMB,
+    TCF_WARAWARA_HD,
+    TCF_LAUNCHER_BG,
+    TCF_WARAWARA_BG,
+    TCF_COUNT
+};
+
+struct ThemeCacheRecord {
+    ThemeCacheString strings[TCF_COUNT];
+    int32_t downloads;
+    int32_t likes;
+    uint32_t flags;
+    uint32_t placeholderColor;
+};
+
+static const uint32_t THEME_CACHE_VERSION = 3;  // 2: 列表字段包含标签 3: 缩略图的占位颜色
+static const uint32_t THEME_CACHE_DETAILS_LOADED = 1 << 0;
+
+// 序列化主题列表, 返回完整的文件内容
 std::string ThemeManager::SerializeThemes() const {
-    FileLogger::GetInstance().LogInfo("SerializeThemes: Serializing %zu themes", mThemes.size());
+    std::vector<ThemeCacheRecord> records(mThemes.size());
+    std::string strings;
     
-    // 使用格式化的JSON输出,提高可读性
-    std::string json = "{\n  \"themes\": [\n";
+    auto addString = [&strings](ThemeCacheString& ref, const std::string& value) {
+        ref.offset = strings.size();
+        ref.length = value.size();
+        strings += value;
+    };
     
+    std::string tags;
     for (size_t i = 0; i < mThemes.size(); i++) {
         const Theme& theme = mThemes[i];
+        const ThemeDetails& details = theme.GetDetails();
+        ThemeCacheRecord& record = records[i];
         
-        if (i > 0) json += ",\n";
-        json += "    {\n";
-        json += "      \"id\": \"" + theme.id + "\",\n";
-        json += "      \"name\": \"" + theme.name + "\",\n";
-        json += "      \"author\": \"" + theme.author + "\",\n";
-        json += "      \"description\": \"" + theme.description + "\",\n";
-        json += "      \"downloads\": " + std::to_string(theme.downloads) + ",\n";
-        json += "      \"likes\": " + std::to_string(theme.likes) + ",\n";
-        json += "      \"version\": \"" + theme.version + "\",\n";
-        json += "      \"updatedAt\": \"" + theme.updatedAt + "\",\n";
-        json += "      \"downloadUrl\": \"" + theme.downloadUrl + "\",\n";
-        
-        // 图片 URLs
-        json += "      \"collageThumbUrl\": \"" + theme.collagePreview.thumbUrl + "\",\n";
-        json += "      \"collageHdUrl\": \"" + theme.collagePreview.hdUrl + "\",\n";
-        json += "      \"launcherThumbUrl\": \"" + theme.launcherScreenshot.thumbUrl + "\",\n";
-        json += "      \"launcherHdUrl\": \"" + theme.launcherScreenshot.hdUrl + "\",\n";
-        json += "      \"waraWaraThumbUrl\": \"" + theme.waraWaraScreenshot.thumbUrl + "\",\n";
-        json += "      \"waraWaraHdUrl\": \"" + theme.waraWaraScreenshot.hdUrl + "\",\n";
-        json += "      \"launcherBgUrl\": \"" + theme.launcherBgUrl + "\",\n";
-        json += "      \"waraWaraBgUrl\": \"" + theme.waraWaraBgUrl + "\"\n";
-        
-        json += "    }";
-        
-        // 每隔10个主题记录一次进度和大小
-        if ((i + 1) % 10 == 0 || i == mThemes.size() - 1) {
-            FileLogger::GetInstance().LogInfo("SerializeThemes: Processed %zu/%zu themes, JSON size: %zu bytes", 
-                i + 1, mThemes.size(), json.size());
+        tags.clear();
+        for (size_t t = 0; t < theme.tags.size(); t++) {
+            if (t > 0) tags += '\n';
+            tags += theme.tags[t];
         }
+        
+        addString(record.strings[TCF_ID], theme.id);
+        addString(record.strings[TCF_NAME], theme.name);
+        addString(record.strings[TCF_AUTHOR], theme.author);
+        addString(record.strings[TCF_DESCRIPTION], details.description);
+        addString(record.strings[TCF_DOWNLOAD_URL], details.downloadUrl);
+        addString(record.strings[TCF_VERSION], details.version);
+        addString(record.strings[TCF_UPDATED_AT], theme.updatedAt);
+        addString(record.strings[TCF_TAGS], tags);
+        addString(record.strings[TCF_COLLAGE_THUMB], theme.collagePreview.thumbUrl);
+        addString(record.strings[TCF_COLLAGE_HD], theme.collagePreview.hdUrl);
+        addString(record.strings[TCF_LAUNCHER_THUMB], details.launcherScreenshot.thumbUrl);
+        addString(record.strings[TCF_LAUNCHER_HD], details.launcherScreenshot.hdUrl);
+        addString(record.strings[TCF_WARAWARA_THUMB], details.waraWaraScreenshot.thumbUrl);
+        addString(record.strings[TCF_WARAWARA_HD], details.waraWaraScreenshot.hdUrl);
+        addString(record.strings[TCF_LAUNCHER_BG], details.launcherBgUrl);
+        addString(record.strings[TCF_WARAWARA_BG], details.waraWaraBgUrl);
+        record.downloads = theme.downloads;
+        record.likes = theme.likes;
+        record.flags = theme.detailsLoaded ? THEME_CACHE_DETAILS_LOADED : 0;
+        record.placeholderColor = theme.collagePreview.placeholderColor;
     }
     
-    json += "\n  ]\n}\n";
-    
-    FileLogger::GetInstance().LogInfo("SerializeThemes: Complete, final JSON size: %zu bytes", json.size());
-    return json;
+    ThemeCacheHeader header;
+    memcpy(header.magic, "UTTC", 4);
+    header.version = THEME_CACHE_VERSION;
+    header.count = records.size();
+    header.recordSize = sizeof(ThemeCacheRecord);
+    header.stringsSize = strings.size();
+    
+    std::string data;
+    data.reserve(sizeof(header) + records.size() * sizeof(ThemeCacheRecord) + strings.size());
+    data.append((const char*)&header, sizeof(header));
+    data.append((const char*)records.data(), records.size() * sizeof(ThemeCacheRecord));
+    data += strings;
+    return data;
 }
 
-// 从 JSON 字符串反序列化主题列表
-bool ThemeManager::DeserializeThemes(const std::string& data) {
-    try {
-        FileLogger::GetInstance().LogInfo("DeserializeThemes: Parsing %zu bytes of JSON", data.size());
-        
-        JsonValue root = SimpleJsonParser::Parse(data);
-        
-        if (!root.isObject() || !root.has("themes") || !root["themes"].isArray()) {
-            FileLogger::GetInstance().LogError("DeserializeThemes: Invalid root structure");
-            return false;
-        }
-        
-        const JsonValue& themesArray = root["themes"];
-        FileLogger::GetInstance().LogInfo("DeserializeThemes: Found themes array with %zu items", themesArray.size());
-        
-        mThemes.clear();
-        
-        for (size_t i = 0; i < themesArray.size(); i++) {
-            const JsonValue& themeJson = themesArray[i];
-            
-            if (!themeJson.isObject()) {
-                FileLogger::GetInstance().LogWarning("DeserializeThemes: Theme %zu is not an object", i);
-                continue;
-            }
-            
-            Theme theme;
-            
-            if (themeJson.has("id")) theme.id = themeJson["id"].asString();
-            if (themeJson.has("name")) theme.name = themeJson["name"].asString();
-            if (themeJson.has("author")) theme.author = themeJson["author"].asString();
-            if (themeJson.has("description")) theme.description = themeJson["description"].asString();
-            if (themeJson.has("downloads")) theme.downloads = themeJson["downloads"].asInt();
-            if (themeJson.has("likes")) theme.likes = themeJson["likes"].asInt();
-            if (themeJson.has("version")) theme.version = themeJson["version"].asString();
-            if (themeJson.has("updatedAt")) theme.updatedAt = themeJson["updatedAt"].asString();
-            if (themeJson.has("downloadUrl")) theme.downloadUrl = themeJson["downloadUrl"].asString();
-            
-            // 图片 URLs
-            if (themeJson.has("collageThumbUrl")) theme.collagePreview.thumbUrl = themeJson["collageThumbUrl"].asString();
-            if (themeJson.has("collageHdUrl")) theme.collagePreview.hdUrl = themeJson["collageHdUrl"].asString();
-            if (themeJson.has("launcherThumbUrl")) theme.launcherScreenshot.thumbUrl = themeJson["launcherThumbUrl"].asString();
-            if (themeJson.has("launcherHdUrl")) theme.launcherScreenshot.hdUrl = themeJson["launcherHdUrl"].asString();
-            if (themeJson.has("waraWaraThumbUrl")) theme.waraWaraScreenshot.thumbUrl = themeJson["waraWaraThumbUrl"].asString();
-            if (themeJson.has("waraWaraHdUrl")) theme.waraWaraScreenshot.hdUrl = themeJson["waraWaraHdUrl"].asString();
-            if (themeJson.has("launcherBgUrl")) theme.launcherBgUrl = themeJson["launcherBgUrl"].asString();
-            if (themeJson.has("waraWaraBgUrl")) theme.waraWaraBgUrl = themeJson["waraWaraBgUrl"].asString();
-            
-            if (!theme.id.empty() && !theme.name.empty()) {
-                mThemes.push_back(theme);
-                
-                // 每隔5个主题记录一次进度
-                if ((i + 1) % 5 == 0 || i == themesArray.size() - 1) {
-                    FileLogger::GetInstance().LogInfo("DeserializeThemes: Loaded %zu/%zu themes", i + 1, themesArray.size());
-                }
-            } else {
-                FileLogger::GetInstance().LogWarning("DeserializeThemes: Theme %zu has empty id or name", i);
+// 从缓存文件内容恢复主题列表, 格式或版本不符时返回 false
+// 不访问成员, 菜单预热时在任务线程中调用
+bool ThemeManager::DeserializeThemes(const std::string& data, std::vector<Theme>& out) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_CATALOG);
+    ThemeCacheHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, "UTTC", 4) != 0 || header.version != THEME_CACHE_VERSION ||
+        header.recordSize != sizeof(ThemeCacheRecord)) {
+        FileLogger::GetInstance().LogWarning("DeserializeThemes: Unknown cache format or version");
+        return false;
+    }
+    
+    size_t recordsBytes = (size_t)header.count * sizeof(ThemeCacheRecord);
+    if (header.count > data.size() / sizeof(ThemeCacheRecord) ||
+        sizeof(header) + recordsBytes + header.stringsSize != data.size()) {
+        FileLogger::GetInstance().LogError("DeserializeThemes: Truncated cache file");
+        return false;
+    }
+    
+    const char* recordsBase = data.data() + sizeof(header);
+    const char* strings = recordsBase + recordsBytes;
+    
+    std::vector<Theme> themes(header.count);
+    for (uint32_t i = 0; i < header.count; i++) {
+        ThemeCacheRecord record;
+        memcpy(&record, recordsBase + (size_t)i * sizeof(ThemeCacheRecord), sizeof(record));
+        
+        // 所有字段都必须落在字符串表内
+        for (const ThemeCacheString& ref : record.strings) {
+            if (ref.offset > header.stringsSize || ref.length > header.stringsSize - ref.offset) {
+                FileLogger::GetInstance().LogError("DeserializeThemes: Corrupt record %u", i);
+                return false;
             }
         }
         
-        FileLogger::GetInstance().LogInfo("DeserializeThemes: Successfully loaded %zu themes", mThemes.size());
-        return !mThemes.empty();
+        auto view = [&record, strings](ThemeCacheField field) {
+            return std::string_view(strings + record.strings[field].offset, record.strings[field].length);
+        };
+        auto get = [&view](ThemeCacheField field, std::string& out) {
+            out.assign(view(field));
+        };
+        // 冷数据字段都为空时 (只有列表字段的主题) 不分配 ThemeDetails
+        bool hasDetails = false;
+        for (ThemeCacheField field : {TCF_DESCRIPTION, TCF_DOWNLOAD_URL, TCF_LAUNCHER_THUMB, TCF_LAUNCHER_HD,
+                                      TCF_WARAWARA_THUMB, TCF_WARAWARA_HD, TCF_LAUNCHER_BG, TCF_WARAWARA_BG}) {
+            hasDetails = hasDetails || !view(field).empty();
+        }
         
-    } catch (...) {
-        FileLogger::GetInstance().LogError("DeserializeThemes: Exception during parsing");
-        return false;
+        Theme& theme = themes[i];
+        theme.id = PooledString(view(TCF_ID));
+        get(TCF_NAME, theme.name);
+        theme.author = PooledString(view(TCF_AUTHOR));
+        get(TCF_UPDATED_AT, theme.updatedAt);
+        get(TCF_COLLAGE_THUMB, theme.collagePreview.thumbUrl);
+        get(TCF_COLLAGE_HD, theme.collagePreview.hdUrl);
+        if (hasDetails) {
+            ThemeDetails& details = theme.EditDetails();
+            get(TCF_DESCRIPTION, details.description);
+            get(TCF_DOWNLOAD_URL, details.downloadUrl);
+            get(TCF_VERSION, details.version);
+            get(TCF_LAUNCHER_THUMB, details.launcherScreenshot.thumbUrl);
+            get(TCF_LAUNCHER_HD, details.launcherScreenshot.hdUrl);
+            get(TCF_WARAWARA_THUMB, details.waraWaraScreenshot.thumbUrl);
+            get(TCF_WARAWARA_HD, details.waraWaraScreenshot.hdUrl);
+            get(TCF_LAUNCHER_BG, details.launcherBgUrl);
+            get(TCF_WARAWARA_BG, details.waraWaraBgUrl);
+        }
+        theme.downloads = record.downloads;
+        theme.likes = record.likes;
+        theme.detailsLoaded = (record.flags & THEME_CACHE_DETAILS_LOADED) != 0;
+        theme.collagePreview.placeholderColor = record.placeholderColor;
+        BuildDisplayStrings(theme);
+        
+        const ThemeCacheString& tags = record.strings[TCF_TAGS];
+        const char* p = strings + tags.offset;
+        const char* tagsEnd = p + tags.length;
+        while (p < tagsEnd) {
+            const char* sep = (const char*)memchr(p, '\n', tagsEnd - p);
+            const char* tagEnd = sep ? sep : tagsEnd;
+            theme.tags.emplace_back(std::string_view(p, tagEnd - p));
+            p = tagEnd + 1;
+        }
     }
+    
+    // 丢弃没有 id 或名称的记录
+    themes.erase(std::remove_if(themes.begin(), themes.end(), [](const Theme& theme) {
+        return theme.id.empty() || theme.name.empty();
+    }), themes.end());
+    
+    out.swap(themes);
+    return !out.empty();
 }
 
-// 保存主题到缓存文件
-bool ThemeManager::SaveCache() {
-    FileLogger::GetInstance().LogInfo("Saving theme cache to: %s", CACHE_FILE);
-    
+// 缓存写入线程: 主线程只序列化 (一次平铺的内存拷贝), 写 SD 卡和 fsync 在后台完成
+// 还没开始写的快照会被更新的快照替换, 只写最新的一份
+struct CacheWriteJob {
+    std::string data;
+    bool saveValidators = false;
+    std::string etag;
+    std::string lastModified;
+};
+
+// 热启动快照: 缩略图的像素在写入线程中从像素缓存读出, 主线程只取得文件路径
+struct WarmStartJob {
+    ThemeManager::WarmView view;
+    std::vector<std::string> urls;
+    std::vector<std::string> pixelPaths;
+    std::vector<std::string> sourcePaths;   // 原始图片比像素缓存新时像素缓存作废
+    Uint32 format = SDL_PIXELFORMAT_UNKNOWN;
+};
+
+static std::mutex sCacheWriteMutex;
+static std::condition_variable sCacheWriteCv;     // 有新任务或要求退出
+static std::condition_variable sCacheIdleCv;      // 写完了一份
+static std::thread sCacheWriteThread;
+static std::unique_ptr<CacheWriteJob> sCacheWriteJob;
+static std::unique_ptr<WarmStartJob> sWarmStartJob;   // 在目录缓存之后写
+static bool sCacheWriterBusy = false;
+static bool sCacheWriterStop = false;
+
+static bool WriteCacheFile(const CacheWriteJob& job) {
     // 创建目录
     struct stat st;
     if (stat(CACHE_DIR, &st) != 0) {
@@ -647,220 +922,914 @@ bool ThemeManager::SaveCache() {
         }
     }
     
-    // 序列化主题数据
-    std::string json = SerializeThemes();
-    
-    FileLogger::GetInstance().LogInfo("SaveCache: JSON length before write: %zu bytes", json.length());
-    
-    // 删除旧文件（Wii U 文件系统可能需要这样做）
-    unlink(CACHE_FILE);
-    
-    // 写入文件
-    FILE* file = fopen(CACHE_FILE, "wb");  // 使用二进制模式
+    // 先写临时文件再改名, 写到一半断电时保留旧的缓存
+    const char* tempPath = CACHE_FILE ".tmp";
+    FILE* file = fopen(tempPath, "wb");
     if (!file) {
         FileLogger::GetInstance().LogError("Failed to open cache file for writing: errno=%d", errno);
         return false;
     }
     
-    size_t written = fwrite(json.c_str(), 1, json.length(), file);
+    bool ok = fwrite(job.data.data(), 1, job.data.size(), file) == job.data.size();
     
-    // 获取文件描述符进行同步
-    int fd = fileno(file);
+    // 强制同步到磁盘 (Wii U 必需)
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
     
-    // 刷新缓冲区到内核
-    if (fflush(file) != 0) {
-        FileLogger::GetInstance().LogError("Failed to flush cache file: errno=%d", errno);
-        fclose(file);
+    // FAT 上不能改名覆盖已有的文件, 新的缓存完整写入后才删除旧的
+    if (ok) {
+        remove(CACHE_FILE);
+    }
+    if (!ok || rename(tempPath, CACHE_FILE) != 0) {
+        FileLogger::GetInstance().LogError("Failed to write cache file: errno=%d", errno);
+        unlink(tempPath);
         return false;
     }
     
-    // 强制同步到磁盘 (Wii U 必需)
-    if (fsync(fd) != 0) {
-        FileLogger::GetInstance().LogError("Failed to fsync cache file: errno=%d", errno);
-        fclose(file);
+    // 校验信息在缓存文件之后写, 不会出现校验信息比缓存新的情况
+    if (job.saveValidators) {
+        DownloadOperation validators;
+        validators.etag = job.etag;
+        validators.lastModified = job.lastModified;
+        DownloadQueue::SaveValidators(CACHE_META_FILE, &validators);
+    }
+    
+    FileLogger::GetInstance().LogInfo("Saved theme cache (%zu bytes)", job.data.size());
+    return true;
+}
+
+// 快照文件头, 后面是 stringBytes 字节的字符串 (标签、选中的 uuid, 各以 0 结尾) 和 thumbCount 张缩略图
+struct WarmStartHeader {
+    char magic[4];          // "UTWS"
+    uint32_t version;
+    uint64_t catalogSize;   // 写入时目录缓存的大小和修改时间, 不同时快照作废
+    int64_t catalogMtime;
+    uint32_t format;        // 像素格式 (渲染器格式)
+    int32_t sortOrder;
+    int32_t selectedIndex;
+    int32_t scrollRow;
+    uint32_t thumbCount;
+    uint32_t stringBytes;
+};
+
+// 每张缩略图: 这个头, urlBytes 字节的 url (不以 0 结尾), pitch * height 字节的像素
+struct WarmStartThumb {
+    uint32_t urlBytes;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+};
+
+static const uint32_t WARM_START_VERSION = 1;
+static const uint32_t WARM_START_MAX_THUMBS = 16;
+
+// 快照中读出的缩略图, 交给主线程放进图集
+struct WarmThumbnails {
+    std::vector<std::pair<std::string, SDL_Surface*>> items;
+    ~WarmThumbnails() { Clear(); }
+    void Clear() {
+        for (auto& item : items) {
+            SDL_FreeSurface(item.second);
+        }
+        items.clear();
+    }
+};
+
+static bool WriteWarmStartFile(const WarmStartJob& job) {
+    // 快照对应刚写完的目录缓存
+    struct stat catalogSt;
+    if (stat(CACHE_FILE, &catalogSt) != 0) {
+        unlink(WARM_START_FILE);
         return false;
     }
     
-    fclose(file);
+    std::string strings;
+    strings.append(job.view.tagFilter).push_back('\0');
+    strings.append(job.view.selectedThemeId).push_back('\0');
+    
+    WarmStartHeader header;
+    memcpy(header.magic, "UTWS", 4);
+    header.version = WARM_START_VERSION;
+    header.catalogSize = (uint64_t)catalogSt.st_size;
+    header.catalogMtime = (int64_t)catalogSt.st_mtime;
+    header.format = job.format;
+    header.sortOrder = job.view.sortOrder;
+    header.selectedIndex = job.view.selectedIndex;
+    header.scrollRow = job.view.scrollRow;
+    header.thumbCount = 0;
+    header.stringBytes = (uint32_t)strings.size();
+    
+    // 整个快照先在内存中拼好, 下次一次读出
+    std::string data(sizeof(header), '\0');
+    data += strings;
+    for (size_t i = 0; i < job.urls.size(); i++) {
+        SDL_Surface* surface = ImageLoader::LoadProcessedCache(job.pixelPaths[i], job.sourcePaths[i], job.format);
+        if (!surface) {
+            continue;
+        }
+        WarmStartThumb thumb;
+        thumb.urlBytes = (uint32_t)job.urls[i].size();
+        thumb.width = surface->w;
+        thumb.height = surface->h;
+        thumb.pitch = surface->pitch;
+        data.append((const char*)&thumb, sizeof(thumb));
+        data += job.urls[i];
+        data.append((const char*)surface->pixels, (size_t)surface->pitch * surface->h);
+        SDL_FreeSurface(surface);
+        header.thumbCount++;
+    }
+    memcpy(&data[0], &header, sizeof(header));
     
-    FileLogger::GetInstance().LogInfo("SaveCache: Attempted to write %zu bytes, actually wrote %zu bytes", 
-        json.length(), written);
+    const char* tempPath = WARM_START_FILE ".tmp";
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    // FAT 上不能改名覆盖已有的文件
+    if (ok) {
+        remove(WARM_START_FILE);
+    }
+    if (!ok || rename(tempPath, WARM_START_FILE) != 0) {
+        FileLogger::GetInstance().LogError("Failed to write warm start snapshot: errno=%d", errno);
+        unlink(tempPath);
+        return false;
+    }
+    FileLogger::GetInstance().LogInfo("Saved warm start snapshot (%u thumbnails, %zu bytes)", header.thumbCount,
+                                      data.size());
+    return true;
+}
+
+// 读出和目录缓存 (catalogSt 为读取目录时的状态) 对应的快照; 没有、不对应或损坏时返回 false
+// 可以在任意线程调用, format 在主线程取得
+static bool ReadWarmStartFile(const struct stat& catalogSt, Uint32 format, ThemeManager::WarmView& view,
+                              WarmThumbnails& thumbs) {
+    FILE* file = fopen(WARM_START_FILE, "rb");
+    if (!file) {
+        return false;
+    }
+    struct stat st;
+    std::string data;
+    bool ok = fstat(fileno(file), &st) == 0 && st.st_size >= (off_t)sizeof(WarmStartHeader);
+    if (ok) {
+        data.resize(st.st_size);
+        ok = fread(&data[0], 1, data.size(), file) == data.size();
+    }
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
     
-    if (written != json.length()) {
-        FileLogger::GetInstance().LogError("Failed to write cache file (partial write: %zu/%zu)", written, json.length());
+    WarmStartHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, "UTWS", 4) != 0 || header.version != WARM_START_VERSION ||
+        header.catalogSize != (uint64_t)catalogSt.st_size || header.catalogMtime != (int64_t)catalogSt.st_mtime ||
+        header.thumbCount > WARM_START_MAX_THUMBS || header.stringBytes > data.size() - sizeof(header)) {
         return false;
     }
     
-    // 验证文件大小
-    struct stat verifySt;
-    if (stat(CACHE_FILE, &verifySt) == 0) {
-        FileLogger::GetInstance().LogInfo("SaveCache: File size on disk: %ld bytes", verifySt.st_size);
+    const char* p = data.data() + sizeof(header);
+    const char* stringsEnd = p + header.stringBytes;
+    const char* tagEnd = (const char*)memchr(p, '\0', stringsEnd - p);
+    const char* idEnd = tagEnd ? (const char*)memchr(tagEnd + 1, '\0', stringsEnd - tagEnd - 1) : nullptr;
+    if (!idEnd) {
+        return false;
+    }
+    view.sortOrder = header.sortOrder;
+    view.tagFilter.assign(p, tagEnd);
+    view.selectedThemeId.assign(tagEnd + 1, idEnd);
+    view.selectedIndex = header.selectedIndex;
+    view.scrollRow = header.scrollRow;
+    
+    // 渲染器格式变了时只恢复视图, 缩略图照常加载
+    if (header.format != format) {
+        return true;
+    }
+    p = stringsEnd;
+    const char* end = data.data() + data.size();
+    for (uint32_t i = 0; i < header.thumbCount; i++) {
+        WarmStartThumb thumb;
+        if ((size_t)(end - p) < sizeof(thumb)) {
+            break;
+        }
+        memcpy(&thumb, p, sizeof(thumb));
+        p += sizeof(thumb);
+        uint64_t pixelBytes = (uint64_t)thumb.pitch * thumb.height;
+        if (thumb.width == 0 || thumb.height == 0 || thumb.width > 4096 || thumb.height > 4096 ||
+            thumb.urlBytes > (size_t)(end - p) || pixelBytes > (uint64_t)(end - p - thumb.urlBytes)) {
+            break;
+        }
+        std::string url(p, thumb.urlBytes);
+        p += thumb.urlBytes;
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, thumb.width, thumb.height, SDL_BITSPERPIXEL(format),
+                                                              format);
+        if (!surface) {
+            break;
+        }
+        size_t rowBytes = std::min((size_t)surface->pitch, (size_t)thumb.pitch);
+        for (uint32_t y = 0; y < thumb.height; y++) {
+            memcpy((uint8_t*)surface->pixels + (size_t)y * surface->pitch, p + (size_t)y * thumb.pitch, rowBytes);
+        }
+        p += pixelBytes;
+        thumbs.items.emplace_back(std::move(url), surface);
+    }
+    return true;
+}
+
+static void CacheWriteThreadFunc() {
+    std::unique_lock<std::mutex> lock(sCacheWriteMutex);
+    while (true) {
+        sCacheWriteCv.wait(lock, [] { return sCacheWriteJob || sWarmStartJob || sCacheWriterStop; });
+        if (!sCacheWriteJob && !sWarmStartJob) {
+            break; // 要求退出且没有剩下的任务
+        }
+        
+        // 目录缓存先写, 快照记下的是它写完后的大小和时间
+        std::unique_ptr<CacheWriteJob> job = std::move(sCacheWriteJob);
+        std::unique_ptr<WarmStartJob> warmJob = job ? nullptr : std::move(sWarmStartJob);
+        sCacheWriterBusy = true;
+        lock.unlock();
         
-        if (verifySt.st_size == 0) {
-            FileLogger::GetInstance().LogError("SaveCache: WARNING - File size is 0 despite successful write!");
+        if (job) {
+            WriteCacheFile(*job);
+        } else {
+            WriteWarmStartFile(*warmJob);
         }
-    } else {
-        FileLogger::GetInstance().LogError("SaveCache: Failed to stat file after write: errno=%d", errno);
+        
+        lock.lock();
+        sCacheWriterBusy = false;
+        sCacheIdleCv.notify_all();
+    }
+}
+
+// 把当前列表交给写入线程, 返回后就可以继续修改 mThemes
+// validators 不为空时写完缓存后一并保存它的 ETag / Last-Modified
+bool ThemeManager::SaveCache(const DownloadOperation* validators) {
+    auto job = std::make_unique<CacheWriteJob>();
+    job->data = SerializeThemes();
+    if (validators) {
+        // 304 响应可能不带校验信息, 沿用请求中的
+        job->saveValidators = true;
+        job->etag = !validators->etag.empty() ? validators->etag : validators->ifNoneMatch;
+        job->lastModified = !validators->lastModified.empty() ? validators->lastModified : validators->ifModifiedSince;
     }
     
-    FileLogger::GetInstance().LogInfo("Saved %zu themes to cache (%zu bytes)", mThemes.size(), json.length());
+    std::lock_guard<std::mutex> lock(sCacheWriteMutex);
+    if (sCacheWriteJob && sCacheWriteJob->saveValidators && !job->saveValidators) {
+        // 被替换的快照带着第一页的校验信息, 保留下来
+        job->saveValidators = true;
+        job->etag = std::move(sCacheWriteJob->etag);
+        job->lastModified = std::move(sCacheWriteJob->lastModified);
+    }
+    sCacheWriteJob = std::move(job);
+    sCacheWriterStop = false;
+    if (!sCacheWriteThread.joinable()) {
+        sCacheWriteThread = std::thread(CacheWriteThreadFunc);
+    }
+    sCacheWriteCv.notify_one();
     return true;
 }
 
+void ThemeManager::WaitForCacheWrites() {
+    std::unique_lock<std::mutex> lock(sCacheWriteMutex);
+    sCacheIdleCv.wait(lock, [] { return !sCacheWriteJob && !sWarmStartJob && !sCacheWriterBusy; });
+}
+
+void ThemeManager::SaveWarmStart(const WarmView& view, const std::vector<std::string>& thumbUrls, int thumbW, int thumbH) {
+    auto job = std::make_unique<WarmStartJob>();
+    job->view = view;
+    job->format = ImageLoader::GetTextureFormat();
+    for (const std::string& url : thumbUrls) {
+        if (job->urls.size() >= WARM_START_MAX_THUMBS) {
+            break;
+        }
+        std::string sourcePath = ImageLoader::GetCachePath(url);
+        if (url.empty() || sourcePath.empty()) {
+            continue;
+        }
+        job->urls.push_back(url);
+        job->pixelPaths.push_back(ImageLoader::GetProcessedCachePath(url, thumbW, thumbH));
+        job->sourcePaths.push_back(std::move(sourcePath));
+    }
+    
+    std::lock_guard<std::mutex> lock(sCacheWriteMutex);
+    sWarmStartJob = std::move(job);
+    sCacheWriterStop = false;
+    if (!sCacheWriteThread.joinable()) {
+        sCacheWriteThread = std::thread(CacheWriteThreadFunc);
+    }
+    sCacheWriteCv.notify_one();
+}
+
+bool ThemeManager::TakeWarmView(WarmView& view) {
+    if (!mWarmView) {
+        return false;
+    }
+    view = std::move(*mWarmView);
+    mWarmView.reset();
+    return true;
+}
+
+// 快照中的缩略图放进图集 (主线程), 之后同一 URL 的图集请求直接命中
+static void AddWarmThumbnails(const WarmThumbnails& thumbs) {
+    size_t added = 0;
+    for (const auto& item : thumbs.items) {
+        if (ImageLoader::AddAtlasThumbnail(item.first, item.second)) {
+            added++;
+        }
+    }
+    if (!thumbs.items.empty()) {
+        FileLogger::GetInstance().LogInfo("Restored %zu/%zu thumbnails from warm start snapshot", added,
+                                          thumbs.items.size());
+    }
+}
+
+void ThemeManager::PrewarmConnections() {
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (!queue) {
+        return;
+    }
+    queue->Prewarm(THEMEZER_GRAPHQL_URL);
+    queue->Prewarm(THEMEZER_CDN_URL "/");
+}
+
+// 菜单预热时读出的缓存: 记下读取时文件的大小和修改时间, 文件之后被改写或删除时不再使用
+struct PrefetchedCatalog {
+    std::vector<Theme> themes;
+    std::unique_ptr<ThemeManager::WarmView> warmView;   // 对应的热启动快照中的视图
+    off_t size = 0;
+    time_t mtime = 0;
+    size_t bytes = 0;
+};
+
+static std::mutex sPrefetchMutex;
+static std::unique_ptr<PrefetchedCatalog> sPrefetchedCatalog;
+static JobHandle sPrefetchJob;
+
+static std::unique_ptr<PrefetchedCatalog> TakePrefetchedCatalog() {
+    // 预读还在进行时等它完成, 比重新读一遍快
+    sPrefetchJob.Wait();
+    std::lock_guard<std::mutex> lock(sPrefetchMutex);
+    return std::move(sPrefetchedCatalog);
+}
+
+size_t ThemeManager::ReleasePrefetchedCatalog() {
+    if (!sPrefetchJob.IsDone()) {
+        return 0;
+    }
+    std::unique_ptr<PrefetchedCatalog> catalog;
+    {
+        std::lock_guard<std::mutex> lock(sPrefetchMutex);
+        catalog = std::move(sPrefetchedCatalog);
+    }
+    return catalog ? catalog->bytes : 0;
+}
+
+void ThemeManager::DeleteCache() {
+    WaitForCacheWrites();
+    TakePrefetchedCatalog();
+    unlink(CACHE_FILE);
+    unlink(CACHE_META_FILE);
+    unlink(WARM_START_FILE);
+}
+
+void ThemeManager::ShutdownCacheWriter() {
+    {
+        std::lock_guard<std::mutex> lock(sCacheWriteMutex);
+        sCacheWriterStop = true;
+        sCacheWriteCv.notify_one();
+    }
+    if (sCacheWriteThread.joinable()) {
+        sCacheWriteThread.join(); // 先写完剩下的快照
+    }
+}
+
 // 从缓存文件加载主题
 bool ThemeManager::LoadCache() {
-    FileLogger::GetInstance().LogInfo("Loading theme cache from: %s", CACHE_FILE);
+    // 上一个界面的缓存可能还在写
+    WaitForCacheWrites();
     
-    // 检查文件是否存在
+    // 旧版本的 JSON 缓存不再读取, 删除后重新获取
     struct stat st;
-    if (stat(CACHE_FILE, &st) != 0) {
-        FileLogger::GetInstance().LogInfo("Cache file does not exist");
-        return false;
+    if (stat(LEGACY_CACHE_FILE, &st) == 0) {
+        unlink(LEGACY_CACHE_FILE);
+        unlink(LEGACY_CACHE_FILE ".meta");
     }
     
-    // 读取文件内容
-    FILE* file = fopen(CACHE_FILE, "r");
-    if (!file) {
-        FileLogger::GetInstance().LogError("Failed to open cache file for reading");
+    if (stat(CACHE_FILE, &st) != 0 || st.st_size <= 0) {
+        FileLogger::GetInstance().LogInfo("Cache file does not exist");
         return false;
     }
     
-    // 获取文件大小
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    // 菜单上已经预读过, 文件没有改变时直接使用
+    std::unique_ptr<PrefetchedCatalog> prefetched = TakePrefetchedCatalog();
+    if (prefetched && prefetched->size == st.st_size && prefetched->mtime == st.st_mtime) {
+        mThemes.swap(prefetched->themes);
+        mWarmView = std::move(prefetched->warmView);
+        mCatalogVersion++;
+        FileLogger::GetInstance().LogInfo("Loaded %zu themes from prefetched cache (%zu bytes)", mThemes.size(),
+                                          prefetched->bytes);
+        return true;
+    }
     
-    if (fileSize <= 0) {
-        fclose(file);
-        FileLogger::GetInstance().LogError("Cache file is empty");
+    FILE* file = fopen(CACHE_FILE, "rb");
+    if (!file) {
+        FileLogger::GetInstance().LogError("Failed to open cache file for reading");
         return false;
     }
     
-    // 读取内容
-    std::string json;
-    json.resize(fileSize);
-    size_t read = fread(&json[0], 1, fileSize, file);
+    std::string data;
+    data.resize(st.st_size);
+    size_t read = fread(&data[0], 1, data.size(), file);
     fclose(file);
     
-    if (read != (size_t)fileSize) {
-        FileLogger::GetInstance().LogError("Failed to read cache file");
+    if (read != data.size() || !DeserializeThemes(data, mThemes)) {
+        FileLogger::GetInstance().LogError("Failed to load cache, discarding it");
+        unlink(CACHE_FILE);
+        unlink(CACHE_META_FILE);
         return false;
     }
-    
-    // 反序列化主题数据
-    if (!DeserializeThemes(json)) {
-        FileLogger::GetInstance().LogError("Failed to deserialize cache");
-        return false;
+    mCatalogVersion++;
+    
+    // 没有经过菜单预读: 快照在这里读, 缩略图直接放进图集
+    auto warmView = std::make_unique<WarmView>();
+    WarmThumbnails warmThumbs;
+    if (ReadWarmStartFile(st, ImageLoader::GetTextureFormat(), *warmView, warmThumbs)) {
+        AddWarmThumbnails(warmThumbs);
+        mWarmView = std::move(warmView);
     }
     
-    FileLogger::GetInstance().LogInfo("Loaded %zu themes from cache (%zu bytes)", mThemes.size(), fileSize);
+    FileLogger::GetInstance().LogInfo("Loaded %zu themes from cache (%zu bytes)", mThemes.size(), data.size());
     return true;
 }
 
-// 检查缓存是否有效 (24小时内)
-bool ThemeManager::IsCacheValid() const {
+void ThemeManager::PrefetchCache(size_t thumbCount, int thumbW, int thumbH) {
+    if (!sPrefetchJob.IsDone()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sPrefetchMutex);
+        if (sPrefetchedCatalog) {
+            return;
+        }
+    }
+    // 缓存可能正在写入 (刚离开下载界面), 写完之后才有意义
+    WaitForCacheWrites();
+    
+    auto thumbUrls = std::make_shared<std::vector<std::string>>();
+    auto warmThumbs = std::make_shared<WarmThumbnails>();
+    Uint32 format = ImageLoader::GetTextureFormat();
+    sPrefetchJob = JobSystem::Submit([thumbUrls, warmThumbs, format, thumbCount, thumbW, thumbH](const CancelToken&) {
+        FILE* file = fopen(CACHE_FILE, "rb");
+        if (!file) {
+            return;
+        }
+        // 按打开的文件取大小和时间, 读取期间被改名替换也不会对错
+        struct stat st;
+        if (fstat(fileno(file), &st) != 0 || st.st_size <= 0) {
+            fclose(file);
+            return;
+        }
+        auto catalog = std::make_unique<PrefetchedCatalog>();
+        catalog->size = st.st_size;
+        catalog->mtime = st.st_mtime;
+        std::string data;
+        data.resize(st.st_size);
+        size_t read = fread(&data[0], 1, data.size(), file);
+        fclose(file);
+        // 损坏的缓存留给 LoadCache 处理 (删除并重新获取)
+        if (read != data.size() || !DeserializeThemes(data, catalog->themes)) {
+            return;
+        }
+        catalog->bytes = data.size();
+        
+        // 热启动快照紧接着目录读出, 其中的缩略图不用再逐个查找和读取
+        auto warmView = std::make_unique<WarmView>();
+        std::set<std::string> warmUrls;
+        if (ReadWarmStartFile(st, format, *warmView, *warmThumbs)) {
+            catalog->warmView = std::move(warmView);
+            for (const auto& item : warmThumbs->items) {
+                warmUrls.insert(item.first);
+            }
+        }
+        
+        // 只取磁盘上已有的缩略图 (像素缓存或原始图片), 没有的在打开列表时再下载
+        for (const Theme& theme : catalog->themes) {
+            if (thumbUrls->size() >= thumbCount) {
+                break;
+            }
+            const std::string& url = theme.collagePreview.thumbUrl;
+            if (url.empty() || warmUrls.count(url)) {
+                continue;
+            }
+            struct stat imageSt;
+            if (ImageLoader::IsInDiskCache(url) ||
+                stat(ImageLoader::GetProcessedCachePath(url, thumbW, thumbH).c_str(), &imageSt) == 0) {
+                thumbUrls->push_back(url);
+            }
+        }
+        FileLogger::GetInstance().LogInfo("Prefetched %zu cached themes, %zu thumbnails on disk",
+                                          catalog->themes.size(), thumbUrls->size());
+        
+        std::lock_guard<std::mutex> lock(sPrefetchMutex);
+        sPrefetchedCatalog = std::move(catalog);
+    }, [thumbUrls, warmThumbs, thumbW, thumbH]() {
+        AddWarmThumbnails(*warmThumbs);
+        warmThumbs->Clear();   // 已经放进图集的像素不再保留
+        // 不带回调: 解码后进入图集, 打开列表时的请求直接命中
+        for (const std::string& url : *thumbUrls) {
+            ImageLoader::LoadRequest request;
+            request.url = url;
+            request.lowPriority = true;
+            request.targetWidth = thumbW;
+            request.targetHeight = thumbH;
+            request.atlas = true;
+            ImageLoader::LoadAsync(request);
+        }
+    });
+}
+
+// 缓存的年龄 (秒), 没有缓存时返回 -1
+int64_t ThemeManager::GetCacheAge() const {
     struct stat st;
     if (stat(CACHE_FILE, &st) != 0) {
-        return false; // 文件不存在
+        return -1; // 文件不存在
     }
     
-    // 获取当前时间
-    time_t now = time(NULL);
     time_t fileTime = st.st_mtime;
     
-    // 检查是否在24小时内
-    const time_t CACHE_VALIDITY_SECONDS = 24 * 60 * 60; // 24小时
-    time_t age = now - fileTime;
+    // 304 确认过的缓存以 .meta 的时间为准
+    struct stat metaSt;
+    if (stat(CACHE_META_FILE, &metaSt) == 0 && metaSt.st_mtime > fileTime) {
+        fileTime = metaSt.st_mtime;
+    }
     
+    // 时钟回拨时当作刚写入
+    int64_t age = (int64_t)(time(NULL) - fileTime);
+    return age < 0 ? 0 : age;
+}
+
+// 检查缓存是否有效 (24小时内)
+bool ThemeManager::IsCacheValid() const {
+    int64_t age = GetCacheAge();
     bool valid = (age >= 0 && age < CACHE_VALIDITY_SECONDS);
     
     if (valid) {
-        FileLogger::GetInstance().LogInfo("Cache is valid (age: %ld seconds)", age);
+        FileLogger::GetInstance().LogInfo("Cache is valid (age: %lld seconds)", (long long)age);
     } else {
-        FileLogger::GetInstance().LogInfo("Cache is invalid (age: %ld seconds, max: %ld)", age, CACHE_VALIDITY_SECONDS);
+        FileLogger::GetInstance().LogInfo("Cache is invalid (age: %lld seconds, max: %lld)", (long long)age,
+                                          (long long)CACHE_VALIDITY_SECONDS);
     }
     
     return valid;
 }
 
-// 后台检测更新
-void ThemeManager::CheckForUpdates() {
-    if (mCheckingUpdates || mThemes.empty()) {
+// 后台检测更新: 以增量同步的方式直接合并变化, 请求全部走 DownloadQueue
+// Themezer 只有 GraphQL (POST) 接口, 不能用条件请求; 检测时只下载 uuid / updatedAt 清单, 有变化的主题才取完整数据
+void ThemeManager::CheckForUpdates(std::function<void(bool ok, size_t changes)> onComplete) {
+    if (!SyncThemes(false)) {
+        if (onComplete) {
+            onComplete(false, 0);
+        }
         return;
     }
+    if (onComplete) {
+        mSyncCompleteCallback = onComplete;
+    }
+}
+
+void ThemeManager::ForceRefresh() {
+    // 已有列表时只同步变化的主题, 没有时完整获取
+    if (mThemes.empty() || mState == FETCH_IN_PROGRESS || (mFetchStream && mFetchStream->page == 1)) {
+        FetchThemes();
+    } else {
+        SyncThemes(true);
+    }
+}
+
+bool ThemeManager::SyncThemes(bool notify) {
+    if (mSyncing || mSyncReady) {
+        // 后台同步进行中又要求显示进度 (手动刷新): 沿用这次同步, 结束时报告结果
+        if (notify && !mSyncNotify) {
+            mSyncNotify = true;
+            mState = FETCH_IN_PROGRESS;
+            if (mStateCallback) {
+                mStateCallback(FETCH_IN_PROGRESS, "Syncing themes...");
+            }
+        }
+        return true;
+    }
+    // 第一页还在边下载边显示时不同步
+    bool loadingFirstPage = mFetchStream && mFetchStream->page == 1;
+    if (mThemes.empty() || mState == FETCH_IN_PROGRESS || loadingFirstPage || !DownloadQueue::GetInstance()) {
+        return false;
+    }
     
-    mCheckingUpdates = true;
-    mHasUpdates = false;
-    
-    FileLogger::GetInstance().LogInfo("Checking for theme updates...");
+    FileLogger::GetInstance().LogInfo("Starting delta sync (%zu cached themes)", mThemes.size());
     
-    // 构造 GraphQL 查询 (只获取基本信息用于对比)
-    std::string query = R"({
-        "query": "{ wiiuThemes(limit: 50) { nodes { uuid updatedAt } } }"
-    })";
+    mSyncing = true;
+    mSyncNotify = notify;
+    mSyncReady = false;
+    mSyncManifest.clear();
+    mSyncChangedIds.clear();
+    mSyncFetched.clear();
     
-    std::string response = FetchUrl(THEMEZER_GRAPHQL_URL, query);
+    if (notify) {
+        mState = FETCH_IN_PROGRESS;
+        if (mStateCallback) {
+            mStateCallback(FETCH_IN_PROGRESS, "Syncing themes...");
+        }
+    }
     
-    if (response.empty()) {
-        mCheckingUpdates = false;
-        FileLogger::GetInstance().LogWarning("Failed to check for updates");
+    SyncManifestPage(1);
+    return true;
+}
+
+void ThemeManager::CancelSync() {
+    if (mSyncOp && DownloadQueue::GetInstance()) {
+        DownloadQueue::GetInstance()->DownloadCancel(mSyncOp);
+        delete mSyncOp;
+    }
+    mSyncOp = nullptr;
+    mSyncing = false;
+    mSyncReady = false;
+    mSyncCompleteCallback = nullptr;
+    mSyncManifest.clear();
+    mSyncChangedIds.clear();
+    mSyncFetched.clear();
+}
+
+void ThemeManager::FinishSync(bool ok) {
+    mSyncing = false;
+    if (ok) {
+        // 在 Update 中合并, 详情页打开期间不改变 mThemes
+        mSyncReady = true;
         return;
     }
     
-    try {
-        JsonValue root = SimpleJsonParser::Parse(response);
-        
-        if (!root.isObject() || !root.has("data")) {
-            mCheckingUpdates = false;
-            return;
+    FileLogger::GetInstance().LogWarning("Delta sync failed, keeping cached themes");
+    mSyncManifest.clear();
+    mSyncChangedIds.clear();
+    mSyncFetched.clear();
+    if (mSyncNotify) {
+        mState = FETCH_SUCCESS; // 继续显示缓存的列表
+        if (mStateCallback) {
+            mStateCallback(FETCH_SUCCESS, "Sync failed, showing cached themes");
         }
+    }
+    
+    auto onComplete = std::move(mSyncCompleteCallback);
+    mSyncCompleteCallback = nullptr;
+    if (onComplete) {
+        onComplete(false, 0);
+    }
+}
+
+void ThemeManager::SyncManifestPage(int page) {
+    // 清单只包含 uuid / updatedAt 和计数, 整个目录只有几十 KB
+    char query[256];
+    snprintf(query, sizeof(query), R"({
+        "query": "{ wiiuThemes(limit: %d, page: %d) { nodes { uuid updatedAt downloadCount saveCount } } }"
+    })", MANIFEST_PAGE_SIZE, page);
+    
+    mSyncOp = new DownloadOperation();
+    mSyncOp->url = THEMEZER_GRAPHQL_URL;
+    mSyncOp->postData = query;
+    mSyncOp->compressed = true;
+    mSyncOp->priority = mSyncNotify ? DownloadPriority::HIGH : DownloadPriority::LOW;
+    mSyncOp->cb = [this, page](DownloadOperation* op) {
+        mSyncOp = nullptr;
         
-        const JsonValue& data = root["data"];
-        if (!data.has("wiiuThemes") || !data["wiiuThemes"].has("nodes")) {
-            mCheckingUpdates = false;
-            return;
+        bool ok = false;
+        size_t count = 0;
+        if (op->status == DownloadStatus::COMPLETE && !op->buffer.empty()) {
+            JsonReader reader(op->buffer);
+            if (EnterThemeNodes(reader)) {
+                while (reader.NextElement()) {
+                    Theme entry;
+                    if (ReadThemeNode(reader, entry) && !entry.id.empty()) {
+                        mSyncManifest.push_back(std::move(entry));
+                    }
+                    count++;
+                }
+                ok = !reader.HasError();
+            }
         }
+        delete op;
         
-        const JsonValue& nodes = data["wiiuThemes"]["nodes"];
+        if (!ok) {
+            FinishSync(false);
+        } else if (count >= (size_t)MANIFEST_PAGE_SIZE) {
+            SyncManifestPage(page + 1);
+        } else {
+            SyncCollectChanges();
+        }
+    };
+    DownloadQueue::GetInstance()->DownloadAdd(mSyncOp);
+}
+
+void ThemeManager::SyncCollectChanges() {
+    // 上次同步点: 本地最新的 updatedAt (ISO 8601, 可以按字符串比较)
+    std::string syncedAt;
+    std::map<PooledString, const Theme*> local;
+    for (const Theme& theme : mThemes) {
+        local[theme.id] = &theme;
+        if (theme.updatedAt > syncedAt) {
+            syncedAt = theme.updatedAt;
+        }
+    }
+    
+    // 本地没有且比同步点新的是新增的主题; 本地没有的旧主题属于还没加载的页, 交给分页加载
+    for (const Theme& entry : mSyncManifest) {
+        auto it = local.find(entry.id);
+        if (it != local.end() ? (it->second->updatedAt != entry.updatedAt) : (entry.updatedAt > syncedAt)) {
+            mSyncChangedIds.push_back(entry.id);
+        }
+    }
+    
+    FileLogger::GetInstance().LogInfo("Delta sync: %zu themes in manifest, %zu changed since %s",
+                                      mSyncManifest.size(), mSyncChangedIds.size(), syncedAt.c_str());
+    SyncFetchChanged(0);
+}
+
+void ThemeManager::SyncFetchChanged(size_t start) {
+    if (start >= mSyncChangedIds.size()) {
+        FinishSync(true);
+        return;
+    }
+    
+    // 每个请求用别名一次获取 GetSyncBatchSize 个主题的列表字段
+    size_t end = std::min(mSyncChangedIds.size(), start + PerfProfile::GetSyncBatchSize());
+    std::string fields = "{ ";
+    for (size_t i = start; i < end; i++) {
+        fields += "t" + std::to_string(i - start) + ": wiiuTheme(uuid: \\\"" + mSyncChangedIds[i] + "\\\") { " THEME_LIST_FIELDS " } ";
+    }
+    fields += "}";
+    
+    mSyncOp = new DownloadOperation();
+    mSyncOp->url = THEMEZER_GRAPHQL_URL;
+    mSyncOp->postData = "{ \"query\": \"" + fields + "\" }";
+    mSyncOp->compressed = true;
+    mSyncOp->priority = mSyncNotify ? DownloadPriority::HIGH : DownloadPriority::LOW;
+    mSyncOp->cb = [this, end](DownloadOperation* op) {
+        mSyncOp = nullptr;
         
-        // 检查是否有新主题或更新
-        for (size_t i = 0; i < nodes.size(); i++) {
-            const JsonValue& node = nodes[i];
-            
-            if (!node.has("uuid") || !node.has("updatedAt")) continue;
-            
-            std::string id = node["uuid"].asString();
-            std::string updatedAt = node["updatedAt"].asString();
-            
-            // 查找本地缓存中的主题
-            bool found = false;
-            bool isNewer = false;
-            
-            for (const Theme& theme : mThemes) {
-                if (theme.id == id) {
-                    found = true;
-                    if (theme.updatedAt != updatedAt) {
-                        isNewer = true;
+        bool ok = false;
+        if (op->status == DownloadStatus::COMPLETE && !op->buffer.empty()) {
+            // data 中每个别名 tN 是一个主题 (已删除的主题为 null)
+            JsonReader reader(op->buffer);
+            if (reader.EnterObject() && reader.FindMember("data") && reader.EnterObject()) {
+                std::string_view alias;
+                while (reader.NextMember(alias)) {
+                    if (alias.empty() || alias[0] != 't') {
+                        reader.Skip();
+                        continue;
+                    }
+                    Theme theme;
+                    if (ReadThemeNode(reader, theme) && !theme.id.empty() && !theme.name.empty()) {
+                        mSyncFetched[theme.id] = std::move(theme);
                     }
-                    break;
                 }
-            }
-            
-            // 如果是新主题或有更新
-            if (!found || isNewer) {
-                mHasUpdates = true;
-                FileLogger::GetInstance().LogInfo("Found updates!");
-                break;
+                ok = !reader.HasError();
             }
         }
+        delete op;
         
-    } catch (...) {
-        FileLogger::GetInstance().LogError("Error parsing update check response");
+        if (ok) {
+            SyncFetchChanged(end);
+        } else {
+            FinishSync(false);
+        }
+    };
+    DownloadQueue::GetInstance()->DownloadAdd(mSyncOp);
+}
+
+void ThemeManager::ApplySync() {
+    // 按清单顺序重建列表: 已有的主题原样移动 (保留已加载的纹理), 变化的更新字段, 新增的插入
+    std::map<PooledString, Theme*> local;
+    std::vector<PooledString> oldOrder;
+    for (Theme& theme : mThemes) {
+        local[theme.id] = &theme;
+        oldOrder.push_back(theme.id);
+    }
+    
+    std::vector<Theme> merged;
+    merged.reserve(mThemes.size() + mSyncFetched.size());
+    std::set<PooledString> seen;
+    size_t inserted = 0, updated = 0, missing = 0;
+    
+    for (const Theme& entry : mSyncManifest) {
+        if (!seen.insert(entry.id).second) {
+            continue;
+        }
+        auto fetched = mSyncFetched.find(entry.id);
+        auto it = local.find(entry.id);
+        if (it != local.end()) {
+            Theme& theme = *it->second;
+            theme.downloads = entry.downloads;
+            theme.likes = entry.likes;
+            if (fetched != mSyncFetched.end()) {
+                const Theme& fresh = fetched->second;
+                ThemeDetails& details = theme.EditDetails();
+                theme.name = fresh.name;
+                theme.author = fresh.author;
+                details.description = fresh.GetDetails().description;
+                theme.updatedAt = fresh.updatedAt;
+                theme.tags = fresh.tags;
+                if (theme.collagePreview.thumbUrl != fresh.collagePreview.thumbUrl) {
+                    theme.collagePreview = fresh.collagePreview;
+                }
+                // 详情 (截图、下载地址) 可能也变了, 打开时重新获取
+                theme.detailsLoaded = false;
+                theme.collagePreview.hdUrl.clear();
+                theme.collagePreview.hdLoaded = false;
+                theme.collagePreview.hdTexture.Reset();
+                details.launcherScreenshot = ThemeImage();
+                details.waraWaraScreenshot = ThemeImage();
+                updated++;
+            } else if (theme.updatedAt != entry.updatedAt) {
+                missing++; // 获取失败, 下次同步再试
+            }
+            BuildDisplayStrings(theme);
+            merged.push_back(std::move(theme));
+        } else if (fetched != mSyncFetched.end()) {
+            merged.push_back(std::move(fetched->second));
+            inserted++;
+        }
+    }
+    
+    // 清单覆盖了整个目录: 本地有而清单中没有的主题已被删除
+    size_t removed = 0;
+    for (const std::string& id : oldOrder) {
+        if (!seen.count(id)) {
+            removed++;
+        }
+    }
+    
+    bool changed = (merged.size() != oldOrder.size());
+    for (size_t i = 0; !changed && i < merged.size(); i++) {
+        changed = (merged[i].id != oldOrder[i]);
+    }
+    
+    // 即使没有增删, 计数也可能变了
+    mThemes.swap(merged);
+    mHasUpdates = (missing > 0);
+    mCacheDirty = true;
+    mCatalogVersion++;
+    if (changed) {
+        mListVersion++;
+    }
+    
+    FileLogger::GetInstance().LogInfo("Delta sync applied: %zu inserted, %zu updated, %zu removed (%zu total)",
+                                      inserted, updated, removed, mThemes.size());
+
+    // 已安装主题的更新标记: 清单覆盖整个目录, 按 id 建表后在任务线程中和登记表连接
+    if (!mSyncManifest.empty()) {
+        auto catalog = std::make_shared<std::unordered_map<std::string, std::string>>();
+        catalog->reserve(mSyncManifest.size());
+        for (const Theme& entry : mSyncManifest) {
+            catalog->emplace(entry.id.str(), entry.updatedAt);
+        }
+        JobSystem::Submit([catalog](const CancelToken&) {
+            ThemeRegistry::GetInstance().ApplyCatalogUpdates(*catalog);
+        });
+    }
+
+    mSyncManifest.clear();
+    mSyncChangedIds.clear();
+    mSyncFetched.clear();
+    
+    if (mSyncNotify) {
+        mState = FETCH_SUCCESS;
+        if (mStateCallback) {
+            mStateCallback(FETCH_SUCCESS, "Themes synced");
+        }
     }
     
-    mCheckingUpdates = false;
+    auto onComplete = std::move(mSyncCompleteCallback);
+    mSyncCompleteCallback = nullptr;
+    if (onComplete) {
+        onComplete(true, inserted + updated + removed);
+    }
 }
 
+// 安装后保存预览图的后台任务: 每个主题一个任务 (协程); 浏览时看过的图片在 ImageLoader 的磁盘缓存中, 直接写出,
+// 其余的经由 DownloadQueue 并行下载到文件 (共享连接, 受队列的并发上限约束); 同时进行的任务数有上限, 其余排队
+// 任何线程都可以排队, 任务在 UpdateImageJobs 中开始; 文件操作在任务线程上进行
+struct ImageSaveJob {
+    std::string themeName;
+    std::string imagesDir;
+    std::vector<std::pair<std::string, std::string>> images; // URL, 目标文件
+};
+
+static constexpr size_t MAX_ACTIVE_IMAGE_JOBS = 2;
+static std::mutex sImageJobMutex;                                  // 保护 sImageJobQueue
+static std::deque<std::shared_ptr<ImageSaveJob>> sImageJobQueue;
+static std::atomic<size_t> sActiveImageJobs{0};                    // 取消时可能在任务线程上减少
+static Async::Scope sImageJobScope;
+
 void ThemeManager::SaveThemeMetadata(const Theme& theme, const std::string& themePath) {
     FileLogger::GetInstance().LogInfo("Saving theme metadata to: %s", themePath.c_str());
     
@@ -877,7 +1846,7 @@ void ThemeManager::SaveThemeMetadata(const Theme& theme, const std::string& them
     fprintf(fp, "  \"id\": \"%s\",\n", theme.id.c_str());
     fprintf(fp, "  \"name\": \"%s\",\n", theme.name.c_str());
     fprintf(fp, "  \"author\": \"%s\",\n", theme.author.c_str());
-    fprintf(fp, "  \"description\": \"%s\",\n", theme.description.c_str());
+    fprintf(fp, "  \"description\": \"%s\",\n", theme.GetDetails().description.c_str());
     fprintf(fp, "  \"downloads\": %d,\n", theme.downloads);
     fprintf(fp, "  \"likes\": %d,\n", theme.likes);
     fprintf(fp, "  \"updatedAt\": \"%s\",\n", theme.updatedAt.c_str());
@@ -891,196 +1860,168 @@ void ThemeManager::SaveThemeMetadata(const Theme& theme, const std::string& them
     fclose(fp);
     
     FileLogger::GetInstance().LogInfo("Metadata saved successfully");
-    
-    // 启动异步图片下载线程
-    std::thread imageDownloadThread([theme, themePath]() {
-        FileLogger::GetInstance().LogInfo("Starting async image downloads");
-        
-        // 创建 images 子目录
-        std::string imagesDir = themePath + "/images";
-        mkdir(imagesDir.c_str(), 0777);
-        FileLogger::GetInstance().LogInfo("Created images directory: %s", imagesDir.c_str());
-        
-        int successCount = 0;
-        int totalImages = 6;
-        
-        // 下载图片到 images/ 子目录 - 先删除旧文件以确保重新下载
-        if (!theme.collagePreview.thumbUrl.empty()) {
-            std::string thumbPath = imagesDir + "/collage_thumb.jpg";
-            unlink(thumbPath.c_str());
-            FileLogger::GetInstance().LogInfo("Downloading collage thumb: %s", theme.collagePreview.thumbUrl.c_str());
-            if (ThemeManager::DownloadImageToFileStatic(theme.collagePreview.thumbUrl, thumbPath)) {
-                successCount++;
-            }
-        }
-        
-        if (!theme.collagePreview.hdUrl.empty()) {
-            std::string hdPath = imagesDir + "/collage.jpg";
-            unlink(hdPath.c_str());
-            FileLogger::GetInstance().LogInfo("Downloading collage HD: %s", theme.collagePreview.hdUrl.c_str());
-            if (ThemeManager::DownloadImageToFileStatic(theme.collagePreview.hdUrl, hdPath)) {
-                successCount++;
-            }
-        }
-        
-        if (!theme.launcherScreenshot.thumbUrl.empty()) {
-            std::string thumbPath = imagesDir + "/launcher_thumb.jpg";
-            unlink(thumbPath.c_str());
-            FileLogger::GetInstance().LogInfo("Downloading launcher thumb: %s", theme.launcherScreenshot.thumbUrl.c_str());
-            if (ThemeManager::DownloadImageToFileStatic(theme.launcherScreenshot.thumbUrl, thumbPath)) {
-                successCount++;
-            }
-        }
-        
-        if (!theme.launcherScreenshot.hdUrl.empty()) {
-            std::string hdPath = imagesDir + "/launcher.jpg";
-            unlink(hdPath.c_str());
-            FileLogger::GetInstance().LogInfo("Downloading launcher HD: %s", theme.launcherScreenshot.hdUrl.c_str());
-            if (ThemeManager::DownloadImageToFileStatic(theme.launcherScreenshot.hdUrl, hdPath)) {
-                successCount++;
-            }
-        }
-        
-        if (!theme.waraWaraScreenshot.thumbUrl.empty()) {
-            std::string thumbPath = imagesDir + "/warawara_thumb.jpg";
-            unlink(thumbPath.c_str());
-            FileLogger::GetInstance().LogInfo("Downloading warawara thumb: %s", theme.waraWaraScreenshot.thumbUrl.c_str());
-            if (ThemeManager::DownloadImageToFileStatic(theme.waraWaraScreenshot.thumbUrl, thumbPath)) {
-                successCount++;
-            }
-        }
-        
-        if (!theme.waraWaraScreenshot.hdUrl.empty()) {
-            std::string hdPath = imagesDir + "/warawara.jpg";
-            unlink(hdPath.c_str());
-            FileLogger::GetInstance().LogInfo("Downloading warawara HD: %s", theme.waraWaraScreenshot.hdUrl.c_str());
-            if (ThemeManager::DownloadImageToFileStatic(theme.waraWaraScreenshot.hdUrl, hdPath)) {
-                successCount++;
-            }
+    ThemeRegistry::GetInstance().UpdateTheme(themePath);
+    
+    // 预览图交给后台任务下载 (这里可能在 InstallQueue 的安装线程中)
+    auto job = std::make_shared<ImageSaveJob>();
+    job->themeName = theme.name;
+    job->imagesDir = themePath + "/images";
+    const ThemeDetails& details = theme.GetDetails();
+    const std::pair<const std::string*, const char*> images[] = {
+        {&theme.collagePreview.thumbUrl, "collage_thumb.jpg"},
+        {&theme.collagePreview.hdUrl, "collage.jpg"},
+        {&details.launcherScreenshot.thumbUrl, "launcher_thumb.jpg"},
+        {&details.launcherScreenshot.hdUrl, "launcher.jpg"},
+        {&details.waraWaraScreenshot.thumbUrl, "warawara_thumb.jpg"},
+        {&details.waraWaraScreenshot.hdUrl, "warawara.jpg"},
+    };
+    for (const auto& image : images) {
+        if (!image.first->empty()) {
+            job->images.emplace_back(*image.first, job->imagesDir + "/" + image.second);
         }
-        
-        FileLogger::GetInstance().LogInfo("Async image downloads complete: %d/%d successful", successCount, totalImages);
-    });
-    
-    // 分离线程,让它在后台运行
-    imageDownloadThread.detach();
+    }
+    if (job->images.empty()) {
+        FileLogger::GetInstance().LogInfo("Metadata saved, theme has no preview images");
+        return;
+    }
     
-    FileLogger::GetInstance().LogInfo("Metadata saved, image downloads started in background");
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(sImageJobMutex);
+        sImageJobQueue.push_back(std::move(job));
+        queued = sImageJobQueue.size();
+    }
+    FileLogger::GetInstance().LogInfo("Metadata saved, preview images queued (%zu jobs waiting)", queued);
 }
 
-bool ThemeManager::DownloadImageToFile(const std::string& url, const std::string& filePath) {
-    FileLogger::GetInstance().LogInfo("[START DOWNLOAD] URL: %s -> %s", url.c_str(), filePath.c_str());
-    
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        FileLogger::GetInstance().LogError("Failed to initialize curl for image download");
+// 磁盘缓存中有这张图片时直接写到 path (先写 .part 再改名), 在任务线程上调用
+static bool CopyFromImageCache(const std::string& url, const std::string& path) {
+    std::vector<uint8_t> data = ImageLoader::LoadFromCache(url);
+    if (data.empty()) {
         return false;
     }
-    
-    FILE* fp = fopen(filePath.c_str(), "wb");
-    if (!fp) {
-        FileLogger::GetInstance().LogError("Failed to open file for writing: %s", filePath.c_str());
-        curl_easy_cleanup(curl);
-        return false;
+    std::string partPath = path + ".part";
+    FileIO file;
+    bool ok = file.Open(partPath, FileIO::MODE_WRITE) && file.Write(data.data(), data.size());
+    ok = file.Close() && ok;
+    // 重新安装时旧的预览图还在, FAT 上不能改名覆盖已有的文件
+    if (ok) {
+        unlink(path.c_str());
     }
-    
-    FileDownloadData downloadData = { fp, 0 };
-    
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &downloadData);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-    
-    CURLcode res = curl_easy_perform(curl);
-    
-    FileLogger::GetInstance().LogInfo("[DOWNLOAD COMPLETE] Total written: %zu bytes, CURL result: %d", downloadData.totalWritten, res);
-    
-    // 确保数据写入磁盘
-    fflush(fp);
-    fclose(fp);
-    curl_easy_cleanup(curl);
-    
-    if (res != CURLE_OK) {
-        FileLogger::GetInstance().LogError("Failed to download image: %s", curl_easy_strerror(res));
-        unlink(filePath.c_str());  // 删除失败的文件
+    if (!ok || rename(partPath.c_str(), path.c_str()) != 0) {
+        unlink(partPath.c_str());
         return false;
     }
+    return true;
+}
+
+// 一个任务: 缓存中没有的图片同时交给 DownloadQueue, 先写 .part 文件, 全部结束后改名
+static Async::Task<void> RunImageSaveJob(std::shared_ptr<ImageSaveJob> job) {
+    std::vector<std::unique_ptr<DownloadOperation>> ops;
+    // 结束或取消时都不留下写了一半的文件 (改名成功的 .part 已经不存在)
+    struct Cleanup {
+        std::vector<std::unique_ptr<DownloadOperation>>& ops;
+        ~Cleanup() {
+            for (const auto& op : ops) {
+                unlink(op->filePath.c_str());
+            }
+            sActiveImageJobs--;
+        }
+    } cleanup{ops};
+    
+    co_await Async::ResumeOnWorker();
+    mkdir(job->imagesDir.c_str(), 0777);
+    
+    std::vector<DownloadOperation*> pending;
+    std::vector<size_t> downloadIndex;  // ops[i] 对应的 job->images 下标
+    int fromCache = 0;
+    for (size_t i = 0; i < job->images.size(); i++) {
+        const auto& image = job->images[i];
+        // 先删除旧文件以确保重新下载
+        unlink(image.second.c_str());
+        if (CopyFromImageCache(image.first, image.second)) {
+            fromCache++;
+            continue;
+        }
+        
+        auto op = std::make_unique<DownloadOperation>();
+        op->url = image.first;
+        op->sink = DownloadSink::FILE;
+        op->filePath = image.second + ".part";
+        op->priority = DownloadPriority::LOW;  // 不和正在浏览的界面抢连接
+        op->traffic = DownloadTraffic::BACKGROUND;
+        pending.push_back(op.get());
+        ops.push_back(std::move(op));
+        downloadIndex.push_back(i);
+    }
+    FileLogger::GetInstance().LogInfo("Preview images for %s: %d from image cache, downloading %zu",
+                                      job->themeName.c_str(), fromCache, pending.size());
+    if (!pending.empty()) {
+        co_await Async::Download(pending);
+        co_await Async::ResumeOnWorker();
+    }
     
-    // 验证文件大小
-    struct stat st;
-    if (stat(filePath.c_str(), &st) == 0) {
-        FileLogger::GetInstance().LogInfo("Image downloaded successfully: %s (Size: %ld bytes)", filePath.c_str(), st.st_size);
-        if (st.st_size == 0) {
-            FileLogger::GetInstance().LogError("Downloaded file is empty: %s", filePath.c_str());
-            unlink(filePath.c_str());
-            return false;
+    int succeeded = fromCache;
+    for (size_t i = 0; i < ops.size(); i++) {
+        const DownloadOperation* op = ops[i].get();
+        const std::string& path = job->images[downloadIndex[i]].second;
+        bool ok = op->status == DownloadStatus::COMPLETE && op->bytesReceived > 0 &&
+                  op->response_code >= 200 && op->response_code < 300;
+        if (ok) {
+            unlink(path.c_str());
+            ok = rename(op->filePath.c_str(), path.c_str()) == 0;
+        }
+        if (ok) {
+            succeeded++;
+        } else {
+            FileLogger::GetInstance().LogError("Failed to download preview image: %s (HTTP %ld)", op->url.c_str(), op->response_code);
         }
-    } else {
-        FileLogger::GetInstance().LogError("Failed to stat downloaded file: %s", filePath.c_str());
-        return false;
     }
     
-    return true;
+    FileLogger::GetInstance().LogInfo("Preview images for %s complete: %d/%zu successful",
+                                      job->themeName.c_str(), succeeded, job->images.size());
+    // 登记表里的预览图路径按实际下载到的文件更新
+    ThemeRegistry::GetInstance().UpdateTheme(job->imagesDir.substr(0, job->imagesDir.length() - strlen("/images")));
 }
 
-// 静态版本供异步线程使用
-bool ThemeManager::DownloadImageToFileStatic(const std::string& url, const std::string& filePath) {
-    FileLogger::GetInstance().LogInfo("[ASYNC START DOWNLOAD] URL: %s -> %s", url.c_str(), filePath.c_str());
-    
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        FileLogger::GetInstance().LogError("Failed to initialize curl for async image download");
-        return false;
+void ThemeManager::UpdateImageJobs() {
+    DownloadQueue* queue = DownloadQueue::GetInstance();
+    if (!queue) {
+        return;
     }
     
-    FILE* fp = fopen(filePath.c_str(), "wb");
-    if (!fp) {
-        FileLogger::GetInstance().LogError("Failed to open file for async writing: %s", filePath.c_str());
-        curl_easy_cleanup(curl);
-        return false;
+    while (sActiveImageJobs < MAX_ACTIVE_IMAGE_JOBS) {
+        std::shared_ptr<ImageSaveJob> job;
+        {
+            std::lock_guard<std::mutex> lock(sImageJobMutex);
+            if (sImageJobQueue.empty()) {
+                break;
+            }
+            job = std::move(sImageJobQueue.front());
+            sImageJobQueue.pop_front();
+        }
+        sActiveImageJobs++;
+        sImageJobScope.Spawn(RunImageSaveJob(std::move(job)));
     }
     
-    FileDownloadData downloadData = { fp, 0 };
-    
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &downloadData);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-    
-    CURLcode res = curl_easy_perform(curl);
-    
-    FileLogger::GetInstance().LogInfo("[ASYNC DOWNLOAD COMPLETE] Total written: %zu bytes, CURL result: %d", downloadData.totalWritten, res);
-    
-    // 确保数据写入磁盘
-    fflush(fp);
-    fclose(fp);
-    curl_easy_cleanup(curl);
-    
-    if (res != CURLE_OK) {
-        FileLogger::GetInstance().LogError("Failed to async download image: %s", curl_easy_strerror(res));
-        unlink(filePath.c_str());  // 删除失败的文件
-        return false;
+    // 当前界面不一定在处理下载队列, 有任务时由这里执行完成回调
+    if (sActiveImageJobs > 0) {
+        queue->Process();
     }
-    
-    // 验证文件大小
-    struct stat st;
-    if (stat(filePath.c_str(), &st) == 0) {
-        FileLogger::GetInstance().LogInfo("Async image downloaded successfully: %s (Size: %ld bytes)", filePath.c_str(), st.st_size);
-        if (st.st_size == 0) {
-            FileLogger::GetInstance().LogError("Async downloaded file is empty: %s", filePath.c_str());
-            unlink(filePath.c_str());
-            return false;
-        }
-    } else {
-        FileLogger::GetInstance().LogError("Failed to stat async downloaded file: %s", filePath.c_str());
-        return false;
+}
+
+void ThemeManager::ShutdownImageJobs() {
+    size_t abandoned = sActiveImageJobs;
+    {
+        std::lock_guard<std::mutex> lock(sImageJobMutex);
+        abandoned += sImageJobQueue.size();
+        sImageJobQueue.clear();
     }
     
-    return true;
+    // 没下载完的图片放弃, 任务自己删除 .part 文件
+    sImageJobScope.Cancel();
+    
+    if (abandoned > 0) {
+        FileLogger::GetInstance().LogWarning("Abandoned %zu unfinished preview image jobs", abandoned);
+    }
 }
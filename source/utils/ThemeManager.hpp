@@ -2,13 +2,18 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
 #include <functional>
+#include <cstdint>
 #include <SDL2/SDL.h>
+#include "StringPool.hpp"
+#include "ImageLoader.hpp"
 
 // 前向声明
 struct DownloadOperation;
-class ThemeDownloader;
+enum class DownloadPriority;
+struct CatalogPageStream;
 
 // 主题图片数据
 struct ThemeImage {
@@ -18,30 +23,90 @@ struct ThemeImage {
     // 本地缓存
     bool thumbLoaded = false;
     bool hdLoaded = false;
-    SDL_Texture* thumbTexture = nullptr;
-    SDL_Texture* hdTexture = nullptr;
+    // 纹理归 ImageLoader 的缓存所有, 这里只保存句柄: 被淘汰后 Get 返回 nullptr, 重新加载后自动更新
+    ImageLoader::TextureHandle thumbTexture;
+    ImageLoader::TextureHandle hdTexture;
+    bool thumbInAtlas = false;      // 列表用的缩略图已打包进 ImageLoader 的图集
+    uint32_t placeholderColor = 0;  // 缩略图的平均颜色 (0xFFRRGGBB, 0 为还不知道), 保存在目录缓存中, 缩略图到达前占位
+};
+
+// 列表卡片显示的文字, 在解析、读取缓存和增量同步后由 ThemeManager::BuildDisplayStrings 生成,
+// 绘制时不再逐帧清理名称、截断描述和格式化数字
+struct ThemeDisplay {
+    std::string name;         // 清理过特殊字符的名称
+    std::string author;       // "by 作者"
+    std::string description;  // 第一行, 按显示宽度截断
+    std::string downloads;
+    std::string likes;
+};
+
+// 只在详情页、安装和保存元数据时用到的字段 (冷数据), 与列表用到的字段分开存放
+struct ThemeDetails {
+    std::string description;
+    std::string downloadUrl;
+    std::string version = "1.0";    // GraphQL 没有 version 字段
+    
+    ThemeImage launcherScreenshot;  // Launcher 截图
+    ThemeImage waraWaraScreenshot;  // Wara Wara Plaza 截图
+    
+    std::string launcherBgUrl;      // Launcher 背景 URL
+    std::string waraWaraBgUrl;      // Wara Wara 背景 URL
+};
+
+// ThemeDetails 的所有者: 第一次写入时才分配, 复制 Theme 时复制内容 (不共享)
+class ThemeDetailsPtr {
+public:
+    ThemeDetailsPtr() = default;
+    ThemeDetailsPtr(const ThemeDetailsPtr& other)
+        : mDetails(other.mDetails ? std::make_unique<ThemeDetails>(*other.mDetails) : nullptr) {}
+    ThemeDetailsPtr(ThemeDetailsPtr&&) noexcept = default;
+    ThemeDetailsPtr& operator=(const ThemeDetailsPtr& other) {
+        if (this != &other) {
+            mDetails = other.mDetails ? std::make_unique<ThemeDetails>(*other.mDetails) : nullptr;
+        }
+        return *this;
+    }
+    ThemeDetailsPtr& operator=(ThemeDetailsPtr&&) noexcept = default;
+    
+    const ThemeDetails* Get() const { return mDetails.get(); }
+    ThemeDetails& GetOrCreate() {
+        if (!mDetails) {
+            mDetails = std::make_unique<ThemeDetails>();
+        }
+        return *mDetails;
+    }
+    void Reset() { mDetails.reset(); }
+    
+private:
+    std::unique_ptr<ThemeDetails> mDetails;
 };
 
 // 主题数据结构
+// id、作者和标签是驻留字符串: 重复的作者和标签只保存一份, 按 id 比较只比较指针
+// 只保存列表绘制、筛选和增量同步逐个访问的字段, 目录有几千个主题时 std::vector<Theme> 保持紧凑;
+// 描述、下载地址和截图在 ThemeDetails 中, 用 GetDetails / EditDetails 访问
 struct Theme {
-    std::string id;
+    PooledString id;
     std::string name;
-    std::string author;
-    std::string description;
-    std::string downloadUrl;
+    PooledString author;
     int downloads = 0;
     int likes = 0;
-    std::string version;
     std::string updatedAt;
-    std::vector<std::string> tags;
+    std::vector<PooledString> tags;
     
-    // 图片资源
     ThemeImage collagePreview;      // 组合预览图(列表缩略图)
-    ThemeImage launcherScreenshot;  // Launcher 截图
-    ThemeImage waraWaraScreenshot;  // Wara Wara Plaza 截图
     
-    std::string launcherBgUrl;      // Launcher 背景 URL
-    std::string waraWaraBgUrl;      // Wara Wara 背景 URL
+    // 列表查询只包含卡片用到的字段和标签; 下载地址、截图和高清图由 FetchThemeDetails 补全
+    bool detailsLoaded = false;
+    
+    ThemeDisplay display;
+    
+    ThemeDetailsPtr details;
+    
+    // 没有冷数据时返回空的默认值, 不分配
+    const ThemeDetails& GetDetails() const;
+    // 需要写入时调用 (第一次调用时分配)
+    ThemeDetails& EditDetails() { return details.GetOrCreate(); }
 };
 
 // 主题管理器
@@ -57,17 +122,27 @@ public:
     ThemeManager();
     ~ThemeManager();
     
-    // 获取主题列表
+    // 获取主题列表 (分页)
+    // 第一页到达后立即进入 FETCH_SUCCESS, 之后的页在后台继续加载, 直到 BACKGROUND_THEME_LIMIT 个;
+    // 再往后的页由 LoadMoreThemes 按需加载. 后续页在 Update 中追加到列表末尾
     void FetchThemes();
+    void LoadMoreThemes();
+    bool HasMoreThemes() const { return mHasMorePages; }
+    
+    // 按需获取单个主题的详情 (完成后 detailsLoaded 为 true 并写入缓存), 调用者轮询结果
+    // 已在预取的批量请求中时提高那个请求的优先级
+    void FetchThemeDetails(const std::string& id);
+    // 预取窗口中还没有详情的主题, 每 DETAIL_BATCH_SIZE 个合并成一个低优先级请求
+    void PrefetchThemeDetails(const std::vector<std::string>& ids);
+    bool IsFetchingDetails(const std::string& id) const { return mDetailOps.count(id) != 0; }
     
-    // 下载主题
-    void DownloadTheme(const Theme& theme);
-    float GetDownloadProgress() const;
-    int GetDownloadState() const;  // 返回 DownloadState 枚举
-    std::string GetDownloadError() const;
-    std::string GetDownloadedFilePath() const;
-    std::string GetExtractedPath() const;
-    void CancelDownload();
+    // 下载和安装主题由 InstallQueue 进行 (离开界面后继续)
+    // 下载完成后写入 theme_info.json 并登记, 预览图交给后台任务 (可以在任意线程调用)
+    static void SaveThemeMetadata(const Theme& theme, const std::string& themePath);
+    
+    // 根据名称、作者、描述和统计数生成 theme.display (可以在任意线程调用)
+    static constexpr size_t CARD_DESCRIPTION_COLUMNS = 50;
+    static void BuildDisplayStrings(Theme& theme);
     
     // 获取状态
     FetchState GetState() const { return mState; }
@@ -80,18 +155,67 @@ public:
     // 检查是否有缓存数据
     bool HasCachedThemes() const { return !mThemes.empty(); }
     
-    // 强制刷新(清除缓存)
-    void ForceRefresh() {
-        mThemes.clear();
-        FetchThemes();
-    }
+    // 刷新: 已有列表时做增量同步, 否则完整获取
+    void ForceRefresh();
     
     // 缓存管理
-    bool SaveCache();           // 保存缓存到文件
+    bool SaveCache(const DownloadOperation* validators = nullptr); // 在后台线程写入缓存文件
     bool LoadCache();           // 从文件加载缓存
+    static void WaitForCacheWrites();   // 等待后台写入完成
+    static void DeleteCache();          // 删除缓存文件, 下次打开时重新获取整个目录
+    static void ShutdownCacheWriter();  // 写完剩下的缓存并结束写入线程 (程序退出时调用)
+    // 菜单预热: 在后台读取并解析缓存文件, 之后的 LoadCache 在文件没有改变时直接使用结果;
+    // 解析完后把缓存中前 thumbCount 个已有磁盘缓存的缩略图按卡片尺寸低优先级加载进图集 (不访问网络)
+    // 已经在预读或已有预读结果时不做任何事; 在主线程调用
+    static void PrefetchCache(size_t thumbCount, int thumbW, int thumbH);
+    // 内存不足时丢弃还没有使用的预读结果 (打开列表时重新读取), 预读还在进行时不等待; 返回缓存文件的大小
+    static size_t ReleasePrefetchedCatalog();
+    
+    // 热启动快照: 离开列表 (包括退出) 时的视图和第一屏缩略图的像素 (图集可以直接使用), 在目录缓存之后由写入线程保存;
+    // 预读或 LoadCache 读目录时一起读出 (一次顺序读取), 缩略图直接放进图集; 目录缓存改变后快照作废
+    struct WarmView {
+        int sortOrder = 0;            // ThemeCatalogIndex::SortOrder
+        std::string tagFilter;        // 空为不过滤
+        std::string selectedThemeId;
+        int selectedIndex = 0;        // 视图中的位置
+        int scrollRow = 0;            // 最上面的行
+    };
+    // thumbUrls: 保存这些缩略图按卡片尺寸 thumbW x thumbH 的像素缓存 (没有像素缓存的跳过); 在主线程调用
+    static void SaveWarmStart(const WarmView& view, const std::vector<std::string>& thumbUrls, int thumbW, int thumbH);
+    // LoadCache 读到了对应的快照时取出其中的视图 (只返回一次 true)
+    bool TakeWarmView(WarmView& view);
+    
+    // 安装后下载预览图的后台任务 (在主循环中调用, 不依赖当前界面); 退出时放弃未完成的任务
+    static void UpdateImageJobs();
+    static void ShutdownImageJobs();
+    
+    // 预先建立到 API 和 CDN 的连接 (启动后和菜单选中"下载主题"时), 打开下载界面时不用再等握手
+    static void PrewarmConnections();
     bool IsCacheValid() const;  // 检查缓存是否有效
-    void CheckForUpdates();     // 后台检测更新
-    bool HasUpdates() const { return mHasUpdates; }
+    int64_t GetCacheAge() const; // 缓存写入或上次确认后经过的秒数, 没有缓存时为 -1
+    static constexpr int64_t CACHE_VALIDITY_SECONDS = 24 * 60 * 60; // 超过这个时间的缓存先显示, 再在后台同步
+    // 增量同步: 先取整个目录的 uuid / updatedAt 清单, 只获取新增和变化的主题,
+    // 在 Update 中按清单顺序合并 (未变化的主题保留已加载的纹理, 清单中没有的删除)
+    // notify 为 true 时和 FetchThemes 一样报告 FETCH_IN_PROGRESS / FETCH_SUCCESS
+    // 返回 false 表示没有开始 (列表为空或正在完整获取); 已经在同步时返回 true
+    bool SyncThemes(bool notify);
+    // 后台增量同步, 不阻塞调用线程; 完成后在 Update 中调用 onComplete (成功与否, 变化的主题数)
+    // 同步已在进行时 onComplete 挂到这次同步上; 被 FetchThemes 取消时不会调用
+    void CheckForUpdates(std::function<void(bool ok, size_t changes)> onComplete = nullptr);
+    bool HasUpdates() const { return mHasUpdates; } // 有变化没能同步, 需要再刷新
+    bool IsSyncing() const { return mSyncing; }
+    
+    // 列表中主题的位置发生变化 (插入、删除、重新排序) 时递增, 按索引保存主题的界面据此重新定位
+    uint32_t GetListVersion() const { return mListVersion; }
+    // 列表被替换或合并了同步结果 (排序和搜索用到的字段可能变了) 时递增; 只在末尾追加主题时不变
+    uint32_t GetCatalogVersion() const { return mCatalogVersion; }
+    const Theme* FindTheme(const std::string& id) const;
+    Theme* FindTheme(const std::string& id);
+    
+    // 记下缩略图的平均颜色 (列表绘制已加载的缩略图时调用); 颜色在缩略图停止到达
+    // PLACEHOLDER_SAVE_DELAY_MS 之后随目录缓存写入一次, 不为每张缩略图重新序列化整个目录
+    void SetPlaceholderColor(Theme& theme, uint32_t color);
+    static constexpr uint64_t PLACEHOLDER_SAVE_DELAY_MS = 5000;
     
     // 更新(在主循环中调用)
     void Update();
@@ -105,24 +229,53 @@ private:
     FetchState mState = FETCH_IDLE;
     std::string mErrorMessage;
     bool mHasUpdates = false;
-    bool mCheckingUpdates = false;
+    uint32_t mListVersion = 0;
+    uint32_t mCatalogVersion = 0;
+    
+    // 增量同步状态
+    DownloadOperation* mSyncOp = nullptr;
+    bool mSyncing = false;
+    bool mSyncNotify = false;
+    bool mSyncReady = false;                // 数据已全部到达, 等待在 Update 中合并
+    std::vector<Theme> mSyncManifest;       // 服务器上的目录 (只有 uuid / updatedAt / 计数)
+    std::vector<std::string> mSyncChangedIds;
+    std::map<std::string, Theme> mSyncFetched; // 新增和变化的主题的列表字段
+    std::function<void(bool ok, size_t changes)> mSyncCompleteCallback;
+    
+    static constexpr int MANIFEST_PAGE_SIZE = 500;
+    // 每个请求获取的变化主题数和每个预取请求获取详情的主题数按网络档位 (PerfProfile) 决定
     DownloadOperation* mFetchOp = nullptr;  // 异步网络请求操作
-    ThemeDownloader* mDownloader = nullptr; // 主题下载器
-    bool mDownloaderNeedsCleanup = false;   // 标记下载器需要清理
+    std::shared_ptr<CatalogPageStream> mFetchStream; // 正在下载的一页 (传输结束后到 Update 处理完为止)
+    int mNextPage = 1;                      // 下一次请求的页码
+    bool mHasMorePages = false;             // 最后一页还没到达
+    std::vector<Theme> mPendingThemes;      // 已下载但还没合并到 mThemes 的后续页
+    bool mCacheDirty = false;               // 合并了新的页或详情, 还没写入缓存
+    uint64_t mPlaceholderChangedMs = 0;     // 最后一次记下新的占位颜色的时间, 0 表示都已写入缓存
+    std::unique_ptr<WarmView> mWarmView;    // LoadCache 读出的热启动视图, 还没被界面取走
+    std::map<std::string, DownloadOperation*> mDetailOps; // 进行中的详情请求 (按 uuid, 批量请求在每个 uuid 下各登记一次)
+    
+    // 每页主题数 (第一页尽快显示); 缓存的页数按它推算, 所以不随性能档位改变
+    static constexpr int CATALOG_PAGE_SIZE = 30;
+    // 自动连续加载的主题数上限按性能档位 (PerfProfile::GetBackgroundThemeLimit) 决定
     
     // 回调
     std::function<void(float progress, long downloaded, long total)> mProgressCallback;
     std::function<void(FetchState state, const std::string& message)> mStateCallback;
     
     // 内部方法
-    bool ParseThemezerResponse(const std::string& jsonData);
-    std::string FetchUrl(const std::string& url, const std::string& postData = "");
+    void FetchPage(int page);
+    static void CopyDetails(const Theme& from, Theme& to);
+    void CancelSync();
+    void FinishSync(bool ok);
+    void SyncManifestPage(int page);
+    void SyncCollectChanges();
+    void SyncFetchChanged(size_t start);
+    void SendDetailBatch(const std::vector<std::string>& ids, DownloadPriority priority);
+    void ApplySync();
+    std::string BuildThemesQuery(int page) const;
+    void DrainFetchStream();
+    void FinishPage(CatalogPageStream& stream, size_t nodeCount);
     std::string GetCachePath() const;
     std::string SerializeThemes() const;
-    bool DeserializeThemes(const std::string& data);
-    void SaveThemeMetadata(const Theme& theme, const std::string& themePath);
-    bool DownloadImageToFile(const std::string& url, const std::string& filePath);
-    
-    // 静态方法供异步线程使用
-    static bool DownloadImageToFileStatic(const std::string& url, const std::string& filePath);
+    static bool DeserializeThemes(const std::string& data, std::vector<Theme>& themes);
 };
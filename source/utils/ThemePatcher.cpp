@@ -1,24 +1,38 @@
 #include "ThemePatcher.hpp"
 #include "SimpleJsonParser.hpp"
 #include "FileLogger.hpp"
+#include "AllocTracker.hpp"
 #include "logger.h"
+#include "MenuSourceCache.hpp"
 #include "hips.hpp"
-#include "minizip/unzip.h"
-#include <sysapp/title.h>
+#include "FileIO.hpp"
+#include "TrashBin.hpp"
+#include "ThemeRegistry.hpp"
+#include "JobSystem.hpp"
+#include "PatchStore.hpp"
+#include "Trace.hpp"
+#include "ZipIndex.hpp"
+#include "PerfProfile.hpp"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <unistd.h>
 #include <fstream>
 #include <cstring>
-
-#define WII_U_MENU_JPN_TID 0x0005001010040000ULL
-#define WII_U_MENU_USA_TID 0x0005001010040100ULL
-#define WII_U_MENU_EUR_TID 0x0005001010040200ULL
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <condition_variable>
 
 #define THEMES_ROOT "fs:/vol/external01/wiiu/themes"
 #define CACHE_ROOT "fs:/vol/external01/UTheme/cache"
+#define UTHEME_ROOT "fs:/vol/external01/UTheme"
 #define INSTALLED_THEMES_ROOT "fs:/vol/external01/UTheme/installed"
+#define CURRENT_THEME_FILE "fs:/vol/external01/UTheme/current.json"
+
+// 同时应用补丁的线程数上限和它们的缓冲区总预算
+#define MAX_PATCH_THREADS 3
+#define PATCH_MEMORY_BUDGET (4 * 1024 * 1024)
 
 ThemePatcher::ThemePatcher() {
 }
@@ -31,47 +45,12 @@ void ThemePatcher::SetProgressCallback(std::function<void(float progress, const
 }
 
 SystemRegion ThemePatcher::GetSystemRegion() {
-    uint64_t menuTitleID = _SYSGetSystemApplicationTitleId(SYSTEM_APP_ID_WII_U_MENU);
-    
-    SystemRegion region = REGION_USA; // 默认美版
-    
-    switch (menuTitleID) {
-        case WII_U_MENU_JPN_TID:
-            region = REGION_JPN;
-            break;
-        case WII_U_MENU_USA_TID:
-            region = REGION_USA;
-            break;
-        case WII_U_MENU_EUR_TID:
-            region = REGION_EUR;
-            break;
-    }
-    
-    DEBUG_FUNCTION_LINE("System region: %d (TitleID: %016llx)", region, menuTitleID);
-    return region;
+    return SystemInfo::GetRegion();
 }
 
 std::pair<std::string, std::string> ThemePatcher::GetMenuPaths() {
-    uint64_t menuTitleID = _SYSGetSystemApplicationTitleId(SYSTEM_APP_ID_WII_U_MENU);
-    
-    // Title ID 格式: 0x0005001010040X00
-    // 高32位: 0x00050010 (父目录)
-    // 低32位: 0x10040X00 (子目录)
-    uint32_t menuIDParentDir = (uint32_t)(menuTitleID >> 32);
-    uint32_t menuIDChildDir = (uint32_t)menuTitleID;
-    
-    char splitMenuID[18];
-    snprintf(splitMenuID, sizeof(splitMenuID), "%08x/%08x", menuIDParentDir, menuIDChildDir);
-    
-    // 使用 storage_mlc_UTheme 设备名（与 BackupManager 一致）
-    std::string menuContentPath = "storage_mlc_UTheme:/sys/title/" + std::string(splitMenuID) + "/content/";
-    
-    DEBUG_FUNCTION_LINE("Menu Title ID: %016llx", menuTitleID);
-    DEBUG_FUNCTION_LINE("Menu path components: %08x / %08x", menuIDParentDir, menuIDChildDir);
-    DEBUG_FUNCTION_LINE("Menu content path: %s", menuContentPath.c_str());
-    
     // 第二个参数不再使用，但为了保持接口兼容性返回空字符串
-    return {menuContentPath, ""};
+    return {SystemInfo::GetMenuContentPath(), ""};
 }
 
 bool ThemePatcher::CreateDirectoryRecursive(const std::string& path) {
@@ -141,7 +120,7 @@ void ThemePatcher::ScanForBPSFiles(const std::string& basePath, const std::strin
                         relPath = relPath.substr(1);
                     }
                     bpsFiles.push_back(relPath);
-                    FileLogger::GetInstance().LogInfo("Found BPS file: %s", relPath.c_str());
+                    ULOG_INFO(PATCH, "Found BPS file: %s", relPath.c_str());
                 }
             }
         }
@@ -188,11 +167,12 @@ bool ThemePatcher::ReadThemeMetadata(const std::string& themePath, ThemeMetadata
         return false;
     }
     
-    FileLogger::GetInstance().LogInfo("Read metadata.json content (first 200 chars): %.200s", jsonContent.c_str());
+    ULOG_DEBUG(PATCH, "Read metadata.json content (first 200 chars): %.200s", jsonContent.c_str());
     
     // 解析 JSON
     try {
-        JsonValue root = SimpleJsonParser::Parse(jsonContent);
+        JsonDocument doc = SimpleJsonParser::Parse(jsonContent);
+        const JsonValue& root = doc.Root();
         
         FileLogger::GetInstance().LogInfo("JSON parsed successfully");
         
@@ -237,94 +217,663 @@ bool ThemePatcher::ReadThemeMetadata(const std::string& themePath, ThemeMetadata
     }
 }
 
-bool ThemePatcher::CreateCacheFile(const std::string& sourcePath, const std::string& cachePath) {
-    FileLogger::GetInstance().LogInfo("Creating cache: %s -> %s", sourcePath.c_str(), cachePath.c_str());
-    
-    // 创建缓存目录
-    std::string cacheDir = cachePath.substr(0, cachePath.find_last_of('/'));
-    if (!CreateDirectoryRecursive(cacheDir)) {
+// 读取 BPS 文件末尾记录的源文件、目标和补丁的 CRC32
+static bool ReadBPSChecksums(const std::string& patchPath, uint32_t& sourceCrc, uint32_t& targetCrc, uint32_t& patchCrc) {
+    FileIO file;
+    if (!file.Open(patchPath, FileIO::MODE_READ)) {
         return false;
     }
-    
-    // 打开源文件
-    FILE* sourceFile = fopen(sourcePath.c_str(), "rb");
-    if (!sourceFile) {
-        FileLogger::GetInstance().LogError("Failed to open source file: %s", sourcePath.c_str());
+    uint8_t trailer[12];
+    uint64_t size = file.Size();
+    if (size < sizeof(trailer) || file.ReadAt(size - sizeof(trailer), trailer, sizeof(trailer)) != sizeof(trailer)) {
         return false;
     }
+    auto le32 = [](const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    };
+    sourceCrc = le32(trailer);
+    targetCrc = le32(trailer + 4);
+    patchCrc = le32(trailer + 8);
+    return true;
+}
+
+// 安装记录中补丁链的各层用 '|' 连接 (只有一个补丁时就是它本身)
+static std::vector<std::string> SplitPatchChain(const std::string& patch) {
+    std::vector<std::string> layers;
+    size_t start = 0;
+    while (true) {
+        size_t bar = patch.find('|', start);
+        layers.push_back(patch.substr(start, bar - start));
+        if (bar == std::string::npos) {
+            return layers;
+        }
+        start = bar + 1;
+    }
+}
+
+// 补丁链记录的校验和: 源文件来自第一层, 目标来自最后一层, 补丁是各层的 ChainCrc
+// 每一层记录的源必须是上一层记录的目标, 否则这几个补丁接不起来
+static bool ReadChainChecksums(const std::vector<std::string>& patchPaths, uint32_t& sourceCrc, uint32_t& targetCrc,
+                               uint32_t& patchCrc) {
+    std::vector<uint32_t> patchCrcs;
+    for (size_t i = 0; i < patchPaths.size(); i++) {
+        uint32_t layerSource, layerTarget, layerPatch;
+        if (!ReadBPSChecksums(patchPaths[i], layerSource, layerTarget, layerPatch) ||
+            (i > 0 && layerSource != targetCrc)) {
+            return false;
+        }
+        if (i == 0) {
+            sourceCrc = layerSource;
+        }
+        targetCrc = layerTarget;
+        patchCrcs.push_back(layerPatch);
+    }
+    patchCrc = BpsStreamPatcher::ChainCrc(patchCrcs);
+    return !patchCrcs.empty();
+}
+
+// 压缩包中的一个 .bps 条目, 边解压边交给 BpsStreamPatcher; 每个任务自己打开压缩包, 可以并行
+// 中央目录只在 ZipIndex::Get 第一次遇到这个压缩包时解析, 之后的条目按索引直接定位
+class ZipPatchStream : public BpsStreamPatcher::PatchStream {
+public:
+    bool Open(const std::string& archivePath, const std::string& entryName) {
+        mIndex = ZipIndex::Get(archivePath);
+        const ZipIndex::Entry* entry = mIndex ? mIndex->Find(entryName) : nullptr;
+        return entry && mReader.Open(*mIndex, *entry);
+    }
     
-    // 获取文件大小
-    fseek(sourceFile, 0, SEEK_END);
-    size_t sourceSize = ftell(sourceFile);
-    rewind(sourceFile);
+    uint64_t Size() override { return mReader.Size(); }
     
-    // 读取数据
-    std::vector<uint8_t> buffer(sourceSize);
-    size_t bytesRead = fread(buffer.data(), 1, sourceSize, sourceFile);
-    fclose(sourceFile);
+    size_t Read(void* dst, size_t n) override {
+        return mReader.Read(dst, n);
+    }
     
-    if (bytesRead != sourceSize) {
-        FileLogger::GetInstance().LogError("Failed to read source file completely");
+private:
+    std::shared_ptr<const ZipIndex> mIndex;  // 条目属于这个索引, 读完之前保持有效
+    ZipIndex::Reader mReader;
+};
+
+// 压缩包中的 .bps 条目 (条目名 -> 条目的 CRC32), 打不开时返回 false
+static bool ListArchivePatches(const std::string& archivePath, std::vector<std::string>& names,
+                               std::map<std::string, uint32_t>& entryCrcs) {
+    std::shared_ptr<const ZipIndex> index = ZipIndex::Get(archivePath);
+    if (!index) {
         return false;
     }
-    
-    // 写入缓存
-    FILE* cacheFile = fopen(cachePath.c_str(), "wb");
-    if (!cacheFile) {
-        FileLogger::GetInstance().LogError("Failed to create cache file: %s", cachePath.c_str());
+    for (const ZipIndex::Entry& entry : index->GetEntries()) {
+        const std::string& name = entry.name;
+        if (name.length() > 4 && name.substr(name.length() - 4) == ".bps" &&
+            name.compare(0, strlen("patched/"), "patched/") != 0) {
+            names.push_back(name);
+            entryCrcs[name] = entry.crc;
+        }
+    }
+    return true;
+}
+
+// ReadBPSChecksums 的压缩包版本: 条目要解压到末尾才能读到
+static bool ReadArchiveBPSChecksums(const std::string& archivePath, const std::string& entryName,
+                                    uint32_t& sourceCrc, uint32_t& targetCrc, uint32_t& patchCrc) {
+    ZipPatchStream stream;
+    if (!stream.Open(archivePath, entryName)) {
         return false;
     }
-    
-    size_t bytesWritten = fwrite(buffer.data(), 1, sourceSize, cacheFile);
-    fclose(cacheFile);
-    
-    if (bytesWritten != sourceSize) {
-        FileLogger::GetInstance().LogError("Failed to write cache file completely");
+    uint8_t trailer[12];
+    size_t kept = 0;
+    std::vector<uint8_t> buffer(16 * 1024);
+    while (true) {
+        size_t got = stream.Read(buffer.data(), buffer.size());
+        if (got == 0) {
+            break;
+        }
+        // 只保留最后 12 个字节
+        if (got >= sizeof(trailer)) {
+            memcpy(trailer, buffer.data() + got - sizeof(trailer), sizeof(trailer));
+            kept = sizeof(trailer);
+        } else {
+            size_t keep = std::min(kept, sizeof(trailer) - got);
+            memmove(trailer, trailer + kept - keep, keep);
+            memcpy(trailer + keep, buffer.data(), got);
+            kept = keep + got;
+        }
+    }
+    if (kept < sizeof(trailer)) {
         return false;
     }
-    
-    FileLogger::GetInstance().LogInfo("Cache created successfully (%zu bytes)", sourceSize);
+    auto le32 = [](const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    };
+    sourceCrc = le32(trailer);
+    targetCrc = le32(trailer + 4);
+    patchCrc = le32(trailer + 8);
     return true;
 }
 
-bool ThemePatcher::ApplyBPSPatch(const std::vector<uint8_t>& sourceData, 
-                                 const std::vector<uint8_t>& patchData,
-                                 std::vector<uint8_t>& outputData) {
-    // 使用 libhips 应用 BPS 补丁
-    auto [result, status] = Hips::patchBPS(
-        sourceData.data(), sourceData.size(),
-        patchData.data(), patchData.size()
-    );
-    
-    if (status != Hips::Result::Success) {
-        const char* errorMsg = "Unknown error";
-        switch (status) {
-            case Hips::Result::InvalidPatch: errorMsg = "Invalid patch"; break;
-            case Hips::Result::SizeMismatch: errorMsg = "Size mismatch"; break;
-            case Hips::Result::ChecksumMismatch: errorMsg = "Checksum mismatch"; break;
-            default: break;
-        }
-        FileLogger::GetInstance().LogError("BPS patching failed: %s", errorMsg);
+// 同一个文件的几个补丁如果接不起来 (后一层的源不是前一层的目标), 它们是各自从原始文件开始的备选补丁:
+// 和补丁链之前的做法一样只用最后一个, 不让整个文件失败
+// 补丁路径为 themePath 下的相对路径, 或 archivePath 不为空时压缩包中的条目名
+static void ResolveUnlinkedChains(std::vector<std::vector<std::string>>& chains, const std::string& themePath,
+                                  const std::string& archivePath) {
+    for (std::vector<std::string>& chain : chains) {
+        if (chain.size() < 2) {
+            continue;
+        }
+        bool linked = true;
+        uint32_t previousTarget = 0;
+        for (size_t i = 0; i < chain.size() && linked; i++) {
+            uint32_t sourceCrc, targetCrc, patchCrc;
+            bool read = archivePath.empty() ?
+                ReadBPSChecksums(themePath + "/" + chain[i], sourceCrc, targetCrc, patchCrc) :
+                ReadArchiveBPSChecksums(archivePath, chain[i], sourceCrc, targetCrc, patchCrc);
+            // 读不到的补丁留给应用时报错
+            if (!read) {
+                break;
+            }
+            linked = (i == 0 || sourceCrc == previousTarget);
+            previousTarget = targetCrc;
+        }
+        if (!linked) {
+            FileLogger::GetInstance().LogWarning("%zu patches for the same file do not chain, using only %s",
+                                                 chain.size(), chain.back().c_str());
+            chain.erase(chain.begin(), chain.end() - 1);
+        }
+    }
+}
+
+// 补丁头部记录的目标大小 (补丁文件或压缩包条目只读开头几十个字节)
+static bool ReadBPSTargetSize(const std::string& patchPath, const std::string& archivePath, uint64_t& targetSize) {
+    uint8_t header[32];
+    size_t got = 0;
+    if (archivePath.empty()) {
+        FileIO file;
+        if (!file.Open(patchPath, FileIO::MODE_READ)) {
+            return false;
+        }
+        got = file.Read(header, sizeof(header));
+    } else {
+        ZipPatchStream stream;
+        if (!stream.Open(archivePath, patchPath)) {
+            return false;
+        }
+        got = stream.Read(header, sizeof(header));
+    }
+    if (got < 4 || memcmp(header, "BPS1", 4) != 0) {
         return false;
     }
+    // "BPS1" 之后依次是源文件大小和目标大小 (BPS 的变长数字)
+    size_t pos = 4;
+    uint64_t values[2];
+    for (uint64_t& value : values) {
+        value = 0;
+        uint64_t shift = 1;
+        while (true) {
+            if (pos >= got || shift > (1ull << 56)) {
+                return false;
+            }
+            uint8_t x = header[pos++];
+            value += (x & 0x7f) * shift;
+            if (x & 0x80) {
+                break;
+            }
+            shift <<= 7;
+            value += shift;
+        }
+    }
+    targetSize = values[1];
+    return true;
+}
+
+std::map<std::string, ThemePatcher::PatchRecord> ThemePatcher::LoadPatchRecords(const std::string& installedInfoPath,
+                                                                                std::string* archivePath) {
+    std::map<std::string, PatchRecord> records;
+    if (archivePath) {
+        archivePath->clear();
+    }
+    
+    FILE* file = fopen(installedInfoPath.c_str(), "r");
+    if (!file) {
+        return records;
+    }
+    std::string content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, n);
+    }
+    fclose(file);
     
-    outputData = std::move(result);
+    try {
+        JsonDocument doc = SimpleJsonParser::Parse(content);
+        const JsonValue& root = doc.Root();
+        if (archivePath && root.has("archivePath")) {
+            *archivePath = std::string(root["archivePath"].asString());
+        }
+        if (!root.has("patches")) {
+            return records;  // 旧版本的安装记录
+        }
+        const JsonValue& patches = root["patches"];
+        for (size_t i = 0; i < patches.size(); i++) {
+            const JsonValue& item = patches[i];
+            PatchRecord record;
+            record.output = std::string(item["output"].asString());
+            record.patch = std::string(item["patch"].asString());
+            record.sourceCrc = (uint32_t)strtoul(std::string(item["sourceCrc"].asString()).c_str(), nullptr, 16);
+            record.patchCrc = (uint32_t)strtoul(std::string(item["patchCrc"].asString()).c_str(), nullptr, 16);
+            record.targetCrc = (uint32_t)strtoul(std::string(item["targetCrc"].asString()).c_str(), nullptr, 16);
+            record.size = (uint64_t)item["size"].asDouble();
+            if (item.has("entryCrc")) {
+                record.entryCrc = (uint32_t)strtoul(std::string(item["entryCrc"].asString()).c_str(), nullptr, 16);
+            }
+            if (!record.output.empty()) {
+                records[record.output] = record;
+            }
+        }
+    } catch (...) {
+        FileLogger::GetInstance().LogWarning("Failed to parse install record: %s", installedInfoPath.c_str());
+        records.clear();
+    }
+    return records;
+}
+
+std::string ThemePatcher::GetJournalPath(const std::string& themeID) {
+    return std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".journal";
+}
+
+std::map<std::string, ThemePatcher::PatchRecord> ThemePatcher::LoadJournal(const std::string& journalPath) {
+    std::map<std::string, PatchRecord> records;
+    FILE* file = fopen(journalPath.c_str(), "r");
+    if (!file) {
+        return records;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        // sourceCrc patchCrc targetCrc size entryCrc output<TAB>patch
+        // 断电时最后一行可能不完整: 没有换行或字段不全的行丢弃
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            break;
+        }
+        line[len - 1] = '\0';
+        unsigned sourceCrc = 0, patchCrc = 0, targetCrc = 0, entryCrc = 0;
+        unsigned long long size = 0;
+        int consumed = 0;
+        if (sscanf(line, "%8x %8x %8x %llu %8x %n", &sourceCrc, &patchCrc, &targetCrc, &size, &entryCrc, &consumed) != 5 ||
+            consumed == 0) {
+            continue;
+        }
+        char* paths = line + consumed;
+        char* tab = strchr(paths, '\t');
+        if (!tab || tab == paths || tab[1] == '\0') {
+            continue;
+        }
+        *tab = '\0';
+        PatchRecord record;
+        record.output = paths;
+        record.patch = tab + 1;
+        record.sourceCrc = sourceCrc;
+        record.patchCrc = patchCrc;
+        record.targetCrc = targetCrc;
+        record.size = size;
+        record.entryCrc = entryCrc;
+        records[record.output] = record;
+    }
+    fclose(file);
+    return records;
+}
+
+bool ThemePatcher::AppendJournal(FILE* journal, const PatchRecord& record) {
+    // 输出已经改名提交, 这一行写到 SD 卡之后中断也不会重新生成
+    return fprintf(journal, "%08x %08x %08x %llu %08x %s\t%s\n", (unsigned)record.sourceCrc, (unsigned)record.patchCrc,
+                   (unsigned)record.targetCrc, (unsigned long long)record.size, (unsigned)record.entryCrc,
+                   record.output.c_str(), record.patch.c_str()) > 0 &&
+           fflush(journal) == 0 && fsync(fileno(journal)) == 0;
+}
+
+bool ThemePatcher::ApplyBPSPatch(const std::string& sourcePath,
+                                 const PatchJob& job,
+                                 bool verifySource,
+                                 BpsStreamPatcher::Info& info) {
+    BpsStreamPatcher::Result result;
+    if (!job.chainPaths.empty()) {
+        result = ApplyPatchChain(sourcePath, job, verifySource, info);
+    } else if (job.archivePath.empty()) {
+        result = BpsStreamPatcher::Apply(sourcePath, job.patchPath, job.outputPath, verifySource, &info, job.compiledPath);
+    } else {
+        ZipPatchStream patch;
+        if (!patch.Open(job.archivePath, job.patchPath)) {
+            FileLogger::GetInstance().LogError("Failed to open %s in %s", job.patchPath.c_str(), job.archivePath.c_str());
+            return false;
+        }
+        result = BpsStreamPatcher::ApplyStream(sourcePath, patch, job.outputPath, verifySource, &info, job.compiledPath);
+    }
+    if (result != BpsStreamPatcher::RESULT_SUCCESS) {
+        FileLogger::GetInstance().LogError("BPS patching failed: %s", BpsStreamPatcher::ResultToString(result));
+        return false;
+    }
     return true;
 }
 
+BpsStreamPatcher::Result ThemePatcher::ApplyPatchChain(const std::string& sourcePath, const PatchJob& job,
+                                                       bool verifySource, BpsStreamPatcher::Info& info) {
+    std::vector<std::string> layers = job.chainPaths;
+    layers.insert(layers.begin(), job.patchPath);
+    if (job.archivePath.empty()) {
+        return BpsStreamPatcher::ApplyChain(sourcePath, layers, job.outputPath, verifySource, &info);
+    }
+    std::vector<std::unique_ptr<ZipPatchStream>> streams;
+    std::vector<BpsStreamPatcher::PatchStream*> patches;
+    for (const std::string& layer : layers) {
+        streams.emplace_back(new ZipPatchStream());
+        if (!streams.back()->Open(job.archivePath, layer)) {
+            FileLogger::GetInstance().LogError("Failed to open %s in %s", layer.c_str(), job.archivePath.c_str());
+            return BpsStreamPatcher::RESULT_OPEN_FAILED;
+        }
+        patches.push_back(streams.back().get());
+    }
+    return BpsStreamPatcher::ApplyChainStreams(sourcePath, patches, job.outputPath, verifySource, &info);
+}
+
+bool ThemePatcher::GetPatchChecksums(const PatchJob& job, uint32_t& sourceCrc, uint32_t& targetCrc, uint32_t& patchCrc) {
+    if (job.archivePath.empty()) {
+        std::vector<std::string> layers = job.chainPaths;
+        layers.insert(layers.begin(), job.patchPath);
+        return ReadChainChecksums(layers, sourceCrc, targetCrc, patchCrc);
+    }
+    if (job.havePrevious && job.previous.entryCrc != 0 && job.previous.entryCrc == job.record.entryCrc) {
+        sourceCrc = job.previous.sourceCrc;
+        targetCrc = job.previous.targetCrc;
+        patchCrc = job.previous.patchCrc;
+        return true;
+    }
+    return false;
+}
+
+void ThemePatcher::RunPatchJob(PatchJob& job, MenuSourceCache& sourceCache) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_PATCH);
+    Trace::Span span("patch", "patch", job.fileName);
+    // 从 SD 卡上的副本读取原始文件; 副本的 CRC32 已知时不必为了校验读完整个文件, 只比较记录的值
+    uint32_t sourceCrc = 0;
+    bool sourceCrcKnown = false;
+    std::string readPath = sourceCache.Acquire(job.sourcePath, sourceCrc, sourceCrcKnown);
+    
+    // 重新安装: 补丁和系统文件都和上次相同, 上次的输出还在, 就直接沿用
+    uint32_t recordedSource = 0, recordedTarget = 0, recordedPatch = 0;
+    if (job.havePrevious && sourceCrcKnown &&
+        GetPatchChecksums(job, recordedSource, recordedTarget, recordedPatch) &&
+        recordedPatch == job.previous.patchCrc && recordedSource == job.previous.sourceCrc &&
+        recordedSource == sourceCrc && recordedTarget == job.previous.targetCrc) {
+        struct stat st;
+        if (stat(job.outputPath.c_str(), &st) == 0 && (uint64_t)st.st_size == job.previous.size) {
+            ULOG_INFO(PATCH, "Unchanged since last install, keeping: %s", job.fileName.c_str());
+            job.record.sourceCrc = recordedSource;
+            job.record.patchCrc = recordedPatch;
+            job.record.targetCrc = recordedTarget;
+            job.record.size = job.previous.size;
+            job.outputSize = job.previous.size;
+            job.success = true;
+            job.reused = true;
+            return;
+        }
+    }
+    
+    // 同样的补丁和源文件以前编译过操作列表: 直接重放, 不再解析补丁
+    BpsStreamPatcher::Info info;
+    BpsStreamPatcher::Info compiled;
+    bool replayed = false;
+    if (sourceCrcKnown && BpsStreamPatcher::ReadCompiledInfo(job.compiledPath, compiled) &&
+        GetPatchChecksums(job, recordedSource, recordedTarget, recordedPatch) &&
+        compiled.patchCrc == recordedPatch && compiled.targetCrc == recordedTarget &&
+        compiled.sourceCrc == recordedSource && compiled.sourceCrc == sourceCrc) {
+        BpsStreamPatcher::Result result = BpsStreamPatcher::ApplyCompiled(readPath, job.compiledPath, job.outputPath, &info);
+        replayed = (result == BpsStreamPatcher::RESULT_SUCCESS);
+        if (!replayed) {
+            FileLogger::GetInstance().LogWarning("Compiled patch for %s failed (%s), applying the BPS patch",
+                job.fileName.c_str(), BpsStreamPatcher::ResultToString(result));
+            remove(job.compiledPath.c_str());
+        }
+    }
+    
+    if (replayed) {
+        job.success = true;
+    } else {
+        job.success = ApplyBPSPatch(readPath, job, !sourceCrcKnown, info);
+        if (job.success && sourceCrcKnown && info.sourceCrc != sourceCrc) {
+            FileLogger::GetInstance().LogError("Source file %s does not match the patch (crc %08x, expected %08x)",
+                job.fileName.c_str(), (unsigned)sourceCrc, (unsigned)info.sourceCrc);
+            remove(job.outputPath.c_str());
+            remove(job.compiledPath.c_str());
+            job.success = false;
+        }
+    }
+    job.outputSize = info.outputSize;
+    job.record.sourceCrc = info.sourceCrc;
+    job.record.patchCrc = info.patchCrc;
+    job.record.targetCrc = info.targetCrc;
+    job.record.size = info.outputSize;
+    if (job.success) {
+        ULOG_INFO(PATCH, "Patched successfully: %s (%llu bytes%s)", job.fileName.c_str(),
+            (unsigned long long)job.outputSize, replayed ? ", compiled" : "");
+    } else {
+        // 不留下上次安装的旧输出, 以免和这次的其它文件混用
+        FileLogger::GetInstance().LogError("Failed to apply patch: %s", job.fileName.c_str());
+        remove(job.outputPath.c_str());
+    }
+}
+
+int ThemePatcher::ApplyPatchJobs(std::vector<PatchJob>& jobs, MenuSourceCache& sourceCache, FILE* journal) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_PATCH);
+    if (jobs.empty()) {
+        return 0;
+    }
+    JobSystem::HeavyWorkScope heavyWork;
+    
+    // 并行数: 不超过任务线程数和补丁数, 所有任务的缓冲区加起来不超过内存预算
+    size_t byBudget = std::max<size_t>(1, PATCH_MEMORY_BUDGET / BpsStreamPatcher::WORKING_SET);
+    size_t threadCount = std::min<size_t>({(size_t)JobSystem::GetWorkerCount(), (size_t)MAX_PATCH_THREADS, byBudget, jobs.size()});
+    FileLogger::GetInstance().LogInfo("Applying %zu patches on %zu thread(s)", jobs.size(), threadCount);
+    
+    std::mutex mutex;
+    std::condition_variable finishedCv;
+    size_t nextJob = 0;
+    size_t finished = 0;
+    
+    auto worker = [&]() {
+        while (true) {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (nextJob >= jobs.size()) {
+                    return;
+                }
+                index = nextJob++;
+            }
+            
+            PatchJob& job = jobs[index];
+            ULOG_INFO(PATCH, "Patching [%zu/%zu]: %s", index + 1, jobs.size(), job.fileName.c_str());
+            RunPatchJob(job, sourceCache);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // 沿用的输出已经在上次的记录里
+                if (journal && job.success && !job.reused && !AppendJournal(journal, job.record)) {
+                    FileLogger::GetInstance().LogWarning("Failed to write install journal for %s", job.fileName.c_str());
+                }
+                finished++;
+            }
+            finishedCv.notify_one();
+        }
+    };
+    
+    // 在共享的任务线程上运行, 调用线程只负责报告进度
+    std::vector<JobHandle> workers;
+    for (size_t t = 0; t < threadCount; t++) {
+        workers.push_back(JobSystem::Submit([&worker](const CancelToken&) { worker(); }));
+    }
+    
+    // 进度回调只在调用线程上执行, 每完成一个补丁报告一次
+    size_t reported = 0;
+    while (reported < jobs.size()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finishedCv.wait(lock, [&]() { return finished > reported; });
+            reported = finished;
+        }
+        if (mProgressCallback) {
+            float progress = (float)reported / jobs.size();
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Applying patch %zu/%zu", reported, jobs.size());
+            mProgressCallback(progress, msg);
+        }
+    }
+    
+    for (auto& handle : workers) {
+        handle.Wait();
+    }
+    
+    int patchedCount = 0;
+    int reusedCount = 0;
+    for (const PatchJob& job : jobs) {
+        if (job.success) {
+            patchedCount++;
+        }
+        if (job.reused) {
+            reusedCount++;
+        }
+    }
+    if (reusedCount > 0) {
+        FileLogger::GetInstance().LogInfo("%d of %zu outputs unchanged since last install", reusedCount, jobs.size());
+    }
+    return patchedCount;
+}
+
+std::string ThemePatcher::GetSourceCacheDir() {
+    // 按 title ID 分目录, 系统更新后自动重建
+    std::string sourceCacheDir = std::string(CACHE_ROOT) + "/menu/" + SystemInfo::GetMenuTitleDir() + "/";
+    CreateDirectoryRecursive(sourceCacheDir.substr(0, sourceCacheDir.length() - 1));
+    return sourceCacheDir;
+}
+
+std::vector<std::vector<std::string>> ThemePatcher::GroupPatchChains(const std::vector<std::string>& bpsFiles,
+                                                                     const std::string& menuContentPath) {
+    // 修补同一个文件的补丁组成补丁链 (例如基础主题加上附加包或修正), 按目录深度再按路径排序:
+    // 浅的先应用, 后一个补丁的源是前一个的目标; 一次生成最后的结果, 不写出中间文件
+    std::vector<std::vector<std::string>> chains;
+    std::map<std::string, size_t> chainIndex;
+    for (const std::string& bpsRelPath : bpsFiles) {
+        std::string originalFilePath;
+        std::string originalFileName;
+        ResolveOriginalFile(bpsRelPath, menuContentPath, originalFilePath, originalFileName);
+        auto inserted = chainIndex.emplace(originalFileName, chains.size());
+        if (inserted.second) {
+            chains.emplace_back();
+        }
+        chains[inserted.first->second].push_back(bpsRelPath);
+    }
+    for (std::vector<std::string>& chain : chains) {
+        std::sort(chain.begin(), chain.end(), [](const std::string& a, const std::string& b) {
+            size_t depthA = std::count(a.begin(), a.end(), '/');
+            size_t depthB = std::count(b.begin(), b.end(), '/');
+            return depthA != depthB ? depthA < depthB : a < b;
+        });
+    }
+    return chains;
+}
+
+void ThemePatcher::ResolveOriginalFile(const std::string& bpsRelPath, const std::string& menuContentPath,
+                                       std::string& originalFilePath, std::string& originalFileName) {
+    // BPS 文件名就是目标文件名（不含扩展名）
+    // 例如: Men.bps -> 修补 Common/Package/Men.pack
+    //       Men2.bps -> 修补 Common/Package/Men2.pack
+    //       cafe_barista_men.bps -> 修补 Common/Sound/Men/cafe_barista_men (音频文件)
+    // 先获取纯文件名（去掉路径和 .bps 后缀）
+    std::string bpsFileName = bpsRelPath;
+    size_t lastSlash = bpsFileName.find_last_of('/');
+    if (lastSlash != std::string::npos) {
+        bpsFileName = bpsFileName.substr(lastSlash + 1);
+    }
+    
+    // 移除 .bps 后缀得到目标文件名（不含扩展名）
+    std::string targetBaseName = bpsFileName.substr(0, bpsFileName.length() - 4);
+    
+    // 判断是否是音频文件(cafe_barista_men 等)
+    bool isAudioFile = (targetBaseName.find("cafe_barista") != std::string::npos);
+    
+    if (isAudioFile) {
+        // 音频文件在 Common/Sound/Men 目录,扩展名为 .bfsar
+        originalFileName = targetBaseName + ".bfsar";
+        originalFilePath = menuContentPath + "Common/Sound/Men/" + originalFileName;
+        FileLogger::GetInstance().LogInfo("Audio file detected: %s", originalFileName.c_str());
+    } else {
+        // 系统菜单界面文件都是 .pack 格式,在 Common/Package/ 下
+        originalFileName = targetBaseName + ".pack";
+        originalFilePath = menuContentPath + "Common/Package/" + originalFileName;
+    }
+}
+
 bool ThemePatcher::InstallTheme(const std::string& themePath, 
                                 const std::string& themeID,
                                 const std::string& themeName, 
                                 const std::string& themeAuthor) {
     FileLogger::GetInstance().LogInfo("Installing theme: %s from path: %s", themeName.c_str(), themePath.c_str());
     
+    // themePath 现在是解压后的文件夹路径：wiiu/themes/主题名/
+    // 补丁文件在这个文件夹里，修补后的文件输出到 patched/ 子目录
+    std::vector<std::string> bpsFiles;
+    ScanForBPSFiles(themePath, themePath, bpsFiles);
+    
+    if (bpsFiles.empty()) {
+        // 直接从压缩包安装的主题, 补丁只在压缩包里
+        std::string archivePath;
+        LoadPatchRecords(std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json", &archivePath);
+        if (!archivePath.empty()) {
+            return InstallThemeFromArchive(archivePath, themePath, themeID, themeName, themeAuthor);
+        }
+        FileLogger::GetInstance().LogError("No BPS patch files found in theme folder");
+        return false;
+    }
+    
+    return InstallPatches(themePath, "", bpsFiles, std::map<std::string, uint32_t>(), themeID, themeName, themeAuthor);
+}
+
+bool ThemePatcher::InstallThemeFromArchive(const std::string& archivePath,
+                                           const std::string& themePath,
+                                           const std::string& themeID,
+                                           const std::string& themeName,
+                                           const std::string& themeAuthor) {
+    FileLogger::GetInstance().LogInfo("Installing theme: %s from archive: %s", themeName.c_str(), archivePath.c_str());
+    
+    std::vector<std::string> bpsFiles;
+    std::map<std::string, uint32_t> entryCrcs;
+    if (!ListArchivePatches(archivePath, bpsFiles, entryCrcs)) {
+        FileLogger::GetInstance().LogError("Failed to open theme archive: %s", archivePath.c_str());
+        return false;
+    }
+    if (bpsFiles.empty()) {
+        FileLogger::GetInstance().LogError("No BPS patch files found in theme archive");
+        return false;
+    }
+    
+    // 以前完整解压留下的补丁不再使用, 删掉以免和压缩包里的不一致
+    std::vector<std::string> looseFiles;
+    ScanForBPSFiles(themePath, themePath, looseFiles);
+    for (const std::string& relPath : looseFiles) {
+        remove((themePath + "/" + relPath).c_str());
+    }
+    
+    return InstallPatches(themePath, archivePath, bpsFiles, entryCrcs, themeID, themeName, themeAuthor);
+}
+
+bool ThemePatcher::InstallPatches(const std::string& themePath, const std::string& archivePath,
+                                  const std::vector<std::string>& bpsFiles, const std::map<std::string, uint32_t>& entryCrcs,
+                                  const std::string& themeID, const std::string& themeName, const std::string& themeAuthor) {
+    Trace::Span span("patch", "install", themeName);
     if (mProgressCallback) {
         mProgressCallback(0.0f, "Preparing installation...");
     }
     
-    // themePath 现在是解压后的文件夹路径：wiiu/themes/主题名/
-    // 补丁文件在这个文件夹里，修补后的文件输出到 patched/ 子目录
     std::string patchedPath = themePath + "/patched";
+    // 编译好的补丁操作列表放在 compiled/ 子目录, 重新安装时使用
+    std::string compiledDir = themePath + "/compiled";
     
     FileLogger::GetInstance().LogInfo("Theme folder: %s", themePath.c_str());
     FileLogger::GetInstance().LogInfo("Patched output: %s", patchedPath.c_str());
@@ -334,119 +883,48 @@ bool ThemePatcher::InstallTheme(const std::string& themePath,
         FileLogger::GetInstance().LogError("Failed to create patched directory");
         return false;
     }
-    
-    // 扫描主题文件夹，查找所有 .bps 文件
-    std::vector<std::string> bpsFiles;
-    ScanForBPSFiles(themePath, themePath, bpsFiles);
-    
-    if (bpsFiles.empty()) {
-        FileLogger::GetInstance().LogError("No BPS patch files found in theme folder");
-        return false;
-    }
+    CreateDirectoryRecursive(compiledDir);
     
     FileLogger::GetInstance().LogInfo("Found %zu BPS patch files", bpsFiles.size());
     
     // 获取系统菜单路径
-    auto menuPathsPair = GetMenuPaths();
-    std::string menuContentPath = menuPathsPair.first;
-    
-    if (menuContentPath.empty()) {
-        FileLogger::GetInstance().LogError("Failed to get system menu paths");
-        return false;
+    const std::string& menuContentPath = SystemInfo::GetMenuContentPath();
+    if (!SystemInfo::IsMenuContentAvailable()) {
+        // 没有挂载 MLC 时原始文件只能来自 SD 卡上的缓存
+        FileLogger::GetInstance().LogWarning("System menu content not available, using cached source files only");
     }
     
     FileLogger::GetInstance().LogInfo("System menu content: %s", menuContentPath.c_str());
     
-    // 应用所有补丁
-    int patchedCount = 0;
-    for (size_t i = 0; i < bpsFiles.size(); i++) {
-        const std::string& bpsRelPath = bpsFiles[i];
-        std::string bpsFullPath = themePath + "/" + bpsRelPath;
-        
-        // BPS 文件名就是目标文件名（不含扩展名）
-        // 例如: Men.bps -> 修补 Common/Package/Men.pack
-        //       Men2.bps -> 修补 Common/Package/Men2.pack
-        //       cafe_barista_men.bps -> 修补 Common/Sound/Men/cafe_barista_men (音频文件)
-        // 先获取纯文件名（去掉路径和 .bps 后缀）
-        std::string bpsFileName = bpsRelPath;
-        size_t lastSlash = bpsFileName.find_last_of('/');
-        if (lastSlash != std::string::npos) {
-            bpsFileName = bpsFileName.substr(lastSlash + 1);
+    // 上次安装的记录: 输入没有变化的输出文件不再重新生成
+    std::string installedInfoPath = std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json";
+    std::map<std::string, PatchRecord> previousRecords = LoadPatchRecords(installedInfoPath);
+    // 移入存储的输出先取回, 没有变化的就能直接沿用
+    RestoreFromStore(themePath, previousRecords);
+    // 上次安装中断: 日志里的输出已经完整提交, 记录覆盖旧安装记录中的同一输出
+    std::string journalPath = GetJournalPath(themeID);
+    std::map<std::string, PatchRecord> journalRecords = LoadJournal(journalPath);
+    if (!journalRecords.empty()) {
+        FileLogger::GetInstance().LogInfo("Resuming interrupted install: %zu output(s) already committed",
+                                          journalRecords.size());
+        for (const auto& pair : journalRecords) {
+            previousRecords[pair.first] = pair.second;
         }
-        
-        // 移除 .bps 后缀得到目标文件名（不含扩展名）
-        std::string targetBaseName = bpsFileName.substr(0, bpsFileName.length() - 4);
-        
-        // 判断是否是音频文件(cafe_barista_men 等)
-        bool isAudioFile = (targetBaseName.find("cafe_barista") != std::string::npos);
+    }
+    
+    std::vector<std::vector<std::string>> chains = GroupPatchChains(bpsFiles, menuContentPath);
+    ResolveUnlinkedChains(chains, themePath, archivePath);
+    
+    // 为每个补丁链确定原始文件和输出路径
+    std::vector<PatchJob> jobs;
+    for (const std::vector<std::string>& chain : chains) {
+        const std::string& bpsRelPath = chain[0];
         
         std::string originalFilePath;
         std::string originalFileName;
+        ResolveOriginalFile(bpsRelPath, menuContentPath, originalFilePath, originalFileName);
         
-        if (isAudioFile) {
-            // 音频文件在 Common/Sound/Men 目录,扩展名为 .bfsar
-            originalFileName = targetBaseName + ".bfsar";
-            originalFilePath = menuContentPath + "Common/Sound/Men/" + originalFileName;
-            FileLogger::GetInstance().LogInfo("Audio file detected: %s", originalFileName.c_str());
-        } else {
-            // 系统菜单界面文件都是 .pack 格式,在 Common/Package/ 下
-            originalFileName = targetBaseName + ".pack";
-            originalFilePath = menuContentPath + "Common/Package/" + originalFileName;
-        }
-        
-        FileLogger::GetInstance().LogInfo("Patching [%zu/%zu]: %s", i + 1, bpsFiles.size(), originalFileName.c_str());
-        
-        // 读取原始文件
-        FILE* origFile = fopen(originalFilePath.c_str(), "rb");
-        if (!origFile) {
-            FileLogger::GetInstance().LogError("Failed to open original file: %s", originalFilePath.c_str());
-            continue;
-        }
-        
-        fseek(origFile, 0, SEEK_END);
-        size_t origSize = ftell(origFile);
-        rewind(origFile);
-        
-        std::vector<uint8_t> originalData(origSize);
-        fread(originalData.data(), 1, origSize, origFile);
-        fclose(origFile);
-        
-        // 读取补丁文件
-        FILE* patchF = fopen(bpsFullPath.c_str(), "rb");
-        if (!patchF) {
-            FileLogger::GetInstance().LogError("Failed to open patch: %s", bpsFullPath.c_str());
-            continue;
-        }
-        
-        fseek(patchF, 0, SEEK_END);
-        size_t patchSize = ftell(patchF);
-        rewind(patchF);
-        
-        std::vector<uint8_t> patchData(patchSize);
-        fread(patchData.data(), 1, patchSize, patchF);
-        fclose(patchF);
-        
-        // 应用 BPS 补丁
-        std::vector<uint8_t> patchedData;
-        if (!ApplyBPSPatch(originalData, patchData, patchedData)) {
-            FileLogger::GetInstance().LogError("Failed to apply patch: %s", originalFileName.c_str());
-            
-            // 显式释放内存
-            originalData.clear();
-            originalData.shrink_to_fit();
-            patchData.clear();
-            patchData.shrink_to_fit();
-            
-            continue;
-        }
-        
-        // 显式释放不再需要的内存
-        originalData.clear();
-        originalData.shrink_to_fit();
-        patchData.clear();
-        patchData.shrink_to_fit();
-        
-        // 保存修补后的文件到 patched/ 子目录（保持相同的目录结构）
+        // 修补后的文件保存到 patched/ 子目录（保持相同的目录结构）
         std::string patchedFilePath = patchedPath + "/Common/Package/" + originalFileName;
         
         // 创建父目录
@@ -455,49 +933,153 @@ bool ThemePatcher::InstallTheme(const std::string& themePath,
             CreateDirectoryRecursive(patchedFilePath.substr(0, slashPos));
         }
         
-        FILE* outFile = fopen(patchedFilePath.c_str(), "wb");
-        if (outFile) {
-            fwrite(patchedData.data(), 1, patchedData.size(), outFile);
-            fclose(outFile);
-            patchedCount++;
-            FileLogger::GetInstance().LogInfo("Patched successfully: %s (%zu bytes)", originalFileName.c_str(), patchedData.size());
+        PatchJob job;
+        job.patchPath = archivePath.empty() ? themePath + "/" + bpsRelPath : bpsRelPath;
+        job.archivePath = archivePath;
+        job.sourcePath = originalFilePath;
+        job.outputPath = patchedFilePath;
+        job.fileName = originalFileName;
+        job.record.output = patchedFilePath.substr(patchedPath.length() + 1);
+        job.record.patch = bpsRelPath;
+        std::vector<uint32_t> layerEntryCrcs;
+        for (size_t i = 0; i < chain.size(); i++) {
+            if (i > 0) {
+                job.chainPaths.push_back(archivePath.empty() ? themePath + "/" + chain[i] : chain[i]);
+                job.record.patch += "|" + chain[i];
+            }
+            auto entry = entryCrcs.find(chain[i]);
+            if (entry != entryCrcs.end()) {
+                layerEntryCrcs.push_back(entry->second);
+            }
+        }
+        if (!layerEntryCrcs.empty() && layerEntryCrcs.size() == chain.size()) {
+            job.record.entryCrc = BpsStreamPatcher::ChainCrc(layerEntryCrcs);
+        }
+        // 补丁链不编译操作列表
+        if (chain.size() == 1) {
+            job.compiledPath = compiledDir + "/" + originalFileName + ".ops";
         } else {
-            FileLogger::GetInstance().LogError("Failed to write patched file: %s", patchedFilePath.c_str());
+            FileLogger::GetInstance().LogInfo("Chaining %zu patches for %s: %s", chain.size(), originalFileName.c_str(),
+                                              job.record.patch.c_str());
         }
-        
-        // 显式释放 patchedData 内存
-        patchedData.clear();
-        patchedData.shrink_to_fit();
-        
-        // 进度更新
+        auto previous = previousRecords.find(job.record.output);
+        if (previous != previousRecords.end()) {
+            job.havePrevious = true;
+            job.previous = previous->second;
+        }
+        jobs.push_back(job);
+    }
+    
+    // 空间预检: 输出按补丁头部的目标大小计算, 替换已有输出只需要差额, 另外留出一个临时文件的空间
+    uint64_t requiredBytes = 0;
+    uint64_t largestOutput = 0;
+    for (const PatchJob& job : jobs) {
+        uint64_t targetSize = 0;
+        const std::string& lastLayer = job.chainPaths.empty() ? job.patchPath : job.chainPaths.back();
+        if (!ReadBPSTargetSize(lastLayer, job.archivePath, targetSize)) {
+            continue;  // 读不到的补丁在应用时报错
+        }
+        struct stat st;
+        uint64_t existing = stat(job.outputPath.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+        if (targetSize > existing) {
+            requiredBytes += targetSize - existing;
+        }
+        largestOutput = std::max(largestOutput, targetSize);
+    }
+    if (!FileIO::HasFreeSpace(patchedPath, requiredBytes + largestOutput)) {
         if (mProgressCallback) {
-            float progress = (float)(i + 1) / bpsFiles.size();
-            char msg[256];
-            snprintf(msg, sizeof(msg), "Applying patch %zu/%zu", i + 1, bpsFiles.size());
-            mProgressCallback(progress, msg);
+            mProgressCallback(0.0f, "Not enough free space");
         }
+        return false;
     }
     
-    FileLogger::GetInstance().LogInfo("Successfully patched %d/%zu files", patchedCount, bpsFiles.size());
+    // 原始文件从 SD 卡上的缓存读取
+    std::string titlePath = menuContentPath.substr(0, menuContentPath.length() - strlen("content/"));
+    MenuSourceCache sourceCache(GetSourceCacheDir(), titlePath);
+    sourceCache.Load();
     
-    // 保存安装信息
-    std::string installedInfoPath = std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json";
+    // 应用所有补丁 (每个补丁修补不同的文件, 可以并行); 日志接着上次中断时的内容追加
     CreateDirectoryRecursive(INSTALLED_THEMES_ROOT);
+    FILE* journal = fopen(journalPath.c_str(), "a");
+    if (!journal) {
+        FileLogger::GetInstance().LogWarning("Failed to open install journal: %s", journalPath.c_str());
+    }
+    int patchedCount = ApplyPatchJobs(jobs, sourceCache, journal);
+    if (journal) {
+        fclose(journal);
+    }
+    sourceCache.Save();
+    
+    FileLogger::GetInstance().LogInfo("Successfully patched %d/%zu files", patchedCount, jobs.size());
+    
+    // 删除上次安装生成、这次已经没有对应补丁的输出文件
+    for (const auto& pair : previousRecords) {
+        bool stillUsed = std::any_of(jobs.begin(), jobs.end(), [&](const PatchJob& job) {
+            return job.record.output == pair.first;
+        });
+        if (!stillUsed) {
+            ULOG_INFO(PATCH, "Removing stale output: %s", pair.first.c_str());
+            remove((patchedPath + "/" + pair.first).c_str());
+            size_t nameStart = pair.first.find_last_of('/');
+            std::string outputName = (nameStart == std::string::npos) ? pair.first : pair.first.substr(nameStart + 1);
+            remove((compiledDir + "/" + outputName + ".ops").c_str());
+        }
+    }
     
+    // 保存安装信息
     std::string installJson = "{\n";
     installJson += "  \"themeID\": \"" + themeID + "\",\n";
     installJson += "  \"themeName\": \"" + themeName + "\",\n";
     installJson += "  \"themeAuthor\": \"" + themeAuthor + "\",\n";
     installJson += "  \"installPath\": \"" + themePath + "\",\n";
-    installJson += "  \"patchedFiles\": " + std::to_string(patchedCount) + "\n";
+    if (!archivePath.empty()) {
+        installJson += "  \"archivePath\": \"" + archivePath + "\",\n";
+    }
+    installJson += "  \"patchedFiles\": " + std::to_string(patchedCount) + ",\n";
+    installJson += "  \"patches\": [";
+    bool firstRecord = true;
+    for (const PatchJob& job : jobs) {
+        if (!job.success) {
+            continue;  // 失败的下次一定重新生成
+        }
+        char crcs[96];
+        snprintf(crcs, sizeof(crcs), "\"sourceCrc\": \"%08x\", \"patchCrc\": \"%08x\", \"targetCrc\": \"%08x\"",
+                 (unsigned)job.record.sourceCrc, (unsigned)job.record.patchCrc, (unsigned)job.record.targetCrc);
+        installJson += firstRecord ? "\n" : ",\n";
+        installJson += "    {\"output\": \"" + job.record.output + "\", \"patch\": \"" + job.record.patch + "\", " +
+                       crcs + ", \"size\": " + std::to_string(job.record.size);
+        if (job.record.entryCrc != 0) {
+            char entryCrc[32];
+            snprintf(entryCrc, sizeof(entryCrc), ", \"entryCrc\": \"%08x\"", (unsigned)job.record.entryCrc);
+            installJson += entryCrc;
+        }
+        installJson += "}";
+        firstRecord = false;
+    }
+    installJson += firstRecord ? "]\n" : "\n  ]\n";
     installJson += "}\n";
     
-    FILE* jsonFile = fopen(installedInfoPath.c_str(), "w");
+    // 先写临时文件再改名, 安装记录写好之前日志一直保留
+    std::string tempInfoPath = installedInfoPath + ".tmp";
+    FILE* jsonFile = fopen(tempInfoPath.c_str(), "w");
+    bool saved = false;
     if (jsonFile) {
-        fwrite(installJson.c_str(), 1, installJson.length(), jsonFile);
-        fclose(jsonFile);
+        saved = fwrite(installJson.c_str(), 1, installJson.length(), jsonFile) == installJson.length() &&
+                fflush(jsonFile) == 0 && fsync(fileno(jsonFile)) == 0;
+        saved = (fclose(jsonFile) == 0) && saved;
+        remove(installedInfoPath.c_str());
+        saved = saved && rename(tempInfoPath.c_str(), installedInfoPath.c_str()) == 0;
+    }
+    if (saved) {
+        remove(journalPath.c_str());
         FileLogger::GetInstance().LogInfo("Saved installation info to: %s", installedInfoPath.c_str());
+    } else {
+        remove(tempInfoPath.c_str());
+        FileLogger::GetInstance().LogError("Failed to save installation info: %s", installedInfoPath.c_str());
     }
+    ThemeRegistry::GetInstance().UpdateTheme(themePath, themeID);
+    
+    SetCurrentTheme(themeID, themePath);
     
     if (mProgressCallback) {
         mProgressCallback(1.0f, "Installation complete");
@@ -506,33 +1088,457 @@ bool ThemePatcher::InstallTheme(const std::string& themePath,
     return true;
 }
 
-bool DeleteDirectoryRecursive(const std::string& path) {
-    DIR* dir = opendir(path.c_str());
-    if (!dir) {
+// 逐块计算文件的 CRC32, 返回文件大小
+static bool ComputeFileCrc(const std::string& path, uint32_t& crc, uint64_t& size,
+                           size_t bufferSize = FileIO::CHUNK_SIZE) {
+    FileIO file;
+    if (!file.Open(path, FileIO::MODE_READ)) {
+        return false;
+    }
+    FileIO::Buffer buffer(bufferSize);
+    uint64_t expected = file.Size();
+    crc = 0;
+    size = 0;
+    size_t n;
+    while (buffer.size() > 0 && (n = file.Read(buffer.data(), buffer.size())) > 0) {
+        crc = Hips::Detail::crc32(buffer.data(), n, crc);
+        size += n;
+    }
+    return size == expected;
+}
+
+bool ThemePatcher::IsPatchedOutputCurrent(const std::string& themePath, const PatchRecord& record, bool checkPatch,
+                                          const std::string& menuContentPath, MenuSourceCache& sourceCache) {
+    // 补丁没有换过
+    std::vector<std::string> layers = SplitPatchChain(record.patch);
+    std::vector<std::string> layerPaths;
+    for (const std::string& layer : layers) {
+        layerPaths.push_back(themePath + "/" + layer);
+    }
+    uint32_t sourceCrc = 0, targetCrc = 0, patchCrc = 0;
+    if (checkPatch && (!ReadChainChecksums(layerPaths, sourceCrc, targetCrc, patchCrc) ||
+        sourceCrc != record.sourceCrc || targetCrc != record.targetCrc || patchCrc != record.patchCrc)) {
+        FileLogger::GetInstance().LogInfo("Patch changed since install: %s", record.patch.c_str());
         return false;
     }
     
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+    // 系统菜单的原始文件没有变 (缓存命中时只比较记录的 CRC32)
+    std::string originalFilePath, originalFileName;
+    ResolveOriginalFile(layers[0], menuContentPath, originalFilePath, originalFileName);
+    uint32_t cachedCrc = 0;
+    bool crcKnown = false;
+    sourceCache.Acquire(originalFilePath, cachedCrc, crcKnown);
+    if (!crcKnown || cachedCrc != record.sourceCrc) {
+        FileLogger::GetInstance().LogInfo("System file changed since install: %s", originalFileName.c_str());
+        return false;
+    }
+    
+    // 输出文件完整: 大小和内容的 CRC32 都和补丁记录的目标一致
+    std::string outputPath = themePath + "/patched/" + record.output;
+    struct stat st;
+    uint32_t outputCrc = 0;
+    uint64_t outputSize = 0;
+    if (stat(outputPath.c_str(), &st) != 0 || (uint64_t)st.st_size != record.size ||
+        !ComputeFileCrc(outputPath, outputCrc, outputSize) ||
+        outputSize != record.size || outputCrc != record.targetCrc) {
+        FileLogger::GetInstance().LogInfo("Patched output missing or damaged: %s", record.output.c_str());
+        return false;
+    }
+    return true;
+}
+
+ThemePatcher::VerifyReport ThemePatcher::VerifyThemes(const std::vector<std::pair<std::string, std::string>>& themes) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_PATCH);
+    VerifyReport report;
+    OSTime start = OSGetSystemTime();
+    
+    // 每个输出一个任务; size 为 0 时 (旧安装记录) 只比较 CRC32
+    struct VerifyJob {
+        size_t theme = 0;
+        std::string label;       // 主题目录名/输出, 用于日志
+        std::string path;
+        uint64_t size = 0;
+        uint32_t crc = 0;
+        bool ok = false;
+    };
+    std::vector<VerifyJob> jobs;
+    const std::string& menuContentPath = SystemInfo::GetMenuContentPath();
+    for (size_t t = 0; t < themes.size(); t++) {
+        const std::string& themePath = themes[t].first;
+        const std::string& themeID = themes[t].second;
+        std::string dirName = themePath.substr(themePath.find_last_of('/') + 1);
+        
+        std::map<std::string, PatchRecord> records;
+        if (!themeID.empty()) {
+            records = LoadPatchRecords(std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json");
+        }
+        if (records.empty()) {
+            // 旧版本的安装记录没有输出清单: 目标的 CRC32 取自补丁链最后一层的末尾
+            std::vector<std::string> bpsFiles;
+            ScanForBPSFiles(themePath, themePath, bpsFiles);
+            std::vector<std::vector<std::string>> chains = GroupPatchChains(bpsFiles, menuContentPath);
+            ResolveUnlinkedChains(chains, themePath, std::string());
+            for (const std::vector<std::string>& chain : chains) {
+                std::vector<std::string> layerPaths;
+                for (const std::string& layer : chain) {
+                    layerPaths.push_back(themePath + "/" + layer);
+                }
+                std::string originalFilePath, originalFileName;
+                ResolveOriginalFile(chain[0], menuContentPath, originalFilePath, originalFileName);
+                PatchRecord record;
+                uint32_t sourceCrc = 0, patchCrc = 0;
+                if (ReadChainChecksums(layerPaths, sourceCrc, record.targetCrc, patchCrc)) {
+                    record.output = "Common/Package/" + originalFileName;
+                    records[record.output] = record;
+                }
+            }
+        }
+        if (records.empty()) {
+            FileLogger::GetInstance().LogWarning("[Verify] No install record or patches for %s", dirName.c_str());
+            report.unverifiable++;
             continue;
         }
         
-        std::string fullPath = path + "/" + entry->d_name;
-        
-        if (entry->d_type == DT_DIR) {
-            DeleteDirectoryRecursive(fullPath);
-        } else {
-            unlink(fullPath.c_str());
+        for (const auto& pair : records) {
+            const PatchRecord& record = pair.second;
+            VerifyJob job;
+            job.theme = t;
+            job.label = dirName + "/" + record.output;
+            job.path = themePath + "/patched/" + record.output;
+            job.size = record.size;
+            job.crc = record.targetCrc;
+            // 不是当前主题时输出可能已经移入 PatchStore, 校验存储中的对象
+            struct stat st;
+            if (record.size > 0 && stat(job.path.c_str(), &st) != 0) {
+                std::string objectPath = std::string(PatchStore::STORE_ROOT) + "/" +
+                                         PatchStore::ObjectName(record.output, record.size, record.targetCrc);
+                if (stat(objectPath.c_str(), &st) == 0) {
+                    job.path = objectPath;
+                }
+            }
+            jobs.push_back(std::move(job));
         }
     }
+    if (jobs.empty()) {
+        return report;
+    }
     
-    closedir(dir);
-    rmdir(path.c_str());
+    // SD 卡上多个文件同时顺序读取, 每个线程一个大缓冲区 (大小按性能档位)
+    JobSystem::HeavyWorkScope heavyWork;
+    size_t bufferSize = PerfProfile::GetCopyBufferSize();
+    size_t threadCount = std::min<size_t>((size_t)std::max(1, JobSystem::GetWorkerCount()), jobs.size());
+    FileLogger::GetInstance().LogInfo("[Verify] Checking %zu outputs of %zu theme(s) on %zu thread(s)",
+                                      jobs.size(), themes.size(), threadCount);
+    
+    std::mutex mutex;
+    std::condition_variable finishedCv;
+    size_t nextJob = 0;
+    size_t finished = 0;
+    uint64_t totalBytes = 0;
+    
+    auto worker = [&]() {
+        while (true) {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (nextJob >= jobs.size()) {
+                    return;
+                }
+                index = nextJob++;
+            }
+            
+            VerifyJob& job = jobs[index];
+            uint32_t crc = 0;
+            uint64_t size = 0;
+            job.ok = ComputeFileCrc(job.path, crc, size, bufferSize) && crc == job.crc &&
+                     (job.size == 0 || size == job.size);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                totalBytes += size;
+                finished++;
+            }
+            finishedCv.notify_one();
+        }
+    };
+    
+    std::vector<JobHandle> workers;
+    for (size_t t = 0; t < threadCount; t++) {
+        workers.push_back(JobSystem::Submit([&worker](const CancelToken&) { worker(); }));
+    }
+    
+    size_t reported = 0;
+    while (reported < jobs.size()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finishedCv.wait(lock, [&]() { return finished > reported; });
+            reported = finished;
+        }
+        if (mProgressCallback) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Verifying %zu/%zu", reported, jobs.size());
+            mProgressCallback((float)reported / jobs.size(), msg);
+        }
+    }
+    for (auto& handle : workers) {
+        handle.Wait();
+    }
+    
+    std::vector<bool> themeDamaged(themes.size(), false);
+    for (const VerifyJob& job : jobs) {
+        report.checkedFiles++;
+        if (!job.ok) {
+            FileLogger::GetInstance().LogWarning("[Verify] Missing or damaged: %s", job.label.c_str());
+            report.damagedFiles++;
+            if (!themeDamaged[job.theme]) {
+                themeDamaged[job.theme] = true;
+                report.damagedThemes.push_back(themes[job.theme].first);
+            }
+        }
+    }
+    FileLogger::GetInstance().LogInfo("[Verify] %d of %d outputs OK (%llu MB) in %llu ms",
+                                      report.checkedFiles - report.damagedFiles, report.checkedFiles,
+                                      (unsigned long long)(totalBytes >> 20),
+                                      (unsigned long long)OSTicksToMilliseconds(OSGetSystemTime() - start));
+    return report;
+}
+
+bool ThemePatcher::SwitchToTheme(const std::string& themePath,
+                                 const std::string& themeID,
+                                 const std::string& themeName,
+                                 const std::string& themeAuthor) {
+    FileLogger::GetInstance().LogInfo("Switching to theme: %s (%s)", themeName.c_str(), themePath.c_str());
+    
+    if (mProgressCallback) {
+        mProgressCallback(0.0f, "Checking patched files...");
+    }
+    
+    // 安装记录里的输出必须正好覆盖主题现在的所有补丁
+    std::string installedInfoPath = std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json";
+    std::string archivePath;
+    std::map<std::string, PatchRecord> records = LoadPatchRecords(installedInfoPath, &archivePath);
+    RestoreFromStore(themePath, records);
+    std::vector<std::string> bpsFiles;
+    ScanForBPSFiles(themePath, themePath, bpsFiles);
+    bool fromArchive = bpsFiles.empty() && !archivePath.empty();
+    std::map<std::string, uint32_t> entryCrcs;
+    bool archiveMissing = false;
+    if (fromArchive && !ListArchivePatches(archivePath, bpsFiles, entryCrcs)) {
+        // 压缩包已经删除: 补丁无从比较, 只要输出和系统文件都和记录一致就能继续使用
+        FileLogger::GetInstance().LogWarning("Theme archive missing: %s", archivePath.c_str());
+        archiveMissing = true;
+        for (const auto& pair : records) {
+            for (const std::string& layer : SplitPatchChain(pair.second.patch)) {
+                bpsFiles.push_back(layer);
+            }
+        }
+    }
+    // 每条记录是一个补丁链, 各层合起来正好是现在的所有补丁
+    size_t recordedLayers = 0;
+    bool current = !records.empty();
+    for (const auto& pair : records) {
+        std::vector<std::string> layers = SplitPatchChain(pair.second.patch);
+        std::vector<uint32_t> layerEntryCrcs;
+        for (const std::string& layer : layers) {
+            current = current && std::find(bpsFiles.begin(), bpsFiles.end(), layer) != bpsFiles.end();
+            layerEntryCrcs.push_back(entryCrcs[layer]);
+        }
+        recordedLayers += layers.size();
+        // 压缩包里的补丁按条目的 CRC32 比较, 不必解压
+        current = current && (!fromArchive || archiveMissing ||
+                              BpsStreamPatcher::ChainCrc(layerEntryCrcs) == pair.second.entryCrc);
+    }
+    current = current && recordedLayers == bpsFiles.size();
+    
+    const std::string& menuContentPath = SystemInfo::GetMenuContentPath();
+    if (current && !menuContentPath.empty()) {
+        std::string titlePath = menuContentPath.substr(0, menuContentPath.length() - strlen("content/"));
+        MenuSourceCache sourceCache(GetSourceCacheDir(), titlePath);
+        sourceCache.Load();
+        size_t checked = 0;
+        for (const auto& pair : records) {
+            if (!IsPatchedOutputCurrent(themePath, pair.second, !fromArchive, menuContentPath, sourceCache)) {
+                current = false;
+                break;
+            }
+            checked++;
+            if (mProgressCallback) {
+                mProgressCallback((float)checked / records.size(), "Checking patched files...");
+            }
+        }
+        sourceCache.Save();
+    } else {
+        current = false;
+    }
+    
+    if (!current) {
+        // 重新安装, 仍然沿用没有变化的输出
+        FileLogger::GetInstance().LogInfo("Patched files are not current, reinstalling theme");
+        return InstallTheme(themePath, themeID, themeName, themeAuthor);
+    }
     
+    SetCurrentTheme(themeID, themePath);
+    FileLogger::GetInstance().LogInfo("Switched to theme without patching: %s (%zu files)", themeName.c_str(), records.size());
+    if (mProgressCallback) {
+        mProgressCallback(1.0f, "Theme activated");
+    }
     return true;
 }
 
+// 当前主题记录中的 ID 和目录
+static bool ReadCurrentTheme(std::string& themeID, std::string& themePath) {
+    std::string content = ThemePatcher::ReadCurrentThemeRecord();
+    if (content.empty()) {
+        return false;
+    }
+    try {
+        JsonDocument doc = SimpleJsonParser::Parse(content);
+        const JsonValue& root = doc.Root();
+        if (!root.has("themeID") || !root.has("installPath")) {
+            return false;
+        }
+        themeID = std::string(root["themeID"].asString());
+        themePath = std::string(root["installPath"].asString());
+        return true;
+    } catch (...) {
+        FileLogger::GetInstance().LogWarning("Failed to parse current theme file");
+    }
+    return false;
+}
+
+int ThemePatcher::RestoreFromStore(const std::string& themePath, const std::map<std::string, PatchRecord>& records) {
+    int restored = 0;
+    for (const auto& pair : records) {
+        std::string outputPath = themePath + "/patched/" + pair.first;
+        struct stat st;
+        if (stat(outputPath.c_str(), &st) == 0) {
+            continue;
+        }
+        CreateDirectoryRecursive(outputPath.substr(0, outputPath.find_last_of('/')));
+        if (PatchStore::Get(pair.first, pair.second.size, pair.second.targetCrc, outputPath)) {
+            restored++;
+        }
+    }
+    if (restored > 0) {
+        FileLogger::GetInstance().LogInfo("Restored %d patched file(s) of %s from the store", restored, themePath.c_str());
+    }
+    return restored;
+}
+
+void ThemePatcher::StashCurrentTheme(const std::string& nextThemePath) {
+    std::string themeID, themePath;
+    if (!PatchStore::IsEnabled() || !ReadCurrentTheme(themeID, themePath) || themePath == nextThemePath) {
+        return;
+    }
+    
+    std::map<std::string, PatchRecord> records = LoadPatchRecords(std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json");
+    int stashed = 0;
+    for (const auto& pair : records) {
+        if (PatchStore::Put(themePath + "/patched/" + pair.first, pair.first, pair.second.size, pair.second.targetCrc)) {
+            stashed++;
+        }
+    }
+    FileLogger::GetInstance().LogInfo("Moved %d patched file(s) of %s into the store", stashed, themePath.c_str());
+}
+
+void ThemePatcher::CollectStoreGarbage() {
+    struct stat st;
+    if (stat(PatchStore::STORE_ROOT, &st) != 0) {
+        return;
+    }
+    
+    // 所有安装记录引用的对象
+    std::set<std::string> referenced;
+    DIR* dir = opendir(INSTALLED_THEMES_ROOT);
+    if (!dir) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name.length() <= 5 || name.compare(name.length() - 5, 5, ".json") != 0) {
+            continue;
+        }
+        for (const auto& pair : LoadPatchRecords(std::string(INSTALLED_THEMES_ROOT) + "/" + name)) {
+            referenced.insert(PatchStore::ObjectName(pair.first, pair.second.size, pair.second.targetCrc));
+        }
+    }
+    closedir(dir);
+    
+    PatchStore::CollectGarbage(referenced);
+}
+
+void ThemePatcher::SetCurrentTheme(const std::string& themeID, const std::string& themePath) {
+    StashCurrentTheme(themePath);
+    CreateDirectoryRecursive(UTHEME_ROOT);
+    std::string json = "{\n";
+    json += "  \"themeID\": \"" + themeID + "\",\n";
+    json += "  \"installPath\": \"" + themePath + "\"\n";
+    json += "}\n";
+    
+    FILE* file = fopen(CURRENT_THEME_FILE, "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("Failed to save current theme");
+        return;
+    }
+    fwrite(json.c_str(), 1, json.length(), file);
+    fclose(file);
+}
+
+std::string ThemePatcher::ReadCurrentThemeRecord() {
+    FILE* file = fopen(CURRENT_THEME_FILE, "r");
+    if (!file) {
+        return "";
+    }
+    std::string content;
+    char buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, n);
+    }
+    fclose(file);
+    return content;
+}
+
+void ThemePatcher::RestoreCurrentThemeRecord(const std::string& record) {
+    if (record.empty()) {
+        unlink(CURRENT_THEME_FILE);
+        return;
+    }
+    FILE* file = fopen(CURRENT_THEME_FILE, "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("Failed to restore current theme");
+        return;
+    }
+    fwrite(record.data(), 1, record.size(), file);
+    fclose(file);
+    
+    // 临时安装的主题启用时, 原来的主题的输出可能已经移入存储
+    std::string themeID, themePath;
+    if (ReadCurrentTheme(themeID, themePath)) {
+        ThemePatcher patcher;
+        patcher.RestoreFromStore(themePath, patcher.LoadPatchRecords(std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json"));
+    }
+}
+
+std::string ThemePatcher::GetCurrentThemePath() {
+    std::string content = ReadCurrentThemeRecord();
+    if (content.empty()) {
+        return "";
+    }
+    
+    try {
+        JsonDocument doc = SimpleJsonParser::Parse(content);
+        const JsonValue& root = doc.Root();
+        if (root.has("installPath")) {
+            return std::string(root["installPath"].asString());
+        }
+    } catch (...) {
+        FileLogger::GetInstance().LogWarning("Failed to parse current theme file");
+    }
+    return "";
+}
+
 bool ThemePatcher::UninstallTheme(const std::string& themeID) {
     FileLogger::GetInstance().LogInfo("Uninstalling theme: %s", themeID.c_str());
     
@@ -569,107 +1575,96 @@ bool ThemePatcher::UninstallTheme(const std::string& themeID) {
         return false;
     }
     
-    // 删除主题目录
+    // 删除主题目录 (移到回收站, 在后台删除)
     std::string themeBasePath = std::string(THEMES_ROOT) + "/" + themeName;
-    DeleteDirectoryRecursive(themeBasePath);
+    TrashBin::Remove(themeBasePath);
     
     // 删除安装信息
     unlink(installedInfoPath.c_str());
+    unlink(GetJournalPath(themeID).c_str());
+    ThemeRegistry::GetInstance().RemoveTheme(themeBasePath);
+    if (GetCurrentThemePath() == themeBasePath) {
+        unlink(CURRENT_THEME_FILE);
+    }
+    // 存储中只被这个主题引用的输出 (在后台扫描安装记录)
+    JobSystem::Submit([](const CancelToken&) {
+        ThemePatcher patcher;
+        patcher.CollectStoreGarbage();
+    });
     
     FileLogger::GetInstance().LogInfo("Theme uninstalled successfully");
     
     return true;
 }
 
-bool ThemePatcher::IsThemeInstalled(const std::string& themeID) {
-    std::string installedInfoPath = std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json";
+std::vector<std::string> ThemePatcher::UninstallThemes(const std::vector<std::string>& themePaths) {
+    std::vector<std::string> removedPaths;
+    if (themePaths.empty()) {
+        return removedPaths;
+    }
+    FileLogger::GetInstance().LogInfo("Uninstalling %zu themes", themePaths.size());
+    
+    // 安装记录的 ID 从登记表 (内存中) 取, 不再逐个读取安装信息
+    std::map<std::string, std::string> installedIDs;  // 主题目录 -> 主题 ID
+    ThemeRegistry& registry = ThemeRegistry::GetInstance();
+    registry.ForEachTheme([&installedIDs](const ThemeRegistry::Entry& entry) {
+        if (entry.installed && !entry.themeID.empty()) {
+            installedIDs[entry.path] = entry.themeID;
+        }
+    });
+    
+    std::string currentThemePath = GetCurrentThemePath();
+    removedPaths.reserve(themePaths.size());
+    for (const std::string& themePath : themePaths) {
+        // 移到回收站只是改名, 目录树在后台删除
+        if (!TrashBin::Remove(themePath)) {
+            FileLogger::GetInstance().LogError("Failed to remove theme directory: %s", themePath.c_str());
+            continue;
+        }
+        auto it = installedIDs.find(themePath);
+        if (it != installedIDs.end()) {
+            unlink((std::string(INSTALLED_THEMES_ROOT) + "/" + it->second + ".json").c_str());
+            unlink(GetJournalPath(it->second).c_str());
+        }
+        if (themePath == currentThemePath) {
+            unlink(CURRENT_THEME_FILE);
+        }
+        removedPaths.push_back(themePath);
+    }
     
-    struct stat st;
-    return (stat(installedInfoPath.c_str(), &st) == 0);
+    registry.RemoveThemes(removedPaths);
+    if (!removedPaths.empty()) {
+        JobSystem::Submit([](const CancelToken&) {
+            ThemePatcher patcher;
+            patcher.CollectStoreGarbage();
+        });
+    }
+    
+    FileLogger::GetInstance().LogInfo("Uninstalled %zu of %zu themes", removedPaths.size(), themePaths.size());
+    return removedPaths;
+}
+
+bool ThemePatcher::IsThemeInstalled(const std::string& themeID) {
+    return ThemeRegistry::GetInstance().IsInstalled(themeID);
 }
 
 std::vector<ThemeMetadata> ThemePatcher::GetInstalledThemes() {
     std::vector<ThemeMetadata> themes;
     
-    DIR* dir = opendir(INSTALLED_THEMES_ROOT);
-    if (!dir) {
-        FileLogger::GetInstance().LogInfo("No installed themes directory");
-        return themes;
-    }
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_type != DT_REG) {
-            continue;
-        }
-        
-        std::string filename = entry->d_name;
-        if (filename.length() < 5 || filename.substr(filename.length() - 5) != ".json") {
+    // 从登记表读取, 不再逐个打开安装记录
+    for (const ThemeRegistry::Entry& entry : ThemeRegistry::GetInstance().GetThemes()) {
+        if (!entry.installed) {
             continue;
         }
-        
-        std::string fullPath = std::string(INSTALLED_THEMES_ROOT) + "/" + filename;
-        
-        FILE* jsonFile = fopen(fullPath.c_str(), "r");
-        if (!jsonFile) {
-            continue;
-        }
-        
-        fseek(jsonFile, 0, SEEK_END);
-        size_t fileSize = ftell(jsonFile);
-        rewind(jsonFile);
-        
-        std::string jsonContent;
-        jsonContent.resize(fileSize);
-        fread(&jsonContent[0], 1, fileSize, jsonFile);
-        fclose(jsonFile);
-        
-        // 简单解析
         ThemeMetadata metadata;
-        
-        // 解析 themeID
-        size_t pos = jsonContent.find("\"themeID\"");
-        if (pos != std::string::npos) {
-            size_t colonPos = jsonContent.find(":", pos);
-            size_t quoteStart = jsonContent.find("\"", colonPos);
-            size_t quoteEnd = jsonContent.find("\"", quoteStart + 1);
-            metadata.themeID = jsonContent.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-        }
-        
-        // 解析 themeName
-        pos = jsonContent.find("\"themeName\"");
-        if (pos != std::string::npos) {
-            size_t colonPos = jsonContent.find(":", pos);
-            size_t quoteStart = jsonContent.find("\"", colonPos);
-            size_t quoteEnd = jsonContent.find("\"", quoteStart + 1);
-            metadata.themeName = jsonContent.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-        }
-        
-        // 解析 themeAuthor
-        pos = jsonContent.find("\"themeAuthor\"");
-        if (pos != std::string::npos) {
-            size_t colonPos = jsonContent.find(":", pos);
-            size_t quoteStart = jsonContent.find("\"", colonPos);
-            size_t quoteEnd = jsonContent.find("\"", quoteStart + 1);
-            metadata.themeAuthor = jsonContent.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-        }
-        
-        // 解析 themeVersion
-        pos = jsonContent.find("\"themeVersion\"");
-        if (pos != std::string::npos) {
-            size_t colonPos = jsonContent.find(":", pos);
-            size_t quoteStart = jsonContent.find("\"", colonPos);
-            size_t quoteEnd = jsonContent.find("\"", quoteStart + 1);
-            metadata.themeVersion = jsonContent.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-        }
-        
+        metadata.themeID = entry.themeID;
+        metadata.themeName = entry.themeName;
+        metadata.themeAuthor = entry.themeAuthor;
+        metadata.themeVersion = entry.themeVersion;
         metadata.themeRegion = REGION_UNIVERSAL;
-        
         themes.push_back(metadata);
     }
     
-    closedir(dir);
-    
     FileLogger::GetInstance().LogInfo("Found %zu installed themes", themes.size());
     
     return themes;
@@ -5,14 +5,11 @@
 #include <vector>
 #include <functional>
 #include <cstdint>
+#include <cstdio>
+#include "BpsStreamPatcher.hpp"
+#include "SystemInfo.hpp"
 
-// 系统区域
-enum SystemRegion {
-    REGION_JPN = 0,
-    REGION_USA = 1,
-    REGION_EUR = 2,
-    REGION_UNIVERSAL = 3
-};
+class MenuSourceCache;
 
 // 主题元数据
 struct ThemeMetadata {
@@ -47,8 +44,34 @@ public:
                      const std::string& themeName, 
                      const std::string& themeAuthor);
     
+    // 直接从 .utheme / .zip 安装: .bps 条目边解压边打补丁, 不写到 SD 卡
+    // themePath: 主题文件夹 (其它文件已解压到这里, 输出写到 patched/)
+    // 压缩包路径写入安装记录, 以后重新安装 (InstallTheme / SwitchToTheme) 时从同一个压缩包读取补丁
+    bool InstallThemeFromArchive(const std::string& archivePath,
+                                 const std::string& themePath,
+                                 const std::string& themeID,
+                                 const std::string& themeName,
+                                 const std::string& themeAuthor);
+    
+    // 切换到以前安装过的主题: patched/ 下的输出和安装记录的指纹 (补丁、原始文件、输出的 CRC32 和大小)
+    // 都一致时直接启用, 不打补丁; 否则退回 InstallTheme (仍然只重新生成变化的文件)
+    bool SwitchToTheme(const std::string& themePath,
+                      const std::string& themeID,
+                      const std::string& themeName,
+                      const std::string& themeAuthor);
+    
+    // 当前启用的主题 (最后一次安装或切换的主题目录), 没有时为空
+    static std::string GetCurrentThemePath();
+    
+    // 当前主题记录的原始内容 (没有时为空); 临时安装主题前保存, 之后原样写回 (内容为空时删除记录)
+    static std::string ReadCurrentThemeRecord();
+    static void RestoreCurrentThemeRecord(const std::string& record);
+    
     // 卸载主题
     bool UninstallTheme(const std::string& themeID);
+    // 一次卸载多个主题 (主题目录的完整路径): 目录移到回收站在后台删除, 登记表只写一次,
+    // 存储的垃圾回收只做一次; 不等待删除完成, 返回已经移走的主题目录
+    static std::vector<std::string> UninstallThemes(const std::vector<std::string>& themePaths);
     
     // 检查主题是否已安装
     bool IsThemeInstalled(const std::string& themeID);
@@ -56,17 +79,103 @@ public:
     // 获取已安装的主题列表
     std::vector<ThemeMetadata> GetInstalledThemes();
     
+    // 校验已安装主题的补丁输出, 不重新安装: patched/ 下每个输出 (已移入 PatchStore 的检查存储中的对象)
+    // 的大小和 CRC32 与安装记录中补丁的目标一致; 没有输出清单的旧安装记录按主题目录中 .bps 末尾的目标 CRC32 校验
+    // 所有主题的输出一起分给任务线程, 每个文件用大块顺序读取; 进度通过 mProgressCallback 在调用线程上报告
+    // 会等待任务线程, 不能在任务线程上调用
+    struct VerifyReport {
+        int checkedFiles = 0;
+        int damagedFiles = 0;                   // 缺少或内容不一致的输出
+        std::vector<std::string> damagedThemes; // 有损坏输出的主题目录 (需要重新安装)
+        int unverifiable = 0;                   // 没有记录也没有补丁, 无法校验的主题数
+    };
+    // themes: (主题目录, 主题 ID)
+    VerifyReport VerifyThemes(const std::vector<std::pair<std::string, std::string>>& themes);
+    
     // 设置进度回调
     void SetProgressCallback(std::function<void(float progress, const std::string& message)> callback);
     
 private:
     std::function<void(float progress, const std::string& message)> mProgressCallback;
     
+    // 安装记录中每个输出文件的输入指纹 (都取自补丁记录的 CRC32), 重新安装时输入没变就不再生成
+    struct PatchRecord {
+        std::string output;      // 相对 patched/ 的路径
+        std::string patch;       // 相对主题目录的 .bps 路径, 补丁链的各层用 '|' 连接
+        uint32_t sourceCrc = 0;
+        uint32_t patchCrc = 0;
+        uint32_t targetCrc = 0;
+        uint64_t size = 0;       // 输出文件大小
+        uint32_t entryCrc = 0;   // 从压缩包安装时补丁条目在 zip 中的 CRC32 (不解压就能比较, 补丁链为各层的 ChainCrc), 否则为 0
+    };
+    
+    // 一个 .bps 补丁 (或修补同一个文件的补丁链) 的应用任务
+    struct PatchJob {
+        std::string patchPath;   // 从压缩包安装时为条目名; 补丁链的第一层
+        std::vector<std::string> chainPaths; // 补丁链在 patchPath 之后依次应用的各层, 单个补丁时为空
+        std::string archivePath; // 不为空时补丁在这个压缩包里
+        std::string sourcePath;  // 系统菜单中的原始文件
+        std::string outputPath;  // patched/ 下的输出文件
+        std::string fileName;    // 原始文件名 (用于日志)
+        std::string compiledPath; // 编译好的操作列表 (compiled/ 下), 补丁链为空
+        PatchRecord record;      // 成功后写入安装记录
+        bool havePrevious = false;
+        PatchRecord previous;    // 上次安装时的记录
+        bool success = false;
+        bool reused = false;     // 输入没有变化, 沿用了上次的输出
+        uint64_t outputSize = 0;
+    };
+    
+    // 在多个线程上应用补丁, 返回成功的个数; 进度通过 mProgressCallback 在调用线程上报告
+    // journal 不为空时每生成一个输出就追加一条记录 (见 AppendJournal)
+    int ApplyPatchJobs(std::vector<PatchJob>& jobs, MenuSourceCache& sourceCache, FILE* journal = nullptr);
+    // 应用一个补丁 (在工作线程上调用), 输入和上次安装相同时沿用上次的输出
+    void RunPatchJob(PatchJob& job, MenuSourceCache& sourceCache);
+    // 补丁末尾记录的源文件、目标和补丁的 CRC32
+    // 压缩包里的补丁要解压到末尾才能读到, 只在条目和上次安装时相同时取上次的记录
+    bool GetPatchChecksums(const PatchJob& job, uint32_t& sourceCrc, uint32_t& targetCrc, uint32_t& patchCrc);
+    // 安装主题目录中的补丁 (archivePath 为空) 或压缩包中的补丁; entryCrcs 是压缩包条目的 CRC32
+    bool InstallPatches(const std::string& themePath, const std::string& archivePath,
+                        const std::vector<std::string>& bpsFiles, const std::map<std::string, uint32_t>& entryCrcs,
+                        const std::string& themeID, const std::string& themeName, const std::string& themeAuthor);
+    // 上次安装记录中的输出文件 (以输出路径为键), 没有记录时为空; archivePath 返回记录的压缩包 (没有时为空)
+    std::map<std::string, PatchRecord> LoadPatchRecords(const std::string& installedInfoPath,
+                                                        std::string* archivePath = nullptr);
+    // 安装日志: 安装过程中每提交 (改名) 一个输出就在 installed/<id>.journal 追加一行并刷到 SD 卡,
+    // 安装记录写好后删除; 安装中断 (断电、崩溃) 后再次安装时把日志并入上次的记录, 已提交的输出直接沿用
+    static std::string GetJournalPath(const std::string& themeID);
+    std::map<std::string, PatchRecord> LoadJournal(const std::string& journalPath);
+    static bool AppendJournal(FILE* journal, const PatchRecord& record);
+    // 记录的输出文件是否还能直接使用 (补丁和原始文件没变, 输出完整)
+    // checkPatch 为 false 时不检查补丁 (压缩包中的补丁由调用者按条目 CRC32 检查)
+    bool IsPatchedOutputCurrent(const std::string& themePath, const PatchRecord& record, bool checkPatch,
+                                const std::string& menuContentPath, MenuSourceCache& sourceCache);
+    // 启用主题; 开启 PatchStore 时先把原来的当前主题的输出移入存储
+    void SetCurrentTheme(const std::string& themeID, const std::string& themePath);
+    // PatchStore: 从存储取回 patched/ 下缺少的输出, 返回取回的个数
+    int RestoreFromStore(const std::string& themePath, const std::map<std::string, PatchRecord>& records);
+    // 把当前主题 (不是 nextThemePath 时) 的输出移入存储
+    void StashCurrentTheme(const std::string& nextThemePath);
+    // 删除没有任何安装记录引用的对象
+    void CollectStoreGarbage();
+    // 把修补同一个文件的补丁分成补丁链, 每条链按应用顺序排列
+    static std::vector<std::vector<std::string>> GroupPatchChains(const std::vector<std::string>& bpsFiles,
+                                                                  const std::string& menuContentPath);
+    // 补丁对应的系统菜单原始文件
+    static void ResolveOriginalFile(const std::string& bpsRelPath, const std::string& menuContentPath,
+                                    std::string& originalFilePath, std::string& originalFileName);
+    // 系统菜单原始文件在 SD 卡上的缓存目录 (以 '/' 结尾)
+    std::string GetSourceCacheDir();
     // 内部方法
-    bool CreateCacheFile(const std::string& sourcePath, const std::string& cachePath);
-    bool ApplyBPSPatch(const std::vector<uint8_t>& sourceData, 
-                      const std::vector<uint8_t>& patchData,
-                      std::vector<uint8_t>& outputData);
+    // 对 sourcePath 应用 job 的补丁 (文件或压缩包条目), 失败时不留下输出文件; info 返回补丁记录的校验和
+    // 成功时同时把操作列表编译到 job.compiledPath, 下次同样的补丁和源文件直接重放
+    bool ApplyBPSPatch(const std::string& sourcePath,
+                      const PatchJob& job,
+                      bool verifySource,
+                      BpsStreamPatcher::Info& info);
+    // 一次应用 job 的补丁链, 不生成中间文件
+    BpsStreamPatcher::Result ApplyPatchChain(const std::string& sourcePath, const PatchJob& job,
+                                             bool verifySource, BpsStreamPatcher::Info& info);
     bool CreateDirectoryRecursive(const std::string& path);
     void ScanForBPSFiles(const std::string& basePath, const std::string& currentPath, 
                         std::vector<std::string>& bpsFiles);
@@ -0,0 +1,621 @@
+#include "ThemeRegistry.hpp"
+#include "FileLogger.hpp"
+#include "SimpleJsonParser.hpp"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+static const char* THEMES_ROOT = "fs:/vol/external01/wiiu/themes";
+static const char* UTHEME_ROOT = "fs:/vol/external01/UTheme";
+static const char* INSTALLED_THEMES_ROOT = "fs:/vol/external01/UTheme/installed";
+static const char* REGISTRY_FILE = "fs:/vol/external01/UTheme/registry.txt";
+static const char* REGISTRY_MAGIC = "UTIR";
+static const int REGISTRY_VERSION = 2;
+static const size_t FIELD_COUNT = 16 + ThemeRegistry::IMAGE_COUNT;  // 版本 1 没有最后的 catalogUpdatedAt
+static const char TAG_SEPARATOR = '\x1f';
+
+static const char* IMAGE_NAMES[ThemeRegistry::IMAGE_COUNT] = {
+    "collage_thumb", "collage", "launcher_thumb", "launcher", "warawara_thumb", "warawara"
+};
+
+static std::vector<std::string> SplitFields(const std::string& line, char separator = '\t') {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find(separator, start);
+        if (tab == std::string::npos) {
+            fields.push_back(line.substr(start));
+            break;
+        }
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    return fields;
+}
+
+// 描述等字段可能有换行: 转义后保存在一行里
+static std::string EscapeField(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': break;
+            default: out += c; break;
+        }
+    }
+    return out;
+}
+
+static std::string UnescapeField(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] != '\\' || i + 1 == value.size()) {
+            out += value[i];
+            continue;
+        }
+        char c = value[++i];
+        out += (c == 't') ? '\t' : (c == 'n') ? '\n' : c;
+    }
+    return out;
+}
+
+static bool ReadFile(const std::string& path, std::string& content) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0) {
+        content.reserve(st.st_size);
+    }
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, n);
+    }
+    fclose(file);
+    return true;
+}
+
+// 类型符合时读入, 否则跳过 (例如字段为 null)
+static void ReadStringField(JsonReader& reader, std::string& value) {
+    if (reader.Peek() != JSON_STRING || !reader.ReadString(value)) {
+        reader.Skip();
+    }
+}
+
+static void ReadIntField(JsonReader& reader, int& value) {
+    if (reader.Peek() != JSON_NUMBER || !reader.ReadInt(value)) {
+        reader.Skip();
+    }
+}
+
+// 安装记录中的安装目录, 没有时为空
+static std::string ReadInstallPath(const std::string& content) {
+    JsonReader reader(content);
+    std::string installPath;
+    if (reader.EnterObject() && reader.FindMember("installPath")) {
+        ReadStringField(reader, installPath);
+    }
+    return installPath;
+}
+
+static std::string StripTrailingSlash(std::string path) {
+    while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+static bool IsDirectory(const std::string& path, const struct dirent* entry) {
+    if (entry->d_type == DT_DIR) {
+        return true;
+    }
+    if (entry->d_type != DT_UNKNOWN) {
+        return false;
+    }
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+ThemeRegistry& ThemeRegistry::GetInstance() {
+    static ThemeRegistry instance;
+    return instance;
+}
+
+void ThemeRegistry::ReadTheme(Entry& entry) {
+    // theme_info.json (下载的主题由 ThemeManager 写入, 本地安装的由 LocalInstallScreen 写入)
+    entry.id.clear();
+    entry.author = "Unknown";
+    entry.description.clear();
+    entry.downloads = 0;
+    entry.likes = 0;
+    entry.updatedAt.clear();
+    entry.tags.clear();
+    std::string content;
+    if (ReadFile(entry.path + "/theme_info.json", content)) {
+        // 只读需要的字段, 不构建整个文档
+        JsonReader reader(content);
+        std::string_view key;
+        if (reader.EnterObject()) {
+            while (reader.NextMember(key)) {
+                if (key == "id") {
+                    ReadStringField(reader, entry.id);
+                } else if (key == "author") {
+                    ReadStringField(reader, entry.author);
+                } else if (key == "description") {
+                    ReadStringField(reader, entry.description);
+                } else if (key == "downloads") {
+                    ReadIntField(reader, entry.downloads);
+                } else if (key == "likes") {
+                    ReadIntField(reader, entry.likes);
+                } else if (key == "updatedAt") {
+                    ReadStringField(reader, entry.updatedAt);
+                } else if (key == "tags" && reader.EnterArray()) {
+                    while (reader.NextElement()) {
+                        std::string tag;
+                        if (reader.Peek() == JSON_STRING && reader.ReadString(tag)) {
+                            entry.tags.push_back(std::move(tag));
+                        } else {
+                            reader.Skip();
+                        }
+                    }
+                } else {
+                    reader.Skip();
+                }
+            }
+        }
+        if (reader.HasError()) {
+            FileLogger::GetInstance().LogWarning("[ThemeRegistry] Failed to parse theme_info.json: %s", entry.path.c_str());
+        }
+    }
+
+    // 修补完成的文件 (Men.pack 或 Men2.pack)
+    struct stat st;
+    std::string packagePath = entry.path + "/patched/Common/Package";
+    entry.hasPatched = stat((packagePath + "/Men.pack").c_str(), &st) == 0 ||
+                       stat((packagePath + "/Men2.pack").c_str(), &st) == 0;
+
+    // 目录中的 BPS 文件 (从压缩包安装的主题没有, 补丁留在压缩包里)
+    entry.bpsCount = 0;
+    DIR* dir = opendir(entry.path.c_str());
+    if (dir) {
+        struct dirent* dirEntry;
+        while ((dirEntry = readdir(dir)) != nullptr) {
+            size_t length = strlen(dirEntry->d_name);
+            if (length > 4 && strcmp(dirEntry->d_name + length - 4, ".bps") == 0) {
+                entry.bpsCount++;
+            }
+        }
+        closedir(dir);
+    }
+
+    // 预览图: 新格式在 images/ 子目录, 旧格式在主题根目录; 支持多种扩展名
+    std::string imagesDir = entry.path + "/images";
+    std::string base = (stat(imagesDir.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) ? imagesDir : entry.path;
+    const char* extensions[] = {".webp", ".jpg", ".jpeg", ".png"};
+    for (int i = 0; i < IMAGE_COUNT; i++) {
+        std::string basePath = base + "/" + IMAGE_NAMES[i];
+        entry.images[i] = basePath + ".jpg";  // 都不存在时的默认值
+        for (const char* ext : extensions) {
+            if (stat((basePath + ext).c_str(), &st) == 0) {
+                entry.images[i] = basePath + ext;
+                break;
+            }
+        }
+    }
+}
+
+bool ThemeRegistry::ReadInstallRecord(const std::string& themeID, Entry& entry) {
+    entry.installed = false;
+    entry.themeID.clear();
+    entry.themeName.clear();
+    entry.themeAuthor.clear();
+    entry.themeVersion.clear();
+    std::string content;
+    if (themeID.empty() || !ReadFile(std::string(INSTALLED_THEMES_ROOT) + "/" + themeID + ".json", content)) {
+        return false;
+    }
+
+    entry.installed = true;
+    entry.themeID = themeID;
+    JsonReader reader(content);
+    std::string_view key;
+    std::string installPath;
+    if (reader.EnterObject()) {
+        while (reader.NextMember(key)) {
+            if (key == "installPath") {
+                ReadStringField(reader, installPath);
+            } else if (key == "themeName") {
+                ReadStringField(reader, entry.themeName);
+            } else if (key == "themeAuthor") {
+                ReadStringField(reader, entry.themeAuthor);
+            } else if (key == "themeVersion") {
+                ReadStringField(reader, entry.themeVersion);
+            } else {
+                reader.Skip();
+            }
+        }
+    }
+    if (reader.HasError()) {
+        // 旧版本写出的记录可能不是合法的 JSON (名称没有转义), 仍然算作已安装
+        FileLogger::GetInstance().LogWarning("[ThemeRegistry] Failed to parse install record: %s", themeID.c_str());
+    }
+    // 同一个 ID 的记录属于另一个目录时不算在这个目录上
+    if (!installPath.empty() && StripTrailingSlash(installPath) != entry.path) {
+        entry.installed = false;
+        entry.themeID.clear();
+        entry.themeName.clear();
+        entry.themeAuthor.clear();
+        entry.themeVersion.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ThemeRegistry::Load() {
+    std::string content;
+    if (!ReadFile(REGISTRY_FILE, content)) {
+        return false;
+    }
+
+    mEntries.clear();
+    size_t start = 0;
+    bool header = true;
+    int version = 0;
+    while (start < content.size()) {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos) {
+            break;  // 没写完的最后一行
+        }
+        std::vector<std::string> fields = SplitFields(content.substr(start, end - start));
+        start = end + 1;
+
+        if (header) {
+            header = false;
+            version = fields.size() >= 2 ? atoi(fields[1].c_str()) : 0;
+            if (fields[0] != REGISTRY_MAGIC || version < 1 || version > REGISTRY_VERSION) {
+                FileLogger::GetInstance().LogWarning("[ThemeRegistry] Registry version mismatch, rebuilding");
+                return false;
+            }
+            continue;
+        }
+
+        // dirName installed themeID themeName themeAuthor themeVersion id author description
+        // downloads likes updatedAt tags hasPatched bpsCount images... catalogUpdatedAt
+        if (fields.size() != FIELD_COUNT - (version == 1 ? 1 : 0) || fields[0].empty()) {
+            continue;
+        }
+        Entry entry;
+        entry.dirName = UnescapeField(fields[0]);
+        entry.path = std::string(THEMES_ROOT) + "/" + entry.dirName;
+        entry.installed = fields[1] == "1";
+        entry.themeID = UnescapeField(fields[2]);
+        entry.themeName = UnescapeField(fields[3]);
+        entry.themeAuthor = UnescapeField(fields[4]);
+        entry.themeVersion = UnescapeField(fields[5]);
+        entry.id = UnescapeField(fields[6]);
+        entry.author = UnescapeField(fields[7]);
+        entry.description = UnescapeField(fields[8]);
+        entry.downloads = atoi(fields[9].c_str());
+        entry.likes = atoi(fields[10].c_str());
+        entry.updatedAt = UnescapeField(fields[11]);
+        if (!fields[12].empty()) {
+            for (const std::string& tag : SplitFields(fields[12], TAG_SEPARATOR)) {
+                entry.tags.push_back(UnescapeField(tag));
+            }
+        }
+        entry.hasPatched = fields[13] == "1";
+        entry.bpsCount = atoi(fields[14].c_str());
+        for (int i = 0; i < IMAGE_COUNT; i++) {
+            entry.images[i] = entry.path + "/" + UnescapeField(fields[15 + i]);
+        }
+        if (version >= 2) {
+            entry.catalogUpdatedAt = UnescapeField(fields[15 + IMAGE_COUNT]);
+        }
+        mEntries[entry.dirName] = std::move(entry);
+    }
+    return !header;
+}
+
+bool ThemeRegistry::Save() {
+    std::string content = std::string(REGISTRY_MAGIC) + "\t" + std::to_string(REGISTRY_VERSION) + "\n";
+    for (const auto& pair : mEntries) {
+        const Entry& entry = pair.second;
+        std::string tags;
+        for (size_t i = 0; i < entry.tags.size(); i++) {
+            if (i > 0) tags += TAG_SEPARATOR;
+            tags += EscapeField(entry.tags[i]);
+        }
+        content += EscapeField(entry.dirName) + "\t" + (entry.installed ? "1" : "0") + "\t" +
+                   EscapeField(entry.themeID) + "\t" + EscapeField(entry.themeName) + "\t" +
+                   EscapeField(entry.themeAuthor) + "\t" + EscapeField(entry.themeVersion) + "\t" +
+                   EscapeField(entry.id) + "\t" + EscapeField(entry.author) + "\t" +
+                   EscapeField(entry.description) + "\t" + std::to_string(entry.downloads) + "\t" +
+                   std::to_string(entry.likes) + "\t" + EscapeField(entry.updatedAt) + "\t" + tags + "\t" +
+                   (entry.hasPatched ? "1" : "0") + "\t" + std::to_string(entry.bpsCount);
+        // 预览图保存相对主题目录的路径
+        for (int i = 0; i < IMAGE_COUNT; i++) {
+            content += "\t" + EscapeField(entry.images[i].substr(entry.path.length() + 1));
+        }
+        content += "\t" + EscapeField(entry.catalogUpdatedAt) + "\n";
+    }
+
+    mkdir(UTHEME_ROOT, 0777);
+    std::string tempPath = std::string(REGISTRY_FILE) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "w");
+    if (!file) {
+        FileLogger::GetInstance().LogError("[ThemeRegistry] Failed to write registry: %s", tempPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+    ok = (fclose(file) == 0) && ok;
+
+    remove(REGISTRY_FILE);
+    if (!ok || rename(tempPath.c_str(), REGISTRY_FILE) != 0) {
+        remove(tempPath.c_str());
+        FileLogger::GetInstance().LogError("[ThemeRegistry] Failed to save registry");
+        return false;
+    }
+    return true;
+}
+
+void ThemeRegistry::Rebuild() {
+    mEntries.clear();
+
+    // 安装记录: 安装目录 -> 主题 ID
+    std::map<std::string, std::string> recordIDs;
+    DIR* dir = opendir(INSTALLED_THEMES_ROOT);
+    if (dir) {
+        struct dirent* dirEntry;
+        while ((dirEntry = readdir(dir)) != nullptr) {
+            std::string filename = dirEntry->d_name;
+            if (filename.length() <= 5 || filename.substr(filename.length() - 5) != ".json") {
+                continue;
+            }
+            std::string themeID = filename.substr(0, filename.length() - 5);
+            std::string content;
+            if (!ReadFile(std::string(INSTALLED_THEMES_ROOT) + "/" + filename, content)) {
+                continue;
+            }
+            std::string installPath = ReadInstallPath(content);
+            if (!installPath.empty()) {
+                recordIDs[StripTrailingSlash(installPath)] = themeID;
+            }
+        }
+        closedir(dir);
+    }
+
+    dir = opendir(THEMES_ROOT);
+    if (!dir) {
+        FileLogger::GetInstance().LogError("[ThemeRegistry] Failed to open themes directory");
+        return;
+    }
+    struct dirent* dirEntry;
+    while ((dirEntry = readdir(dir)) != nullptr) {
+        if (strcmp(dirEntry->d_name, ".") == 0 || strcmp(dirEntry->d_name, "..") == 0) {
+            continue;
+        }
+        Entry entry;
+        entry.dirName = dirEntry->d_name;
+        entry.path = std::string(THEMES_ROOT) + "/" + entry.dirName;
+        if (!IsDirectory(entry.path, dirEntry)) {
+            continue;
+        }
+        ReadTheme(entry);
+        auto record = recordIDs.find(entry.path);
+        ReadInstallRecord(record != recordIDs.end() ? record->second : entry.id, entry);
+        mEntries[entry.dirName] = std::move(entry);
+    }
+    closedir(dir);
+    FileLogger::GetInstance().LogInfo("[ThemeRegistry] Rebuilt registry: %zu theme(s)", mEntries.size());
+}
+
+void ThemeRegistry::EnsureLoaded() {
+    if (mLoaded) {
+        return;
+    }
+    mLoaded = true;
+
+    if (!Load()) {
+        Rebuild();
+        Save();
+        return;
+    }
+
+    // 登记表之外添加或删除的目录 (比如直接复制到 SD 卡上): 只读一次目录列表, 已登记的目录不再打开
+    DIR* dir = opendir(THEMES_ROOT);
+    if (!dir) {
+        return;
+    }
+    bool changed = false;
+    std::set<std::string> seen;
+    struct dirent* dirEntry;
+    while ((dirEntry = readdir(dir)) != nullptr) {
+        if (strcmp(dirEntry->d_name, ".") == 0 || strcmp(dirEntry->d_name, "..") == 0) {
+            continue;
+        }
+        std::string dirName = dirEntry->d_name;
+        std::string path = std::string(THEMES_ROOT) + "/" + dirName;
+        if (!IsDirectory(path, dirEntry)) {
+            continue;
+        }
+        seen.insert(dirName);
+        if (mEntries.count(dirName)) {
+            continue;
+        }
+        Entry entry;
+        entry.dirName = dirName;
+        entry.path = path;
+        ReadTheme(entry);
+        ReadInstallRecord(entry.id, entry);
+        mEntries[dirName] = std::move(entry);
+        changed = true;
+    }
+    closedir(dir);
+
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (seen.count(it->first)) {
+            ++it;
+        } else {
+            it = mEntries.erase(it);
+            changed = true;
+        }
+    }
+    if (changed) {
+        Save();
+    }
+    FileLogger::GetInstance().LogInfo("[ThemeRegistry] %zu registered theme(s)", mEntries.size());
+}
+
+std::vector<ThemeRegistry::Entry> ThemeRegistry::GetThemes() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    std::vector<Entry> themes;
+    themes.reserve(mEntries.size());
+    for (const auto& pair : mEntries) {
+        themes.push_back(pair.second);
+    }
+    return themes;
+}
+
+void ThemeRegistry::ForEachTheme(const std::function<void(const Entry&)>& visit) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    for (const auto& pair : mEntries) {
+        visit(pair.second);
+    }
+}
+
+size_t ThemeRegistry::GetThemeCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    return mEntries.size();
+}
+
+std::set<std::string> ThemeRegistry::GetInstalledIDs() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    std::set<std::string> ids;
+    for (const auto& pair : mEntries) {
+        if (pair.second.installed) {
+            ids.insert(pair.second.themeID);
+        }
+    }
+    return ids;
+}
+
+bool ThemeRegistry::IsInstalled(const std::string& themeID) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    for (const auto& pair : mEntries) {
+        if (pair.second.installed && pair.second.themeID == themeID) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThemeRegistry::UpdateTheme(const std::string& themePath, const std::string& themeID) {
+    std::string path = StripTrailingSlash(themePath);
+    std::string dirName = path.substr(path.find_last_of('/') + 1);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    struct stat st;
+    if (dirName.empty() || stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        if (mEntries.erase(dirName)) {
+            Save();
+        }
+        return;
+    }
+
+    Entry entry;
+    entry.dirName = dirName;
+    entry.path = std::string(THEMES_ROOT) + "/" + dirName;
+    ReadTheme(entry);
+    auto previous = mEntries.find(dirName);
+    std::string recordID = themeID;
+    if (recordID.empty()) {
+        recordID = (previous != mEntries.end() && previous->second.installed) ? previous->second.themeID : entry.id;
+    }
+    ReadInstallRecord(recordID, entry);
+    // 目录中的版本留到下次同步; 重新安装后 updatedAt 变新, HasUpdate 自然变为 false
+    bool hadUpdate = false;
+    if (previous != mEntries.end()) {
+        entry.catalogUpdatedAt = previous->second.catalogUpdatedAt;
+        hadUpdate = previous->second.HasUpdate();
+    }
+    bool hasUpdate = entry.HasUpdate();
+    mEntries[dirName] = std::move(entry);
+    Save();
+    if (hadUpdate != hasUpdate) {
+        mUpdatesVersion.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void ThemeRegistry::Preload() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+}
+
+void ThemeRegistry::RemoveTheme(const std::string& themePath) {
+    std::string path = StripTrailingSlash(themePath);
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    if (mEntries.erase(path.substr(path.find_last_of('/') + 1))) {
+        Save();
+    }
+}
+
+void ThemeRegistry::RemoveThemes(const std::vector<std::string>& themePaths) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    size_t removed = 0;
+    for (const std::string& themePath : themePaths) {
+        std::string path = StripTrailingSlash(themePath);
+        removed += mEntries.erase(path.substr(path.find_last_of('/') + 1));
+    }
+    if (removed > 0) {
+        Save();
+    }
+}
+
+size_t ThemeRegistry::ApplyCatalogUpdates(const std::unordered_map<std::string, std::string>& catalog) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    EnsureLoaded();
+    bool changed = false;
+    bool flagsChanged = false;
+    size_t updates = 0;
+    for (auto& pair : mEntries) {
+        Entry& entry = pair.second;
+        const std::string& key = entry.id.empty() ? entry.themeID : entry.id;
+        auto it = key.empty() ? catalog.end() : catalog.find(key);
+        const std::string& catalogUpdatedAt = it != catalog.end() ? it->second : std::string();
+        if (entry.catalogUpdatedAt == catalogUpdatedAt) {
+            updates += entry.HasUpdate() ? 1 : 0;
+            continue;
+        }
+        bool hadUpdate = entry.HasUpdate();
+        entry.catalogUpdatedAt = catalogUpdatedAt;
+        bool hasUpdate = entry.HasUpdate();
+        updates += hasUpdate ? 1 : 0;
+        flagsChanged = flagsChanged || hadUpdate != hasUpdate;
+        changed = true;
+    }
+    if (changed) {
+        Save();
+    }
+    if (flagsChanged) {
+        mUpdatesVersion.fetch_add(1, std::memory_order_release);
+    }
+    FileLogger::GetInstance().LogInfo("[ThemeRegistry] %zu theme update(s) available", updates);
+    return updates;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+// 已安装主题的登记表: wiiu/themes 下每个主题目录的信息 (theme_info.json、安装记录、补丁输出、预览图)
+// 整个表保存在一个文件中, 安装、卸载和预览图下载完成时更新 (先写临时文件再改名)
+// 各界面只从内存读取; 第一次使用时读入登记表, 再读一次 wiiu/themes 目录补上在别处添加或删除的主题
+// 登记表不存在时 (第一次运行) 扫描所有主题目录重建
+class ThemeRegistry {
+public:
+    enum Image {
+        IMAGE_COLLAGE_THUMB,
+        IMAGE_COLLAGE,
+        IMAGE_LAUNCHER_THUMB,
+        IMAGE_LAUNCHER,
+        IMAGE_WARAWARA_THUMB,
+        IMAGE_WARAWARA,
+        IMAGE_COUNT
+    };
+
+    struct Entry {
+        std::string dirName;        // wiiu/themes 下的目录名
+        std::string path;           // 主题目录的完整路径
+        // 安装记录 (UTheme/installed/<themeID>.json), installed 为 false 时为空
+        bool installed = false;
+        std::string themeID;
+        std::string themeName;
+        std::string themeAuthor;
+        std::string themeVersion;
+        // theme_info.json (没有时 author 为 "Unknown")
+        std::string id;
+        std::string author;
+        std::string description;
+        int downloads = 0;
+        int likes = 0;
+        std::string updatedAt;
+        std::vector<std::string> tags;
+        // 目录内容
+        bool hasPatched = false;    // patched/Common/Package 下有 Men.pack 或 Men2.pack
+        int bpsCount = 0;           // 目录中的 .bps 文件数
+        std::string images[IMAGE_COUNT];  // 预览图路径 (找不到时是默认的 .jpg 路径)
+        // 上次同步时目录中这个主题的 updatedAt (不在目录中或还没同步过时为空)
+        std::string catalogUpdatedAt;
+
+        // 目录中的版本比安装的新 (updatedAt 是 ISO 8601 时间, 可以直接比较字符串)
+        bool HasUpdate() const {
+            return !updatedAt.empty() && !catalogUpdatedAt.empty() && catalogUpdatedAt > updatedAt;
+        }
+    };
+
+    static ThemeRegistry& GetInstance();
+
+    // 预先读入登记表 (菜单预热, 在任务线程中调用), 之后第一次使用时不用再读文件
+    void Preload();
+
+    // 所有主题目录, 按目录名排序
+    std::vector<Entry> GetThemes();
+    // 按目录名顺序访问每个条目, 不复制; visit 在持有登记表的锁时调用, 不能再调用登记表
+    void ForEachTheme(const std::function<void(const Entry&)>& visit);
+    size_t GetThemeCount();
+    // 有安装记录的主题 ID
+    std::set<std::string> GetInstalledIDs();
+    bool IsInstalled(const std::string& themeID);
+
+    // 主题目录或安装记录改变后调用: 重新读取这个目录并保存登记表
+    // themeID 为空时使用 theme_info.json 中的 id 或原来记录的 ID 查找安装记录
+    void UpdateTheme(const std::string& themePath, const std::string& themeID = "");
+    // 主题被删除后调用
+    void RemoveTheme(const std::string& themePath);
+    // 一次删除多个主题后调用, 只保存一次登记表
+    void RemoveThemes(const std::vector<std::string>& themePaths);
+
+    // 每次同步主题目录后调用 (任务线程): catalog 为目录中每个主题的 id -> updatedAt
+    // 用主题 ID (theme_info.json 的 id, 没有时用安装记录的 ID) 查表, 一遍完成; 有变化时保存登记表
+    // 返回有更新的主题数
+    size_t ApplyCatalogUpdates(const std::unordered_map<std::string, std::string>& catalog);
+    // 每次更新标记改变时加一, 界面据此决定是否重新读取
+    uint32_t GetUpdatesVersion() const { return mUpdatesVersion.load(std::memory_order_acquire); }
+
+private:
+    ThemeRegistry() = default;
+    ThemeRegistry(const ThemeRegistry&) = delete;
+    ThemeRegistry& operator=(const ThemeRegistry&) = delete;
+
+    std::mutex mMutex;
+    bool mLoaded = false;
+    std::map<std::string, Entry> mEntries;  // 目录名 -> 条目
+    std::atomic<uint32_t> mUpdatesVersion{0};
+
+    // 以下调用时持有 mMutex
+    void EnsureLoaded();
+    bool Load();
+    void Rebuild();
+    bool Save();
+    static void ReadTheme(Entry& entry);
+    static bool ReadInstallRecord(const std::string& themeID, Entry& entry);
+};
@@ -0,0 +1,184 @@
+#include "Trace.hpp"
+#include "FileLogger.hpp"
+#include <coreinit/thread.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+
+namespace {
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    OSTime start;
+    OSTime end;
+    uint32_t tid;
+    uint32_t core;
+    char detail[Trace::DETAIL_LENGTH];
+};
+
+struct TraceThread {
+    uint32_t tid;
+    char name[32];
+};
+
+std::unique_ptr<TraceEvent[]> sEvents;          // Start 时分配
+std::atomic<size_t> sNextEvent{0};              // 下一个空位, 可能超过 MAX_EVENTS (丢弃的事件)
+std::atomic<int> sWriters{0};                   // 正在写入事件的线程数, Stop 等它归零
+OSTime sStartTime = 0;
+uint32_t sSession = 0;                          // 每次 Start 递增, 线程在新的记录中重新登记名字
+
+std::mutex sThreadMutex;
+TraceThread sThreads[Trace::MAX_THREADS];
+size_t sThreadCount = 0;
+thread_local uint32_t tRegisteredSession = 0;
+
+void RegisterThread(uint32_t tid, OSThread* thread) {
+    std::lock_guard<std::mutex> lock(sThreadMutex);
+    if (sThreadCount >= Trace::MAX_THREADS) {
+        return;
+    }
+    TraceThread& entry = sThreads[sThreadCount++];
+    entry.tid = tid;
+    const char* name = OSGetThreadName(thread);
+    snprintf(entry.name, sizeof(entry.name), "%s", name ? name : "thread");
+}
+
+// JSON 字符串中需要转义的字符换成空格, 说明文字只用来辨认
+void WriteEscaped(FILE* file, const char* text) {
+    for (const char* p = text; *p; p++) {
+        char c = *p;
+        fputc(c == '"' || c == '\\' || (unsigned char) c < 0x20 ? ' ' : c, file);
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Trace::sRecording{false};
+
+void Trace::Start() {
+    if (IsRecording()) {
+        return;
+    }
+    if (!sEvents) {
+        sEvents.reset(new (std::nothrow) TraceEvent[MAX_EVENTS]);
+        if (!sEvents) {
+            FileLogger::GetInstance().LogError("[Trace] Not enough memory for the event buffer");
+            return;
+        }
+    }
+    sNextEvent.store(0);
+    {
+        std::lock_guard<std::mutex> lock(sThreadMutex);
+        sThreadCount = 0;
+    }
+    sSession++;
+    sStartTime = OSGetSystemTime();
+    sRecording.store(true);
+    FileLogger::GetInstance().LogInfo("[Trace] Recording started");
+}
+
+void Trace::Record(const char* category, const char* name, OSTime start, OSTime end, const char* detail) {
+    // 先登记为写入者再检查, Stop 清除标记后等待已经进入的写入者
+    sWriters.fetch_add(1, std::memory_order_acquire);
+    if (sRecording.load(std::memory_order_relaxed)) {
+        size_t index = sNextEvent.fetch_add(1, std::memory_order_relaxed);
+        if (index < MAX_EVENTS) {
+            OSThread* thread = OSGetCurrentThread();
+            uint32_t tid = (uint32_t)(uintptr_t) thread;
+            if (tRegisteredSession != sSession) {
+                tRegisteredSession = sSession;
+                RegisterThread(tid, thread);
+            }
+
+            TraceEvent& event = sEvents[index];
+            event.category = category;
+            event.name = name;
+            event.start = std::max(start, sStartTime);  // 记录开始前已经在进行的传输
+            event.end = end;
+            event.tid = tid;
+            event.core = OSGetCoreId();
+            event.detail[0] = '\0';
+            if (detail && *detail) {
+                // 路径和地址的末尾最有辨识度
+                size_t length = strlen(detail);
+                const char* tail = detail + (length >= DETAIL_LENGTH ? length - (DETAIL_LENGTH - 1) : 0);
+                snprintf(event.detail, sizeof(event.detail), "%s", tail);
+            }
+        }
+    }
+    sWriters.fetch_sub(1, std::memory_order_release);
+}
+
+bool Trace::Stop(std::string& path) {
+    if (!IsRecording()) {
+        return false;
+    }
+    sRecording.store(false);
+    while (sWriters.load(std::memory_order_acquire) != 0) {
+        OSSleepTicks(OSMillisecondsToTicks(1));
+    }
+
+    struct stat st;
+    if (stat(ROOT, &st) != 0) {
+        mkdir(ROOT, 0755);
+    }
+    OSCalendarTime calendar;
+    OSTicksToCalendarTime(OSGetTime(), &calendar);
+    char name[64];
+    snprintf(name, sizeof(name), "/trace-%04d%02d%02d-%02d%02d%02d.json", calendar.tm_year, calendar.tm_mon + 1,
+             calendar.tm_mday, calendar.tm_hour, calendar.tm_min, calendar.tm_sec);
+    path = std::string(ROOT) + name;
+
+    bool ok = WriteJson(path);
+    size_t recorded = sNextEvent.load();
+    if (ok) {
+        FileLogger::GetInstance().LogInfo("[Trace] Wrote %zu events to %s (%zu dropped)", std::min(recorded, MAX_EVENTS),
+                                          path.c_str(), recorded > MAX_EVENTS ? recorded - MAX_EVENTS : 0);
+    } else {
+        FileLogger::GetInstance().LogError("[Trace] Failed to write %s", path.c_str());
+    }
+    // 缓冲区不常用, 写完就释放
+    sEvents.reset();
+    return ok;
+}
+
+bool Trace::WriteJson(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    static char buffer[64 * 1024];
+    setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    {
+        std::lock_guard<std::mutex> lock(sThreadMutex);
+        for (size_t i = 0; i < sThreadCount; i++) {
+            fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"",
+                    (unsigned) sThreads[i].tid);
+            WriteEscaped(file, sThreads[i].name);
+            fputs("\"}},\n", file);
+        }
+    }
+
+    const size_t count = std::min(sNextEvent.load(), MAX_EVENTS);
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent& event = sEvents[i];
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":0,\"tid\":%u,"
+                      "\"args\":{\"core\":%u,\"detail\":\"",
+                event.name, event.category, (unsigned long long) OSTicksToMicroseconds(event.start - sStartTime),
+                (unsigned long long) OSTicksToMicroseconds(event.end - event.start), (unsigned) event.tid,
+                (unsigned) event.core);
+        WriteEscaped(file, event.detail);
+        fputs("\"}},\n", file);
+    }
+    // 最后写进程名, 前面的每个事件都可以带逗号
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"UTheme\"}}\n]}\n", file);
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <coreinit/time.h>
+
+// 后台流水线的时间线记录: 下载传输、图片解码和上传、解压、补丁、备份复制等各记录一段 (开始和结束时间、线程、核心)
+// 记录开始后事件存放在内存中的固定缓冲区 (满了之后丢弃), 停止时写成 Chrome Trace Event JSON,
+// 用 chrome://tracing 或 Perfetto 打开, 可以看出各阶段的重叠、等待和关键路径
+// 没有在记录时 Record 只读一个原子变量; Record 可以在任何线程调用, Start / Stop 只在主线程调用
+class Trace {
+public:
+    static constexpr size_t MAX_EVENTS = 8192;
+    static constexpr size_t DETAIL_LENGTH = 48;   // 附加说明 (文件名、地址) 保留的长度, 超出时保留末尾
+    static constexpr size_t MAX_THREADS = 32;
+    static constexpr const char* ROOT = "fs:/vol/external01/UTheme/trace";
+
+    static bool IsRecording() { return sRecording.load(std::memory_order_relaxed); }
+
+    // 清空缓冲区开始记录
+    static void Start();
+    // 停止记录并写出 JSON, 成功时 path 为写出的文件
+    static bool Stop(std::string& path);
+
+    // 记录一段 [start, end); category 和 name 必须是字符串常量, detail 会被复制
+    static void Record(const char* category, const char* name, OSTime start, OSTime end, const char* detail = nullptr);
+
+    // 作用域计时, 析构时记录
+    class Span {
+    public:
+        Span(const char* category, const char* name, const std::string& detail = std::string())
+            : mCategory(category), mName(name), mStart(IsRecording() ? OSGetSystemTime() : 0) {
+            if (mStart) {
+                mDetail = detail;
+            }
+        }
+        ~Span() {
+            if (mStart) {
+                Record(mCategory, mName, mStart, OSGetSystemTime(), mDetail.c_str());
+            }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* mCategory;
+        const char* mName;
+        OSTime mStart;
+        std::string mDetail;
+    };
+
+private:
+    static bool WriteJson(const std::string& path);
+
+    static std::atomic<bool> sRecording;
+};
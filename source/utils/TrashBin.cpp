@@ -0,0 +1,185 @@
+#include "TrashBin.hpp"
+#include "FileLogger.hpp"
+#include "IdleTasks.hpp"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+static const char* UTHEME_DIR = "fs:/vol/external01/UTheme";
+static const char* TRASH_DIR = "fs:/vol/external01/UTheme/trash";
+// 每删除这么多项暂停一下, 让前台 (比如随后开始的安装) 的文件操作先进行;
+// 界面不空闲时 (有输入、正在安装) 一直等到空闲, 浏览时不和图片加载争用 SD 卡
+static const int DELETE_BATCH = 32;
+static const int BUSY_POLL_MS = 100;
+
+static std::mutex sMutex;
+static std::condition_variable sCv;
+static std::deque<std::string> sQueue;   // 等待删除的回收站条目
+static std::thread sThread;
+static std::atomic<bool> sStop{false};
+static unsigned sNextId = 0;
+
+// d_type 在某些文件系统上不可靠, 不确定时用 stat 判断
+static bool IsDirectoryEntry(const std::string& path, const struct dirent* entry) {
+    if (entry->d_type == DT_DIR) {
+        return true;
+    }
+    if (entry->d_type != DT_UNKNOWN) {
+        return false;
+    }
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// 递归删除; stop 不为空时每项检查一次, 要求停止就返回 false (已删除的部分不恢复)
+// batch 计数已删除的项, 每满 DELETE_BATCH 暂停一下并等待界面空闲 (为空时不暂停)
+static bool DeleteTree(const std::string& path, const std::atomic<bool>* stop, int* batch) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return true;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return unlink(path.c_str()) == 0;
+    }
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        FileLogger::GetInstance().LogError("[TrashBin] Failed to open directory: %s", path.c_str());
+        return false;
+    }
+    bool success = true;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (stop && stop->load()) {
+            closedir(dir);
+            return false;
+        }
+        std::string fullPath = path + "/" + entry->d_name;
+        if (IsDirectoryEntry(fullPath, entry)) {
+            if (!DeleteTree(fullPath, stop, batch)) {
+                success = false;
+                if (stop && stop->load()) {
+                    closedir(dir);
+                    return false;
+                }
+            }
+        } else if (unlink(fullPath.c_str()) != 0) {
+            FileLogger::GetInstance().LogError("[TrashBin] Failed to delete file: %s", fullPath.c_str());
+            success = false;
+        }
+        if (batch && ++*batch >= DELETE_BATCH) {
+            *batch = 0;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            while (stop && !stop->load() && !IdleTasks::IsIdle()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(BUSY_POLL_MS));
+            }
+        }
+    }
+    closedir(dir);
+
+    if (rmdir(path.c_str()) != 0) {
+        FileLogger::GetInstance().LogError("[TrashBin] Failed to delete directory: %s", path.c_str());
+        return false;
+    }
+    return success;
+}
+
+static void WorkerThread() {
+    int batch = 0;
+    std::unique_lock<std::mutex> lock(sMutex);
+    while (true) {
+        sCv.wait(lock, [] { return !sQueue.empty() || sStop.load(); });
+        if (sStop.load()) {
+            break;
+        }
+        std::string path = sQueue.front();
+        sQueue.pop_front();
+        lock.unlock();
+        if (DeleteTree(path, &sStop, &batch)) {
+            FileLogger::GetInstance().LogInfo("[TrashBin] Deleted %s", path.c_str());
+        }
+        lock.lock();
+    }
+}
+
+// 调用时持有 sMutex
+static void Enqueue(const std::string& path) {
+    sQueue.push_back(path);
+    if (!sThread.joinable()) {
+        sStop = false;
+        sThread = std::thread(WorkerThread);
+    }
+    sCv.notify_one();
+}
+
+void TrashBin::Init() {
+    DIR* dir = opendir(TRASH_DIR);
+    if (!dir) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(sMutex);
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        Enqueue(std::string(TRASH_DIR) + "/" + entry->d_name);
+        count++;
+    }
+    closedir(dir);
+    if (count > 0) {
+        FileLogger::GetInstance().LogInfo("[TrashBin] Deleting %d leftover item(s)", count);
+    }
+}
+
+void TrashBin::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        sStop = true;
+        sCv.notify_one();
+    }
+    if (sThread.joinable()) {
+        sThread.join();
+    }
+    sQueue.clear();
+}
+
+bool TrashBin::Remove(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return true;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return unlink(path.c_str()) == 0;
+    }
+
+    mkdir(UTHEME_DIR, 0777);
+    mkdir(TRASH_DIR, 0777);
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        // 名称只需要在回收站里唯一; 上次留下的条目可能占用了同样的名称
+        std::string trashPath;
+        do {
+            trashPath = std::string(TRASH_DIR) + "/" + std::to_string(sNextId++);
+        } while (stat(trashPath.c_str(), &st) == 0);
+
+        if (rename(path.c_str(), trashPath.c_str()) == 0) {
+            Enqueue(trashPath);
+            return true;
+        }
+    }
+    FileLogger::GetInstance().LogWarning("[TrashBin] Cannot move %s to trash, deleting in place", path.c_str());
+    return DeleteTree(path, nullptr, nullptr);
+}
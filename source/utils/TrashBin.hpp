@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+// 后台删除目录: 先把目录改名移到 UTheme/trash/ 下 (同一张 SD 卡上, 改名是即时的),
+// 再由后台线程分批删除其中的内容 (界面空闲时才继续, 见 IdleTasks), 调用者不用等待整个目录树删完
+// 程序退出时没删完的内容留在 trash/ 下, 下次启动时 (Init) 继续删除
+class TrashBin {
+public:
+    // 启动时调用: 继续删除上次留下的内容
+    static void Init();
+    // 退出时调用: 停止后台线程 (删到一半的目录留到下次启动)
+    static void Shutdown();
+
+    // 移除文件或目录: 目录移到回收站后在后台删除, 不能改名时 (比如不在 SD 卡上) 直接删除
+    // path 已经不存在时返回 true
+    static bool Remove(const std::string& path);
+};
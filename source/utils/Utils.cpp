@@ -1,5 +1,6 @@
 #include "Utils.hpp"
 #include "logger.h"
+#include <cstdint>
 #include <cstring>
 
 #include <coreinit/debug.h>
@@ -229,4 +230,67 @@ namespace Utils {
         return safe;
     }
 
+    // 解码 text[pos] 开始的一个 UTF-8 字符, 返回字节数 (非法序列按 1 字节处理)
+    static size_t DecodeUtf8(std::string_view text, size_t pos, uint32_t& codepoint) {
+        unsigned char c = (unsigned char)text[pos];
+        size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 1;
+        if (pos + length > text.size()) {
+            length = 1;
+        }
+        codepoint = length == 1 ? c : c & (0xff >> (length + 1));
+        for (size_t i = 1; i < length; i++) {
+            unsigned char next = (unsigned char)text[pos + i];
+            if ((next & 0xc0) != 0x80) {
+                codepoint = c;
+                return 1;
+            }
+            codepoint = (codepoint << 6) | (next & 0x3f);
+        }
+        return length;
+    }
+
+    // 中日韩、谚文、全角字符和表情的显示宽度按 2 列计算
+    static size_t DisplayColumns(uint32_t codepoint) {
+        if ((codepoint >= 0x1100 && codepoint <= 0x115f) ||
+            (codepoint >= 0x2e80 && codepoint <= 0xa4cf) ||
+            (codepoint >= 0xac00 && codepoint <= 0xd7a3) ||
+            (codepoint >= 0xf900 && codepoint <= 0xfaff) ||
+            (codepoint >= 0xfe30 && codepoint <= 0xfe4f) ||
+            (codepoint >= 0xff00 && codepoint <= 0xff60) ||
+            (codepoint >= 0xffe0 && codepoint <= 0xffe6) ||
+            (codepoint >= 0x1f300 && codepoint <= 0x1faff) ||
+            (codepoint >= 0x20000 && codepoint <= 0x3fffd)) {
+            return 2;
+        }
+        return 1;
+    }
+
+    std::string TruncateForDisplay(std::string_view text, size_t maxColumns) {
+        size_t lineEnd = text.find('\n');
+        if (lineEnd != std::string_view::npos) {
+            text = text.substr(0, lineEnd);
+        }
+        if (!text.empty() && text.back() == '\r') {
+            text.remove_suffix(1);
+        }
+
+        // cut 为保留 "..." 的位置时能放下的最后一个字符边界
+        const size_t ellipsisColumns = 3;
+        size_t columns = 0;
+        size_t cut = 0;
+        for (size_t pos = 0; pos < text.size();) {
+            uint32_t codepoint;
+            size_t length = DecodeUtf8(text, pos, codepoint);
+            columns += DisplayColumns(codepoint);
+            if (columns > maxColumns) {
+                return std::string(text.substr(0, cut)) + "...";
+            }
+            pos += length;
+            if (columns + ellipsisColumns <= maxColumns) {
+                cut = pos;
+            }
+        }
+        return std::string(text);
+    }
+
 } // namespace Utils
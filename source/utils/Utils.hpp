@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace Utils {
 
@@ -30,4 +31,8 @@ namespace Utils {
     // 清理主题名称中的特殊Unicode字符用于显示
     std::string SanitizeThemeNameForDisplay(const std::string& themeName);
 
+    // 只取第一行, 按显示宽度截断到 maxColumns 列 (中日韩和全角字符算 2 列), 截断时末尾加 "..."
+    // 只在 UTF-8 字符边界截断, 不会切开多字节字符
+    std::string TruncateForDisplay(std::string_view text, size_t maxColumns);
+
 } // namespace Utils
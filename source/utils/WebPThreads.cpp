@@ -0,0 +1,129 @@
+#include "WebPThreads.hpp"
+#include "FileLogger.hpp"
+#include "src/utils/thread_utils.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <new>
+
+namespace {
+
+// 每个 WebPWorker 对应一个线程, 状态切换与 thread_utils.c 的 pthread 实现一致
+struct WorkerImpl {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread thread;
+};
+
+void Execute(WebPWorker* const worker) {
+    if (worker->hook != nullptr) {
+        worker->had_error |= !worker->hook(worker->data1, worker->data2);
+    }
+}
+
+void ThreadLoop(WebPWorker* worker) {
+    WorkerImpl* impl = (WorkerImpl*)worker->impl_;
+    bool done = false;
+    while (!done) {
+        std::unique_lock<std::mutex> lock(impl->mutex);
+        while (worker->status_ == OK) { // 空闲等待
+            impl->condition.wait(lock);
+        }
+        if (worker->status_ == WORK) {
+            Execute(worker);
+            worker->status_ = OK;
+        } else if (worker->status_ == NOT_OK) {
+            done = true;
+        }
+        lock.unlock();
+        impl->condition.notify_all(); // 通知 Sync()
+    }
+}
+
+// 等待当前任务完成, 然后切换到新状态
+void ChangeState(WebPWorker* const worker, WebPWorkerStatus newStatus) {
+    WorkerImpl* impl = (WorkerImpl*)worker->impl_;
+    if (impl == nullptr) {
+        return;
+    }
+    
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    if (worker->status_ >= OK) {
+        while (worker->status_ != OK) {
+            impl->condition.wait(lock);
+        }
+        if (newStatus != OK) {
+            worker->status_ = newStatus;
+            lock.unlock();
+            impl->condition.notify_all();
+        }
+    }
+}
+
+void Init(WebPWorker* const worker) {
+    memset(worker, 0, sizeof(*worker));
+    worker->status_ = NOT_OK;
+}
+
+int Sync(WebPWorker* const worker) {
+    ChangeState(worker, OK);
+    return !worker->had_error;
+}
+
+int Reset(WebPWorker* const worker) {
+    worker->had_error = 0;
+    if (worker->status_ < OK) {
+        WorkerImpl* impl = new (std::nothrow) WorkerImpl();
+        if (impl == nullptr) {
+            return 0;
+        }
+        worker->impl_ = impl;
+        
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        try {
+            impl->thread = std::thread(ThreadLoop, worker);
+        } catch (...) {
+            worker->impl_ = nullptr;
+            delete impl;
+            FileLogger::GetInstance().LogWarning("[WebP] Failed to start worker thread, decoding single-threaded");
+            return 0;
+        }
+        worker->status_ = OK;
+        return 1;
+    }
+    
+    if (worker->status_ > OK) {
+        return Sync(worker);
+    }
+    return 1;
+}
+
+void Launch(WebPWorker* const worker) {
+    ChangeState(worker, WORK);
+}
+
+void End(WebPWorker* const worker) {
+    WorkerImpl* impl = (WorkerImpl*)worker->impl_;
+    if (impl != nullptr) {
+        ChangeState(worker, NOT_OK);
+        if (impl->thread.joinable()) {
+            impl->thread.join();
+        }
+        delete impl;
+        worker->impl_ = nullptr;
+    }
+    worker->status_ = NOT_OK;
+}
+
+} // namespace
+
+bool WebPThreads::Install() {
+    static const WebPWorkerInterface sInterface = { Init, Reset, Sync, Launch, Execute, End };
+    if (!WebPSetWorkerInterface(&sInterface)) {
+        FileLogger::GetInstance().LogError("[WebP] WebPSetWorkerInterface failed");
+        return false;
+    }
+    FileLogger::GetInstance().LogInfo("[WebP] Multithreaded decoding enabled");
+    return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// libwebp 多线程解码支持
+// 用 std::thread (wut 中由 coreinit OSThread 实现) 实现 WebPWorkerInterface,
+// 解码时设置 WebPDecoderConfig.options.use_threads 即可把环路滤波放到另一个核心
+namespace WebPThreads {
+
+    // 安装线程接口, 必须在第一次解码之前调用
+    bool Install();
+
+}
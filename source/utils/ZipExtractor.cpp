@@ -0,0 +1,320 @@
+#include "ZipExtractor.hpp"
+#include "FileLogger.hpp"
+#include "AllocTracker.hpp"
+#include "ZipIndex.hpp"
+#include "JobSystem.hpp"
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// 设备根目录, 不能也不需要创建
+static bool IsDeviceRoot(const std::string& path) {
+    return path.empty() || path.back() == ':' || path == "fs:/vol" || path == "fs:/vol/external01";
+}
+
+namespace {
+
+// 一个要解压的文件条目
+struct EntryJob {
+    std::string path;
+    const ZipIndex::Entry* zipEntry = nullptr;
+    uint64_t size = 0;    // 未压缩大小
+    // 以下只由写入线程使用
+    FileIO file;
+    bool opened = false;
+    bool failed = false;
+};
+
+// 工作线程交给写入线程的一块数据; buffer 为空的 last 块表示条目结束
+struct WriteChunk {
+    EntryJob* entry = nullptr;
+    FileIO::Buffer* buffer = nullptr;
+    size_t len = 0;
+    bool last = false;
+    const char* error = nullptr;  // 解压失败, 输出文件要删除
+};
+
+} // namespace
+
+ZipExtractor::ZipExtractor(size_t bufferSize, unsigned threadCount)
+    : mBufferSize(bufferSize), mThreadCount(std::max(1u, threadCount)) {
+}
+
+void ZipExtractor::SetFilter(std::function<bool(const std::string& name)> filter) {
+    mFilter = filter;
+}
+
+void ZipExtractor::SetProgressCallback(std::function<void(uint64_t done, uint64_t total)> callback) {
+    mProgressCallback = callback;
+}
+
+void ZipExtractor::SetCancelFlag(const std::atomic<bool>* cancel) {
+    mCancel = cancel;
+}
+
+bool ZipExtractor::IsCancelled() {
+    if (mCancel && mCancel->load()) {
+        mCancelled = true;
+        mError = "Cancelled";
+    }
+    return mCancelled;
+}
+
+bool ZipExtractor::EnsureDirectory(const std::string& path, std::set<std::string>& created) {
+    if (IsDeviceRoot(path) || created.count(path)) {
+        return true;
+    }
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos && !EnsureDirectory(path.substr(0, slash), created)) {
+        return false;
+    }
+    if (mkdir(path.c_str(), 0777) != 0 && errno != EEXIST) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            FileLogger::GetInstance().LogError("[ZipExtractor] Failed to create directory: %s", path.c_str());
+            return false;
+        }
+    }
+    created.insert(path);
+    return true;
+}
+
+bool ZipExtractor::EnsureDirectory(const std::string& path) {
+    if (!EnsureDirectory(path, mCreatedDirs)) {
+        mError = "Failed to create directory";
+        return false;
+    }
+    return true;
+}
+
+bool ZipExtractor::Extract(const std::string& zipPath, const std::string& destDir) {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_ARCHIVE);
+    JobSystem::HeavyWorkScope heavyWork;
+    FileLogger::GetInstance().LogInfo("[ZipExtractor] Extracting: %s -> %s", zipPath.c_str(), destDir.c_str());
+    mError.clear();
+    mCancelled = false;
+
+    ZipIndex index;
+    if (!index.Open(zipPath)) {
+        mError = "Failed to open ZIP file";
+        return false;
+    }
+
+    // 中央目录已经在索引中: 记下要解压的条目, 统计要解压的字节数, 创建所有目录
+    std::deque<EntryJob> entries;
+    uint64_t total = 0;
+    uint64_t replaced = 0;  // 会被覆盖的已有文件的大小
+    bool ok = EnsureDirectory(destDir);
+    for (const ZipIndex::Entry& zipEntry : index.GetEntries()) {
+        if (!ok) {
+            break;
+        }
+        const std::string& name = zipEntry.name;
+        if (name.empty()) {
+            continue;
+        }
+        std::string fullPath = destDir + "/" + name;
+        if (zipEntry.IsDirectory()) {
+            ok = EnsureDirectory(fullPath.substr(0, fullPath.length() - 1));
+            continue;
+        }
+        if (mFilter && !mFilter(name)) {
+            continue;
+        }
+        ok = EnsureDirectory(fullPath.substr(0, fullPath.find_last_of('/')));
+        entries.emplace_back();
+        EntryJob& entry = entries.back();
+        entry.path = fullPath;
+        entry.zipEntry = &zipEntry;
+        entry.size = zipEntry.size;
+        total += zipEntry.size;
+        struct stat st;
+        if (stat(fullPath.c_str(), &st) == 0) {
+            replaced += (uint64_t)st.st_size;
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+    // 空间不够时在解压之前就失败
+    if (total > replaced && !FileIO::HasFreeSpace(destDir, total - replaced)) {
+        mError = "Not enough free space";
+        return false;
+    }
+
+    // 缓冲区池: 每个工作线程一个在解压、一个在等待写入
+    size_t workerCount = std::min<size_t>(mThreadCount, entries.size());
+    std::vector<FileIO::Buffer> buffers(workerCount * 2);
+    std::vector<FileIO::Buffer*> freeBuffers;
+    for (FileIO::Buffer& buffer : buffers) {
+        buffer.resize(mBufferSize);
+        if (buffer.size() == 0) {
+            mError = "Out of memory";
+            return false;
+        }
+        freeBuffers.push_back(&buffer);
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<WriteChunk> queue;
+    size_t nextEntry = 0;
+    size_t running = workerCount;
+    bool abort = false;
+
+    auto worker = [&]() {
+        ZipIndex::Reader reader;  // 每个线程打开一次压缩包
+        while (true) {
+            EntryJob* entry;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (abort || nextEntry >= entries.size()) {
+                    break;
+                }
+                entry = &entries[nextEntry++];
+            }
+
+            WriteChunk last;
+            last.entry = entry;
+            last.last = true;
+            // 按索引中的位置直接定位
+            if (!reader.Open(index, *entry->zipEntry)) {
+                last.error = "Failed to read ZIP entry";
+            } else {
+                while (true) {
+                    FileIO::Buffer* buffer;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cv.wait(lock, [&]() { return !freeBuffers.empty() || abort; });
+                        if (abort) {
+                            last.error = "Cancelled";
+                            break;
+                        }
+                        buffer = freeBuffers.back();
+                        freeBuffers.pop_back();
+                    }
+                    // Reader 会填满整个缓冲区 (除非到了条目末尾), 读完时校验大小和 CRC32
+                    size_t bytesRead = reader.Read(buffer->data(), buffer->size());
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (bytesRead == 0) {
+                        freeBuffers.push_back(buffer);
+                        if (reader.Failed()) {
+                            last.error = "Corrupt ZIP entry";
+                        }
+                        break;
+                    }
+                    WriteChunk chunk;
+                    chunk.entry = entry;
+                    chunk.buffer = buffer;
+                    chunk.len = bytesRead;
+                    queue.push_back(chunk);
+                    cv.notify_all();
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(last);
+            cv.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        running--;
+        cv.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < workerCount; t++) {
+        threads.emplace_back(worker);
+    }
+
+    // 写入都在这个线程上进行, 各条目的块按解压的顺序到达
+    uint64_t done = 0;
+    int fileCount = 0;
+    while (true) {
+        WriteChunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return !queue.empty() || running == 0; });
+            if (queue.empty()) {
+                break;
+            }
+            chunk = queue.front();
+            queue.pop_front();
+        }
+
+        EntryJob& entry = *chunk.entry;
+        const char* error = nullptr;
+        if (!entry.failed && !entry.opened) {
+            entry.opened = true;
+            if (!entry.file.Open(entry.path, FileIO::MODE_WRITE)) {
+                error = "Failed to create file";
+            } else if (entry.size > mBufferSize && !entry.file.Reserve(entry.size)) {
+                // 分几块写入的大文件先一次分配好空间
+                error = "Not enough free space";
+            }
+        }
+        if (!entry.failed && !error && chunk.buffer && !entry.file.Write(chunk.buffer->data(), chunk.len)) {
+            error = "Failed to write file";
+        }
+        if (chunk.last) {
+            if (entry.file.IsOpen() && !entry.file.Close() && !error && !entry.failed) {
+                error = "Failed to write file";
+            }
+            if (!error && !entry.failed) {
+                error = chunk.error;
+            }
+        }
+        if (error && !entry.failed) {
+            entry.failed = true;
+            if (ok) {
+                mError = error;
+                ok = false;
+                if (!mCancelled) {
+                    FileLogger::GetInstance().LogError("[ZipExtractor] %s: %s", error, entry.path.c_str());
+                }
+            }
+        }
+        if (chunk.last) {
+            if (entry.failed) {
+                entry.file.Close();
+                remove(entry.path.c_str());
+            } else {
+                fileCount++;
+            }
+        }
+
+        bool stop = !ok;
+        if (chunk.buffer) {
+            done += chunk.len;
+            if (mProgressCallback) {
+                mProgressCallback(done, total);
+            }
+            stop = IsCancelled() || stop;
+            if (mCancelled) {
+                ok = false;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (chunk.buffer) {
+                freeBuffers.push_back(chunk.buffer);
+            }
+            abort = abort || stop;
+        }
+        cv.notify_all();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (ok) {
+        FileLogger::GetInstance().LogInfo("[ZipExtractor] Extracted %d files (%llu bytes) on %zu thread(s)",
+            fileCount, (unsigned long long)done, workerCount);
+    }
+    return ok;
+}
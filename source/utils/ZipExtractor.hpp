@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <set>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include "FileIO.hpp"
+
+// 把 ZIP (.utheme) 解压到目录, ThemeDownloader 和 LocalInstallScreen 共用
+// 中央目录由 ZipIndex 解析一次; 各条目是分别压缩的: 几个工作线程各自打开压缩包, 按索引中的位置直接定位, 同时解压不同的条目
+// 解压出的块放进对齐的缓冲区, 由调用 Extract 的线程按顺序经 FileIO 写出 (写入只在这一个线程上)
+// 不超过缓冲区的条目 (绝大多数) 只写一次
+// 目录在开始解压前由调用线程创建, 已经创建或确认存在的目录记在集合里, 不再重复 mkdir
+// 进度按已写入的字节数 / 所有要解压条目的未压缩大小报告
+class ZipExtractor {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+    static constexpr unsigned DEFAULT_THREADS = 3;
+
+    // bufferSize: 每个缓冲区的大小, 共 threadCount * 2 个 (每个线程一个在解压, 一个在等待写入)
+    explicit ZipExtractor(size_t bufferSize = DEFAULT_BUFFER_SIZE, unsigned threadCount = DEFAULT_THREADS);
+
+    // 返回 false 的条目不解压 (参数为条目在压缩包中的路径)
+    void SetFilter(std::function<bool(const std::string& name)> filter);
+    // 在调用 Extract 的线程上调用
+    void SetProgressCallback(std::function<void(uint64_t done, uint64_t total)> callback);
+    // 不为空时每写入一块检查一次, 为 true 就停止
+    void SetCancelFlag(const std::atomic<bool>* cancel);
+
+    // destDir 不存在时创建; 任何条目解压或写入失败都返回 false
+    bool Extract(const std::string& zipPath, const std::string& destDir);
+
+    const std::string& GetError() const { return mError; }
+    bool WasCancelled() const { return mCancelled; }
+
+    // 创建目录及其上级目录; created 记录已经创建或确认存在的目录, 其中的目录不再 mkdir
+    static bool EnsureDirectory(const std::string& path, std::set<std::string>& created);
+
+private:
+    size_t mBufferSize;
+    unsigned mThreadCount;
+    std::function<bool(const std::string&)> mFilter;
+    std::function<void(uint64_t, uint64_t)> mProgressCallback;
+    const std::atomic<bool>* mCancel = nullptr;
+    std::set<std::string> mCreatedDirs;
+    std::string mError;
+    bool mCancelled = false;
+
+    bool EnsureDirectory(const std::string& path);  // 失败时设置 mError
+    bool IsCancelled();
+};
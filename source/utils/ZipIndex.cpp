@@ -0,0 +1,443 @@
+#include "ZipIndex.hpp"
+#include "DiskCacheIndex.hpp"
+#include "FastMemory.hpp"
+#include "FileLogger.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <list>
+#include <mutex>
+
+static const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const uint32_t END_OF_CENTRAL_DIR_SIGNATURE = 0x06054b50;
+static const uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+static const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+static const size_t CENTRAL_HEADER_SIZE = 46;
+static const size_t LOCAL_HEADER_SIZE = 30;
+static const size_t END_OF_CENTRAL_DIR_SIZE = 22;
+static const size_t ZIP64_END_SIZE = 56;
+static const size_t ZIP64_LOCATOR_SIZE = 20;
+static const size_t MAX_COMMENT_SIZE = 0xFFFF;
+
+static const uint16_t FLAG_ENCRYPTED = 0x0001;
+static const uint16_t EXTRA_ZIP64 = 0x0001;
+
+static std::atomic<int> sInflateBackend{ZipIndex::INFLATE_STREAM};
+
+static uint16_t ReadLE16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ReadLE64(const uint8_t* p) {
+    return (uint64_t)ReadLE32(p) | ((uint64_t)ReadLE32(p + 4) << 32);
+}
+
+bool ZipIndex::Open(const std::string& path) {
+    mPath = path;
+    mEntries.clear();
+    mSlots.clear();
+
+    FileIO file;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !file.Open(path, FileIO::MODE_READ)) {
+        FileLogger::GetInstance().LogError("[ZipIndex] Failed to open: %s", path.c_str());
+        return false;
+    }
+    mFileSize = (uint64_t)st.st_size;
+    mMtime = (int64_t)st.st_mtime;
+
+    // 中央目录结尾在文件末尾, 后面最多跟 64 KB 的注释
+    size_t tailSize = (size_t)std::min<uint64_t>(mFileSize, END_OF_CENTRAL_DIR_SIZE + MAX_COMMENT_SIZE);
+    uint64_t tailOffset = mFileSize - tailSize;
+    std::vector<uint8_t> tail(tailSize);
+    if (tailSize < END_OF_CENTRAL_DIR_SIZE || file.ReadAt(tailOffset, tail.data(), tailSize) != tailSize) {
+        FileLogger::GetInstance().LogError("[ZipIndex] Not a ZIP file: %s", path.c_str());
+        return false;
+    }
+    size_t eocd = tailSize - END_OF_CENTRAL_DIR_SIZE;
+    while (ReadLE32(&tail[eocd]) != END_OF_CENTRAL_DIR_SIGNATURE) {
+        if (eocd == 0) {
+            FileLogger::GetInstance().LogError("[ZipIndex] End of central directory not found: %s", path.c_str());
+            return false;
+        }
+        eocd--;
+    }
+    uint64_t count = ReadLE16(&tail[eocd + 10]);
+    uint64_t dirSize = ReadLE32(&tail[eocd + 12]);
+    uint64_t dirOffset = ReadLE32(&tail[eocd + 16]);
+
+    // ZIP64: 紧挨在中央目录结尾前面的定位记录指向 64 位的结尾记录
+    if (eocd >= ZIP64_LOCATOR_SIZE && ReadLE32(&tail[eocd - ZIP64_LOCATOR_SIZE]) == ZIP64_LOCATOR_SIGNATURE) {
+        uint8_t end64[ZIP64_END_SIZE];
+        uint64_t end64Offset = ReadLE64(&tail[eocd - ZIP64_LOCATOR_SIZE + 8]);
+        if (file.ReadAt(end64Offset, end64, sizeof(end64)) != sizeof(end64) ||
+            ReadLE32(end64) != ZIP64_END_SIGNATURE) {
+            FileLogger::GetInstance().LogError("[ZipIndex] Corrupt ZIP64 end record: %s", path.c_str());
+            return false;
+        }
+        count = ReadLE64(end64 + 32);
+        dirSize = ReadLE64(end64 + 40);
+        dirOffset = ReadLE64(end64 + 48);
+    }
+    if (dirSize > MAX_CENTRAL_DIR_SIZE || dirOffset + dirSize > mFileSize || count > dirSize / CENTRAL_HEADER_SIZE) {
+        FileLogger::GetInstance().LogError("[ZipIndex] Corrupt central directory: %s", path.c_str());
+        return false;
+    }
+
+    // 整个中央目录一次读入
+    std::vector<uint8_t> dir((size_t)dirSize);
+    if (dirSize > 0 && file.ReadAt(dirOffset, dir.data(), dir.size()) != dir.size()) {
+        FileLogger::GetInstance().LogError("[ZipIndex] Failed to read central directory: %s", path.c_str());
+        return false;
+    }
+    if (!ParseCentralDirectory(dir.data(), dir.size(), count)) {
+        mEntries.clear();
+        return false;
+    }
+    BuildTable();
+    return true;
+}
+
+bool ZipIndex::ParseCentralDirectory(const uint8_t* data, size_t size, uint64_t count) {
+    mEntries.reserve((size_t)count);
+    size_t pos = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        const uint8_t* header = data + pos;
+        if (size - pos < CENTRAL_HEADER_SIZE || ReadLE32(header) != CENTRAL_HEADER_SIGNATURE) {
+            FileLogger::GetInstance().LogError("[ZipIndex] Corrupt central directory entry %llu: %s",
+                                               (unsigned long long)i, mPath.c_str());
+            return false;
+        }
+        uint16_t flags = ReadLE16(header + 8);
+        uint16_t method = ReadLE16(header + 10);
+        size_t nameLength = ReadLE16(header + 28);
+        size_t extraLength = ReadLE16(header + 30);
+        size_t commentLength = ReadLE16(header + 32);
+        size_t recordSize = CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength;
+        if (size - pos < recordSize) {
+            FileLogger::GetInstance().LogError("[ZipIndex] Truncated central directory: %s", mPath.c_str());
+            return false;
+        }
+        if (flags & FLAG_ENCRYPTED) {
+            FileLogger::GetInstance().LogError("[ZipIndex] Encrypted entries are not supported: %s", mPath.c_str());
+            return false;
+        }
+
+        mEntries.emplace_back();
+        Entry& entry = mEntries.back();
+        entry.name.assign((const char*)header + CENTRAL_HEADER_SIZE, nameLength);
+        entry.nameHash = DiskCacheIndex::Hash(entry.name);
+        entry.method = method;
+        entry.crc = ReadLE32(header + 16);
+        entry.compressedSize = ReadLE32(header + 20);
+        entry.size = ReadLE32(header + 24);
+        entry.headerOffset = ReadLE32(header + 42);
+
+        // ZIP64 扩展字段按顺序只包含 32 位字段放不下 (为 0xFFFFFFFF) 的值
+        const uint8_t* extra = header + CENTRAL_HEADER_SIZE + nameLength;
+        const uint8_t* extraEnd = extra + extraLength;
+        while (extraEnd - extra >= 4) {
+            uint16_t id = ReadLE16(extra);
+            size_t length = ReadLE16(extra + 2);
+            const uint8_t* field = extra + 4;
+            if ((size_t)(extraEnd - field) < length) {
+                break;
+            }
+            if (id == EXTRA_ZIP64) {
+                const uint8_t* fieldEnd = field + length;
+                for (uint64_t* value : {&entry.size, &entry.compressedSize, &entry.headerOffset}) {
+                    if (*value == 0xFFFFFFFF && fieldEnd - field >= 8) {
+                        *value = ReadLE64(field);
+                        field += 8;
+                    }
+                }
+            }
+            extra += 4 + length;
+        }
+        pos += recordSize;
+    }
+    return true;
+}
+
+void ZipIndex::BuildTable() {
+    size_t slots = 16;
+    while (slots < mEntries.size() * 2) {
+        slots *= 2;
+    }
+    mSlots.assign(slots, -1);
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        size_t slot = (size_t)mEntries[i].nameHash & (slots - 1);
+        while (mSlots[slot] >= 0) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        mSlots[slot] = (int32_t)i;
+    }
+}
+
+const ZipIndex::Entry* ZipIndex::Find(const std::string& name) const {
+    if (mSlots.empty()) {
+        return nullptr;
+    }
+    uint64_t hash = DiskCacheIndex::Hash(name);
+    size_t mask = mSlots.size() - 1;
+    for (size_t slot = (size_t)hash & mask; mSlots[slot] >= 0; slot = (slot + 1) & mask) {
+        const Entry& entry = mEntries[mSlots[slot]];
+        if (entry.nameHash == hash && entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool ZipIndex::GetDataOffset(FileIO& file, const Entry& entry, uint64_t& offset) const {
+    uint8_t header[LOCAL_HEADER_SIZE];
+    if (file.ReadAt(entry.headerOffset, header, sizeof(header)) != sizeof(header) ||
+        ReadLE32(header) != LOCAL_HEADER_SIGNATURE) {
+        return false;
+    }
+    offset = entry.headerOffset + LOCAL_HEADER_SIZE + ReadLE16(header + 26) + ReadLE16(header + 28);
+    return offset + entry.compressedSize <= mFileSize;
+}
+
+bool ZipIndex::Read(const Entry& entry, std::string& out, uint64_t maxSize) const {
+    if (entry.size > maxSize) {
+        return false;
+    }
+    Reader reader;
+    if (!reader.Open(*this, entry)) {
+        return false;
+    }
+    out.resize((size_t)entry.size);
+    if (!out.empty() && reader.Read(&out[0], out.size()) != out.size()) {
+        return false;
+    }
+    // 再读一次确认条目到此结束, 同时校验 CRC32
+    char extra;
+    return reader.Read(&extra, 1) == 0 && !reader.Failed();
+}
+
+std::shared_ptr<const ZipIndex> ZipIndex::Get(const std::string& path) {
+    struct CachedIndex {
+        std::string path;
+        std::shared_ptr<const ZipIndex> index;
+    };
+    static std::mutex sMutex;
+    static std::list<CachedIndex> sCache;   // 头部为最近使用
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        for (auto it = sCache.begin(); it != sCache.end(); ++it) {
+            if (it->path != path) {
+                continue;
+            }
+            if (it->index->mFileSize == (uint64_t)st.st_size && it->index->mMtime == (int64_t)st.st_mtime) {
+                sCache.splice(sCache.begin(), sCache, it);
+                return sCache.front().index;
+            }
+            sCache.erase(it);
+            break;
+        }
+    }
+
+    // 解析不持有锁, 同一文件同时被请求时可能解析两次
+    auto index = std::make_shared<ZipIndex>();
+    if (!index->Open(path)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCache.remove_if([&](const CachedIndex& cached) { return cached.path == path; });
+    sCache.push_front({path, index});
+    if (sCache.size() > CACHE_SIZE) {
+        sCache.pop_back();
+    }
+    return index;
+}
+
+void ZipIndex::SetInflateBackend(InflateBackend backend) {
+    sInflateBackend = backend;
+}
+
+ZipIndex::InflateBackend ZipIndex::GetInflateBackend() {
+    return (InflateBackend)sInflateBackend.load();
+}
+
+//------------------------------------------------------------------------------
+
+ZipIndex::Reader::~Reader() {
+    EndInflate();
+}
+
+void ZipIndex::Reader::EndInflate() {
+    if (mInflating) {
+        inflateEnd(&mStream);
+        mInflating = false;
+    }
+}
+
+bool ZipIndex::Reader::Open(const ZipIndex& index, const Entry& entry) {
+    if (entry.method != METHOD_STORED && entry.method != METHOD_DEFLATE) {
+        FileLogger::GetInstance().LogError("[ZipIndex] Unsupported compression method %u: %s",
+                                           (unsigned)entry.method, entry.name.c_str());
+        return false;
+    }
+    mEntry = nullptr;
+    mOutput = 0;
+    mCrc = 0;
+    mFailed = false;
+    mDone = false;
+    if (!mFile.IsOpen() || mPath != index.mPath) {
+        mFile.Close();
+        mPath.clear();
+        if (!mFile.Open(index.mPath, FileIO::MODE_READ)) {
+            return false;
+        }
+        mPath = index.mPath;
+    }
+    if (!index.GetDataOffset(mFile, entry, mInputOffset)) {
+        return false;
+    }
+    if (entry.method == METHOD_DEFLATE) {
+        if (mInflating) {
+            inflateReset(&mStream);
+        } else {
+            if (mInput.size() < INPUT_SIZE) {
+                mInput.resize(INPUT_SIZE);  // INFLATE_DIRECT 放大过的缓冲区留给下一个条目
+            }
+            mStream = {};
+            mStream.zalloc = FastMemory::ZAlloc;
+            mStream.zfree = FastMemory::ZFree;
+            if (mInput.size() == 0 || inflateInit2(&mStream, -MAX_WBITS) != Z_OK) {
+                return false;
+            }
+            mInflating = true;
+        }
+        mStream.avail_in = 0;
+    }
+    mEntry = &entry;
+    mBackend = GetInflateBackend();
+    mInputRemaining = entry.compressedSize;
+    return true;
+}
+
+size_t ZipIndex::Reader::Read(void* dst, size_t n) {
+    if (!mEntry || mDone || mFailed || n == 0) {
+        return 0;
+    }
+    uint8_t* out = (uint8_t*)dst;
+    size_t done = 0;
+    bool ended = false;
+
+    if (mEntry->method == METHOD_STORED) {
+        while (done < n && mInputRemaining > 0) {
+            size_t got = mFile.ReadAt(mInputOffset, out + done, (size_t)std::min<uint64_t>(n - done, mInputRemaining));
+            if (got == 0) {
+                mFailed = true;
+                return 0;
+            }
+            mInputOffset += got;
+            mInputRemaining -= got;
+            done += got;
+        }
+        ended = mInputRemaining == 0;
+    } else if (mBackend == INFLATE_DIRECT && mOutput == 0 && n >= mEntry->size &&
+               mInputRemaining <= DIRECT_MAX_INPUT) {
+        if (!InflateDirect(out, n, done)) {
+            mFailed = true;
+            EndInflate();
+            return 0;
+        }
+        ended = true;
+    } else {
+        mStream.next_out = out;
+        mStream.avail_out = (uInt)n;
+        while (mStream.avail_out > 0) {
+            if (mStream.avail_in == 0 && mInputRemaining > 0) {
+                size_t got = mFile.ReadAt(mInputOffset, mInput.data(),
+                                          (size_t)std::min<uint64_t>(mInput.size(), mInputRemaining));
+                if (got == 0) {
+                    mFailed = true;
+                    EndInflate();
+                    return 0;
+                }
+                mInputOffset += got;
+                mInputRemaining -= got;
+                mStream.next_in = mInput.data();
+                mStream.avail_in = (uInt)got;
+            }
+            int ret = inflate(&mStream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                ended = true;
+                break;
+            }
+            if (ret != Z_OK) {
+                // 包括压缩数据用完了流还没结束 (Z_BUF_ERROR)
+                mFailed = true;
+                EndInflate();
+                return 0;
+            }
+        }
+        done = n - mStream.avail_out;
+    }
+
+    mCrc = (uint32_t)crc32(mCrc, out, (uInt)done);
+    mOutput += done;
+    if (ended || mOutput > mEntry->size) {
+        mDone = true;
+        mFailed = !Finish();
+    }
+    if (mDone || mFailed) {
+        // 解压状态在 MEM1 里, 只在一个条目之内持有
+        EndInflate();
+    }
+    return mFailed ? 0 : done;
+}
+
+bool ZipIndex::Reader::InflateDirect(uint8_t* dst, size_t n, size_t& done) {
+    size_t compressed = (size_t)mInputRemaining;
+    if (mInput.size() < compressed) {
+        // 按 INPUT_SIZE 取整, 之后大小相近的条目不用重新分配
+        mInput.resize((compressed + INPUT_SIZE - 1) / INPUT_SIZE * INPUT_SIZE);
+        if (mInput.size() < compressed) {
+            return false;
+        }
+    }
+    size_t got = 0;
+    while (got < compressed) {
+        size_t read = mFile.ReadAt(mInputOffset + got, mInput.data() + got, compressed - got);
+        if (read == 0) {
+            return false;
+        }
+        got += read;
+    }
+    mInputOffset += got;
+    mInputRemaining = 0;
+
+    // 输入和输出都一次给全, 一次调用就结束时 inflate 不更新窗口
+    mStream.next_in = mInput.data();
+    mStream.avail_in = (uInt)got;
+    mStream.next_out = dst;
+    mStream.avail_out = (uInt)n;
+    if (inflate(&mStream, Z_FINISH) != Z_STREAM_END) {
+        return false;
+    }
+    done = n - mStream.avail_out;
+    return true;
+}
+
+bool ZipIndex::Reader::Finish() {
+    if (mOutput != mEntry->size || mCrc != mEntry->crc) {
+        FileLogger::GetInstance().LogError("[ZipIndex] Corrupt entry: %s", mEntry->name.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "FileIO.hpp"
+#include <zlib.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ZIP 中央目录索引: 打开时一次读入整个中央目录, 解析成扁平的条目数组 (名称哈希、位置、大小、CRC32)
+// 按名称查找走开放寻址的哈希表, 不用逐个遍历条目; 读取条目时直接定位到本地文件头, 读一次就开始解压
+// 只支持 stored 和 deflate, 有加密条目时 Open 失败; ZIP64 的大小和位置从扩展字段读取
+// 建好的索引只读, 可以在多个线程上共用; 每个线程用自己的 Reader (各自打开文件)
+// Get 按路径缓存最近用过的几个索引, 文件大小或修改时间变了时重新解析
+class ZipIndex {
+public:
+    static constexpr size_t CACHE_SIZE = 4;
+    static constexpr uint64_t MAX_CENTRAL_DIR_SIZE = 16 * 1024 * 1024;
+
+    enum Method : uint16_t {
+        METHOD_STORED = 0,
+        METHOD_DEFLATE = 8
+    };
+
+    struct Entry {
+        std::string name;            // 条目在压缩包中的路径
+        uint64_t nameHash = 0;
+        uint64_t headerOffset = 0;   // 本地文件头的位置
+        uint64_t compressedSize = 0;
+        uint64_t size = 0;           // 未压缩大小
+        uint32_t crc = 0;
+        uint16_t method = METHOD_STORED;
+
+        bool IsDirectory() const { return !name.empty() && name.back() == '/'; }
+    };
+
+    // inflate 的两种用法, 输出相同; 基准测试的 inflate-stream / inflate-direct 比较两者 (见 Benchmark)
+    enum InflateBackend {
+        INFLATE_STREAM,   // 按调用者的缓冲区逐块解压, zlib 每次调用后把输出复制进 32KB 滑动窗口
+        INFLATE_DIRECT    // 条目能放进调用者的缓冲区时一次读入全部压缩数据, Z_FINISH 一次解压到目标里,
+                          // zlib 不分配也不复制窗口, 解压循环一直走 inflate_fast; 放不下的条目退回 INFLATE_STREAM
+    };
+    static constexpr size_t DIRECT_MAX_INPUT = 1024 * 1024;  // INFLATE_DIRECT 读入的压缩数据上限
+
+    // 之后打开的 Reader 使用的实现 (默认 INFLATE_STREAM, 配置文件中 directinflate=1 时为 INFLATE_DIRECT), 可以在任何线程调用
+    static void SetInflateBackend(InflateBackend backend);
+    static InflateBackend GetInflateBackend();
+
+    // 按顺序读出一个条目, 读完时校验大小和 CRC32
+    // inflate 的状态和窗口放在 MEM1 (FastMemory), 条目读完或出错时释放, 下一个条目重新分配
+    class Reader {
+    public:
+        static constexpr size_t INPUT_SIZE = 64 * 1024;
+
+        Reader() = default;
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // 可以重复调用, 读取同一压缩包的下一个条目时不重新打开文件
+        bool Open(const ZipIndex& index, const Entry& entry);
+        // 读满 n 字节才返回 (条目末尾除外), 返回 0 表示读完或出错
+        size_t Read(void* dst, size_t n);
+        // 数据损坏、读取失败, 或读完后大小和 CRC32 不符
+        bool Failed() const { return mFailed; }
+        uint64_t Size() const { return mEntry ? mEntry->size : 0; }
+
+    private:
+        FileIO mFile;
+        std::string mPath;             // mFile 打开的压缩包
+        const Entry* mEntry = nullptr;
+        InflateBackend mBackend = INFLATE_STREAM;
+        FileIO::Buffer mInput;
+        z_stream mStream = {};
+        bool mInflating = false;
+        uint64_t mInputOffset = 0;     // 下一次读取压缩数据的位置
+        uint64_t mInputRemaining = 0;  // 还没读入的压缩数据
+        uint64_t mOutput = 0;          // 已经交出的字节数
+        uint32_t mCrc = 0;
+        bool mFailed = false;
+        bool mDone = false;
+
+        bool Finish();
+        void EndInflate();
+        bool InflateDirect(uint8_t* dst, size_t n, size_t& done);
+    };
+
+    ZipIndex() = default;
+
+    // 读入并解析中央目录
+    bool Open(const std::string& path);
+    // 缓存中的索引 (没有或已过期时打开), 失败时返回空
+    static std::shared_ptr<const ZipIndex> Get(const std::string& path);
+
+    const std::string& GetPath() const { return mPath; }
+    const std::vector<Entry>& GetEntries() const { return mEntries; }
+    const Entry* Find(const std::string& name) const;
+
+    // 压缩数据开始的位置 (读一次本地文件头)
+    bool GetDataOffset(FileIO& file, const Entry& entry, uint64_t& offset) const;
+    // 整个条目读入内存并校验, 超过 maxSize 时失败
+    bool Read(const Entry& entry, std::string& out, uint64_t maxSize = 32 * 1024 * 1024) const;
+
+private:
+    std::string mPath;
+    uint64_t mFileSize = 0;
+    int64_t mMtime = 0;
+    std::vector<Entry> mEntries;
+    std::vector<int32_t> mSlots;    // 哈希表: 条目下标, -1 为空; 大小为 2 的幂
+
+    bool ParseCentralDirectory(const uint8_t* data, size_t size, uint64_t count);
+    void BuildTable();
+};
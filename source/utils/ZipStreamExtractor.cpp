@@ -0,0 +1,324 @@
+#include "ZipStreamExtractor.hpp"
+#include "ZipExtractor.hpp"
+#include "FileLogger.hpp"
+#include "AllocTracker.hpp"
+#include "minizip/unzip.h"
+#include <zlib.h>
+#include <cstdio>
+#include <algorithm>
+
+static const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static const uint32_t END_OF_CENTRAL_DIR_SIGNATURE = 0x06054b50;
+static const uint32_t DATA_DESCRIPTOR_SIGNATURE = 0x08074b50;
+static const size_t LOCAL_HEADER_SIZE = 30;
+
+static const uint16_t FLAG_ENCRYPTED = 0x0001;
+static const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+static const uint16_t METHOD_STORED = 0;
+static const uint16_t METHOD_DEFLATE = 8;
+static const uint16_t EXTRA_ZIP64 = 0x0001;
+
+static uint16_t ReadLE16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+ZipStreamExtractor::ZipStreamExtractor(const std::string& destDir) : mDestDir(destDir) {
+}
+
+ZipStreamExtractor::~ZipStreamExtractor() {
+    Abandon();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void ZipStreamExtractor::SetFilter(std::function<bool(const std::string& name)> filter) {
+    mFilter = filter;
+}
+
+bool ZipStreamExtractor::Start() {
+    mOutput.resize(FileIO::CHUNK_SIZE);
+    if (mOutput.size() == 0 || !ZipExtractor::EnsureDirectory(mDestDir, mCreatedDirs)) {
+        return false;
+    }
+    mThread = std::thread(&ZipStreamExtractor::WorkerThread, this);
+    FileLogger::GetInstance().LogInfo("[ZipStream] Extracting while downloading -> %s", mDestDir.c_str());
+    return true;
+}
+
+void ZipStreamExtractor::Feed(const void* data, size_t size) {
+    if (!IsStarted()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    // 积压太多说明写入跟不上下载, 让下载等一等
+    mCv.wait(lock, [&]() { return mPending.size() < MAX_PENDING || mStopped; });
+    if (mStopped) {
+        return;
+    }
+    const uint8_t* bytes = (const uint8_t*)data;
+    mPending.insert(mPending.end(), bytes, bytes + size);
+    mCv.notify_all();
+}
+
+void ZipStreamExtractor::Abandon() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (IsStarted() && !mStopped) {
+        FileLogger::GetInstance().LogInfo("[ZipStream] Abandoned, extracting after download");
+    }
+    mStopped = true;
+    mCv.notify_all();
+}
+
+bool ZipStreamExtractor::Finish(const std::string& zipPath) {
+    if (!IsStarted()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEnded = true;
+        mCv.notify_all();
+    }
+    mThread.join();
+    if (!mComplete) {
+        return false;
+    }
+
+    // 中央目录才是权威的条目列表: 条目数不一致 (比如压缩包被追加过) 时以完整解压为准
+    unzFile zip = unzOpen(zipPath.c_str());
+    unz_global_info info;
+    bool ok = zip && unzGetGlobalInfo(zip, &info) == UNZ_OK && info.number_entry == mEntryCount;
+    if (zip) {
+        unzClose(zip);
+    }
+    if (ok) {
+        FileLogger::GetInstance().LogInfo("[ZipStream] Extracted %u entries during download", mEntryCount);
+    } else {
+        FileLogger::GetInstance().LogWarning("[ZipStream] Entry count does not match the central directory");
+    }
+    return ok;
+}
+
+void ZipStreamExtractor::WorkerThread() {
+    AllocTracker::TagScope allocTag(AllocTracker::TAG_ARCHIVE);
+    ExtractEntries();
+    // 之后的数据 (中央目录或放弃后的剩余部分) 都不需要了
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopped = true;
+    std::vector<uint8_t>().swap(mPending);
+    mCv.notify_all();
+}
+
+bool ZipStreamExtractor::Fill() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCv.wait(lock, [&]() { return !mPending.empty() || mEnded || mStopped; });
+    if (mStopped || mPending.empty()) {
+        return false;
+    }
+    mInput.erase(mInput.begin(), mInput.begin() + mInputPos);
+    mInputPos = 0;
+    mInput.insert(mInput.end(), mPending.begin(), mPending.end());
+    mPending.clear();
+    mCv.notify_all();
+    return true;
+}
+
+bool ZipStreamExtractor::Need(size_t n) {
+    while (Available() < n) {
+        if (!Fill()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ZipStreamExtractor::Skip(uint64_t n) {
+    while (n > 0) {
+        if (Available() == 0 && !Fill()) {
+            return false;
+        }
+        size_t step = (size_t)std::min<uint64_t>(n, Available());
+        mInputPos += step;
+        n -= step;
+    }
+    return true;
+}
+
+bool ZipStreamExtractor::ExtractEntries() {
+    while (true) {
+        if (!Need(4)) {
+            return false;
+        }
+        uint32_t signature = ReadLE32(Data());
+        if (signature == CENTRAL_HEADER_SIGNATURE || signature == END_OF_CENTRAL_DIR_SIGNATURE) {
+            mComplete = true;
+            return true;
+        }
+        if (signature != LOCAL_HEADER_SIGNATURE) {
+            FileLogger::GetInstance().LogWarning("[ZipStream] Unexpected signature %08x", (unsigned)signature);
+            return false;
+        }
+        if (!Need(LOCAL_HEADER_SIZE)) {
+            return false;
+        }
+
+        const uint8_t* header = Data();
+        uint16_t flags = ReadLE16(header + 6);
+        uint16_t method = ReadLE16(header + 8);
+        uint32_t crc = ReadLE32(header + 14);
+        uint32_t compressedSize = ReadLE32(header + 18);
+        uint32_t uncompressedSize = ReadLE32(header + 22);
+        uint16_t nameLength = ReadLE16(header + 26);
+        uint16_t extraLength = ReadLE16(header + 28);
+        if (!Need(LOCAL_HEADER_SIZE + nameLength + extraLength)) {
+            return false;
+        }
+
+        header = Data();
+        std::string name((const char*)header + LOCAL_HEADER_SIZE, nameLength);
+        bool zip64 = false;
+        const uint8_t* extra = header + LOCAL_HEADER_SIZE + nameLength;
+        for (size_t i = 0; i + 4 <= extraLength; i += 4 + ReadLE16(extra + i + 2)) {
+            zip64 = zip64 || ReadLE16(extra + i) == EXTRA_ZIP64;
+        }
+        mInputPos += LOCAL_HEADER_SIZE + nameLength + extraLength;
+
+        // stored 条目带数据描述符时大小只记在中央目录里, 无法知道数据在哪里结束
+        const char* unsupported = nullptr;
+        if (flags & FLAG_ENCRYPTED) {
+            unsupported = "encrypted";
+        } else if (zip64 || compressedSize == 0xFFFFFFFF || uncompressedSize == 0xFFFFFFFF) {
+            unsupported = "ZIP64";
+        } else if (method != METHOD_STORED && method != METHOD_DEFLATE) {
+            unsupported = "compression method";
+        } else if (method == METHOD_STORED && (flags & FLAG_DATA_DESCRIPTOR)) {
+            unsupported = "stored with data descriptor";
+        }
+        if (unsupported) {
+            FileLogger::GetInstance().LogInfo("[ZipStream] %s needs the central directory (%s), extracting after download",
+                name.c_str(), unsupported);
+            return false;
+        }
+
+        std::string fullPath = mDestDir + "/" + name;
+        bool isDirectory = !name.empty() && name.back() == '/';
+        bool write = !name.empty() && !isDirectory && (!mFilter || mFilter(name));
+        if (isDirectory && !ZipExtractor::EnsureDirectory(fullPath.substr(0, fullPath.length() - 1), mCreatedDirs)) {
+            return false;
+        }
+        if (write && !ZipExtractor::EnsureDirectory(fullPath.substr(0, fullPath.find_last_of('/')), mCreatedDirs)) {
+            return false;
+        }
+        if (!ExtractEntry(flags, method, crc, compressedSize, uncompressedSize, fullPath, write)) {
+            return false;
+        }
+        mEntryCount++;
+    }
+}
+
+bool ZipStreamExtractor::ExtractEntry(uint16_t flags, uint16_t method, uint32_t crc, uint32_t compressedSize,
+                                      uint32_t uncompressedSize, const std::string& path, bool write) {
+    bool descriptor = (flags & FLAG_DATA_DESCRIPTOR) != 0;
+    FileIO file;
+    if (write && !file.Open(path, FileIO::MODE_WRITE)) {
+        FileLogger::GetInstance().LogError("[ZipStream] Failed to create file: %s", path.c_str());
+        return false;
+    }
+
+    uint32_t actualCrc = 0;
+    uint64_t inSize = 0;
+    uint64_t outSize = 0;
+    bool ok = true;
+    bool checked = true;  // 数据经过了解压或复制, 可以校验
+    auto emit = [&](const uint8_t* data, size_t size) {
+        actualCrc = (uint32_t)crc32(actualCrc, data, (uInt)size);
+        outSize += size;
+        return !write || file.Write(data, size);
+    };
+
+    if (!write && !descriptor) {
+        // 不需要的条目大小已知, 直接跳过
+        checked = false;
+        ok = Skip(compressedSize);
+    } else if (method == METHOD_STORED) {
+        while (ok && inSize < compressedSize) {
+            if (Available() == 0 && !Fill()) {
+                ok = false;
+                break;
+            }
+            size_t step = (size_t)std::min<uint64_t>(compressedSize - inSize, Available());
+            ok = emit(Data(), step);
+            mInputPos += step;
+            inSize += step;
+        }
+    } else {
+        // 带数据描述符的 deflate 条目也是解压到流结束为止 (不需要的条目只解压不写出)
+        z_stream zs = {};
+        ok = inflateInit2(&zs, -MAX_WBITS) == Z_OK;
+        int ret = Z_OK;
+        while (ok && ret != Z_STREAM_END) {
+            if (Available() == 0 && !Fill()) {
+                ok = false;
+                break;
+            }
+            size_t avail = Available();
+            if (!descriptor) {
+                avail = (size_t)std::min<uint64_t>(avail, compressedSize - inSize);
+                if (avail == 0) {
+                    ok = false;  // 压缩数据用完了, 流还没有结束
+                    break;
+                }
+            }
+            zs.next_in = (Bytef*)Data();
+            zs.avail_in = (uInt)avail;
+            zs.next_out = mOutput.data();
+            zs.avail_out = (uInt)mOutput.size();
+            ret = inflate(&zs, Z_NO_FLUSH);
+            size_t used = avail - zs.avail_in;
+            mInputPos += used;
+            inSize += used;
+            size_t produced = mOutput.size() - zs.avail_out;
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                ok = false;
+            } else if (produced > 0) {
+                ok = emit(mOutput.data(), produced);
+            }
+        }
+        inflateEnd(&zs);
+    }
+
+    if (ok && descriptor) {
+        // 描述符的签名是可选的
+        ok = Need(4);
+        if (ok && ReadLE32(Data()) == DATA_DESCRIPTOR_SIGNATURE) {
+            mInputPos += 4;
+        }
+        ok = ok && Need(12);
+        if (ok) {
+            crc = ReadLE32(Data());
+            compressedSize = ReadLE32(Data() + 4);
+            uncompressedSize = ReadLE32(Data() + 8);
+            mInputPos += 12;
+        }
+    }
+
+    bool valid = ok && (!checked || (actualCrc == crc && inSize == compressedSize && outSize == uncompressedSize));
+    if (ok && !valid) {
+        FileLogger::GetInstance().LogError("[ZipStream] Corrupt ZIP entry: %s", path.c_str());
+    }
+    if (write) {
+        if (!file.Close() && valid) {
+            FileLogger::GetInstance().LogError("[ZipStream] Failed to write file: %s", path.c_str());
+            valid = false;
+        }
+        if (!valid) {
+            remove(path.c_str());
+        }
+    }
+    return valid;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <set>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include "FileIO.hpp"
+
+// 边下载边解压: 按下载到达的顺序解析 ZIP 的本地文件头, 在工作线程上解压并写出各条目
+// 下载线程用 Feed 交入数据 (只做复制, 积压超过 MAX_PENDING 时等待), 解析、解压和写入都在工作线程上
+// 遇到只能依靠中央目录才能处理的条目 (加密、ZIP64、既非 stored 也非 deflate、stored 且带数据描述符)
+// 就停止, Finish 返回 false, 调用方在下载完成后改用 ZipExtractor 完整解压
+// deflate 条目带数据描述符没有关系: 解压到流结束就知道条目在哪里结束, 再读描述符校验 CRC32 和大小
+class ZipStreamExtractor {
+public:
+    static constexpr size_t MAX_PENDING = 4 * 1024 * 1024;
+
+    explicit ZipStreamExtractor(const std::string& destDir);
+    ~ZipStreamExtractor();
+    ZipStreamExtractor(const ZipStreamExtractor&) = delete;
+    ZipStreamExtractor& operator=(const ZipStreamExtractor&) = delete;
+
+    // 返回 false 的条目不写出 (参数为条目在压缩包中的路径); 在 Start 之前设置
+    void SetFilter(std::function<bool(const std::string& name)> filter);
+
+    // 启动工作线程, 目标目录不存在时创建
+    bool Start();
+    bool IsStarted() const { return mThread.joinable(); }
+
+    // 交入压缩包接下来的数据, 必须从文件开头起连续; 工作线程已经停止时直接丢弃
+    void Feed(const void* data, size_t size);
+    // 数据不再连续 (重新下载等): 停止解压, Finish 将返回 false
+    void Abandon();
+    // 下载完成后调用: 等待剩下的数据解压完
+    // 所有条目都已解压并校验, 且条目数与 zipPath 的中央目录一致时返回 true
+    bool Finish(const std::string& zipPath);
+
+private:
+    std::function<bool(const std::string&)> mFilter;
+    std::string mDestDir;
+    std::set<std::string> mCreatedDirs;
+    std::thread mThread;
+
+    // 下载线程和工作线程共用, 由 mMutex 保护
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::vector<uint8_t> mPending;
+    bool mEnded = false;     // 不会再有数据
+    bool mStopped = false;   // 工作线程已经结束或被要求停止
+
+    // 以下只由工作线程使用
+    std::vector<uint8_t> mInput;
+    size_t mInputPos = 0;
+    FileIO::Buffer mOutput;
+    bool mComplete = false;  // 解析到了中央目录
+    unsigned mEntryCount = 0;
+
+    void WorkerThread();
+    bool ExtractEntries();
+    bool ExtractEntry(uint16_t flags, uint16_t method, uint32_t crc, uint32_t compressedSize,
+                      uint32_t uncompressedSize, const std::string& path, bool write);
+    bool Fill();
+    bool Need(size_t n);
+    bool Skip(uint64_t n);
+    size_t Available() const { return mInput.size() - mInputPos; }
+    const uint8_t* Data() const { return mInput.data() + mInputPos; }
+};
@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <array>
 #include <climits>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <type_traits>
@@ -118,6 +119,10 @@ namespace Hips {
         //#else
             const u64 byte = readLE<u64, 1>(data, offset, patchSize);
         //#endif
+				// Ran off the end of the patch: stop instead of looping forever on zeros
+				if (offset > patchSize) {
+					break;
+				}
                 
 				ret += (byte & 0x7F) * shift;
 
@@ -162,7 +167,37 @@ namespace Hips {
 				0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 			};
 
+			// Slice-by-8: table k maps a byte to its CRC contribution k bytes further down the stream,
+			// so 8 input bytes are folded in with 8 independent lookups instead of a serial chain of 8
+			struct SliceTables {
+				u32 table[8][256];
+			};
+			static constexpr SliceTables slices = [] {
+				SliceTables t{};
+				for (usize i = 0; i < 256; i++) {
+					t.table[0][i] = crcTable[i];
+				}
+				for (usize k = 1; k < 8; k++) {
+					for (usize i = 0; i < 256; i++) {
+						const u32 prev = t.table[k - 1][i];
+						t.table[k][i] = (prev >> 8) ^ crcTable[prev & 0xFF];
+					}
+				}
+				return t;
+			}();
+
 			crc = ~crc;
+			// Bytes are assembled explicitly so this is correct (and identical) on big-endian hosts like the Wii U
+			while (length >= 8) {
+				const u32 one = (u32(data[0]) | (u32(data[1]) << 8) | (u32(data[2]) << 16) | (u32(data[3]) << 24)) ^ crc;
+				const u32 two = u32(data[4]) | (u32(data[5]) << 8) | (u32(data[6]) << 16) | (u32(data[7]) << 24);
+				crc = slices.table[7][one & 0xFF] ^ slices.table[6][(one >> 8) & 0xFF] ^ slices.table[5][(one >> 16) & 0xFF] ^
+					  slices.table[4][one >> 24] ^ slices.table[3][two & 0xFF] ^ slices.table[2][(two >> 8) & 0xFF] ^
+					  slices.table[1][(two >> 16) & 0xFF] ^ slices.table[0][two >> 24];
+				data += 8;
+				length -= 8;
+			}
+
 			for (usize i = 0; i < length; i++) {
 				const u8 byte = data[i];
 				crc = crcTable[(crc ^ byte) & 0xFF] ^ (crc >> 8);
@@ -382,6 +417,77 @@ namespace Hips {
 			return Detail::readRunLength<T>(data, offset, patchSize);
 		}
 
+		// VLE decoder for the action loop. Almost every word in a real patch is 1 or 2 bytes long, so those
+		// are decoded without the generic loop. Returns false if the number runs past "end"
+		static inline bool readNumber(const u8* patch, usize& offset, usize end, u64& value) {
+			if (offset + 1 < end) [[likely]] {
+				const u8 first = patch[offset];
+				if (first & 0x80) {
+					value = first & 0x7F;
+					offset += 1;
+					return true;
+				}
+
+				const u8 second = patch[offset + 1];
+				if (second & 0x80) {
+					value = u64(first & 0x7F) + (u64((second & 0x7F) + 1) << 7);
+					offset += 2;
+					return true;
+				}
+			}
+
+			u64 ret = 0;
+			u64 shift = 1;
+			while (offset < end) {
+				const u8 byte = patch[offset++];
+				ret += (byte & 0x7F) * shift;
+				if (byte & 0x80) {
+					value = ret;
+					return true;
+				}
+
+				shift <<= 7;
+				ret += shift;
+			}
+
+			return false;
+		}
+
+		// Fill "length" bytes at "dst" with a copy of the target "distance" bytes behind it (the regions overlap,
+		// so the result is that pattern repeated). The first period is copied once, then the filled part doubles
+		// with each memcpy, so no copy overlaps its own source
+		static inline void replicate(u8* dst, usize distance, usize length) {
+			if (distance == 1) {
+				std::memset(dst, dst[-1], length);
+				return;
+			}
+
+			usize done = std::min(distance, length);
+			std::memcpy(dst, dst - distance, done);
+			while (done < length) {
+				const usize chunk = std::min(done, length - done);
+				std::memcpy(dst + done, dst, chunk);
+				done += chunk;
+			}
+		}
+
+		// A copy that starts outside [0, limit) reads zeros. Offsets are unsigned, so one that went "negative"
+		// wraps back to 0 part-way through the copy; advance src/dst past the zeros to that point
+		static inline void skipToZero(usize& src, usize limit, usize& dst, usize& length) {
+			if (src < limit) {
+				return;
+			}
+
+			const usize untilZero = usize(0) - src;
+			if (untilZero < length) {
+				dst += untilZero;
+				length -= untilZero;
+				src = 0;
+			} else {
+				length = 0;
+			}
+		}
+
 		namespace Action {
 			enum : u32 {
 				SourceRead = 0,
@@ -390,107 +496,309 @@ namespace Hips {
 				TargetCopy = 3,
 			};
 		}
-	}  // namespace BPS
 
-	static std::pair<std::vector<u8>, Result> patchBPS(const u8* data, usize dataSize, const u8* patch, usize patchSize) {
-		if (patch == nullptr || patchSize < BPS::minimumPatchSize) [[unlikely]] {
-			return {{}, Result::InvalidPatch};
+		// Checks the magic and sizes. On success patchOffset points at the first action and actionsEnd at the CRC32s
+		static inline Result readHeader(const u8* patch, usize patchSize, usize dataSize, u64& outputSize, usize& patchOffset,
+										usize& actionsEnd) {
+			if (patch == nullptr || patchSize < minimumPatchSize) [[unlikely]] {
+				return Result::InvalidPatch;
+			}
+
+			// Header magic does not match, so the patch is invalid
+			if (patch[0] != 'B' || patch[1] != 'P' || patch[2] != 'S' || patch[3] != '1') [[unlikely]] {
+				return Result::InvalidPatch;
+			}
+
+			patchOffset = headerSize;
+			const u64 inputSize = readRunLength<u64>(patch, patchOffset, patchSize);
+			outputSize = readRunLength<u64>(patch, patchOffset, patchSize);
+			const u64 metadataSize = readRunLength<u64>(patch, patchOffset, patchSize);
+
+			// The file we're trying to patch is smaller than the input is meant to be, reject it
+			if (dataSize < inputSize) {
+				return Result::SizeMismatch;
+			}
+
+			// The action list ends where the three CRC32s start
+			actionsEnd = patchSize - 12;
+			if (patchOffset > actionsEnd || metadataSize > actionsEnd - patchOffset) {
+				return Result::InvalidPatch;
+			}
+			patchOffset += metadataSize;
+			return Result::Success;
 		}
 
-		// Header magic does not match, so the patch is invalid
-		if (patch[0] != 'B' || patch[1] != 'P' || patch[2] != 'S' || patch[3] != '1') [[unlikely]] {
-			return {{}, Result::InvalidPatch};
+		// In-place application (patchBPSInPlace) writes the target over the source, front to back.
+		// A SourceRead puts every byte back where it was, so only the other actions clobber source bytes, and only
+		// those a later SourceCopy reads again have to be saved first. Both lists are sorted, disjoint intervals
+		struct Interval {
+			usize start;
+			usize end;
+			usize spillOffset;  // Where the saved bytes start in the spill buffer
+		};
+
+		// Writes only move forward, so a new interval either extends the last one or starts after it
+		static inline void appendInterval(std::vector<Interval>& intervals, usize start, usize end) {
+			if (start >= end) {
+				return;
+			}
+			if (!intervals.empty() && start <= intervals.back().end) {
+				intervals.back().end = std::max(intervals.back().end, end);
+			} else {
+				intervals.push_back({start, end, 0});
+			}
 		}
 
-		usize patchOffset = BPS::headerSize;
-		const u64 inputSize = BPS::readRunLength<u64>(patch, patchOffset, patchSize);
-		const u64 outputSize = BPS::readRunLength<u64>(patch, patchOffset, patchSize);
-		const u64 metadataSize = BPS::readRunLength<u64>(patch, patchOffset, patchSize);
+		// First interval that ends after "position"
+		static inline usize findInterval(const std::vector<Interval>& intervals, usize position) {
+			return usize(std::upper_bound(intervals.begin(), intervals.end(), position,
+										  [](usize value, const Interval& interval) { return value < interval.end; }) -
+						 intervals.begin());
+		}
 
-		// The file we're trying to patch is smaller than the input is meant to be, reject it
-		if (dataSize < inputSize) {
-			return {{}, Result::SizeMismatch};
+		// Walks the actions without writing anything and returns the source ranges that are read after an earlier
+		// action overwrote them, with their offsets in the spill buffer. Returns the spill size
+		static usize planInPlace(const u8* patch, usize patchOffset, usize actionsEnd, usize dataSize, u64 outputSize,
+								 std::vector<Interval>& spill) {
+			std::vector<Interval> clobbered;
+			std::vector<Interval> needed;
+			usize sourceOffset = 0;
+			usize outputOffset = 0;
+			usize outputOffset2 = 0;
+
+			// Same offset arithmetic as the apply loops, including wrap-around and running off the end
+			while (patchOffset < actionsEnd) {
+				u64 word;
+				if (!readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+					break;
+				}
+				const u64 action = (word & 3);
+				const u64 length = (word >> 2) + 1;
+				const usize count = usize(std::min<u64>(length, outputSize - outputOffset));
+				const usize writeEnd = std::min(outputOffset + count, dataSize);
+
+				switch (action) {
+					case Action::SourceRead: {
+						outputOffset += count;
+						break;
+					}
+
+					case Action::TargetRead: {
+						patchOffset += count;
+						appendInterval(clobbered, outputOffset, writeEnd);
+						outputOffset += count;
+						break;
+					}
+
+					case Action::SourceCopy: {
+						u64 word;
+						if (!readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+							break;
+						}
+						const s64 offset = s64(word >> 1);
+						sourceOffset += (word & 1) ? -offset : +offset;
+
+						usize src = sourceOffset;
+						usize dst = outputOffset;
+						usize n = count;
+						skipToZero(src, dataSize, dst, n);
+						if (src < dataSize && n > 0) {
+							// Overlap with this action's own write is handled by the copy order, not the spill
+							const usize readEnd = src + std::min<usize>(n, dataSize - src);
+							for (usize i = findInterval(clobbered, src); i < clobbered.size() && clobbered[i].start < readEnd; i++) {
+								needed.push_back({std::max(src, clobbered[i].start), std::min(readEnd, clobbered[i].end), 0});
+							}
+						}
+						sourceOffset += count;
+						appendInterval(clobbered, outputOffset, writeEnd);
+						outputOffset += count;
+						break;
+					}
+
+					case Action::TargetCopy: {
+						u64 word;
+						if (!readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+							break;
+						}
+						const s64 offset = s64(word >> 1);
+						outputOffset2 += (word & 1) ? -offset : +offset;
+						outputOffset2 += count;
+						appendInterval(clobbered, outputOffset, writeEnd);
+						outputOffset += count;
+						break;
+					}
+				}
+			}
+
+			std::sort(needed.begin(), needed.end(), [](const Interval& a, const Interval& b) { return a.start < b.start; });
+			spill.clear();
+			usize spillSize = 0;
+			for (const Interval& interval : needed) {
+				if (!spill.empty() && interval.start <= spill.back().end) {
+					if (interval.end > spill.back().end) {
+						spillSize += interval.end - spill.back().end;
+						spill.back().end = interval.end;
+					}
+				} else {
+					spill.push_back({interval.start, interval.end, spillSize});
+					spillSize += interval.end - interval.start;
+				}
+			}
+			return spillSize;
 		}
 
-		// Copy file to be patched in output buffer
+		// SourceCopy within the shared buffer: spilled ranges come from the spill buffer, the rest from the buffer itself.
+		// Pieces go front to back when reading ahead of the write position and back to front when reading behind it,
+		// so a piece never reads bytes an earlier piece of the same copy already overwrote (as memmove does)
+		static void sourceCopyInPlace(u8* buffer, usize dst, usize src, usize length, const std::vector<Interval>& spill,
+									  const u8* spillData) {
+			const usize end = src + length;
+			const usize first = findInterval(spill, src);
+			if (first == spill.size() || spill[first].start >= end) [[likely]] {
+				std::memmove(buffer + dst, buffer + src, length);
+				return;
+			}
+
+			if (src >= dst) {
+				usize position = src;
+				usize i = first;
+				while (position < end) {
+					usize pieceEnd;
+					if (i < spill.size() && spill[i].start <= position) {
+						pieceEnd = std::min(end, spill[i].end);
+						std::memcpy(buffer + dst + (position - src), spillData + spill[i].spillOffset + (position - spill[i].start),
+									pieceEnd - position);
+						i++;
+					} else {
+						pieceEnd = (i < spill.size()) ? std::min(end, spill[i].start) : end;
+						std::memmove(buffer + dst + (position - src), buffer + position, pieceEnd - position);
+					}
+					position = pieceEnd;
+				}
+			} else {
+				// Intervals that start before "end"
+				usize i = usize(std::lower_bound(spill.begin(), spill.end(), end,
+												 [](const Interval& interval, usize value) { return interval.start < value; }) -
+								spill.begin());
+				usize position = end;
+				while (position > src) {
+					usize pieceStart;
+					if (i > 0 && spill[i - 1].start < position && spill[i - 1].end >= position) {
+						pieceStart = std::max(src, spill[i - 1].start);
+						std::memcpy(buffer + dst + (pieceStart - src),
+									spillData + spill[i - 1].spillOffset + (pieceStart - spill[i - 1].start), position - pieceStart);
+						i--;
+					} else {
+						pieceStart = (i > 0) ? std::max(src, spill[i - 1].end) : src;
+						std::memmove(buffer + dst + (pieceStart - src), buffer + pieceStart, position - pieceStart);
+					}
+					position = pieceStart;
+				}
+			}
+		}
+
+		// Give up on in-place application when more than this fraction of the buffer would have to be spilled
+		static constexpr usize maxSpillFraction = 4;
+	}  // namespace BPS
+
+	static std::pair<std::vector<u8>, Result> patchBPS(const u8* data, usize dataSize, const u8* patch, usize patchSize) {
+		u64 outputSize;
+		usize patchOffset;
+		usize actionsEnd;
+		const Result header = BPS::readHeader(patch, patchSize, dataSize, outputSize, patchOffset, actionsEnd);
+		if (header != Result::Success) {
+			return {{}, header};
+		}
+
+		// The output starts zeroed and every action writes it front to back, so bytes that fall outside the
+		// source, the patch or the already-written target can simply be skipped: they are already 0
 		std::vector<u8> output(outputSize);
+		u8* const out = output.data();
 		usize sourceOffset = 0;
 		usize outputOffset = 0;
 		usize outputOffset2 = 0; // Offset used for TargetCopy commands
 
-		while (patchOffset < patchSize - 12) {
+		while (patchOffset < actionsEnd) {
 			// Each "record" in a BPS patch consists of a VLE word, whose bottom 2 bits are a patching "action" to perform
 			// And the top bits are the length of memory to operate on
-			const u64 word = BPS::readRunLength<u64>(patch, patchOffset, patchSize);
+			u64 word;
+			if (!BPS::readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+				break;
+			}
 			const u64 action = (word & 3);
-			u64 length = (word >> 2) + 1;
+			const u64 length = (word >> 2) + 1;
+
+			// Clamp once: nothing is written past the end of the target
+			const usize count = usize(std::min<u64>(length, outputSize - outputOffset));
 
 			switch (action) {
 				case BPS::Action::SourceRead: {
-					while (length > 0 && outputOffset < outputSize) {
-						// 添加边界检查
-						if (outputOffset >= dataSize) {
-							output[outputOffset] = 0;  // 超出源文件范围,填充0
-						} else {
-							output[outputOffset] = data[outputOffset];
-						}
-						outputOffset += 1;
-						length -= 1;
+					if (outputOffset < dataSize) {
+						std::memcpy(out + outputOffset, data + outputOffset, std::min<usize>(count, dataSize - outputOffset));
 					}
+					outputOffset += count;
 					break;
 				}
 
 				case BPS::Action::TargetRead: {
-					while (length > 0 && outputOffset < outputSize) {
-						output[outputOffset++] = BPS::read<u8, 1>(patch, patchOffset, patchSize);
-						length -= 1;
+					if (patchOffset < patchSize) {
+						std::memcpy(out + outputOffset, patch + patchOffset, std::min<usize>(count, patchSize - patchOffset));
 					}
+					patchOffset += count;
+					outputOffset += count;
 					break;
 				}
 
 				case BPS::Action::SourceCopy: {
-					const u64 word = BPS::readRunLength<u64>(patch, patchOffset, patchSize);
+					u64 word;
+					if (!BPS::readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+						break;
+					}
 					const s64 offset = s64(word >> 1);
 					sourceOffset += (word & 1) ? -offset : +offset;
 
-					while (length > 0 && outputOffset < outputSize) {
-						// 添加边界检查
-						if (sourceOffset >= dataSize) {
-							output[outputOffset++] = 0;  // 超出源文件范围,填充0
-						} else {
-							output[outputOffset++] = data[sourceOffset];
-						}
-						sourceOffset++;
-						length -= 1;
+					usize src = sourceOffset;
+					usize dst = outputOffset;
+					usize n = count;
+					BPS::skipToZero(src, dataSize, dst, n);
+					if (src < dataSize) {
+						std::memcpy(out + dst, data + src, std::min<usize>(n, dataSize - src));
 					}
+					sourceOffset += count;
+					outputOffset += count;
 					break;
 				}
 
 				case BPS::Action::TargetCopy: {
-					const u64 data = BPS::readRunLength<u64>(patch, patchOffset, patchSize);
-					const s64 offset = s64(data >> 1);
-					outputOffset2 += (data & 1) ? -offset : +offset;
-
-					while (length > 0 && outputOffset < outputSize) {
-						// 添加边界检查
-						if (outputOffset2 >= outputSize) {
-							output[outputOffset++] = 0;  // 超出范围,填充0
+					u64 word;
+					if (!BPS::readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+						break;
+					}
+					const s64 offset = s64(word >> 1);
+					outputOffset2 += (word & 1) ? -offset : +offset;
+
+					// Reading at or ahead of the write position only sees zeros
+					usize src = outputOffset2;
+					usize dst = outputOffset;
+					usize n = count;
+					BPS::skipToZero(src, dst, dst, n);
+					if (src < dst) {
+						const usize distance = dst - src;
+						if (distance >= n) {
+							std::memcpy(out + dst, out + src, n);
 						} else {
-							output[outputOffset++] = output[outputOffset2];
+							BPS::replicate(out + dst, distance, n);
 						}
-						outputOffset2++;
-						length -= 1;
 					}
+					outputOffset2 += count;
+					outputOffset += count;
 					break;
 				}
 			}
 		}
 
-		// Pad rest of the output with 0s
-		while (outputOffset < outputSize) {
-			output[outputOffset++] = 0;
-		}
-
+		// Anything the patch didn't cover stays 0
+		patchOffset = actionsEnd;
 		const u32 inputCRC = BPS::read<u32, 4>(patch, patchOffset, patchSize);
 		const u32 outputCRC = BPS::read<u32, 4>(patch, patchOffset, patchSize);
 		const u32 patchCRC = BPS::read<u32, 4>(patch, patchOffset, patchSize);
@@ -502,6 +810,144 @@ namespace Hips {
 		return {output, Result::Success};
 	}
 
+	// Same result as patchBPS, but the target is built in the source's own buffer, which is consumed. Source bytes that
+	// a SourceCopy reads after an earlier action overwrote them are saved to a spill buffer up front, so peak memory is
+	// about max(source, target) + spill instead of source + target. If the spill would be large this falls back to
+	// patchBPS (source + target, as before). When the target is larger than the source the vector grows, so reserve
+	// its capacity beforehand to avoid a reallocation
+	static std::pair<std::vector<u8>, Result> patchBPSInPlace(std::vector<u8>&& data, const u8* patch, usize patchSize) {
+		const usize dataSize = data.size();
+		u64 outputSize;
+		usize patchOffset;
+		usize actionsEnd;
+		const Result header = BPS::readHeader(patch, patchSize, dataSize, outputSize, patchOffset, actionsEnd);
+		if (header != Result::Success) {
+			return {{}, header};
+		}
+
+		std::vector<BPS::Interval> spill;
+		const usize spillSize = BPS::planInPlace(patch, patchOffset, actionsEnd, dataSize, outputSize, spill);
+		if (spillSize > std::max<u64>(dataSize, outputSize) / BPS::maxSpillFraction) {
+			return patchBPS(data.data(), dataSize, patch, patchSize);
+		}
+
+		std::vector<u8> spillData(spillSize);
+		for (const BPS::Interval& interval : spill) {
+			std::memcpy(spillData.data() + interval.spillOffset, data.data() + interval.start, interval.end - interval.start);
+		}
+		data.resize(std::max<u64>(dataSize, outputSize));
+
+		// Unlike patchBPS the buffer isn't zeroed beforehand (it still holds the source), so every byte of an action
+		// that patchBPS would skip is cleared explicitly
+		u8* const out = data.data();
+		const auto zero = [out](usize from, usize to) {
+			if (from < to) {
+				std::memset(out + from, 0, to - from);
+			}
+		};
+		usize sourceOffset = 0;
+		usize outputOffset = 0;
+		usize outputOffset2 = 0;
+
+		while (patchOffset < actionsEnd) {
+			u64 word;
+			if (!BPS::readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+				break;
+			}
+			const u64 action = (word & 3);
+			const u64 length = (word >> 2) + 1;
+			const usize count = usize(std::min<u64>(length, outputSize - outputOffset));
+
+			switch (action) {
+				case BPS::Action::SourceRead: {
+					// The source byte is already in place
+					const usize kept = (outputOffset < dataSize) ? std::min<usize>(count, dataSize - outputOffset) : 0;
+					zero(outputOffset + kept, outputOffset + count);
+					outputOffset += count;
+					break;
+				}
+
+				case BPS::Action::TargetRead: {
+					const usize copied = (patchOffset < patchSize) ? std::min<usize>(count, patchSize - patchOffset) : 0;
+					std::memcpy(out + outputOffset, patch + patchOffset, copied);
+					zero(outputOffset + copied, outputOffset + count);
+					patchOffset += count;
+					outputOffset += count;
+					break;
+				}
+
+				case BPS::Action::SourceCopy: {
+					u64 word;
+					if (!BPS::readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+						break;
+					}
+					const s64 offset = s64(word >> 1);
+					sourceOffset += (word & 1) ? -offset : +offset;
+
+					usize src = sourceOffset;
+					usize dst = outputOffset;
+					usize n = count;
+					BPS::skipToZero(src, dataSize, dst, n);
+					const usize copied = (src < dataSize) ? std::min<usize>(n, dataSize - src) : 0;
+					if (copied > 0) {
+						BPS::sourceCopyInPlace(out, dst, src, copied, spill, spillData.data());
+					}
+					// Cleared after the copy, which may still read source bytes in this range
+					zero(outputOffset, dst);
+					zero(dst + copied, outputOffset + count);
+					sourceOffset += count;
+					outputOffset += count;
+					break;
+				}
+
+				case BPS::Action::TargetCopy: {
+					u64 word;
+					if (!BPS::readNumber(patch, patchOffset, actionsEnd, word)) [[unlikely]] {
+						break;
+					}
+					const s64 offset = s64(word >> 1);
+					outputOffset2 += (word & 1) ? -offset : +offset;
+
+					usize src = outputOffset2;
+					usize dst = outputOffset;
+					usize n = count;
+					BPS::skipToZero(src, dst, dst, n);
+					// Cleared before the copy, which reads the target and must see these as 0 like patchBPS does
+					zero(outputOffset, dst);
+					usize copied = 0;
+					if (src < dst) {
+						const usize distance = dst - src;
+						if (distance >= n) {
+							std::memcpy(out + dst, out + src, n);
+						} else {
+							BPS::replicate(out + dst, distance, n);
+						}
+						copied = n;
+					}
+					zero(dst + copied, outputOffset + count);
+					outputOffset2 += count;
+					outputOffset += count;
+					break;
+				}
+			}
+		}
+
+		// Anything the patch didn't cover is 0
+		zero(outputOffset, usize(outputSize));
+		data.resize(outputSize);
+
+		patchOffset = actionsEnd;
+		const u32 inputCRC = BPS::read<u32, 4>(patch, patchOffset, patchSize);
+		const u32 outputCRC = BPS::read<u32, 4>(patch, patchOffset, patchSize);
+		const u32 patchCRC = BPS::read<u32, 4>(patch, patchOffset, patchSize);
+
+		if (outputCRC != Detail::crc32(data.data(), data.size())) {
+			return {std::move(data), Result::ChecksumMismatch};
+		}
+
+		return {std::move(data), Result::Success};
+	}
+
 	static std::pair<std::vector<u8>, Result> patch(const u8* data, usize dataSize, const u8* patch, usize patchSize, PatchType type) {
 		switch (type) {
 			case PatchType::IPS: return patchIPS(data, dataSize, patch, patchSize);
@@ -667,7 +667,7 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
   (void)width;
   (void)height;
   assert(headers == NULL || !headers->is_lossless);
-#if defined(WEBP_USE_THREAD)
+#if defined(WEBP_USE_THREAD) || defined(WEBP_USE_WORKER_INTERFACE)
   if (width >= MIN_WIDTH_FOR_THREADS) return 2;
 #endif
   return 0;
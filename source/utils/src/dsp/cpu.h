@@ -139,6 +139,18 @@
 #define WEBP_USE_MSA
 #endif
 
+//------------------------------------------------------------------------------
+// PowerPC defines.
+// There is no integer SIMD on 32-bit big-endian PowerPC (e.g. the Wii U's
+// Espresso only has floating-point paired singles), the kernels are plain C
+// tuned for its byte order.
+
+#if (defined(__powerpc__) || defined(__PPC__) || defined(__ppc__)) && \
+    !defined(__powerpc64__) && defined(__BYTE_ORDER__) &&               \
+    (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define WEBP_USE_PPC
+#endif
+
 //------------------------------------------------------------------------------
 
 #ifndef WEBP_DSP_OMIT_C_CODE
@@ -257,7 +269,8 @@ typedef enum {
   kNEON,
   kMIPS32,
   kMIPSdspR2,
-  kMSA
+  kMSA,
+  kPPC
 } CPUFeature;
 
 // returns true if the CPU supports the feature.
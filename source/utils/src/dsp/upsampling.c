@@ -219,6 +219,7 @@ extern VP8CPUInfo VP8GetCPUInfo;
 extern void WebPInitYUV444ConvertersMIPSdspR2(void);
 extern void WebPInitYUV444ConvertersSSE2(void);
 extern void WebPInitYUV444ConvertersSSE41(void);
+extern void WebPInitYUV444ConvertersPPC(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
   WebPYUV444Converters[MODE_RGBA]      = WebPYuv444ToRgba_C;
@@ -248,6 +249,11 @@ WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitYUV444ConvertersMIPSdspR2();
     }
+#endif
+#if defined(WEBP_USE_PPC)
+    if (VP8GetCPUInfo(kPPC)) {
+      WebPInitYUV444ConvertersPPC();
+    }
 #endif
   }
 }
@@ -260,6 +266,7 @@ extern void WebPInitUpsamplersSSE41(void);
 extern void WebPInitUpsamplersNEON(void);
 extern void WebPInitUpsamplersMIPSdspR2(void);
 extern void WebPInitUpsamplersMSA(void);
+extern void WebPInitUpsamplersPPC(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
 #ifdef FANCY_UPSAMPLING
@@ -298,6 +305,11 @@ WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
     if (VP8GetCPUInfo(kMSA)) {
       WebPInitUpsamplersMSA();
     }
+#endif
+#if defined(WEBP_USE_PPC)
+    if (VP8GetCPUInfo(kPPC)) {
+      WebPInitUpsamplersPPC();
+    }
 #endif
   }
 
@@ -0,0 +1,165 @@
+// Copyright 2011 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// PowerPC (big-endian) version of YUV to RGB upsampling functions.
+// Same arithmetic as upsampling.c, but every pixel is written with a single
+// 32-bit store and the top/bottom rows share the u/v interpolation.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_PPC)
+
+#include <assert.h>
+#include <string.h>
+#include "src/dsp/yuv.h"
+
+// Converts one pixel from a packed u/v pair (u | v << 16) and writes it.
+#define PUT_PIXEL(PACK, Y, UV, DST) do {                                       \
+  const int u_ = (int)((UV) & 0xff);                                           \
+  const int v_ = (int)((UV) >> 16);                                            \
+  const uint32_t p_ = PACK(MultHi((Y), 19077), VP8_PPC_R_UV(v_),               \
+                           VP8_PPC_G_UV(u_, v_), VP8_PPC_B_UV(u_));            \
+  memcpy((DST), &p_, 4);                                                       \
+} while (0)
+
+//------------------------------------------------------------------------------
+// Fancy upsampler
+
+#ifdef FANCY_UPSAMPLING
+
+#define LOAD_UV(u, v) ((u) | ((v) << 16))
+
+#define UPSAMPLE_FUNC(FUNC_NAME, PACK)                                         \
+static void FUNC_NAME(const uint8_t* top_y, const uint8_t* bottom_y,           \
+                      const uint8_t* top_u, const uint8_t* top_v,              \
+                      const uint8_t* cur_u, const uint8_t* cur_v,              \
+                      uint8_t* top_dst, uint8_t* bottom_dst, int len) {        \
+  int x;                                                                       \
+  const int last_pixel_pair = (len - 1) >> 1;                                  \
+  uint32_t tl_uv = LOAD_UV(top_u[0], top_v[0]);   /* top-left sample */        \
+  uint32_t l_uv  = LOAD_UV(cur_u[0], cur_v[0]);   /* left-sample */            \
+  assert(top_y != NULL);                                                       \
+  {                                                                            \
+    const uint32_t uv0 = (3 * tl_uv + l_uv + 0x00020002u) >> 2;                \
+    PUT_PIXEL(PACK, top_y[0], uv0, top_dst);                                   \
+  }                                                                            \
+  if (bottom_y != NULL) {                                                      \
+    const uint32_t uv0 = (3 * l_uv + tl_uv + 0x00020002u) >> 2;                \
+    PUT_PIXEL(PACK, bottom_y[0], uv0, bottom_dst);                             \
+  }                                                                            \
+  if (bottom_y != NULL) {                                                      \
+    for (x = 1; x <= last_pixel_pair; ++x) {                                   \
+      const uint32_t t_uv = LOAD_UV(top_u[x], top_v[x]);                       \
+      const uint32_t uv   = LOAD_UV(cur_u[x], cur_v[x]);                       \
+      const uint32_t avg = tl_uv + t_uv + l_uv + uv + 0x00080008u;             \
+      const uint32_t diag_12 = (avg + 2 * (t_uv + l_uv)) >> 3;                 \
+      const uint32_t diag_03 = (avg + 2 * (tl_uv + uv)) >> 3;                  \
+      uint8_t* const top_out = top_dst + (2 * x - 1) * 4;                      \
+      uint8_t* const bottom_out = bottom_dst + (2 * x - 1) * 4;                \
+      PUT_PIXEL(PACK, top_y[2 * x - 1], (diag_12 + tl_uv) >> 1, top_out);      \
+      PUT_PIXEL(PACK, top_y[2 * x - 0], (diag_03 + t_uv) >> 1, top_out + 4);   \
+      PUT_PIXEL(PACK, bottom_y[2 * x - 1], (diag_03 + l_uv) >> 1, bottom_out); \
+      PUT_PIXEL(PACK, bottom_y[2 * x - 0], (diag_12 + uv) >> 1,                \
+                bottom_out + 4);                                               \
+      tl_uv = t_uv;                                                            \
+      l_uv = uv;                                                               \
+    }                                                                          \
+  } else {                                                                     \
+    for (x = 1; x <= last_pixel_pair; ++x) {                                   \
+      const uint32_t t_uv = LOAD_UV(top_u[x], top_v[x]);                       \
+      const uint32_t uv   = LOAD_UV(cur_u[x], cur_v[x]);                       \
+      const uint32_t avg = tl_uv + t_uv + l_uv + uv + 0x00080008u;             \
+      const uint32_t diag_12 = (avg + 2 * (t_uv + l_uv)) >> 3;                 \
+      const uint32_t diag_03 = (avg + 2 * (tl_uv + uv)) >> 3;                  \
+      uint8_t* const top_out = top_dst + (2 * x - 1) * 4;                      \
+      PUT_PIXEL(PACK, top_y[2 * x - 1], (diag_12 + tl_uv) >> 1, top_out);      \
+      PUT_PIXEL(PACK, top_y[2 * x - 0], (diag_03 + t_uv) >> 1, top_out + 4);   \
+      tl_uv = t_uv;                                                            \
+      l_uv = uv;                                                               \
+    }                                                                          \
+  }                                                                            \
+  if (!(len & 1)) {                                                            \
+    {                                                                          \
+      const uint32_t uv0 = (3 * tl_uv + l_uv + 0x00020002u) >> 2;              \
+      PUT_PIXEL(PACK, top_y[len - 1], uv0, top_dst + (len - 1) * 4);           \
+    }                                                                          \
+    if (bottom_y != NULL) {                                                    \
+      const uint32_t uv0 = (3 * l_uv + tl_uv + 0x00020002u) >> 2;              \
+      PUT_PIXEL(PACK, bottom_y[len - 1], uv0, bottom_dst + (len - 1) * 4);     \
+    }                                                                          \
+  }                                                                            \
+}
+
+UPSAMPLE_FUNC(UpsampleRgbaLinePair_PPC, VP8PackRgbaPPC)
+UPSAMPLE_FUNC(UpsampleBgraLinePair_PPC, VP8PackBgraPPC)
+
+#undef LOAD_UV
+#undef UPSAMPLE_FUNC
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitUpsamplersPPC(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitUpsamplersPPC(void) {
+  WebPUpsamplers[MODE_RGBA] = UpsampleRgbaLinePair_PPC;
+  WebPUpsamplers[MODE_BGRA] = UpsampleBgraLinePair_PPC;
+  WebPUpsamplers[MODE_rgbA] = UpsampleRgbaLinePair_PPC;
+  WebPUpsamplers[MODE_bgrA] = UpsampleBgraLinePair_PPC;
+}
+
+#endif  // FANCY_UPSAMPLING
+
+//------------------------------------------------------------------------------
+// YUV444 converter
+
+#define YUV444_FUNC(FUNC_NAME, PACK)                                           \
+static void FUNC_NAME(const uint8_t* y, const uint8_t* u, const uint8_t* v,    \
+                      uint8_t* dst, int len) {                                 \
+  int i;                                                                       \
+  for (i = 0; i + 1 < len; i += 2) {                                           \
+    const uint32_t p0 = PACK(MultHi(y[i + 0], 19077), VP8_PPC_R_UV(v[i + 0]),  \
+                             VP8_PPC_G_UV(u[i + 0], v[i + 0]),                 \
+                             VP8_PPC_B_UV(u[i + 0]));                          \
+    const uint32_t p1 = PACK(MultHi(y[i + 1], 19077), VP8_PPC_R_UV(v[i + 1]),  \
+                             VP8_PPC_G_UV(u[i + 1], v[i + 1]),                 \
+                             VP8_PPC_B_UV(u[i + 1]));                          \
+    memcpy(dst + i * 4 + 0, &p0, 4);                                           \
+    memcpy(dst + i * 4 + 4, &p1, 4);                                           \
+  }                                                                            \
+  if (i < len) {                                                               \
+    const uint32_t uv = (uint32_t)u[i] | ((uint32_t)v[i] << 16);               \
+    PUT_PIXEL(PACK, y[i], uv, dst + i * 4);                                    \
+  }                                                                            \
+}
+
+YUV444_FUNC(Yuv444ToRgba_PPC, VP8PackRgbaPPC)
+YUV444_FUNC(Yuv444ToBgra_PPC, VP8PackBgraPPC)
+
+#undef YUV444_FUNC
+#undef PUT_PIXEL
+
+extern void WebPInitYUV444ConvertersPPC(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitYUV444ConvertersPPC(void) {
+  WebPYUV444Converters[MODE_RGBA] = Yuv444ToRgba_PPC;
+  WebPYUV444Converters[MODE_BGRA] = Yuv444ToBgra_PPC;
+  WebPYUV444Converters[MODE_rgbA] = Yuv444ToRgba_PPC;
+  WebPYUV444Converters[MODE_bgrA] = Yuv444ToBgra_PPC;
+}
+
+#else  // !WEBP_USE_PPC
+
+WEBP_DSP_INIT_STUB(WebPInitYUV444ConvertersPPC)
+
+#endif  // WEBP_USE_PPC
+
+#if !(defined(FANCY_UPSAMPLING) && defined(WEBP_USE_PPC))
+WEBP_DSP_INIT_STUB(WebPInitUpsamplersPPC)
+#endif
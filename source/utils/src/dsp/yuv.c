@@ -75,6 +75,7 @@ extern void WebPInitSamplersSSE2(void);
 extern void WebPInitSamplersSSE41(void);
 extern void WebPInitSamplersMIPS32(void);
 extern void WebPInitSamplersMIPSdspR2(void);
+extern void WebPInitSamplersPPC(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitSamplers) {
   WebPSamplers[MODE_RGB]       = YuvToRgbRow;
@@ -111,6 +112,11 @@ WEBP_DSP_INIT_FUNC(WebPInitSamplers) {
       WebPInitSamplersMIPSdspR2();
     }
 #endif  // WEBP_USE_MIPS_DSP_R2
+#if defined(WEBP_USE_PPC)
+    if (VP8GetCPUInfo(kPPC)) {
+      WebPInitSamplersPPC();
+    }
+#endif  // WEBP_USE_PPC
   }
 }
 
@@ -143,6 +143,36 @@ static WEBP_INLINE void VP8YuvToRgba(uint8_t y, uint8_t u, uint8_t v,
   rgba[3] = 0xff;
 }
 
+//-----------------------------------------------------------------------------
+// PowerPC extra functions (for upsampling_ppc.c and yuv_ppc.c)
+
+#if defined(WEBP_USE_PPC)
+
+// Packs one pixel into a 32-bit word whose big-endian memory layout is
+// R, G, B, A (resp. B, G, R, A), so that it can be written with a single
+// store instead of four byte stores. 'yt' is MultHi(y, 19077) and the other
+// terms are the chroma contributions of VP8YUVToR/G/B(), which can be shared
+// between pixels using the same u/v.
+static WEBP_INLINE uint32_t VP8PackRgbaPPC(int yt, int r_uv, int g_uv,
+                                           int b_uv) {
+  return ((uint32_t)VP8Clip8(yt + r_uv) << 24) |
+         ((uint32_t)VP8Clip8(yt + g_uv) << 16) |
+         ((uint32_t)VP8Clip8(yt + b_uv) <<  8) | 0xffu;
+}
+
+static WEBP_INLINE uint32_t VP8PackBgraPPC(int yt, int r_uv, int g_uv,
+                                           int b_uv) {
+  return ((uint32_t)VP8Clip8(yt + b_uv) << 24) |
+         ((uint32_t)VP8Clip8(yt + g_uv) << 16) |
+         ((uint32_t)VP8Clip8(yt + r_uv) <<  8) | 0xffu;
+}
+
+#define VP8_PPC_R_UV(v)    (MultHi((v), 26149) - 14234)
+#define VP8_PPC_G_UV(u, v) (8708 - MultHi((u), 6419) - MultHi((v), 13320))
+#define VP8_PPC_B_UV(u)    (MultHi((u), 33050) - 17685)
+
+#endif  // WEBP_USE_PPC
+
 //-----------------------------------------------------------------------------
 // SSE2 extra functions (mostly for upsampling_sse2.c)
 
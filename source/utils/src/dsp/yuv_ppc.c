@@ -0,0 +1,70 @@
+// Copyright 2010 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// PowerPC (big-endian) version of YUV->RGB point-sampling functions.
+// The chroma terms are computed once per pixel pair and each pixel is
+// written with a single 32-bit store.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_PPC)
+
+#include <string.h>
+#include "src/dsp/yuv.h"
+
+//------------------------------------------------------------------------------
+// simple point-sampling
+
+#define ROW_FUNC(FUNC_NAME, PACK)                                              \
+static void FUNC_NAME(const uint8_t* y,                                        \
+                      const uint8_t* u, const uint8_t* v,                      \
+                      uint8_t* dst, int len) {                                 \
+  const uint8_t* const end = dst + (len & ~1) * 4;                             \
+  while (dst != end) {                                                         \
+    const int r_uv = VP8_PPC_R_UV(v[0]);                                       \
+    const int g_uv = VP8_PPC_G_UV(u[0], v[0]);                                 \
+    const int b_uv = VP8_PPC_B_UV(u[0]);                                       \
+    const uint32_t p0 = PACK(MultHi(y[0], 19077), r_uv, g_uv, b_uv);           \
+    const uint32_t p1 = PACK(MultHi(y[1], 19077), r_uv, g_uv, b_uv);           \
+    memcpy(dst + 0, &p0, 4);                                                   \
+    memcpy(dst + 4, &p1, 4);                                                   \
+    y += 2;                                                                    \
+    ++u;                                                                       \
+    ++v;                                                                       \
+    dst += 8;                                                                  \
+  }                                                                            \
+  if (len & 1) {                                                               \
+    const uint32_t p0 = PACK(MultHi(y[0], 19077), VP8_PPC_R_UV(v[0]),          \
+                             VP8_PPC_G_UV(u[0], v[0]), VP8_PPC_B_UV(u[0]));    \
+    memcpy(dst, &p0, 4);                                                       \
+  }                                                                            \
+}
+
+ROW_FUNC(YuvToRgbaRow_PPC, VP8PackRgbaPPC)
+ROW_FUNC(YuvToBgraRow_PPC, VP8PackBgraPPC)
+
+#undef ROW_FUNC
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitSamplersPPC(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplersPPC(void) {
+  WebPSamplers[MODE_RGBA] = YuvToRgbaRow_PPC;
+  WebPSamplers[MODE_BGRA] = YuvToBgraRow_PPC;
+  WebPSamplers[MODE_rgbA] = YuvToRgbaRow_PPC;
+  WebPSamplers[MODE_bgrA] = YuvToBgraRow_PPC;
+}
+
+#else  // !WEBP_USE_PPC
+
+WEBP_DSP_INIT_STUB(WebPInitSamplersPPC)
+
+#endif  // WEBP_USE_PPC
@@ -0,0 +1,829 @@
+// 主机上的热点路径基准测试: BPS 补丁、目录 JSON 解析、主题压缩包解压和 WebP 解码
+// 语料由固定种子生成, 每次运行的输入完全相同; 结果输出吞吐量和每次迭代的分配次数/字节数
+// 分配统计包括 operator new 和 C 代码的 malloc (链接时 --wrap), 不包括 zlib 共享库内部的分配
+
+#include "hips.hpp"
+#include "SimpleJsonParser.hpp"
+#include "minizip/unzip.h"
+#include "src/webp/decode.h"
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// 分配统计
+
+static size_t sAllocCount = 0;
+static size_t sAllocBytes = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    sAllocCount++;
+    sAllocBytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    sAllocCount++;
+    sAllocBytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    sAllocCount++;
+    sAllocBytes += size;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    __real_free(ptr);
+}
+}
+
+void* operator new(size_t size) {
+    void* ptr = __wrap_malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    __real_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    __real_free(ptr);
+}
+
+//------------------------------------------------------------------------------
+// 计时
+
+namespace {
+
+constexpr double MIN_SECONDS = 0.5;   // 每项至少运行的时间
+constexpr int MIN_ITERATIONS = 5;
+
+int sFailures = 0;
+volatile bool sSink;   // 保存结果, 避免编译器删掉没有副作用的计算
+
+// 固定种子的 xorshift, 语料在所有机器上都相同
+class Random {
+public:
+    explicit Random(uint64_t seed) : mState(seed) {}
+
+    uint32_t Next() {
+        mState ^= mState << 13;
+        mState ^= mState >> 7;
+        mState ^= mState << 17;
+        return (uint32_t)(mState >> 16);
+    }
+
+    uint32_t Range(uint32_t min, uint32_t max) { return min + Next() % (max - min + 1); }
+
+    void Fill(std::vector<uint8_t>& out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out.push_back((uint8_t)Next());
+        }
+    }
+
+private:
+    uint64_t mState;
+};
+
+// fn 执行一次并返回结果是否正确; 第一次运行用来预热和检查结果, 不计入统计
+template <typename Fn>
+void Run(const std::string& name, size_t bytes, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+
+    if (!fn()) {
+        printf("%-36s FAILED\n", name.c_str());
+        sFailures++;
+        return;
+    }
+
+    int iterations = 0;
+    double total = 0.0;
+    double best = 1e9;
+    size_t allocCount = sAllocCount;
+    size_t allocBytes = sAllocBytes;
+    while (iterations < MIN_ITERATIONS || total < MIN_SECONDS) {
+        auto start = Clock::now();
+        sSink = fn();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        total += seconds;
+        best = std::min(best, seconds);
+        iterations++;
+    }
+    allocCount = sAllocCount - allocCount;
+    allocBytes = sAllocBytes - allocBytes;
+
+    double average = total / iterations;
+    printf("%-36s %8.2f MB %6d x %9.3f ms (best %9.3f) %9.1f MB/s %9zu allocs %10zu KB\n",
+           name.c_str(), bytes / (1024.0 * 1024.0), iterations, average * 1000.0, best * 1000.0,
+           bytes / (1024.0 * 1024.0) / average, allocCount / iterations, allocBytes / iterations / 1024);
+}
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+void PutLE32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+void PutLE16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back((uint8_t)value);
+    out.push_back((uint8_t)(value >> 8));
+}
+
+//------------------------------------------------------------------------------
+// BPS: 模拟 Men.pack 大小的源文件和一个以 SourceRead 为主的补丁
+
+constexpr size_t PACK_SIZE = 12 * 1024 * 1024;
+
+// 压缩过的纹理 (随机) 和重复的结构数据各占一半
+std::vector<uint8_t> MakePack(Random& random) {
+    std::vector<uint8_t> pack;
+    pack.reserve(PACK_SIZE);
+    while (pack.size() < PACK_SIZE) {
+        size_t block = std::min<size_t>(4096, PACK_SIZE - pack.size());
+        if (random.Next() & 1) {
+            random.Fill(pack, block);
+        } else {
+            uint32_t record = random.Next();
+            for (size_t i = 0; i < block; i++) {
+                pack.push_back((uint8_t)(record >> ((i % 4) * 8)) + (uint8_t)(i / 64));
+            }
+        }
+    }
+    return pack;
+}
+
+class BpsWriter {
+public:
+    std::vector<uint8_t> patch;
+
+    void Number(uint64_t value) {
+        while (true) {
+            uint8_t x = value & 0x7F;
+            value >>= 7;
+            if (value == 0) {
+                patch.push_back(0x80 | x);
+                break;
+            }
+            patch.push_back(x);
+            value--;
+        }
+    }
+
+    void Action(uint32_t action, uint64_t length) { Number(((length - 1) << 2) | action); }
+
+    void Offset(int64_t offset) { Number(((uint64_t)(offset < 0 ? -offset : offset) << 1) | (offset < 0 ? 1 : 0)); }
+};
+
+// 同时生成补丁和期望的结果
+void MakePatch(Random& random, const std::vector<uint8_t>& source, std::vector<uint8_t>& patch,
+               std::vector<uint8_t>& target) {
+    namespace Action = Hips::BPS::Action;
+    BpsWriter writer;
+    writer.patch = {'B', 'P', 'S', '1'};
+    writer.Number(source.size());
+    writer.Number(source.size());
+    writer.Number(0);
+
+    target.clear();
+    target.reserve(source.size());
+    size_t sourceCursor = 0;
+    size_t targetCursor = 0;
+    while (target.size() < source.size()) {
+        size_t left = source.size() - target.size();
+        uint32_t kind = random.Next() % 100;
+        if (kind < 70 || target.size() < 64) {
+            size_t length = std::min<size_t>(random.Range(256, 64 * 1024), left);
+            writer.Action(Action::SourceRead, length);
+            target.insert(target.end(), source.begin() + target.size(), source.begin() + target.size() + length);
+        } else if (kind < 85) {
+            size_t length = std::min<size_t>(random.Range(16, 16 * 1024), left);
+            writer.Action(Action::TargetRead, length);
+            size_t start = writer.patch.size();
+            random.Fill(writer.patch, length);
+            target.insert(target.end(), writer.patch.begin() + start, writer.patch.end());
+        } else if (kind < 95) {
+            size_t length = std::min<size_t>(random.Range(64, 16 * 1024), left);
+            size_t from = random.Next() % (source.size() - length);
+            writer.Action(Action::SourceCopy, length);
+            writer.Offset((int64_t)from - (int64_t)sourceCursor);
+            target.insert(target.end(), source.begin() + from, source.begin() + from + length);
+            sourceCursor = from + length;
+        } else {
+            // 可能和正在写的位置重叠 (重复的图案)
+            size_t length = std::min<size_t>(random.Range(32, 2048), left);
+            size_t from = random.Next() % target.size();
+            writer.Action(Action::TargetCopy, length);
+            writer.Offset((int64_t)from - (int64_t)targetCursor);
+            for (size_t i = 0; i < length; i++) {
+                target.push_back(target[from + i]);
+            }
+            targetCursor = from + length;
+        }
+    }
+
+    PutLE32(writer.patch, Hips::Detail::crc32(source.data(), source.size()));
+    PutLE32(writer.patch, Hips::Detail::crc32(target.data(), target.size()));
+    PutLE32(writer.patch, Hips::Detail::crc32(writer.patch.data(), writer.patch.size()));
+    patch = std::move(writer.patch);
+}
+
+//------------------------------------------------------------------------------
+// 目录: Themezer GraphQL 响应 (data.wiiuThemes.nodes), 字段和 ThemeManager 解析的相同
+
+constexpr int CATALOG_NODES = 1000;
+constexpr size_t CATALOG_CHUNK = 16 * 1024;   // 和网络数据块大小相近
+
+std::string MakeCatalog(Random& random) {
+    std::string json = "{\"data\":{\"wiiuThemes\":{\"nodes\":[";
+    char buffer[256];
+    for (int i = 0; i < CATALOG_NODES; i++) {
+        if (i > 0) {
+            json += ',';
+        }
+        snprintf(buffer, sizeof(buffer), "{\"uuid\":\"%08x-%04x-4%03x-a%03x-%012x\",\"name\":\"Theme %d\",",
+                 random.Next(), random.Next() & 0xFFFF, random.Next() & 0xFFF, random.Next() & 0xFFF,
+                 random.Next(), i);
+        json += buffer;
+        json += "\"description\":\"";
+        int sentences = (int)random.Range(1, 6);
+        for (int s = 0; s < sentences; s++) {
+            json += "A cozy theme with soft colors and caf\\u00e9 music.\\nMade for the Wii U Menu. ";
+        }
+        json += "\",";
+        snprintf(buffer, sizeof(buffer),
+                 "\"creator\":{\"username\":\"creator%u\",\"id\":\"%u\"},\"downloadCount\":%u,\"saveCount\":%u,"
+                 "\"updatedAt\":\"2024-%02u-%02uT12:00:00.000Z\",",
+                 random.Next() % 300, random.Next(), random.Next() % 50000, random.Next() % 2000,
+                 random.Range(1, 12), random.Range(1, 28));
+        json += buffer;
+        const char* images[] = {"collagePreview", "launcherScreenshot", "waraWaraPlazaScreenshot"};
+        for (const char* image : images) {
+            snprintf(buffer, sizeof(buffer),
+                     "\"%s\":{\"thumbUrl\":\"https://cdn.themezer.net/%08x/thumb.webp\","
+                     "\"hdUrl\":\"https://cdn.themezer.net/%08x/hd.webp\"},",
+                     image, random.Next(), random.Next());
+            json += buffer;
+        }
+        snprintf(buffer, sizeof(buffer), "\"downloadUrl\":\"https://api.themezer.net/wiiu/%08x/download\",",
+                 random.Next());
+        json += buffer;
+        json += "\"tags\":[";
+        int tags = (int)random.Range(0, 4);
+        for (int t = 0; t < tags; t++) {
+            snprintf(buffer, sizeof(buffer), "%s{\"name\":\"tag%u\"}", t ? "," : "", random.Next() % 40);
+            json += buffer;
+        }
+        json += "]}";
+    }
+    json += "],\"pageInfo\":{\"hasNextPage\":true}}}}";
+    return json;
+}
+
+// 和 ThemeManager 的 Theme 相同的字段 (不含 PooledString 等 Wii U 代码)
+struct CatalogTheme {
+    std::string id, name, description, author, updatedAt, downloadUrl;
+    std::string thumbUrls[3], hdUrls[3];
+    std::vector<std::string> tags;
+    int downloads = 0;
+    int likes = 0;
+};
+
+void ReadString(JsonReader& reader, std::string& value) {
+    if (reader.Peek() != JSON_STRING || !reader.ReadString(value)) {
+        reader.Skip();
+    }
+}
+
+void ReadImage(JsonReader& reader, std::string& thumbUrl, std::string& hdUrl) {
+    std::string_view key;
+    if (!reader.EnterObject()) {
+        reader.Skip();
+        return;
+    }
+    while (reader.NextMember(key)) {
+        if (key == "thumbUrl") {
+            ReadString(reader, thumbUrl);
+        } else if (key == "hdUrl") {
+            ReadString(reader, hdUrl);
+        } else {
+            reader.Skip();
+        }
+    }
+}
+
+// 和 ThemeManager 的 ReadThemeNode 相同的读取顺序
+bool ReadNode(std::string_view node, CatalogTheme& theme) {
+    JsonReader reader(node);
+    std::string_view key;
+    if (!reader.EnterObject()) {
+        return false;
+    }
+    while (reader.NextMember(key)) {
+        if (key == "uuid") {
+            ReadString(reader, theme.id);
+        } else if (key == "name") {
+            ReadString(reader, theme.name);
+        } else if (key == "description") {
+            ReadString(reader, theme.description);
+        } else if (key == "creator") {
+            if (reader.EnterObject() && reader.FindMember("username")) {
+                ReadString(reader, theme.author);
+                while (reader.NextMember(key)) {
+                    reader.Skip();
+                }
+            }
+        } else if (key == "downloadCount") {
+            reader.ReadInt(theme.downloads);
+        } else if (key == "saveCount") {
+            reader.ReadInt(theme.likes);
+        } else if (key == "updatedAt") {
+            ReadString(reader, theme.updatedAt);
+        } else if (key == "collagePreview") {
+            ReadImage(reader, theme.thumbUrls[0], theme.hdUrls[0]);
+        } else if (key == "launcherScreenshot") {
+            ReadImage(reader, theme.thumbUrls[1], theme.hdUrls[1]);
+        } else if (key == "waraWaraPlazaScreenshot") {
+            ReadImage(reader, theme.thumbUrls[2], theme.hdUrls[2]);
+        } else if (key == "downloadUrl") {
+            ReadString(reader, theme.downloadUrl);
+        } else if (key == "tags" && reader.EnterArray()) {
+            while (reader.NextElement()) {
+                if (reader.EnterObject() && reader.FindMember("name")) {
+                    std::string_view tag;
+                    if (reader.ReadString(tag)) {
+                        theme.tags.emplace_back(tag);
+                    }
+                    while (reader.NextMember(key)) {
+                        reader.Skip();
+                    }
+                }
+            }
+        } else {
+            reader.Skip();
+        }
+    }
+    return !reader.HasError();
+}
+
+// 目录页的实际路径: 分块送入 JsonArrayStream, 每个节点用 JsonReader 读成结构体
+bool ParseCatalogStream(const std::string& json, std::vector<CatalogTheme>& themes) {
+    themes.clear();
+    bool ok = true;
+    JsonArrayStream stream({"data", "wiiuThemes", "nodes"}, [&](std::string_view node) {
+        themes.emplace_back();
+        ok = ReadNode(node, themes.back()) && ok;
+    });
+    for (size_t offset = 0; offset < json.size(); offset += CATALOG_CHUNK) {
+        stream.Feed(json.data() + offset, std::min(CATALOG_CHUNK, json.size() - offset));
+    }
+    return ok && stream.Finished() && !stream.HasError();
+}
+
+// 整个文档的 DOM 解析 (本地索引、补丁配置等使用)
+size_t ParseCatalogDocument(std::string_view json) {
+    JsonDocument doc = SimpleJsonParser::Parse(json);
+    if (doc.HasError()) {
+        return 0;
+    }
+    const JsonValue& nodes = doc.Root()["data"]["wiiuThemes"]["nodes"];
+    size_t checksum = nodes.size();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const JsonValue& node = nodes[i];
+        checksum += node["uuid"].asString().size() + node["name"].asString().size() +
+                    node["description"].asString().size() + node["creator"]["username"].asString().size() +
+                    node["collagePreview"]["hdUrl"].asString().size() + node["tags"].size();
+    }
+    return checksum;
+}
+
+//------------------------------------------------------------------------------
+// 压缩包: 和下载的主题包相同的结构 (几个 .bps 补丁和 metadata.json)
+
+struct ZipEntry {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+std::vector<uint8_t> Deflate(const std::vector<uint8_t>& data) {
+    z_stream stream = {};
+    deflateInit2(&stream, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::vector<uint8_t> out(deflateBound(&stream, data.size()));
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = (uInt)data.size();
+    stream.next_out = out.data();
+    stream.avail_out = (uInt)out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+std::vector<uint8_t> MakeZip(const std::vector<ZipEntry>& entries) {
+    std::vector<uint8_t> zip;
+    std::vector<uint8_t> central;
+    for (const ZipEntry& entry : entries) {
+        std::vector<uint8_t> compressed = Deflate(entry.data);
+        uint32_t crc = (uint32_t)crc32(0, entry.data.data(), (uInt)entry.data.size());
+        uint32_t offset = (uint32_t)zip.size();
+
+        PutLE32(zip, 0x04034b50);
+        PutLE16(zip, 20);
+        PutLE16(zip, 0);
+        PutLE16(zip, Z_DEFLATED);
+        PutLE32(zip, 0);   // 时间和日期
+        PutLE32(zip, crc);
+        PutLE32(zip, (uint32_t)compressed.size());
+        PutLE32(zip, (uint32_t)entry.data.size());
+        PutLE16(zip, (uint16_t)entry.name.size());
+        PutLE16(zip, 0);
+        zip.insert(zip.end(), entry.name.begin(), entry.name.end());
+        zip.insert(zip.end(), compressed.begin(), compressed.end());
+
+        PutLE32(central, 0x02014b50);
+        PutLE16(central, 20);
+        PutLE16(central, 20);
+        PutLE16(central, 0);
+        PutLE16(central, Z_DEFLATED);
+        PutLE32(central, 0);
+        PutLE32(central, crc);
+        PutLE32(central, (uint32_t)compressed.size());
+        PutLE32(central, (uint32_t)entry.data.size());
+        PutLE16(central, (uint16_t)entry.name.size());
+        PutLE32(central, 0);   // extra 和 comment 长度
+        PutLE32(central, 0);   // 磁盘号和内部属性
+        PutLE32(central, 0);   // 外部属性
+        PutLE32(central, offset);
+        central.insert(central.end(), entry.name.begin(), entry.name.end());
+    }
+
+    uint32_t centralOffset = (uint32_t)zip.size();
+    zip.insert(zip.end(), central.begin(), central.end());
+    PutLE32(zip, 0x06054b50);
+    PutLE32(zip, 0);
+    PutLE16(zip, (uint16_t)entries.size());
+    PutLE16(zip, (uint16_t)entries.size());
+    PutLE32(zip, (uint32_t)central.size());
+    PutLE32(zip, centralOffset);
+    PutLE16(zip, 0);
+    return zip;
+}
+
+// 和 ZipExtractor 相同的 minizip 调用, 只是解压到内存而不写 SD 卡
+bool ExtractZip(const std::string& path, std::vector<ZipEntry>& out) {
+    out.clear();
+    unzFile zip = unzOpen(path.c_str());
+    if (!zip) {
+        return false;
+    }
+    bool ok = true;
+    for (int status = unzGoToFirstFile(zip); status == UNZ_OK && ok; status = unzGoToNextFile(zip)) {
+        char name[256];
+        unz_file_info info;
+        if (unzGetCurrentFileInfo(zip, &info, name, sizeof(name), nullptr, 0, nullptr, 0) != UNZ_OK ||
+            unzOpenCurrentFile(zip) != UNZ_OK) {
+            ok = false;
+            break;
+        }
+        ZipEntry& entry = out.emplace_back();
+        entry.name = name;
+        entry.data.resize(info.uncompressed_size);
+        size_t done = 0;
+        while (done < entry.data.size()) {
+            int n = unzReadCurrentFile(zip, entry.data.data() + done,
+                                       (unsigned)std::min<size_t>(64 * 1024, entry.data.size() - done));
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            done += n;
+        }
+        // CRC 错误在读完时由 unzCloseCurrentFile 报告
+        ok = unzCloseCurrentFile(zip) == UNZ_OK && ok;
+    }
+    unzClose(zip);
+    return ok;
+}
+
+size_t TotalSize(const std::vector<ZipEntry>& entries) {
+    size_t total = 0;
+    for (const ZipEntry& entry : entries) {
+        total += entry.data.size();
+    }
+    return total;
+}
+
+// 临时文件, 离开作用域时删除
+class TempFile {
+public:
+    explicit TempFile(const std::vector<uint8_t>& data) {
+        char path[] = "/tmp/utheme_bench_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            mPath = path;
+            ssize_t written = write(fd, data.data(), data.size());
+            (void)written;
+            close(fd);
+        }
+    }
+    ~TempFile() {
+        if (!mPath.empty()) {
+            unlink(mPath.c_str());
+        }
+    }
+    const std::string& Path() const { return mPath; }
+
+private:
+    std::string mPath;
+};
+
+//------------------------------------------------------------------------------
+// WebP: 没有编码器 (sharpyuv 没有打包进来), 直接写出一个无损 (VP8L) 的预览图大小的图片
+// 所有字面量用 8 位等长编码, 不用变换和 LZ77, 测的是无损解码的熵解码和输出路径;
+// 有损 (VP8) 的真实预览图用 CORPUS 目录测试
+
+constexpr int PREVIEW_WIDTH = 1280;
+constexpr int PREVIEW_HEIGHT = 720;
+
+class BitWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void Put(uint32_t value, int bits) {
+        mBits |= (uint64_t)value << mUsed;
+        mUsed += bits;
+        while (mUsed >= 8) {
+            bytes.push_back((uint8_t)mBits);
+            mBits >>= 8;
+            mUsed -= 8;
+        }
+    }
+
+    void Flush() {
+        if (mUsed > 0) {
+            bytes.push_back((uint8_t)mBits);
+        }
+        mBits = 0;
+        mUsed = 0;
+    }
+
+private:
+    uint64_t mBits = 0;
+    int mUsed = 0;
+};
+
+// 前 256 个符号码长 8, 其余符号不使用
+void PutFlatCode(BitWriter& bits, int symbols) {
+    bits.Put(0, 1);       // 普通编码
+    bits.Put(12 - 4, 4);  // 码长编码的码长数: 顺序表中符号 0 在第 2 位, 符号 8 在第 11 位
+    for (int i = 0; i < 12; i++) {
+        bits.Put((i == 2 || i == 11) ? 1 : 0, 3);
+    }
+    bits.Put(0, 1);       // 码长覆盖所有符号
+    for (int i = 0; i < symbols; i++) {
+        bits.Put(i < 256 ? 1 : 0, 1);   // 1 位的码: 0 -> 码长 0, 1 -> 码长 8
+    }
+}
+
+// 只有一个符号的编码 (不占用像素数据的位)
+void PutSingleSymbol(BitWriter& bits, uint8_t symbol) {
+    bits.Put(1, 1);       // 简单编码
+    bits.Put(0, 1);       // 1 个符号
+    bits.Put(1, 1);       // 8 位符号
+    bits.Put(symbol, 8);
+}
+
+uint32_t Reverse8(uint32_t value) {
+    value = ((value & 0xF0) >> 4) | ((value & 0x0F) << 4);
+    value = ((value & 0xCC) >> 2) | ((value & 0x33) << 2);
+    return ((value & 0xAA) >> 1) | ((value & 0x55) << 1);
+}
+
+std::vector<uint8_t> MakeLosslessWebP(Random& random, std::vector<uint8_t>& rgba) {
+    rgba.resize((size_t)PREVIEW_WIDTH * PREVIEW_HEIGHT * 4);
+    BitWriter bits;
+    bits.Put(0x2F, 8);
+    bits.Put(PREVIEW_WIDTH - 1, 14);
+    bits.Put(PREVIEW_HEIGHT - 1, 14);
+    bits.Put(0, 1);       // 不透明
+    bits.Put(0, 3);       // 版本
+    bits.Put(0, 1);       // 无变换
+    bits.Put(0, 1);       // 无颜色缓存
+    bits.Put(0, 1);       // 无元 Huffman 编码
+    PutFlatCode(bits, 256 + 24);   // 绿色 + 长度前缀
+    PutFlatCode(bits, 256);        // 红
+    PutFlatCode(bits, 256);        // 蓝
+    PutSingleSymbol(bits, 255);    // alpha
+    PutSingleSymbol(bits, 0);      // 距离
+    for (int y = 0; y < PREVIEW_HEIGHT; y++) {
+        for (int x = 0; x < PREVIEW_WIDTH; x++) {
+            uint32_t noise = random.Next();
+            uint8_t* pixel = &rgba[((size_t)y * PREVIEW_WIDTH + x) * 4];
+            pixel[0] = (uint8_t)(x * 255 / PREVIEW_WIDTH + (noise & 7));
+            pixel[1] = (uint8_t)(y * 255 / PREVIEW_HEIGHT + ((noise >> 3) & 7));
+            pixel[2] = (uint8_t)((x + y) / 8 + ((noise >> 6) & 15));
+            pixel[3] = 255;
+            bits.Put(Reverse8(pixel[1]), 8);
+            bits.Put(Reverse8(pixel[0]), 8);
+            bits.Put(Reverse8(pixel[2]), 8);
+        }
+    }
+    bits.Flush();
+
+    std::vector<uint8_t> webp = {'R', 'I', 'F', 'F'};
+    size_t padded = (bits.bytes.size() + 1) & ~(size_t)1;
+    PutLE32(webp, (uint32_t)(4 + 8 + padded));
+    webp.insert(webp.end(), {'W', 'E', 'B', 'P', 'V', 'P', '8', 'L'});
+    PutLE32(webp, (uint32_t)bits.bytes.size());
+    webp.insert(webp.end(), bits.bytes.begin(), bits.bytes.end());
+    webp.resize(8 + 4 + 8 + padded);
+    return webp;
+}
+
+// 和 ImageLoader 一次性解码相同: 解码到调用方的 RGBA 缓冲
+bool DecodeWebP(const std::vector<uint8_t>& data, std::vector<uint8_t>& pixels) {
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(data.data(), data.size(), &config.input) != VP8_STATUS_OK) {
+        return false;
+    }
+    int width = config.input.width;
+    int height = config.input.height;
+    pixels.resize((size_t)width * height * 4);
+    config.output.colorspace = MODE_RGBA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = pixels.data();
+    config.output.u.RGBA.stride = width * 4;
+    config.output.u.RGBA.size = pixels.size();
+    VP8StatusCode status = WebPDecode(data.data(), data.size(), &config);
+    WebPFreeDecBuffer(&config.output);
+    return status == VP8_STATUS_OK;
+}
+
+// 和 ImageLoader 渐进加载相同: 按下载数据块增量解码
+bool DecodeWebPIncremental(const std::vector<uint8_t>& data, std::vector<uint8_t>& pixels) {
+    int width = 0;
+    int height = 0;
+    if (!WebPGetInfo(data.data(), data.size(), &width, &height)) {
+        return false;
+    }
+    pixels.resize((size_t)width * height * 4);
+    WebPIDecoder* idec = WebPINewRGB(MODE_RGBA, pixels.data(), pixels.size(), width * 4);
+    if (!idec) {
+        return false;
+    }
+    VP8StatusCode status = VP8_STATUS_SUSPENDED;
+    for (size_t offset = 0; offset < data.size() && status == VP8_STATUS_SUSPENDED; offset += CATALOG_CHUNK) {
+        status = WebPIAppend(idec, data.data() + offset, std::min(CATALOG_CHUNK, data.size() - offset));
+    }
+    WebPIDelete(idec);
+    return status == VP8_STATUS_OK;
+}
+
+//------------------------------------------------------------------------------
+
+void BenchBps(Random& random, std::vector<uint8_t>& patchOut) {
+    std::vector<uint8_t> source = MakePack(random);
+    std::vector<uint8_t> target;
+    MakePatch(random, source, patchOut, target);
+
+    Run("bps apply (Men.pack)", target.size(), [&] {
+        auto [output, result] = Hips::patchBPS(source.data(), source.size(), patchOut.data(), patchOut.size());
+        return result == Hips::Result::Success && output == target;
+    });
+    // 源文件的副本不计入: 原地应用消耗传入的缓冲区
+    std::vector<uint8_t> copy;
+    Run("bps apply in place (Men.pack)", target.size(), [&] {
+        copy.reserve(std::max(source.size(), target.size()));
+        copy.assign(source.begin(), source.end());
+        auto [output, result] = Hips::patchBPSInPlace(std::move(copy), patchOut.data(), patchOut.size());
+        bool ok = result == Hips::Result::Success && output == target;
+        copy = std::move(output);
+        return ok;
+    });
+    Run("crc32", source.size(), [&] {
+        return Hips::Detail::crc32(source.data(), source.size()) != 0;
+    });
+}
+
+void BenchCatalog(const std::string& name, const std::string& json) {
+    std::vector<CatalogTheme> themes;
+    Run(name + " stream", json.size(), [&] {
+        return ParseCatalogStream(json, themes) && !themes.empty();
+    });
+    Run(name + " document", json.size(), [&] {
+        return ParseCatalogDocument(json) > 0;
+    });
+}
+
+void BenchZip(const std::string& name, const std::string& path, const std::vector<ZipEntry>* expected) {
+    std::vector<ZipEntry> entries;
+    if (!ExtractZip(path, entries)) {
+        printf("%-36s FAILED\n", name.c_str());
+        sFailures++;
+        return;
+    }
+    Run(name, TotalSize(entries), [&] {
+        if (!ExtractZip(path, entries)) {
+            return false;
+        }
+        if (!expected) {
+            return true;
+        }
+        for (size_t i = 0; i < expected->size(); i++) {
+            if (i >= entries.size() || entries[i].data != (*expected)[i].data) {
+                return false;
+            }
+        }
+        return entries.size() == expected->size();
+    });
+}
+
+void BenchWebP(const std::string& name, const std::vector<uint8_t>& data, const std::vector<uint8_t>* expected) {
+    std::vector<uint8_t> pixels;
+    Run(name + " decode", data.size(), [&] {
+        return DecodeWebP(data, pixels) && (!expected || pixels == *expected);
+    });
+    Run(name + " incremental", data.size(), [&] {
+        return DecodeWebPIncremental(data, pixels) && (!expected || pixels == *expected);
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    printf("%-36s %11s %8s %14s %16s %14s %16s %13s\n", "benchmark", "input", "iters", "average", "",
+           "throughput", "per iteration", "");
+
+    Random random(0x5554686D65ull);
+
+    std::vector<uint8_t> patch;
+    BenchBps(random, patch);
+
+    std::string catalog = MakeCatalog(random);
+    BenchCatalog("catalog json", catalog);
+
+    std::vector<ZipEntry> entries(4);
+    entries[0].name = "Men.bps";
+    entries[0].data = patch;
+    entries[1].name = "Men2.bps";
+    entries[1].data = patch;
+    entries[2].name = "cafe_barista_men.bps";
+    entries[2].data.assign(patch.begin(), patch.begin() + std::min<size_t>(patch.size(), 256 * 1024));
+    entries[3].name = "metadata.json";
+    entries[3].data.assign(catalog.begin(), catalog.begin() + 2048);
+    TempFile zip(MakeZip(entries));
+    BenchZip("theme zip extract", zip.Path(), &entries);
+
+    std::vector<uint8_t> rgba;
+    std::vector<uint8_t> webp = MakeLosslessWebP(random, rgba);
+    BenchWebP("webp lossless 1280x720", webp, &rgba);
+
+    // 真实数据 (例如从 SD 卡缓存复制的预览图和下载的主题包)
+    if (argc > 1) {
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(argv[1])) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        for (const auto& file : files) {
+            std::string ext = file.extension().string();
+            std::string name = file.filename().string();
+            if (ext == ".webp") {
+                BenchWebP(name, ReadFile(file), nullptr);
+            } else if (ext == ".zip") {
+                BenchZip(name, file.string(), nullptr);
+            } else if (ext == ".json") {
+                std::vector<uint8_t> data = ReadFile(file);
+                BenchCatalog(name, std::string(data.begin(), data.end()));
+            }
+        }
+    }
+
+    return sFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+// 基准测试用的 libwebp 配置 (编译时定义 HAVE_CONFIG_H 才会包含)
+// 不定义 WEBP_HAVE_SSE2 / WEBP_HAVE_SSE41 / WEBP_HAVE_NEON: 主机上也只用 C 实现,
+// 和 Wii U (没有可用的 SIMD 版本) 的解码路径一致
+#ifndef UTHEME_BENCH_WEBP_CONFIG_H_
+#define UTHEME_BENCH_WEBP_CONFIG_H_
+
+#define HAVE_BUILTIN_BSWAP16 1
+#define HAVE_BUILTIN_BSWAP32 1
+#define HAVE_BUILTIN_BSWAP64 1
+
+#endif  // UTHEME_BENCH_WEBP_CONFIG_H_
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Packs the assets that aren't needed all the time into one bundle (called from the Makefile),
+# read by source/utils/AssetBundle.cpp. Each asset is compressed on its own (raw deflate),
+# so it can be decompressed on first use and released again.
+#
+# Layout, big endian:
+#   header  "UTAB", u32 version, u32 count
+#   entries char name[32], u32 method (0 stored, 1 deflate), u32 offset, u32 compressed size, u32 size
+#   data
+#
+# usage: pack_assets.py <output> <file>...
+
+import os
+import struct
+import sys
+import zlib
+
+VERSION = 1
+NAME_SIZE = 32
+METHOD_STORED = 0
+METHOD_DEFLATE = 1
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: pack_assets.py <output> <file>...")
+
+    output, paths = sys.argv[1], sys.argv[2:]
+
+    entries = []
+    for path in paths:
+        name = os.path.basename(path).encode("utf-8")
+        if len(name) >= NAME_SIZE:
+            sys.exit("asset name too long: %s" % path)
+        with open(path, "rb") as f:
+            raw = f.read()
+        compressor = zlib.compressobj(9, zlib.DEFLATED, -zlib.MAX_WBITS)
+        packed = compressor.compress(raw) + compressor.flush()
+        method = METHOD_DEFLATE
+        if len(packed) >= len(raw):
+            packed, method = raw, METHOD_STORED
+        entries.append((name, method, packed, len(raw)))
+
+    offset = 12 + len(entries) * (NAME_SIZE + 16)
+    index = struct.pack(">4sII", b"UTAB", VERSION, len(entries))
+    for name, method, packed, size in entries:
+        index += struct.pack(">%dsIIII" % NAME_SIZE, name, method, offset, len(packed), size)
+        offset += len(packed)
+
+    with open(output, "wb") as f:
+        f.write(index)
+        for _, _, packed, _ in entries:
+            f.write(packed)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Subsets the UI font before it is embedded (called from the Makefile).
+# Keeps the characters of the language files plus Latin, kana, symbols and the
+# common CJK characters (GB2312 level 1, JIS X 0208 level 1) seen in theme names.
+# Anything else is drawn with the full font from the SD card, see Gfx.cpp.
+#
+# usage: subset_font.py <full font> <output> <language json>...
+
+import sys
+
+RANGES = [
+    (0x0020, 0x007e),  # Basic Latin
+    (0x00a0, 0x017f),  # Latin-1 Supplement, Latin Extended-A
+    (0x2000, 0x206f),  # General Punctuation
+    (0x2100, 0x21ff),  # Letterlike Symbols, Number Forms, Arrows
+    (0x2460, 0x24ff),  # Enclosed Alphanumerics
+    (0x2500, 0x27bf),  # Box Drawing, Geometric Shapes, Misc Symbols, Dingbats
+    (0x3000, 0x30ff),  # CJK Symbols and Punctuation, Hiragana, Katakana
+    (0xff00, 0xffef),  # Halfwidth and Fullwidth Forms
+]
+
+
+def table_chars(codec, rows):
+    chars = set()
+    for row in rows:
+        for cell in range(0xa1, 0xff):
+            try:
+                chars.update(bytes([row, cell]).decode(codec))
+            except UnicodeDecodeError:
+                pass
+    return chars
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("usage: subset_font.py <full font> <output> <language json>...")
+
+    try:
+        from fontTools import subset
+    except ImportError:
+        sys.exit("subset_font.py needs fonttools (pip install fonttools), or build with FONT_SUBSET=0")
+
+    source, output, languages = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+    chars = set()
+    for start, end in RANGES:
+        chars.update(chr(c) for c in range(start, end + 1))
+    chars |= table_chars("gb2312", range(0xb0, 0xd8))
+    chars |= table_chars("euc_jp", range(0xb0, 0xd0))
+    for path in languages:
+        with open(path, encoding="utf-8") as f:
+            chars.update(f.read())
+
+    options = subset.Options()
+    options.notdef_outline = True
+    font = subset.load_font(source, options)
+    subsetter = subset.Subsetter(options)
+    subsetter.populate(unicodes=[ord(c) for c in chars if ord(c) >= 0x20])
+    subsetter.subset(font)
+    subset.save_font(font, output, options)
+    font.close()
+
+
+if __name__ == "__main__":
+    main()